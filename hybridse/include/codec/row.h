@@ -87,6 +87,25 @@ class Row {
         slice_.reset(reinterpret_cast<const char *>(buf), size);
     }
 
+    // whether the row refers to the buffers owned by others only
+    bool IsBorrowed() const;
+
+    // make the row refer to cnt slices owned by others, the i-th slice is
+    // given by slice(i) as a pair of buffer and size. The vector of the
+    // secondary slices is reused
+    template <typename SliceFn>
+    void Borrow(size_t cnt, SliceFn slice) {
+        if (0 == cnt) {
+            slice_ = RefCountedSlice();
+        }
+        slices_.resize(cnt > 0 ? cnt - 1 : 0);
+        for (size_t i = 0; i < cnt; ++i) {
+            auto s = slice(i);
+            (0 == i ? slice_ : slices_[i - 1]) =
+                RefCountedSlice::Create(s.first, s.second);
+        }
+    }
+
  private:
     void Append(const std::vector<hybridse::base::RefCountedSlice> &slices);
     void Append(const Row &b);
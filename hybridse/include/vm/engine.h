@@ -17,11 +17,15 @@
 #ifndef INCLUDE_VM_ENGINE_H_
 #define INCLUDE_VM_ENGINE_H_
 
+#include <condition_variable>  // NOLINT
+#include <deque>
+#include <list>
 #include <map>
 #include <memory>
 #include <mutex>  //NOLINT
 #include <set>
 #include <string>
+#include <thread>  // NOLINT
 #include <utility>
 #include <vector>
 #include "base/raw_buffer.h"
@@ -125,6 +129,36 @@ class EngineOptions {
         return enable_spark_unsaferow_format_;
     }
 
+    /// Set `true` to enable tiered compiling, default `false`.
+    ///
+    /// If set `true`, a new query is compiled without the ir optimization, so it can run sooner. The query is
+    /// recompiled with the optimization in the background once it gets hot, the later sessions get the optimized one.
+    inline EngineOptions* set_enable_tiered_compile(bool flag) {
+        enable_tiered_compile_ = flag;
+        return this;
+    }
+    /// Return if the engine compiles the queries in tiers.
+    inline bool is_enable_tiered_compile() const { return enable_tiered_compile_; }
+
+    /// Set the times a tiered query is got from the cache before it's recompiled with the optimization, default `100`.
+    ///
+    /// A query is recompiled sooner if its runs, including the ones still running, have taken longer than its
+    /// compiling, or have processed `tiered_compile_rows` rows.
+    inline EngineOptions* set_tiered_compile_hits(uint32_t hits) {
+        tiered_compile_hits_ = hits;
+        return this;
+    }
+    /// Return the times a tiered query is got before it's recompiled.
+    inline uint32_t tiered_compile_hits() const { return tiered_compile_hits_; }
+
+    /// Set the rows the runs of a tiered query process before it's recompiled with the optimization, default `10000`.
+    inline EngineOptions* set_tiered_compile_rows(uint64_t rows) {
+        tiered_compile_rows_ = rows;
+        return this;
+    }
+    /// Return the rows a tiered query processes before it's recompiled.
+    inline uint64_t tiered_compile_rows() const { return tiered_compile_rows_; }
+
     /// Return JitOptions
     inline hybridse::vm::JitOptions& jit_options() { return jit_options_; }
 
@@ -139,9 +173,25 @@ class EngineOptions {
     bool enable_batch_window_parallelization_;
     uint32_t max_sql_cache_size_;
     bool enable_spark_unsaferow_format_;
+    bool enable_tiered_compile_;
+    uint32_t tiered_compile_hits_;
+    uint64_t tiered_compile_rows_;
     JitOptions jit_options_;
 };
 
+/// \brief The compiling and the running statistics of a query.
+struct QueryStats {
+    uint64_t compile_time_us = 0;  ///< The time spent on compiling the query
+    /// The total time spent on running the tiered compiled query, the
+    /// optimized one is not timed
+    uint64_t run_time_us = 0;
+    uint64_t run_cnt = 0;  ///< The times the tiered compiled query is run
+    bool optimized = true;         ///< Whether the query runs the optimized code
+};
+
+struct SqlContext;
+class SqlCompileInfo;
+
 /// \brief A RunSession maintain SQL running context, including compile information, procedure name.
 ///
 class RunSession {
@@ -183,6 +233,9 @@ class RunSession {
 
  protected:
     std::shared_ptr<hybridse::vm::CompileInfo> compile_info_;
+    // the context of the compile info if it's tiered compiled, its runs are
+    // timed to decide the recompiling. null otherwise
+    SqlContext* tiered_ctx_;
     hybridse::vm::EngineMode engine_mode_;
     bool is_debug_;
     std::string sp_name_;
@@ -371,7 +424,36 @@ class Engine {
     /// \brief Clear engine's compiling result cache
     void ClearCacheLocked(const std::string& db);
 
+    /// \brief Return the statistics of a cached query, the ones of the optimized code if it's recompiled
+    bool GetQueryStats(const std::string& sql, const std::string& db, EngineMode engine_mode, QueryStats* stats);
+
  private:
+    struct TieredCompileTask {
+        std::string db;
+        std::string sql;
+        std::shared_ptr<CompileInfo> info;
+    };
+    // a tiered query not recompiled yet, it's dropped once it's evicted from the cache
+    struct TieredWatch {
+        std::string db;
+        std::string sql;
+        std::weak_ptr<CompileInfo> info;
+    };
+
+    void InitSqlContext(const std::string& sql, const std::string& db, EngineMode engine_mode,
+                        SqlContext* ctx);
+    // compile the sql of the context and build its cluster job
+    bool Compile(const std::shared_ptr<SqlCompileInfo>& info, base::Status& status);  // NOLINT
+    // count the hit of a tiered query and queue its recompiling once it's hot. It returns the optimized one if the
+    // query has been recompiled
+    std::shared_ptr<CompileInfo> HitTieredCache(const std::string& db, const std::string& sql,
+                                                const std::shared_ptr<CompileInfo>& info);
+    // return true if the tiered query of ctx is hot enough to be recompiled
+    bool IsTieredHot(const SqlContext& ctx) const;
+    // queue the recompiling of the watched queries that get hot while running, tiered_mu_ is held
+    void CheckTieredRunsLocked();
+    void RunTieredCompile();
+
     bool GetDependentTables(node::PlanNode* node, std::set<std::string>* tables,
                             base::Status& status);  // NOLINT
     std::shared_ptr<CompileInfo> GetCacheLocked(const std::string& db,
@@ -393,6 +475,12 @@ class Engine {
     EngineOptions options_;
     base::SpinMutex mu_;
     EngineLRUCache lru_cache_;
+    std::mutex tiered_mu_;
+    std::condition_variable tiered_cv_;
+    std::deque<TieredCompileTask> tiered_tasks_;
+    std::list<TieredWatch> tiered_watches_;
+    bool tiered_stop_;
+    std::thread tiered_thread_;
 };
 
 /// \brief Local tablet is responsible to run a task locally.
@@ -94,11 +94,19 @@ class JitOptions {
     bool is_enable_perf() const { return enable_perf_; }
     void set_enable_perf(bool flag) { enable_perf_ = flag; }
 
+    // the dir of the object code cache of the compiled modules, the cache
+    // is disabled if it's empty
+    const std::string& object_cache_path() const { return object_cache_path_; }
+    void set_object_cache_path(const std::string& path) {
+        object_cache_path_ = path;
+    }
+
  private:
     bool enable_mcjit_ = false;
     bool enable_vtune_ = false;
     bool enable_gdb_ = false;
     bool enable_perf_ = false;
+    std::string object_cache_path_;
 };
 }  // namespace vm
 }  // namespace hybridse
@@ -81,6 +81,94 @@ class MemTimeTableIterator : public RowIterator {
     MemTimeTable::const_iterator iter_;
 };
 
+/**
+ * Ring buffer of the window rows in the descending order of key from the
+ * front to the back. It keeps the key with the raw pointers and sizes of the
+ * row slices instead of the Row objects, so pushing and popping a row takes
+ * no reference counting nor allocation once the buffer is warmed up.
+ *
+ * The slices are borrowed: the rows read from the storage refer to the
+ * segments pinned by the ticket of their iterator, which lives while the
+ * window is built. A row with a managed slice is kept in the buffer too, the
+ * storage gives such copies for the values it can't pin, e.g. the ones
+ * uncompressed from a time block.
+ */
+class WindowBuffer {
+ public:
+    WindowBuffer();
+    ~WindowBuffer() {}
+    WindowBuffer(const WindowBuffer&) = delete;
+    WindowBuffer& operator=(const WindowBuffer&) = delete;
+
+    inline uint64_t size() const { return tail_ - head_; }
+    inline bool empty() const { return tail_ == head_; }
+
+    // the key of the row at pos from the front
+    inline const uint64_t& GetKey(uint64_t pos) const {
+        return entries_[(head_ + pos) & mask_].key;
+    }
+    inline const uint64_t& GetFrontKey() const { return GetKey(0); }
+    inline const uint64_t& GetBackKey() const { return GetKey(size() - 1); }
+
+    // set row to the row at pos, it's valid until the row is popped
+    void GetRow(uint64_t pos, Row* row) const;
+    Row At(uint64_t pos) const;
+
+    void PushFront(uint64_t key, const Row& row);
+    // push the row at pos of other
+    void PushFront(const WindowBuffer& other, uint64_t pos);
+    void PopFront();
+    void PopBack();
+
+ private:
+    struct Entry {
+        uint64_t key;
+        // the position of the first slice in slices_
+        uint64_t slice_pos;
+        uint32_t slice_cnt;
+        // the row is kept in owners_
+        bool owned;
+    };
+    struct RawSlice {
+        int8_t* buf;
+        size_t size;
+    };
+
+    // make room for one more row of slice_cnt slices at the front
+    void Reserve(uint32_t slice_cnt);
+
+    // the positions grow down from the front and up from the back, they are
+    // masked into the vectors of the power of two sizes
+    std::vector<Entry> entries_;
+    std::vector<Row> owners_;
+    uint64_t mask_;
+    uint64_t head_;
+    uint64_t tail_;
+    std::vector<RawSlice> slices_;
+    uint64_t slice_mask_;
+    uint64_t slice_head_;
+    uint64_t slice_tail_;
+};
+
+class WindowBufferIterator : public RowIterator {
+ public:
+    WindowBufferIterator(const WindowBuffer* buffer, const vm::Schema* schema);
+    ~WindowBufferIterator() {}
+    void Seek(const uint64_t& ts) override;
+    void SeekToFirst() override;
+    const uint64_t& GetKey() const override;
+    void Next() override;
+    bool Valid() const override;
+    const Row& GetValue() override;
+    bool IsSeekable() const override;
+
+ private:
+    const WindowBuffer* buffer_;
+    const Schema* schema_;
+    uint64_t pos_;
+    Row row_;
+};
+
 class MemTableIterator : public RowIterator {
  public:
     MemTableIterator(const MemTable* table, const vm::Schema* schema);
@@ -249,30 +337,41 @@ class Window : public MemTimeTableHandler {
     Window()
         : MemTimeTableHandler(),
           exclude_current_time_(false),
-          instance_not_in_window_(false) {}
+          instance_not_in_window_(false),
+          buffer_() {}
     virtual ~Window() {}
 
     std::unique_ptr<RowIterator> GetIterator() override {
-        std::unique_ptr<vm::MemTimeTableIterator> it(
-            new vm::MemTimeTableIterator(&table_, schema_));
+        std::unique_ptr<vm::WindowBufferIterator> it(
+            new vm::WindowBufferIterator(&buffer_, schema_));
         return std::move(it);
     }
 
     RowIterator* GetRawIterator() {
-        return new vm::MemTimeTableIterator(&table_, schema_);
+        return new vm::WindowBufferIterator(&buffer_, schema_);
     }
     virtual bool BufferData(uint64_t key, const Row& row) = 0;
-    virtual void PopBackData() { PopBackRow(); }
+    virtual void PopBackData() { buffer_.PopBack(); }
     virtual void PopFrontData() = 0;
 
-    virtual const uint64_t GetCount() { return table_.size(); }
+    virtual const uint64_t GetCount() { return buffer_.size(); }
     virtual Row At(uint64_t pos) {
-        if (pos >= table_.size()) {
+        if (pos >= buffer_.size()) {
             return Row();
         } else {
-            return table_[pos].second;
+            return buffer_.At(pos);
         }
     }
+    const std::pair<uint64_t, Row>& GetFrontRow() override {
+        edge_row_.first = buffer_.GetFrontKey();
+        buffer_.GetRow(0, &edge_row_.second);
+        return edge_row_;
+    }
+    const std::pair<uint64_t, Row>& GetBackRow() override {
+        edge_row_.first = buffer_.GetBackKey();
+        buffer_.GetRow(buffer_.size() - 1, &edge_row_.second);
+        return edge_row_;
+    }
     const std::string GetHandlerTypeName() override { return "Window"; }
     const bool instance_not_in_window() const {
         return instance_not_in_window_;
@@ -289,6 +388,9 @@ class Window : public MemTimeTableHandler {
  protected:
     bool exclude_current_time_;
     bool instance_not_in_window_;
+    // the rows of the window, table_ is not used
+    WindowBuffer buffer_;
+    std::pair<uint64_t, Row> edge_row_;
 };
 class WindowRange {
  public:
@@ -370,22 +472,22 @@ class HistoryWindow : public Window {
     ~HistoryWindow() {}
     virtual void PopFrontData() {
         if (current_history_buffer_.empty()) {
-            PopFrontRow();
+            buffer_.PopFront();
         } else {
-            current_history_buffer_.pop_front();
+            current_history_buffer_.PopFront();
         }
     }
     virtual void PopEffectiveData() {
-        if (!table_.empty()) {
-            PopFrontRow();
+        if (!buffer_.empty()) {
+            buffer_.PopFront();
         }
     }
     bool BufferData(uint64_t key, const Row& row) {
-        if (!table_.empty() && GetFrontRow().first > key) {
+        if (!buffer_.empty() && buffer_.GetFrontKey() > key) {
             DLOG(WARNING) << "Fail BufferData: buffer key less than latest key";
             return false;
         }
-        auto cur_size = table_.size();
+        auto cur_size = buffer_.size();
         if (cur_size < window_range_.start_row_) {
             // current row InWindow
             int64_t sub = (key + window_range_.start_offset_);
@@ -411,41 +513,45 @@ class HistoryWindow : public Window {
  protected:
     bool BufferCurrentHistoryBuffer(uint64_t key, const Row& row,
                                     uint64_t end_ts) {
-        current_history_buffer_.emplace_front(std::make_pair(key, row));
+        current_history_buffer_.PushFront(key, row);
         int64_t sub = (key + window_range_.start_offset_);
         uint64_t start_ts = sub < 0 ? 0u : static_cast<uint64_t>(sub);
         while (!current_history_buffer_.empty()) {
-            auto& back = current_history_buffer_.back();
-            if (back.first > end_ts) {
+            uint64_t back_pos = current_history_buffer_.size() - 1;
+            if (current_history_buffer_.GetKey(back_pos) > end_ts) {
                 break;
             }
-            BufferEffectiveWindow(back.first, back.second, start_ts);
-            current_history_buffer_.pop_back();
+            buffer_.PushFront(current_history_buffer_, back_pos);
+            SlideWindow(start_ts);
+            current_history_buffer_.PopBack();
         }
         return true;
     }
 
     bool BufferEffectiveWindow(uint64_t key, const Row& row,
                                uint64_t start_ts) {
-        AddFrontRow(key, row);
-        auto cur_size = table_.size();
+        buffer_.PushFront(key, row);
+        return SlideWindow(start_ts);
+    }
+
+    bool SlideWindow(uint64_t start_ts) {
+        auto cur_size = buffer_.size();
         while (window_range_.max_size_ > 0 &&
                cur_size > window_range_.max_size_) {
-            PopBackRow();
+            buffer_.PopBack();
             --cur_size;
         }
 
         // Slide window when window size >= rows_preceding
         while (cur_size > 0) {
-            const auto& pair = GetBackRow();
             if ((kFrameRows == window_range_.frame_type_ ||
                  kFrameRowsMergeRowsRange == window_range_.frame_type_) &&
                 cur_size <= window_range_.start_row_ + 1) {
                 break;
             }
             if (kFrameRows == window_range_.frame_type_ ||
-                pair.first < start_ts) {
-                PopBackRow();
+                buffer_.GetBackKey() < start_ts) {
+                buffer_.PopBack();
                 --cur_size;
 
             } else {
@@ -465,7 +571,7 @@ class HistoryWindow : public Window {
         }
     }
     WindowRange window_range_;
-    MemTimeTable current_history_buffer_;
+    WindowBuffer current_history_buffer_;
 };
 
 /**
@@ -489,9 +595,9 @@ class CurrentHistoryWindow : public HistoryWindow {
                                     max_size)) {}
     ~CurrentHistoryWindow() {}
 
-    virtual void PopFrontData() { PopFrontRow(); }
+    virtual void PopFrontData() { buffer_.PopFront(); }
     bool BufferData(uint64_t key, const Row& row) {
-        if (!table_.empty() && GetFrontRow().first > key) {
+        if (!buffer_.empty() && buffer_.GetFrontKey() > key) {
             DLOG(WARNING) << "Fail BufferData: buffer key less than latest key";
             return false;
         }
@@ -81,6 +81,15 @@ static void BM_AllocFromByteMemPool1000(benchmark::State& state) {  // NOLINT
 static void BM_AllocFromNewFree1000(benchmark::State& state) {  // NOLINT
     NewFree1000(&state, BENCHMARK, state.range(0));
 }
+static void BM_SumCateHashDict(benchmark::State& state) {  // NOLINT
+    SumCateHashDict(&state, BENCHMARK, state.range(0), state.range(1));
+}
+static void BM_SumCateMapDict(benchmark::State& state) {  // NOLINT
+    SumCateMapDict(&state, BENCHMARK, state.range(0), state.range(1));
+}
+static void BM_TopKHeap(benchmark::State& state) {  // NOLINT
+    TopKHeap(&state, BENCHMARK, state.range(0), state.range(1));
+}
 static void BM_HistoryWindowBuffer(benchmark::State& state) {  // NOLINT
     HistoryWindowBuffer(&state, BENCHMARK, state.range(0));
 }
@@ -157,6 +166,26 @@ BENCHMARK(BM_AllocFromNewFree1000)
     ->Args({1000})
     ->Args({10000});
 
+// window size and the count of the categories
+BENCHMARK(BM_SumCateHashDict)
+    ->Args({100, 10})
+    ->Args({1000, 10})
+    ->Args({1000, 100})
+    ->Args({10000, 100})
+    ->Args({10000, 1000});
+BENCHMARK(BM_SumCateMapDict)
+    ->Args({100, 10})
+    ->Args({1000, 10})
+    ->Args({1000, 100})
+    ->Args({10000, 100})
+    ->Args({10000, 1000});
+// window size and k
+BENCHMARK(BM_TopKHeap)
+    ->Args({100, 3})
+    ->Args({1000, 10})
+    ->Args({10000, 10})
+    ->Args({10000, 100});
+
 BENCHMARK(BM_TimestampFormat);
 BENCHMARK(BM_TimestampToString);
 BENCHMARK(BM_DateFormat);
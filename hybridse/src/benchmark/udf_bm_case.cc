@@ -15,6 +15,8 @@
  */
 
 #include "benchmark/udf_bm_case.h"
+#include <algorithm>
+#include <functional>
 #include <memory>
 #include <string>
 #include <vector>
@@ -24,6 +26,7 @@
 #include "codegen/ir_base_builder.h"
 #include "codegen/window_ir_builder.h"
 #include "gtest/gtest.h"
+#include "udf/containers.h"
 #include "udf/udf.h"
 #include "udf/udf_test.h"
 #include "vm/jit_runtime.h"
@@ -513,6 +516,127 @@ void ByteMemPoolAlloc1000(benchmark::State* state, MODE mode,
         }
     }
 }
+// keys spread over [0, cardinality) like a shuffled category column
+static void BuildCateData(int64_t data_size, int64_t cardinality,
+                          std::vector<int32_t>* keys,
+                          std::vector<int64_t>* values) {
+    for (int64_t i = 0; i < data_size; ++i) {
+        keys->push_back(static_cast<int32_t>(
+            (static_cast<uint64_t>(i) * 2654435761ULL) % cardinality));
+        values->push_back(i);
+    }
+}
+
+template <typename DictT>
+static int32_t RunSumCate(const std::vector<int32_t>& keys,
+                          const std::vector<int64_t>& values,
+                          std::string* result) {
+    alignas(DictT) int8_t buf[sizeof(DictT)];
+    DictT* dict = reinterpret_cast<DictT*>(buf);
+    DictT::Init(dict);
+    for (size_t i = 0; i < keys.size(); ++i) {
+        auto res = dict->Emplace(keys[i], values[i]);
+        if (!res.second) {
+            *res.first += values[i];
+        }
+    }
+    codec::StringRef output;
+    DictT::OutputString(dict, false, &output,
+                        [](const int64_t& sum, char* buf, size_t size) {
+                            return udf::v1::format_string(sum, buf, size);
+                        });
+    DictT::Destroy(dict);
+    if (result != nullptr) {
+        *result = output.ToString();
+    }
+    hybridse::vm::JitRuntime::get()->ReleaseRunStep();
+    return output.size_;
+}
+
+template <typename DictT>
+static void SumCate(benchmark::State* state, MODE mode, int64_t data_size,
+                    int64_t cardinality) {
+    std::vector<int32_t> keys;
+    std::vector<int64_t> values;
+    BuildCateData(data_size, cardinality, &keys, &values);
+    switch (mode) {
+        case BENCHMARK: {
+            for (auto _ : *state) {
+                benchmark::DoNotOptimize(
+                    RunSumCate<DictT>(keys, values, nullptr));
+            }
+            break;
+        }
+        case TEST: {
+            // the output must be the same as the ordered map
+            using MapDictT =
+                udf::container::BoundedGroupByDict<int32_t, int64_t, int64_t>;
+            std::string expect;
+            std::string result;
+            RunSumCate<MapDictT>(keys, values, &expect);
+            RunSumCate<DictT>(keys, values, &result);
+            ASSERT_EQ(expect, result);
+        }
+    }
+}
+
+void SumCateHashDict(benchmark::State* state, MODE mode, int64_t data_size,
+                     int64_t cardinality) {
+    SumCate<udf::container::HashGroupByDict<int32_t, int64_t, int64_t>>(
+        state, mode, data_size, cardinality);
+}
+
+void SumCateMapDict(benchmark::State* state, MODE mode, int64_t data_size,
+                    int64_t cardinality) {
+    SumCate<udf::container::BoundedGroupByDict<int32_t, int64_t, int64_t>>(
+        state, mode, data_size, cardinality);
+}
+
+static int32_t RunTopK(const std::vector<int64_t>& values, int64_t bound,
+                       std::string* result) {
+    using ContainerT = udf::container::TopKContainer<int64_t, int64_t>;
+    alignas(ContainerT) int8_t buf[sizeof(ContainerT)];
+    ContainerT* topk = reinterpret_cast<ContainerT*>(buf);
+    ContainerT::Init(topk);
+    for (auto value : values) {
+        ContainerT::Push(topk, value, false, bound);
+    }
+    codec::StringRef output;
+    ContainerT::Output(topk, &output);
+    if (result != nullptr) {
+        *result = output.ToString();
+    }
+    hybridse::vm::JitRuntime::get()->ReleaseRunStep();
+    return output.size_;
+}
+
+void TopKHeap(benchmark::State* state, MODE mode, int64_t data_size,
+              int64_t bound) {
+    std::vector<int32_t> keys;
+    std::vector<int64_t> values;
+    BuildCateData(data_size, data_size, &keys, &values);
+    values.assign(keys.begin(), keys.end());
+    switch (mode) {
+        case BENCHMARK: {
+            for (auto _ : *state) {
+                benchmark::DoNotOptimize(RunTopK(values, bound, nullptr));
+            }
+            break;
+        }
+        case TEST: {
+            std::sort(values.begin(), values.end(), std::greater<int64_t>());
+            std::string expect;
+            for (int64_t i = 0; i < bound && i < data_size; ++i) {
+                expect.append(i == 0 ? "" : ",")
+                    .append(std::to_string(values[i]));
+            }
+            std::string result;
+            RunTopK(values, bound, &result);
+            ASSERT_EQ(expect, result);
+        }
+    }
+}
+
 void TimestampFormat(benchmark::State* state, MODE mode) {
     codec::Timestamp timestamp(1590115420000L);
     const std::string format = "%Y-%m-%d %H:%M:%S";
@@ -43,6 +43,12 @@ void DateFormat(benchmark::State* state, MODE mode);
 void ByteMemPoolAlloc1000(benchmark::State* state, MODE mode,
                           size_t request_size);
 void NewFree1000(benchmark::State* state, MODE mode, size_t request_size);
+void SumCateHashDict(benchmark::State* state, MODE mode, int64_t data_size,
+                     int64_t cardinality);
+void SumCateMapDict(benchmark::State* state, MODE mode, int64_t data_size,
+                    int64_t cardinality);
+void TopKHeap(benchmark::State* state, MODE mode, int64_t data_size,
+              int64_t bound);
 
 int64_t RunHistoryWindowBuffer(const hybridse::vm::WindowRange& window_range,
                                uint64_t data_size,
@@ -72,6 +72,16 @@ TEST_F(UdfBMCaseTest, ByteMemPoolAlloc1000_TEST) {
     ByteMemPoolAlloc1000(nullptr, TEST, 1000);
     ByteMemPoolAlloc1000(nullptr, TEST, 10000);
 }
+TEST_F(UdfBMCaseTest, SumCateHashDict_TEST) {
+    SumCateHashDict(nullptr, TEST, 100, 10);
+    SumCateHashDict(nullptr, TEST, 1000, 100);
+    SumCateHashDict(nullptr, TEST, 10000, 1000);
+}
+TEST_F(UdfBMCaseTest, TopKHeap_TEST) {
+    TopKHeap(nullptr, TEST, 100, 3);
+    TopKHeap(nullptr, TEST, 1000, 10);
+    TopKHeap(nullptr, TEST, 10, 100);
+}
 TEST_F(UdfBMCaseTest, TimestampToString_TEST) {
     TimestampToString(nullptr, TEST);
 }
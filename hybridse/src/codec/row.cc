@@ -69,6 +69,18 @@ void Row::Append(const Row &b) {
 
 int32_t Row::GetRowPtrCnt() const { return 1 + slices_.size(); }
 
+bool Row::IsBorrowed() const {
+    if (slice_.IsManaged()) {
+        return false;
+    }
+    for (const auto &slice : slices_) {
+        if (slice.IsManaged()) {
+            return false;
+        }
+    }
+    return true;
+}
+
 // Return a string that contains the copy of the referenced data.
 std::string Row::ToString() const { return slice_.ToString(); }
 
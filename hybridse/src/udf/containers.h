@@ -17,12 +17,18 @@
 #ifndef SRC_UDF_CONTAINERS_H_
 #define SRC_UDF_CONTAINERS_H_
 
+#include <stdlib.h>
+
 #include <algorithm>
 #include <functional>
+#include <iterator>
 #include <map>
 #include <string>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+#include "base/fe_hash.h"
 #include "codec/type_codec.h"
 #include "udf/literal_traits.h"
 #include "udf/udf.h"
@@ -64,6 +70,172 @@ struct ContainerStorageTypeTrait<codec::Timestamp> {
     }
 };
 
+/**
+ * Bump allocator owned by an aggregate state, the memory is released all
+ * together when the state is destroyed. The first chunk is inlined into the
+ * state so that the small windows never call malloc. The destructors of the
+ * objects in the arena are never called, only the plain values of the stored
+ * types should be put into it.
+ */
+class ContainerArena {
+ public:
+    ContainerArena()
+        : cur_(inline_chunk_),
+          end_(inline_chunk_ + INLINE_CHUNK_SIZE),
+          chunks_(nullptr),
+          next_chunk_size_(MIN_CHUNK_SIZE) {}
+    ~ContainerArena() {
+        while (chunks_ != nullptr) {
+            Chunk* next = chunks_->next;
+            free(chunks_);
+            chunks_ = next;
+        }
+    }
+    ContainerArena(const ContainerArena&) = delete;
+    ContainerArena& operator=(const ContainerArena&) = delete;
+
+    template <typename T>
+    T* AllocateArray(size_t n) {
+        return reinterpret_cast<T*>(Allocate(sizeof(T) * n, alignof(T)));
+    }
+
+    void* Allocate(size_t size, size_t align) {
+        char* ptr = Align(cur_, align);
+        if (ptr + size > end_) {
+            NewChunk(size + align);
+            ptr = Align(cur_, align);
+        }
+        cur_ = ptr + size;
+        return ptr;
+    }
+
+ private:
+    struct Chunk {
+        Chunk* next;
+    };
+
+    static char* Align(char* ptr, size_t align) {
+        auto addr = reinterpret_cast<uintptr_t>(ptr);
+        return reinterpret_cast<char*>((addr + align - 1) & ~(align - 1));
+    }
+
+    void NewChunk(size_t min_size) {
+        size_t size = std::max(next_chunk_size_, min_size + sizeof(Chunk));
+        next_chunk_size_ = std::min(next_chunk_size_ * 2, MAX_CHUNK_SIZE);
+        auto chunk = static_cast<Chunk*>(malloc(size));
+        chunk->next = chunks_;
+        chunks_ = chunk;
+        cur_ = reinterpret_cast<char*>(chunk + 1);
+        end_ = reinterpret_cast<char*>(chunk) + size;
+    }
+
+    static const size_t INLINE_CHUNK_SIZE = 256;
+    static const size_t MIN_CHUNK_SIZE = 4096;
+    static const size_t MAX_CHUNK_SIZE = 1024 * 1024;
+
+    char inline_chunk_[INLINE_CHUNK_SIZE];
+    char* cur_;
+    char* end_;
+    Chunk* chunks_;
+    size_t next_chunk_size_;
+};
+
+/**
+ * Hash of the stored key types.
+ */
+template <typename T>
+struct ContainerHashTrait {
+    static uint32_t hash(const T& t) {
+        static_assert(std::is_integral<T>::value, "unsupported key type");
+        return Mix(static_cast<uint64_t>(t));
+    }
+    // finalizer of murmur3, spreads the sequential keys over the slots
+    static uint32_t Mix(uint64_t h) {
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        return static_cast<uint32_t>(h);
+    }
+};
+
+template <>
+struct ContainerHashTrait<codec::StringRef> {
+    static uint32_t hash(const codec::StringRef& t) {
+        return base::hash(t.data_, t.size_, codec::SEED);
+    }
+};
+
+template <>
+struct ContainerHashTrait<codec::Date> {
+    static uint32_t hash(const codec::Date& t) {
+        return ContainerHashTrait<int32_t>::Mix(t.date_);
+    }
+};
+
+template <>
+struct ContainerHashTrait<codec::Timestamp> {
+    static uint32_t hash(const codec::Timestamp& t) {
+        return ContainerHashTrait<int64_t>::Mix(t.ts_);
+    }
+};
+
+/**
+ * Format the sorted key value pairs as "k:v,k:v" into a managed string, the
+ * pairs beyond the max output size are dropped.
+ */
+template <typename IterT, typename FormatValueF>
+void FormatKeyValues(IterT begin, IterT end, size_t max_size,
+                     const FormatValueF& format_value,
+                     codec::StringRef* output) {
+    // estimate output length
+    uint32_t str_len = 0;
+    auto stop = begin;
+    for (; stop != end; ++stop) {
+        uint32_t key_len = v1::to_string_len(stop->first);
+        uint32_t value_len = format_value(stop->second, nullptr, 0);
+        uint32_t new_len = str_len + key_len + value_len + 2;  // "k:v,"
+        if (new_len > max_size) {
+            break;
+        }
+        str_len = new_len;
+    }
+    if (str_len == 0) {
+        output->size_ = 0;
+        output->data_ = "";
+        return;
+    }
+
+    // allocate string buffer
+    char* buffer = udf::v1::AllocManagedStringBuf(str_len);
+
+    // fill string buffer
+    char* cur = buffer;
+    uint32_t remain_space = str_len;
+    for (auto iter = begin; iter != stop; ++iter) {
+        uint32_t key_len = v1::format_string(iter->first, cur, remain_space);
+        cur += key_len;
+        *(cur++) = ':';
+        remain_space -= key_len + 1;
+
+        uint32_t value_len = format_value(iter->second, cur, remain_space);
+        cur += value_len;
+        remain_space -= value_len;
+        if (remain_space-- > 0) {
+            *(cur++) = ',';
+        }
+    }
+
+    *(buffer + str_len - 1) = '\0';
+    output->data_ = buffer;
+    output->size_ = str_len - 1;  // must leave one '\0' for string format impl
+}
+
+/**
+ * Keep the k largest values in a binary min heap, the heap top is the value
+ * to evict. The values are sorted only once at output.
+ */
 template <typename T, typename BoundT>
 class TopKContainer {
  public:
@@ -97,33 +269,31 @@ class TopKContainer {
     }
 
     static void OutputString(ContainerT* ptr, codec::StringRef* output) {
-        auto& map = ptr->map_;
-        if (map.empty()) {
+        if (ptr->size_ == 0) {
             output->size_ = 0;
             output->data_ = "";
             return;
         }
+        // sort the min heap into descending order
+        StorageT* heap = ptr->heap_;
+        std::sort_heap(heap, heap + ptr->size_, std::greater<StorageT>());
 
         // estimate output length
         uint32_t str_len = 0;
-        for (auto iter = map.rbegin(); iter != map.rend(); ++iter) {
-            uint32_t key_len = v1::to_string_len(iter->first);
-            str_len += (key_len + 1) * iter->second;  // "x,x,x,"
+        for (BoundT i = 0; i < ptr->size_; ++i) {
+            str_len += v1::to_string_len(heap[i]) + 1;  // "x,x,x,"
         }
         // allocate string buffer
         char* buffer = udf::v1::AllocManagedStringBuf(str_len);
         // fill string buffer
         char* cur = buffer;
         uint32_t remain_space = str_len;
-        for (auto iter = map.rbegin(); iter != map.rend(); ++iter) {
-            for (size_t k = 0; k < iter->second; ++k) {
-                uint32_t key_len =
-                    v1::format_string(iter->first, cur, remain_space);
-                cur += key_len;
-                remain_space -= key_len;
-                if (remain_space-- > 0) {
-                    *(cur++) = ',';
-                }
+        for (BoundT i = 0; i < ptr->size_; ++i) {
+            uint32_t key_len = v1::format_string(heap[i], cur, remain_space);
+            cur += key_len;
+            remain_space -= key_len;
+            if (remain_space-- > 0) {
+                *(cur++) = ',';
             }
         }
         *(buffer + str_len - 1) = '\0';
@@ -132,27 +302,40 @@ class TopKContainer {
     }
 
     void Push(InputT t) {
-        auto key = ContainerStorageTypeTrait<T>::to_stored_value(t);
-        auto iter = map_.find(key);
-        if (iter == map_.end()) {
-            map_.insert(iter, {key, 1});
-        } else {
-            iter->second += 1;
+        if (bound_ <= 0) {
+            return;
         }
-        elem_cnt_ += 1;
-        if (elem_cnt_ > bound_) {
-            auto iter_min = map_.begin();
-            iter_min->second -= 1;
-            if (iter_min->second == 0) {
-                map_.erase(iter_min);
+        auto value = ContainerStorageTypeTrait<T>::to_stored_value(t);
+        std::greater<StorageT> cmp;
+        if (size_ < bound_) {
+            if (size_ == capacity_) {
+                Grow();
             }
-            elem_cnt_ -= 1;
+            heap_[size_++] = value;
+            std::push_heap(heap_, heap_ + size_, cmp);
+        } else if (cmp(value, heap_[0])) {
+            std::pop_heap(heap_, heap_ + size_, cmp);
+            heap_[size_ - 1] = value;
+            std::push_heap(heap_, heap_ + size_, cmp);
         }
     }
 
  private:
-    std::map<StorageT, size_t, std::less<StorageT>> map_;
-    BoundT elem_cnt_ = 0;
+    void Grow() {
+        BoundT capacity = capacity_ == 0 ? 16 : capacity_ * 2;
+        if (capacity > bound_) {
+            capacity = bound_;
+        }
+        StorageT* heap = arena_.AllocateArray<StorageT>(capacity);
+        std::copy(heap_, heap_ + size_, heap);
+        heap_ = heap;
+        capacity_ = capacity;
+    }
+
+    ContainerArena arena_;
+    StorageT* heap_ = nullptr;
+    BoundT size_ = 0;
+    BoundT capacity_ = 0;
     BoundT bound_ = -1;  // delayed to be set by first push
 };
 
@@ -205,98 +388,155 @@ class BoundedGroupByDict {
                              codec::StringRef* output,
                              const FormatValueF& format_value) {
         auto& map = ptr->map_;
-        if (map.empty()) {
-            output->size_ = 0;
-            output->data_ = "";
-            return;
-        }
-
-        // estimate output length
-        uint32_t str_len = 0;
-        auto stop_pos = map.end();
-        auto stop_rpos = map.rend();
         if (is_desc) {
-            for (auto iter = map.rbegin(); iter != map.rend(); ++iter) {
-                uint32_t key_len = v1::to_string_len(iter->first);
-                uint32_t value_len = format_value(iter->second, nullptr, 0);
-                uint32_t new_len = str_len + key_len + value_len + 2;  // "k:v,"
-                if (new_len > MAX_OUTPUT_STR_SIZE) {
-                    stop_rpos = iter;
-                    break;
-                } else {
-                    str_len = new_len;
-                }
-            }
+            FormatKeyValues(map.rbegin(), map.rend(), MAX_OUTPUT_STR_SIZE,
+                            format_value, output);
         } else {
-            for (auto iter = map.begin(); iter != map.end(); ++iter) {
-                uint32_t key_len = v1::to_string_len(iter->first);
-                uint32_t value_len = format_value(iter->second, nullptr, 0);
-                uint32_t new_len = str_len + key_len + value_len + 2;  // "k:v,"
-                if (new_len > MAX_OUTPUT_STR_SIZE) {
-                    stop_pos = iter;
-                    break;
-                } else {
-                    str_len = new_len;
-                }
-            }
+            FormatKeyValues(map.begin(), map.end(), MAX_OUTPUT_STR_SIZE,
+                            format_value, output);
         }
+    }
 
-        // allocate string buffer
-        char* buffer = udf::v1::AllocManagedStringBuf(str_len);
+    // insert the value if the key is absent, return the stored value of the
+    // key and whether it is inserted
+    std::pair<StorageV*, bool> Emplace(const StorageK& key,
+                                       const StorageV& value) {
+        auto iter = map_.lower_bound(key);
+        if (iter != map_.end() && !(key < iter->first)) {
+            return {&iter->second, false};
+        }
+        iter = map_.emplace_hint(iter, key, value);
+        return {&iter->second, true};
+    }
 
-        // fill string buffer
-        char* cur = buffer;
-        uint32_t remain_space = str_len;
+    std::map<StorageK, StorageV>& map() { return map_; }
+
+ private:
+    std::map<StorageK, StorageV> map_;
+
+    static const size_t MAX_OUTPUT_STR_SIZE = 4096;
+};
+
+/**
+ * Group by dict on an open addressing hash table with linear probing. The
+ * entries are appended into an array in the arena and sorted by key only at
+ * output, so an update neither rebalances a tree nor calls malloc. The keys
+ * can not be erased, use BoundedGroupByDict for the bounded aggregates.
+ */
+template <typename K, typename V,
+          typename StorageV = typename ContainerStorageTypeTrait<V>::type>
+class HashGroupByDict {
+ public:
+    // actual input type
+    using InputK = typename DataTypeTrait<K>::CCallArgType;
+    using InputV = typename DataTypeTrait<V>::CCallArgType;
+
+    // actual stored type
+    using StorageK = typename ContainerStorageTypeTrait<K>::type;
+    using Entry = std::pair<StorageK, StorageV>;
+
+    // self type
+    using ContainerT = HashGroupByDict<K, V, StorageV>;
+
+    using FormatValueF =
+        std::function<uint32_t(const StorageV&, char*, size_t)>;
+
+    // convert to internal key and value
+    static inline StorageK to_stored_key(const InputK& key) {
+        return ContainerStorageTypeTrait<K>::to_stored_value(key);
+    }
+    static inline auto to_stored_value(const InputV& value) {
+        return ContainerStorageTypeTrait<V>::to_stored_value(value);
+    }
+
+    static void Init(ContainerT* addr) { new (addr) ContainerT(); }
+
+    static void Destroy(ContainerT* ptr) { ptr->~ContainerT(); }
+
+    static void OutputString(ContainerT* ptr, bool is_desc,
+                             codec::StringRef* output,
+                             const FormatValueF& format_value) {
+        Entry* begin = ptr->entries_;
+        Entry* end = ptr->entries_ + ptr->size_;
+        // the slots are useless after sort, the dict is destroyed next
+        std::sort(begin, end, [](const Entry& x, const Entry& y) {
+            return x.first < y.first;
+        });
         if (is_desc) {
-            for (auto iter = map.rbegin(); iter != map.rend(); ++iter) {
-                if (iter == stop_rpos) {
-                    break;
-                }
-                uint32_t key_len =
-                    v1::format_string(iter->first, cur, remain_space);
-                cur += key_len;
-                *(cur++) = ':';
-                remain_space -= key_len + 1;
-
-                uint32_t value_len =
-                    format_value(iter->second, cur, remain_space);
-                cur += value_len;
-                remain_space -= value_len;
-                if (remain_space-- > 0) {
-                    *(cur++) = ',';
-                }
-            }
+            FormatKeyValues(std::reverse_iterator<Entry*>(end),
+                            std::reverse_iterator<Entry*>(begin),
+                            MAX_OUTPUT_STR_SIZE, format_value, output);
         } else {
-            for (auto iter = map.begin(); iter != map.end(); ++iter) {
-                if (iter == stop_pos) {
-                    break;
-                }
-                uint32_t key_len =
-                    v1::format_string(iter->first, cur, remain_space);
-                cur += key_len;
-                *(cur++) = ':';
-                remain_space -= key_len + 1;
-
-                uint32_t value_len =
-                    format_value(iter->second, cur, remain_space);
-                cur += value_len;
-                remain_space -= value_len;
-                if (remain_space-- > 0) {
-                    *(cur++) = ',';
-                }
-            }
+            FormatKeyValues(begin, end, MAX_OUTPUT_STR_SIZE, format_value,
+                            output);
         }
+    }
 
-        *(buffer + str_len - 1) = '\0';
-        output->data_ = buffer;
-        output->size_ =
-            str_len - 1;  // must leave one '\0' for string format impl
+    // insert the value if the key is absent, return the stored value of the
+    // key and whether it is inserted
+    std::pair<StorageV*, bool> Emplace(const StorageK& key,
+                                       const StorageV& value) {
+        if (size_ == capacity_) {
+            Grow();
+        }
+        uint32_t hash = ContainerHashTrait<StorageK>::hash(key);
+        for (uint32_t pos = hash & slot_mask_;; pos = (pos + 1) & slot_mask_) {
+            Slot& slot = slots_[pos];
+            if (slot.idx == 0) {
+                slot.hash = hash;
+                slot.idx = ++size_;
+                Entry* entry = new (&entries_[size_ - 1]) Entry(key, value);
+                return {&entry->second, true};
+            }
+            if (slot.hash == hash && entries_[slot.idx - 1].first == key) {
+                return {&entries_[slot.idx - 1].second, false};
+            }
+        }
     }
 
-    std::map<StorageK, StorageV>& map() { return map_; }
+    size_t size() const { return size_; }
 
  private:
-    std::map<StorageK, StorageV> map_;
+    struct Slot {
+        uint32_t hash;
+        // the index of the entry plus one, zero for the empty slot
+        uint32_t idx;
+    };
+
+    // double the entries and keep the load factor of the slots below 0.5
+    void Grow() {
+        uint32_t capacity = capacity_ == 0 ? 8 : capacity_ * 2;
+        Entry* entries = arena_.AllocateArray<Entry>(capacity);
+        for (uint32_t i = 0; i < size_; ++i) {
+            new (&entries[i]) Entry(entries_[i]);
+        }
+        uint32_t slot_cnt = capacity * 2;
+        Slot* slots = arena_.AllocateArray<Slot>(slot_cnt);
+        std::fill(slots, slots + slot_cnt, Slot{0, 0});
+        uint32_t slot_mask = slot_cnt - 1;
+        for (uint32_t i = 0; i < capacity_ * 2; ++i) {
+            const Slot& slot = slots_[i];
+            if (slot.idx == 0) {
+                continue;
+            }
+            uint32_t pos = slot.hash & slot_mask;
+            while (slots[pos].idx != 0) {
+                pos = (pos + 1) & slot_mask;
+            }
+            slots[pos] = slot;
+        }
+        entries_ = entries;
+        slots_ = slots;
+        slot_mask_ = slot_mask;
+        capacity_ = capacity;
+    }
+
+    ContainerArena arena_;
+    Entry* entries_ = nullptr;
+    Slot* slots_ = nullptr;
+    uint32_t slot_mask_ = 0;
+    uint32_t size_ = 0;
+    uint32_t capacity_ = 0;
 
     static const size_t MAX_OUTPUT_STR_SIZE = 4096;
 };
@@ -0,0 +1,118 @@
+/*
+ * Copyright 2021 4Paradigm
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string>
+
+#include "udf/default_udf_library.h"
+#include "udf/sketches.h"
+#include "udf/udf_registry.h"
+
+using hybridse::codec::Date;
+using hybridse::codec::StringRef;
+using hybridse::codec::Timestamp;
+
+namespace hybridse {
+namespace udf {
+
+template <typename T>
+struct ApproxDistinctCountDef {
+    using ContainerT = udf::container::HyperLogLog<T>;
+
+    void operator()(UdafRegistryHelper& helper) {  // NOLINT
+        std::string suffix = ".opaque_hll_" + DataTypeTrait<T>::to_string();
+        helper.templates<int64_t, Opaque<ContainerT>, Nullable<T>>()
+            .init("approx_distinct_count_init" + suffix, ContainerT::Init)
+            .update("approx_distinct_count_update" + suffix,
+                    ContainerT::Update)
+            .merge("approx_distinct_count_merge" + suffix,
+                   reinterpret_cast<void*>(ContainerT::Merge))
+            .output("approx_distinct_count_output" + suffix,
+                    ContainerT::Output);
+    }
+};
+
+template <typename T>
+struct ApproxPercentileDef {
+    using ContainerT = udf::container::TDigest<T>;
+
+    void operator()(UdafRegistryHelper& helper) {  // NOLINT
+        std::string suffix =
+            ".opaque_tdigest_" + DataTypeTrait<T>::to_string();
+        helper.templates<double, Opaque<ContainerT>, Nullable<T>, double>()
+            .init("approx_percentile_init" + suffix, ContainerT::Init)
+            .update("approx_percentile_update" + suffix, ContainerT::Update)
+            .merge("approx_percentile_merge" + suffix,
+                   reinterpret_cast<void*>(ContainerT::Merge))
+            .output("approx_percentile_output" + suffix, ContainerT::Output);
+    }
+};
+
+void DefaultUdfLibrary::InitApproxUdafs() {
+    RegisterUdafTemplate<ApproxDistinctCountDef>("approx_distinct_count")
+        .doc(R"(
+            @brief Compute approximate number of distinct values with a
+            HyperLogLog sketch of fixed 4KB state, the standard error is
+            about 1.6%. Null values are ignored.
+
+            @param value  Specify value column to aggregate on.
+
+            Example:
+
+            |value|
+            |--|
+            |0|
+            |0|
+            |2|
+            |2|
+            |4|
+            @code{.sql}
+                SELECT approx_distinct_count(value) OVER w;
+                -- output 3
+            @endcode
+        )")
+        .args_in<bool, int16_t, int32_t, int64_t, float, double, Timestamp,
+                 Date, StringRef>();
+
+    RegisterUdafTemplate<ApproxPercentileDef>("approx_percentile")
+        .doc(R"(
+            @brief Compute approximate percentile of values with a t-digest
+            sketch of fixed size state. The result is interpolated between
+            the nearest values, the values are not summarized in the small
+            windows of less than about 60 rows. Null values are ignored,
+            output NaN if there is no value.
+
+            @param value  Specify value column to aggregate on.
+            @param percentage  Specify the percentage in [0, 1].
+
+            Example:
+
+            |value|
+            |--|
+            |1|
+            |2|
+            |3|
+            |4|
+            |5|
+            @code{.sql}
+                SELECT approx_percentile(value, 0.5) OVER w;
+                -- output 3.0
+            @endcode
+        )")
+        .args_in<int16_t, int32_t, int64_t, float, double>();
+}
+
+}  // namespace udf
+}  // namespace hybridse
@@ -43,8 +43,8 @@ struct AvgCateDef {
     template <typename V>
     struct Impl {
         using ContainerT =
-            udf::container::BoundedGroupByDict<K, V,
-                                               std::pair<int64_t, double>>;
+            udf::container::HashGroupByDict<K, V,
+                                            std::pair<int64_t, double>>;
         using InputK = typename ContainerT::InputK;
         using InputV = typename ContainerT::InputV;
 
@@ -63,19 +63,22 @@ struct AvgCateDef {
         static ContainerT* Update(ContainerT* ptr, InputV value,
                                   bool is_value_null, InputK key,
                                   bool is_key_null) {
+            return UpdateDict(ptr, value, is_value_null, key, is_key_null);
+        }
+
+        // shared by the bounded dict of top_n_key_avg_cate_where
+        template <typename DictT>
+        static DictT* UpdateDict(DictT* ptr, InputV value, bool is_value_null,
+                                 InputK key, bool is_key_null) {
             if (is_key_null || is_value_null) {
                 return ptr;
             }
-            auto& map = ptr->map();
-            auto stored_key = ContainerT::to_stored_key(key);
-            auto iter = map.find(stored_key);
-            if (iter == map.end()) {
-                map.insert(iter, {stored_key,
-                                  {1, ContainerT::to_stored_value(value)}});
-            } else {
-                auto& pair = iter->second;
-                pair.first += 1;
-                pair.second += ContainerT::to_stored_value(value);
+            auto stored_value = DictT::to_stored_value(value);
+            auto res =
+                ptr->Emplace(DictT::to_stored_key(key), {1, stored_value});
+            if (!res.second) {
+                res.first->first += 1;
+                res.first->second += stored_value;
             }
             return ptr;
         }
@@ -105,8 +108,8 @@ struct AvgCateWhereDef {
     template <typename V>
     struct Impl {
         using ContainerT =
-            udf::container::BoundedGroupByDict<K, V,
-                                               std::pair<int64_t, double>>;
+            udf::container::HashGroupByDict<K, V,
+                                            std::pair<int64_t, double>>;
         using InputK = typename ContainerT::InputK;
         using InputV = typename ContainerT::InputV;
 
@@ -185,8 +188,8 @@ struct TopKAvgCateWhereDef {
                                   bool is_cond_null, InputK key,
                                   bool is_key_null, int64_t bound) {
             if (cond && !is_cond_null) {
-                AvgCateImpl::Update(ptr, value, is_value_null, key,
-                                    is_key_null);
+                AvgCateImpl::UpdateDict(ptr, value, is_value_null, key,
+                                        is_key_null);
                 auto& map = ptr->map();
                 if (bound >= 0 && map.size() > static_cast<size_t>(bound)) {
                     map.erase(map.begin());
@@ -41,7 +41,7 @@ struct CountCateDef {
 
     template <typename V>
     struct Impl {
-        using ContainerT = udf::container::BoundedGroupByDict<K, V, int64_t>;
+        using ContainerT = udf::container::HashGroupByDict<K, V, int64_t>;
         using InputK = typename ContainerT::InputK;
         using InputV = typename ContainerT::InputV;
 
@@ -60,17 +60,19 @@ struct CountCateDef {
         static ContainerT* Update(ContainerT* ptr, InputV value,
                                   bool is_value_null, InputK key,
                                   bool is_key_null) {
+            return UpdateDict(ptr, value, is_value_null, key, is_key_null);
+        }
+
+        // shared by the bounded dict of top_n_key_count_cate_where
+        template <typename DictT>
+        static DictT* UpdateDict(DictT* ptr, InputV value, bool is_value_null,
+                                 InputK key, bool is_key_null) {
             if (is_key_null || is_value_null) {
                 return ptr;
             }
-            auto& map = ptr->map();
-            auto stored_key = ContainerT::to_stored_key(key);
-            auto iter = map.find(stored_key);
-            if (iter == map.end()) {
-                map.insert(iter, {stored_key, 1});
-            } else {
-                auto& single = iter->second;
-                single += 1;
+            auto res = ptr->Emplace(DictT::to_stored_key(key), 1);
+            if (!res.second) {
+                *res.first += 1;
             }
             return ptr;
         }
@@ -97,7 +99,7 @@ struct CountCateWhereDef {
 
     template <typename V>
     struct Impl {
-        using ContainerT = udf::container::BoundedGroupByDict<K, V, int64_t>;
+        using ContainerT = udf::container::HashGroupByDict<K, V, int64_t>;
         using InputK = typename ContainerT::InputK;
         using InputV = typename ContainerT::InputV;
 
@@ -176,8 +178,8 @@ struct TopKCountCateWhereDef {
                                   bool is_cond_null, InputK key,
                                   bool is_key_null, int64_t bound) {
             if (cond && !is_cond_null) {
-                AvgCateImpl::Update(ptr, value, is_value_null, key,
-                                    is_key_null);
+                AvgCateImpl::UpdateDict(ptr, value, is_value_null, key,
+                                        is_key_null);
                 auto& map = ptr->map();
                 if (bound >= 0 && map.size() > static_cast<size_t>(bound)) {
                     map.erase(map.begin());
@@ -41,7 +41,7 @@ struct MaxCateDef {
 
     template <typename V>
     struct Impl {
-        using ContainerT = udf::container::BoundedGroupByDict<K, V, V>;
+        using ContainerT = udf::container::HashGroupByDict<K, V, V>;
         using InputK = typename ContainerT::InputK;
         using InputV = typename ContainerT::InputV;
 
@@ -60,20 +60,20 @@ struct MaxCateDef {
         static ContainerT* Update(ContainerT* ptr, InputV value,
                                   bool is_value_null, InputK key,
                                   bool is_key_null) {
+            return UpdateDict(ptr, value, is_value_null, key, is_key_null);
+        }
+
+        // shared by the bounded dict of top_n_key_max_cate_where
+        template <typename DictT>
+        static DictT* UpdateDict(DictT* ptr, InputV value, bool is_value_null,
+                                 InputK key, bool is_key_null) {
             if (is_key_null || is_value_null) {
                 return ptr;
             }
-            auto& map = ptr->map();
-            auto stored_key = ContainerT::to_stored_key(key);
-            auto iter = map.find(stored_key);
-            if (iter == map.end()) {
-                map.insert(iter,
-                           {stored_key, ContainerT::to_stored_value(value)});
-            } else {
-                auto& single = iter->second;
-                if (single < ContainerT::to_stored_value(value)) {
-                    single = ContainerT::to_stored_value(value);
-                }
+            auto stored_value = DictT::to_stored_value(value);
+            auto res = ptr->Emplace(DictT::to_stored_key(key), stored_value);
+            if (!res.second && *res.first < stored_value) {
+                *res.first = stored_value;
             }
             return ptr;
         }
@@ -99,7 +99,7 @@ struct MaxCateWhereDef {
 
     template <typename V>
     struct Impl {
-        using ContainerT = udf::container::BoundedGroupByDict<K, V, V>;
+        using ContainerT = udf::container::HashGroupByDict<K, V, V>;
         using InputK = typename ContainerT::InputK;
         using InputV = typename ContainerT::InputV;
 
@@ -178,8 +178,8 @@ struct TopKMaxCateWhereDef {
                                   bool is_cond_null, InputK key,
                                   bool is_key_null, int64_t bound) {
             if (cond && !is_cond_null) {
-                AvgCateImpl::Update(ptr, value, is_value_null, key,
-                                    is_key_null);
+                AvgCateImpl::UpdateDict(ptr, value, is_value_null, key,
+                                        is_key_null);
                 auto& map = ptr->map();
                 if (bound >= 0 && map.size() > static_cast<size_t>(bound)) {
                     map.erase(map.begin());
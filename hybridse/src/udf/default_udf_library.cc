@@ -2051,6 +2051,7 @@ void DefaultUdfLibrary::InitUdaf() {
                  StringRef>();
 
     InitAggByCateUdafs();
+    InitApproxUdafs();
 }
 
 }  // namespace udf
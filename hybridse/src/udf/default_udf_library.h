@@ -36,6 +36,7 @@ class DefaultUdfLibrary : public UdfLibrary {
     void InitWindowFunctions();
     void InitUdaf();
     void InitAggByCateUdafs();
+    void InitApproxUdafs();
     void InitSumByCateUdafs();
     void InitCountByCateUdafs();
     void InitMinByCateUdafs();
@@ -0,0 +1,309 @@
+/*
+ * Copyright 2021 4Paradigm
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SRC_UDF_SKETCHES_H_
+#define SRC_UDF_SKETCHES_H_
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "base/fe_hash.h"
+#include "codec/type_codec.h"
+#include "udf/containers.h"
+
+namespace hybridse {
+namespace udf {
+namespace container {
+
+/**
+ * 64 bit hash of the stored value types for the sketches.
+ */
+template <typename T>
+struct SketchHashTrait {
+    static uint64_t hash(const T& t) {
+        // +0.0 and -0.0 are the same value
+        T value = t == 0 ? 0 : t;
+        return base::MurmurHash64A(&value, sizeof(T), codec::SEED);
+    }
+};
+
+template <>
+struct SketchHashTrait<codec::StringRef> {
+    static uint64_t hash(const codec::StringRef& t) {
+        return base::MurmurHash64A(t.data_, t.size_, codec::SEED);
+    }
+};
+
+template <>
+struct SketchHashTrait<codec::Date> {
+    static uint64_t hash(const codec::Date& t) {
+        return SketchHashTrait<int32_t>::hash(t.date_);
+    }
+};
+
+template <>
+struct SketchHashTrait<codec::Timestamp> {
+    static uint64_t hash(const codec::Timestamp& t) {
+        return SketchHashTrait<int64_t>::hash(t.ts_);
+    }
+};
+
+/**
+ * HyperLogLog sketch with 2^12 one byte registers, the standard error of the
+ * estimated distinct count is about 1.6%. Two sketches are merged by taking
+ * the max of each register.
+ */
+template <typename T>
+class HyperLogLog {
+ public:
+    // actual input argument type
+    using InputT = typename DataTypeTrait<T>::CCallArgType;
+
+    // actual stored type
+    using StorageT = typename ContainerStorageTypeTrait<T>::type;
+
+    // self type
+    using ContainerT = HyperLogLog<T>;
+
+    static const uint32_t PRECISION = 12;
+    static const uint32_t REGISTER_CNT = 1 << PRECISION;
+
+    static void Init(ContainerT* addr) { new (addr) ContainerT(); }
+
+    static ContainerT* Update(ContainerT* ptr, InputT t, bool is_null) {
+        if (!is_null) {
+            ptr->Add(SketchHashTrait<StorageT>::hash(
+                ContainerStorageTypeTrait<T>::to_stored_value(t)));
+        }
+        return ptr;
+    }
+
+    static ContainerT* Merge(ContainerT* ptr, ContainerT* other) {
+        for (uint32_t i = 0; i < REGISTER_CNT; ++i) {
+            ptr->registers_[i] =
+                std::max(ptr->registers_[i], other->registers_[i]);
+        }
+        return ptr;
+    }
+
+    static int64_t Output(ContainerT* ptr) {
+        return static_cast<int64_t>(std::llround(ptr->Estimate()));
+    }
+
+    void Add(uint64_t hash) {
+        uint32_t idx = hash >> (64 - PRECISION);
+        // the guard bit bounds the rank when the remaining bits are zero
+        uint64_t rest = (hash << PRECISION) | (1ULL << (PRECISION - 1));
+        uint8_t rank = __builtin_clzll(rest) + 1;
+        if (rank > registers_[idx]) {
+            registers_[idx] = rank;
+        }
+    }
+
+    double Estimate() const {
+        double sum = 0;
+        uint32_t zeros = 0;
+        for (uint32_t i = 0; i < REGISTER_CNT; ++i) {
+            sum += std::ldexp(1.0, -registers_[i]);
+            if (registers_[i] == 0) {
+                zeros += 1;
+            }
+        }
+        double m = REGISTER_CNT;
+        double estimate = 0.7213 / (1 + 1.079 / m) * m * m / sum;
+        // linear counting is more accurate for the small cardinality
+        if (estimate <= 2.5 * m && zeros > 0) {
+            estimate = m * std::log(m / zeros);
+        }
+        return estimate;
+    }
+
+ private:
+    uint8_t registers_[REGISTER_CNT] = {0};
+};
+
+/**
+ * Merging t-digest with the arcsine scale function. The values are buffered
+ * and compressed into at most about COMPRESSION centroids, the quantiles near
+ * 0 and 1 are more accurate than the median. The state is fixed size, two
+ * digests are merged by compressing their centroids together.
+ */
+template <typename T>
+class TDigest {
+ public:
+    // actual input argument type
+    using InputT = typename DataTypeTrait<T>::CCallArgType;
+
+    // self type
+    using ContainerT = TDigest<T>;
+
+    static const int32_t COMPRESSION = 100;
+    static const int32_t MAX_CENTROIDS = 2 * COMPRESSION;
+    static const int32_t BUFFER_SIZE = 4 * COMPRESSION;
+
+    static void Init(ContainerT* addr) { new (addr) ContainerT(); }
+
+    static ContainerT* Update(ContainerT* ptr, InputT t, bool is_null,
+                              double quantile) {
+        ptr->quantile_ = quantile;
+        if (!is_null) {
+            ptr->Add(static_cast<double>(t));
+        }
+        return ptr;
+    }
+
+    static ContainerT* Merge(ContainerT* ptr, ContainerT* other) {
+        other->Compress();
+        for (int32_t i = 0; i < other->centroid_cnt_; ++i) {
+            ptr->Add(other->centroids_[i].mean, other->centroids_[i].weight);
+        }
+        ptr->min_ = std::min(ptr->min_, other->min_);
+        ptr->max_ = std::max(ptr->max_, other->max_);
+        if (other->quantile_ >= 0) {
+            ptr->quantile_ = other->quantile_;
+        }
+        return ptr;
+    }
+
+    // NaN for the empty digest like avg
+    static double Output(ContainerT* ptr) {
+        return ptr->Quantile(ptr->quantile_);
+    }
+
+    void Add(double value, double weight = 1) {
+        if (std::isnan(value)) {
+            return;
+        }
+        if (buffer_cnt_ == BUFFER_SIZE) {
+            Compress();
+        }
+        buffer_[buffer_cnt_++] = {value, weight};
+        min_ = std::min(min_, value);
+        max_ = std::max(max_, value);
+    }
+
+    double Quantile(double q) {
+        Compress();
+        if (centroid_cnt_ == 0 || std::isnan(q)) {
+            return std::numeric_limits<double>::quiet_NaN();
+        }
+        if (q <= 0) {
+            return min_;
+        }
+        if (q >= 1) {
+            return max_;
+        }
+        const Centroid* c = centroids_;
+        double target = q * total_weight_;
+        // interpolate between the centers of the centroids, the halves of
+        // the first and the last centroids are between them and min/max
+        if (target < c[0].weight / 2) {
+            return Lerp(min_, c[0].mean, target / (c[0].weight / 2));
+        }
+        double center = c[0].weight / 2;
+        for (int32_t i = 1; i < centroid_cnt_; ++i) {
+            double next_center = center + (c[i - 1].weight + c[i].weight) / 2;
+            if (target < next_center) {
+                return Lerp(c[i - 1].mean, c[i].mean,
+                            (target - center) / (next_center - center));
+            }
+            center = next_center;
+        }
+        const Centroid& last = c[centroid_cnt_ - 1];
+        return Lerp(last.mean, max_, (target - center) / (last.weight / 2));
+    }
+
+ private:
+    struct Centroid {
+        double mean;
+        double weight;
+    };
+
+    static double Lerp(double a, double b, double t) {
+        return a + (b - a) * std::min(std::max(t, 0.0), 1.0);
+    }
+
+    // the scale function k(q) and its inverse
+    static double K(double q) {
+        return COMPRESSION / (2 * M_PI) * std::asin(2 * q - 1);
+    }
+    static double KInverse(double k) {
+        if (k >= COMPRESSION / 4.0) {
+            return 1;
+        }
+        return (std::sin(k * 2 * M_PI / COMPRESSION) + 1) / 2;
+    }
+
+    // merge the buffer into the centroids
+    void Compress() {
+        if (buffer_cnt_ == 0) {
+            return;
+        }
+        Centroid all[MAX_CENTROIDS + BUFFER_SIZE];
+        std::copy(centroids_, centroids_ + centroid_cnt_, all);
+        std::copy(buffer_, buffer_ + buffer_cnt_, all + centroid_cnt_);
+        int32_t cnt = centroid_cnt_ + buffer_cnt_;
+        std::sort(all, all + cnt, [](const Centroid& x, const Centroid& y) {
+            return x.mean < y.mean;
+        });
+        double total = total_weight_;
+        for (int32_t i = 0; i < buffer_cnt_; ++i) {
+            total += buffer_[i].weight;
+        }
+
+        // a centroid absorbs the next one while it spans less than one unit
+        // of k, adjacent output centroids span more than one unit together
+        centroid_cnt_ = 0;
+        Centroid cur = all[0];
+        double weight_so_far = 0;
+        double weight_limit = total * KInverse(K(0) + 1);
+        for (int32_t i = 1; i < cnt; ++i) {
+            if (weight_so_far + cur.weight + all[i].weight <= weight_limit) {
+                double weight = cur.weight + all[i].weight;
+                cur.mean += (all[i].mean - cur.mean) * all[i].weight / weight;
+                cur.weight = weight;
+            } else {
+                weight_so_far += cur.weight;
+                centroids_[centroid_cnt_++] = cur;
+                cur = all[i];
+                weight_limit =
+                    total * KInverse(K(weight_so_far / total) + 1);
+            }
+        }
+        centroids_[centroid_cnt_++] = cur;
+        total_weight_ = total;
+        buffer_cnt_ = 0;
+    }
+
+    Centroid centroids_[MAX_CENTROIDS];
+    Centroid buffer_[BUFFER_SIZE];
+    int32_t centroid_cnt_ = 0;
+    int32_t buffer_cnt_ = 0;
+    double total_weight_ = 0;
+    double min_ = std::numeric_limits<double>::infinity();
+    double max_ = -std::numeric_limits<double>::infinity();
+    // delayed to be set by update
+    double quantile_ = -1;
+};
+
+}  // namespace container
+}  // namespace udf
+}  // namespace hybridse
+
+#endif  // SRC_UDF_SKETCHES_H_
@@ -14,6 +14,10 @@
  * limitations under the License.
  */
 
+#include <memory>
+#include <vector>
+
+#include "udf/sketches.h"
 #include "udf/udf_test.h"
 
 namespace hybridse {
@@ -194,6 +198,122 @@ TEST_F(UdafTest, topk_test) {
         "top", StringRef(""), MakeList<int32_t>({}), MakeList<int32_t>({}));
 }
 
+TEST_F(UdafTest, approx_distinct_count_test) {
+    CheckUdf<int64_t, ListRef<int32_t>>(
+        "approx_distinct_count", 3, MakeList<int32_t>({0, 0, 2, 2, 4}));
+    CheckUdf<int64_t, ListRef<StringRef>>(
+        "approx_distinct_count", 2,
+        MakeList<StringRef>({StringRef("x"), StringRef("y"), StringRef("x")}));
+    // null values are ignored
+    CheckUdf<int64_t, ListRef<Nullable<int64_t>>>(
+        "approx_distinct_count", 2,
+        MakeList<Nullable<int64_t>>({1, nullptr, 3, nullptr, 1}));
+    // empty
+    CheckUdf<int64_t, ListRef<int32_t>>("approx_distinct_count", 0,
+                                        MakeList<int32_t>({}));
+}
+
+TEST_F(UdafTest, approx_percentile_test) {
+    CheckUdf<double, ListRef<int32_t>, ListRef<double>>(
+        "approx_percentile", 3.0, MakeList<int32_t>({5, 1, 4, 2, 3}),
+        MakeList<double>({0.5, 0.5, 0.5, 0.5, 0.5}));
+    CheckUdf<double, ListRef<double>, ListRef<double>>(
+        "approx_percentile", 1.0, MakeList<double>({5, 1, 4, 2, 3}),
+        MakeList<double>({0, 0, 0, 0, 0}));
+    CheckUdf<double, ListRef<double>, ListRef<double>>(
+        "approx_percentile", 5.0, MakeList<double>({5, 1, 4, 2, 3}),
+        MakeList<double>({1, 1, 1, 1, 1}));
+    // null values are ignored
+    CheckUdf<double, ListRef<Nullable<int64_t>>, ListRef<double>>(
+        "approx_percentile", 2.0,
+        MakeList<Nullable<int64_t>>({1, nullptr, 2, nullptr, 3}),
+        MakeList<double>({0.5, 0.5, 0.5, 0.5, 0.5}));
+    // empty
+    CheckUdf<double, ListRef<int32_t>, ListRef<double>>(
+        "approx_percentile", 0.0 / 0, MakeList<int32_t>({}),
+        MakeList<double>({}));
+}
+
+TEST_F(UdafTest, approx_distinct_count_merge_test) {
+    using HLL = container::HyperLogLog<int32_t>;
+    // the partial states overlap on [4000, 6000)
+    auto single = std::make_unique<HLL>();
+    auto left = std::make_unique<HLL>();
+    auto right = std::make_unique<HLL>();
+    for (int32_t i = 0; i < 10000; ++i) {
+        HLL::Update(single.get(), i, false);
+        if (i < 6000) {
+            HLL::Update(left.get(), i, false);
+        }
+        if (i >= 4000) {
+            HLL::Update(right.get(), i, false);
+        }
+    }
+    int64_t expect = HLL::Output(single.get());
+    ASSERT_NEAR(10000, expect, 10000 * 0.05);
+
+    // the registers of the merged state are the ones of a single pass
+    auto merged = std::make_unique<HLL>();
+    HLL::Merge(merged.get(), left.get());
+    ASSERT_EQ(HLL::Output(left.get()), HLL::Output(merged.get()));
+    HLL::Merge(merged.get(), right.get());
+    ASSERT_EQ(expect, HLL::Output(merged.get()));
+
+    // merging an empty state changes nothing
+    auto empty = std::make_unique<HLL>();
+    HLL::Merge(left.get(), empty.get());
+    HLL::Merge(left.get(), right.get());
+    ASSERT_EQ(expect, HLL::Output(left.get()));
+    ASSERT_EQ(0, HLL::Output(empty.get()));
+}
+
+TEST_F(UdafTest, approx_percentile_merge_test) {
+    using Digest = container::TDigest<double>;
+    // the values of the parts interleave, so each part covers the whole range
+    const int32_t parts = 4;
+    auto single = std::make_unique<Digest>();
+    std::vector<std::unique_ptr<Digest>> partials;
+    for (int32_t i = 0; i < parts; ++i) {
+        partials.push_back(std::make_unique<Digest>());
+    }
+    for (int32_t i = 1; i <= 10000; ++i) {
+        Digest::Update(single.get(), i, false, 0.5);
+        Digest::Update(partials[i % parts].get(), i, false, 0.5);
+    }
+    auto merged = std::make_unique<Digest>();
+    for (auto& partial : partials) {
+        Digest::Merge(merged.get(), partial.get());
+    }
+    ASSERT_NEAR(Digest::Output(single.get()), Digest::Output(merged.get()), 10000 * 0.01);
+    for (double q : {0.01, 0.1, 0.25, 0.75, 0.9, 0.99}) {
+        ASSERT_NEAR(single->Quantile(q), merged->Quantile(q), 10000 * 0.01) << "quantile " << q;
+    }
+    ASSERT_DOUBLE_EQ(1, merged->Quantile(0));
+    ASSERT_DOUBLE_EQ(10000, merged->Quantile(1));
+
+    // merged into an empty state and merging an empty state
+    auto empty = std::make_unique<Digest>();
+    auto from_empty = std::make_unique<Digest>();
+    Digest::Merge(from_empty.get(), single.get());
+    Digest::Merge(from_empty.get(), empty.get());
+    ASSERT_DOUBLE_EQ(Digest::Output(single.get()), Digest::Output(from_empty.get()));
+    ASSERT_TRUE(std::isnan(Digest::Output(empty.get())));
+
+    // the values still buffered in the partial states are merged too
+    auto small_left = std::make_unique<Digest>();
+    auto small_right = std::make_unique<Digest>();
+    for (int32_t i = 1; i <= 50; ++i) {
+        Digest::Update(small_left.get(), i, false, 0.5);
+        Digest::Update(small_right.get(), i + 50, false, 0.5);
+    }
+    auto small_merged = std::make_unique<Digest>();
+    Digest::Merge(small_merged.get(), small_left.get());
+    Digest::Merge(small_merged.get(), small_right.get());
+    ASSERT_DOUBLE_EQ(1, small_merged->Quantile(0));
+    ASSERT_DOUBLE_EQ(100, small_merged->Quantile(1));
+    ASSERT_NEAR(50.5, Digest::Output(small_merged.get()), 1);
+}
+
 TEST_F(UdafTest, sum_cate_test) {
     CheckUdf<StringRef, ListRef<int32_t>, ListRef<int32_t>>(
         "sum_cate", StringRef("1:4,2:6"), MakeList<int32_t>({1, 2, 3, 4}),
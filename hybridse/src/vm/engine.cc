@@ -15,6 +15,7 @@
  */
 
 #include "vm/engine.h"
+#include <chrono>  // NOLINT
 #include <string>
 #include <utility>
 #include <vector>
@@ -50,7 +51,10 @@ EngineOptions::EngineOptions()
       enable_expr_optimize_(true),
       enable_batch_window_parallelization_(false),
       max_sql_cache_size_(50),
-      enable_spark_unsaferow_format_(false) {
+      enable_spark_unsaferow_format_(false),
+      enable_tiered_compile_(false),
+      tiered_compile_hits_(100),
+      tiered_compile_rows_(10000) {
     // TODO(chendihao): Pass the parameter to avoid global gflag
     FLAGS_enable_spark_unsaferow_format = enable_spark_unsaferow_format_;
 }
@@ -61,10 +65,33 @@ EngineOptions* EngineOptions::set_enable_spark_unsaferow_format(bool flag) {
     return this;
 }
 
-Engine::Engine(const std::shared_ptr<Catalog>& catalog) : cl_(catalog), options_(), mu_(), lru_cache_() {}
+static uint64_t NowMicros() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+// the interval the engine checks the runs of the tiered queries in progress
+static const std::chrono::milliseconds kTieredCheckInterval(10);
+
+Engine::Engine(const std::shared_ptr<Catalog>& catalog)
+    : cl_(catalog), options_(), mu_(), lru_cache_(), tiered_stop_(false) {}
 Engine::Engine(const std::shared_ptr<Catalog>& catalog, const EngineOptions& options)
-    : cl_(catalog), options_(options), mu_(), lru_cache_() {}
-Engine::~Engine() {}
+    : cl_(catalog), options_(options), mu_(), lru_cache_(), tiered_stop_(false) {
+    if (options_.is_enable_tiered_compile()) {
+        tiered_thread_ = std::thread(&Engine::RunTieredCompile, this);
+    }
+}
+Engine::~Engine() {
+    {
+        std::lock_guard<std::mutex> lock(tiered_mu_);
+        tiered_stop_ = true;
+    }
+    tiered_cv_.notify_all();
+    if (tiered_thread_.joinable()) {
+        tiered_thread_.join();
+    }
+}
 void Engine::InitializeGlobalLLVM() {
     if (LLVM_IS_INITIALIZED) return;
     LLVMInitializeNativeTarget();
@@ -182,7 +209,7 @@ bool Engine::Get(const std::string& sql, const std::string& db, RunSession& sess
                  base::Status& status) {  // NOLINT (runtime/references)
     std::shared_ptr<CompileInfo> cached_info = GetCacheLocked(db, sql, session.engine_mode());
     if (cached_info && IsCompatibleCache(session, cached_info, status)) {
-        session.SetCompileInfo(cached_info);
+        session.SetCompileInfo(HitTieredCache(db, sql, cached_info));
         return true;
     }
     // TODO(baoxinqi): IsCompatibleCache fail, return false, or reset status.
@@ -194,37 +221,27 @@ bool Engine::Get(const std::string& sql, const std::string& db, RunSession& sess
     status = base::Status::OK();
     std::shared_ptr<SqlCompileInfo> info = std::make_shared<SqlCompileInfo>();
     auto& sql_context = std::dynamic_pointer_cast<SqlCompileInfo>(info)->get_sql_context();
-    sql_context.sql = sql;
-    sql_context.db = db;
-    sql_context.engine_mode = session.engine_mode();
-    sql_context.is_performance_sensitive = options_.is_performance_sensitive();
-    sql_context.is_cluster_optimized = options_.is_cluster_optimzied();
-    sql_context.is_batch_request_optimized = options_.is_batch_request_optimized();
-    sql_context.enable_batch_window_parallelization = options_.is_enable_batch_window_parallelization();
-    sql_context.enable_expr_optimize = options_.is_enable_expr_optimize();
-    sql_context.jit_options = options_.jit_options();
+    InitSqlContext(sql, db, session.engine_mode(), &sql_context);
+    sql_context.is_tiered = options_.is_enable_tiered_compile() && !options_.is_plan_only();
+    sql_context.catalog = std::atomic_load_explicit(&cl_, std::memory_order_acquire);
     if (session.engine_mode() == kBatchMode) {
         sql_context.parameter_types = dynamic_cast<BatchRunSession*>(&session)->GetParameterSchema();
     } else if (session.engine_mode() == kBatchRequestMode) {
         auto batch_req_sess = dynamic_cast<BatchRequestRunSession*>(&session);
         sql_context.batch_request_info.common_column_indices = batch_req_sess->common_column_indices();
     }
-
-    SqlCompiler compiler(std::atomic_load_explicit(&cl_, std::memory_order_acquire), options_.is_keep_ir(), false,
-                         options_.is_plan_only());
-    bool ok = compiler.Compile(info->get_sql_context(), status);
-    if (!ok || 0 != status.code) {
+    if (!Compile(info, status)) {
         return false;
     }
-    if (!options_.is_compile_only()) {
-        ok = compiler.BuildClusterJob(info->get_sql_context(), status);
-        if (!ok || 0 != status.code) {
-            LOG(WARNING) << "fail to build cluster job: " << status.msg;
-            return false;
-        }
-    }
 
     SetCacheLocked(db, sql, session.engine_mode(), info);
+    if (sql_context.is_tiered) {
+        {
+            std::lock_guard<std::mutex> lock(tiered_mu_);
+            tiered_watches_.push_back({db, sql, info});
+        }
+        tiered_cv_.notify_one();
+    }
     session.SetCompileInfo(info);
     if (session.is_debug_) {
         std::ostringstream plan_oss;
@@ -239,6 +256,161 @@ bool Engine::Get(const std::string& sql, const std::string& db, RunSession& sess
     return true;
 }
 
+void Engine::InitSqlContext(const std::string& sql, const std::string& db, EngineMode engine_mode,
+                            SqlContext* ctx) {
+    ctx->sql = sql;
+    ctx->db = db;
+    ctx->engine_mode = engine_mode;
+    ctx->is_performance_sensitive = options_.is_performance_sensitive();
+    ctx->is_cluster_optimized = options_.is_cluster_optimzied();
+    ctx->is_batch_request_optimized = options_.is_batch_request_optimized();
+    ctx->enable_batch_window_parallelization = options_.is_enable_batch_window_parallelization();
+    ctx->enable_expr_optimize = options_.is_enable_expr_optimize();
+    ctx->jit_options = options_.jit_options();
+}
+
+bool Engine::Compile(const std::shared_ptr<SqlCompileInfo>& info, base::Status& status) {
+    uint64_t start = NowMicros();
+    SqlCompiler compiler(info->get_sql_context().catalog, options_.is_keep_ir(), false, options_.is_plan_only());
+    bool ok = compiler.Compile(info->get_sql_context(), status);
+    if (!ok || 0 != status.code) {
+        return false;
+    }
+    if (!options_.is_compile_only()) {
+        ok = compiler.BuildClusterJob(info->get_sql_context(), status);
+        if (!ok || 0 != status.code) {
+            LOG(WARNING) << "fail to build cluster job: " << status.msg;
+            return false;
+        }
+    }
+    info->get_sql_context().compile_time_us.store(NowMicros() - start, std::memory_order_relaxed);
+    return true;
+}
+
+std::shared_ptr<CompileInfo> Engine::HitTieredCache(const std::string& db, const std::string& sql,
+                                                    const std::shared_ptr<CompileInfo>& info) {
+    auto& ctx = std::dynamic_pointer_cast<SqlCompileInfo>(info)->get_sql_context();
+    if (!ctx.is_tiered) {
+        return info;
+    }
+    auto optimized_info = std::atomic_load_explicit(&ctx.optimized_info, std::memory_order_acquire);
+    if (optimized_info) {
+        return optimized_info;
+    }
+    ctx.hit_cnt.fetch_add(1, std::memory_order_relaxed);
+    if (!IsTieredHot(ctx)) {
+        return info;
+    }
+    if (!ctx.is_recompiling.exchange(true, std::memory_order_relaxed)) {
+        {
+            std::lock_guard<std::mutex> lock(tiered_mu_);
+            tiered_tasks_.push_back({db, sql, info});
+        }
+        tiered_cv_.notify_one();
+    }
+    return info;
+}
+
+bool Engine::IsTieredHot(const SqlContext& ctx) const {
+    if (ctx.hit_cnt.load(std::memory_order_relaxed) >= options_.tiered_compile_hits() ||
+        ctx.run_rows.load(std::memory_order_relaxed) >= options_.tiered_compile_rows()) {
+        return true;
+    }
+    // a run in progress counts too, so a single long run gets the query recompiled
+    uint64_t run_time_us = ctx.run_time_us.load(std::memory_order_relaxed);
+    uint64_t run_start_us = ctx.run_start_us.load(std::memory_order_relaxed);
+    if (run_start_us > 0) {
+        uint64_t now = NowMicros();
+        run_time_us += now > run_start_us ? now - run_start_us : 0;
+    }
+    return run_time_us >= ctx.compile_time_us.load(std::memory_order_relaxed);
+}
+
+void Engine::CheckTieredRunsLocked() {
+    for (auto it = tiered_watches_.begin(); it != tiered_watches_.end();) {
+        auto info = it->info.lock();
+        if (!info) {
+            it = tiered_watches_.erase(it);
+            continue;
+        }
+        auto& ctx = std::dynamic_pointer_cast<SqlCompileInfo>(info)->get_sql_context();
+        if (ctx.is_recompiling.load(std::memory_order_relaxed)) {
+            it = tiered_watches_.erase(it);
+            continue;
+        }
+        if (IsTieredHot(ctx) && !ctx.is_recompiling.exchange(true, std::memory_order_relaxed)) {
+            tiered_tasks_.push_back({it->db, it->sql, info});
+            it = tiered_watches_.erase(it);
+            continue;
+        }
+        ++it;
+    }
+}
+
+void Engine::RunTieredCompile() {
+    while (true) {
+        TieredCompileTask task;
+        {
+            std::unique_lock<std::mutex> lock(tiered_mu_);
+            while (!tiered_stop_ && tiered_tasks_.empty()) {
+                if (tiered_watches_.empty()) {
+                    tiered_cv_.wait(lock);
+                } else {
+                    // the runs update the statistics without notifying, so they are checked periodically
+                    tiered_cv_.wait_for(lock, kTieredCheckInterval);
+                    CheckTieredRunsLocked();
+                }
+            }
+            if (tiered_stop_) {
+                return;
+            }
+            task = std::move(tiered_tasks_.front());
+            tiered_tasks_.pop_front();
+        }
+        auto& tiered_ctx = std::dynamic_pointer_cast<SqlCompileInfo>(task.info)->get_sql_context();
+        auto info = std::make_shared<SqlCompileInfo>();
+        auto& ctx = info->get_sql_context();
+        InitSqlContext(task.sql, task.db, tiered_ctx.engine_mode, &ctx);
+        // the tables are resolved on the catalog of the tiered one, the catalog of the engine may be updated since
+        ctx.catalog = tiered_ctx.catalog;
+        ctx.parameter_types = tiered_ctx.parameter_types;
+        ctx.batch_request_info.common_column_indices = tiered_ctx.batch_request_info.common_column_indices;
+        base::Status status;
+        if (!Compile(info, status)) {
+            LOG(WARNING) << "fail to recompile tiered sql " << task.sql << ": " << status;
+            continue;
+        }
+        // a catalog may change its tables in place, the sessions can't switch to code with other schemas
+        if (ctx.encoded_schema != tiered_ctx.encoded_schema ||
+            ctx.encoded_request_schema != tiered_ctx.encoded_request_schema) {
+            LOG(WARNING) << "the schema of tiered sql changes on recompiling, keep the unoptimized one: " << task.sql;
+            continue;
+        }
+        // the later sessions of the sql get the optimized one through the cached one
+        std::atomic_store_explicit(&tiered_ctx.optimized_info, std::shared_ptr<CompileInfo>(info),
+                                   std::memory_order_release);
+        DLOG(INFO) << "recompile tiered sql in " << ctx.compile_time_us.load() << "us, which ran "
+                   << tiered_ctx.run_cnt.load() << " times in " << tiered_ctx.run_time_us.load() << "us: " << task.sql;
+    }
+}
+
+bool Engine::GetQueryStats(const std::string& sql, const std::string& db, EngineMode engine_mode,
+                           QueryStats* stats) {
+    std::shared_ptr<CompileInfo> info = GetCacheLocked(db, sql, engine_mode);
+    if (!info || stats == nullptr) {
+        return false;
+    }
+    auto& tiered_ctx = std::dynamic_pointer_cast<SqlCompileInfo>(info)->get_sql_context();
+    auto optimized_info = std::atomic_load_explicit(&tiered_ctx.optimized_info, std::memory_order_acquire);
+    auto& ctx = optimized_info ? std::dynamic_pointer_cast<SqlCompileInfo>(optimized_info)->get_sql_context()
+                               : tiered_ctx;
+    stats->compile_time_us = ctx.compile_time_us.load(std::memory_order_relaxed);
+    stats->run_time_us = ctx.run_time_us.load(std::memory_order_relaxed);
+    stats->run_cnt = ctx.run_cnt.load(std::memory_order_relaxed);
+    stats->optimized = !ctx.is_tiered;
+    return true;
+}
+
 bool Engine::Explain(const std::string& sql, const std::string& db, EngineMode engine_mode,
                      const codec::Schema& parameter_schema,
                      const std::set<size_t>& common_column_indices, ExplainOutput* explain_output,
@@ -373,11 +545,46 @@ bool Engine::SetCacheLocked(const std::string& db, const std::string& sql, Engin
     }
 }
 
-RunSession::RunSession(EngineMode engine_mode) : engine_mode_(engine_mode), is_debug_(false), sp_name_("") {}
+// RunTimer adds the time and the rows of a run to the statistics of a tiered
+// compiled sql, it does nothing if ctx is null. The start of the run is
+// published while it's in progress, so the engine sees a long run before it
+// ends
+class RunTimer {
+ public:
+    explicit RunTimer(SqlContext* ctx) : ctx_(ctx), start_(ctx ? NowMicros() : 0), rows_(0), publish_(false) {
+        if (ctx_ != nullptr) {
+            // one run is published at a time, the concurrent ones are counted once they end
+            uint64_t expect = 0;
+            publish_ = ctx_->run_start_us.compare_exchange_strong(expect, start_, std::memory_order_relaxed);
+        }
+    }
+    ~RunTimer() {
+        if (ctx_ != nullptr) {
+            ctx_->run_time_us.fetch_add(NowMicros() - start_, std::memory_order_relaxed);
+            ctx_->run_cnt.fetch_add(1, std::memory_order_relaxed);
+            ctx_->run_rows.fetch_add(rows_, std::memory_order_relaxed);
+            if (publish_) {
+                ctx_->run_start_us.store(0, std::memory_order_relaxed);
+            }
+        }
+    }
+    void SetRows(uint64_t rows) { rows_ = rows; }
+
+ private:
+    SqlContext* ctx_;
+    uint64_t start_;
+    uint64_t rows_;
+    bool publish_;
+};
+
+RunSession::RunSession(EngineMode engine_mode)
+    : tiered_ctx_(nullptr), engine_mode_(engine_mode), is_debug_(false), sp_name_("") {}
 RunSession::~RunSession() {}
 
 bool RunSession::SetCompileInfo(const std::shared_ptr<CompileInfo>& compile_info) {
     compile_info_ = compile_info;
+    auto sql_info = std::dynamic_pointer_cast<SqlCompileInfo>(compile_info);
+    tiered_ctx_ = sql_info && sql_info->get_sql_context().is_tiered ? &sql_info->get_sql_context() : nullptr;
     return true;
 }
 
@@ -387,6 +594,8 @@ int32_t RequestRunSession::Run(const Row& in_row, Row* out_row) {
                in_row, out_row);
 }
 int32_t RequestRunSession::Run(const uint32_t task_id, const Row& in_row, Row* out_row) {
+    RunTimer timer(tiered_ctx_);
+    timer.SetRows(1);
     auto task = std::dynamic_pointer_cast<SqlCompileInfo>(compile_info_)
                     ->get_sql_context()
                     .cluster_job.GetTask(task_id)
@@ -416,6 +625,8 @@ int32_t BatchRequestRunSession::Run(const std::vector<Row>& request_batch, std::
 }
 int32_t BatchRequestRunSession::Run(const uint32_t id, const std::vector<Row>& request_batch,
                                     std::vector<Row>& output) {
+    RunTimer timer(tiered_ctx_);
+    timer.SetRows(request_batch.size());
     RunnerContext ctx(&std::dynamic_pointer_cast<SqlCompileInfo>(compile_info_)->get_sql_context().cluster_job,
                       request_batch, sp_name_, is_debug_);
     auto task =
@@ -440,6 +651,7 @@ int32_t BatchRunSession::Run(std::vector<Row>& rows, uint64_t limit) {
     return Run(Row(), rows, limit);
 }
 int32_t BatchRunSession::Run(const Row& parameter_row, std::vector<Row>& rows, uint64_t limit) {
+    RunTimer timer(tiered_ctx_);
     auto& sql_ctx = std::dynamic_pointer_cast<SqlCompileInfo>(compile_info_)->get_sql_context();
     RunnerContext ctx(&sql_ctx.cluster_job, parameter_row, is_debug_);
     auto output = sql_ctx.cluster_job.GetTask(0).GetRoot()->RunWithCache(ctx);
@@ -454,14 +666,18 @@ int32_t BatchRunSession::Run(const Row& parameter_row, std::vector<Row>& rows, u
                 return 0;
             }
             iter->SeekToFirst();
+            uint64_t cnt = 0;
             while (iter->Valid()) {
                 rows.push_back(iter->GetValue());
                 iter->Next();
+                cnt++;
             }
+            timer.SetRows(cnt);
             return 0;
         }
         case kRowHandler: {
             rows.push_back(std::dynamic_pointer_cast<RowHandler>(output)->GetValue());
+            timer.SetRows(1);
             return 0;
         }
         case kPartitionHandler: {
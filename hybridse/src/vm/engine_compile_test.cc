@@ -14,6 +14,9 @@
  * limitations under the License.
  */
 
+#include <chrono>  // NOLINT
+#include <thread>  // NOLINT
+#include <vector>
 #include "case/case_data_mock.h"
 #include "gtest/gtest.h"
 #include "gtest/internal/gtest-param-util.h"
@@ -82,6 +85,126 @@ TEST_F(EngineCompileTest, EngineLRUCacheTest) {
     }
 }
 
+TEST_F(EngineCompileTest, EngineTieredCompileTest) {
+    auto catalog = BuildSimpleCatalog();
+    hybridse::type::Database db;
+    db.set_name("simple_db");
+    hybridse::type::TableDef table_def;
+    sqlcase::CaseSchemaMock::BuildTableDef(table_def);
+    table_def.set_name("t1");
+    AddTable(db, table_def);
+    catalog->AddDatabase(db);
+
+    EngineOptions options;
+    options.set_enable_tiered_compile(true);
+    options.set_tiered_compile_hits(1);
+    Engine engine(catalog, options);
+    std::string sql = "select col1, col2 + 1 as col2 from t1;";
+    base::Status get_status;
+    BatchRunSession cold_session;
+    ASSERT_TRUE(engine.Get(sql, "simple_db", cold_session, get_status)) << get_status;
+    std::vector<Row> output;
+    ASSERT_EQ(0, cold_session.Run(output));
+    QueryStats stats;
+    ASSERT_TRUE(engine.GetQueryStats(sql, "simple_db", kBatchMode, &stats));
+    ASSERT_FALSE(stats.optimized);
+    ASSERT_GT(stats.compile_time_us, 0u);
+    ASSERT_EQ(1u, stats.run_cnt);
+
+    // the repeated sql is recompiled in the background
+    BatchRunSession session;
+    ASSERT_TRUE(engine.Get(sql, "simple_db", session, get_status)) << get_status;
+    for (int i = 0; i < 1000 && session.GetCompileInfo() == cold_session.GetCompileInfo(); i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        ASSERT_TRUE(engine.Get(sql, "simple_db", session, get_status)) << get_status;
+    }
+    ASSERT_NE(session.GetCompileInfo(), cold_session.GetCompileInfo());
+    ASSERT_EQ(0, session.Run(output));
+    ASSERT_TRUE(engine.GetQueryStats(sql, "simple_db", kBatchMode, &stats));
+    ASSERT_TRUE(stats.optimized);
+    // the runs of the optimized code are not timed
+    ASSERT_EQ(0u, stats.run_cnt);
+    // the sessions got before keep running the unoptimized code
+    ASSERT_EQ(0, cold_session.Run(output));
+}
+
+TEST_F(EngineCompileTest, EngineTieredCompileOnRunTest) {
+    auto catalog = BuildSimpleCatalog();
+    hybridse::type::Database db;
+    db.set_name("simple_db");
+    hybridse::type::TableDef table_def;
+    std::vector<Row> rows;
+    CaseDataMock::BuildOnePkTableData(table_def, rows, 100);
+    table_def.set_name("t1");
+    AddTable(db, table_def);
+    catalog->AddDatabase(db);
+    ASSERT_TRUE(catalog->InsertRows("simple_db", "t1", rows));
+
+    EngineOptions options;
+    options.set_enable_tiered_compile(true);
+    options.set_tiered_compile_rows(100);
+    Engine engine(catalog, options);
+    std::string sql = "select col1, col2 + 1 as col2 from t1;";
+    base::Status get_status;
+    BatchRunSession session;
+    ASSERT_TRUE(engine.Get(sql, "simple_db", session, get_status)) << get_status;
+    std::vector<Row> output;
+    ASSERT_EQ(0, session.Run(output));
+    ASSERT_EQ(100u, output.size());
+
+    // the run processes enough rows, the sql is recompiled without being got from the cache again
+    QueryStats stats;
+    for (int i = 0; i < 1000; i++) {
+        ASSERT_TRUE(engine.GetQueryStats(sql, "simple_db", kBatchMode, &stats));
+        if (stats.optimized) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ASSERT_TRUE(stats.optimized);
+    BatchRunSession hot_session;
+    ASSERT_TRUE(engine.Get(sql, "simple_db", hot_session, get_status)) << get_status;
+    ASSERT_NE(session.GetCompileInfo(), hot_session.GetCompileInfo());
+}
+
+TEST_F(EngineCompileTest, EngineTieredCompileOnCatalogTest) {
+    auto build_catalog = [](hybridse::type::Type col2_type) {
+        auto catalog = BuildSimpleCatalog();
+        hybridse::type::Database db;
+        db.set_name("simple_db");
+        hybridse::type::TableDef table_def;
+        sqlcase::CaseSchemaMock::BuildTableDef(table_def);
+        table_def.set_name("t1");
+        table_def.mutable_columns(2)->set_type(col2_type);
+        AddTable(db, table_def);
+        catalog->AddDatabase(db);
+        return catalog;
+    };
+    EngineOptions options;
+    options.set_enable_tiered_compile(true);
+    options.set_tiered_compile_hits(1);
+    Engine engine(build_catalog(hybridse::type::kInt16), options);
+    std::string sql = "select col1, col2 + 1 as col2 from t1;";
+    base::Status get_status;
+    BatchRunSession cold_session;
+    ASSERT_TRUE(engine.Get(sql, "simple_db", cold_session, get_status)) << get_status;
+
+    // the catalog of the engine is updated before the sql gets hot, the recompiling resolves the table on the
+    // catalog of the tiered one
+    engine.UpdateCatalog(build_catalog(hybridse::type::kDouble));
+    BatchRunSession session;
+    ASSERT_TRUE(engine.Get(sql, "simple_db", session, get_status)) << get_status;
+    for (int i = 0; i < 1000 && session.GetCompileInfo() == cold_session.GetCompileInfo(); i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        ASSERT_TRUE(engine.Get(sql, "simple_db", session, get_status)) << get_status;
+    }
+    ASSERT_NE(session.GetCompileInfo(), cold_session.GetCompileInfo());
+    ASSERT_EQ(cold_session.GetEncodedSchema(), session.GetEncodedSchema());
+    QueryStats stats;
+    ASSERT_TRUE(engine.GetQueryStats(sql, "simple_db", kBatchMode, &stats));
+    ASSERT_TRUE(stats.optimized);
+}
+
 TEST_F(EngineCompileTest, EngineWithParameterizedLRUCacheTest) {
     // Build Simple Catalog
     auto catalog = BuildSimpleCatalog();
@@ -15,6 +15,7 @@
  */
 
 #include "vm/jit.h"
+#include <sstream>
 #include <string>
 #include <utility>
 extern "C" {
@@ -22,6 +23,9 @@ extern "C" {
 #include <cstdlib>
 }
 #include "glog/logging.h"
+#include "hybridse_version.h"  // NOLINT
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
 #include "llvm/ExecutionEngine/JITEventListener.h"
 #include "llvm/ExecutionEngine/JITSymbol.h"
 #include "llvm/ExecutionEngine/Orc/CompileUtils.h"
@@ -36,6 +40,9 @@ extern "C" {
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/LegacyPassManager.h"
 #include "llvm/IR/Verifier.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/SHA1.h"
 #include "llvm/Transforms/InstCombine/InstCombine.h"
 #include "llvm/Transforms/Scalar.h"
 #include "llvm/Transforms/Scalar/GVN.h"
@@ -120,15 +127,60 @@ bool HybridSeJit::AddSymbol(const std::string& name, void* fn_ptr) {
 
 void HybridSeJit::Init() {
     auto& jd = getMainJITDylib();
+    char global_prefix = getDataLayout().getGlobalPrefix();
     auto gen = llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(
-        getDataLayout().getGlobalPrefix());
+        global_prefix);
     auto err = gen.takeError();
     if (err) {
         LOG(WARNING) << "Create process sym failed";
         ::llvm::errs() << err;
         return;
     }
-    jd.setGenerator(gen.get());
+    // only the shared symbols referred by the modules are defined
+    auto process_gen = std::move(gen.get());
+    jd.setGenerator([this, global_prefix, process_gen](
+                        ::llvm::orc::JITDylib& parent,
+                        const ::llvm::orc::SymbolNameSet& names) mutable
+                    -> ::llvm::Expected<::llvm::orc::SymbolNameSet> {
+        ::llvm::orc::SymbolNameSet added;
+        ::llvm::orc::SymbolNameSet missing;
+        ::llvm::orc::SymbolMap symbol_map;
+        for (auto& name : names) {
+            ::llvm::StringRef symbol = *name;
+            if (global_prefix != '\0' && !symbol.empty() &&
+                symbol.front() == global_prefix) {
+                symbol = symbol.drop_front();
+            }
+            if (shared_symbols_ != nullptr) {
+                auto it = shared_symbols_->find(symbol.str());
+                if (it != shared_symbols_->end()) {
+                    symbol_map[name] = ::llvm::JITEvaluatedSymbol(
+                        ::llvm::pointerToJITTargetAddress(it->second),
+                        ::llvm::JITSymbolFlags());
+                    added.insert(name);
+                    continue;
+                }
+            }
+            missing.insert(name);
+        }
+        if (!symbol_map.empty()) {
+            if (auto err = parent.define(
+                    ::llvm::orc::absoluteSymbols(std::move(symbol_map)))) {
+                return std::move(err);
+            }
+        }
+        if (missing.empty()) {
+            return added;
+        }
+        auto found = process_gen(parent, missing);
+        if (!found) {
+            return found.takeError();
+        }
+        for (auto& name : *found) {
+            added.insert(name);
+        }
+        return added;
+    });
 }
 
 bool HybridSeJit::AddSymbol(::llvm::orc::JITDylib& jd,
@@ -148,10 +200,131 @@ bool HybridSeJit::AddSymbol(::llvm::orc::JITDylib& jd,
     }
 }
 
+static const char MODULE_KEY_PREFIX[] = "hybridse_obj_";
+
+bool HybridSeObjectCache::Init() {
+    std::error_code ec = ::llvm::sys::fs::create_directories(dir_);
+    if (ec) {
+        LOG(WARNING) << "fail to create object cache dir " << dir_ << ": "
+                     << ec.message();
+        return false;
+    }
+    return true;
+}
+
+std::string HybridSeObjectCache::GetModuleKey(const ::llvm::Module& m) {
+    std::ostringstream version;
+    version << HYBRIDSE_VERSION_MAJOR << "." << HYBRIDSE_VERSION_MINOR << "."
+            << HYBRIDSE_VERSION_BUG << ";" << ::llvm::sys::getProcessTriple()
+            << ";" << ::llvm::sys::getHostCPUName().str() << ";";
+    ::llvm::SHA1 sha1;
+    sha1.update(version.str());
+    sha1.update(LlvmToString(m));
+    return MODULE_KEY_PREFIX + ::llvm::toHex(sha1.final(), true);
+}
+
+bool HybridSeObjectCache::GetPath(const ::llvm::Module* m,
+                                  std::string* path) const {
+    const std::string& key = m->getModuleIdentifier();
+    if (key.compare(0, sizeof(MODULE_KEY_PREFIX) - 1, MODULE_KEY_PREFIX) !=
+        0) {
+        return false;
+    }
+    *path = dir_ + "/" + key + ".o";
+    return true;
+}
+
+bool HybridSeObjectCache::Contains(const std::string& key) const {
+    return ::llvm::sys::fs::exists(dir_ + "/" + key + ".o");
+}
+
+void HybridSeObjectCache::notifyObjectCompiled(const ::llvm::Module* m,
+                                               ::llvm::MemoryBufferRef obj) {
+    std::string path;
+    if (!GetPath(m, &path)) {
+        return;
+    }
+    // the object is written into a temp file first, so a crash never leaves
+    // a partial object behind. The same module may be compiled by several
+    // threads at once, each of them writes its own temp file
+    int fd = -1;
+    ::llvm::SmallString<128> tmp_path;
+    std::error_code ec = ::llvm::sys::fs::createUniqueFile(
+        dir_ + "/%%%%%%.tmp", fd, tmp_path);
+    if (ec) {
+        LOG(WARNING) << "fail to create temp object file under " << dir_
+                     << ": " << ec.message();
+        return;
+    }
+    {
+        ::llvm::raw_fd_ostream os(fd, true);
+        os << obj.getBuffer();
+        os.close();
+        if (os.has_error()) {
+            os.clear_error();
+            LOG(WARNING) << "fail to write object file " << tmp_path.c_str();
+            ::llvm::sys::fs::remove(tmp_path);
+            return;
+        }
+    }
+    if (::llvm::sys::fs::rename(tmp_path, path)) {
+        LOG(WARNING) << "fail to rename object file " << tmp_path.c_str();
+        ::llvm::sys::fs::remove(tmp_path);
+        return;
+    }
+    DLOG(INFO) << "cache object of module " << m->getModuleIdentifier();
+}
+
+std::unique_ptr<::llvm::MemoryBuffer> HybridSeObjectCache::getObject(
+    const ::llvm::Module* m) {
+    std::string path;
+    if (!GetPath(m, &path)) {
+        return nullptr;
+    }
+    auto buf = ::llvm::MemoryBuffer::getFile(path, -1, false);
+    if (!buf) {
+        return nullptr;
+    }
+    DLOG(INFO) << "load cached object of module " << m->getModuleIdentifier();
+    return std::move(buf.get());
+}
+
+static bool PrepareCachedModule(HybridSeObjectCache* cache,
+                                ::llvm::Module* module) {
+    if (cache == nullptr) {
+        return false;
+    }
+    std::string key = HybridSeObjectCache::GetModuleKey(*module);
+    module->setModuleIdentifier(key);
+    return cache->Contains(key);
+}
+
 bool HybridSeLlvmJitWrapper::Init() {
     DLOG(INFO) << "Start to initialize hybridse jit";
-    auto jit = ::llvm::Expected<std::unique_ptr<HybridSeJit>>(
-        HybridSeJitBuilder().create());
+    HybridSeJitBuilder builder;
+    if (!jit_options_.object_cache_path().empty()) {
+        object_cache_.reset(
+            new HybridSeObjectCache(jit_options_.object_cache_path()));
+        if (!object_cache_->Init()) {
+            object_cache_.reset();
+        }
+    }
+    if (object_cache_) {
+        // the same compiler as the default one of lljit with the object cache
+        HybridSeObjectCache* cache = object_cache_.get();
+        builder.setCompileFunctionCreator(
+            [cache](::llvm::orc::JITTargetMachineBuilder jtmb)
+                -> ::llvm::Expected<
+                    ::llvm::orc::IRCompileLayer::CompileFunction> {
+                auto tm = jtmb.createTargetMachine();
+                if (!tm) {
+                    return tm.takeError();
+                }
+                return ::llvm::orc::TMOwningSimpleCompiler(std::move(*tm),
+                                                           cache);
+            });
+    }
+    auto jit = ::llvm::Expected<std::unique_ptr<HybridSeJit>>(builder.create());
     {
         ::llvm::Error e = jit.takeError();
         if (e) {
@@ -172,6 +345,10 @@ bool HybridSeLlvmJitWrapper::OptModule(::llvm::Module* module) {
     return jit_->OptModule(module);
 }
 
+bool HybridSeLlvmJitWrapper::PrepareCachedModule(::llvm::Module* module) {
+    return hybridse::vm::PrepareCachedModule(object_cache_.get(), module);
+}
+
 bool HybridSeLlvmJitWrapper::AddModule(
     std::unique_ptr<llvm::Module> module,
     std::unique_ptr<llvm::LLVMContext> llvm_ctx) {
@@ -204,8 +381,22 @@ bool HybridSeLlvmJitWrapper::AddExternalFunction(const std::string& name,
                                                 name, addr);
 }
 
+bool HybridSeLlvmJitWrapper::AddSharedSymbols(const JitSymbolTable* symbols) {
+    jit_->SetSharedSymbols(symbols);
+    return true;
+}
+
 #ifdef LLVM_EXT_ENABLE
-bool HybridSeMcJitWrapper::Init() { return true; }
+bool HybridSeMcJitWrapper::Init() {
+    if (!jit_options_.object_cache_path().empty()) {
+        object_cache_.reset(
+            new HybridSeObjectCache(jit_options_.object_cache_path()));
+        if (!object_cache_->Init()) {
+            object_cache_.reset();
+        }
+    }
+    return true;
+}
 
 bool HybridSeMcJitWrapper::OptModule(::llvm::Module* module) {
     DLOG(INFO) << "Module before opt:\n" << LlvmToString(*module);
@@ -214,6 +405,10 @@ bool HybridSeMcJitWrapper::OptModule(::llvm::Module* module) {
     return true;
 }
 
+bool HybridSeMcJitWrapper::PrepareCachedModule(::llvm::Module* module) {
+    return hybridse::vm::PrepareCachedModule(object_cache_.get(), module);
+}
+
 bool HybridSeMcJitWrapper::AddModule(
     std::unique_ptr<llvm::Module> module,
     std::unique_ptr<llvm::LLVMContext> llvm_ctx) {
@@ -247,6 +442,9 @@ bool HybridSeMcJitWrapper::AddModule(
                          << err_str_;
             return false;
         }
+        if (object_cache_) {
+            execution_engine_->setObjectCache(object_cache_.get());
+        }
         for (auto& pair : extern_functions_) {
             resolver->addSymbol(pair.first, pair.second);
         }
@@ -21,6 +21,7 @@
 #include <memory>
 #include <string>
 #include "llvm/ExecutionEngine/GenericValue.h"
+#include "llvm/ExecutionEngine/ObjectCache.h"
 #include "llvm/ExecutionEngine/Orc/LLJIT.h"
 #include "vm/jit_wrapper.h"
 
@@ -44,6 +45,12 @@ class HybridSeJit : public ::llvm::orc::LLJIT {
  public:
     void Init();
 
+    // the symbols missing in the main module are looked up in the shared
+    // table before the process, the table must outlive the jit
+    void SetSharedSymbols(const JitSymbolTable* symbols) {
+        shared_symbols_ = symbols;
+    }
+
     ::llvm::Error AddIRModule(::llvm::orc::JITDylib& jd,  // NOLINT
                               ::llvm::orc::ThreadSafeModule tsm,
                               ::llvm::orc::VModuleKey key);
@@ -68,6 +75,9 @@ class HybridSeJit : public ::llvm::orc::LLJIT {
 
  protected:
     HybridSeJit(::llvm::orc::LLJITBuilderState& s, ::llvm::Error& e);  // NOLINT
+
+ private:
+    const JitSymbolTable* shared_symbols_ = nullptr;
 };
 
 class HybridSeJitBuilder
@@ -85,24 +95,62 @@ std::string LlvmToString(const T& value) {
     return str;
 }
 
+// HybridSeObjectCache keeps the object code of the compiled modules in the
+// files under a dir, so the modules compiled before a restart are linked from
+// the files without the optimization and the code generation. Only the modules
+// named by GetModuleKey are cached
+class HybridSeObjectCache : public ::llvm::ObjectCache {
+ public:
+    explicit HybridSeObjectCache(const std::string& dir) : dir_(dir) {}
+    ~HybridSeObjectCache() override {}
+
+    bool Init();
+
+    void notifyObjectCompiled(const ::llvm::Module* m,
+                              ::llvm::MemoryBufferRef obj) override;
+
+    std::unique_ptr<::llvm::MemoryBuffer> getObject(
+        const ::llvm::Module* m) override;
+
+    bool Contains(const std::string& key) const;
+
+    // the key hashes the ir of the module before the optimization, the
+    // version of hybridse and the host target
+    static std::string GetModuleKey(const ::llvm::Module& m);
+
+ private:
+    bool GetPath(const ::llvm::Module* m, std::string* path) const;
+
+    const std::string dir_;
+};
+
 class HybridSeLlvmJitWrapper : public HybridSeJitWrapper {
  public:
     HybridSeLlvmJitWrapper() {}
+    explicit HybridSeLlvmJitWrapper(const JitOptions& jit_options)
+        : jit_options_(jit_options) {}
     ~HybridSeLlvmJitWrapper() {}
 
     bool Init() override;
 
     bool OptModule(::llvm::Module* module) override;
 
+    bool PrepareCachedModule(::llvm::Module* module) override;
+
     bool AddModule(std::unique_ptr<llvm::Module> module,
                    std::unique_ptr<llvm::LLVMContext> llvm_ctx) override;
 
     bool AddExternalFunction(const std::string& name, void* addr) override;
 
+    bool AddSharedSymbols(const JitSymbolTable* symbols) override;
+
     hybridse::vm::RawPtrHandle FindFunction(
         const std::string& funcname) override;
 
  private:
+    const JitOptions jit_options_;
+    // the compiler of the jit refers to the cache
+    std::unique_ptr<HybridSeObjectCache> object_cache_;
     std::unique_ptr<HybridSeJit> jit_;
     std::unique_ptr<::llvm::orc::MangleAndInterner> mi_;
 };
@@ -118,6 +166,8 @@ class HybridSeMcJitWrapper : public HybridSeJitWrapper {
 
     bool OptModule(::llvm::Module* module) override;
 
+    bool PrepareCachedModule(::llvm::Module* module) override;
+
     bool AddModule(std::unique_ptr<llvm::Module> module,
                    std::unique_ptr<llvm::LLVMContext> llvm_ctx) override;
 
@@ -131,6 +181,7 @@ class HybridSeMcJitWrapper : public HybridSeJitWrapper {
     bool CheckError();
 
     const JitOptions jit_options_;
+    std::unique_ptr<HybridSeObjectCache> object_cache_;
     std::string err_str_ = "";
     std::map<std::string, void*> extern_functions_;
     llvm::ExecutionEngine* execution_engine_ = nullptr;
@@ -59,12 +59,54 @@ bool HybridSeJitWrapper::AddModuleFromBuffer(const base::RawBuffer& buf) {
     return this->AddModule(std::move(llvm_module), std::move(llvm_ctx));
 }
 
-bool HybridSeJitWrapper::InitJitSymbols(HybridSeJitWrapper* jit) {
-    InitBuiltinJitSymbols(jit);
-    udf::DefaultUdfLibrary::get()->InitJITSymbols(jit);
+bool HybridSeJitWrapper::AddSharedSymbols(const JitSymbolTable* symbols) {
+    for (auto& pair : *symbols) {
+        AddExternalFunction(pair.first, pair.second);
+    }
     return true;
 }
 
+// JitSymbolCollector records the external functions added without a jit
+class JitSymbolCollector : public HybridSeJitWrapper {
+ public:
+    explicit JitSymbolCollector(JitSymbolTable* symbols) : symbols_(symbols) {}
+    ~JitSymbolCollector() {}
+
+    bool Init() override { return true; }
+    bool OptModule(::llvm::Module* module) override { return false; }
+    bool AddModule(std::unique_ptr<llvm::Module> module,
+                   std::unique_ptr<llvm::LLVMContext> llvm_ctx) override {
+        return false;
+    }
+    bool AddExternalFunction(const std::string& name, void* addr) override {
+        // the first one wins like the jit
+        symbols_->emplace(name, addr);
+        return true;
+    }
+    hybridse::vm::RawPtrHandle FindFunction(
+        const std::string& funcname) override {
+        return nullptr;
+    }
+
+ private:
+    JitSymbolTable* symbols_;
+};
+
+static const JitSymbolTable* GetDefaultJitSymbols() {
+    static const JitSymbolTable* symbols = []() {
+        auto table = new JitSymbolTable();
+        JitSymbolCollector collector(table);
+        InitBuiltinJitSymbols(&collector);
+        udf::DefaultUdfLibrary::get()->InitJITSymbols(&collector);
+        return table;
+    }();
+    return symbols;
+}
+
+bool HybridSeJitWrapper::InitJitSymbols(HybridSeJitWrapper* jit) {
+    return jit->AddSharedSymbols(GetDefaultJitSymbols());
+}
+
 HybridSeJitWrapper* HybridSeJitWrapper::Create() {
     return Create(JitOptions());
 }
@@ -76,14 +118,14 @@ HybridSeJitWrapper* HybridSeJitWrapper::Create(const JitOptions& jit_options) {
         return new HybridSeMcJitWrapper(jit_options);
 #else
         LOG(WARNING) << "McJit support is not enabled";
-        return new HybridSeLlvmJitWrapper();
+        return new HybridSeLlvmJitWrapper(jit_options);
 #endif
     } else {
         if (jit_options.is_enable_vtune() || jit_options.is_enable_perf() ||
             jit_options.is_enable_gdb()) {
             LOG(WARNING) << "LLJIT do not support jit events";
         }
-        return new HybridSeLlvmJitWrapper();
+        return new HybridSeLlvmJitWrapper(jit_options);
     }
 }
 
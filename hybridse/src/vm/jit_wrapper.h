@@ -19,6 +19,7 @@
 
 #include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 #include "base/fe_status.h"
 #include "base/raw_buffer.h"
@@ -32,6 +33,8 @@ namespace vm {
 
 class JitOptions;
 
+typedef std::unordered_map<std::string, void*> JitSymbolTable;
+
 class HybridSeJitWrapper {
  public:
     HybridSeJitWrapper() {}
@@ -41,11 +44,20 @@ class HybridSeJitWrapper {
     virtual bool Init() = 0;
     virtual bool OptModule(::llvm::Module* module) = 0;
 
+    // name the module by its key if the jit caches the object code, it
+    // returns true if the object of the module is cached already, so the
+    // module needn't be optimized
+    virtual bool PrepareCachedModule(::llvm::Module* module) { return false; }
+
     virtual bool AddModule(std::unique_ptr<llvm::Module> module,
                            std::unique_ptr<llvm::LLVMContext> llvm_ctx) = 0;
 
     virtual bool AddExternalFunction(const std::string& name, void* addr) = 0;
 
+    // add the symbols of a table which outlives the jit, a jit may resolve
+    // them lazily instead of defining each of them
+    virtual bool AddSharedSymbols(const JitSymbolTable* symbols);
+
     bool AddModuleFromBuffer(const base::RawBuffer&);
 
     virtual hybridse::vm::RawPtrHandle FindFunction(
@@ -55,6 +67,8 @@ class HybridSeJitWrapper {
     static HybridSeJitWrapper* Create();
     static void DeleteJit(HybridSeJitWrapper* jit);
 
+    // add the builtin symbols and the ones of the default udf library, which
+    // are collected once for the process
     static bool InitJitSymbols(HybridSeJitWrapper* jit);
 };
 
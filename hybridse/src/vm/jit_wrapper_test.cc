@@ -15,6 +15,9 @@
  */
 
 #include "vm/jit_wrapper.h"
+#include <thread>  // NOLINT
+#include <vector>
+#include "boost/filesystem.hpp"
 #include "codec/fe_row_codec.h"
 #include "gtest/gtest.h"
 #include "udf/udf.h"
@@ -150,6 +153,75 @@ TEST_F(JitWrapperTest, test_window) {
     delete jit;
 }
 
+TEST_F(JitWrapperTest, test_object_cache) {
+    std::string dir = "/tmp/jit_wrapper_test_object_cache";
+    boost::filesystem::remove_all(dir);
+    EngineOptions options;
+    options.jit_options().set_object_cache_path(dir);
+    auto catalog = GetTestCatalog();
+    auto schema = catalog->GetTable("db", "t1")->GetSchema();
+    int8_t buf[1024];
+    codec::RowBuilder row_builder(*schema);
+    row_builder.SetBuffer(buf, 1024);
+    row_builder.AppendDouble(3.14);
+    row_builder.AppendInt64(42);
+    hybridse::codec::Row empty_parameter;
+    hybridse::codec::Row row(base::RefCountedSlice::Create(buf, 1024));
+    // the second engine links the object compiled by the first one
+    for (int i = 0; i < 2; i++) {
+        auto compile_info =
+            Compile("select col_1, col_2 from t1;", options, catalog);
+        ASSERT_TRUE(compile_info != nullptr);
+        ASSERT_EQ(1, std::distance(boost::filesystem::directory_iterator(dir),
+                                   boost::filesystem::directory_iterator()));
+        auto &sql_context = compile_info->get_sql_context();
+        auto fn = sql_context.jit->FindFunction(
+            sql_context.physical_plan->GetFnInfos()[0]->fn_name());
+        ASSERT_TRUE(fn != nullptr);
+        hybridse::codec::Row output =
+            CoreAPI::RowProject(fn, row, empty_parameter);
+        codec::RowView row_view(*schema, output.buf(), output.size());
+        int64_t c2;
+        ASSERT_EQ(row_view.GetInt64(1, &c2), 0);
+        ASSERT_EQ(c2, 42);
+    }
+    boost::filesystem::remove_all(dir);
+}
+
+TEST_F(JitWrapperTest, test_object_cache_concurrent) {
+    std::string dir = "/tmp/jit_wrapper_test_object_cache_concurrent";
+    boost::filesystem::remove_all(dir);
+    EngineOptions options;
+    options.jit_options().set_object_cache_path(dir);
+    auto catalog = GetTestCatalog();
+    // the same module is compiled and cached by the threads at once
+    std::vector<std::shared_ptr<SqlCompileInfo>> compile_infos(8);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < compile_infos.size(); i++) {
+        threads.emplace_back([&, i]() {
+            compile_infos[i] =
+                Compile("select col_1, col_2 from t1;", options, catalog);
+        });
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+    for (auto &compile_info : compile_infos) {
+        ASSERT_TRUE(compile_info != nullptr);
+    }
+    // no temp file is left and the object is complete
+    ASSERT_EQ(1, std::distance(boost::filesystem::directory_iterator(dir),
+                               boost::filesystem::directory_iterator()));
+    auto compile_info =
+        Compile("select col_1, col_2 from t1;", options, catalog);
+    ASSERT_TRUE(compile_info != nullptr);
+    auto &sql_context = compile_info->get_sql_context();
+    ASSERT_TRUE(sql_context.jit->FindFunction(
+                    sql_context.physical_plan->GetFnInfos()[0]->fn_name()) !=
+                nullptr);
+    boost::filesystem::remove_all(dir);
+}
+
 }  // namespace vm
 }  // namespace hybridse
 
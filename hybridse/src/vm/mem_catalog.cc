@@ -16,6 +16,7 @@
 
 #include "vm/mem_catalog.h"
 #include <algorithm>
+#include <utility>
 namespace hybridse {
 namespace vm {
 MemTimeTableIterator::MemTimeTableIterator(const MemTimeTable* table,
@@ -53,6 +54,153 @@ const Row& hybridse::vm::MemTimeTableIterator::GetValue() {
 void MemTimeTableIterator::Next() { iter_++; }
 bool MemTimeTableIterator::Valid() const { return end_iter_ > iter_; }
 bool MemTimeTableIterator::IsSeekable() const { return true; }
+
+WindowBuffer::WindowBuffer()
+    : entries_(),
+      owners_(),
+      mask_(0),
+      head_(0),
+      tail_(0),
+      slices_(),
+      slice_mask_(0),
+      slice_head_(0),
+      slice_tail_(0) {}
+
+void WindowBuffer::Reserve(uint32_t slice_cnt) {
+    if (size() + 1 > entries_.size()) {
+        uint64_t cap = entries_.empty() ? 16 : entries_.size() << 1;
+        std::vector<Entry> entries(cap);
+        std::vector<Row> owners(cap);
+        for (uint64_t v = head_; v != tail_; ++v) {
+            entries[v & (cap - 1)] = entries_[v & mask_];
+            owners[v & (cap - 1)] = std::move(owners_[v & mask_]);
+        }
+        entries_.swap(entries);
+        owners_.swap(owners);
+        mask_ = cap - 1;
+    }
+    uint64_t slice_size = slice_tail_ - slice_head_;
+    if (slice_size + slice_cnt > slices_.size()) {
+        uint64_t cap = slices_.empty() ? 16 : slices_.size();
+        while (cap < slice_size + slice_cnt) {
+            cap <<= 1;
+        }
+        std::vector<RawSlice> slices(cap);
+        for (uint64_t v = slice_head_; v != slice_tail_; ++v) {
+            slices[v & (cap - 1)] = slices_[v & slice_mask_];
+        }
+        slices_.swap(slices);
+        slice_mask_ = cap - 1;
+    }
+}
+
+void WindowBuffer::PushFront(uint64_t key, const Row& row) {
+    // the rows borrowed from the storage are kept as the raw slices, the
+    // others are kept alive by the copies of them
+    bool owned = !row.IsBorrowed();
+    uint32_t slice_cnt = owned ? 0 : row.GetRowPtrCnt();
+    Reserve(slice_cnt);
+    slice_head_ -= slice_cnt;
+    for (uint32_t i = 0; i < slice_cnt; ++i) {
+        auto& slice = slices_[(slice_head_ + i) & slice_mask_];
+        slice.buf = row.buf(i);
+        slice.size = row.size(i);
+    }
+    --head_;
+    auto& entry = entries_[head_ & mask_];
+    entry.key = key;
+    entry.slice_pos = slice_head_;
+    entry.slice_cnt = slice_cnt;
+    entry.owned = owned;
+    if (owned) {
+        owners_[head_ & mask_] = row;
+    }
+}
+
+void WindowBuffer::PushFront(const WindowBuffer& other, uint64_t pos) {
+    uint64_t slot = (other.head_ + pos) & other.mask_;
+    const auto& other_entry = other.entries_[slot];
+    Reserve(other_entry.slice_cnt);
+    slice_head_ -= other_entry.slice_cnt;
+    for (uint32_t i = 0; i < other_entry.slice_cnt; ++i) {
+        slices_[(slice_head_ + i) & slice_mask_] =
+            other.slices_[(other_entry.slice_pos + i) & other.slice_mask_];
+    }
+    --head_;
+    auto& entry = entries_[head_ & mask_];
+    entry = other_entry;
+    entry.slice_pos = slice_head_;
+    if (entry.owned) {
+        owners_[head_ & mask_] = other.owners_[slot];
+    }
+}
+
+void WindowBuffer::PopFront() {
+    auto& entry = entries_[head_ & mask_];
+    if (entry.owned) {
+        owners_[head_ & mask_] = Row();
+    }
+    slice_head_ += entry.slice_cnt;
+    ++head_;
+}
+
+void WindowBuffer::PopBack() {
+    --tail_;
+    auto& entry = entries_[tail_ & mask_];
+    if (entry.owned) {
+        owners_[tail_ & mask_] = Row();
+    }
+    slice_tail_ -= entry.slice_cnt;
+}
+
+void WindowBuffer::GetRow(uint64_t pos, Row* row) const {
+    uint64_t slot = (head_ + pos) & mask_;
+    const auto& entry = entries_[slot];
+    if (entry.owned) {
+        *row = owners_[slot];
+        return;
+    }
+    row->Borrow(entry.slice_cnt, [&](size_t i) {
+        const auto& slice = slices_[(entry.slice_pos + i) & slice_mask_];
+        return std::make_pair(slice.buf, slice.size);
+    });
+}
+
+Row WindowBuffer::At(uint64_t pos) const {
+    Row row;
+    GetRow(pos, &row);
+    return row;
+}
+
+WindowBufferIterator::WindowBufferIterator(const WindowBuffer* buffer,
+                                           const vm::Schema* schema)
+    : buffer_(buffer), schema_(schema), pos_(0), row_() {}
+
+// the keys are in descending order, seek to the first key <= ts
+void WindowBufferIterator::Seek(const uint64_t& ts) {
+    uint64_t low = 0;
+    uint64_t high = buffer_->size();
+    while (low < high) {
+        uint64_t mid = low + (high - low) / 2;
+        if (buffer_->GetKey(mid) > ts) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    pos_ = low;
+}
+void WindowBufferIterator::SeekToFirst() { pos_ = 0; }
+const uint64_t& WindowBufferIterator::GetKey() const {
+    return buffer_->GetKey(pos_);
+}
+const Row& WindowBufferIterator::GetValue() {
+    buffer_->GetRow(pos_, &row_);
+    return row_;
+}
+void WindowBufferIterator::Next() { ++pos_; }
+bool WindowBufferIterator::Valid() const { return pos_ < buffer_->size(); }
+bool WindowBufferIterator::IsSeekable() const { return true; }
 MemWindowIterator::MemWindowIterator(const MemSegmentMap* partitions,
                                      const Schema* schema)
     : WindowIterator(),
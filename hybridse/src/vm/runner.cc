@@ -2699,8 +2699,7 @@ std::shared_ptr<DataHandlerList> ProxyRequestRunner::BatchRequestRun(
         std::shared_ptr<DataHandlerVector> one_index_key_input =
             std::shared_ptr<DataHandlerVector>();
         if (index_key_input) {
-            std::shared_ptr<DataHandlerVector> one_index_key_input =
-                std::make_shared<DataHandlerVector>();
+            one_index_key_input = std::make_shared<DataHandlerVector>();
             one_index_key_input->Add(index_key_input->Get(0));
         }
         auto res =
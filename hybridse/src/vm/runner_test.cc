@@ -15,9 +15,12 @@
  */
 
 #include <memory>
+#include <string>
 #include <utility>
+#include <vector>
 #include "boost/algorithm/string.hpp"
 #include "case/sql_case.h"
+#include "codec/fe_row_codec.h"
 #include "gtest/gtest.h"
 #include "llvm/ExecutionEngine/Orc/LLJIT.h"
 #include "llvm/IR/Function.h"
@@ -410,6 +413,97 @@ TEST_F(RunnerTest, RunnerPrintDataMemTimeTableTest) {
         LOG(INFO) << oss.str();
     }
 }
+
+TEST_F(RunnerTest, BatchRequestCommonJoinTest) {
+    hybridse::type::TableDef table_def;
+    BuildTableDef(table_def);
+    table_def.set_name("t1");
+    hybridse::type::TableDef table_def2;
+    BuildTableDef(table_def2);
+    table_def2.set_name("t2");
+    ::hybridse::type::IndexDef* index = table_def2.add_indexes();
+    index->set_name("index1");
+    index->add_first_keys("col1");
+    index->set_second_key("col5");
+    hybridse::type::Database db;
+    db.set_name("db");
+    AddTable(db, table_def);
+    AddTable(db, table_def2);
+    auto catalog = BuildSimpleCatalog(db);
+    std::vector<Row> rows;
+    hybridse::type::TableDef temp_table;
+    BuildRows(temp_table, rows);
+    ASSERT_TRUE(catalog->InsertRows("db", "t2", rows));
+
+    // request rows share col1 only, the join key of t1 and t2
+    std::vector<Row> request_batch;
+    for (int32_t i = 0; i < 8; ++i) {
+        codec::RowBuilder builder(table_def.columns());
+        std::string str0 = std::to_string(i);
+        std::string str = "request";
+        uint32_t total_size = builder.CalTotalLength(str.size() + str0.size());
+        int8_t* ptr = static_cast<int8_t*>(malloc(total_size));
+        builder.SetBuffer(ptr, total_size);
+        builder.AppendString(str0.c_str(), str0.size());
+        builder.AppendInt32(1);
+        builder.AppendInt16(i);
+        builder.AppendFloat(1.1f * i);
+        builder.AppendDouble(11.1 * i);
+        builder.AppendInt64(i);
+        builder.AppendString(str.c_str(), str.size());
+        request_batch.push_back(Row(base::RefCountedSlice::Create(ptr, total_size)));
+    }
+
+    std::string sql =
+        "select t1.col0, t1.col5, t2.col4 from t1 last join t2 "
+        "order by t2.col5 on t1.col1 = t2.col1;";
+    EngineOptions options;
+    options.set_performance_sensitive(false);
+    Engine engine(catalog, options);
+    base::Status status;
+
+    // without common columns the join runs for every request row
+    {
+        BatchRequestRunSession session;
+        ASSERT_TRUE(engine.Get(sql, "db", session, status)) << status;
+        auto& sql_context = std::dynamic_pointer_cast<SqlCompileInfo>(session.GetCompileInfo())->get_sql_context();
+        auto join_runner =
+            GetFirstRunnerOfType(sql_context.cluster_job.GetMainTask().GetRoot(), kRunnerRequestLastJoin);
+        ASSERT_TRUE(join_runner != nullptr);
+        ASSERT_FALSE(join_runner->need_batch_cache());
+
+        RunnerContext ctx(&sql_context.cluster_job, request_batch);
+        auto outputs = join_runner->BatchRequestRun(ctx);
+        ASSERT_TRUE(outputs != nullptr);
+        ASSERT_EQ(request_batch.size(), outputs->GetSize());
+        ASSERT_NE(outputs->Get(0).get(), outputs->Get(1).get());
+    }
+
+    // with col1 common the join only depends on the common row, so it runs
+    // once for the batch and every request row shares the same result
+    {
+        BatchRequestRunSession session;
+        session.AddCommonColumnIdx(1);
+        ASSERT_TRUE(engine.Get(sql, "db", session, status)) << status;
+        auto& sql_context = std::dynamic_pointer_cast<SqlCompileInfo>(session.GetCompileInfo())->get_sql_context();
+        auto join_runner =
+            GetFirstRunnerOfType(sql_context.cluster_job.GetMainTask().GetRoot(), kRunnerRequestLastJoin);
+        ASSERT_TRUE(join_runner != nullptr);
+        ASSERT_TRUE(join_runner->need_batch_cache());
+
+        RunnerContext ctx(&sql_context.cluster_job, request_batch);
+        auto outputs = join_runner->BatchRequestRun(ctx);
+        ASSERT_TRUE(outputs != nullptr);
+        ASSERT_EQ(request_batch.size(), outputs->GetSize());
+        for (size_t i = 1; i < outputs->GetSize(); ++i) {
+            ASSERT_EQ(outputs->Get(0).get(), outputs->Get(i).get());
+        }
+
+        std::vector<Row> output;
+        ASSERT_EQ(0, session.Run(request_batch, output));
+        ASSERT_EQ(request_batch.size(), output.size());
+    }
+}
 }  // namespace vm
 }  // namespace hybridse
 
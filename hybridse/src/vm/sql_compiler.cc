@@ -122,9 +122,17 @@ bool SqlCompiler::Compile(SqlContext& ctx, Status& status) {  // NOLINT
         LOG(WARNING) << status;
         return false;
     }
-    InitBuiltinJitSymbols(jit.get());
-    ctx.udf_library->InitJITSymbols(jit.get());
-    if (!jit->OptModule(m.get())) {
+    if (ctx.udf_library == udf::DefaultUdfLibrary::get()) {
+        HybridSeJitWrapper::InitJitSymbols(jit.get());
+    } else {
+        InitBuiltinJitSymbols(jit.get());
+        ctx.udf_library->InitJITSymbols(jit.get());
+    }
+    // the object code of a cached module is linked as it is, the optimization
+    // is only needed to keep the optimized ir. A tiered sql runs unoptimized
+    // until it's recompiled
+    bool cached = !ctx.is_tiered && jit->PrepareCachedModule(m.get());
+    if (!ctx.is_tiered && (!cached || keep_ir_) && !jit->OptModule(m.get())) {
         LOG(WARNING) << "fail to opt ir module for sql " << ctx.sql;
         return false;
     }
@@ -17,6 +17,7 @@
 #ifndef SRC_VM_SQL_COMPILER_H_
 #define SRC_VM_SQL_COMPILER_H_
 
+#include <atomic>
 #include <memory>
 #include <set>
 #include <string>
@@ -72,6 +73,27 @@ struct SqlContext {
 
     ::hybridse::vm::BatchRequestInfo batch_request_info;
 
+    // the catalog the sql is compiled against, the recompiling of a tiered
+    // sql resolves the tables on the same one
+    std::shared_ptr<Catalog> catalog;
+    // compiled without the optimization of the ir, the engine recompiles it
+    // with the optimization once it gets hot
+    bool is_tiered = false;
+    // the time in microseconds spent on compiling the sql and on running it
+    std::atomic<uint64_t> compile_time_us{0};
+    std::atomic<uint64_t> run_time_us{0};
+    std::atomic<uint64_t> run_cnt{0};
+    // the rows processed by the runs
+    std::atomic<uint64_t> run_rows{0};
+    // the start time of a run in progress, 0 if there is none. The engine
+    // checks it to recompile a sql whose single run lasts long
+    std::atomic<uint64_t> run_start_us{0};
+    std::atomic<uint64_t> hit_cnt{0};
+    std::atomic<bool> is_recompiling{false};
+    // the optimized compile info of a tiered sql once it's recompiled, it's
+    // accessed atomically
+    std::shared_ptr<CompileInfo> optimized_info;
+
     SqlContext() {}
     ~SqlContext() {}
 };
@@ -1016,6 +1016,73 @@ TEST_F(WindowIteratorTest,
         ASSERT_EQ(10L, window.GetCount());
     }
 }
+
+TEST_F(WindowIteratorTest, WindowBufferTest) {
+    std::vector<std::string> bufs;
+    for (int i = 0; i < 200; ++i) {
+        bufs.push_back("row" + std::to_string(i));
+    }
+    // the rows borrowed from bufs of one or two slices, and the managed rows
+    auto make_row = [&](int i) {
+        if (i % 3 == 0) {
+            int8_t* ptr = reinterpret_cast<int8_t*>(malloc(bufs[i].size()));
+            memcpy(ptr, bufs[i].data(), bufs[i].size());
+            return Row(base::RefCountedSlice::CreateManaged(
+                ptr, bufs[i].size()));
+        }
+        Row row(bufs[i]);
+        return i % 3 == 1 ? Row(1, row, 1, Row(bufs[i])) : row;
+    };
+    auto check_row = [&](int i, const Row& row) {
+        ASSERT_EQ(i % 3 == 1 ? 2 : 1, row.GetRowPtrCnt());
+        for (int k = 0; k < row.GetRowPtrCnt(); ++k) {
+            ASSERT_EQ(bufs[i], std::string(reinterpret_cast<char*>(row.buf(k)),
+                                           row.size(k)));
+        }
+    };
+
+    WindowBuffer buffer;
+    ASSERT_TRUE(buffer.empty());
+    // keep at most 20 rows so the positions wrap around, then grow
+    int back = 0;
+    for (int i = 0; i < 200; ++i) {
+        buffer.PushFront(i, make_row(i));
+        if (i < 150 && buffer.size() > 20) {
+            buffer.PopBack();
+            ++back;
+        }
+        ASSERT_EQ(static_cast<uint64_t>(i), buffer.GetFrontKey());
+        ASSERT_EQ(static_cast<uint64_t>(back), buffer.GetBackKey());
+    }
+    ASSERT_EQ(70u, buffer.size());
+    for (uint64_t pos = 0; pos < buffer.size(); ++pos) {
+        check_row(199 - pos, buffer.At(pos));
+    }
+
+    WindowBufferIterator iter(&buffer, nullptr);
+    iter.Seek(150);
+    ASSERT_TRUE(iter.Valid());
+    ASSERT_EQ(150u, iter.GetKey());
+    check_row(150, iter.GetValue());
+    iter.Next();
+    ASSERT_EQ(149u, iter.GetKey());
+    iter.Seek(1000);
+    ASSERT_EQ(199u, iter.GetKey());
+    iter.Seek(0);
+    ASSERT_FALSE(iter.Valid());
+
+    // move the rows to another buffer from the back
+    WindowBuffer other;
+    while (!buffer.empty()) {
+        other.PushFront(buffer, buffer.size() - 1);
+        buffer.PopBack();
+        buffer.PopFront();
+    }
+    ASSERT_EQ(35u, other.size());
+    for (uint64_t pos = 0; pos < other.size(); ++pos) {
+        check_row(other.GetKey(pos), other.At(pos));
+    }
+}
 class RequestUnionWindowTest : public ::testing::Test {
  public:
     RequestUnionWindowTest() {}
@@ -21,6 +21,7 @@
 #include <string>
 
 #include "apiserver/interface_provider.h"
+#include "base/endianconv.h"
 #include "brpc/server.h"
 
 namespace openmldb {
@@ -75,50 +76,91 @@ void APIServerImpl::Process(google::protobuf::RpcController* cntl_base, const Ht
     DLOG(INFO) << "unresolved path: " << unresolved_path << ", method: " << HttpMethod2Str(method);
     const butil::IOBuf& req_body = cntl->request_attachment();
 
+    // the binary response is only used when the client accepts it and the route supports it
+    const std::string* accept = cntl->http_request().GetHeader("Accept");
+    if (accept != nullptr && accept->find(kRowContentType) != std::string::npos) {
+        butil::IOBuf resp_body;
+        if (provider_.handleBinary(unresolved_path, method, req_body, &resp_body)) {
+            cntl->http_response().set_content_type(kRowContentType);
+            cntl->response_attachment().swap(resp_body);
+            return;
+        }
+    }
+
     JsonWriter writer;
     provider_.handle(unresolved_path, method, req_body, writer);
 
     cntl->response_attachment().append(writer.GetString());
 }
 
-bool APIServerImpl::Json2SQLRequestRow(const butil::rapidjson::Value& non_common_cols_v,
-                                       const butil::rapidjson::Value& common_cols_v,
-                                       std::shared_ptr<openmldb::sdk::SQLRequestRow> row) {
-    auto sch = row->GetSchema();
-
-    // scan all strings to init the total string length
-    decltype(common_cols_v.Size()) str_len_sum = 0;
-    decltype(common_cols_v.Size()) non_common_idx = 0, common_idx = 0;
-    for (decltype(sch->GetColumnCnt()) i = 0; i < sch->GetColumnCnt(); ++i) {
-        if (sch->GetColumnType(i) != hybridse::sdk::kTypeString) {
-            continue;
-        }
-        if (sch->IsConstant(i)) {
-            str_len_sum += common_cols_v[common_idx].GetStringLength();
-            ++common_idx;
-        } else {
-            str_len_sum += non_common_cols_v[non_common_idx].GetStringLength();
-            ++non_common_idx;
+std::shared_ptr<PreparedProcedure> APIServerImpl::GetPreparedProcedure(const std::string& db,
+                                                                     const std::string& sp,
+                                                                     hybridse::sdk::Status* status) {
+    // procedure lookup is a catalog map lookup. The catalog keeps the same ProcedureInfo for an unchanged
+    // procedure across refreshes, so a different pointer means the procedure is changed.
+    auto sp_info = sql_router_->ShowProcedure(db, sp, status);
+    if (!sp_info) {
+        std::lock_guard<::openmldb::base::SpinMutex> lock(sp_mu_);
+        auto db_it = prepared_sps_.find(db);
+        if (db_it != prepared_sps_.end()) {
+            db_it->second.erase(sp);
+        }
+        return nullptr;
+    }
+    {
+        std::lock_guard<::openmldb::base::SpinMutex> lock(sp_mu_);
+        auto db_it = prepared_sps_.find(db);
+        if (db_it != prepared_sps_.end()) {
+            auto sp_it = db_it->second.find(sp);
+            if (sp_it != db_it->second.end() && sp_it->second->sp_info == sp_info) {
+                return sp_it->second;
+            }
         }
     }
-    row->Init(static_cast<int32_t>(str_len_sum));
+    auto prepared = PrepareProcedure(sp_info);
+    if (!prepared) {
+        status->code = -1;
+        status->msg = "unsupported input schema of procedure " + sp;
+        return nullptr;
+    }
+    std::lock_guard<::openmldb::base::SpinMutex> lock(sp_mu_);
+    prepared_sps_[db][sp] = prepared;
+    return prepared;
+}
 
-    non_common_idx = 0, common_idx = 0;
-    for (decltype(sch->GetColumnCnt()) i = 0; i < sch->GetColumnCnt(); ++i) {
-        if (sch->IsConstant(i)) {
-            if (!AppendJsonValue(common_cols_v[common_idx], sch->GetColumnType(i), sch->IsColumnNotNull(i), row)) {
-                return false;
-            }
-            ++common_idx;
+std::shared_ptr<PreparedProcedure> APIServerImpl::PrepareProcedure(
+    std::shared_ptr<hybridse::sdk::ProcedureInfo> sp_info) {
+    const auto* schema_impl = dynamic_cast<const ::hybridse::sdk::SchemaImpl*>(&sp_info->GetInputSchema());
+    if (schema_impl == nullptr) {
+        return nullptr;
+    }
+    auto prepared = std::make_shared<PreparedProcedure>();
+    prepared->sp_info = sp_info;
+    // Hard copy, and RequestRow needs shared schema
+    prepared->input_schema = std::make_shared<::hybridse::sdk::SchemaImpl>(schema_impl->GetSchema());
+    prepared->common_column_indices = std::make_shared<openmldb::sdk::ColumnIndicesSet>(prepared->input_schema);
+    const auto& input_schema = schema_impl->GetSchema();
+    codec::Schema common_schema;
+    codec::Schema non_common_schema;
+    for (int i = 0; i < input_schema.size(); ++i) {
+        const auto& column = input_schema.Get(i);
+        ::openmldb::common::ColumnDesc* desc = nullptr;
+        if (column.is_constant()) {
+            prepared->common_column_indices->AddCommonColumnIdx(i);
+            desc = common_schema.Add();
         } else {
-            if (!AppendJsonValue(non_common_cols_v[non_common_idx], sch->GetColumnType(i), sch->IsColumnNotNull(i),
-                                 row)) {
-                return false;
-            }
-            ++non_common_idx;
+            desc = non_common_schema.Add();
+        }
+        if (!::openmldb::catalog::SchemaAdapter::ConvertType(column, desc)) {
+            return nullptr;
         }
     }
-    return true;
+    prepared->common_encoder = std::make_unique<JsonRowEncoder>(common_schema);
+    prepared->non_common_encoder = std::make_unique<JsonRowEncoder>(non_common_schema);
+    if (!prepared->common_encoder->IsValid() || !prepared->non_common_encoder->IsValid()) {
+        return nullptr;
+    }
+    return prepared;
 }
 
 template <typename T>
@@ -273,107 +315,77 @@ void APIServerImpl::RegisterPut() {
     });
 }
 
-void APIServerImpl::RegisterExecSP() {
-    provider_.post("/dbs/:db_name/procedures/:sp_name", [this](const InterfaceProvider::Params& param,
-                                                               const butil::IOBuf& req_body, JsonWriter& writer) {
-        auto err = GeneralError();
-        auto db_it = param.find("db_name");
-        auto sp_it = param.find("sp_name");
-        if (db_it == param.end() || sp_it == param.end()) {
-            writer << err.Set("Invalid path");
-            return;
-        }
-        auto db = db_it->second;
-        auto sp = sp_it->second;
-
-        Document document;
-        if (document.Parse(req_body.to_string().c_str()).HasParseError()) {
-            writer << err.Set("Json parse failed");
-            return;
-        }
-
-        auto common_cols = document.FindMember("common_cols");
-        butil::rapidjson::Value common_cols_v;
-        if (common_cols != document.MemberEnd()) {
-            common_cols_v = common_cols->value;  // move
-            if (!common_cols_v.IsArray()) {
-                writer << err.Set("common_cols is not array");
-                return;
-            }
-        } else {
-            common_cols_v.SetArray();  // If there's no common cols, no need to add this field in request
-        }
+bool APIServerImpl::ExecuteSP(const InterfaceProvider::Params& param, const butil::IOBuf& req_body, ExecSPResp* resp,
+                              std::string* msg) {
+    auto db_it = param.find("db_name");
+    auto sp_it = param.find("sp_name");
+    if (db_it == param.end() || sp_it == param.end()) {
+        *msg = "Invalid path";
+        return false;
+    }
+    auto db = db_it->second;
+    auto sp = sp_it->second;
+
+    hybridse::sdk::Status status;
+    // We need the input schema from procedure info(should know which column is constant).
+    // GetRequestRowByProcedure can't do that.
+    auto prepared = GetPreparedProcedure(db, sp, &status);
+    if (!prepared) {
+        *msg = status.msg;
+        return false;
+    }
 
-        auto input = document.FindMember("input");
-        if (input == document.MemberEnd() || !input->value.IsArray() || input->value.Empty()) {
-            writer << err.Set("Invalid input");
-            return;
-        }
-        const auto& rows = input->value;
+    // the body is parsed in situ, values are encoded into the common and non-common rows directly
+    std::string body = req_body.to_string();
+    JsonRowDecoder decoder(*prepared->common_encoder, *prepared->non_common_encoder);
+    if (!decoder.Decode(&body[0], msg)) {
+        return false;
+    }
 
-        hybridse::sdk::Status status;
-        // We need to use ShowProcedure to get input schema(should know which column is constant).
-        // GetRequestRowByProcedure can't do that.
-        auto sp_info = sql_router_->ShowProcedure(db, sp, &status);
-        if (!sp_info) {
-            writer << err.Set(status.msg);
-            return;
+    auto row_batch =
+        std::make_shared<sdk::SQLRequestRowBatch>(prepared->input_schema, prepared->common_column_indices);
+    for (auto& row : decoder.GetNonCommonRows()) {
+        if (!row_batch->AddRow(decoder.GetCommonRow(), std::move(row))) {
+            *msg = "Translate to request row failed";
+            return false;
         }
+    }
 
-        const auto& schema_impl = dynamic_cast<const ::hybridse::sdk::SchemaImpl&>(sp_info->GetInputSchema());
-        // Hard copy, and RequestRow needs shared schema
-        auto input_schema = std::make_shared<::hybridse::sdk::SchemaImpl>(schema_impl.GetSchema());
-        auto common_column_indices = std::make_shared<openmldb::sdk::ColumnIndicesSet>(input_schema);
-        decltype(common_cols_v.Size()) expected_common_size = 0;
-        for (int i = 0; i < input_schema->GetColumnCnt(); ++i) {
-            if (input_schema->IsConstant(i)) {
-                common_column_indices->AddCommonColumnIdx(i);
-                ++expected_common_size;
-            }
-        }
+    auto rs = sql_router_->CallSQLBatchRequestProcedure(db, sp, row_batch, &status);
+    if (!rs) {
+        *msg = status.msg;
+        return false;
+    }
 
-        if (common_cols_v.Size() != expected_common_size) {
-            writer << err.Set("Invalid common cols size");
-            return;
-        }
-        auto expected_input_size = input_schema->GetColumnCnt() - expected_common_size;
+    // output schema in sp_info is needed for encoding data, so we need a bool in ExecSPResp to know whether to
+    // print schema
+    resp->sp_info = prepared->sp_info;
+    resp->need_schema = decoder.NeedSchema();
+    resp->rs = rs;
+    return true;
+}
 
-        // TODO(hw): SQLRequestRowBatch should add common & non-common cols directly
-        auto row_batch = std::make_shared<sdk::SQLRequestRowBatch>(input_schema, common_column_indices);
-        std::set<std::string> col_set;
-        for (decltype(rows.Size()) i = 0; i < rows.Size(); ++i) {
-            if (!rows[i].IsArray() || rows[i].Size() != expected_input_size) {
-                writer << err.Set("Invalid input data row");
+void APIServerImpl::RegisterExecSP() {
+    provider_.post(
+        "/dbs/:db_name/procedures/:sp_name",
+        [this](const InterfaceProvider::Params& param, const butil::IOBuf& req_body, JsonWriter& writer) {
+            auto err = GeneralError();
+            ExecSPResp resp;
+            if (!ExecuteSP(param, req_body, &resp, &err.msg)) {
+                writer << err;
                 return;
             }
-            auto row = std::make_shared<sdk::SQLRequestRow>(input_schema, col_set);
-
-            // sizes have been checked
-            if (!Json2SQLRequestRow(rows[i], common_cols_v, row)) {
-                writer << err.Set("Translate to request row failed");
+            writer << resp;
+        },
+        [this](const InterfaceProvider::Params& param, const butil::IOBuf& req_body, butil::IOBuf* resp_body) {
+            auto err = GeneralError();
+            ExecSPResp resp;
+            if (!ExecuteSP(param, req_body, &resp, &err.msg)) {
+                WriteBinaryError(err, resp_body);
                 return;
             }
-            row->Build();
-            row_batch->AddRow(row);
-        }
-
-        auto rs = sql_router_->CallSQLBatchRequestProcedure(db, sp, row_batch, &status);
-        if (!rs) {
-            writer << err.Set(status.msg);
-            return;
-        }
-
-        ExecSPResp resp;
-        // output schema in sp_info is needed for encoding data, so we need a bool in ExecSPResp to know whether to
-        // print schema
-        resp.sp_info = sp_info;
-        if (document.HasMember("need_schema") && document["need_schema"].IsBool() &&
-            document["need_schema"].GetBool()) {
-            resp.need_schema = true;
-        }
-        resp.rs = rs;
-        writer << resp;
-    });
+            WriteBinaryExecSPResp(resp, resp_body);
+        });
 }
 
 void APIServerImpl::RegisterGetSP() {
@@ -596,7 +608,7 @@ void WriteValue(JsonWriter& ar, std::shared_ptr<hybridse::sdk::ResultSet> rs, in
         case hybridse::sdk::kTypeBool: {
             bool value = false;
             rs->GetBool(i, &value);
-            ar&(value ? "true" : "false");
+            ar& value;
             break;
         }
         default: {
@@ -607,6 +619,67 @@ void WriteValue(JsonWriter& ar, std::shared_ptr<hybridse::sdk::ResultSet> rs, in
     }
 }
 
+void WriteBatchRequestRows(JsonWriter& ar, const hybridse::sdk::Schema& schema,  // NOLINT
+                           ::openmldb::sdk::SQLBatchRequestResultSet* rs) {
+    JsonRowWriter common_writer(rs->GetCommonSchema());
+    JsonRowWriter non_common_writer(rs->GetNonCommonSchema());
+    // the output columns of data and common_cols_data, and where they are in the result rows
+    struct ColumnPos {
+        bool is_common;
+        uint32_t idx;
+    };
+    std::vector<ColumnPos> data_cols;
+    std::vector<ColumnPos> common_cols;
+    const int8_t* row = nullptr;
+    uint32_t size = 0;
+
+    // data-data: non common cols data
+    ar.Member("data");
+    ar.StartArray();
+    rs->Reset();
+    bool has_row = false;
+    while (rs->Next()) {
+        if (!has_row) {
+            // the column mapping of rs is valid only if there is any row
+            for (decltype(schema.GetColumnCnt()) i = 0; i < schema.GetColumnCnt(); i++) {
+                ColumnPos pos{rs->IsCommonColumnIdx(i), static_cast<uint32_t>(rs->GetColumnRemap(i))};
+                if (schema.IsConstant(i)) {
+                    common_cols.push_back(pos);
+                } else {
+                    data_cols.push_back(pos);
+                }
+            }
+            if (rs->GetCommonRow(&row, &size)) {
+                common_writer.Reset(row, size);
+            }
+            has_row = true;
+        }
+        if (rs->GetNonCommonRow(&row, &size)) {
+            non_common_writer.Reset(row, size);
+        }
+        ar.StartArray();
+        for (const auto& pos : data_cols) {
+            (pos.is_common ? common_writer : non_common_writer).WriteValue(ar, pos.idx);
+        }
+        ar.EndArray();  // one row end
+    }
+    ar.EndArray();
+
+    // data-common_cols_data, they are the same in all rows, so write the ones of the first row
+    ar.Member("common_cols_data");
+    rs->Reset();
+    if (rs->Next()) {
+        if (rs->GetNonCommonRow(&row, &size)) {
+            non_common_writer.Reset(row, size);
+        }
+        ar.StartArray();
+        for (const auto& pos : common_cols) {
+            (pos.is_common ? common_writer : non_common_writer).WriteValue(ar, pos.idx);
+        }
+        ar.EndArray();  // one row end
+    }
+}
+
 // ExecSPResp reading is unsupported now, cuz we decode ResultSet with Schema here, it's irreversible
 JsonWriter& operator&(JsonWriter& ar, ExecSPResp& s) {  // NOLINT
     ar.StartObject();
@@ -622,6 +695,14 @@ JsonWriter& operator&(JsonWriter& ar, ExecSPResp& s) {  // NOLINT
         WriteSchema(ar, "schema", schema, false);
     }
 
+    // the raw rows of a batch request result set are written directly, without the ResultSet getters
+    auto* batch_rs = dynamic_cast<::openmldb::sdk::SQLBatchRequestResultSet*>(s.rs.get());
+    if (batch_rs != nullptr) {
+        WriteBatchRequestRows(ar, schema, batch_rs);
+        ar.EndObject();  // end data
+        return ar.EndObject();
+    }
+
     // data-data: non common cols data
     ar.Member("data");
     ar.StartArray();
@@ -656,6 +737,34 @@ JsonWriter& operator&(JsonWriter& ar, ExecSPResp& s) {  // NOLINT
     return ar.EndObject();
 }
 
+static void WriteBinaryMeta(const ::openmldb::api::SQLBatchRequestQueryResponse& meta, butil::IOBuf* body) {
+    std::string meta_str;
+    meta.SerializeToString(&meta_str);
+    uint32_t meta_size = meta_str.size();
+    // the meta size is little-endian on the wire, whatever the host byte order is
+    memrev32ifbe(static_cast<void*>(&meta_size));
+    body->append(&meta_size, sizeof(meta_size));
+    body->append(meta_str);
+}
+
+void WriteBinaryExecSPResp(const ExecSPResp& s, butil::IOBuf* body) {
+    auto* batch_rs = dynamic_cast<::openmldb::sdk::SQLBatchRequestResultSet*>(s.rs.get());
+    if (batch_rs == nullptr) {
+        WriteBinaryError(GeneralError("binary response is unsupported for this result set"), body);
+        return;
+    }
+    WriteBinaryMeta(batch_rs->GetResponse(), body);
+    // the rows are appended by reference, no copy
+    body->append(batch_rs->GetRowsBuffer());
+}
+
+void WriteBinaryError(const GeneralError& err, butil::IOBuf* body) {
+    ::openmldb::api::SQLBatchRequestQueryResponse meta;
+    meta.set_code(err.code);
+    meta.set_msg(err.msg);
+    WriteBinaryMeta(meta, body);
+}
+
 JsonWriter& operator&(JsonWriter& ar, std::shared_ptr<hybridse::sdk::ProcedureInfo> sp_info) {  // NOLINT
     ar.StartObject();
     ar.Member("name") & sp_info->GetSpName();
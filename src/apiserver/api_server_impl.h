@@ -17,6 +17,7 @@
 #ifndef SRC_APISERVER_API_SERVER_IMPL_H_
 #define SRC_APISERVER_API_SERVER_IMPL_H_
 
+#include <map>
 #include <memory>
 #include <string>
 #include <utility>
@@ -24,9 +25,12 @@
 #include <algorithm>
 
 #include "apiserver/interface_provider.h"
+#include "base/spinlock.h"
 #include "apiserver/json_helper.h"
+#include "apiserver/json_row_codec.h"
 #include "json2pb/rapidjson.h"  // rapidjson's DOM-style API
 #include "proto/api_server.pb.h"
+#include "sdk/batch_request_result_set_sql.h"
 #include "sdk/sql_cluster_router.h"
 
 namespace openmldb {
@@ -36,11 +40,29 @@ using butil::rapidjson::Document;
 using butil::rapidjson::StringBuffer;
 using butil::rapidjson::Writer;
 
+// The content type of binary responses. Clients which send `Accept: application/x-openmldb-row` get the binary
+// response from the routes that support it, see `WriteBinaryExecSPResp()`. Other routes still respond in json.
+constexpr const char* kRowContentType = "application/x-openmldb-row";
+
+struct ExecSPResp;
+
+// PreparedProcedure holds everything ExecSP derives from the procedure info. It's built once per procedure and
+// rebuilt only when the procedure info in catalog is changed, so a request only parses values and encodes rows.
+struct PreparedProcedure {
+    std::shared_ptr<hybridse::sdk::ProcedureInfo> sp_info;
+    std::shared_ptr<hybridse::sdk::SchemaImpl> input_schema;
+    std::shared_ptr<openmldb::sdk::ColumnIndicesSet> common_column_indices;
+    // the encoders of the common and non-common columns of the input schema, request rows are encoded with them
+    // directly and they are shared by all the requests of the procedure
+    std::unique_ptr<JsonRowEncoder> common_encoder;
+    std::unique_ptr<JsonRowEncoder> non_common_encoder;
+};
+
 // APIServer is a service for brpc::Server. The entire implement is `StartAPIServer()` in src/cmd/openmldb.cc
 // Every request is handled by `Process()`, we will choose the right method of the request by `InterfaceProvider`.
 // InterfaceProvider's url parser supports to parse urls like "/a/:arg1/b/:arg2/:arg3", but doesn't support wildcards.
 // Methods should be registered in `InterfaceProvider` in the init phase.
-// Both input and output are json data. We use rapidjson to handle it.
+// Both input and output are json data. We use rapidjson to handle it. ExecSP can respond in binary as well.
 class APIServerImpl : public APIServer {
  public:
     APIServerImpl() = default;
@@ -61,9 +83,16 @@ class APIServerImpl : public APIServer {
     void RegisterGetDB();
     void RegisterGetTable();
 
-    static bool Json2SQLRequestRow(const butil::rapidjson::Value& non_common_cols_v,
-                                   const butil::rapidjson::Value& common_cols_v,
-                                   std::shared_ptr<openmldb::sdk::SQLRequestRow> row);
+    // returns the cached PreparedProcedure, it's rebuilt if the procedure is changed
+    std::shared_ptr<PreparedProcedure> GetPreparedProcedure(const std::string& db, const std::string& sp,
+                                                            hybridse::sdk::Status* status);
+
+    static std::shared_ptr<PreparedProcedure> PrepareProcedure(std::shared_ptr<hybridse::sdk::ProcedureInfo> sp_info);
+
+    // executes the procedure in param with the json request body, sets msg if failed
+    bool ExecuteSP(const InterfaceProvider::Params& param, const butil::IOBuf& req_body, ExecSPResp* resp,
+                   std::string* msg);
+
     template <typename T>
     static bool AppendJsonValue(const butil::rapidjson::Value& v, hybridse::sdk::DataType type, bool is_not_null,
                                 T row);
@@ -73,6 +102,9 @@ class APIServerImpl : public APIServer {
     InterfaceProvider provider_;
     // cluster_sdk_ is not owned by this class.
     ::openmldb::sdk::ClusterSDK* cluster_sdk_;
+    ::openmldb::base::SpinMutex sp_mu_;
+    // db -> sp name -> prepared procedure
+    std::map<std::string, std::map<std::string, std::shared_ptr<PreparedProcedure>>> prepared_sps_;
 };
 
 struct PutResp {
@@ -103,9 +135,22 @@ void WriteSchema(JsonWriter& ar, const std::string& name, const hybridse::sdk::S
 
 void WriteValue(JsonWriter& ar, std::shared_ptr<hybridse::sdk::ResultSet> rs, int i);  // NOLINT
 
+// write data and common_cols_data of ExecSPResp from the raw rows of rs
+void WriteBatchRequestRows(JsonWriter& ar, const hybridse::sdk::Schema& schema,  // NOLINT
+                           ::openmldb::sdk::SQLBatchRequestResultSet* rs);
+
 // ExecSPResp reading is unsupported now, cuz we decode ResultSet with Schema here, it's irreversible
 JsonWriter& operator&(JsonWriter& ar, ExecSPResp& s);  // NOLINT
 
+// The binary ExecSPResp. The body is a 4-byte little-endian meta size, the meta, then the raw rows. The meta is a
+// serialized api::SQLBatchRequestQueryResponse which has code, msg, the output schema, the common column indices and
+// the row sizes. The rows are the common row(if there are common columns) followed by the non-common rows, the same
+// layout the tablet responds, so clients can decode them as SQLBatchRequestResultSet does.
+void WriteBinaryExecSPResp(const ExecSPResp& s, butil::IOBuf* body);
+
+// the binary response of an error, the meta has only code and msg
+void WriteBinaryError(const GeneralError& err, butil::IOBuf* body);
+
 struct GetSPResp {
     GetSPResp() = default;
     int code = 0;
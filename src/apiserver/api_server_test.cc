@@ -15,6 +15,7 @@
  */
 
 #include "apiserver/api_server_impl.h"
+#include "base/endianconv.h"
 #include "brpc/channel.h"
 #include "brpc/restful.h"
 #include "brpc/server.h"
@@ -480,6 +481,188 @@ TEST_F(APIServerTest, procedure) {
     ASSERT_TRUE(env->cluster_remote->ExecuteDDL(env->db, "drop table trans;", &status));
 }
 
+TEST_F(APIServerTest, procedure_recreate) {
+    const auto env = APIServerTestEnv::Instance();
+
+    std::string ddl = "create table trans(c1 string, c3 int, c4 bigint, c7 timestamp, index(key=c1, ts=c7));";
+    hybridse::sdk::Status status;
+    env->cluster_remote->ExecuteDDL(env->db, "drop table trans;", &status);
+    ASSERT_TRUE(env->cluster_sdk->Refresh());
+    ASSERT_TRUE(env->cluster_remote->ExecuteDDL(env->db, ddl, &status)) << "fail to create table";
+    ASSERT_TRUE(env->cluster_sdk->Refresh());
+
+    std::string sp_name = "sp_recreate";
+    std::string sql =
+        "SELECT c1, c3, sum(c4) OVER w1 as w1_c4_sum FROM trans WINDOW w1 AS"
+        " (PARTITION BY trans.c1 ORDER BY trans.c7 ROWS BETWEEN 2 PRECEDING AND CURRENT ROW);";
+    auto exec_sp = [&](const std::string& body, int expect_code) {
+        brpc::Controller cntl;
+        cntl.http_request().set_method(brpc::HTTP_METHOD_POST);
+        cntl.http_request().uri() = "http://127.0.0.1:8010/dbs/" + env->db + "/procedures/" + sp_name;
+        cntl.request_attachment().append(body);
+        env->http_channel.CallMethod(NULL, &cntl, NULL, NULL, NULL);
+        ASSERT_FALSE(cntl.Failed()) << cntl.ErrorText();
+        butil::rapidjson::Document document;
+        ASSERT_FALSE(document.Parse(cntl.response_attachment().to_string().c_str()).HasParseError());
+        ASSERT_EQ(expect_code, document["code"].GetInt()) << cntl.response_attachment().to_string();
+    };
+
+    std::string sp_ddl = "create procedure " + sp_name +
+                         " (const c1 string, c3 int, c4 bigint, const c7 timestamp) begin " + sql + " end;";
+    ASSERT_TRUE(env->cluster_remote->ExecuteDDL(env->db, sp_ddl, &status)) << "fail to create procedure";
+    ASSERT_TRUE(env->cluster_sdk->Refresh());
+    exec_sp(R"({"common_cols":["bb", 1590738994000], "input": [[23, 123], [24, 234]]})", 0);
+    // the prepared procedure is reused
+    exec_sp(R"({"common_cols":["bb", 1590738994000], "input": [[25, 345]]})", 0);
+
+    // recreate the procedure with another common column layout, the cached one must not be used
+    ASSERT_TRUE(env->cluster_remote->ExecuteDDL(env->db, "drop procedure " + sp_name + ";", &status));
+    ASSERT_TRUE(env->cluster_sdk->Refresh());
+    exec_sp(R"({"common_cols":["bb", 1590738994000], "input": [[23, 123]]})", -1);
+    sp_ddl = "create procedure " + sp_name + " (const c1 string, const c3 int, c4 bigint, c7 timestamp) begin " +
+             sql + " end;";
+    ASSERT_TRUE(env->cluster_remote->ExecuteDDL(env->db, sp_ddl, &status)) << "fail to create procedure";
+    ASSERT_TRUE(env->cluster_sdk->Refresh());
+    exec_sp(R"({"common_cols":["bb", 1590738994000], "input": [[23, 123]]})", -1);
+    exec_sp(R"({"common_cols":["bb", 23], "input": [[123, 1590738994000], [234, 1590738994001]]})", 0);
+
+    ASSERT_TRUE(env->cluster_remote->ExecuteDDL(env->db, "drop procedure " + sp_name + ";", &status));
+    ASSERT_TRUE(env->cluster_remote->ExecuteDDL(env->db, "drop table trans;", &status));
+}
+
+TEST_F(APIServerTest, procedure_binary) {
+    const auto env = APIServerTestEnv::Instance();
+
+    std::string ddl = "create table trans(c1 string, c3 int, c4 bigint, c7 timestamp, index(key=c1, ts=c7));";
+    hybridse::sdk::Status status;
+    env->cluster_remote->ExecuteDDL(env->db, "drop table trans;", &status);
+    ASSERT_TRUE(env->cluster_sdk->Refresh());
+    ASSERT_TRUE(env->cluster_remote->ExecuteDDL(env->db, ddl, &status)) << "fail to create table";
+    ASSERT_TRUE(env->cluster_sdk->Refresh());
+
+    std::string sp_name = "sp_binary";
+    std::string sp_ddl = "create procedure " + sp_name +
+                         " (const c1 string, const c3 int, c4 bigint, const c7 timestamp) begin SELECT c1, c3, "
+                         "sum(c4) OVER w1 as w1_c4_sum FROM trans WINDOW w1 AS (PARTITION BY trans.c1 ORDER BY "
+                         "trans.c7 ROWS BETWEEN 2 PRECEDING AND CURRENT ROW); end;";
+    ASSERT_TRUE(env->cluster_remote->ExecuteDDL(env->db, sp_ddl, &status)) << "fail to create procedure";
+    ASSERT_TRUE(env->cluster_sdk->Refresh());
+
+    auto exec_sp = [&](const std::string& body, std::shared_ptr<::openmldb::api::SQLBatchRequestQueryResponse> meta,
+                       std::shared_ptr<brpc::Controller> rows) {
+        brpc::Controller cntl;
+        cntl.http_request().set_method(brpc::HTTP_METHOD_POST);
+        cntl.http_request().uri() = "http://127.0.0.1:8010/dbs/" + env->db + "/procedures/" + sp_name;
+        cntl.http_request().SetHeader("Accept", kRowContentType);
+        cntl.request_attachment().append(body);
+        env->http_channel.CallMethod(NULL, &cntl, NULL, NULL, NULL);
+        ASSERT_FALSE(cntl.Failed()) << cntl.ErrorText();
+        ASSERT_EQ(kRowContentType, cntl.http_response().content_type());
+
+        auto& resp_body = cntl.response_attachment();
+        uint32_t meta_size = 0;
+        ASSERT_EQ(sizeof(meta_size), resp_body.cutn(&meta_size, sizeof(meta_size)));
+        memrev32ifbe(static_cast<void*>(&meta_size));
+        butil::IOBuf meta_buf;
+        ASSERT_EQ(meta_size, resp_body.cutn(&meta_buf, meta_size));
+        ASSERT_TRUE(meta->ParseFromString(meta_buf.to_string()));
+        rows->response_attachment().swap(resp_body);
+    };
+
+    // the rows can be decoded in the same way as the tablet response
+    auto meta = std::make_shared<::openmldb::api::SQLBatchRequestQueryResponse>();
+    auto rows = std::make_shared<brpc::Controller>();
+    exec_sp(R"({"common_cols":["bb", 23, 1590738994000], "input": [[123], [234]]})", meta, rows);
+    ASSERT_EQ(0, meta->code()) << meta->msg();
+    ASSERT_EQ(2u, meta->count());
+    ::openmldb::sdk::SQLBatchRequestResultSet rs(meta, rows);
+    ASSERT_TRUE(rs.Init());
+    ASSERT_EQ(3, rs.GetSchema()->GetColumnCnt());
+    std::string str;
+    int32_t i32 = 0;
+    int64_t i64 = 0;
+    ASSERT_TRUE(rs.Next());
+    ASSERT_TRUE(rs.GetString(0, &str));
+    ASSERT_EQ("bb", str);
+    ASSERT_TRUE(rs.GetInt32(1, &i32));
+    ASSERT_EQ(23, i32);
+    ASSERT_TRUE(rs.GetInt64(2, &i64));
+    ASSERT_EQ(123, i64);
+    ASSERT_TRUE(rs.Next());
+    ASSERT_TRUE(rs.GetInt64(2, &i64));
+    ASSERT_EQ(234, i64);
+    ASSERT_FALSE(rs.Next());
+
+    // errors are in the meta
+    meta = std::make_shared<::openmldb::api::SQLBatchRequestQueryResponse>();
+    rows = std::make_shared<brpc::Controller>();
+    exec_sp(R"({"common_cols":["bb", 23, 1590738994000], "input": [[123, 1]]})", meta, rows);
+    ASSERT_EQ(-1, meta->code());
+    ASSERT_EQ("Invalid input data row", meta->msg());
+    ASSERT_EQ(0u, rows->response_attachment().size());
+
+    // routes without binary support respond in json
+    {
+        brpc::Controller cntl;
+        cntl.http_request().uri() = "http://127.0.0.1:8010/dbs/" + env->db + "/procedures/" + sp_name;
+        cntl.http_request().SetHeader("Accept", kRowContentType);
+        env->http_channel.CallMethod(NULL, &cntl, NULL, NULL, NULL);
+        ASSERT_FALSE(cntl.Failed()) << cntl.ErrorText();
+        butil::rapidjson::Document document;
+        ASSERT_FALSE(document.Parse(cntl.response_attachment().to_string().c_str()).HasParseError());
+        ASSERT_EQ(0, document["code"].GetInt());
+    }
+
+    ASSERT_TRUE(env->cluster_remote->ExecuteDDL(env->db, "drop procedure " + sp_name + ";", &status));
+    ASSERT_TRUE(env->cluster_remote->ExecuteDDL(env->db, "drop table trans;", &status));
+}
+
+TEST_F(APIServerTest, procedure_many_rows) {
+    const auto env = APIServerTestEnv::Instance();
+
+    std::string ddl = "create table trans(c1 string, c3 int, c4 bigint, c5 float, c6 double, c7 timestamp, "
+                      "c8 date, index(key=c1, ts=c7));";
+    hybridse::sdk::Status status;
+    env->cluster_remote->ExecuteDDL(env->db, "drop table trans;", &status);
+    ASSERT_TRUE(env->cluster_sdk->Refresh());
+    ASSERT_TRUE(env->cluster_remote->ExecuteDDL(env->db, ddl, &status)) << "fail to create table";
+    ASSERT_TRUE(env->cluster_sdk->Refresh());
+
+    std::string sp_name = "sp_many_rows";
+    std::string sp_ddl = "create procedure " + sp_name +
+                         " (const c1 string, const c3 int, c4 bigint, c5 float, c6 double, const c7 timestamp, "
+                         "c8 date) begin SELECT c1, c3, c4, c5, c6, c7, c8, sum(c4) OVER w1 as w1_c4_sum FROM trans "
+                         "WINDOW w1 AS (PARTITION BY trans.c1 ORDER BY trans.c7 ROWS BETWEEN 2 PRECEDING AND "
+                         "CURRENT ROW); end;";
+    ASSERT_TRUE(env->cluster_remote->ExecuteDDL(env->db, sp_ddl, &status)) << "fail to create procedure";
+    ASSERT_TRUE(env->cluster_sdk->Refresh());
+
+    uint32_t row_cnt = 500;
+    std::string body = R"({"common_cols":["bb", 23, 1590738994000], "input": [)";
+    for (uint32_t i = 0; i < row_cnt; i++) {
+        body += (i == 0 ? "" : ",");
+        body += "[" + std::to_string(i) + R"(, 5.1, 6.1, "2021-08-01"])";
+    }
+    body += "]}";
+
+    // the prepared procedure and its encoders are reused by the later requests
+    for (uint32_t i = 0; i < 3; i++) {
+        brpc::Controller cntl;
+        cntl.http_request().set_method(brpc::HTTP_METHOD_POST);
+        cntl.http_request().uri() = "http://127.0.0.1:8010/dbs/" + env->db + "/procedures/" + sp_name;
+        cntl.request_attachment().append(body);
+        env->http_channel.CallMethod(NULL, &cntl, NULL, NULL, NULL);
+        ASSERT_FALSE(cntl.Failed()) << cntl.ErrorText();
+        butil::rapidjson::Document document;
+        ASSERT_FALSE(document.Parse(cntl.response_attachment().to_string().c_str()).HasParseError());
+        ASSERT_EQ(0, document["code"].GetInt()) << cntl.response_attachment().to_string();
+        ASSERT_EQ(row_cnt, document["data"]["data"].Size());
+    }
+
+    ASSERT_TRUE(env->cluster_remote->ExecuteDDL(env->db, "drop procedure " + sp_name + ";", &status));
+    ASSERT_TRUE(env->cluster_remote->ExecuteDDL(env->db, "drop table trans;", &status));
+}
+
 TEST_F(APIServerTest, getDBs) {
     const auto env = APIServerTestEnv::Instance();
     {
@@ -112,6 +112,12 @@ InterfaceProvider& InterfaceProvider::post(const std::string& path, std::functio
     return *this;
 }
 
+InterfaceProvider& InterfaceProvider::post(const std::string& path, std::function<func> callback,
+                                           std::function<binary_func> binary_callback) {
+    registerRequest(brpc::HttpMethod::HTTP_METHOD_POST, path, std::move(callback), std::move(binary_callback));
+    return *this;
+}
+
 bool InterfaceProvider::matching(const Url& received, const Url& registered) {
     auto registeredParts = registered.parsePath();
     auto receivedParts = received.parsePath(true);
@@ -147,13 +153,14 @@ std::unordered_map<std::string, std::string> InterfaceProvider::extractParameter
     return map;
 }
 
-void InterfaceProvider::registerRequest(brpc::HttpMethod type, std::string const& url, std::function<func>&& callback) {
+void InterfaceProvider::registerRequest(brpc::HttpMethod type, std::string const& url, std::function<func>&& callback,
+                                        std::function<binary_func>&& binary_callback) {
     Url parsed;
     if (!ReducedUrlParser::parse(url, &parsed)) {
         LOG(ERROR) << "Fail to parse url " << url;
         return;
     }
-    BuiltRequest req{parsed, callback};
+    BuiltRequest req{parsed, callback, binary_callback};
     requests_[type].push_back(req);
 }
 
@@ -193,5 +200,27 @@ bool InterfaceProvider::handle(const std::string& path, const brpc::HttpMethod&
     request->callback(params, req_body, writer);
     return true;
 }
+
+bool InterfaceProvider::handleBinary(const std::string& path, const brpc::HttpMethod& method,
+                                     const butil::IOBuf& req_body, butil::IOBuf* resp_body) {
+    Url url;
+    if (!ReducedUrlParser::parse(path, &url)) {
+        return false;
+    }
+    auto requestList = requests_.find(method);
+    if (requestList == std::end(requests_)) {
+        return false;
+    }
+    auto request = std::find_if(std::begin(requestList->second), std::end(requestList->second),
+                                [&, this](BuiltRequest const& request) { return matching(url, request.url); });
+    // errors are responded by handle() in json
+    if (request == std::end(requestList->second) || !request->binary_callback) {
+        return false;
+    }
+
+    auto params = extractParameters(url, request->url);
+    request->binary_callback(params, req_body, resp_body);
+    return true;
+}
 }  // namespace apiserver
 }  // namespace openmldb
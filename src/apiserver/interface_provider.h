@@ -117,6 +117,8 @@ class InterfaceProvider {
 
     typedef std::unordered_map<std::string, std::string> Params;
     using func = void(const Params& params, const butil::IOBuf& req_body, JsonWriter& writer);  // NOLINT
+    // binary handlers write the whole response body by themselves, see `handleBinary()`
+    using binary_func = void(const Params& params, const butil::IOBuf& req_body, butil::IOBuf* resp_body);
     /**
      *  Registers a new get request handler.
      *
@@ -144,20 +146,41 @@ class InterfaceProvider {
      */
     InterfaceProvider& post(std::string const& path, std::function<func> callback);
 
+    /**
+     *  Registers a new post request handler which can also respond in binary.
+     *
+     *  @param path The url to listen on. The syntax of is quite complex and documented elsewhere.
+     *  @param callback The function called when a client sends a request on the url.
+     *  @param binary_callback The function called instead of callback when the client accepts the binary response.
+     *
+     */
+    InterfaceProvider& post(std::string const& path, std::function<func> callback,
+                            std::function<binary_func> binary_callback);
+
     bool handle(const std::string& path, const brpc::HttpMethod& method, const butil::IOBuf& req_body,
                 JsonWriter& writer);  // NOLINT
 
+    /**
+     *  Handles the request by the binary handler of the matched url. Returns false if there is no matched url or
+     *  the matched one has no binary handler, the request should be handled by `handle()` then.
+     */
+    bool handleBinary(const std::string& path, const brpc::HttpMethod& method, const butil::IOBuf& req_body,
+                      butil::IOBuf* resp_body);
+
  private:
     struct BuiltRequest {
         Url url;
         std::function<func> callback;
+        // may be empty
+        std::function<binary_func> binary_callback;
     };
 
     static bool matching(const Url& received, const Url& registered);
     static std::unordered_map<std::string, std::string> extractParameters(const Url& received, const Url& registered);
 
  private:
-    void registerRequest(brpc::HttpMethod, const std::string& path, std::function<func>&& callback);
+    void registerRequest(brpc::HttpMethod, const std::string& path, std::function<func>&& callback,
+                         std::function<binary_func>&& binary_callback = nullptr);
 
  private:
     std::unordered_map<int, std::vector<BuiltRequest>> requests_;
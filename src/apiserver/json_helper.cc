@@ -322,5 +322,10 @@ JsonWriter& JsonWriter::SetNull() {
     WRITER->Null();
     return *this;
 }
+
+JsonWriter& JsonWriter::String(const char* s, size_t length) {
+    WRITER->String(s, static_cast<SizeType>(length));
+    return *this;
+}
 }  // namespace apiserver
 }  // namespace openmldb
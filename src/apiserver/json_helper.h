@@ -115,6 +115,8 @@ class JsonWriter {
     JsonWriter& operator&(const double& d);
     JsonWriter& operator&(const std::string& s);
     JsonWriter& SetNull();
+    // write a string value without copying it into std::string
+    JsonWriter& String(const char* s, size_t length);
 
     static const bool IsReader = false;
     static const bool IsWriter = !IsReader;
@@ -0,0 +1,488 @@
+/*
+ * Copyright 2021 4Paradigm
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apiserver/json_row_codec.h"
+
+#include <cstdlib>
+#include <limits>
+#include <string>
+
+#include "glog/logging.h"
+#include "json2pb/rapidjson.h"
+
+namespace openmldb {
+namespace apiserver {
+
+using butil::rapidjson::SizeType;
+
+class JsonRowDecoder::Handler
+    : public butil::rapidjson::BaseReaderHandler<butil::rapidjson::UTF8<>, JsonRowDecoder::Handler> {
+ public:
+    Handler(std::vector<JsonScalar>* common_values, std::vector<JsonScalar>* input_values, uint32_t input_width)
+        : common_values_(common_values), input_values_(input_values), input_width_(input_width) {}
+
+    bool Null() { return AddScalar(JsonScalar()); }
+    bool Bool(bool b) {
+        if (member_ == kNeedSchema && depth_ == 1) {
+            need_schema_ = b;
+            member_ = kNone;
+            return true;
+        }
+        JsonScalar v;
+        v.kind = JsonScalar::kBool;
+        v.b = b;
+        return AddScalar(v);
+    }
+    bool Int(int i) { return AddInt(i, true, true); }
+    bool Uint(unsigned u) { return AddInt(u, u <= static_cast<unsigned>(std::numeric_limits<int32_t>::max()), true); }
+    bool Int64(int64_t i) { return AddInt(i, false, true); }
+    bool Uint64(uint64_t u) {
+        return AddInt(static_cast<int64_t>(u), false, u <= static_cast<uint64_t>(std::numeric_limits<int64_t>::max()));
+    }
+    bool Double(double d) {
+        JsonScalar v;
+        v.kind = JsonScalar::kDouble;
+        v.d = d;
+        return AddScalar(v);
+    }
+    bool String(const char* str, SizeType len, bool) {
+        JsonScalar v;
+        v.kind = JsonScalar::kString;
+        v.str = str;
+        v.len = len;
+        return AddScalar(v);
+    }
+
+    bool StartObject() {
+        if (skip_depth_ > 0) {
+            ++skip_depth_;
+            return true;
+        }
+        if (depth_ == 0) {
+            depth_ = 1;
+            return true;
+        }
+        if (depth_ == 1 && member_ != kCommonCols && member_ != kInput) {
+            member_ = kNone;
+            skip_depth_ = 1;
+            return true;
+        }
+        return FailNested();
+    }
+    bool Key(const char* str, SizeType len, bool) {
+        if (skip_depth_ > 0) {
+            return true;
+        }
+        if (Equals(str, len, "common_cols")) {
+            member_ = kCommonCols;
+            common_values_->clear();
+        } else if (Equals(str, len, "input")) {
+            member_ = kInput;
+            input_values_->clear();
+            rows_ = 0;
+        } else if (Equals(str, len, "need_schema")) {
+            member_ = kNeedSchema;
+        } else {
+            member_ = kOther;
+        }
+        return true;
+    }
+    bool EndObject(SizeType) {
+        if (skip_depth_ > 0) {
+            if (--skip_depth_ == 0) {
+                member_ = kNone;
+            }
+            return true;
+        }
+        depth_ = 0;
+        return true;
+    }
+
+    bool StartArray() {
+        if (skip_depth_ > 0) {
+            ++skip_depth_;
+            return true;
+        }
+        if (depth_ == 1) {
+            switch (member_) {
+                case kCommonCols:
+                case kInput:
+                    has_input_ |= member_ == kInput;
+                    depth_ = 2;
+                    return true;
+                default:
+                    member_ = kNone;
+                    skip_depth_ = 1;
+                    return true;
+            }
+        }
+        if (depth_ == 2 && member_ == kInput) {
+            depth_ = 3;
+            row_width_ = 0;
+            return true;
+        }
+        return FailNested();
+    }
+    bool EndArray(SizeType) {
+        if (skip_depth_ > 0) {
+            if (--skip_depth_ == 0) {
+                member_ = kNone;
+            }
+            return true;
+        }
+        if (depth_ == 3) {
+            if (row_width_ != input_width_) {
+                return Fail("Invalid input data row");
+            }
+            ++rows_;
+            depth_ = 2;
+            return true;
+        }
+        depth_ = 1;
+        member_ = kNone;
+        return true;
+    }
+
+    inline bool NeedSchema() const { return need_schema_; }
+    inline bool HasInput() const { return has_input_; }
+    inline uint32_t GetRows() const { return rows_; }
+    inline const std::string& GetError() const { return error_; }
+
+ private:
+    enum Member { kNone, kCommonCols, kInput, kNeedSchema, kOther };
+
+    static bool Equals(const char* str, SizeType len, const char* name) {
+        return len == strlen(name) && memcmp(str, name, len) == 0;
+    }
+
+    bool Fail(const std::string& msg) {
+        error_ = msg;
+        return false;
+    }
+
+    // an object or array is found where a value or row is expected
+    bool FailNested() {
+        if (depth_ == 0) {
+            return Fail("Json parse failed");
+        } else if (depth_ == 1) {
+            return Fail(member_ == kInput ? "Invalid input" : "common_cols is not array");
+        } else if (depth_ == 2 && member_ == kInput) {
+            return Fail("Invalid input data row");
+        }
+        return Fail("Translate to request row failed");
+    }
+
+    bool AddInt(int64_t i, bool is_int32, bool is_int64) {
+        JsonScalar v;
+        v.kind = JsonScalar::kInt;
+        v.i = i;
+        v.is_int32 = is_int32;
+        v.is_int64 = is_int64;
+        return AddScalar(v);
+    }
+
+    bool AddScalar(const JsonScalar& v) {
+        if (skip_depth_ > 0) {
+            return true;
+        }
+        if (depth_ == 0) {
+            return Fail("Json parse failed");
+        }
+        if (depth_ == 1) {
+            switch (member_) {
+                case kCommonCols:
+                    return Fail("common_cols is not array");
+                case kInput:
+                    return Fail("Invalid input");
+                default:
+                    member_ = kNone;
+                    return true;
+            }
+        }
+        if (depth_ == 2 && member_ == kCommonCols) {
+            common_values_->push_back(v);
+            return true;
+        }
+        if (depth_ == 3) {
+            if (++row_width_ > input_width_) {
+                return Fail("Invalid input data row");
+            }
+            input_values_->push_back(v);
+            return true;
+        }
+        return Fail("Invalid input data row");
+    }
+
+    std::vector<JsonScalar>* common_values_;
+    std::vector<JsonScalar>* input_values_;
+    uint32_t input_width_;
+    Member member_ = kNone;
+    // 1 is in the request object, 2 is in common_cols or input, 3 is in an input row
+    uint32_t depth_ = 0;
+    // > 0 if we are in a value of an unknown member
+    uint32_t skip_depth_ = 0;
+    uint32_t row_width_ = 0;
+    uint32_t rows_ = 0;
+    bool need_schema_ = false;
+    bool has_input_ = false;
+    std::string error_;
+};
+
+JsonRowEncoder::JsonRowEncoder(const codec::Schema& schema) : layout_(schema), not_null_() {
+    for (const auto& column : schema) {
+        not_null_.push_back(column.not_null());
+    }
+}
+
+bool JsonRowEncoder::Encode(const JsonScalar* values, std::string* row) const {
+    uint32_t cnt = layout_.GetFieldCnt();
+    uint32_t str_len_sum = 0;
+    for (uint32_t i = 0; i < cnt; ++i) {
+        if (layout_.IsString(i) && values[i].kind == JsonScalar::kString) {
+            str_len_sum += values[i].len;
+        }
+    }
+    uint8_t addr_length = 0;
+    uint32_t total_size = layout_.CalTotalLength(str_len_sum, &addr_length);
+    row->resize(total_size);
+    int8_t* buf = reinterpret_cast<int8_t*>(&(*row)[0]);
+    uint32_t str_offset = layout_.InitRow(buf, total_size, addr_length);
+    for (uint32_t i = 0; i < cnt; ++i) {
+        if (!SetScalar(values[i], i, addr_length, buf, &str_offset)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool JsonRowEncoder::SetScalar(const JsonScalar& v, uint32_t idx, uint8_t addr_length, int8_t* row,
+                               uint32_t* str_offset) const {
+    if (v.kind == JsonScalar::kNull) {
+        if (not_null_[idx]) {
+            return false;
+        }
+        if (layout_.IsString(idx)) {
+            layout_.SetNULLString(row, idx, addr_length, *str_offset);
+        }
+        return true;
+    }
+    switch (layout_.GetType(idx)) {
+        case ::openmldb::type::kBool: {
+            if (v.kind != JsonScalar::kBool) {
+                return false;
+            }
+            layout_.SetField<uint8_t>(row, idx, v.b ? 1 : 0);
+            return true;
+        }
+        case ::openmldb::type::kSmallInt: {
+            if (v.kind != JsonScalar::kInt || !v.is_int32 || v.i < std::numeric_limits<int16_t>::min() ||
+                v.i > std::numeric_limits<int16_t>::max()) {
+                return false;
+            }
+            layout_.SetField<int16_t>(row, idx, static_cast<int16_t>(v.i));
+            return true;
+        }
+        case ::openmldb::type::kInt: {
+            if (v.kind != JsonScalar::kInt || !v.is_int32) {
+                return false;
+            }
+            layout_.SetField<int32_t>(row, idx, static_cast<int32_t>(v.i));
+            return true;
+        }
+        case ::openmldb::type::kBigInt:
+        case ::openmldb::type::kTimestamp: {
+            if (v.kind != JsonScalar::kInt || !v.is_int64) {
+                return false;
+            }
+            layout_.SetField<int64_t>(row, idx, v.i);
+            return true;
+        }
+        case ::openmldb::type::kFloat: {
+            if (v.kind != JsonScalar::kDouble) {
+                return false;
+            }
+            layout_.SetField<float>(row, idx, static_cast<float>(v.d));
+            return true;
+        }
+        case ::openmldb::type::kDouble: {
+            if (v.kind != JsonScalar::kDouble) {
+                return false;
+            }
+            layout_.SetField<double>(row, idx, v.d);
+            return true;
+        }
+        case ::openmldb::type::kString:
+        case ::openmldb::type::kVarchar: {
+            if (v.kind != JsonScalar::kString) {
+                return false;
+            }
+            layout_.SetString(row, idx, addr_length, v.str, v.len, str_offset);
+            return true;
+        }
+        case ::openmldb::type::kDate: {
+            if (v.kind != JsonScalar::kString) {
+                return false;
+            }
+            // yyyy-mm-dd, the in situ string is null-terminated
+            char* end = nullptr;
+            int64_t year = strtol(v.str, &end, 10);
+            if (end == v.str || *end != '-') {
+                return false;
+            }
+            const char* pos = end + 1;
+            int64_t month = strtol(pos, &end, 10);
+            if (end == pos || *end != '-') {
+                return false;
+            }
+            pos = end + 1;
+            int64_t day = strtol(pos, &end, 10);
+            if (end == pos || end != v.str + v.len) {
+                return false;
+            }
+            // keep the same as SQLRequestRow, an invalid date is encoded as 0
+            int32_t date = 0;
+            if (year >= 1900 && year <= 9999 && month >= 1 && month <= 12 && day >= 1 && day <= 31) {
+                date = static_cast<int32_t>(((year - 1900) << 16) | ((month - 1) << 8) | day);
+            }
+            layout_.SetField<int32_t>(row, idx, date);
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+JsonRowDecoder::JsonRowDecoder(const JsonRowEncoder& common_encoder, const JsonRowEncoder& non_common_encoder)
+    : common_encoder_(common_encoder),
+      non_common_encoder_(non_common_encoder),
+      common_values_(),
+      input_values_(),
+      common_row_(),
+      non_common_rows_(),
+      need_schema_(false) {}
+
+bool JsonRowDecoder::Decode(char* body, std::string* msg) {
+    common_row_.clear();
+    non_common_rows_.clear();
+    common_values_.clear();
+    input_values_.clear();
+    uint32_t common_cnt = common_encoder_.GetColumnCnt();
+    uint32_t non_common_cnt = non_common_encoder_.GetColumnCnt();
+    Handler handler(&common_values_, &input_values_, non_common_cnt);
+    butil::rapidjson::Reader reader;
+    butil::rapidjson::InsituStringStream stream(body);
+    if (reader.Parse<butil::rapidjson::kParseInsituFlag>(stream, handler).IsError()) {
+        *msg = handler.GetError().empty() ? "Json parse failed" : handler.GetError();
+        return false;
+    }
+    need_schema_ = handler.NeedSchema();
+    if (!handler.HasInput() || handler.GetRows() == 0) {
+        *msg = "Invalid input";
+        return false;
+    }
+    if (common_values_.size() != common_cnt) {
+        *msg = "Invalid common cols size";
+        return false;
+    }
+    if (common_cnt > 0 && !common_encoder_.Encode(common_values_.data(), &common_row_)) {
+        *msg = "Translate to request row failed";
+        return false;
+    }
+    non_common_rows_.resize(handler.GetRows());
+    if (non_common_cnt == 0) {
+        return true;
+    }
+    for (uint32_t i = 0; i < handler.GetRows(); ++i) {
+        if (!non_common_encoder_.Encode(input_values_.data() + static_cast<size_t>(i) * non_common_cnt,
+                                        &non_common_rows_[i])) {
+            *msg = "Translate to request row failed";
+            return false;
+        }
+    }
+    return true;
+}
+
+JsonRowWriter::JsonRowWriter(const hybridse::codec::Schema& schema) : row_view_(schema), types_(), not_null_() {
+    for (const auto& column : schema) {
+        types_.push_back(column.type());
+        not_null_.push_back(column.is_not_null());
+    }
+}
+
+void JsonRowWriter::WriteValue(JsonWriter& ar, uint32_t idx) {  // NOLINT
+    if (row_view_.IsNULL(idx)) {
+        if (not_null_[idx]) {
+            LOG(ERROR) << "Value in column " << idx << " is null but it can't be null";
+        }
+        ar.SetNull();
+        return;
+    }
+    switch (types_[idx]) {
+        case hybridse::type::kInt32: {
+            ar& row_view_.GetInt32Unsafe(idx);
+            break;
+        }
+        case hybridse::type::kInt64: {
+            ar& row_view_.GetInt64Unsafe(idx);
+            break;
+        }
+        case hybridse::type::kInt16: {
+            ar& static_cast<int>(row_view_.GetInt16Unsafe(idx));
+            break;
+        }
+        case hybridse::type::kFloat: {
+            ar& static_cast<double>(row_view_.GetFloatUnsafe(idx));
+            break;
+        }
+        case hybridse::type::kDouble: {
+            ar& row_view_.GetDoubleUnsafe(idx);
+            break;
+        }
+        case hybridse::type::kVarchar: {
+            const char* val = nullptr;
+            uint32_t length = 0;
+            row_view_.GetString(idx, &val, &length);
+            ar.String(val, length);
+            break;
+        }
+        case hybridse::type::kTimestamp: {
+            ar& row_view_.GetTimestampUnsafe(idx);
+            break;
+        }
+        case hybridse::type::kDate: {
+            int32_t year = 0;
+            int32_t month = 0;
+            int32_t day = 0;
+            row_view_.GetDate(idx, &year, &month, &day);
+            char buf[32];
+            int len = snprintf(buf, sizeof(buf), "%d-%d-%d", year, month, day);
+            ar.String(buf, len);
+            break;
+        }
+        case hybridse::type::kBool: {
+            ar& row_view_.GetBoolUnsafe(idx);
+            break;
+        }
+        default: {
+            LOG(ERROR) << "Invalid Column Type";
+            ar & "NA";
+            break;
+        }
+    }
+}
+
+}  // namespace apiserver
+}  // namespace openmldb
@@ -0,0 +1,116 @@
+/*
+ * Copyright 2021 4Paradigm
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SRC_APISERVER_JSON_ROW_CODEC_H_
+#define SRC_APISERVER_JSON_ROW_CODEC_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "apiserver/json_helper.h"
+#include "codec/codec.h"
+#include "codec/fe_row_codec.h"
+#include "codec/row_layout.h"
+
+namespace openmldb {
+namespace apiserver {
+
+// A json scalar kept by JsonRowDecoder until its row is complete. Strings point into the parsed body.
+struct JsonScalar {
+    enum Kind { kNull, kBool, kInt, kDouble, kString };
+    Kind kind = kNull;
+    // only valid for kInt, whether the number fits in int32 / int64
+    bool is_int32 = false;
+    bool is_int64 = false;
+    bool b = false;
+    int64_t i = 0;
+    double d = 0;
+    const char* str = nullptr;
+    uint32_t len = 0;
+};
+
+// JsonRowEncoder encodes the json scalars of a row with the layout of a schema. It's immutable once built, so the
+// encoders of a procedure are built once and shared by all the requests of it.
+class JsonRowEncoder {
+ public:
+    explicit JsonRowEncoder(const codec::Schema& schema);
+
+    inline bool IsValid() const { return layout_.IsValid(); }
+    inline uint32_t GetColumnCnt() const { return layout_.GetFieldCnt(); }
+
+    // values has GetColumnCnt() scalars. Returns false if a value doesn't match the type of its column
+    bool Encode(const JsonScalar* values, std::string* row) const;
+
+ private:
+    bool SetScalar(const JsonScalar& v, uint32_t idx, uint8_t addr_length, int8_t* row, uint32_t* str_offset) const;
+
+    codec::RowLayout layout_;
+    std::vector<bool> not_null_;
+};
+
+// JsonRowDecoder decodes the ExecSP request body
+//   {"common_cols": [...], "input": [[...], ...], "need_schema": true}
+// with the rapidjson SAX reader and encodes the values by JsonRowEncoder, no json document is built.
+// The common row and every input row are encoded with the common and non-common columns of the request schema
+// respectively, which is the layout SQLRequestRowBatch sends.
+class JsonRowDecoder {
+ public:
+    // the encoders of the common and non-common columns of the request schema, they must outlive the decoder
+    JsonRowDecoder(const JsonRowEncoder& common_encoder, const JsonRowEncoder& non_common_encoder);
+
+    // body is parsed in situ, it's modified and must be null-terminated. Returns false and sets msg if the body is
+    // not a valid request.
+    bool Decode(char* body, std::string* msg);
+
+    inline const std::string& GetCommonRow() const { return common_row_; }
+    inline std::vector<std::string>& GetNonCommonRows() { return non_common_rows_; }
+    inline bool NeedSchema() const { return need_schema_; }
+
+ private:
+    // rapidjson SAX handler, it collects the scalars of common_cols and input
+    class Handler;
+
+    const JsonRowEncoder& common_encoder_;
+    const JsonRowEncoder& non_common_encoder_;
+    std::vector<JsonScalar> common_values_;
+    std::vector<JsonScalar> input_values_;
+    std::string common_row_;
+    std::vector<std::string> non_common_rows_;
+    bool need_schema_;
+};
+
+// JsonRowWriter writes the columns of an encoded row as json values. The column types are resolved from the
+// schema once, the values are read from the row bytes directly and strings are written without copies.
+class JsonRowWriter {
+ public:
+    explicit JsonRowWriter(const hybridse::codec::Schema& schema);
+
+    void Reset(const int8_t* row, uint32_t size) { row_view_.Reset(row, size); }
+
+    // write the value of column idx of the current row
+    void WriteValue(JsonWriter& ar, uint32_t idx);  // NOLINT
+
+ private:
+    hybridse::codec::RowView row_view_;
+    std::vector<hybridse::type::Type> types_;
+    std::vector<bool> not_null_;
+};
+
+}  // namespace apiserver
+}  // namespace openmldb
+
+#endif  // SRC_APISERVER_JSON_ROW_CODEC_H_
@@ -0,0 +1,117 @@
+/*
+ * Copyright 2021 4Paradigm
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string>
+#include <vector>
+
+#include "apiserver/json_row_codec.h"
+#include "benchmark/benchmark.h"
+#include "catalog/schema_adapter.h"
+
+namespace openmldb {
+namespace apiserver {
+
+static void AddColumn(codec::Schema* schema, const std::string& name, type::DataType data_type) {
+    auto* col = schema->Add();
+    col->set_name(name);
+    col->set_data_type(data_type);
+}
+
+// the ExecSP body of the procedure (const c1 string, const c3 int, c4 bigint, c5 float, c6 double,
+// const c7 timestamp, c8 date) with row_cnt input rows
+static std::string BuildBody(uint32_t row_cnt) {
+    std::string body = R"({"common_cols": ["bb", 23, 1590738994000], "input": [)";
+    for (uint32_t i = 0; i < row_cnt; i++) {
+        body += (i == 0 ? "" : ",");
+        body += "[" + std::to_string(i) + R"(, 5.1, 6.1, "2021-08-01"])";
+    }
+    body += "]}";
+    return body;
+}
+
+static void BM_DecodeRequest(benchmark::State& state) {  // NOLINT
+    codec::Schema common_schema;
+    codec::Schema non_common_schema;
+    AddColumn(&common_schema, "c1", type::kString);
+    AddColumn(&common_schema, "c3", type::kInt);
+    AddColumn(&common_schema, "c7", type::kTimestamp);
+    AddColumn(&non_common_schema, "c4", type::kBigInt);
+    AddColumn(&non_common_schema, "c5", type::kFloat);
+    AddColumn(&non_common_schema, "c6", type::kDouble);
+    AddColumn(&non_common_schema, "c8", type::kDate);
+    JsonRowEncoder common_encoder(common_schema);
+    JsonRowEncoder non_common_encoder(non_common_schema);
+    std::string body = BuildBody(state.range(0));
+    std::string msg;
+    for (auto _ : state) {
+        std::string buf = body;
+        JsonRowDecoder decoder(common_encoder, non_common_encoder);
+        if (!decoder.Decode(&buf[0], &msg)) {
+            state.SkipWithError(msg.c_str());
+            break;
+        }
+        benchmark::DoNotOptimize(decoder.GetNonCommonRows().data());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void BM_WriteResponse(benchmark::State& state) {  // NOLINT
+    codec::Schema schema;
+    AddColumn(&schema, "c1", type::kString);
+    AddColumn(&schema, "c3", type::kInt);
+    AddColumn(&schema, "c4", type::kBigInt);
+    AddColumn(&schema, "c6", type::kDouble);
+    AddColumn(&schema, "c7", type::kTimestamp);
+    AddColumn(&schema, "w1_c4_sum", type::kBigInt);
+    hybridse::codec::Schema sql_schema;
+    catalog::SchemaAdapter::ConvertSchema(schema, &sql_schema);
+    std::vector<std::string> rows;
+    codec::RowBuilder builder(schema);
+    std::string str = "bb";
+    for (int64_t i = 0; i < state.range(0); i++) {
+        std::string row(builder.CalTotalLength(str.size()), '\0');
+        builder.SetBuffer(reinterpret_cast<int8_t*>(&row[0]), row.size());
+        builder.AppendString(str.c_str(), str.size());
+        builder.AppendInt32(23);
+        builder.AppendInt64(i);
+        builder.AppendDouble(6.1);
+        builder.AppendTimestamp(1590738994000l);
+        builder.AppendInt64(i * 3);
+        rows.push_back(std::move(row));
+    }
+    JsonRowWriter row_writer(sql_schema);
+    for (auto _ : state) {
+        JsonWriter writer;
+        writer.StartArray();
+        for (const auto& row : rows) {
+            row_writer.Reset(reinterpret_cast<const int8_t*>(row.data()), row.size());
+            writer.StartArray();
+            for (int i = 0; i < sql_schema.size(); i++) {
+                row_writer.WriteValue(writer, i);
+            }
+            writer.EndArray();
+        }
+        writer.EndArray();
+        benchmark::DoNotOptimize(writer.GetString());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK(BM_DecodeRequest)->ArgNames({"rows"})->Arg(1)->Arg(100)->Arg(10000);
+BENCHMARK(BM_WriteResponse)->ArgNames({"rows"})->Arg(1)->Arg(100)->Arg(10000);
+
+}  // namespace apiserver
+}  // namespace openmldb
@@ -0,0 +1,243 @@
+/*
+ * Copyright 2021 4Paradigm
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apiserver/json_row_codec.h"
+
+#include <string>
+
+#include "catalog/schema_adapter.h"
+#include "gtest/gtest.h"
+#include "json2pb/rapidjson.h"
+
+namespace openmldb {
+namespace apiserver {
+
+class JsonRowCodecTest : public ::testing::Test {
+ public:
+    JsonRowCodecTest() {}
+    ~JsonRowCodecTest() {}
+};
+
+void AddColumn(codec::Schema* schema, const std::string& name, type::DataType data_type, bool not_null = false) {
+    auto* col = schema->Add();
+    col->set_name(name);
+    col->set_data_type(data_type);
+    col->set_not_null(not_null);
+}
+
+// common: c1 string, c3 int, c7 timestamp. non-common: c4 bigint, c5 float, c6 double, c8 date
+void BuildSchema(codec::Schema* common_schema, codec::Schema* non_common_schema) {
+    AddColumn(common_schema, "c1", type::kString);
+    AddColumn(common_schema, "c3", type::kInt);
+    AddColumn(common_schema, "c7", type::kTimestamp);
+    AddColumn(non_common_schema, "c4", type::kBigInt, true);
+    AddColumn(non_common_schema, "c5", type::kFloat);
+    AddColumn(non_common_schema, "c6", type::kDouble);
+    AddColumn(non_common_schema, "c8", type::kDate);
+}
+
+TEST_F(JsonRowCodecTest, Decode) {
+    codec::Schema common_schema;
+    codec::Schema non_common_schema;
+    BuildSchema(&common_schema, &non_common_schema);
+    JsonRowEncoder common_encoder(common_schema);
+    JsonRowEncoder non_common_encoder(non_common_schema);
+    JsonRowDecoder decoder(common_encoder, non_common_encoder);
+    std::string msg;
+    // the order of members doesn't matter, unknown members are skipped
+    std::string body = R"({
+        "input": [[123, 5.1, 6.1, "2021-08-01"], [234, null, 6.2, "2021-08-02"]],
+        "other": {"a": [1, [2]], "b": "c"},
+        "common_cols": ["bb", 23, 1590738994000],
+        "need_schema": true
+    })";
+    ASSERT_TRUE(decoder.Decode(&body[0], &msg)) << msg;
+    ASSERT_TRUE(decoder.NeedSchema());
+    ASSERT_EQ(2u, decoder.GetNonCommonRows().size());
+
+    codec::RowView common_view(common_schema);
+    const auto& common_row = decoder.GetCommonRow();
+    ASSERT_TRUE(common_view.Reset(reinterpret_cast<const int8_t*>(common_row.data()), common_row.size()));
+    std::string str;
+    ASSERT_EQ(0, common_view.GetStrValue(0, &str));
+    ASSERT_EQ("bb", str);
+    int32_t i32 = 0;
+    ASSERT_EQ(0, common_view.GetInt32(1, &i32));
+    ASSERT_EQ(23, i32);
+    int64_t ts = 0;
+    ASSERT_EQ(0, common_view.GetTimestamp(2, &ts));
+    ASSERT_EQ(1590738994000l, ts);
+
+    codec::RowView view(non_common_schema);
+    auto& rows = decoder.GetNonCommonRows();
+    ASSERT_TRUE(view.Reset(reinterpret_cast<const int8_t*>(rows[0].data()), rows[0].size()));
+    int64_t i64 = 0;
+    ASSERT_EQ(0, view.GetInt64(0, &i64));
+    ASSERT_EQ(123, i64);
+    float f = 0;
+    ASSERT_EQ(0, view.GetFloat(1, &f));
+    ASSERT_FLOAT_EQ(5.1f, f);
+    double d = 0;
+    ASSERT_EQ(0, view.GetDouble(2, &d));
+    ASSERT_DOUBLE_EQ(6.1, d);
+    uint32_t year = 0, month = 0, day = 0;
+    ASSERT_EQ(0, view.GetDate(3, &year, &month, &day));
+    ASSERT_EQ(2021u, year);
+    ASSERT_EQ(8u, month);
+    ASSERT_EQ(1u, day);
+    ASSERT_TRUE(view.Reset(reinterpret_cast<const int8_t*>(rows[1].data()), rows[1].size()));
+    ASSERT_TRUE(view.IsNULL(1));
+    ASSERT_EQ(0, view.GetDouble(2, &d));
+    ASSERT_DOUBLE_EQ(6.2, d);
+}
+
+TEST_F(JsonRowCodecTest, DecodeInvalid) {
+    codec::Schema common_schema;
+    codec::Schema non_common_schema;
+    BuildSchema(&common_schema, &non_common_schema);
+    JsonRowEncoder common_encoder(common_schema);
+    JsonRowEncoder non_common_encoder(non_common_schema);
+    JsonRowDecoder decoder(common_encoder, non_common_encoder);
+    std::vector<std::pair<std::string, std::string>> cases = {
+        {R"({"common_cols": ["bb", 23, 1590738994000], "input": [[123, 5.1, 6.1, "2021-08-01"])",
+         "Json parse failed"},
+        {R"({"common_cols": ["bb", 23, 1590738994000]})", "Invalid input"},
+        {R"({"common_cols": ["bb", 23, 1590738994000], "input": []})", "Invalid input"},
+        {R"({"common_cols": ["bb", 23, 1590738994000], "input": 1})", "Invalid input"},
+        {R"({"common_cols": "bb", "input": [[123, 5.1, 6.1, "2021-08-01"]]})", "common_cols is not array"},
+        {R"({"common_cols": ["bb", 23], "input": [[123, 5.1, 6.1, "2021-08-01"]]})", "Invalid common cols size"},
+        {R"({"common_cols": ["bb", 23, 1590738994000], "input": [[123, 5.1, 6.1]]})", "Invalid input data row"},
+        {R"({"common_cols": ["bb", 23, 1590738994000], "input": [[123, 5.1, 6.1, "2021-08-01", 1]]})",
+         "Invalid input data row"},
+        {R"({"common_cols": ["bb", 23, 1590738994000], "input": [123]})", "Invalid input data row"},
+        // c4 is not null
+        {R"({"common_cols": ["bb", 23, 1590738994000], "input": [[null, 5.1, 6.1, "2021-08-01"]]})",
+         "Translate to request row failed"},
+        // c3 int overflow
+        {R"({"common_cols": ["bb", 3000000000, 1590738994000], "input": [[123, 5.1, 6.1, "2021-08-01"]]})",
+         "Translate to request row failed"},
+        // c5 float should be a double literal
+        {R"({"common_cols": ["bb", 23, 1590738994000], "input": [[123, 5, 6.1, "2021-08-01"]]})",
+         "Translate to request row failed"},
+        {R"({"common_cols": ["bb", 23, 1590738994000], "input": [[123, 5.1, 6.1, "2021/08/01"]]})",
+         "Translate to request row failed"},
+    };
+    for (auto& c : cases) {
+        std::string msg;
+        std::string body = c.first;
+        ASSERT_FALSE(decoder.Decode(&body[0], &msg)) << c.first;
+        ASSERT_EQ(c.second, msg) << c.first;
+    }
+}
+
+TEST_F(JsonRowCodecTest, WriteRow) {
+    hybridse::codec::Schema schema;
+    auto add_column = [&schema](const std::string& name, hybridse::type::Type type) {
+        auto* col = schema.Add();
+        col->set_name(name);
+        col->set_type(type);
+    };
+    add_column("c1", hybridse::type::kVarchar);
+    add_column("c2", hybridse::type::kInt16);
+    add_column("c3", hybridse::type::kInt32);
+    add_column("c4", hybridse::type::kInt64);
+    add_column("c5", hybridse::type::kFloat);
+    add_column("c6", hybridse::type::kDouble);
+    add_column("c7", hybridse::type::kTimestamp);
+    add_column("c8", hybridse::type::kDate);
+    add_column("c9", hybridse::type::kBool);
+    add_column("c10", hybridse::type::kVarchar);
+    codec::Schema openmldb_schema;
+    ASSERT_TRUE(catalog::SchemaAdapter::ConvertSchema(schema, &openmldb_schema));
+
+    std::string str = "hello";
+    codec::RowBuilder builder(openmldb_schema);
+    uint32_t size = builder.CalTotalLength(str.size());
+    std::string row(size, '\0');
+    builder.SetBuffer(reinterpret_cast<int8_t*>(&row[0]), size);
+    ASSERT_TRUE(builder.AppendString(str.c_str(), str.size()));
+    ASSERT_TRUE(builder.AppendInt16(2));
+    ASSERT_TRUE(builder.AppendInt32(3));
+    ASSERT_TRUE(builder.AppendInt64(4));
+    ASSERT_TRUE(builder.AppendFloat(5.5));
+    ASSERT_TRUE(builder.AppendDouble(6.5));
+    ASSERT_TRUE(builder.AppendTimestamp(1590738994000l));
+    ASSERT_TRUE(builder.AppendDate(2021, 8, 1));
+    ASSERT_TRUE(builder.AppendBool(false));
+    ASSERT_TRUE(builder.AppendNULL());
+
+    JsonRowWriter row_writer(schema);
+    row_writer.Reset(reinterpret_cast<const int8_t*>(row.data()), row.size());
+    JsonWriter writer;
+    writer.StartArray();
+    for (int i = 0; i < schema.size(); i++) {
+        row_writer.WriteValue(writer, i);
+    }
+    writer.EndArray();
+
+    butil::rapidjson::Document document;
+    ASSERT_FALSE(document.Parse(writer.GetString()).HasParseError()) << writer.GetString();
+    ASSERT_EQ(10u, document.Size());
+    ASSERT_STREQ("hello", document[0].GetString());
+    ASSERT_EQ(2, document[1].GetInt());
+    ASSERT_EQ(3, document[2].GetInt());
+    ASSERT_EQ(4, document[3].GetInt64());
+    ASSERT_DOUBLE_EQ(5.5, document[4].GetDouble());
+    ASSERT_DOUBLE_EQ(6.5, document[5].GetDouble());
+    ASSERT_EQ(1590738994000l, document[6].GetInt64());
+    ASSERT_STREQ("2021-8-1", document[7].GetString());
+    ASSERT_FALSE(document[8].GetBool());
+    ASSERT_TRUE(document[9].IsNull());
+}
+
+TEST_F(JsonRowCodecTest, DecodeReuse) {
+    codec::Schema common_schema;
+    codec::Schema non_common_schema;
+    BuildSchema(&common_schema, &non_common_schema);
+    uint32_t row_cnt = 1000;
+    std::string body = R"({"common_cols": ["bb", 23, 1590738994000], "input": [)";
+    for (uint32_t i = 0; i < row_cnt; i++) {
+        body += (i == 0 ? "" : ",");
+        body += "[" + std::to_string(i) + R"(, 5.1, 6.1, "2021-08-01"])";
+    }
+    body += "]}";
+    // the encoders are shared by the decoders of all requests
+    JsonRowEncoder common_encoder(common_schema);
+    JsonRowEncoder non_common_encoder(non_common_schema);
+    codec::RowView view(non_common_schema);
+    for (uint32_t i = 0; i < 3; i++) {
+        JsonRowDecoder decoder(common_encoder, non_common_encoder);
+        std::string buf = body;
+        std::string msg;
+        ASSERT_TRUE(decoder.Decode(&buf[0], &msg)) << msg;
+        auto& rows = decoder.GetNonCommonRows();
+        ASSERT_EQ(row_cnt, rows.size());
+        for (uint32_t j = 0; j < row_cnt; j++) {
+            ASSERT_TRUE(view.Reset(reinterpret_cast<const int8_t*>(rows[j].data()), rows[j].size()));
+            int64_t i64 = 0;
+            ASSERT_EQ(0, view.GetInt64(0, &i64));
+            ASSERT_EQ(j, static_cast<uint32_t>(i64));
+        }
+    }
+}
+
+}  // namespace apiserver
+}  // namespace openmldb
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
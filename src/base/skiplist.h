@@ -253,6 +253,11 @@ class Skiplist {
 
     Node<K, V>* GetLast() { return tail_.load(std::memory_order_acquire); }
 
+    Node<K, V>* GetFirst() { return head_->GetNext(0); }
+
+    // the first node whose key is not less than key, NULL if there is none
+    Node<K, V>* LowerBound(const K& key) { return FindLessThan(key)->GetNext(0); }
+
     uint32_t GetSize() {
         uint32_t cnt = 0;
         Node<K, V>* node = head_->GetNext(0);
@@ -291,12 +296,12 @@ class Skiplist {
         return cnt;
     }
 
-    // Need external synchronized
-    bool AddToFirst(const K& key, V& value) {  // NOLINT
+    // Need external synchronized, return the height of new node or 0 if key is after the first node
+    uint8_t AddToFirst(const K& key, V& value) {  // NOLINT
         {
             Node<K, V>* node = head_->GetNext(0);
             if (node != NULL && compare_(key, node->GetKey()) > 0) {
-                return false;
+                return 0;
             }
         }
         uint8_t height = RandomHeight();
@@ -315,7 +320,7 @@ class Skiplist {
             node->SetNextNoBarrier(i, pre[i]->GetNextNoBarrier(i));
             pre[i]->SetNext(i, node);
         }
-        return true;
+        return height;
     }
 
     class Iterator {
@@ -440,7 +445,8 @@ class Skiplist {
         uint64_t cnt = 0;
         while (node != NULL) {
             if (cnt == pos) {
-                tail_.store(pre, std::memory_order_release);
+                pre == head_ ? tail_.store(NULL, std::memory_order_release)
+                             : tail_.store(pre, std::memory_order_release);
                 for (uint8_t i = 0; i < pre->Height(); i++) {
                     pre->SetNext(i, NULL);
                 }
@@ -50,6 +50,9 @@ class Slice {
     // Return true iff the length of the referenced data is zero
     bool empty() const { return size_ == 0; }
 
+    // Return true iff the slice owns the referenced data and frees it
+    bool need_free() const { return need_free_; }
+
     void reset(const char* d, size_t size) {
         data_ = d;
         size_ = size;
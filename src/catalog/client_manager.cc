@@ -281,24 +281,16 @@ std::shared_ptr<::hybridse::vm::TableHandler> TabletAccessor::SubQuery(uint32_t
         request.add_common_column_indices(idx);
     }
     if (request_is_common) {
-        if (rows.empty()) {
-            request.set_common_slices(0);
-        } else {
+        // the sub task runs the common row once and the output is repeated for the batch by AsyncTableHandler, so
+        // the row is sent once as the only input row
+        request.set_common_slices(0);
+        if (!rows.empty()) {
             size_t common_slice_size = 0;
             if (!codec::EncodeRpcRow(rows[0], &io_buf, &common_slice_size)) {
                 return std::make_shared<::hybridse::vm::ErrorTableHandler>(::hybridse::common::kBadRequest,
                                                                            "encode common row buf failed");
             }
             request.add_row_sizes(common_slice_size);
-            request.set_common_slices(rows[0].GetRowPtrCnt());
-
-            // TODO(baoxinqi): opt request is common, need no uncommon slices
-            size_t uncommon_slice_size = 0;
-            if (!codec::EncodeRpcRow(rows[0], &io_buf, &uncommon_slice_size)) {
-                return std::make_shared<::hybridse::vm::ErrorTableHandler>(::hybridse::common::kBadRequest,
-                                                                           "encode uncommon row buf failed");
-            }
-            request.add_row_sizes(uncommon_slice_size);
             request.set_non_common_slices(rows[0].GetRowPtrCnt());
         }
     } else {
@@ -16,11 +16,73 @@
 
 #include "catalog/distribute_iterator.h"
 
+#include "bthread/bthread.h"
+
 namespace openmldb {
 namespace catalog {
 
+namespace {
+
+bthread_key_t CreateRecorderKey() {
+    bthread_key_t key = INVALID_BTHREAD_KEY;
+    if (bthread_key_create(&key, NULL) != 0) {
+        LOG(WARNING) << "fail to create the bthread key of the key read recorder, the key reads are not recorded";
+    }
+    return key;
+}
+
+bthread_key_t GetRecorderKey() {
+    static bthread_key_t key = CreateRecorderKey();
+    return key;
+}
+
+}  // namespace
+
+KeyReadRecorder::Scope::Scope(KeyReadRecorder* recorder) : prev_(KeyReadRecorder::Current()) {
+    bthread_setspecific(GetRecorderKey(), recorder);
+}
+
+KeyReadRecorder::Scope::~Scope() { bthread_setspecific(GetRecorderKey(), prev_); }
+
+KeyReadRecorder* KeyReadRecorder::Current() {
+    return static_cast<KeyReadRecorder*>(bthread_getspecific(GetRecorderKey()));
+}
+
+void KeyReadRecorder::Record(const std::shared_ptr<::openmldb::storage::Table>& table, const std::string& key) {
+    KeyReadRecorder* recorder = Current();
+    if (recorder == nullptr) {
+        return;
+    }
+    auto& reads = recorder->reads_;
+    for (const auto& read : reads) {
+        if (read.key == key && read.table.lock() == table) {
+            return;
+        }
+    }
+    reads.push_back(KeyRead{table, key, table->GetKeyVersion(key)});
+}
+
+void KeyReadRecorder::RecordUntracked() {
+    KeyReadRecorder* recorder = Current();
+    if (recorder != nullptr) {
+        recorder->tracked_ = false;
+    }
+}
+
+bool KeyReadRecorder::IsUnchanged(const KeyReads& reads) {
+    for (const auto& read : reads) {
+        auto table = read.table.lock();
+        if (!table || table->GetKeyVersion(read.key) != read.version) {
+            return false;
+        }
+    }
+    return true;
+}
+
 FullTableIterator::FullTableIterator(std::shared_ptr<Tables> tables)
-    : tables_(tables), cur_pid_(0), it_(), key_(0), value_() {}
+    : tables_(tables), cur_pid_(0), it_(), key_(0), value_() {
+    KeyReadRecorder::RecordUntracked();
+}
 
 void FullTableIterator::SeekToFirst() {
     it_.reset();
@@ -59,8 +121,15 @@ void FullTableIterator::Next() {
 }
 
 const ::hybridse::codec::Row& FullTableIterator::GetValue() {
-    value_ = ::hybridse::codec::Row(
-        ::hybridse::base::RefCountedSlice::Create(it_->GetValue().data(), it_->GetValue().size()));
+    ::openmldb::base::Slice value = it_->GetValue();
+    if (value.need_free()) {
+        // the copy of the table iterator is freed with the slice, the runners may keep the row longer
+        int8_t* buf = reinterpret_cast<int8_t*>(malloc(value.size()));
+        memcpy(buf, value.data(), value.size());
+        value_ = ::hybridse::codec::Row(::hybridse::base::RefCountedSlice::CreateManaged(buf, value.size()));
+    } else {
+        value_ = ::hybridse::codec::Row(::hybridse::base::RefCountedSlice::Create(value.data(), value.size()));
+    }
     return value_;
 }
 
@@ -83,11 +152,15 @@ void DistributeWindowIterator::Seek(const std::string& key) {
     }
     auto iter = tables_->find(cur_pid_);
     if (iter != tables_->end()) {
+        // the version is read before the rows, so a put in the meantime changes it
+        KeyReadRecorder::Record(iter->second, key);
         it_.reset(iter->second->NewWindowIterator(index_));
         it_->Seek(key);
         if (it_->Valid()) {
             return;
         }
+    } else {
+        KeyReadRecorder::RecordUntracked();
     }
     for (const auto& kv : *tables_) {
         if (kv.first <= cur_pid_) {
@@ -104,6 +177,7 @@ void DistributeWindowIterator::Seek(const std::string& key) {
 
 void DistributeWindowIterator::SeekToFirst() {
     DLOG(INFO) << "seek to first";
+    KeyReadRecorder::RecordUntracked();
     it_.reset();
     if (!tables_) {
         return;
@@ -119,6 +193,7 @@ void DistributeWindowIterator::SeekToFirst() {
 }
 
 void DistributeWindowIterator::Next() {
+    KeyReadRecorder::RecordUntracked();
     it_->Next();
     if (!it_->Valid()) {
         auto iter = tables_->find(cur_pid_);
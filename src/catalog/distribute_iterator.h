@@ -20,6 +20,7 @@
 #include <map>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "base/hash.h"
 #include "storage/table.h"
@@ -30,6 +31,53 @@ namespace catalog {
 
 using Tables = std::map<uint32_t, std::shared_ptr<::openmldb::storage::Table>>;
 
+// KeyReadRecorder records the versions of the keys sought by the window iterators while a request runs, so the
+// result computed from them can be reused until one of the keys is written. It's owned by the request and bound to
+// the bthread running it by Scope, the bthread local storage moves with the bthread if it's scheduled onto another
+// worker. The iterators are created by the shared table handlers, which know nothing of the request
+class KeyReadRecorder {
+ public:
+    struct KeyRead {
+        std::weak_ptr<::openmldb::storage::Table> table;
+        std::string key;
+        uint64_t version;
+    };
+    using KeyReads = std::vector<KeyRead>;
+
+    // bind a recorder to the current bthread, or the current pthread out of bthreads, until the scope ends
+    class Scope {
+     public:
+        explicit Scope(KeyReadRecorder* recorder);
+        ~Scope();
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+     private:
+        KeyReadRecorder* prev_;
+    };
+
+    KeyReadRecorder() : tracked_(true), reads_() {}
+    KeyReadRecorder(const KeyReadRecorder&) = delete;
+    KeyReadRecorder& operator=(const KeyReadRecorder&) = delete;
+
+    // false if some reads are not tracked, e.g. a full scan
+    inline bool IsTracked() const { return tracked_; }
+    inline KeyReads& GetReads() { return reads_; }
+
+    // record into the recorder bound to the current bthread, nothing is recorded if there is none
+    static void Record(const std::shared_ptr<::openmldb::storage::Table>& table, const std::string& key);
+    static void RecordUntracked();
+
+    // whether none of the keys is written since it's read
+    static bool IsUnchanged(const KeyReads& reads);
+
+ private:
+    static KeyReadRecorder* Current();
+
+    bool tracked_;
+    KeyReads reads_;
+};
+
 class FullTableIterator : public ::hybridse::codec::ConstIterator<uint64_t, ::hybridse::codec::Row> {
  public:
     explicit FullTableIterator(std::shared_ptr<Tables> tables);
@@ -135,6 +135,17 @@ bool SDKCatalog::Init(const std::vector<::openmldb::nameserver::TableInfo>& tabl
     return true;
 }
 
+bool SDKCatalog::Init(const std::vector<std::shared_ptr<SDKTableHandler>>& tables, const Procedures& db_sp_map) {
+    for (const auto& table : tables) {
+        if (!table) {
+            continue;
+        }
+        tables_[table->GetDatabase()].emplace(table->GetName(), table);
+    }
+    db_sp_map_ = db_sp_map;
+    return true;
+}
+
 std::shared_ptr<::hybridse::vm::TableHandler> SDKCatalog::GetTable(const std::string& db,
                                                                    const std::string& table_name) {
     auto db_it = tables_.find(db);
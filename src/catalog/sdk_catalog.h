@@ -113,6 +113,9 @@ class SDKCatalog : public ::hybridse::vm::Catalog {
 
     bool Init(const std::vector<::openmldb::nameserver::TableInfo>& tables, const Procedures& db_sp_map);
 
+    // init with the handlers which have been initialized, they can be shared between catalogs
+    bool Init(const std::vector<std::shared_ptr<SDKTableHandler>>& tables, const Procedures& db_sp_map);
+
     std::shared_ptr<::hybridse::type::Database> GetDatabase(const std::string& db) override {
         return std::shared_ptr<::hybridse::type::Database>();
     }
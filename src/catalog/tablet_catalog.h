@@ -204,6 +204,8 @@ class TabletTableHandler : public ::hybridse::vm::TableHandler,
 
     inline int32_t GetTid() { return table_st_.GetTid(); }
 
+    inline uint32_t GetPartitionNum() { return table_st_.GetPartitionNum(); }
+
     void AddTable(std::shared_ptr<::openmldb::storage::Table> table);
 
     bool HasLocalTable();
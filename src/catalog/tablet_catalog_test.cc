@@ -16,18 +16,25 @@
 
 #include "catalog/tablet_catalog.h"
 
+#include <string>
 #include <vector>
 
 #include "base/fe_status.h"
 #include "catalog/schema_adapter.h"
 #include "codec/fe_row_codec.h"
 #include "codec/schema_codec.h"
+#include "gflags/gflags.h"
 #include "gtest/gtest.h"
 #include "proto/fe_common.pb.h"
 #include "storage/mem_table.h"
 #include "storage/table.h"
 #include "vm/engine.h"
 
+DECLARE_uint32(time_block_hot_cnt);
+DECLARE_uint32(time_block_min_cnt);
+DECLARE_uint32(time_block_max_cnt);
+DECLARE_bool(time_block_compress);
+
 namespace openmldb {
 namespace catalog {
 
@@ -421,6 +428,57 @@ TEST_F(TabletCatalogTest, iterator_test) {
     }
     ASSERT_EQ(record_num, 500);
 }
+TEST_F(TabletCatalogTest, full_iterator_over_compressed_time_blocks) {
+    FLAGS_time_block_hot_cnt = 10;
+    FLAGS_time_block_min_cnt = 20;
+    FLAGS_time_block_max_cnt = 32;
+    FLAGS_time_block_compress = true;
+    std::shared_ptr<TabletCatalog> catalog(new TabletCatalog());
+    ASSERT_TRUE(catalog->Init());
+    TestArgs *args = PrepareMultiPartitionTable("t1", 1);
+    ::hybridse::vm::Schema fe_schema;
+    SchemaAdapter::ConvertSchema(args->meta[0].column_desc(), &fe_schema);
+    ::hybridse::codec::RowBuilder rb(fe_schema);
+    std::string pk = "pk_sealed";
+    uint64_t ts = 1589780888000l;
+    std::vector<std::string> expect_values;
+    for (int i = 99; i >= 0; i--) {
+        std::string value;
+        value.resize(rb.CalTotalLength(pk.size()));
+        rb.SetBuffer(reinterpret_cast<int8_t *>(&(value[0])), value.size());
+        rb.AppendString(pk.c_str(), pk.size());
+        rb.AppendInt64(ts + i);
+        args->tables[0]->Put(pk, ts + i, value.c_str(), value.size());
+        expect_values.push_back(value);
+    }
+    // all but the latest 10 records of pk_sealed are sealed into several compressed blocks
+    std::dynamic_pointer_cast<::openmldb::storage::MemTable>(args->tables[0])->SchedGc();
+    ASSERT_TRUE(catalog->AddTable(args->meta[0], args->tables[0]));
+    auto handler = catalog->GetTable("db1", "t1");
+
+    // a batch runner keeps the rows after the iterator reads the other blocks
+    std::vector<::hybridse::codec::Row> rows;
+    auto full_iterator = handler->GetIterator();
+    for (full_iterator->SeekToFirst(); full_iterator->Valid(); full_iterator->Next()) {
+        rows.push_back(full_iterator->GetValue());
+    }
+    ASSERT_EQ(600u, rows.size());
+    std::vector<std::string> values;
+    ::hybridse::codec::RowView row_view(fe_schema);
+    for (auto &row : rows) {
+        ASSERT_TRUE(row_view.Reset(row.buf(), row.size()));
+        if (row_view.GetStringUnsafe(0) == pk) {
+            values.push_back(row.ToString());
+        }
+    }
+    ASSERT_EQ(expect_values, values);
+
+    FLAGS_time_block_hot_cnt = 0;
+    FLAGS_time_block_min_cnt = 128;
+    FLAGS_time_block_max_cnt = 1024;
+    FLAGS_time_block_compress = false;
+}
+
 TEST_F(TabletCatalogTest, window_iterator_seek_test_discontinuous) {
     std::vector<std::shared_ptr<TabletCatalog>> catalog_vec;
     for (int i = 0; i < 2; i++) {
@@ -1185,7 +1185,7 @@ bool TabletClient::LoadIndexData(uint32_t tid, uint32_t pid, uint32_t partition_
 }
 
 bool TabletClient::ExtractIndexData(uint32_t tid, uint32_t pid, uint32_t partition_num,
-                                    const ::openmldb::common::ColumnKey& column_key, uint32_t idx,
+                                    const ::openmldb::common::ColumnKey& column_key, uint32_t idx, bool local_data,
                                     std::shared_ptr<TaskInfo> task_info) {
     ::openmldb::api::ExtractIndexDataRequest request;
     ::openmldb::api::GeneralResponse response;
@@ -1193,6 +1193,7 @@ bool TabletClient::ExtractIndexData(uint32_t tid, uint32_t pid, uint32_t partiti
     request.set_pid(pid);
     request.set_partition_num(partition_num);
     request.set_idx(idx);
+    request.set_local_data(local_data);
     ::openmldb::common::ColumnKey* cur_column_key = request.mutable_column_key();
     cur_column_key->CopyFrom(column_key);
     if (task_info) {
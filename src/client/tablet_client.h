@@ -242,7 +242,7 @@ class TabletClient {
     bool LoadIndexData(uint32_t tid, uint32_t pid, uint32_t partition_num, std::shared_ptr<TaskInfo> task_info);
 
     bool ExtractIndexData(uint32_t tid, uint32_t pid, uint32_t partition_num,
-                          const ::openmldb::common::ColumnKey& column_key, uint32_t idx,
+                          const ::openmldb::common::ColumnKey& column_key, uint32_t idx, bool local_data,
                           std::shared_ptr<TaskInfo> task_info);
 
     bool CancelOP(const uint64_t op_id);
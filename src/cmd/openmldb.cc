@@ -2361,6 +2361,26 @@ int GenTableInfo(const std::string& path,
         }
         ns_table_info.set_key_entry_max_height(table_info.key_entry_max_height());
     }
+    std::string key_index_type = table_info.key_index_type();
+    std::transform(key_index_type.begin(), key_index_type.end(), key_index_type.begin(), ::tolower);
+    if (key_index_type == "kskiplist" || key_index_type == "skiplist") {
+        ns_table_info.set_key_index_type(::openmldb::type::KeyIndexType::kSkiplist);
+    } else if (key_index_type == "kbtree" || key_index_type == "btree") {
+        ns_table_info.set_key_index_type(::openmldb::type::KeyIndexType::kBTree);
+    } else {
+        printf("key index type %s is invalid\n", table_info.key_index_type().c_str());
+        return -1;
+    }
+    std::string storage_mode = table_info.storage_mode();
+    std::transform(storage_mode.begin(), storage_mode.end(), storage_mode.begin(), ::tolower);
+    if (storage_mode == "kmemory" || storage_mode == "memory") {
+        ns_table_info.set_storage_mode(::openmldb::type::StorageMode::kMemory);
+    } else if (storage_mode == "kdisk" || storage_mode == "disk") {
+        ns_table_info.set_storage_mode(::openmldb::type::StorageMode::kDisk);
+    } else {
+        printf("storage mode %s is invalid\n", table_info.storage_mode().c_str());
+        return -1;
+    }
     ns_table_info.set_seg_cnt(table_info.seg_cnt());
     ns_table_info.set_format_version(table_info.format_version());
     if (SetTablePartition(table_info, ns_table_info) < 0) {
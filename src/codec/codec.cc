@@ -22,6 +22,7 @@
 
 #include "base/glog_wapper.h"
 #include "boost/lexical_cast.hpp"
+#include "codec/row_layout.h"
 
 namespace openmldb {
 namespace codec {
@@ -904,14 +905,14 @@ int32_t GetStrField(const int8_t* row, uint32_t field_offset, uint32_t next_str_
 RowProject::RowProject(const std::map<int32_t, std::shared_ptr<Schema>>& vers_schema, const ProjectList& plist)
     : plist_(plist),
       output_schema_(),
-      row_builder_(NULL),
-      cur_rv_(nullptr),
+      out_layout_(),
+      cur_layout_(),
       max_idx_(0),
-      vers_views_(),
+      vers_layouts_(),
       vers_schema_(vers_schema),
       cur_ver_(1) {}
 
-RowProject::~RowProject() { delete row_builder_; }
+RowProject::~RowProject() {}
 
 bool RowProject::Init() {
     if (plist_.size() <= 0) {
@@ -924,138 +925,106 @@ bool RowProject::Init() {
             max_idx_ = idx;
         }
     }
-    for (const auto it : vers_schema_) {
+    for (const auto& it : vers_schema_) {
         if (max_idx_ >= (uint32_t)it.second->size()) {
             continue;
         }
-        std::shared_ptr<RowView> rv = std::make_shared<RowView>(*it.second);
-        vers_views_.insert(std::make_pair(it.first, rv));
+        auto layout = std::make_shared<RowLayout>(*it.second);
+        if (!layout->IsValid()) {
+            LOG(WARNING) << "invalid schema of ver " << it.first;
+            return false;
+        }
+        vers_layouts_.insert(std::make_pair(it.first, layout));
     }
-    if (vers_views_.empty()) {
-        LOG(WARNING) << "empty row views";
+    if (vers_layouts_.empty()) {
+        LOG(WARNING) << "empty row layouts";
         return false;
     }
-    const auto it = vers_views_.begin();
-    cur_schema_ = vers_schema_.find(it->first)->second;
-    cur_rv_ = it->second;
+    const auto it = vers_layouts_.begin();
+    cur_ver_ = it->first;
+    cur_layout_ = it->second;
+    const std::shared_ptr<Schema>& cur_schema = vers_schema_.find(it->first)->second;
     for (int32_t i = 0; i < plist_.size(); i++) {
         uint32_t idx = plist_.Get(i);
-        const ::openmldb::common::ColumnDesc& column = cur_schema_->Get(idx);
+        const ::openmldb::common::ColumnDesc& column = cur_schema->Get(idx);
         output_schema_.Add()->CopyFrom(column);
     }
-    row_builder_ = new RowBuilder(output_schema_);
+    out_layout_ = std::make_shared<RowLayout>(output_schema_);
     return true;
 }
 
-bool RowProject::Project(const int8_t* row_ptr, uint32_t size, int8_t** output_ptr, uint32_t* out_size) {
-    if (row_ptr == NULL || output_ptr == NULL || out_size == NULL) return false;
+bool RowProject::ResolveLayout(const int8_t* row_ptr, uint32_t size) {
     uint8_t version = openmldb::codec::RowView::GetSchemaVersion(row_ptr);
     if (version != cur_ver_) {
-        auto it = vers_views_.find(version);
-        if (it == vers_views_.end()) {
-            LOG(WARNING) << "not found valid row view for ver " << unsigned(version);
+        auto it = vers_layouts_.find(version);
+        if (it == vers_layouts_.end()) {
+            LOG(WARNING) << "not found valid row layout for ver " << unsigned(version);
             return false;
         }
-        cur_rv_ = it->second;
+        cur_layout_ = it->second;
         cur_ver_ = version;
-        cur_schema_ = vers_schema_.find(version)->second;
     }
-    bool ok = cur_rv_->Reset(row_ptr, size);
-    if (!ok) return false;
+    return cur_layout_->CheckRow(row_ptr, size);
+}
+
+uint32_t RowProject::GetProjectSize(const int8_t* row_ptr, uint32_t size) {
+    if (row_ptr == NULL || !ResolveLayout(row_ptr, size)) return 0;
+    const RowLayout& layout = *cur_layout_;
+    uint8_t addr_length = RowLayout::GetAddrLength(size);
     uint32_t str_size = 0;
     for (int32_t i = 0; i < plist_.size(); i++) {
         uint32_t idx = plist_.Get(i);
-        const ::openmldb::common::ColumnDesc& column = cur_schema_->Get(idx);
-        if (column.data_type() == ::openmldb::type::kVarchar || column.data_type() == ::openmldb::type::kString) {
-            if (cur_rv_->IsNULL(idx)) continue;
+        if (layout.IsString(idx) && !RowLayout::IsNULL(row_ptr, idx)) {
+            const char* content = nullptr;
             uint32_t length = 0;
-            char* content = nullptr;
-            int32_t ret = cur_rv_->GetString(idx, &content, &length);
-            if (ret != 0) {
-                return false;
-            }
+            layout.GetString(row_ptr, size, addr_length, idx, &content, &length);
             str_size += length;
         }
     }
-    uint32_t total_size = row_builder_->CalTotalLength(str_size);
-    char* ptr = new char[total_size];
-    row_builder_->SetBuffer(reinterpret_cast<int8_t*>(ptr), total_size);
+    uint8_t out_addr_length = 0;
+    return out_layout_->CalTotalLength(str_size, &out_addr_length);
+}
+
+bool RowProject::Project(const int8_t* row_ptr, uint32_t size, int8_t* out, uint32_t out_size) {
+    if (row_ptr == NULL || out == NULL || !ResolveLayout(row_ptr, size)) return false;
+    const RowLayout& layout = *cur_layout_;
+    const RowLayout& out_layout = *out_layout_;
+    uint8_t addr_length = RowLayout::GetAddrLength(size);
+    uint8_t out_addr_length = RowLayout::GetAddrLength(out_size);
+    uint32_t str_offset = out_layout.InitRow(out, out_size, out_addr_length);
     for (int32_t i = 0; i < plist_.size(); i++) {
         uint32_t idx = plist_.Get(i);
-        const ::openmldb::common::ColumnDesc& column = cur_schema_->Get(idx);
-        int32_t ret = 0;
-        if (cur_rv_->IsNULL(idx)) {
-            row_builder_->AppendNULL();
-            continue;
-        }
-        switch (column.data_type()) {
-            case ::openmldb::type::kBool: {
-                bool val = false;
-                ret = cur_rv_->GetBool(idx, &val);
-                if (ret == 0) row_builder_->AppendBool(val);
-                break;
-            }
-            case ::openmldb::type::kSmallInt: {
-                int16_t val = 0;
-                ret = cur_rv_->GetInt16(idx, &val);
-                if (ret == 0) row_builder_->AppendInt16(val);
-                break;
-            }
-            case ::openmldb::type::kInt: {
-                int32_t val = 0;
-                ret = cur_rv_->GetInt32(idx, &val);
-                if (ret == 0) row_builder_->AppendInt32(val);
-                break;
-            }
-            case ::openmldb::type::kDate: {
-                int32_t val = 0;
-                ret = cur_rv_->GetDate(idx, &val);
-                if (ret == 0) row_builder_->AppendDate(val);
-                break;
-            }
-            case ::openmldb::type::kBigInt: {
-                int64_t val = 0;
-                ret = cur_rv_->GetInt64(idx, &val);
-                if (ret == 0) row_builder_->AppendInt64(val);
-                break;
-            }
-            case ::openmldb::type::kTimestamp: {
-                int64_t val = 0;
-                ret = cur_rv_->GetTimestamp(idx, &val);
-                if (ret == 0) row_builder_->AppendTimestamp(val);
-                break;
-            }
-            case ::openmldb::type::kFloat: {
-                float val = 0;
-                ret = cur_rv_->GetFloat(idx, &val);
-                if (ret == 0) row_builder_->AppendFloat(val);
-                break;
+        bool is_null = RowLayout::IsNULL(row_ptr, idx);
+        if (!layout.IsString(idx)) {
+            if (!is_null) {
+                out_layout.CopyField(out, i, layout, row_ptr, idx);
             }
-            case ::openmldb::type::kDouble: {
-                double val = 0;
-                ret = cur_rv_->GetDouble(idx, &val);
-                if (ret == 0) row_builder_->AppendDouble(val);
-                break;
-            }
-            case ::openmldb::type::kString:
-            case ::openmldb::type::kVarchar: {
-                char* val = NULL;
-                uint32_t size = 0;
-                ret = cur_rv_->GetString(idx, &val, &size);
-                if (ret == 0) row_builder_->AppendString(val, size);
-                break;
-            }
-            default: {
-                PDLOG(WARNING, "not supported type");
+        } else if (is_null) {
+            out_layout.SetNULLString(out, i, out_addr_length, str_offset);
+        } else {
+            const char* content = nullptr;
+            uint32_t length = 0;
+            layout.GetString(row_ptr, size, addr_length, idx, &content, &length);
+            if (str_offset + length > out_size) {
+                LOG(WARNING) << "the output size " << out_size << " is less than the projected size";
+                return false;
             }
+            out_layout.SetString(out, i, out_addr_length, content, length, &str_offset);
         }
-        if (ret != 0) {
-            delete[] ptr;
-            PDLOG(WARNING, "fail to project column %s with idx %u", column.name().c_str(), idx);
-            return false;
-        }
     }
-    *output_ptr = reinterpret_cast<int8_t*>(ptr);
+    return str_offset == out_size;
+}
+
+bool RowProject::Project(const int8_t* row_ptr, uint32_t size, int8_t** output_ptr, uint32_t* out_size) {
+    if (row_ptr == NULL || output_ptr == NULL || out_size == NULL) return false;
+    uint32_t total_size = GetProjectSize(row_ptr, size);
+    if (total_size == 0) return false;
+    int8_t* ptr = reinterpret_cast<int8_t*>(new char[total_size]);
+    if (!Project(row_ptr, size, ptr, total_size)) {
+        delete[] ptr;
+        return false;
+    }
+    *output_ptr = ptr;
     *out_size = total_size;
     return true;
 }
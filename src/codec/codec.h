@@ -28,6 +28,7 @@
 #include <vector>
 
 #include "base/endianconv.h"
+#include "base/slice.h"
 #include "base/strings.h"
 #include "proto/common.pb.h"
 
@@ -45,6 +46,7 @@ struct RowContext;
 class RowBuilder;
 class RowView;
 class RowProject;
+class RowLayout;
 
 // TODO(wangtaize) share the row codec context
 struct RowContext {};
@@ -59,17 +61,25 @@ class RowProject {
 
     bool Project(const int8_t* row_ptr, uint32_t row_size, int8_t** out_ptr, uint32_t* out_size);
 
+    // the size of the projected row, 0 if the row can not be projected
+    uint32_t GetProjectSize(const int8_t* row_ptr, uint32_t row_size);
+
+    // project a row into out, out_size must be its GetProjectSize
+    bool Project(const int8_t* row_ptr, uint32_t row_size, int8_t* out, uint32_t out_size);
+
     uint32_t GetMaxIdx() { return max_idx_; }
 
  private:
+    // switch to the layout of the row version and check the row
+    bool ResolveLayout(const int8_t* row_ptr, uint32_t row_size);
+
     const ProjectList& plist_;
     Schema output_schema_;
-    // TODO(wangtaize) share the init overhead
-    RowBuilder* row_builder_;
-    std::shared_ptr<Schema> cur_schema_;
-    std::shared_ptr<RowView> cur_rv_;
+    // the layouts are resolved once in Init, a row is projected by the field offsets without type checks
+    std::shared_ptr<RowLayout> out_layout_;
+    std::shared_ptr<RowLayout> cur_layout_;
     uint32_t max_idx_;
-    std::map<int32_t, std::shared_ptr<RowView>> vers_views_;
+    std::map<int32_t, std::shared_ptr<RowLayout>> vers_layouts_;
     std::map<int32_t, std::shared_ptr<Schema>> vers_schema_;
     uint32_t cur_ver_;
 };
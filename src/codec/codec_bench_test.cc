@@ -18,6 +18,7 @@
 
 #include "base/kv_iterator.h"
 #include "codec/row_codec.h"
+#include "codec/row_layout.h"
 #include "common/timer.h"
 #include "gtest/gtest.h"
 #include "proto/common.pb.h"
@@ -223,6 +224,241 @@ TEST_F(CodecBenchmarkTest, Decode) {
     std::cout << "Decode protobuf: " << pconsumed / 1000 << std::endl;
 }
 
+// 20 columns, bigint / double / string in turn
+void BuildBenchSchema(Schema* schema) {
+    std::vector<type::DataType> types = {type::kBigInt, type::kDouble, type::kVarchar};
+    for (uint32_t i = 0; i < 20; i++) {
+        common::ColumnDesc* col = schema->Add();
+        col->set_name("col" + std::to_string(i));
+        col->set_data_type(types[i % types.size()]);
+    }
+}
+
+std::string BuildBenchRow(const Schema& schema) {
+    std::string str = "hello world";
+    uint32_t str_cnt = 0;
+    for (const auto& col : schema) {
+        str_cnt += col.data_type() == type::kVarchar ? 1 : 0;
+    }
+    RowBuilder builder(schema);
+    std::string row(builder.CalTotalLength(str.size() * str_cnt), '\0');
+    builder.SetBuffer(reinterpret_cast<int8_t*>(&row[0]), row.size());
+    for (int i = 0; i < schema.size(); i++) {
+        switch (schema.Get(i).data_type()) {
+            case type::kBigInt:
+                builder.AppendInt64(i);
+                break;
+            case type::kDouble:
+                builder.AppendDouble(i + 0.5);
+                break;
+            default:
+                builder.AppendString(str.c_str(), str.size());
+        }
+    }
+    return row;
+}
+
+TEST_F(CodecBenchmarkTest, RowViewVsRowLayout) {
+    Schema schema;
+    BuildBenchSchema(&schema);
+    std::string row = BuildBenchRow(schema);
+    const int8_t* row_ptr = reinterpret_cast<const int8_t*>(row.data());
+    uint32_t times = 1000000;
+    int64_t i64_sum = 0;
+    double double_sum = 0;
+    uint64_t str_sum = 0;
+    uint64_t consumed = ::baidu::common::timer::get_micros();
+    RowView view(schema);
+    for (uint32_t i = 0; i < times; i++) {
+        view.Reset(row_ptr, row.size());
+        for (int j = 0; j < schema.size(); j++) {
+            switch (schema.Get(j).data_type()) {
+                case type::kBigInt: {
+                    int64_t val = 0;
+                    view.GetInt64(j, &val);
+                    i64_sum += val;
+                    break;
+                }
+                case type::kDouble: {
+                    double val = 0;
+                    view.GetDouble(j, &val);
+                    double_sum += val;
+                    break;
+                }
+                default: {
+                    char* val = NULL;
+                    uint32_t length = 0;
+                    view.GetString(j, &val, &length);
+                    str_sum += length;
+                }
+            }
+        }
+    }
+    consumed = ::baidu::common::timer::get_micros() - consumed;
+    uint64_t lconsumed = ::baidu::common::timer::get_micros();
+    RowLayout layout(schema);
+    for (uint32_t i = 0; i < times; i++) {
+        uint8_t addr_length = RowLayout::GetAddrLength(row.size());
+        for (uint32_t j = 0; j < layout.GetFieldCnt(); j++) {
+            switch (layout.GetType(j)) {
+                case type::kBigInt:
+                    i64_sum -= layout.GetField<int64_t>(row_ptr, j);
+                    break;
+                case type::kDouble:
+                    double_sum -= layout.GetField<double>(row_ptr, j);
+                    break;
+                default: {
+                    const char* val = NULL;
+                    uint32_t length = 0;
+                    layout.GetString(row_ptr, row.size(), addr_length, j, &val, &length);
+                    str_sum -= length;
+                }
+            }
+        }
+    }
+    lconsumed = ::baidu::common::timer::get_micros() - lconsumed;
+    ASSERT_EQ(0, i64_sum);
+    ASSERT_DOUBLE_EQ(0, double_sum);
+    ASSERT_EQ(0u, str_sum);
+    std::cout << "decode " << times << " rows by RowView consumed:" << consumed / 1000 << "ms" << std::endl;
+    std::cout << "decode " << times << " rows by RowLayout consumed:" << lconsumed / 1000 << "ms" << std::endl;
+}
+
+TEST_F(CodecBenchmarkTest, RowBuilderVsRowLayout) {
+    Schema schema;
+    BuildBenchSchema(&schema);
+    std::string expect = BuildBenchRow(schema);
+    std::string str = "hello world";
+    std::string row(expect.size(), '\0');
+    int8_t* buf = reinterpret_cast<int8_t*>(&row[0]);
+    uint32_t times = 1000000;
+    uint64_t consumed = ::baidu::common::timer::get_micros();
+    RowBuilder builder(schema);
+    for (uint32_t i = 0; i < times; i++) {
+        builder.SetBuffer(buf, row.size());
+        for (int j = 0; j < schema.size(); j++) {
+            switch (schema.Get(j).data_type()) {
+                case type::kBigInt:
+                    builder.AppendInt64(j);
+                    break;
+                case type::kDouble:
+                    builder.AppendDouble(j + 0.5);
+                    break;
+                default:
+                    builder.AppendString(str.c_str(), str.size());
+            }
+        }
+    }
+    consumed = ::baidu::common::timer::get_micros() - consumed;
+    ASSERT_EQ(expect, row);
+    row.assign(expect.size(), '\0');
+    buf = reinterpret_cast<int8_t*>(&row[0]);
+    uint64_t lconsumed = ::baidu::common::timer::get_micros();
+    RowLayout layout(schema);
+    for (uint32_t i = 0; i < times; i++) {
+        uint8_t addr_length = 0;
+        uint32_t size = layout.CalTotalLength(str.size() * layout.GetStrFieldCnt(), &addr_length);
+        uint32_t str_offset = layout.InitRow(buf, size, addr_length);
+        for (uint32_t j = 0; j < layout.GetFieldCnt(); j++) {
+            switch (layout.GetType(j)) {
+                case type::kBigInt:
+                    layout.SetField<int64_t>(buf, j, j);
+                    break;
+                case type::kDouble:
+                    layout.SetField<double>(buf, j, j + 0.5);
+                    break;
+                default:
+                    layout.SetString(buf, j, addr_length, str.c_str(), str.size(), &str_offset);
+            }
+        }
+    }
+    lconsumed = ::baidu::common::timer::get_micros() - lconsumed;
+    ASSERT_EQ(expect, row);
+    std::cout << "encode " << times << " rows by RowBuilder consumed:" << consumed / 1000 << "ms" << std::endl;
+    std::cout << "encode " << times << " rows by RowLayout consumed:" << lconsumed / 1000 << "ms" << std::endl;
+}
+
+TEST_F(CodecBenchmarkTest, ProjectRowViewVsRowLayout) {
+    Schema schema;
+    BuildBenchSchema(&schema);
+    std::string row = BuildBenchRow(schema);
+    const int8_t* row_ptr = reinterpret_cast<const int8_t*>(row.data());
+    ProjectList plist;
+    for (uint32_t idx : {0, 2, 4, 9, 11, 17}) {
+        plist.Add(idx);
+    }
+    Schema output_schema;
+    for (uint32_t idx : plist) {
+        output_schema.Add()->CopyFrom(schema.Get(idx));
+    }
+    uint32_t times = 1000000;
+    // the generic projection RowProject did by RowView and RowBuilder
+    uint64_t consumed = ::baidu::common::timer::get_micros();
+    RowView view(schema);
+    RowBuilder builder(output_schema);
+    std::string generic_out;
+    for (uint32_t i = 0; i < times; i++) {
+        view.Reset(row_ptr, row.size());
+        uint32_t str_size = 0;
+        for (uint32_t idx : plist) {
+            char* val = NULL;
+            uint32_t length = 0;
+            if (schema.Get(idx).data_type() == type::kVarchar && view.GetString(idx, &val, &length) == 0) {
+                str_size += length;
+            }
+        }
+        uint32_t total_size = builder.CalTotalLength(str_size);
+        int8_t* ptr = reinterpret_cast<int8_t*>(new char[total_size]);
+        builder.SetBuffer(ptr, total_size);
+        for (uint32_t idx : plist) {
+            switch (schema.Get(idx).data_type()) {
+                case type::kBigInt: {
+                    int64_t val = 0;
+                    view.GetInt64(idx, &val);
+                    builder.AppendInt64(val);
+                    break;
+                }
+                case type::kDouble: {
+                    double val = 0;
+                    view.GetDouble(idx, &val);
+                    builder.AppendDouble(val);
+                    break;
+                }
+                default: {
+                    char* val = NULL;
+                    uint32_t length = 0;
+                    view.GetString(idx, &val, &length);
+                    builder.AppendString(val, length);
+                }
+            }
+        }
+        if (i == 0) {
+            generic_out.assign(reinterpret_cast<char*>(ptr), total_size);
+        }
+        delete[] ptr;
+    }
+    consumed = ::baidu::common::timer::get_micros() - consumed;
+    std::map<int32_t, std::shared_ptr<Schema>> vers_schema;
+    vers_schema.insert(std::make_pair(1, std::make_shared<Schema>(schema)));
+    RowProject rp(vers_schema, plist);
+    ASSERT_TRUE(rp.Init());
+    std::string layout_out;
+    uint64_t lconsumed = ::baidu::common::timer::get_micros();
+    for (uint32_t i = 0; i < times; i++) {
+        int8_t* data = NULL;
+        uint32_t size = 0;
+        rp.Project(row_ptr, row.size(), &data, &size);
+        if (i == 0) {
+            layout_out.assign(reinterpret_cast<char*>(data), size);
+        }
+        delete[] data;
+    }
+    lconsumed = ::baidu::common::timer::get_micros() - lconsumed;
+    ASSERT_EQ(generic_out, layout_out);
+    std::cout << "project " << times << " rows by RowView consumed:" << consumed / 1000 << "ms" << std::endl;
+    std::cout << "project " << times << " rows by RowLayout consumed:" << lconsumed / 1000 << "ms" << std::endl;
+}
+
 }  // namespace codec
 }  // namespace openmldb
 
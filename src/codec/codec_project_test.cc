@@ -398,6 +398,30 @@ TEST_P(ProjectCodecTest, common_case) {
     CompareRow(&left, &right, args->output_schema);
 }
 
+TEST_P(ProjectCodecTest, buffer_case) {
+    auto args = GetParam();
+    std::map<int32_t, std::shared_ptr<Schema>> vers_schema;
+    vers_schema.insert(std::make_pair(1, std::make_shared<Schema>(args->schema)));
+    RowProject rp(vers_schema, args->plist);
+    ASSERT_TRUE(rp.Init());
+    const int8_t* row_ptr = reinterpret_cast<int8_t*>(args->row_ptr);
+    uint32_t size = rp.GetProjectSize(row_ptr, args->row_size);
+    ASSERT_EQ(size, args->out_size);
+    // the projected rows are adjacent in one buffer
+    uint32_t row_cnt = 3;
+    std::vector<int8_t> buf(size * row_cnt);
+    for (uint32_t i = 0; i < row_cnt; i++) {
+        ASSERT_TRUE(rp.Project(row_ptr, args->row_size, buf.data() + i * size, size));
+    }
+    RowView right(args->output_schema);
+    right.Reset(reinterpret_cast<int8_t*>(args->out_ptr), args->out_size);
+    for (uint32_t i = 0; i < row_cnt; i++) {
+        RowView left(args->output_schema);
+        left.Reset(buf.data() + i * size, size);
+        CompareRow(&left, &right, args->output_schema);
+    }
+}
+
 INSTANTIATE_TEST_SUITE_P(ProjectCodecTestPrefix, ProjectCodecTest, testing::ValuesIn(GenCommonCase()));
 
 }  // namespace codec
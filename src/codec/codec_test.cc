@@ -21,6 +21,8 @@
 #include "base/kv_iterator.h"
 #include "boost/container/deque.hpp"
 #include "codec/row_codec.h"
+#include "codec/row_layout.h"
+#include "codec/sdk_codec.h"
 #include "gtest/gtest.h"
 #include "proto/common.pb.h"
 #include "proto/tablet.pb.h"
@@ -482,6 +484,143 @@ TEST_F(CodecTest, NotAppendString) {
     ASSERT_EQ(view.GetInt16(10, &val), -1);
 }
 
+TEST_F(CodecTest, RowLayout) {
+    Schema schema;
+    std::vector<::openmldb::type::DataType> types = {
+        ::openmldb::type::kBool,   ::openmldb::type::kSmallInt, ::openmldb::type::kVarchar,
+        ::openmldb::type::kInt,    ::openmldb::type::kString,   ::openmldb::type::kBigInt,
+        ::openmldb::type::kFloat,  ::openmldb::type::kVarchar,  ::openmldb::type::kDouble,
+        ::openmldb::type::kDate,   ::openmldb::type::kTimestamp};
+    for (uint32_t i = 0; i < types.size(); i++) {
+        ::openmldb::common::ColumnDesc* col = schema.Add();
+        col->set_name("col" + std::to_string(i));
+        col->set_data_type(types[i]);
+    }
+    RowLayout layout(schema);
+    ASSERT_TRUE(layout.IsValid());
+    ASSERT_EQ(3u, layout.GetStrFieldCnt());
+    // the address length of the strings is 1, 2 and 3 bytes
+    for (uint32_t str_len : {10u, 1000u, 70000u}) {
+        std::string str1(str_len, 'a');
+        std::string str2 = "hello";
+        // encode by RowLayout and decode by RowView
+        uint8_t addr_length = 0;
+        uint32_t size = layout.CalTotalLength(str1.size() + str2.size(), &addr_length);
+        RowBuilder builder(schema);
+        ASSERT_EQ(builder.CalTotalLength(str1.size() + str2.size()), size);
+        ASSERT_EQ(RowLayout::GetAddrLength(size), addr_length);
+        std::string row(size, '\0');
+        int8_t* buf = reinterpret_cast<int8_t*>(&row[0]);
+        uint32_t str_offset = layout.InitRow(buf, size, addr_length);
+        layout.SetField<bool>(buf, 0, true);
+        layout.SetField<int16_t>(buf, 1, 16);
+        layout.SetString(buf, 2, addr_length, str1.c_str(), str1.size(), &str_offset);
+        layout.SetField<int32_t>(buf, 3, 32);
+        layout.SetNULLString(buf, 4, addr_length, str_offset);
+        layout.SetField<int64_t>(buf, 5, 64);
+        layout.SetField<float>(buf, 6, 1.5f);
+        layout.SetString(buf, 7, addr_length, str2.c_str(), str2.size(), &str_offset);
+        layout.SetField<int32_t>(buf, 9, 1000);
+        layout.SetField<int64_t>(buf, 10, 1590738994000l);
+        ASSERT_EQ(size, str_offset);
+        RowView view(schema, buf, size);
+        bool b = false;
+        ASSERT_EQ(0, view.GetBool(0, &b));
+        ASSERT_TRUE(b);
+        int16_t i16 = 0;
+        ASSERT_EQ(0, view.GetInt16(1, &i16));
+        ASSERT_EQ(16, i16);
+        char* ch = NULL;
+        uint32_t length = 0;
+        ASSERT_EQ(0, view.GetString(2, &ch, &length));
+        ASSERT_EQ(str1, std::string(ch, length));
+        ASSERT_TRUE(view.IsNULL(4));
+        ASSERT_EQ(0, view.GetString(7, &ch, &length));
+        ASSERT_EQ(str2, std::string(ch, length));
+        ASSERT_TRUE(view.IsNULL(8));
+        int64_t ts = 0;
+        ASSERT_EQ(0, view.GetTimestamp(10, &ts));
+        ASSERT_EQ(1590738994000l, ts);
+
+        // encode by RowBuilder and decode by RowLayout
+        builder.SetBuffer(buf, size);
+        ASSERT_TRUE(builder.AppendBool(false));
+        ASSERT_TRUE(builder.AppendInt16(-16));
+        ASSERT_TRUE(builder.AppendString(str2.c_str(), str2.size()));
+        ASSERT_TRUE(builder.AppendNULL());
+        ASSERT_TRUE(builder.AppendString(str1.c_str(), str1.size()));
+        ASSERT_TRUE(builder.AppendInt64(-64));
+        ASSERT_TRUE(builder.AppendFloat(2.5f));
+        ASSERT_TRUE(builder.AppendNULL());
+        ASSERT_TRUE(builder.AppendDouble(3.5));
+        ASSERT_TRUE(builder.AppendDate(2021, 8, 1));
+        ASSERT_TRUE(builder.AppendTimestamp(1590738994001l));
+        ASSERT_TRUE(layout.CheckRow(buf, size));
+        ASSERT_FALSE(layout.CheckRow(buf, size - 1));
+        ASSERT_FALSE(layout.GetField<bool>(buf, 0));
+        ASSERT_EQ(-16, layout.GetField<int16_t>(buf, 1));
+        const char* val = nullptr;
+        layout.GetString(buf, size, addr_length, 2, &val, &length);
+        ASSERT_EQ(str2, std::string(val, length));
+        ASSERT_TRUE(RowLayout::IsNULL(buf, 3));
+        layout.GetString(buf, size, addr_length, 4, &val, &length);
+        ASSERT_EQ(str1, std::string(val, length));
+        ASSERT_EQ(-64, layout.GetField<int64_t>(buf, 5));
+        ASSERT_FLOAT_EQ(2.5f, layout.GetField<float>(buf, 6));
+        ASSERT_TRUE(RowLayout::IsNULL(buf, 7));
+        ASSERT_DOUBLE_EQ(3.5, layout.GetField<double>(buf, 8));
+        int32_t date = 0;
+        ASSERT_EQ(0, view.GetDate(9, &date));
+        ASSERT_EQ(date, layout.GetField<int32_t>(buf, 9));
+        ASSERT_EQ(1590738994001l, layout.GetField<int64_t>(buf, 10));
+    }
+}
+
+TEST_F(CodecTest, SDKCodecRowLayout) {
+    ::openmldb::api::TableMeta meta;
+    meta.set_format_version(1);
+    std::vector<::openmldb::type::DataType> types = {
+        ::openmldb::type::kBool,  ::openmldb::type::kSmallInt, ::openmldb::type::kVarchar, ::openmldb::type::kInt,
+        ::openmldb::type::kString, ::openmldb::type::kBigInt, ::openmldb::type::kFloat,    ::openmldb::type::kDouble,
+        ::openmldb::type::kDate,  ::openmldb::type::kTimestamp};
+    for (uint32_t i = 0; i < types.size(); i++) {
+        ::openmldb::common::ColumnDesc* col = meta.add_column_desc();
+        col->set_name("col" + std::to_string(i));
+        col->set_data_type(types[i]);
+    }
+    meta.mutable_column_desc(0)->set_not_null(true);
+    SDKCodec sdk_codec(meta);
+    std::vector<std::vector<std::string>> rows = {
+        {"true", "16", "hello", "32", "", "64", "1.5", "2.5", "2021-8-1", "1590738994000"},
+        {"False", "-16", std::string(300, 'a'), "null", NONETOKEN, "-64", "null", "-2.5", "1900-1-31", "0"}};
+    for (const auto& raw : rows) {
+        // the same bytes as the generic RowBuilder path
+        std::string row;
+        ASSERT_EQ(0, sdk_codec.EncodeRow(raw, &row));
+        std::string expect_row;
+        ASSERT_EQ(0, RowCodec::EncodeRow(raw, meta.column_desc(), 1, expect_row).code);
+        ASSERT_EQ(expect_row, row);
+        // the same text as the generic RowView path
+        std::vector<std::string> value;
+        ASSERT_EQ(0, sdk_codec.DecodeRow(row, &value));
+        std::vector<std::string> expect_value;
+        ASSERT_TRUE(RowCodec::DecodeRow(meta.column_desc(), ::openmldb::base::Slice(row), expect_value));
+        ASSERT_EQ(expect_value, value);
+    }
+    std::string row;
+    std::vector<std::string> raw = rows[0];
+    raw[0] = "null";
+    ASSERT_EQ(-1, sdk_codec.EncodeRow(raw, &row));
+    raw = rows[0];
+    raw[3] = "abc";
+    ASSERT_EQ(-1, sdk_codec.EncodeRow(raw, &row));
+    raw = rows[0];
+    raw[8] = "2021-13-1";
+    ASSERT_EQ(-1, sdk_codec.EncodeRow(raw, &row));
+    raw.pop_back();
+    ASSERT_EQ(-1, sdk_codec.EncodeRow(raw, &row));
+}
+
 }  // namespace codec
 }  // namespace openmldb
 
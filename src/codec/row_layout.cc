@@ -0,0 +1,178 @@
+/*
+ * Copyright 2021 4Paradigm
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "codec/row_layout.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "base/glog_wapper.h"
+#include "base/strings.h"
+#include "boost/lexical_cast.hpp"
+
+namespace openmldb {
+namespace codec {
+
+RowLayout::RowLayout(const Schema& schema)
+    : is_valid_(true), bitmap_size_(0), str_field_cnt_(0), str_field_start_offset_(0), types_(), widths_(),
+      offsets_() {
+    bitmap_size_ = (schema.size() >> 3) + !!(schema.size() & 0x07);
+    uint32_t offset = HEADER_LENGTH + bitmap_size_;
+    for (const auto& column : schema) {
+        ::openmldb::type::DataType type = column.data_type();
+        uint32_t width = 0;
+        switch (type) {
+            case ::openmldb::type::kBool:
+                width = sizeof(bool);
+                break;
+            case ::openmldb::type::kSmallInt:
+                width = sizeof(int16_t);
+                break;
+            case ::openmldb::type::kInt:
+            case ::openmldb::type::kDate:
+                width = sizeof(int32_t);
+                break;
+            case ::openmldb::type::kFloat:
+                width = sizeof(float);
+                break;
+            case ::openmldb::type::kBigInt:
+            case ::openmldb::type::kTimestamp:
+                width = sizeof(int64_t);
+                break;
+            case ::openmldb::type::kDouble:
+                width = sizeof(double);
+                break;
+            case ::openmldb::type::kVarchar:
+            case ::openmldb::type::kString:
+                break;
+            default:
+                PDLOG(WARNING, "type %d of column %s is not supported", type, column.name().c_str());
+                is_valid_ = false;
+                return;
+        }
+        types_.push_back(type);
+        widths_.push_back(width);
+        if (width == 0) {
+            offsets_.push_back(str_field_cnt_);
+            str_field_cnt_++;
+        } else {
+            offsets_.push_back(offset);
+            offset += width;
+        }
+    }
+    str_field_start_offset_ = offset;
+}
+
+bool RowLayout::SetTextField(int8_t* row, uint32_t idx, const std::string& val) const {
+    try {
+        switch (types_[idx]) {
+            case ::openmldb::type::kBool: {
+                std::string b_val = val;
+                std::transform(b_val.begin(), b_val.end(), b_val.begin(), ::tolower);
+                if (b_val == "true") {
+                    SetField<bool>(row, idx, true);
+                } else if (b_val == "false") {
+                    SetField<bool>(row, idx, false);
+                } else {
+                    return false;
+                }
+                return true;
+            }
+            case ::openmldb::type::kSmallInt:
+                SetField<int16_t>(row, idx, boost::lexical_cast<int16_t>(val));
+                return true;
+            case ::openmldb::type::kInt:
+                SetField<int32_t>(row, idx, boost::lexical_cast<int32_t>(val));
+                return true;
+            case ::openmldb::type::kBigInt:
+            case ::openmldb::type::kTimestamp:
+                SetField<int64_t>(row, idx, boost::lexical_cast<int64_t>(val));
+                return true;
+            case ::openmldb::type::kFloat:
+                SetField<float>(row, idx, boost::lexical_cast<float>(val));
+                return true;
+            case ::openmldb::type::kDouble:
+                SetField<double>(row, idx, boost::lexical_cast<double>(val));
+                return true;
+            case ::openmldb::type::kDate: {
+                std::vector<std::string> parts;
+                ::openmldb::base::SplitString(val, "-", parts);
+                if (parts.size() != 3) {
+                    return false;
+                }
+                uint32_t year = boost::lexical_cast<uint32_t>(parts[0]);
+                uint32_t month = boost::lexical_cast<uint32_t>(parts[1]);
+                uint32_t day = boost::lexical_cast<uint32_t>(parts[2]);
+                if (year < 1900 || year > 9999 || month < 1 || month > 12 || day < 1 || day > 31) {
+                    return false;
+                }
+                int32_t date = (year - 1900) << 16;
+                date = date | ((month - 1) << 8);
+                date = date | day;
+                SetField<int32_t>(row, idx, date);
+                return true;
+            }
+            default:
+                return false;
+        }
+    } catch (std::exception const& e) {
+        return false;
+    }
+}
+
+void RowLayout::GetTextField(const int8_t* row, uint32_t row_size, uint8_t addr_length, uint32_t idx,
+                             std::string* val) const {
+    switch (types_[idx]) {
+        case ::openmldb::type::kBool:
+            val->assign(GetField<bool>(row, idx) ? "true" : "false");
+            break;
+        case ::openmldb::type::kSmallInt:
+            val->assign(std::to_string(GetField<int16_t>(row, idx)));
+            break;
+        case ::openmldb::type::kInt:
+            val->assign(std::to_string(GetField<int32_t>(row, idx)));
+            break;
+        case ::openmldb::type::kBigInt:
+        case ::openmldb::type::kTimestamp:
+            val->assign(std::to_string(GetField<int64_t>(row, idx)));
+            break;
+        case ::openmldb::type::kFloat:
+            val->assign(std::to_string(GetField<float>(row, idx)));
+            break;
+        case ::openmldb::type::kDouble:
+            val->assign(std::to_string(GetField<double>(row, idx)));
+            break;
+        case ::openmldb::type::kDate: {
+            int32_t date = GetField<int32_t>(row, idx);
+            uint32_t day = date & 0x0000000FF;
+            date = date >> 8;
+            uint32_t month = 1 + (date & 0x0000FF);
+            uint32_t year = 1900 + (date >> 8);
+            val->assign(std::to_string(year) + "-" + std::to_string(month) + "-" + std::to_string(day));
+            break;
+        }
+        default: {
+            const char* str = nullptr;
+            uint32_t size = 0;
+            GetString(row, row_size, addr_length, idx, &str, &size);
+            val->assign(str, size);
+        }
+    }
+}
+
+}  // namespace codec
+}  // namespace openmldb
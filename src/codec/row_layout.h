@@ -0,0 +1,196 @@
+/*
+ * Copyright 2021 4Paradigm
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SRC_CODEC_ROW_LAYOUT_H_
+#define SRC_CODEC_ROW_LAYOUT_H_
+
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "codec/codec.h"
+
+namespace openmldb {
+namespace codec {
+
+// RowLayout is the field layout of a schema version which is resolved once. Its accessors read and write the
+// fields of a row in the codec format by the offsets computed ahead, there are no type checks, so the caller
+// must guarantee the type of a field. RowView and RowBuilder are the checked generic path.
+class RowLayout {
+ public:
+    explicit RowLayout(const Schema& schema);
+
+    inline bool IsValid() const { return is_valid_; }
+    inline uint32_t GetFieldCnt() const { return types_.size(); }
+    inline ::openmldb::type::DataType GetType(uint32_t idx) const { return types_[idx]; }
+    inline bool IsString(uint32_t idx) const { return widths_[idx] == 0; }
+    // the byte size of a fixed width field, 0 for a string field
+    inline uint32_t GetWidth(uint32_t idx) const { return widths_[idx]; }
+    inline uint32_t GetStrFieldCnt() const { return str_field_cnt_; }
+
+    static inline uint8_t GetAddrLength(uint32_t row_size) {
+        if (row_size <= UINT8_MAX) {
+            return 1;
+        } else if (row_size <= UINT16_MAX) {
+            return 2;
+        } else if (row_size <= UINT24_MAX) {
+            return 3;
+        }
+        return 4;
+    }
+
+    // whether the row is a complete row of the layout
+    inline bool CheckRow(const int8_t* row, uint32_t size) const {
+        return row != nullptr && size > HEADER_LENGTH && size >= str_field_start_offset_ &&
+               *(reinterpret_cast<const uint32_t*>(row + VERSION_LENGTH)) == size;
+    }
+
+    static inline bool IsNULL(const int8_t* row, uint32_t idx) {
+        return *(reinterpret_cast<const uint8_t*>(row + HEADER_LENGTH + (idx >> 3))) & (1 << (idx & 0x07));
+    }
+
+    template <typename T>
+    inline T GetField(const int8_t* row, uint32_t idx) const {
+        T val;
+        memcpy(&val, row + offsets_[idx], sizeof(T));
+        return val;
+    }
+
+    // get the string field idx of a row, addr_length is GetAddrLength of the row size
+    inline void GetString(const int8_t* row, uint32_t row_size, uint8_t addr_length, uint32_t idx,
+                          const char** val, uint32_t* size) const {
+        uint32_t str_pos = offsets_[idx];
+        const int8_t* addr = row + str_field_start_offset_ + str_pos * addr_length;
+        uint32_t start = ReadAddr(addr, addr_length);
+        uint32_t end = str_pos + 1 < str_field_cnt_ ? ReadAddr(addr + addr_length, addr_length) : row_size;
+        *val = reinterpret_cast<const char*>(row + start);
+        *size = end - start;
+    }
+
+    // the total size of a row whose strings have str_length bytes in all and the string address length of it
+    inline uint32_t CalTotalLength(uint32_t str_length, uint8_t* addr_length) const {
+        uint32_t total_length = str_field_start_offset_ + str_length;
+        if (total_length + str_field_cnt_ <= UINT8_MAX) {
+            *addr_length = 1;
+        } else if (total_length + str_field_cnt_ * 2 <= UINT16_MAX) {
+            *addr_length = 2;
+        } else if (total_length + str_field_cnt_ * 3 <= UINT24_MAX) {
+            *addr_length = 3;
+        } else {
+            *addr_length = 4;
+        }
+        return total_length + str_field_cnt_ * *addr_length;
+    }
+
+    // write the header of a row and mark all fields null, it returns the offset of the first string
+    inline uint32_t InitRow(int8_t* row, uint32_t size, uint8_t addr_length, uint8_t version = 1) const {
+        *row = 1;
+        *(row + 1) = version;
+        *(reinterpret_cast<uint32_t*>(row + VERSION_LENGTH)) = size;
+        memset(row + HEADER_LENGTH, 0xFF, bitmap_size_);
+        return str_field_start_offset_ + str_field_cnt_ * addr_length;
+    }
+
+    template <typename T>
+    inline void SetField(int8_t* row, uint32_t idx, T val) const {
+        memcpy(row + offsets_[idx], &val, sizeof(T));
+        SetNotNULL(row, idx);
+    }
+
+    // copy a fixed width field from the field src_idx of a row with the layout src
+    inline void CopyField(int8_t* row, uint32_t idx, const RowLayout& src, const int8_t* src_row,
+                          uint32_t src_idx) const {
+        memcpy(row + offsets_[idx], src_row + src.offsets_[src_idx], widths_[idx]);
+        SetNotNULL(row, idx);
+    }
+
+    // the strings must be set in the order of the string fields, including the null ones. str_offset is the
+    // offset to write the string, it starts from the value InitRow returns
+    inline void SetString(int8_t* row, uint32_t idx, uint8_t addr_length, const char* val, uint32_t size,
+                          uint32_t* str_offset) const {
+        WriteAddr(row + str_field_start_offset_ + offsets_[idx] * addr_length, addr_length, *str_offset);
+        if (size > 0) {
+            memcpy(row + *str_offset, val, size);
+        }
+        *str_offset += size;
+        SetNotNULL(row, idx);
+    }
+
+    // the fields are null after InitRow, only the null strings have to be set for their addresses
+    inline void SetNULLString(int8_t* row, uint32_t idx, uint8_t addr_length, uint32_t str_offset) const {
+        WriteAddr(row + str_field_start_offset_ + offsets_[idx] * addr_length, addr_length, str_offset);
+    }
+
+    // parse the text of a fixed width field and set it as RowBuilder::AppendValue does, false if val is malformed
+    bool SetTextField(int8_t* row, uint32_t idx, const std::string& val) const;
+
+    // the text of the not null field idx of a row as RowView::GetStrValue formats it
+    void GetTextField(const int8_t* row, uint32_t row_size, uint8_t addr_length, uint32_t idx,
+                      std::string* val) const;
+
+ private:
+    static inline void SetNotNULL(int8_t* row, uint32_t idx) {
+        *(reinterpret_cast<uint8_t*>(row + HEADER_LENGTH + (idx >> 3))) &= ~(1 << (idx & 0x07));
+    }
+
+    // the address of 3 bytes is big endian, the others are in the host byte order
+    static inline uint32_t ReadAddr(const int8_t* ptr, uint8_t addr_length) {
+        switch (addr_length) {
+            case 1:
+                return *(reinterpret_cast<const uint8_t*>(ptr));
+            case 2:
+                return *(reinterpret_cast<const uint16_t*>(ptr));
+            case 3:
+                return (static_cast<uint32_t>(static_cast<uint8_t>(ptr[0])) << 16) |
+                       (static_cast<uint32_t>(static_cast<uint8_t>(ptr[1])) << 8) | static_cast<uint8_t>(ptr[2]);
+            default:
+                return *(reinterpret_cast<const uint32_t*>(ptr));
+        }
+    }
+
+    static inline void WriteAddr(int8_t* ptr, uint8_t addr_length, uint32_t addr) {
+        switch (addr_length) {
+            case 1:
+                *(reinterpret_cast<uint8_t*>(ptr)) = addr;
+                break;
+            case 2:
+                *(reinterpret_cast<uint16_t*>(ptr)) = addr;
+                break;
+            case 3:
+                ptr[0] = addr >> 16;
+                ptr[1] = (addr & 0xFF00) >> 8;
+                ptr[2] = addr & 0x00FF;
+                break;
+            default:
+                *(reinterpret_cast<uint32_t*>(ptr)) = addr;
+        }
+    }
+
+    bool is_valid_;
+    uint32_t bitmap_size_;
+    uint32_t str_field_cnt_;
+    uint32_t str_field_start_offset_;
+    std::vector<::openmldb::type::DataType> types_;
+    std::vector<uint32_t> widths_;
+    // the byte offset of a fixed width field or the position of a string field in the string fields
+    std::vector<uint32_t> offsets_;
+};
+
+}  // namespace codec
+}  // namespace openmldb
+
+#endif  // SRC_CODEC_ROW_LAYOUT_H_
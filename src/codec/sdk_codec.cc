@@ -43,6 +43,7 @@ SDKCodec::SDKCodec(const ::openmldb::nameserver::TableInfo& table_info)
     ParseSchemaVer(table_info.schema_versions(), add_schema);
     ParseAddedColumnDesc(add_schema);
     ParseTsCol();
+    BuildLayouts();
     for (const auto& name : table_info.partition_key()) {
         auto iter = schema_idx_map_.find(name);
         if (iter != schema_idx_map_.end()) {
@@ -64,6 +65,7 @@ SDKCodec::SDKCodec(const ::openmldb::api::TableMeta& table_info)
     ParseSchemaVer(table_info.schema_versions(), add_schema);
     ParseAddedColumnDesc(table_info.added_column_desc());
     ParseTsCol();
+    BuildLayouts();
 }
 
 void SDKCodec::ParseColumnDesc(const Schema& column_desc) {
@@ -129,6 +131,16 @@ void SDKCodec::ParseSchemaVer(const VerSchema& ver_schema, const Schema& add_sch
     }
 }
 
+void SDKCodec::BuildLayouts() {
+    if (format_version_ != 1) {
+        return;
+    }
+    layout_ = std::make_shared<RowLayout>(schema_);
+    for (const auto& kv : version_schema_) {
+        version_layout_.emplace(kv.first, std::make_shared<RowLayout>(*kv.second));
+    }
+}
+
 int SDKCodec::EncodeDimension(const std::map<std::string, std::string>& raw_data, uint32_t pid_num,
                               std::map<uint32_t, Dimension>* dimensions) {
     uint32_t dimension_idx = 0;
@@ -237,22 +249,59 @@ int SDKCodec::EncodeTsDimension(const std::vector<std::string>& raw_data, std::v
 }
 
 int SDKCodec::EncodeRow(const std::vector<std::string>& raw_data, std::string* row) {
-    auto ret = RowCodec::EncodeRow(raw_data, schema_, last_ver_, *row);
-    return ret.code;
+    if (!layout_ || !layout_->IsValid()) {
+        return RowCodec::EncodeRow(raw_data, schema_, last_ver_, *row).code;
+    }
+    int32_t str_len = RowCodec::CalStrLength(raw_data, schema_);
+    if (raw_data.empty() || str_len < 0) {
+        return -1;
+    }
+    const RowLayout& layout = *layout_;
+    uint8_t addr_length = 0;
+    uint32_t size = layout.CalTotalLength(str_len, &addr_length);
+    row->resize(size);
+    int8_t* buf = reinterpret_cast<int8_t*>(&((*row)[0]));
+    uint32_t str_offset = layout.InitRow(buf, size, addr_length, last_ver_);
+    for (uint32_t i = 0; i < layout.GetFieldCnt(); i++) {
+        const std::string& val = raw_data[i];
+        if (val == "null" || val == NONETOKEN) {
+            if (schema_.Get(i).not_null()) {
+                return -1;
+            }
+            if (layout.IsString(i)) {
+                layout.SetNULLString(buf, i, addr_length, str_offset);
+            }
+        } else if (layout.IsString(i)) {
+            layout.SetString(buf, i, addr_length, val.data(), val.size(), &str_offset);
+        } else if (!layout.SetTextField(buf, i, val)) {
+            return -1;
+        }
+    }
+    return 0;
 }
 
 int SDKCodec::DecodeRow(const std::string& row, std::vector<std::string>* value) {
     if (format_version_ == 1) {
         const int8_t* data = reinterpret_cast<const int8_t*>(row.data());
         int32_t ver = openmldb::codec::RowView::GetSchemaVersion(data);
-        auto it = version_schema_.find(ver);
-        if (it == version_schema_.end()) {
+        auto it = version_layout_.find(ver);
+        if (it == version_layout_.end()) {
             return -1;
         }
-        auto schema = it->second;
-        if (!RowCodec::DecodeRow(*schema, data, schema->size(), false, 0, schema->size(), *value)) {
+        const RowLayout& layout = *it->second;
+        if (!layout.IsValid() || !layout.CheckRow(data, row.size())) {
             return -1;
         }
+        uint8_t addr_length = RowLayout::GetAddrLength(row.size());
+        for (uint32_t i = 0; i < layout.GetFieldCnt(); i++) {
+            if (RowLayout::IsNULL(data, i)) {
+                value->emplace_back(NONETOKEN);
+                continue;
+            }
+            std::string col;
+            layout.GetTextField(data, row.size(), addr_length, i, &col);
+            value->emplace_back(std::move(col));
+        }
     } else {
         openmldb::base::Slice data(row);
         if (!RowCodec::DecodeRow(base_schema_size_, base_schema_size_ + modify_times_, data, value)) {
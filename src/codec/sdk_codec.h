@@ -22,6 +22,7 @@
 #include <utility>
 #include <vector>
 
+#include "codec/row_layout.h"
 #include "codec/schema_codec.h"
 #include "proto/common.pb.h"
 #include "proto/tablet.pb.h"
@@ -65,6 +66,7 @@ class SDKCodec {
     void ParseAddedColumnDesc(const Schema& column_desc);
     void ParseSchemaVer(const VerSchema& ver_schema, const Schema& add_schema);
     void ParseTsCol();
+    void BuildLayouts();
 
  private:
     Schema schema_;
@@ -77,6 +79,9 @@ class SDKCodec {
     int modify_times_;
     std::map<int32_t, std::shared_ptr<Schema>> version_schema_;
     int32_t last_ver_;
+    // the layouts of format version 1, layout_ is of schema_ which rows are encoded with
+    std::shared_ptr<RowLayout> layout_;
+    std::map<int32_t, std::shared_ptr<RowLayout>> version_layout_;
 };
 
 }  // namespace codec
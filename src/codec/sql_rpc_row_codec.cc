@@ -16,6 +16,8 @@
 
 #include "codec/sql_rpc_row_codec.h"
 
+#include <algorithm>
+
 namespace openmldb {
 namespace codec {
 
@@ -105,5 +107,39 @@ bool EncodeRpcRow(const int8_t* buf, size_t size, butil::IOBuf* io_buf) {
     return true;
 }
 
+IOBufArena::IOBufArena(butil::IOBuf* io_buf)
+    : io_buf_(io_buf), block_(nullptr), used_(0), capacity_(0), next_capacity_(kMinBlockSize) {}
+
+IOBufArena::~IOBufArena() { Flush(); }
+
+int8_t* IOBufArena::Allocate(uint32_t size) {
+    if (block_ == nullptr || used_ + size > capacity_) {
+        Flush();
+        capacity_ = std::max(size, next_capacity_);
+        next_capacity_ = std::min(next_capacity_ * 2, kMaxBlockSize);
+        block_ = reinterpret_cast<char*>(malloc(capacity_));
+    }
+    int8_t* ptr = reinterpret_cast<int8_t*>(block_ + used_);
+    used_ += size;
+    return ptr;
+}
+
+void IOBufArena::Discard(uint32_t size) { used_ -= std::min(size, used_); }
+
+void IOBufArena::Flush() {
+    if (block_ == nullptr) {
+        return;
+    }
+    if (used_ == 0) {
+        free(block_);
+    } else {
+        // the IOBuf owns the block from now on and frees it with its last reference
+        io_buf_->append_user_data(block_, used_, free);
+    }
+    block_ = nullptr;
+    used_ = 0;
+    capacity_ = 0;
+}
+
 }  // namespace codec
 }  // namespace openmldb
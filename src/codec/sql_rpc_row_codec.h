@@ -37,6 +37,34 @@ bool EncodeRpcRow(const hybridse::codec::Row& row, butil::IOBuf* buf, size_t* to
 
 bool EncodeRpcRow(const int8_t* buf, size_t size, butil::IOBuf* io_buf);
 
+// IOBufArena lays out the records of a response next to each other in blocks which the IOBuf takes over by
+// append_user_data, so a record is written into the IOBuf memory in place and never copied. The blocks grow from
+// kMinBlockSize to kMaxBlockSize, a block is appended when the next record doesn't fit or on Flush
+class IOBufArena {
+ public:
+    static constexpr uint32_t kMinBlockSize = 8 * 1024;
+    static constexpr uint32_t kMaxBlockSize = 1024 * 1024;
+
+    explicit IOBufArena(butil::IOBuf* io_buf);
+    ~IOBufArena();
+
+    // the space of a record of size bytes in the IOBuf. It must be filled before the next Allocate or Flush
+    int8_t* Allocate(uint32_t size);
+
+    // give back the space of the last Allocate of size bytes, which is not filled, so Flush doesn't append it
+    void Discard(uint32_t size);
+
+    // append the records allocated to the IOBuf
+    void Flush();
+
+ private:
+    butil::IOBuf* io_buf_;
+    char* block_;
+    uint32_t used_;
+    uint32_t capacity_;
+    uint32_t next_capacity_;
+};
+
 }  // namespace codec
 }  // namespace openmldb
 #endif  // SRC_CODEC_SQL_RPC_ROW_CODEC_H_
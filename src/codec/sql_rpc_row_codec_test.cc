@@ -123,6 +123,40 @@ TEST_F(SqlRpcRowCodecTest, TestMultiSlice) {
     ASSERT_EQ(0, decoded.size(3));
 }
 
+TEST_F(SqlRpcRowCodecTest, TestIOBufArena) {
+    butil::IOBuf buf;
+    buf.append("head");
+    std::string expect = "head";
+    {
+        IOBufArena arena(&buf);
+        // the records span several blocks and one record is larger than a block
+        std::vector<uint32_t> sizes = {10, 1000, IOBufArena::kMinBlockSize, 3 * IOBufArena::kMaxBlockSize, 7};
+        for (uint32_t i = 0; i < 20; i++) {
+            uint32_t size = sizes[i % sizes.size()];
+            int8_t* ptr = arena.Allocate(size);
+            memset(ptr, 'a' + i % 26, size);
+            expect.append(size, 'a' + i % 26);
+        }
+        // the last block is appended when the arena is destroyed
+        ASSERT_LT(buf.size(), expect.size());
+    }
+    ASSERT_EQ(expect, buf.to_string());
+    // a flush without records appends nothing
+    IOBufArena arena(&buf);
+    arena.Allocate(0);
+    arena.Flush();
+    ASSERT_EQ(expect.size(), buf.size());
+    // the space of a record which fails to be filled is discarded
+    {
+        IOBufArena discard_arena(&buf);
+        memset(discard_arena.Allocate(5), 'x', 5);
+        expect.append(5, 'x');
+        discard_arena.Allocate(100);
+        discard_arena.Discard(100);
+    }
+    ASSERT_EQ(expect, buf.to_string());
+}
+
 }  // namespace codec
 }  // namespace openmldb
 
@@ -38,6 +38,8 @@ DEFINE_uint32(name_server_op_execute_timeout, 2 * 60 * 60 * 1000, "config the ti
 DEFINE_bool(auto_failover, false, "enable or disable auto failover");
 DEFINE_bool(enable_timeseries_table, true, "enable or disable timeseries table");
 DEFINE_int32(max_op_num, 10000, "config the max op num");
+DEFINE_uint32(max_table_change_log_size, 1000,
+              "config the max entries of the table change log which clients refresh the changed tables by");
 DEFINE_uint32(partition_num, 8, "config the default partition_num");
 DEFINE_uint32(replica_num, 3,
               "config the default replica_num. if set 3, there is one leader "
@@ -48,13 +50,34 @@ DEFINE_int32(gc_pool_size, 2, "the size of tablet gc thread pool");
 DEFINE_int32(gc_safe_offset, 1, "the safe offset of tablet gc in minute");
 DEFINE_uint64(gc_on_table_recover_count, 10000000, "make a gc on recover count");
 DEFINE_uint32(gc_deleted_pk_version_delta, 2, "config the gc version delta");
+DEFINE_bool(enable_latest_bounded_list, false,
+            "trim the records beyond latest ttl on put for latest and absorlat table");
+DEFINE_uint32(latest_bounded_list_slack, 8, "config the count of records over latest ttl to trigger trim on put");
+DEFINE_uint32(time_block_hot_cnt, 0,
+              "config the count of the latest records of a key kept in the skiplist, the older ones are sealed into "
+              "time blocks by gc. 0 disables the time blocks");
+DEFINE_uint32(time_block_min_cnt, 128, "config the min count of the records over time_block_hot_cnt to seal");
+DEFINE_uint32(time_block_max_cnt, 1024, "config the max count of the records in a time block");
+DEFINE_bool(time_block_compress, false, "compress the values in the time blocks with snappy");
+DEFINE_uint32(cold_tier_age, 0,
+              "config the age in minute of the rows which gc moves from memory into the disk tier of a table. "
+              "0 disables the disk tier");
 DEFINE_double(mem_release_rate, 5, "specify memory release rate, which should be in 0 ~ 10");
 DEFINE_int32(task_pool_size, 3, "the size of tablet task thread pool");
 DEFINE_int32(io_pool_size, 2, "the size of tablet io task thread pool");
+DEFINE_int32(procedure_compile_pool_size, 4,
+             "the size of tablet thread pool which compiles the procedures recovered on startup or refresh");
 DEFINE_bool(use_name, false, "enable or disable use server name");
 DEFINE_string(data_dir, "./data", "the path of data dir");
 DEFINE_bool(enable_distsql, false, "enable or disable distribute sql");
+DEFINE_string(jit_object_cache_path, "",
+              "config the dir of the object code cache of the compiled sql, the procedures are linked from the "
+              "cache after a restart. empty disables the cache");
 DEFINE_bool(enable_localtablet, true, "enable or disable local tablet opt when distribute sql circumstance");
+DEFINE_uint32(request_cache_size, 0,
+              "config the max number of the procedure outputs in request mode the tablet caches, which are reused "
+              "until a key they read is written. 0 disables the cache, and so does enable_distsql");
+DEFINE_uint32(request_cache_max_age, 1000, "config the max age in millisecond of a cached procedure output");
 
 // scan configuration
 DEFINE_uint32(scan_max_bytes_size, 2 * 1024 * 1024, "config the max size of scan bytes size");
@@ -110,6 +133,12 @@ DEFINE_uint32(make_snapshot_offline_interval, 60 * 60 * 24,
               "makesnapshot from ns. unit is second");
 DEFINE_string(snapshot_compression, "off", "Type of snapshot compression, can be off, snappy, zlib");
 DEFINE_int32(snapshot_pool_size, 1, "the size of tablet thread pool for making snapshot");
+DEFINE_uint32(snapshot_max_segments, 0,
+              "config the max incremental segments of a snapshot, making snapshot writes only the binlog delta "
+              "as a new segment until the limit is reached, then all segments are compacted. 0 means disabled");
+DEFINE_bool(enable_memtable_checkpoint, false,
+            "dump the memtable to a checkpoint after making snapshot, and recover from the checkpoint on load "
+            "table instead of replaying the snapshot");
 
 DEFINE_uint32(load_index_max_wait_time, 120 * 60 * 1000, "config the max wait time of load index");
 
@@ -135,11 +164,17 @@ DEFINE_uint32(block_cache_mb, 4096,
 DEFINE_uint32(write_buffer_mb, 128, "Memtable size");
 DEFINE_uint32(block_cache_shardbits, 8, "Divide block cache into 2^8 shards to avoid cache contention");
 DEFINE_bool(verify_compression, false, "For debug");
+DEFINE_uint32(disk_table_file_size_mb, 256, "the size of the sorted files a disk table compacts into");
 
 // load table resouce control
 DEFINE_uint32(load_table_batch, 30, "set laod table batch size");
 DEFINE_uint32(load_table_thread_num, 3, "set load tabale thread pool size");
 DEFINE_uint32(load_table_queue_size, 1000, "set load tabale queue size");
 
+// add index resouce control
+DEFINE_uint32(extract_index_thread_num, 4, "the thread num of extracting a new index from the memory of an index");
+DEFINE_uint32(extract_index_max_rate, 0,
+              "the max records per second of extracting a new index from memory. 0 means no limit");
+
 // multiple data center
 DEFINE_uint32(get_replica_status_interval, 10000, "config the interval to sync replica cluster status time");
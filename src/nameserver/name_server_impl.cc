@@ -44,6 +44,7 @@ DECLARE_int32(get_task_status_interval);
 DECLARE_int32(name_server_task_pool_size);
 DECLARE_int32(name_server_task_wait_time);
 DECLARE_int32(max_op_num);
+DECLARE_uint32(max_table_change_log_size);
 DECLARE_uint32(partition_num);
 DECLARE_uint32(replica_num);
 DECLARE_bool(auto_failover);
@@ -781,6 +782,24 @@ bool NameServerImpl::Recover() {
             }
         }
         value.clear();
+        {
+            std::lock_guard<std::mutex> lock(change_log_mu_);
+            // continue the sequence of the previous leader, so clients keep refreshing by the log
+            if (!zk_client_->GetNodeValue(zk_table_change_log_node_, value) || !table_change_log_.Decode(value)) {
+                // a new log has a new epoch, the clients of the old one will do a full refresh
+                table_change_log_ = ::openmldb::zk::ZkChangeLog();
+                table_change_log_.epoch = ::baidu::common::timer::get_micros();
+                bool ok = zk_client_->IsExistNode(zk_table_change_log_node_) == 0
+                              ? zk_client_->SetNodeValue(zk_table_change_log_node_, table_change_log_.Encode())
+                              : zk_client_->CreateNode(zk_table_change_log_node_, table_change_log_.Encode());
+                if (!ok) {
+                    PDLOG(WARNING, "create zk table change log node failed");
+                    return false;
+                }
+            }
+            changed_nodes_.clear();
+        }
+        value.clear();
         if (!zk_client_->GetNodeValue(zk_auto_failover_node_, value)) {
             auto_failover_.load(std::memory_order_acquire) ? value = "true" : value = "false";
             if (!zk_client_->CreateNode(zk_auto_failover_node_, value)) {
@@ -1539,6 +1558,7 @@ bool NameServerImpl::Init(const std::string& zk_cluster, const std::string& zk_p
     zk_zone_data_path_ = zk_path + "/cluster";
     zk_auto_failover_node_ = zk_config_path + "/auto_failover";
     zk_table_changed_notify_node_ = zk_table_path + "/notify";
+    zk_table_change_log_node_ = zk_table_path + "/notify_log";
     running_.store(false, std::memory_order_release);
     mode_.store(kNORMAL, std::memory_order_release);
     auto_failover_.store(FLAGS_auto_failover, std::memory_order_release);
@@ -2496,6 +2516,8 @@ int NameServerImpl::CreateTableOnTablet(std::shared_ptr<::openmldb::nameserver::
     if (table_info->has_key_entry_max_height()) {
         table_meta.set_key_entry_max_height(table_info->key_entry_max_height());
     }
+    table_meta.set_key_index_type(table_info->key_index_type());
+    table_meta.set_storage_mode(table_info->storage_mode());
     for (int idx = 0; idx < table_info->column_desc_size(); idx++) {
         ::openmldb::common::ColumnDesc* column_desc = table_meta.add_column_desc();
         column_desc->CopyFrom(table_info->column_desc(idx));
@@ -3304,6 +3326,7 @@ void NameServerImpl::DropTableInternel(const DropTableRequest& request, GeneralR
                 code = 304;
             } else {
                 PDLOG(INFO, "delete table node[%s/%u]", zk_db_table_data_path_.c_str(), tid);
+                RecordNodeChanged(zk_db_table_data_path_ + "/" + std::to_string(tid));
                 db_table_info_[request.db()].erase(name);
             }
         } else {
@@ -3312,6 +3335,7 @@ void NameServerImpl::DropTableInternel(const DropTableRequest& request, GeneralR
                 code = 304;
             } else {
                 PDLOG(INFO, "delete table node[%s/%s]", zk_table_data_path_.c_str(), name.c_str());
+                RecordNodeChanged(zk_table_data_path_ + "/" + name);
                 table_info_.erase(name);
             }
         }
@@ -3857,6 +3881,7 @@ bool NameServerImpl::SetTableInfo(std::shared_ptr<::openmldb::nameserver::TableI
         }
         PDLOG(INFO, "create db table node[%s/%u] success! value[%s] value_size[%u]", zk_db_table_data_path_.c_str(),
               table_info->tid(), table_value.c_str(), table_value.length());
+        RecordNodeChanged(zk_db_table_data_path_ + "/" + std::to_string(table_info->tid()));
         {
             std::lock_guard<std::mutex> lock(mu_);
             db_table_info_[table_info->db()].insert(std::make_pair(table_info->name(), table_info));
@@ -3871,6 +3896,7 @@ bool NameServerImpl::SetTableInfo(std::shared_ptr<::openmldb::nameserver::TableI
         }
         PDLOG(INFO, "create table node[%s/%s] success! value[%s] value_size[%u]", zk_table_data_path_.c_str(),
               table_info->name().c_str(), table_value.c_str(), table_value.length());
+        RecordNodeChanged(zk_table_data_path_ + "/" + table_info->name());
         {
             std::lock_guard<std::mutex> lock(mu_);
             table_info_.insert(std::make_pair(table_info->name(), table_info));
@@ -4030,6 +4056,7 @@ bool NameServerImpl::SaveTableInfo(std::shared_ptr<TableInfo> table_info) {
             return false;
         }
         PDLOG(INFO, "create table node[%s/%s] success!", zk_table_data_path_.c_str(), table_info->name().c_str());
+        RecordNodeChanged(zk_table_data_path_ + "/" + table_info->name());
     } else {
         if (!zk_client_->CreateNode(zk_db_table_data_path_ + "/" + std::to_string(table_info->tid()), table_value)) {
             PDLOG(WARNING, "create object db table node[%s/%s] failed!", zk_db_table_data_path_.c_str(),
@@ -4037,6 +4064,7 @@ bool NameServerImpl::SaveTableInfo(std::shared_ptr<TableInfo> table_info) {
             return false;
         }
         PDLOG(INFO, "create db table node[%s/%s] success!", zk_db_table_data_path_.c_str(), table_info->name().c_str());
+        RecordNodeChanged(zk_db_table_data_path_ + "/" + std::to_string(table_info->tid()));
     }
 
     return true;
@@ -8087,7 +8115,21 @@ void NameServerImpl::UpdateLeaderInfo(std::shared_ptr<::openmldb::api::TaskInfo>
     task_info->set_status(::openmldb::api::TaskStatus::kFailed);
 }
 
+void NameServerImpl::RecordNodeChanged(const std::string& path) {
+    std::lock_guard<std::mutex> lock(change_log_mu_);
+    changed_nodes_.push_back(path);
+}
+
 void NameServerImpl::NotifyTableChanged() {
+    {
+        std::lock_guard<std::mutex> lock(change_log_mu_);
+        // the log is written before the notification, so the clients notified see the changed nodes
+        table_change_log_.Append(changed_nodes_, FLAGS_max_table_change_log_size);
+        changed_nodes_.clear();
+        if (!zk_client_->SetNodeValue(zk_table_change_log_node_, table_change_log_.Encode())) {
+            PDLOG(WARNING, "set zk table change log failed. node is %s", zk_table_change_log_node_.c_str());
+        }
+    }
     bool ok = zk_client_->Increment(zk_table_changed_notify_node_);
     if (!ok) {
         PDLOG(WARNING, "increment failed. node is %s", zk_table_changed_notify_node_.c_str());
@@ -9091,6 +9133,7 @@ bool NameServerImpl::UpdateZkTableNodeWithoutNotify(const TableInfo* table_info)
         return false;
     }
     LOG(INFO) << "update table node[" << temp_path << "] success";
+    RecordNodeChanged(temp_path);
     return true;
 }
 
@@ -9387,6 +9430,46 @@ int NameServerImpl::CreateAddIndexOPTask(std::shared_ptr<OPData> op_data) {
         return 0;
     }
     const int part_size = table_info->table_partition_size();
+    // the records of the new index are in the partition already if the table has only one partition or an index
+    // with the same key columns, so dumping and sending index data to other partitions are skipped
+    bool local_data = part_size == 1 ||
+                      std::any_of(table_info->column_key().begin(), table_info->column_key().end(),
+                                  [&ck](const ::openmldb::common::ColumnKey& column_key) {
+                                      return column_key.flag() == 0 && column_key.index_name() != ck.index_name() &&
+                                             column_key.col_name_size() == ck.col_name_size() &&
+                                             std::equal(ck.col_name().begin(), ck.col_name().end(),
+                                                        column_key.col_name().begin());
+                                  });
+    if (local_data) {
+        task = CreateAddIndexToTabletTask(op_index, kAddIndexOP, tid, pid, endpoints, ck);
+        if (!task) {
+            LOG(WARNING) << "create add index task failed. tid[" << tid << "] pid[" << pid << "]";
+            return -1;
+        }
+        op_data->task_list_.push_back(task);
+        task = CreateExtractIndexDataTask(op_index, kAddIndexOP, tid, pid, endpoints, part_size, ck, ck_idx, true);
+        if (!task) {
+            LOG(WARNING) << "Create extract index data task failed. tid[" << tid << "] pid[" << pid << "]";
+            return -1;
+        }
+        op_data->task_list_.push_back(task);
+        task = CreateCheckBinlogSyncProgressTask(op_index, kAddIndexOP, name, db, pid, follower_endpoint,
+                                                 FLAGS_check_binlog_sync_progress_delta);
+        if (!task) {
+            LOG(WARNING) << "create CheckBinlogSyncProgressTask failed. name[" << name << "] pid[" << pid << "]";
+            return -1;
+        }
+        op_data->task_list_.push_back(task);
+        boost::function<bool()> fun = boost::bind(&NameServerImpl::AddIndexToTableInfo, this, name, db, ck, ck_idx);
+        task = CreateTableSyncTask(op_index, kAddIndexOP, tid, fun);
+        if (!task) {
+            LOG(WARNING) << "create table sync task failed. name[" << name << "] pid[" << pid << "]";
+            return -1;
+        }
+        op_data->task_list_.push_back(task);
+        PDLOG(INFO, "index data is in partition. skip dumping index data. table[%s] pid[%u]", name.c_str(), pid);
+        return 0;
+    }
     task = CreateDumpIndexDataTask(op_index, kAddIndexOP, tid, pid, leader_endpoint, part_size, ck, ck_idx);
     if (!task) {
         LOG(WARNING) << "create dump index task failed. tid[" << tid << "] pid[" << pid << "] endpoint["
@@ -9407,7 +9490,7 @@ int NameServerImpl::CreateAddIndexOPTask(std::shared_ptr<OPData> op_data) {
         return -1;
     }
     op_data->task_list_.push_back(task);
-    task = CreateExtractIndexDataTask(op_index, kAddIndexOP, tid, pid, endpoints, part_size, ck, ck_idx);
+    task = CreateExtractIndexDataTask(op_index, kAddIndexOP, tid, pid, endpoints, part_size, ck, ck_idx, false);
     if (!task) {
         LOG(WARNING) << "Create extract index data task failed. tid[" << tid << "] pid[" << pid << "]";
         return -1;
@@ -9555,7 +9638,7 @@ std::shared_ptr<Task> NameServerImpl::CreateExtractIndexDataTask(uint64_t op_ind
                                                                  const std::vector<std::string>& endpoints,
                                                                  uint32_t partition_num,
                                                                  const ::openmldb::common::ColumnKey& column_key,
-                                                                 uint32_t idx) {
+                                                                 uint32_t idx, bool local_data) {
     std::shared_ptr<Task> task = std::make_shared<Task>("", std::make_shared<::openmldb::api::TaskInfo>());
     for (const auto& endpoint : endpoints) {
         std::shared_ptr<TabletInfo> tablet = GetHealthTabletInfoNoLock(endpoint);
@@ -9570,7 +9653,7 @@ std::shared_ptr<Task> NameServerImpl::CreateExtractIndexDataTask(uint64_t op_ind
         sub_task->task_info_->set_status(::openmldb::api::TaskStatus::kInited);
         sub_task->task_info_->set_endpoint(endpoint);
         boost::function<bool()> fun = boost::bind(&TabletClient::ExtractIndexData, tablet->client_, tid, pid,
-                                                  partition_num, column_key, idx, sub_task->task_info_);
+                                                  partition_num, column_key, idx, local_data, sub_task->task_info_);
         sub_task->fun_ = boost::bind(&NameServerImpl::WrapTaskFun, this, fun, sub_task->task_info_);
         task->sub_task_.push_back(sub_task);
         PDLOG(INFO,
@@ -10035,6 +10118,7 @@ void NameServerImpl::CreateProcedure(RpcController* controller, const CreateProc
             response->set_msg("create zk node failed");
             break;
         }
+        RecordNodeChanged(sp_data_path);
         {
             std::lock_guard<std::mutex> lock(mu_);
             auto& sp_table_map = db_sp_table_map_[db_name];
@@ -10153,6 +10237,7 @@ void NameServerImpl::DropProcedure(RpcController* controller, const DropProcedur
             response->set_msg("delete storage procedure zk node failed");
             return;
         }
+        RecordNodeChanged(sp_data_path);
         auto& sp_table_map = db_sp_table_map_[db_name];
         auto& table_vec = sp_table_map[sp_name];
         auto& table_sp_map = db_table_sp_map_[db_name];
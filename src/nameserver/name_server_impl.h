@@ -37,6 +37,7 @@
 #include "proto/tablet.pb.h"
 #include "zk/dist_lock.h"
 #include "zk/zk_client.h"
+#include "zk/zk_node_cache.h"
 
 DECLARE_uint32(name_server_task_concurrency);
 DECLARE_uint32(name_server_task_concurrency_for_replica_cluster);
@@ -577,7 +578,8 @@ class NameServerImpl : public NameServer {
     std::shared_ptr<Task> CreateExtractIndexDataTask(uint64_t op_index, ::openmldb::api::OPType op_type, uint32_t tid,
                                                      uint32_t pid, const std::vector<std::string>& endpoints,
                                                      uint32_t partition_num,
-                                                     const ::openmldb::common::ColumnKey& column_key, uint32_t idx);
+                                                     const ::openmldb::common::ColumnKey& column_key, uint32_t idx,
+                                                     bool local_data);
 
     std::shared_ptr<Task> CreateAddIndexToTabletTask(uint64_t op_index, ::openmldb::api::OPType op_type, uint32_t tid,
                                                      uint32_t pid, const std::vector<std::string>& endpoints,
@@ -664,7 +666,11 @@ class NameServerImpl : public NameServer {
     int DropTableRemoteOP(const std::string& name, const std::string& db, const std::string& alias,
                           uint64_t parent_id = INVALID_PARENT_ID,
                           uint32_t concurrency = FLAGS_name_server_task_concurrency_for_replica_cluster);
+    // write the change log with the nodes recorded since the last notification and notify the table changed
     void NotifyTableChanged();
+    // record a table or procedure node which is created, updated or deleted, it's written to the change log by the
+    // next NotifyTableChanged
+    void RecordNodeChanged(const std::string& path);
     void DeleteDoneOP();
     void UpdateTableStatus();
     int DropTableOnTablet(std::shared_ptr<::openmldb::nameserver::TableInfo> table_info);
@@ -769,6 +775,10 @@ class NameServerImpl : public NameServer {
     std::string zk_auto_failover_node_;
     std::string zk_auto_recover_table_node_;
     std::string zk_table_changed_notify_node_;
+    std::string zk_table_change_log_node_;
+    std::mutex change_log_mu_;
+    ::openmldb::zk::ZkChangeLog table_change_log_;
+    std::vector<std::string> changed_nodes_;
     std::string zk_offline_endpoint_lock_node_;
     std::string zk_zone_data_path_;
     uint32_t table_index_;
@@ -35,6 +35,7 @@ SQLBatchRequestResultSet::SQLBatchRequestResultSet(
       index_(-1),
       byte_size_(0),
       position_(0),
+      cur_row_size_(0),
       common_row_view_(),
       non_common_row_view_(),
       external_schema_(),
@@ -112,6 +113,7 @@ bool SQLBatchRequestResultSet::IsNULL(int index) {
 
 bool SQLBatchRequestResultSet::Next() {
     index_++;
+    cur_row_size_ = 0;
     if (index_ < static_cast<int32_t>(response_->count()) && position_ < byte_size_) {
         if (non_common_schema_.empty()) {
             return true;
@@ -120,10 +122,11 @@ bool SQLBatchRequestResultSet::Next() {
         uint32_t row_size = 0;
         cntl_->response_attachment().copy_to(&row_size, 4, position_ + 2);
         DLOG(INFO) << "row size " << row_size << " position " << position_ << " byte size " << byte_size_;
-        butil::IOBuf tmp;
-        cntl_->response_attachment().append_to(&tmp, row_size, position_);
+        cur_row_.clear();
+        cntl_->response_attachment().append_to(&cur_row_, row_size, position_);
+        cur_row_size_ = row_size;
         position_ += row_size;
-        bool ok = non_common_row_view_->Reset(tmp);
+        bool ok = non_common_row_view_->Reset(cur_row_);
         if (!ok) {
             LOG(WARNING) << "reset row buf failed";
             return false;
@@ -136,9 +139,35 @@ bool SQLBatchRequestResultSet::Next() {
 bool SQLBatchRequestResultSet::Reset() {
     index_ = -1;
     position_ = common_buf_size_;
+    cur_row_size_ = 0;
     return true;
 }
 
+bool SQLBatchRequestResultSet::GetCommonRow(const int8_t** row, uint32_t* size) {
+    if (row == nullptr || size == nullptr || common_buf_size_ == 0) {
+        return false;
+    }
+    if (common_row_buf_.size() < common_buf_size_) {
+        common_row_buf_.resize(common_buf_size_);
+    }
+    // the row is returned in place if it's in one block, or it's copied into the buffer
+    *row = reinterpret_cast<const int8_t*>(common_buf_.fetch(&common_row_buf_[0], common_buf_size_));
+    *size = common_buf_size_;
+    return *row != nullptr;
+}
+
+bool SQLBatchRequestResultSet::GetNonCommonRow(const int8_t** row, uint32_t* size) {
+    if (row == nullptr || size == nullptr || cur_row_size_ == 0) {
+        return false;
+    }
+    if (cur_row_buf_.size() < cur_row_size_) {
+        cur_row_buf_.resize(cur_row_size_);
+    }
+    *row = reinterpret_cast<const int8_t*>(cur_row_.fetch(&cur_row_buf_[0], cur_row_size_));
+    *size = cur_row_size_;
+    return *row != nullptr;
+}
+
 bool SQLBatchRequestResultSet::IsCommonColumnIdx(size_t index) const {
     return common_column_indices_.find(index) != common_column_indices_.end();
 }
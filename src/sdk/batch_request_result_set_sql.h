@@ -72,11 +72,28 @@ class SQLBatchRequestResultSet : public ::hybridse::sdk::ResultSet {
 
     inline int32_t Size() { return response_->count(); }
 
+    // Raw row access for the callers which decode rows by themselves. The common row is encoded with
+    // GetCommonSchema() and the current row with GetNonCommonSchema(), GetColumnRemap() maps a column of
+    // GetSchema() to its index in one of them.
+    inline const ::hybridse::codec::Schema& GetCommonSchema() const { return common_schema_; }
+    inline const ::hybridse::codec::Schema& GetNonCommonSchema() const { return non_common_schema_; }
+    inline size_t GetColumnRemap(size_t index) const { return column_remap_[index]; }
+    bool IsCommonColumnIdx(size_t index) const;
+
+    // the common row and the current row in the response attachment, returns false if there is no such row. A row
+    // is not copied unless it's split in the attachment. The common row is valid as long as the result set and the
+    // current row until the next call of Next() or Reset()
+    bool GetCommonRow(const int8_t** row, uint32_t* size);
+    bool GetNonCommonRow(const int8_t** row, uint32_t* size);
+
+    // the tablet response and its rows attachment, the common row(if any) followed by the non-common rows
+    inline const ::openmldb::api::SQLBatchRequestQueryResponse& GetResponse() const { return *response_; }
+    inline const butil::IOBuf& GetRowsBuffer() const { return cntl_->response_attachment(); }
+
  private:
     inline uint32_t GetRecordSize() { return response_->count(); }
 
  private:
-    bool IsCommonColumnIdx(size_t index) const;
     bool IsValidColumnIdx(size_t index) const;
     size_t GetCommonColumnNum() const;
 
@@ -84,6 +101,12 @@ class SQLBatchRequestResultSet : public ::hybridse::sdk::ResultSet {
     int32_t index_;
     uint32_t byte_size_;
     uint32_t position_;
+    // the current non-common row in the response attachment
+    butil::IOBuf cur_row_;
+    uint32_t cur_row_size_;
+    // the copies of the rows which are not contiguous in the attachment
+    std::string common_row_buf_;
+    std::string cur_row_buf_;
 
     std::set<size_t> common_column_indices_;
     std::vector<size_t> column_remap_;
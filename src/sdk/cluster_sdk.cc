@@ -85,6 +85,10 @@ bool ClusterSDK::Init() {
     LOG(INFO) << "init zk client with zk cluster " << options_.zk_cluster << " , zk path " << options_.zk_path
               << ",session timeout " << options_.session_timeout << " and session id " << zk_client_->GetSessionTerm();
 
+    std::string change_log_path = options_.zk_path + "/table/notify_log";
+    table_node_cache_.reset(new ::openmldb::zk::ZkNodeCache(zk_client_, table_root_path_, change_log_path));
+    sp_node_cache_.reset(new ::openmldb::zk::ZkNodeCache(zk_client_, sp_root_path_, change_log_path));
+
     ::hybridse::vm::EngineOptions eopt;
     eopt.set_compile_only(true);
     eopt.set_plan_only(true);
@@ -137,55 +141,59 @@ bool ClusterSDK::CreateNsClient() {
     }
 }
 
-bool ClusterSDK::RefreshCatalog(const std::vector<std::string>& table_datas, const std::vector<std::string>& sp_datas) {
-    std::vector<::openmldb::nameserver::TableInfo> tables;
-    std::map<std::string, std::map<std::string, std::shared_ptr<::openmldb::nameserver::TableInfo>>> mapping;
-    auto new_catalog = std::make_shared<::openmldb::catalog::SDKCatalog>(client_manager_);
-    for (uint32_t i = 0; i < table_datas.size(); i++) {
-        if (table_datas[i].empty()) continue;
-        std::string value;
-        bool ok = zk_client_->GetNodeValue(table_root_path_ + "/" + table_datas[i], value);
-        if (!ok) {
-            LOG(WARNING) << "fail to get table data";
-            continue;
-        }
+bool ClusterSDK::RefreshCatalog(const std::map<std::string, std::string>& changed_tables,
+                                const std::vector<std::string>& deleted_tables,
+                                const std::map<std::string, std::string>& changed_sps,
+                                const std::vector<std::string>& deleted_sps, bool tablet_changed) {
+    if (changed_tables.empty() && deleted_tables.empty() && changed_sps.empty() && deleted_sps.empty() &&
+        !tablet_changed) {
+        DLOG(INFO) << "catalog is not changed";
+        return true;
+    }
+    for (const auto& node : deleted_tables) {
+        table_infos_.erase(node);
+        table_handlers_.erase(node);
+    }
+    for (const auto& kv : changed_tables) {
+        table_infos_.erase(kv.first);
+        table_handlers_.erase(kv.first);
         std::shared_ptr<::openmldb::nameserver::TableInfo> table_info(new ::openmldb::nameserver::TableInfo());
-        ok = table_info->ParseFromString(value);
-        if (!ok) {
-            LOG(WARNING) << "fail to parse table proto with " << value;
+        if (!table_info->ParseFromString(kv.second)) {
+            LOG(WARNING) << "fail to parse table proto with " << kv.second;
             continue;
         }
         DLOG(INFO) << "parse table " << table_info->name() << " ok";
         if (table_info->format_version() != 1) {
             continue;
         }
-        tables.push_back(*(table_info.get()));
-        auto it = mapping.find(table_info->db());
-        if (it == mapping.end()) {
-            std::map<std::string, std::shared_ptr<::openmldb::nameserver::TableInfo>> table_in_db;
-            table_in_db.insert(std::make_pair(table_info->name(), table_info));
-            mapping.insert(std::make_pair(table_info->db(), table_in_db));
-        } else {
-            it->second.insert(std::make_pair(table_info->name(), table_info));
-        }
-        DLOG(INFO) << "load table info with name " << table_info->name() << " in db " << table_info->db();
+        table_infos_.emplace(kv.first, table_info);
     }
-
-    Procedures db_sp_map;
-    for (const auto& node : sp_datas) {
-        if (node.empty()) continue;
-        std::string value;
-        bool ok = zk_client_->GetNodeValue(sp_root_path_ + "/" + node, value);
-        if (!ok) {
-            LOG(WARNING) << "fail to get procedure data. node: " << node;
+    // the tablet accessors are bound when the handler is created, so rebuild all of them if tablets changed
+    for (const auto& kv : table_infos_) {
+        if (!tablet_changed && table_handlers_.find(kv.first) != table_handlers_.end()) {
+            continue;
+        }
+        auto handler = std::make_shared<::openmldb::catalog::SDKTableHandler>(*(kv.second), *client_manager_);
+        if (!handler->Init()) {
+            LOG(WARNING) << "fail to init table " << kv.second->name();
+            table_handlers_.erase(kv.first);
+            table_node_cache_->Invalidate(kv.first);
             continue;
         }
+        table_handlers_[kv.first] = handler;
+        DLOG(INFO) << "load table info with name " << kv.second->name() << " in db " << kv.second->db();
+    }
+
+    for (const auto& node : deleted_sps) {
+        sp_infos_.erase(node);
+    }
+    for (const auto& kv : changed_sps) {
+        sp_infos_.erase(kv.first);
         std::string uncompressed;
-        ::snappy::Uncompress(value.c_str(), value.length(), &uncompressed);
+        ::snappy::Uncompress(kv.second.c_str(), kv.second.length(), &uncompressed);
         ::openmldb::api::ProcedureInfo sp_info_pb;
-        ok = sp_info_pb.ParseFromString(uncompressed);
-        if (!ok) {
-            LOG(WARNING) << "fail to parse procedure proto. node: " << node << " value: " << value;
+        if (!sp_info_pb.ParseFromString(uncompressed)) {
+            LOG(WARNING) << "fail to parse procedure proto. node: " << kv.first << " value: " << kv.second;
             continue;
         }
         DLOG(INFO) << "parse procedure " << sp_info_pb.sp_name() << " ok";
@@ -196,17 +204,23 @@ bool ClusterSDK::RefreshCatalog(const std::vector<std::string>& table_datas, con
                          << " db: " << sp_info_pb.db_name();
             continue;
         }
-        auto it = db_sp_map.find(sp_info->GetDbName());
-        if (it == db_sp_map.end()) {
-            std::map<std::string, std::shared_ptr<hybridse::sdk::ProcedureInfo>> sp_in_db = {
-                {sp_info->GetSpName(), sp_info}};
-            db_sp_map.insert(std::make_pair(sp_info->GetDbName(), sp_in_db));
-        } else {
-            it->second.insert(std::make_pair(sp_info->GetSpName(), sp_info));
-        }
+        sp_infos_.emplace(kv.first, sp_info);
         DLOG(INFO) << "load procedure info with sp name " << sp_info->GetSpName() << " in db " << sp_info->GetDbName();
     }
-    if (!new_catalog->Init(tables, db_sp_map)) {
+
+    std::map<std::string, std::map<std::string, std::shared_ptr<::openmldb::nameserver::TableInfo>>> mapping;
+    std::vector<std::shared_ptr<::openmldb::catalog::SDKTableHandler>> handlers;
+    for (const auto& kv : table_handlers_) {
+        const auto& table_info = table_infos_[kv.first];
+        mapping[table_info->db()].emplace(table_info->name(), table_info);
+        handlers.push_back(kv.second);
+    }
+    Procedures db_sp_map;
+    for (const auto& kv : sp_infos_) {
+        db_sp_map[kv.second->GetDbName()].emplace(kv.second->GetSpName(), kv.second);
+    }
+    auto new_catalog = std::make_shared<::openmldb::catalog::SDKCatalog>(client_manager_);
+    if (!new_catalog->Init(handlers, db_sp_map)) {
         LOG(WARNING) << "fail to init catalog";
         return false;
     }
@@ -216,10 +230,13 @@ bool ClusterSDK::RefreshCatalog(const std::vector<std::string>& table_datas, con
         catalog_ = new_catalog;
     }
     engine_->UpdateCatalog(new_catalog);
+    LOG(INFO) << "refresh catalog. changed tables " << changed_tables.size() << ", deleted tables "
+              << deleted_tables.size() << ", changed procedures " << changed_sps.size() << ", deleted procedures "
+              << deleted_sps.size();
     return true;
 }
 
-bool ClusterSDK::InitTabletClient() {
+bool ClusterSDK::InitTabletClient(bool* tablet_changed) {
     std::vector<std::string> tablets;
     bool ok = zk_client_->GetNodes(tablets);
     if (!ok) {
@@ -235,33 +252,30 @@ bool ClusterSDK::InitTabletClient() {
         real_ep_map.emplace(endpoint, real_endpoint);
     }
     client_manager_->UpdateClient(real_ep_map);
+    *tablet_changed = real_ep_map != real_ep_map_;
+    real_ep_map_.swap(real_ep_map);
     return true;
 }
 
 bool ClusterSDK::InitCatalog() {
-    std::vector<std::string> table_datas;
-    if (zk_client_->IsExistNode(table_root_path_) == 0) {
-        bool ok = zk_client_->GetChildren(table_root_path_, table_datas);
-        if (!ok) {
-            LOG(WARNING) << "fail to get table list with path " << table_root_path_;
-            return false;
-        }
-    } else {
-        LOG(INFO) << "no tables in db";
+    std::lock_guard<std::mutex> lock(refresh_mu_);
+    bool tablet_changed = false;
+    bool ok = InitTabletClient(&tablet_changed);
+    if (!ok) return false;
+    // only the table and procedure nodes modified since last refresh are fetched
+    std::map<std::string, std::string> changed_tables;
+    std::vector<std::string> deleted_tables;
+    if (!table_node_cache_->Refresh(&changed_tables, &deleted_tables)) {
+        LOG(WARNING) << "fail to get table list with path " << table_root_path_;
+        return false;
     }
-    std::vector<std::string> sp_datas;
-    if (zk_client_->IsExistNode(sp_root_path_) == 0) {
-        bool ok = zk_client_->GetChildren(sp_root_path_, sp_datas);
-        if (!ok) {
-            LOG(WARNING) << "fail to get procedure list with path " << sp_root_path_;
-            return false;
-        }
-    } else {
-        DLOG(INFO) << "no procedures in db";
+    std::map<std::string, std::string> changed_sps;
+    std::vector<std::string> deleted_sps;
+    if (!sp_node_cache_->Refresh(&changed_sps, &deleted_sps)) {
+        LOG(WARNING) << "fail to get procedure list with path " << sp_root_path_;
+        return false;
     }
-    bool ok = InitTabletClient();
-    if (!ok) return false;
-    return RefreshCatalog(table_datas, sp_datas);
+    return RefreshCatalog(changed_tables, deleted_tables, changed_sps, deleted_sps, tablet_changed);
 }
 
 uint32_t ClusterSDK::GetTableId(const std::string& db, const std::string& tname) {
@@ -19,6 +19,7 @@
 
 #include <map>
 #include <memory>
+#include <mutex>  // NOLINT
 #include <string>
 #include <vector>
 
@@ -30,6 +31,7 @@
 #include "vm/catalog.h"
 #include "vm/engine.h"
 #include "zk/zk_client.h"
+#include "zk/zk_node_cache.h"
 
 namespace openmldb {
 namespace sdk {
@@ -89,8 +91,12 @@ class ClusterSDK {
 
  private:
     bool InitCatalog();
-    bool RefreshCatalog(const std::vector<std::string>& table_datas, const std::vector<std::string>& sp_datas);
-    bool InitTabletClient();
+    // patch the cached tables and procedures with the changed zk nodes and swap in a new catalog
+    bool RefreshCatalog(const std::map<std::string, std::string>& changed_tables,
+                        const std::vector<std::string>& deleted_tables,
+                        const std::map<std::string, std::string>& changed_sps,
+                        const std::vector<std::string>& deleted_sps, bool tablet_changed);
+    bool InitTabletClient(bool* tablet_changed);
     bool CreateNsClient();
     void WatchNotify();
     void CheckZk();
@@ -112,6 +118,15 @@ class ClusterSDK {
     ::openmldb::base::Random rand_;
     std::string sp_root_path_;
     ::hybridse::vm::Engine* engine_;
+    // serialize the refresh of catalog
+    std::mutex refresh_mu_;
+    std::unique_ptr<::openmldb::zk::ZkNodeCache> table_node_cache_;
+    std::unique_ptr<::openmldb::zk::ZkNodeCache> sp_node_cache_;
+    // zk node name -> the parsed table and procedure of the current catalog
+    std::map<std::string, std::shared_ptr<::openmldb::nameserver::TableInfo>> table_infos_;
+    std::map<std::string, std::shared_ptr<::openmldb::catalog::SDKTableHandler>> table_handlers_;
+    std::map<std::string, std::shared_ptr<hybridse::sdk::ProcedureInfo>> sp_infos_;
+    std::map<std::string, std::string> real_ep_map_;
 };
 
 }  // namespace sdk
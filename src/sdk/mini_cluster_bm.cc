@@ -352,6 +352,10 @@ void BM_BatchRequestQuery(benchmark::State& state, hybridse::sqlcase::SqlCase& s
                     benchmark::DoNotOptimize(router->ExecuteSQLBatchRequest(sql_case.db(), sql, row_batch, &status));
                 }
             }
+            // items_per_second is the rows served per second, so the cost per row can be compared between the
+            // batch sizes
+            state.counters["batch_size"] = row_batch->Size();
+            state.SetItemsProcessed(state.iterations() * row_batch->Size());
         }
     }
     openmldb::sdk::SQLSDKTest::DropProcedure(sql_case, router);
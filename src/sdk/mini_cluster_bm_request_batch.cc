@@ -46,10 +46,35 @@ DECLARE_bool(enable_localtablet);
         ->Args({1, 10, 100})                                                   \
         ->Args({0, 1000, 100})                                                 \
         ->Args({1, 1000, 100});
+// the cost per row against the batch size with the window scale fixed
+#define DEFINE_BATCH_REQUEST_SCALE_CASE(NAME, PATH, CASE_ID)                   \
+    static void BM_BatchRequestScale_##NAME(benchmark::State& state) {         \
+        auto sql_case = LoadSQLCaseWithID(PATH, CASE_ID);                      \
+        sql_case.batch_request_optimized_ = state.range(0) == 1;               \
+        if (!hybridse::sqlcase::SqlCase::IsDebug()) {                          \
+            sql_case.SqlCaseRepeatConfig("window_scale", state.range(1));      \
+            sql_case.SqlCaseRepeatConfig("batch_scale", state.range(2));       \
+        }                                                                      \
+                                                                               \
+        MiniBenchmarkOnCase(sql_case, kBatchRequestMode, mc, &state);          \
+    }                                                                          \
+    BENCHMARK(BM_BatchRequestScale_##NAME)                                     \
+        ->Unit(benchmark::kMicrosecond)                                        \
+        ->ArgNames({"batch_request_optimized", "window_scale", "batch_scale"}) \
+        ->Args({0, 100, 1})                                                    \
+        ->Args({1, 100, 1})                                                    \
+        ->Args({0, 100, 10})                                                   \
+        ->Args({1, 100, 10})                                                   \
+        ->Args({0, 100, 100})                                                  \
+        ->Args({1, 100, 100})                                                  \
+        ->Args({0, 100, 1000})                                                 \
+        ->Args({1, 100, 1000});
 const char* DEFAULT_YAML_PATH = "/cases/benchmark/batch_request_benchmark.yaml";
 
 DEFINE_BATCH_REQUEST_CASE(TwoWindow, DEFAULT_YAML_PATH, "0");
 DEFINE_BATCH_REQUEST_CASE(CommonWindow, DEFAULT_YAML_PATH, "1");
+DEFINE_BATCH_REQUEST_SCALE_CASE(CommonWindow, DEFAULT_YAML_PATH, "1");
+DEFINE_BATCH_REQUEST_SCALE_CASE(CommonJoin, DEFAULT_YAML_PATH, "4");
 
 int main(int argc, char** argv) {
     ::hybridse::vm::Engine::InitializeGlobalLLVM();
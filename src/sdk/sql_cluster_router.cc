@@ -247,7 +247,7 @@ std::shared_ptr<SQLInsertRow> SQLClusterRouter::GetInsertRow(const std::string&
     if (cache) {
         status->code = 0;
         return std::make_shared<SQLInsertRow>(cache->table_info, cache->column_schema, cache->default_map,
-                                              cache->str_length);
+                                              cache->str_length, cache->row_layout);
     }
     std::shared_ptr<::openmldb::nameserver::TableInfo> table_info;
     DefaultValueMap default_map;
@@ -259,7 +259,8 @@ std::shared_ptr<SQLInsertRow> SQLClusterRouter::GetInsertRow(const std::string&
     }
     cache = std::make_shared<SQLCache>(table_info, default_map, str_length);
     SetCache(db, sql, cache);
-    return std::make_shared<SQLInsertRow>(table_info, cache->column_schema, default_map, str_length);
+    return std::make_shared<SQLInsertRow>(table_info, cache->column_schema, default_map, str_length,
+                                          cache->row_layout);
 }
 
 bool SQLClusterRouter::GetInsertInfo(const std::string& db, const std::string& sql, ::hybridse::sdk::Status* status,
@@ -509,7 +510,7 @@ std::shared_ptr<SQLInsertRows> SQLClusterRouter::GetInsertRows(const std::string
     if (cache) {
         status->code = 0;
         return std::make_shared<SQLInsertRows>(cache->table_info, cache->column_schema, cache->default_map,
-                                               cache->str_length);
+                                               cache->str_length, cache->row_layout);
     }
     std::shared_ptr<::openmldb::nameserver::TableInfo> table_info;
     DefaultValueMap default_map;
@@ -519,7 +520,8 @@ std::shared_ptr<SQLInsertRows> SQLClusterRouter::GetInsertRows(const std::string
     }
     cache = std::make_shared<SQLCache>(table_info, default_map, str_length);
     SetCache(db, sql, cache);
-    return std::make_shared<SQLInsertRows>(table_info, cache->column_schema, default_map, str_length);
+    return std::make_shared<SQLInsertRows>(table_info, cache->column_schema, default_map, str_length,
+                                           cache->row_layout);
 }
 
 bool SQLClusterRouter::ExecuteDDL(const std::string& db, const std::string& sql, hybridse::sdk::Status* status) {
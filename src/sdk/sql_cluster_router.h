@@ -55,6 +55,7 @@ struct SQLCache {
              uint32_t str_length)
         : table_info(table_info), default_map(default_map), column_schema(), str_length(str_length) {
         column_schema = openmldb::sdk::ConvertToSchema(table_info);
+        row_layout = std::make_shared<::openmldb::codec::RowLayout>(table_info->column_desc());
     }
     SQLCache(std::shared_ptr<::hybridse::sdk::Schema> column_schema,
              const ::hybridse::vm::Router& input_router)
@@ -96,6 +97,8 @@ struct SQLCache {
     std::shared_ptr<::hybridse::sdk::Schema> parameter_schema;
     uint32_t str_length;
     ::hybridse::vm::Router router;
+    // the layout of the insert rows, it's null for a query cache
+    std::shared_ptr<::openmldb::codec::RowLayout> row_layout;
 };
 
 class SQLClusterRouter : public SQLRouter {
@@ -28,14 +28,24 @@ namespace sdk {
 SQLInsertRows::SQLInsertRows(std::shared_ptr<::openmldb::nameserver::TableInfo> table_info,
                              std::shared_ptr<hybridse::sdk::Schema> schema, DefaultValueMap default_map,
                              uint32_t default_str_length)
-    : table_info_(table_info), schema_(schema), default_map_(default_map), default_str_length_(default_str_length) {}
+    : SQLInsertRows(table_info, schema, default_map, default_str_length,
+                    std::make_shared<::openmldb::codec::RowLayout>(table_info->column_desc())) {}
+
+SQLInsertRows::SQLInsertRows(std::shared_ptr<::openmldb::nameserver::TableInfo> table_info,
+                             std::shared_ptr<hybridse::sdk::Schema> schema, DefaultValueMap default_map,
+                             uint32_t default_str_length, std::shared_ptr<::openmldb::codec::RowLayout> layout)
+    : table_info_(table_info),
+      schema_(schema),
+      default_map_(default_map),
+      default_str_length_(default_str_length),
+      layout_(layout) {}
 
 std::shared_ptr<SQLInsertRow> SQLInsertRows::NewRow() {
     if (!rows_.empty() && !rows_.back()->IsComplete()) {
         return std::shared_ptr<SQLInsertRow>();
     }
     std::shared_ptr<SQLInsertRow> row =
-        std::make_shared<SQLInsertRow>(table_info_, schema_, default_map_, default_str_length_);
+        std::make_shared<SQLInsertRow>(table_info_, schema_, default_map_, default_str_length_, layout_);
     rows_.push_back(row);
     return row;
 }
@@ -43,13 +53,22 @@ std::shared_ptr<SQLInsertRow> SQLInsertRows::NewRow() {
 SQLInsertRow::SQLInsertRow(std::shared_ptr<::openmldb::nameserver::TableInfo> table_info,
                            std::shared_ptr<hybridse::sdk::Schema> schema, DefaultValueMap default_map,
                            uint32_t default_string_length)
+    : SQLInsertRow(table_info, schema, default_map, default_string_length,
+                   std::make_shared<::openmldb::codec::RowLayout>(table_info->column_desc())) {}
+
+SQLInsertRow::SQLInsertRow(std::shared_ptr<::openmldb::nameserver::TableInfo> table_info,
+                           std::shared_ptr<hybridse::sdk::Schema> schema, DefaultValueMap default_map,
+                           uint32_t default_string_length, std::shared_ptr<::openmldb::codec::RowLayout> layout)
     : table_info_(table_info),
       schema_(schema),
       default_map_(default_map),
       default_string_length_(default_string_length),
-      rb_(table_info->column_desc()),
+      layout_(layout),
       val_(),
-      str_size_(0) {
+      str_size_(0),
+      cnt_(0),
+      addr_length_(0),
+      str_offset_(0) {
     std::map<std::string, uint32_t> column_name_map;
     for (int idx = 0; idx < table_info_->column_desc_size(); idx++) {
         column_name_map.emplace(table_info_->column_desc(idx).name(), idx);
@@ -70,22 +89,32 @@ SQLInsertRow::SQLInsertRow(std::shared_ptr<::openmldb::nameserver::TableInfo> ta
 }
 
 bool SQLInsertRow::Init(int str_length) {
-    str_size_ = str_length + default_string_length_;
-    uint32_t row_size = rb_.CalTotalLength(str_size_);
-    val_.resize(row_size);
-    int8_t* buf = reinterpret_cast<int8_t*>(&(val_[0]));
-    bool ok = rb_.SetBuffer(reinterpret_cast<int8_t*>(buf), row_size);
-    if (!ok) {
+    if (!layout_->IsValid() || layout_->GetFieldCnt() == 0) {
         return false;
     }
+    str_size_ = str_length + default_string_length_;
+    uint32_t row_size = layout_->CalTotalLength(str_size_, &addr_length_);
+    val_.resize(row_size);
+    str_offset_ = layout_->InitRow(GetBuf(), row_size, addr_length_);
+    cnt_ = 0;
     MakeDefault();
     return true;
 }
 
-void SQLInsertRow::PackDimension(const std::string& val) { raw_dimensions_[rb_.GetAppendPos()] = val; }
+template <typename T>
+bool SQLInsertRow::AppendField(::openmldb::type::DataType type, T val) {
+    if (!Check(type)) {
+        return false;
+    }
+    layout_->SetField<T>(GetBuf(), cnt_, val);
+    cnt_++;
+    return MakeDefault();
+}
+
+void SQLInsertRow::PackDimension(const std::string& val) { raw_dimensions_[cnt_] = val; }
 
 bool SQLInsertRow::PackTs(uint64_t ts) {
-    if (ts_set_.count(rb_.GetAppendPos())) {
+    if (ts_set_.count(cnt_)) {
         ts_.push_back(ts);
         return true;
     }
@@ -120,12 +149,12 @@ const std::map<uint32_t, std::vector<std::pair<std::string, uint32_t>>>& SQLInse
 }
 
 bool SQLInsertRow::MakeDefault() {
-    auto it = default_map_->find(rb_.GetAppendPos());
+    auto it = default_map_->find(cnt_);
     if (it != default_map_->end()) {
         if (it->second->IsNull()) {
             return AppendNULL();
         }
-        switch (table_info_->column_desc(rb_.GetAppendPos()).data_type()) {
+        switch (table_info_->column_desc(cnt_).data_type()) {
             case openmldb::type::kBool:
                 return AppendBool(it->second->GetInt());
             case openmldb::type::kSmallInt:
@@ -156,30 +185,21 @@ bool SQLInsertRow::AppendBool(bool val) {
     if (IsDimension()) {
         PackDimension(val ? "true" : "false");
     }
-    if (rb_.AppendBool(val)) {
-        return MakeDefault();
-    }
-    return false;
+    return AppendField<bool>(::openmldb::type::kBool, val);
 }
 
 bool SQLInsertRow::AppendInt16(int16_t val) {
     if (IsDimension()) {
         PackDimension(std::to_string(val));
     }
-    if (rb_.AppendInt16(val)) {
-        return MakeDefault();
-    }
-    return false;
+    return AppendField<int16_t>(::openmldb::type::kSmallInt, val);
 }
 
 bool SQLInsertRow::AppendInt32(int32_t val) {
     if (IsDimension()) {
         PackDimension(std::to_string(val));
     }
-    if (rb_.AppendInt32(val)) {
-        return MakeDefault();
-    }
-    return false;
+    return AppendField<int32_t>(::openmldb::type::kInt, val);
 }
 
 bool SQLInsertRow::AppendInt64(int64_t val) {
@@ -187,10 +207,7 @@ bool SQLInsertRow::AppendInt64(int64_t val) {
         PackDimension(std::to_string(val));
     }
     PackTs(val);
-    if (rb_.AppendInt64(val)) {
-        return MakeDefault();
-    }
-    return false;
+    return AppendField<int64_t>(::openmldb::type::kBigInt, val);
 }
 
 bool SQLInsertRow::AppendTimestamp(int64_t val) {
@@ -198,39 +215,19 @@ bool SQLInsertRow::AppendTimestamp(int64_t val) {
         PackDimension(std::to_string(val));
     }
     PackTs(val);
-    if (rb_.AppendTimestamp(val)) {
-        return MakeDefault();
-    }
-    return false;
+    return AppendField<int64_t>(::openmldb::type::kTimestamp, val);
 }
 
 bool SQLInsertRow::AppendFloat(float val) {
-    if (rb_.AppendFloat(val)) {
-        return MakeDefault();
-    }
-    return false;
+    return AppendField<float>(::openmldb::type::kFloat, val);
 }
 
 bool SQLInsertRow::AppendDouble(double val) {
-    if (rb_.AppendDouble(val)) {
-        return MakeDefault();
-    }
-    return false;
+    return AppendField<double>(::openmldb::type::kDouble, val);
 }
 
 bool SQLInsertRow::AppendString(const std::string& val) {
-    if (IsDimension()) {
-        if (val.empty()) {
-            PackDimension(hybridse::codec::EMPTY_STRING);
-        } else {
-            PackDimension(val);
-        }
-    }
-    str_size_ -= val.size();
-    if (rb_.AppendString(val.c_str(), val.size())) {
-        return MakeDefault();
-    }
-    return false;
+    return AppendString(val.c_str(), val.size());
 }
 
 bool SQLInsertRow::AppendString(const char* string_buffer_var_name, uint32_t length) {
@@ -242,10 +239,14 @@ bool SQLInsertRow::AppendString(const char* string_buffer_var_name, uint32_t len
         }
     }
     str_size_ -= length;
-    if (rb_.AppendString(string_buffer_var_name, length)) {
-        return MakeDefault();
+    if (string_buffer_var_name == NULL ||
+        (!Check(::openmldb::type::kVarchar) && !Check(::openmldb::type::kString)) ||
+        str_offset_ + length > val_.size()) {
+        return false;
     }
-    return false;
+    layout_->SetString(GetBuf(), cnt_, addr_length_, string_buffer_var_name, length, &str_offset_);
+    cnt_++;
+    return MakeDefault();
 }
 
 bool SQLInsertRow::AppendDate(uint32_t year, uint32_t month, uint32_t day) {
@@ -258,36 +259,41 @@ bool SQLInsertRow::AppendDate(uint32_t year, uint32_t month, uint32_t day) {
         date = date | day;
         PackDimension(std::to_string(date));
     }
-    if (rb_.AppendDate(year, month, day)) {
-        return MakeDefault();
-    }
-    return false;
+    if (year < 1900 || year > 9999) return false;
+    if (month < 1 || month > 12) return false;
+    if (day < 1 || day > 31) return false;
+    int32_t date = (year - 1900) << 16;
+    date = date | ((month - 1) << 8);
+    date = date | day;
+    return AppendField<int32_t>(::openmldb::type::kDate, date);
 }
 
 bool SQLInsertRow::AppendDate(int32_t date) {
     if (IsDimension()) {
         PackDimension(std::to_string(date));
     }
-    if (rb_.AppendDate(date)) {
-        return MakeDefault();
-    }
-    return false;
+    return AppendField<int32_t>(::openmldb::type::kDate, date);
 }
 
 bool SQLInsertRow::AppendNULL() {
     if (IsDimension()) {
         PackDimension(hybridse::codec::NONETOKEN);
     }
-    if (ts_set_.count(rb_.GetAppendPos())) {
+    if (ts_set_.count(cnt_)) {
         return false;
     }
-    if (rb_.AppendNULL()) {
-        return MakeDefault();
+    if (val_.empty() || cnt_ >= layout_->GetFieldCnt() || table_info_->column_desc(cnt_).not_null()) {
+        return false;
     }
-    return false;
+    // the fields are null after InitRow, a null string sets its address only
+    if (layout_->IsString(cnt_)) {
+        layout_->SetNULLString(GetBuf(), cnt_, addr_length_, str_offset_);
+    }
+    cnt_++;
+    return MakeDefault();
 }
 
-bool SQLInsertRow::IsComplete() { return rb_.IsComplete(); }
+bool SQLInsertRow::IsComplete() { return !val_.empty() && cnt_ == layout_->GetFieldCnt(); }
 
 bool SQLInsertRow::Build() { return str_size_ == 0; }
 
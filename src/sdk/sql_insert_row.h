@@ -27,6 +27,7 @@
 #include "base/hash.h"
 #include "codec/codec.h"
 #include "codec/fe_row_codec.h"
+#include "codec/row_layout.h"
 #include "node/sql_node.h"
 #include "proto/name_server.pb.h"
 #include "sdk/base.h"
@@ -65,6 +66,10 @@ class SQLInsertRow {
     explicit SQLInsertRow(std::shared_ptr<::openmldb::nameserver::TableInfo> table_info,
                           std::shared_ptr<hybridse::sdk::Schema> schema, DefaultValueMap default_map,
                           uint32_t default_str_length);
+    // the rows of a table share the layout which is resolved from its column_desc once
+    SQLInsertRow(std::shared_ptr<::openmldb::nameserver::TableInfo> table_info,
+                 std::shared_ptr<hybridse::sdk::Schema> schema, DefaultValueMap default_map,
+                 uint32_t default_str_length, std::shared_ptr<::openmldb::codec::RowLayout> layout);
     ~SQLInsertRow() = default;
     bool Init(int str_length);
     bool AppendBool(bool val);
@@ -102,7 +107,14 @@ class SQLInsertRow {
     bool MakeDefault();
     bool PackTs(uint64_t ts);
     void PackDimension(const std::string& val);
-    inline bool IsDimension() { return raw_dimensions_.find(rb_.GetAppendPos()) != raw_dimensions_.end(); }
+    inline bool IsDimension() { return raw_dimensions_.find(cnt_) != raw_dimensions_.end(); }
+    inline int8_t* GetBuf() { return reinterpret_cast<int8_t*>(&(val_[0])); }
+    // whether the field to append is of type and the row is initialized
+    inline bool Check(::openmldb::type::DataType type) {
+        return !val_.empty() && cnt_ < layout_->GetFieldCnt() && layout_->GetType(cnt_) == type;
+    }
+    template <typename T>
+    bool AppendField(::openmldb::type::DataType type, T val);
 
  private:
     std::shared_ptr<::openmldb::nameserver::TableInfo> table_info_;
@@ -114,15 +126,22 @@ class SQLInsertRow {
     std::map<uint32_t, std::string> raw_dimensions_;
     std::map<uint32_t, std::vector<std::pair<std::string, uint32_t>>> dimensions_;
     std::vector<uint64_t> ts_;
-    ::openmldb::codec::RowBuilder rb_;
+    std::shared_ptr<::openmldb::codec::RowLayout> layout_;
     std::string val_;
     uint32_t str_size_;
+    // the index of the field to append
+    uint32_t cnt_;
+    uint8_t addr_length_;
+    uint32_t str_offset_;
 };
 
 class SQLInsertRows {
  public:
     SQLInsertRows(std::shared_ptr<::openmldb::nameserver::TableInfo> table_info,
                   std::shared_ptr<hybridse::sdk::Schema> schema, DefaultValueMap default_map, uint32_t str_size);
+    SQLInsertRows(std::shared_ptr<::openmldb::nameserver::TableInfo> table_info,
+                  std::shared_ptr<hybridse::sdk::Schema> schema, DefaultValueMap default_map, uint32_t str_size,
+                  std::shared_ptr<::openmldb::codec::RowLayout> layout);
     ~SQLInsertRows() = default;
     std::shared_ptr<SQLInsertRow> NewRow();
     inline uint32_t GetCnt() { return rows_.size(); }
@@ -138,6 +157,7 @@ class SQLInsertRows {
     std::shared_ptr<hybridse::sdk::Schema> schema_;
     DefaultValueMap default_map_;
     uint32_t default_str_length_;
+    std::shared_ptr<::openmldb::codec::RowLayout> layout_;
     std::vector<std::shared_ptr<SQLInsertRow>> rows_;
 };
 
@@ -20,6 +20,7 @@
 
 #include <string>
 #include <unordered_map>
+#include <utility>
 
 #include "catalog/schema_adapter.h"
 #include "glog/logging.h"
@@ -469,5 +470,43 @@ bool SQLRequestRowBatch::AddRow(std::shared_ptr<SQLRequestRow> row) {
     return true;
 }
 
+// whether row is a complete encoded row, its size is in the header
+static inline bool IsEncodedRow(const std::string& row) {
+    return row.size() > SDK_HEADER_LENGTH &&
+           *(reinterpret_cast<const uint32_t*>(row.data() + SDK_VERSION_LENGTH)) == row.size();
+}
+
+bool SQLRequestRowBatch::AddRow(const std::string& common_row, std::string non_common_row) {
+    if (common_column_indices_.empty()) {
+        if (!IsEncodedRow(non_common_row)) {
+            LOG(WARNING) << "invalid request row";
+            return false;
+        }
+        non_common_slices_.emplace_back(std::move(non_common_row));
+        return true;
+    }
+    if (!IsEncodedRow(common_row)) {
+        LOG(WARNING) << "invalid common row";
+        return false;
+    }
+    // all columns are common, the common row is the whole row
+    if (common_column_indices_.size() == static_cast<size_t>(request_schema_.size())) {
+        non_common_slices_.emplace_back(common_row);
+        return true;
+    }
+    if (!IsEncodedRow(non_common_row)) {
+        LOG(WARNING) << "invalid non-common row";
+        return false;
+    }
+    if (non_common_slices_.empty()) {
+        common_slice_ = common_row;
+    } else if (common_row != common_slice_) {
+        LOG(WARNING) << "the common columns of a batch must be the same";
+        return false;
+    }
+    non_common_slices_.emplace_back(std::move(non_common_row));
+    return true;
+}
+
 }  // namespace sdk
 }  // namespace openmldb
@@ -88,6 +88,10 @@ class SQLRequestRowBatch {
  public:
     SQLRequestRowBatch(std::shared_ptr<hybridse::sdk::Schema> schema, std::shared_ptr<ColumnIndicesSet> indices);
     bool AddRow(std::shared_ptr<SQLRequestRow> row);
+    // add a row which is encoded as the common and non-common columns of the request schema separately, so the
+    // column selection of AddRow is skipped. The common row is kept only once as AddRow does. It returns false if
+    // a row is not complete or the common row differs from the one of the batch.
+    bool AddRow(const std::string& common_row, std::string non_common_row);
     int Size() const { return non_common_slices_.size(); }
 
     const std::set<size_t>& common_column_indices() const { return common_column_indices_; }
@@ -0,0 +1,422 @@
+/*
+ * Copyright 2021 4Paradigm
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "storage/aggregator.h"
+
+#include <snappy.h>
+
+#include <algorithm>
+
+#include "base/glog_wapper.h"
+#include "storage/table.h"
+#include "storage/ticket.h"
+
+namespace openmldb {
+namespace storage {
+
+void AggrBuffer::Merge(const AggrBuffer& other) {
+    cnt += other.cnt;
+    int_sum += other.int_sum;
+    int_min = std::min(int_min, other.int_min);
+    int_max = std::max(int_max, other.int_max);
+    double_sum += other.double_sum;
+    double_min = std::min(double_min, other.double_min);
+    double_max = std::max(double_max, other.double_max);
+}
+
+Aggregator::Aggregator(Table* table, const ::openmldb::api::AggregatorInfo& info)
+    : table_(table),
+      info_(info),
+      type_(AggrType::kCount),
+      index_id_(0),
+      ts_idx_(-1),
+      aggr_col_(-1),
+      aggr_col_type_(::openmldb::type::kBigInt),
+      filter_col_(-1),
+      bucket_size_(info.bucket_size()),
+      compressed_(table->GetCompressType() == ::openmldb::type::kSnappy),
+      shards_(),
+      decoder_mu_(),
+      decoders_(std::make_shared<std::map<uint8_t, Decoder>>()) {}
+
+bool Aggregator::ParseAggrFunc(const std::string& func, AggrType* type, bool* has_filter) {
+    static const std::string where_suffix = "_where";
+    std::string name = func;
+    *has_filter = false;
+    if (name.size() > where_suffix.size() &&
+        name.compare(name.size() - where_suffix.size(), where_suffix.size(), where_suffix) == 0) {
+        name.resize(name.size() - where_suffix.size());
+        *has_filter = true;
+    }
+    if (name == "sum") {
+        *type = AggrType::kSum;
+    } else if (name == "min") {
+        *type = AggrType::kMin;
+    } else if (name == "max") {
+        *type = AggrType::kMax;
+    } else if (name == "count") {
+        *type = AggrType::kCount;
+    } else if (name == "avg") {
+        *type = AggrType::kAvg;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool Aggregator::Init(std::string* msg) {
+    bool has_filter = false;
+    if (!ParseAggrFunc(info_.aggr_func(), &type_, &has_filter)) {
+        msg->assign("unsupported aggr func " + info_.aggr_func());
+        return false;
+    }
+    if (bucket_size_ == 0) {
+        msg->assign("bucket size should be greater than zero");
+        return false;
+    }
+    std::shared_ptr<IndexDef> index_def = table_->GetIndex(info_.index_name());
+    if (!index_def || !index_def->IsReady()) {
+        msg->assign("index " + info_.index_name() + " is not found");
+        return false;
+    }
+    auto ttl_type = index_def->GetTTLType();
+    if (ttl_type != TTLType::kAbsoluteTime && ttl_type != TTLType::kAbsAndLat) {
+        msg->assign("the rows of index " + info_.index_name() + " may be deleted by the latest ttl");
+        return false;
+    }
+    index_id_ = index_def->GetId();
+    auto ts_col = index_def->GetTsColumn();
+    ts_idx_ = ts_col ? ts_col->GetTsIdx() : -1;
+
+    auto table_meta = table_->GetTableMeta();
+    auto find_column = [&table_meta](const std::string& name) {
+        for (int32_t i = 0; i < table_meta->column_desc_size(); i++) {
+            if (table_meta->column_desc(i).name() == name) {
+                return i;
+            }
+        }
+        return -1;
+    };
+    if (info_.aggr_col().empty() || info_.aggr_col() == "*") {
+        if (type_ != AggrType::kCount) {
+            msg->assign("aggr column is required by " + info_.aggr_func());
+            return false;
+        }
+    } else {
+        aggr_col_ = find_column(info_.aggr_col());
+        if (aggr_col_ < 0) {
+            msg->assign("aggr column " + info_.aggr_col() + " is not found");
+            return false;
+        }
+        aggr_col_type_ = table_meta->column_desc(aggr_col_).data_type();
+        switch (aggr_col_type_) {
+            case ::openmldb::type::kSmallInt:
+            case ::openmldb::type::kInt:
+            case ::openmldb::type::kBigInt:
+            case ::openmldb::type::kTimestamp:
+            case ::openmldb::type::kFloat:
+            case ::openmldb::type::kDouble:
+                break;
+            default:
+                if (type_ != AggrType::kCount) {
+                    msg->assign("the type of aggr column " + info_.aggr_col() + " is not supported");
+                    return false;
+                }
+        }
+    }
+    if (has_filter) {
+        filter_col_ = find_column(info_.filter_col());
+        if (filter_col_ < 0 || table_meta->column_desc(filter_col_).data_type() != ::openmldb::type::kBool) {
+            msg->assign("filter column " + info_.filter_col() + " is not a bool column");
+            return false;
+        }
+    }
+    return true;
+}
+
+::openmldb::codec::RowView* Aggregator::GetRowView(uint8_t version) {
+    auto decoders = std::atomic_load_explicit(&decoders_, std::memory_order_acquire);
+    auto it = decoders->find(version);
+    if (it != decoders->end()) {
+        return it->second.view.get();
+    }
+    std::lock_guard<std::mutex> lock(decoder_mu_);
+    decoders = std::atomic_load_explicit(&decoders_, std::memory_order_acquire);
+    it = decoders->find(version);
+    if (it != decoders->end()) {
+        return it->second.view.get();
+    }
+    auto schema = table_->GetVersionSchema(version);
+    if (!schema) {
+        return nullptr;
+    }
+    // the row views are never removed, so the returned pointer is valid while the aggregator lives
+    auto new_decoders = std::make_shared<std::map<uint8_t, Decoder>>(*decoders);
+    Decoder& decoder = (*new_decoders)[version];
+    decoder.schema = schema;
+    decoder.view = std::make_shared<::openmldb::codec::RowView>(*schema);
+    std::atomic_store_explicit(&decoders_, new_decoders, std::memory_order_release);
+    return decoder.view.get();
+}
+
+bool Aggregator::AggregateRow(const ::openmldb::base::Slice& value, std::string* buf, AggrBuffer* buffer) {
+    const int8_t* row = reinterpret_cast<const int8_t*>(value.data());
+    if (compressed_) {
+        buf->clear();
+        if (!::snappy::Uncompress(value.data(), value.size(), buf)) {
+            return false;
+        }
+        row = reinterpret_cast<const int8_t*>(buf->data());
+    }
+    // the offsets of the columns are independent of the row, the row view is shared by the readers
+    ::openmldb::codec::RowView* view = GetRowView(::openmldb::codec::RowView::GetSchemaVersion(row));
+    if (view == nullptr) {
+        return false;
+    }
+    return Aggregate(view, row, buffer);
+}
+
+bool Aggregator::Aggregate(::openmldb::codec::RowView* view, const int8_t* row, AggrBuffer* buffer) const {
+    if (filter_col_ >= 0) {
+        bool cond = false;
+        if (view->GetValue(row, filter_col_, ::openmldb::type::kBool, &cond) != 0 || !cond) {
+            return false;
+        }
+    }
+    if (aggr_col_ < 0) {
+        buffer->cnt++;
+        return true;
+    }
+    if (view->IsNULL(row, aggr_col_)) {
+        return false;
+    }
+    switch (aggr_col_type_) {
+        case ::openmldb::type::kSmallInt:
+        case ::openmldb::type::kInt:
+        case ::openmldb::type::kBigInt:
+        case ::openmldb::type::kTimestamp: {
+            int64_t val = 0;
+            if (view->GetInteger(row, aggr_col_, aggr_col_type_, &val) != 0) {
+                return false;
+            }
+            buffer->int_sum += val;
+            buffer->int_min = std::min(buffer->int_min, val);
+            buffer->int_max = std::max(buffer->int_max, val);
+            break;
+        }
+        case ::openmldb::type::kFloat: {
+            float val = 0;
+            if (view->GetValue(row, aggr_col_, aggr_col_type_, &val) != 0) {
+                return false;
+            }
+            buffer->double_sum += val;
+            buffer->double_min = std::min(buffer->double_min, static_cast<double>(val));
+            buffer->double_max = std::max(buffer->double_max, static_cast<double>(val));
+            break;
+        }
+        case ::openmldb::type::kDouble: {
+            double val = 0;
+            if (view->GetValue(row, aggr_col_, aggr_col_type_, &val) != 0) {
+                return false;
+            }
+            buffer->double_sum += val;
+            buffer->double_min = std::min(buffer->double_min, val);
+            buffer->double_max = std::max(buffer->double_max, val);
+            break;
+        }
+        default:
+            // only counted
+            break;
+    }
+    buffer->cnt++;
+    return true;
+}
+
+void Aggregator::Shard::UpdateBucket(const std::string& key, uint64_t ts, uint64_t bucket_size,
+                                     const AggrBuffer& delta) {
+    buckets[key][ts - ts % bucket_size].Merge(delta);
+}
+
+void Aggregator::Update(const std::string& key, uint64_t ts, const ::openmldb::base::Slice& value) {
+    std::string buf;
+    AggrBuffer delta;
+    if (!AggregateRow(value, &buf, &delta)) {
+        return;
+    }
+    Shard& shard = GetShard(key);
+    std::lock_guard<std::mutex> lock(shard.mu);
+    if (shard.backfilling) {
+        shard.pending.emplace_back(key, ts, delta);
+        shard.pending_rows.emplace(key, ts, value.ToString());
+        return;
+    }
+    shard.UpdateBucket(key, ts, bucket_size_, delta);
+}
+
+void Aggregator::BeginBackfill() {
+    for (auto& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mu);
+        shard.backfilling = true;
+    }
+}
+
+void Aggregator::Backfill(const std::string& key, uint64_t ts, const ::openmldb::base::Slice& value) {
+    std::string buf;
+    AggrBuffer delta;
+    if (!AggregateRow(value, &buf, &delta)) {
+        return;
+    }
+    Shard& shard = GetShard(key);
+    std::lock_guard<std::mutex> lock(shard.mu);
+    if (!shard.pending_rows.empty()) {
+        auto it = shard.pending_rows.find(std::make_tuple(key, ts, value.ToString()));
+        if (it != shard.pending_rows.end()) {
+            // it's put after the backfill begins, the pending update counts it
+            shard.pending_rows.erase(it);
+            return;
+        }
+    }
+    shard.UpdateBucket(key, ts, bucket_size_, delta);
+}
+
+void Aggregator::EndBackfill() {
+    for (auto& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mu);
+        for (const auto& update : shard.pending) {
+            shard.UpdateBucket(std::get<0>(update), std::get<1>(update), bucket_size_, std::get<2>(update));
+        }
+        shard.pending.clear();
+        shard.pending_rows.clear();
+        shard.backfilling = false;
+    }
+}
+
+bool Aggregator::ScanRows(const std::string& key, uint64_t start_ts, uint64_t end_ts, AggrBuffer* buffer) {
+    Ticket ticket;
+    std::unique_ptr<TableIterator> it(table_->NewIterator(index_id_, key, ticket));
+    if (!it) {
+        return false;
+    }
+    std::string buf;
+    // the rows are in the descending order of ts
+    for (it->Seek(end_ts); it->Valid() && it->GetKey() >= start_ts; it->Next()) {
+        AggregateRow(it->GetValue(), &buf, buffer);
+    }
+    return true;
+}
+
+bool Aggregator::Query(const std::string& key, uint64_t start_ts, uint64_t end_ts, AggrBuffer* buffer) {
+    if (start_ts > end_ts) {
+        return true;
+    }
+    // the buckets in [first, last) are covered by the range
+    uint64_t first = (start_ts + bucket_size_ - 1) / bucket_size_ * bucket_size_;
+    uint64_t last = end_ts == UINT64_MAX ? end_ts - end_ts % bucket_size_ : (end_ts + 1) / bucket_size_ * bucket_size_;
+    if (first >= last) {
+        return ScanRows(key, start_ts, end_ts, buffer);
+    }
+    {
+        Shard& shard = GetShard(key);
+        std::lock_guard<std::mutex> lock(shard.mu);
+        if (shard.backfilling) {
+            return ScanRows(key, start_ts, end_ts, buffer);
+        }
+        auto key_it = shard.buckets.find(key);
+        if (key_it != shard.buckets.end()) {
+            for (auto it = key_it->second.lower_bound(first); it != key_it->second.end() && it->first < last; ++it) {
+                buffer->Merge(it->second);
+            }
+        }
+    }
+    if (start_ts < first && !ScanRows(key, start_ts, first - 1, buffer)) {
+        return false;
+    }
+    if (last <= end_ts && !ScanRows(key, last, end_ts, buffer)) {
+        return false;
+    }
+    return true;
+}
+
+bool Aggregator::IsIntegerOutput() const {
+    switch (type_) {
+        case AggrType::kCount:
+            return true;
+        case AggrType::kAvg:
+            return false;
+        default:
+            return aggr_col_type_ != ::openmldb::type::kFloat && aggr_col_type_ != ::openmldb::type::kDouble;
+    }
+}
+
+bool Aggregator::GetValue(const AggrBuffer& buffer, int64_t* int_value, double* double_value) const {
+    if (type_ == AggrType::kCount) {
+        *int_value = buffer.cnt;
+        return true;
+    }
+    // null like the sql aggregate functions if there is no value
+    if (buffer.cnt == 0) {
+        return false;
+    }
+    bool is_int = aggr_col_type_ != ::openmldb::type::kFloat && aggr_col_type_ != ::openmldb::type::kDouble;
+    switch (type_) {
+        case AggrType::kSum:
+            *int_value = buffer.int_sum;
+            *double_value = buffer.double_sum;
+            break;
+        case AggrType::kMin:
+            *int_value = buffer.int_min;
+            *double_value = buffer.double_min;
+            break;
+        case AggrType::kMax:
+            *int_value = buffer.int_max;
+            *double_value = buffer.double_max;
+            break;
+        case AggrType::kAvg:
+            *double_value = (is_int ? static_cast<double>(buffer.int_sum) : buffer.double_sum) / buffer.cnt;
+            break;
+        default:
+            return false;
+    }
+    return true;
+}
+
+void Aggregator::Delete(const std::string& key) {
+    Shard& shard = GetShard(key);
+    std::lock_guard<std::mutex> lock(shard.mu);
+    shard.buckets.erase(key);
+}
+
+void Aggregator::Expire(uint64_t time) {
+    if (time < bucket_size_) {
+        return;
+    }
+    uint64_t bound = time - bucket_size_;
+    for (auto& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mu);
+        for (auto key_it = shard.buckets.begin(); key_it != shard.buckets.end();) {
+            auto& buckets = key_it->second;
+            buckets.erase(buckets.begin(), buckets.upper_bound(bound));
+            if (buckets.empty()) {
+                key_it = shard.buckets.erase(key_it);
+            } else {
+                ++key_it;
+            }
+        }
+    }
+}
+
+}  // namespace storage
+}  // namespace openmldb
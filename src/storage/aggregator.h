@@ -0,0 +1,162 @@
+/*
+ * Copyright 2021 4Paradigm
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SRC_STORAGE_AGGREGATOR_H_
+#define SRC_STORAGE_AGGREGATOR_H_
+
+#include <array>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <set>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "base/hash.h"
+#include "base/slice.h"
+#include "codec/codec.h"
+#include "proto/tablet.pb.h"
+
+namespace openmldb {
+namespace storage {
+
+class Table;
+
+enum class AggrType { kSum = 1, kMin = 2, kMax = 3, kCount = 4, kAvg = 5 };
+
+// the partial aggregate of some rows, the integer and the double fields are used by the integer and the floating
+// columns respectively
+struct AggrBuffer {
+    // the number of non null values
+    int64_t cnt = 0;
+    int64_t int_sum = 0;
+    int64_t int_min = std::numeric_limits<int64_t>::max();
+    int64_t int_max = std::numeric_limits<int64_t>::min();
+    double double_sum = 0;
+    double double_min = std::numeric_limits<double>::infinity();
+    double double_max = -std::numeric_limits<double>::infinity();
+
+    void Merge(const AggrBuffer& other);
+};
+
+// Aggregator keeps the partial aggregates of an index in time buckets per key, they are updated on put. A query
+// over a long time range merges the buckets which are covered by it and scans the raw rows only at its two edges.
+// The rows deleted by the latest ttl are still counted in the buckets, so an aggregator is only created on the
+// index with the absolute ttl
+class Aggregator {
+ public:
+    Aggregator(Table* table, const ::openmldb::api::AggregatorInfo& info);
+    Aggregator(const Aggregator&) = delete;
+    Aggregator& operator=(const Aggregator&) = delete;
+
+    // resolve the index and the columns of info, msg is set if it's invalid
+    bool Init(std::string* msg);
+
+    // parse sum, count, min, max, avg and their _where forms
+    static bool ParseAggrFunc(const std::string& func, AggrType* type, bool* has_filter);
+
+    // aggregate a row put into the index with key and ts
+    void Update(const std::string& key, uint64_t ts, const ::openmldb::base::Slice& value);
+
+    // the existing rows are added by Backfill between BeginBackfill and EndBackfill. The rows put in the meantime
+    // are held back and the same rows found by Backfill are skipped, so every row is counted once
+    void BeginBackfill();
+    void Backfill(const std::string& key, uint64_t ts, const ::openmldb::base::Slice& value);
+    void EndBackfill();
+
+    // aggregate the rows of key whose ts is in [start_ts, end_ts]
+    bool Query(const std::string& key, uint64_t start_ts, uint64_t end_ts, AggrBuffer* buffer);
+
+    // aggregate an uncompressed row which is not in the table into buffer, e.g. the request row of a query. view
+    // is the row view of the schema of row, false if it's filtered out
+    bool Aggregate(::openmldb::codec::RowView* view, const int8_t* row, AggrBuffer* buffer) const;
+
+    // output the aggregate of buffer, false if it's null
+    bool GetValue(const AggrBuffer& buffer, int64_t* int_value, double* double_value) const;
+
+    // whether the output of GetValue is an integer
+    bool IsIntegerOutput() const;
+
+    void Delete(const std::string& key);
+
+    // drop the buckets which are entirely older than time
+    void Expire(uint64_t time);
+
+    inline uint32_t GetIndexId() const { return index_id_; }
+    inline int32_t GetTsIdx() const { return ts_idx_; }
+    inline uint64_t GetBucketSize() const { return bucket_size_; }
+    inline const ::openmldb::api::AggregatorInfo& GetInfo() const { return info_; }
+
+ private:
+    struct Decoder {
+        std::shared_ptr<::openmldb::codec::Schema> schema;
+        std::shared_ptr<::openmldb::codec::RowView> view;
+    };
+
+    // aggregate value into buffer, false if it's filtered out or can't be decoded
+    bool AggregateRow(const ::openmldb::base::Slice& value, std::string* buf, AggrBuffer* buffer);
+
+    ::openmldb::codec::RowView* GetRowView(uint8_t version);
+
+    bool ScanRows(const std::string& key, uint64_t start_ts, uint64_t end_ts, AggrBuffer* buffer);
+
+    // the buckets of the keys in a shard with their lock, the puts of different keys don't contend on one lock.
+    // The rows put during a backfill are held back per shard
+    struct Shard {
+        std::mutex mu;
+        std::unordered_map<std::string, std::map<uint64_t, AggrBuffer>> buckets;
+        bool backfilling = false;
+        std::vector<std::tuple<std::string, uint64_t, AggrBuffer>> pending;
+        std::multiset<std::tuple<std::string, uint64_t, std::string>> pending_rows;
+
+        void UpdateBucket(const std::string& key, uint64_t ts, uint64_t bucket_size, const AggrBuffer& delta);
+    };
+
+    inline Shard& GetShard(const std::string& key) {
+        return shards_[::openmldb::base::hash(key.data(), key.size(), SHARD_SEED) & (SHARD_CNT - 1)];
+    }
+
+    static constexpr uint32_t SHARD_CNT = 16;
+    static constexpr uint32_t SHARD_SEED = 0x3c6ef372;
+
+    Table* table_;
+    ::openmldb::api::AggregatorInfo info_;
+    AggrType type_;
+    uint32_t index_id_;
+    int32_t ts_idx_;
+    // -1 counts the rows
+    int32_t aggr_col_;
+    ::openmldb::type::DataType aggr_col_type_;
+    // -1 if there is no filter
+    int32_t filter_col_;
+    uint64_t bucket_size_;
+    bool compressed_;
+
+    std::array<Shard, SHARD_CNT> shards_;
+
+    std::mutex decoder_mu_;
+    // the row views of the schema versions, it's copied on write so that it's read without the lock
+    std::shared_ptr<std::map<uint8_t, Decoder>> decoders_;
+};
+
+}  // namespace storage
+}  // namespace openmldb
+
+#endif  // SRC_STORAGE_AGGREGATOR_H_
@@ -0,0 +1,308 @@
+/*
+ * Copyright 2021 4Paradigm
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "storage/aggregator.h"
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "base/glog_wapper.h"
+#include "codec/codec.h"
+#include "codec/schema_codec.h"
+#include "gtest/gtest.h"
+#include "storage/mem_table.h"
+#include "storage/mem_table_checkpoint.h"
+
+namespace openmldb {
+namespace storage {
+
+using ::openmldb::codec::SchemaCodec;
+
+class AggregatorTest : public ::testing::Test {
+ public:
+    AggregatorTest() {}
+    ~AggregatorTest() {}
+};
+
+struct TestRow {
+    std::string card;
+    int64_t price;
+    double amt;
+    bool flag;
+    uint64_t ts;
+};
+
+static ::openmldb::api::TableMeta GetTableMeta() {
+    ::openmldb::api::TableMeta table_meta;
+    table_meta.set_name("t1");
+    table_meta.set_tid(1);
+    table_meta.set_pid(0);
+    table_meta.set_seg_cnt(8);
+    table_meta.set_mode(::openmldb::api::TableMode::kTableLeader);
+    SchemaCodec::SetColumnDesc(table_meta.add_column_desc(), "card", ::openmldb::type::kString);
+    SchemaCodec::SetColumnDesc(table_meta.add_column_desc(), "price", ::openmldb::type::kBigInt);
+    SchemaCodec::SetColumnDesc(table_meta.add_column_desc(), "amt", ::openmldb::type::kDouble);
+    SchemaCodec::SetColumnDesc(table_meta.add_column_desc(), "flag", ::openmldb::type::kBool);
+    SchemaCodec::SetColumnDesc(table_meta.add_column_desc(), "ts1", ::openmldb::type::kBigInt);
+    SchemaCodec::SetIndex(table_meta.add_column_key(), "card", "card", "ts1", ::openmldb::type::kAbsoluteTime, 0, 0);
+    SchemaCodec::SetIndex(table_meta.add_column_key(), "card_lat", "card", "ts1", ::openmldb::type::kLatestTime, 0,
+                          10);
+    return table_meta;
+}
+
+static ::openmldb::api::AggregatorInfo GetInfo(const std::string& func, const std::string& col,
+                                               const std::string& filter, uint64_t bucket_size) {
+    ::openmldb::api::AggregatorInfo info;
+    info.set_aggr_func(func);
+    info.set_index_name("card");
+    info.set_aggr_col(col);
+    info.set_filter_col(filter);
+    info.set_bucket_size(bucket_size);
+    return info;
+}
+
+static void PutRows(MemTable* table, std::vector<TestRow>* rows, int begin, int end) {
+    ::openmldb::codec::RowBuilder builder(table->GetTableMeta()->column_desc());
+    for (int i = begin; i < end; i++) {
+        TestRow row = {"card" + std::to_string(i % 5), i, i * 0.5, i % 3 == 0, 10000 + static_cast<uint64_t>(i) * 7};
+        std::string value;
+        value.resize(builder.CalTotalLength(row.card.size()));
+        builder.SetBuffer(reinterpret_cast<int8_t*>(&value[0]), value.size());
+        ASSERT_TRUE(builder.AppendString(row.card.c_str(), row.card.size()));
+        ASSERT_TRUE(builder.AppendInt64(row.price));
+        ASSERT_TRUE(builder.AppendDouble(row.amt));
+        ASSERT_TRUE(builder.AppendBool(row.flag));
+        ASSERT_TRUE(builder.AppendInt64(row.ts));
+        ::openmldb::api::PutRequest request;
+        ::openmldb::api::Dimension* dim = request.add_dimensions();
+        dim->set_idx(0);
+        dim->set_key(row.card);
+        dim = request.add_dimensions();
+        dim->set_idx(1);
+        dim->set_key(row.card);
+        ::openmldb::api::TSDimension* ts = request.add_ts_dimensions();
+        ts->set_idx(0);
+        ts->set_ts(row.ts);
+        ASSERT_TRUE(table->Put(request.dimensions(), request.ts_dimensions(), value));
+        rows->push_back(row);
+    }
+}
+
+// check the aggregator against the rows on the ranges crossing many buckets, one bucket or none
+static void CheckQuery(MemTable* table, uint32_t pos, const std::vector<TestRow>& rows) {
+    auto aggregator = table->GetAggregator(pos);
+    ASSERT_TRUE(aggregator);
+    const auto& info = aggregator->GetInfo();
+    std::vector<std::pair<uint64_t, uint64_t>> ranges = {
+        {0, UINT64_MAX}, {10000, 17000}, {10003, 16999}, {12345, 12999}, {12001, 12002}, {20000, 10000}};
+    for (const auto& range : ranges) {
+        for (int k = 0; k < 5; k++) {
+            std::string key = "card" + std::to_string(k);
+            int64_t cnt = 0;
+            int64_t int_sum = 0;
+            double double_sum = 0;
+            int64_t int_max = INT64_MIN;
+            for (const auto& row : rows) {
+                if (row.card != key || row.ts < range.first || row.ts > range.second) {
+                    continue;
+                }
+                if (!info.filter_col().empty() && !row.flag) {
+                    continue;
+                }
+                cnt++;
+                int_sum += row.price;
+                double_sum += row.amt;
+                int_max = std::max(int_max, row.price);
+            }
+            AggrBuffer buffer;
+            ASSERT_TRUE(aggregator->Query(key, range.first, range.second, &buffer));
+            int64_t int_value = 0;
+            double double_value = 0;
+            bool not_null = aggregator->GetValue(buffer, &int_value, &double_value);
+            if (info.aggr_func() == "count" || info.aggr_func() == "count_where") {
+                ASSERT_TRUE(not_null);
+                ASSERT_EQ(cnt, int_value);
+                continue;
+            }
+            ASSERT_EQ(cnt > 0, not_null);
+            if (cnt == 0) {
+                continue;
+            }
+            if (info.aggr_func() == "sum") {
+                ASSERT_EQ(int_sum, int_value);
+            } else if (info.aggr_func() == "max") {
+                ASSERT_EQ(int_max, int_value);
+            } else if (info.aggr_func() == "avg_where") {
+                ASSERT_DOUBLE_EQ(double_sum / cnt, double_value);
+            }
+        }
+    }
+}
+
+TEST_F(AggregatorTest, ParseAggrFunc) {
+    AggrType type;
+    bool has_filter = false;
+    ASSERT_TRUE(Aggregator::ParseAggrFunc("sum", &type, &has_filter));
+    ASSERT_EQ(AggrType::kSum, type);
+    ASSERT_FALSE(has_filter);
+    ASSERT_TRUE(Aggregator::ParseAggrFunc("avg_where", &type, &has_filter));
+    ASSERT_EQ(AggrType::kAvg, type);
+    ASSERT_TRUE(has_filter);
+    ASSERT_FALSE(Aggregator::ParseAggrFunc("_where", &type, &has_filter));
+    ASSERT_FALSE(Aggregator::ParseAggrFunc("distinct_count", &type, &has_filter));
+}
+
+TEST_F(AggregatorTest, InvalidInfo) {
+    MemTable table(GetTableMeta());
+    ASSERT_TRUE(table.Init());
+    std::string msg;
+    ASSERT_FALSE(table.AddAggregator(GetInfo("median", "price", "", 1000), &msg));
+    ASSERT_FALSE(table.AddAggregator(GetInfo("sum", "price", "", 0), &msg));
+    ASSERT_FALSE(table.AddAggregator(GetInfo("sum", "", "", 1000), &msg));
+    ASSERT_FALSE(table.AddAggregator(GetInfo("sum", "card", "", 1000), &msg));
+    ASSERT_FALSE(table.AddAggregator(GetInfo("sum_where", "price", "price", 1000), &msg));
+    auto info = GetInfo("sum", "price", "", 1000);
+    info.set_index_name("card_lat");
+    ASSERT_FALSE(table.AddAggregator(info, &msg));
+    ASSERT_FALSE(table.GetAggregator(0));
+    ASSERT_EQ(0, table.GetTableMeta()->aggregators_size());
+}
+
+TEST_F(AggregatorTest, UpdateOnPut) {
+    auto table_meta = GetTableMeta();
+    table_meta.add_aggregators()->CopyFrom(GetInfo("sum", "price", "", 1000));
+    table_meta.add_aggregators()->CopyFrom(GetInfo("count", "*", "", 300));
+    table_meta.add_aggregators()->CopyFrom(GetInfo("max", "price", "", 1000));
+    MemTable table(table_meta);
+    ASSERT_TRUE(table.Init());
+    std::vector<TestRow> rows;
+    PutRows(&table, &rows, 0, 1000);
+    CheckQuery(&table, 0, rows);
+    CheckQuery(&table, 1, rows);
+    CheckQuery(&table, 2, rows);
+    ASSERT_FALSE(table.GetAggregator(3));
+
+    ASSERT_TRUE(table.Delete("card1", 0));
+    rows.erase(std::remove_if(rows.begin(), rows.end(), [](const TestRow& row) { return row.card == "card1"; }),
+               rows.end());
+    CheckQuery(&table, 0, rows);
+}
+
+TEST_F(AggregatorTest, Backfill) {
+    MemTable table(GetTableMeta());
+    ASSERT_TRUE(table.Init());
+    std::vector<TestRow> rows;
+    PutRows(&table, &rows, 0, 500);
+    std::string msg;
+    ASSERT_TRUE(table.AddAggregator(GetInfo("avg_where", "amt", "flag", 1000), &msg));
+    ASSERT_TRUE(table.AddAggregator(GetInfo("count_where", "", "flag", 100), &msg));
+    ASSERT_EQ(2, table.GetTableMeta()->aggregators_size());
+    PutRows(&table, &rows, 500, 1000);
+    CheckQuery(&table, 0, rows);
+    CheckQuery(&table, 1, rows);
+
+    // a table loaded with the meta gets the same aggregators
+    MemTable loaded(*table.GetTableMeta());
+    ASSERT_TRUE(loaded.Init());
+    std::vector<TestRow> loaded_rows;
+    PutRows(&loaded, &loaded_rows, 0, 1000);
+    CheckQuery(&loaded, 0, loaded_rows);
+    CheckQuery(&loaded, 1, loaded_rows);
+}
+
+TEST_F(AggregatorTest, Expire) {
+    MemTable table(GetTableMeta());
+    ASSERT_TRUE(table.Init());
+    std::vector<TestRow> rows;
+    PutRows(&table, &rows, 0, 1000);
+    std::string msg;
+    ASSERT_TRUE(table.AddAggregator(GetInfo("count", "", "", 1000), &msg));
+    auto aggregator = table.GetAggregator(0);
+    AggrBuffer buffer;
+    ASSERT_TRUE(aggregator->Query("card0", 10000, 10999, &buffer));
+    ASSERT_EQ(29, buffer.cnt);
+    // the bucket is covered by the range entirely, it's dropped with the rows expired
+    aggregator->Expire(11000);
+    buffer = AggrBuffer();
+    ASSERT_TRUE(aggregator->Query("card0", 10000, 10999, &buffer));
+    ASSERT_EQ(0, buffer.cnt);
+    buffer = AggrBuffer();
+    ASSERT_TRUE(aggregator->Query("card0", 11000, 11999, &buffer));
+    ASSERT_EQ(29, buffer.cnt);
+}
+
+TEST_F(AggregatorTest, ConcurrentPut) {
+    auto table_meta = GetTableMeta();
+    table_meta.add_aggregators()->CopyFrom(GetInfo("sum", "price", "", 1000));
+    table_meta.add_aggregators()->CopyFrom(GetInfo("count_where", "", "flag", 300));
+    MemTable table(table_meta);
+    ASSERT_TRUE(table.Init());
+    std::vector<std::vector<TestRow>> thread_rows(4);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; i++) {
+        threads.emplace_back([&table, &thread_rows, i]() { PutRows(&table, &thread_rows[i], i * 500, i * 500 + 500); });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    std::vector<TestRow> rows;
+    for (const auto& cur : thread_rows) {
+        rows.insert(rows.end(), cur.begin(), cur.end());
+    }
+    ASSERT_EQ(2000u, rows.size());
+    CheckQuery(&table, 0, rows);
+    CheckQuery(&table, 1, rows);
+}
+
+TEST_F(AggregatorTest, RecoverFromCheckpoint) {
+    auto table_meta = GetTableMeta();
+    table_meta.add_aggregators()->CopyFrom(GetInfo("sum", "price", "", 1000));
+    table_meta.add_aggregators()->CopyFrom(GetInfo("count_where", "", "flag", 300));
+    auto table = std::make_shared<MemTable>(table_meta);
+    ASSERT_TRUE(table->Init());
+    std::vector<TestRow> rows;
+    PutRows(table.get(), &rows, 0, 1000);
+    std::string path = "/tmp/aggregator_test/" + std::to_string(rand() % 10000000 + 1) + "/checkpoint/";  // NOLINT
+    MemTableCheckpoint checkpoint(1, 0, path);
+    ASSERT_TRUE(checkpoint.Init());
+    ASSERT_EQ(0, checkpoint.Make(table, []() { return 1000; }));
+
+    // the rows loaded from the checkpoint are aggregated as the replayed ones
+    auto loaded = std::make_shared<MemTable>(table_meta);
+    ASSERT_TRUE(loaded->Init());
+    uint64_t offset = 0;
+    uint64_t end_offset = 0;
+    ASSERT_EQ(0, checkpoint.Recover(loaded, 0, &offset, &end_offset));
+    ASSERT_EQ(1000u, offset);
+    ASSERT_EQ(1000u, loaded->GetRecordCnt());
+    CheckQuery(loaded.get(), 0, rows);
+    CheckQuery(loaded.get(), 1, rows);
+    PutRows(loaded.get(), &rows, 1000, 1500);
+    CheckQuery(loaded.get(), 0, rows);
+    CheckQuery(loaded.get(), 1, rows);
+}
+
+}  // namespace storage
+}  // namespace openmldb
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    ::openmldb::base::SetLogLevel(INFO);
+    return RUN_ALL_TESTS();
+}
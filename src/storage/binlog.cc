@@ -31,6 +31,7 @@
 #include "common/timer.h"
 #include "gflags/gflags.h"
 #include "log/log_writer.h"
+#include "storage/mem_table.h"
 
 DECLARE_uint64(gc_on_table_recover_count);
 DECLARE_int32(binlog_name_length);
@@ -40,9 +41,11 @@ namespace storage {
 
 Binlog::Binlog(LogParts* log_part, const std::string& binlog_path) : log_part_(log_part), log_path_(binlog_path) {}
 
-bool Binlog::RecoverFromBinlog(std::shared_ptr<Table> table, uint64_t offset, uint64_t& latest_offset) {
+bool Binlog::RecoverFromBinlog(std::shared_ptr<Table> table, uint64_t offset, uint64_t& latest_offset,
+                               uint64_t dedup_end_offset) {
     uint32_t tid = table->GetId();
     uint32_t pid = table->GetPid();
+    std::shared_ptr<MemTable> mem_table = std::dynamic_pointer_cast<MemTable>(table);
     PDLOG(INFO, "start recover table tid %u, pid %u from binlog with start offset %lu", tid, pid, offset);
     ::openmldb::log::LogReader log_reader(log_part_, log_path_, false);
     log_reader.SetOffset(offset);
@@ -53,6 +56,8 @@ bool Binlog::RecoverFromBinlog(std::shared_ptr<Table> table, uint64_t offset, ui
     uint64_t failed_cnt = 0;
     uint64_t consumed = ::baidu::common::timer::now_time();
     int last_log_index = log_reader.GetLogIndex();
+    // the same rows replayed in (offset, dedup_end_offset]
+    MemTable::ReplayCounts replayed;
     bool reach_end_log = true;
     while (true) {
         buffer.clear();
@@ -115,6 +120,8 @@ bool Binlog::RecoverFromBinlog(std::shared_ptr<Table> table, uint64_t offset, ui
             } else {
                 table->Delete(entry.dimensions(0).key(), entry.dimensions(0).idx());
             }
+        } else if (mem_table && entry.log_index() <= dedup_end_offset) {
+            mem_table->PutIfAbsent(entry, &replayed);
         } else {
             table->Put(entry);
         }
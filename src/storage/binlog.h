@@ -32,8 +32,10 @@ class Binlog {
  public:
     Binlog(LogParts* log_part, const std::string& binlog_path);
     ~Binlog() = default;
+    // the entries in (offset, dedup_end_offset] may be in the table already, they are put by PutIfAbsent
     bool RecoverFromBinlog(std::shared_ptr<Table> table, uint64_t offset,
-                           uint64_t& latest_offset);  // NOLINT
+                           uint64_t& latest_offset,  // NOLINT
+                           uint64_t dedup_end_offset = 0);
 
  private:
     LogParts* log_part_;
@@ -0,0 +1,1029 @@
+/*
+ * Copyright 2021 4Paradigm
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "storage/disk_table.h"
+
+#include <endian.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <utility>
+
+#include "base/file_util.h"
+#include "base/glog_wapper.h"
+#include "common/timer.h"
+#include "gflags/gflags.h"
+
+DECLARE_uint32(write_buffer_mb);
+DECLARE_string(file_compression);
+DECLARE_uint32(max_traverse_cnt);
+DECLARE_uint32(disk_table_file_size_mb);
+
+namespace openmldb {
+namespace storage {
+
+static const uint8_t TYPE_DELETION = 0;
+static const uint8_t TYPE_VALUE = 1;
+// the writers wait for the flush if there are so many write buffers waiting
+static const uint32_t MAX_IMM_NUM = 4;
+static const char* FILE_SUFFIX = ".sst";
+static const char* TMP_SUFFIX = ".tmp";
+
+// the key of a row is [index id u32][pk size u32][pk][~time u64][~seq u64] in big endian, so the rows of a key
+// are in the desc order of time and the tombstone of a key, whose time is UINT64_MAX, is the first
+static std::string EncodePrefix(uint32_t index_id, const ::openmldb::base::Slice& pk) {
+    std::string prefix;
+    prefix.reserve(8 + pk.size() + 16);
+    uint32_t id = htobe32(index_id);
+    uint32_t size = htobe32(pk.size());
+    prefix.append(reinterpret_cast<const char*>(&id), sizeof(id));
+    prefix.append(reinterpret_cast<const char*>(&size), sizeof(size));
+    prefix.append(pk.data(), pk.size());
+    return prefix;
+}
+
+static std::string EncodeIndexPrefix(uint32_t index_id) {
+    uint32_t id = htobe32(index_id);
+    return std::string(reinterpret_cast<const char*>(&id), sizeof(id));
+}
+
+static void AppendInverted64(std::string* key, uint64_t value) {
+    value = htobe64(~value);
+    key->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+static uint64_t DecodeInverted64(const char* ptr) {
+    uint64_t value;
+    memcpy(&value, ptr, sizeof(value));
+    return ~be64toh(value);
+}
+
+// the size of [index id][pk size][pk] of a key, it's 0 if the key is invalid
+static uint32_t GetPrefixSize(const ::openmldb::base::Slice& key) {
+    if (key.size() < 8 + 16) {
+        return 0;
+    }
+    uint32_t pk_size;
+    memcpy(&pk_size, key.data() + 4, sizeof(pk_size));
+    pk_size = be32toh(pk_size);
+    if (key.size() != 8 + pk_size + 16) {
+        return 0;
+    }
+    return 8 + pk_size;
+}
+
+// the first key after all the keys of prefix
+static std::string GetPrefixEnd(const std::string& prefix) { return prefix + std::string(16, '\xff'); }
+
+class WriteBuffer::Iterator : public SortedIterator {
+ public:
+    explicit Iterator(WriteBuffer* buffer) : it_(buffer->list_.NewIterator()) {}
+    bool Valid() const override { return it_->Valid(); }
+    void Next() override { it_->Next(); }
+    ::openmldb::base::Slice GetKey() const override { return it_->GetKey(); }
+    ::openmldb::base::Slice GetValue() const override { return it_->GetValue(); }
+    void Seek(const ::openmldb::base::Slice& key) override { it_->Seek(key); }
+    void SeekToFirst() override { it_->SeekToFirst(); }
+
+ private:
+    std::unique_ptr<::openmldb::base::Skiplist<::openmldb::base::Slice, ::openmldb::base::Slice,
+                                               DiskKeyComparator>::Iterator>
+        it_;
+};
+
+WriteBuffer::WriteBuffer() : list_(12, 4, DiskKeyComparator()), byte_size_(0), max_seq_(0) {}
+
+WriteBuffer::~WriteBuffer() {
+    std::vector<const char*> bufs;
+    std::unique_ptr<::openmldb::base::Skiplist<::openmldb::base::Slice, ::openmldb::base::Slice,
+                                               DiskKeyComparator>::Iterator>
+        it(list_.NewIterator());
+    for (it->SeekToFirst(); it->Valid(); it->Next()) {
+        bufs.push_back(it->GetKey().data());
+    }
+    list_.Clear();
+    for (const char* buf : bufs) {
+        delete[] buf;
+    }
+}
+
+void WriteBuffer::Put(const ::openmldb::base::Slice& key, uint8_t type, const ::openmldb::base::Slice& value,
+                      uint64_t seq) {
+    // the key and the value are in one buffer, the value is prefixed by the type
+    char* buf = new char[key.size() + 1 + value.size()];
+    memcpy(buf, key.data(), key.size());
+    buf[key.size()] = static_cast<char>(type);
+    memcpy(buf + key.size() + 1, value.data(), value.size());
+    ::openmldb::base::Slice skey(buf, key.size());
+    ::openmldb::base::Slice svalue(buf + key.size(), 1 + value.size());
+    list_.Insert(skey, svalue);
+    byte_size_.fetch_add(key.size() + 1 + value.size(), std::memory_order_relaxed);
+    max_seq_.store(seq, std::memory_order_relaxed);
+}
+
+SortedIterator* WriteBuffer::NewIterator() { return new Iterator(this); }
+
+SortedIterator* DiskVersion::NewIterator() const {
+    std::vector<SortedIterator*> iters;
+    iters.push_back(mem->NewIterator());
+    for (const auto& imm : imms) {
+        iters.push_back(imm->NewIterator());
+    }
+    for (const auto& file : files) {
+        iters.push_back(file->NewIterator());
+    }
+    return new MergedIterator(std::move(iters));
+}
+
+void DiskRowCursor::ReadTombstone(const std::string& prefix) {
+    prefix_ = prefix;
+    del_seq_ = 0;
+    it_->Seek(prefix_);
+    // the tombstones are the first of the key, the latest one is the first of them
+    if (it_->Valid() && it_->GetKey().starts_with(prefix_) && it_->GetValue().data()[0] == TYPE_DELETION) {
+        del_seq_ = DecodeInverted64(it_->GetKey().data() + prefix_.size() + 8);
+    }
+}
+
+void DiskRowCursor::SeekToFirst(const std::string& prefix) {
+    ReadTombstone(prefix);
+    Skip();
+}
+
+void DiskRowCursor::Seek(const std::string& prefix, uint64_t time) {
+    ReadTombstone(prefix);
+    std::string key = prefix_;
+    AppendInverted64(&key, time);
+    it_->Seek(key);
+    Skip();
+}
+
+void DiskRowCursor::Next() {
+    it_->Next();
+    Skip();
+}
+
+void DiskRowCursor::Skip() {
+    valid_ = false;
+    for (; it_->Valid(); it_->Next()) {
+        ::openmldb::base::Slice key = it_->GetKey();
+        if (!key.starts_with(prefix_) || key.size() != prefix_.size() + 16) {
+            return;
+        }
+        uint64_t seq = DecodeInverted64(key.data() + prefix_.size() + 8);
+        if (it_->GetValue().data()[0] == TYPE_DELETION || seq < del_seq_) {
+            continue;
+        }
+        time_ = DecodeInverted64(key.data() + prefix_.size());
+        valid_ = true;
+        return;
+    }
+}
+
+::openmldb::base::Slice DiskRowCursor::GetValue() const {
+    ::openmldb::base::Slice value = it_->GetValue();
+    return ::openmldb::base::Slice(value.data() + 1, value.size() - 1);
+}
+
+::openmldb::base::Slice DiskRowCursor::CopyValue() const {
+    ::openmldb::base::Slice value = GetValue();
+    char* buf = new char[value.size()];
+    memcpy(buf, value.data(), value.size());
+    return ::openmldb::base::Slice(buf, value.size(), true);
+}
+
+std::string DiskRowCursor::GetPK() const {
+    if (prefix_.size() < 8) {
+        return std::string();
+    }
+    return prefix_.substr(8);
+}
+
+DiskTableIterator::DiskTableIterator(const std::shared_ptr<DiskVersion>& version, const std::string& prefix)
+    : version_(version), it_(version->NewIterator()), prefix_(prefix), cursor_(it_.get()) {}
+
+void DiskTableIterator::SeekToLast() {
+    uint64_t cnt = 0;
+    for (cursor_.SeekToFirst(prefix_); cursor_.Valid(); cursor_.Next()) {
+        cnt++;
+    }
+    cursor_.SeekToFirst(prefix_);
+    for (uint64_t i = 1; i < cnt; i++) {
+        cursor_.Next();
+    }
+}
+
+DiskTableWindowIterator::DiskTableWindowIterator(const std::shared_ptr<DiskVersion>& version,
+                                                 const std::string& prefix, ::openmldb::storage::TTLType ttl_type,
+                                                 uint64_t expire_time, uint64_t expire_cnt)
+    : version_(version),
+      it_(version->NewIterator()),
+      prefix_(prefix),
+      cursor_(it_.get()),
+      record_idx_(0),
+      expire_value_(expire_time, expire_cnt, ttl_type),
+      row_() {}
+
+const ::hybridse::codec::Row& DiskTableWindowIterator::GetValue() {
+    ::openmldb::base::Slice value = cursor_.GetValue();
+    int8_t* buf = reinterpret_cast<int8_t*>(malloc(value.size()));
+    memcpy(buf, value.data(), value.size());
+    row_ = ::hybridse::codec::Row(::hybridse::base::RefCountedSlice::CreateManaged(buf, value.size()));
+    return row_;
+}
+
+DiskTableKeyIterator::DiskTableKeyIterator(const std::shared_ptr<DiskVersion>& version, uint32_t index_id,
+                                           ::openmldb::storage::TTLType ttl_type, uint64_t expire_time,
+                                           uint64_t expire_cnt)
+    : version_(version),
+      it_(version->NewIterator()),
+      cursor_(it_.get()),
+      index_prefix_(EncodeIndexPrefix(index_id)),
+      ttl_type_(ttl_type),
+      expire_time_(expire_time),
+      expire_cnt_(expire_cnt),
+      valid_(false) {}
+
+void DiskTableKeyIterator::SeekKey() {
+    valid_ = false;
+    while (it_->Valid() && it_->GetKey().starts_with(index_prefix_)) {
+        uint32_t prefix_size = GetPrefixSize(it_->GetKey());
+        if (prefix_size == 0) {
+            it_->Next();
+            continue;
+        }
+        std::string prefix(it_->GetKey().data(), prefix_size);
+        cursor_.SeekToFirst(prefix);
+        if (cursor_.Valid()) {
+            valid_ = true;
+            return;
+        }
+        it_->Seek(GetPrefixEnd(prefix));
+    }
+}
+
+void DiskTableKeyIterator::SeekToFirst() {
+    it_->Seek(index_prefix_);
+    SeekKey();
+}
+
+void DiskTableKeyIterator::Seek(const std::string& key) {
+    it_->Seek(index_prefix_ + EncodePrefix(0, key).substr(4));
+    SeekKey();
+}
+
+void DiskTableKeyIterator::Next() {
+    it_->Seek(GetPrefixEnd(cursor_.GetPrefix()));
+    SeekKey();
+}
+
+::hybridse::vm::RowIterator* DiskTableKeyIterator::GetRawValue() {
+    auto* it = new DiskTableWindowIterator(version_, cursor_.GetPrefix(), ttl_type_, expire_time_, expire_cnt_);
+    it->SeekToFirst();
+    return it;
+}
+
+std::unique_ptr<::hybridse::vm::RowIterator> DiskTableKeyIterator::GetValue() {
+    return std::unique_ptr<::hybridse::vm::RowIterator>(GetRawValue());
+}
+
+const hybridse::codec::Row DiskTableKeyIterator::GetKey() {
+    std::string pk = cursor_.GetPK();
+    int8_t* buf = reinterpret_cast<int8_t*>(malloc(pk.size()));
+    memcpy(buf, pk.data(), pk.size());
+    return hybridse::codec::Row(::hybridse::base::RefCountedSlice::CreateManaged(buf, pk.size()));
+}
+
+DiskTableTraverseIterator::DiskTableTraverseIterator(const std::shared_ptr<DiskVersion>& version, uint32_t index_id,
+                                                     ::openmldb::storage::TTLType ttl_type, uint64_t expire_time,
+                                                     uint64_t expire_cnt)
+    : version_(version),
+      it_(version->NewIterator()),
+      cursor_(it_.get()),
+      index_prefix_(EncodeIndexPrefix(index_id)),
+      record_idx_(0),
+      expire_value_(expire_time, expire_cnt, ttl_type),
+      traverse_cnt_(0),
+      valid_(false) {}
+
+bool DiskTableTraverseIterator::Valid() {
+    return valid_ && cursor_.Valid() && !expire_value_.IsExpired(cursor_.GetTime(), record_idx_);
+}
+
+void DiskTableTraverseIterator::Next() {
+    cursor_.Next();
+    record_idx_++;
+    traverse_cnt_++;
+    if (!cursor_.Valid() || expire_value_.IsExpired(cursor_.GetTime(), record_idx_)) {
+        it_->Seek(GetPrefixEnd(cursor_.GetPrefix()));
+        SeekKey();
+    }
+}
+
+void DiskTableTraverseIterator::SeekKey() {
+    valid_ = false;
+    while (it_->Valid() && it_->GetKey().starts_with(index_prefix_)) {
+        if (traverse_cnt_ >= FLAGS_max_traverse_cnt) {
+            return;
+        }
+        uint32_t prefix_size = GetPrefixSize(it_->GetKey());
+        if (prefix_size == 0) {
+            it_->Next();
+            continue;
+        }
+        std::string prefix(it_->GetKey().data(), prefix_size);
+        cursor_.SeekToFirst(prefix);
+        record_idx_ = 1;
+        traverse_cnt_++;
+        if (cursor_.Valid() && !expire_value_.IsExpired(cursor_.GetTime(), record_idx_)) {
+            valid_ = true;
+            return;
+        }
+        it_->Seek(GetPrefixEnd(prefix));
+    }
+}
+
+void DiskTableTraverseIterator::SeekToFirst() {
+    it_->Seek(index_prefix_);
+    SeekKey();
+}
+
+void DiskTableTraverseIterator::Seek(const std::string& key, uint64_t time) {
+    std::string prefix = index_prefix_ + EncodePrefix(0, key).substr(4);
+    it_->Seek(prefix);
+    if (!it_->Valid() || GetPrefixSize(it_->GetKey()) != prefix.size() || !it_->GetKey().starts_with(prefix)) {
+        // the key is not found, start from the key after it
+        SeekKey();
+        return;
+    }
+    valid_ = true;
+    if (expire_value_.ttl_type == ::openmldb::storage::TTLType::kLatestTime) {
+        record_idx_ = 1;
+        for (cursor_.SeekToFirst(prefix); cursor_.Valid() && record_idx_ <= expire_value_.lat_ttl;
+             cursor_.Next(), record_idx_++) {
+            traverse_cnt_++;
+            if (cursor_.GetTime() < time) {
+                return;
+            }
+        }
+    } else {
+        cursor_.Seek(prefix, time);
+        record_idx_ = 1;
+        traverse_cnt_++;
+        if (cursor_.Valid() && cursor_.GetTime() == time) {
+            cursor_.Next();
+        }
+        if (cursor_.Valid() && !expire_value_.IsExpired(cursor_.GetTime(), record_idx_)) {
+            return;
+        }
+    }
+    it_->Seek(GetPrefixEnd(prefix));
+    SeekKey();
+}
+
+uint64_t DiskTableTraverseIterator::GetKey() const {
+    if (valid_ && cursor_.Valid()) {
+        return cursor_.GetTime();
+    }
+    return UINT64_MAX;
+}
+
+DiskTable::DiskTable(const ::openmldb::api::TableMeta& table_meta, const std::string& db_path)
+    : Table(table_meta.name(), table_meta.tid(), table_meta.pid(), 0, true, 60 * 1000,
+            std::map<std::string, uint32_t>(), ::openmldb::type::TTLType::kAbsoluteTime,
+            ::openmldb::type::CompressType::kNoCompress),
+      db_path_(db_path),
+      version_(std::make_shared<DiskVersion>()),
+      seq_(0),
+      file_no_(0),
+      record_cnt_(0),
+      count_index_id_(0) {
+    diskused_ = 0;
+    table_meta_ = std::make_shared<::openmldb::api::TableMeta>(table_meta);
+    version_->mem = std::make_shared<WriteBuffer>();
+}
+
+DiskTable::~DiskTable() {
+    version_.reset();
+    PDLOG(INFO, "drop disktable. tid %u pid %u", id_, pid_);
+}
+
+bool DiskTable::Init() {
+    if (!InitFromMeta()) {
+        return false;
+    }
+    auto index = GetIndex(0);
+    if (index) {
+        count_index_id_ = index->GetId();
+    }
+    if (!::openmldb::base::MkdirRecur(db_path_)) {
+        PDLOG(WARNING, "fail to create path %s. tid %u pid %u", db_path_.c_str(), id_, pid_);
+        return false;
+    }
+    std::vector<std::string> file_vec;
+    if (::openmldb::base::GetFileName(db_path_, file_vec) < 0) {
+        return false;
+    }
+    auto version = std::make_shared<DiskVersion>();
+    version->mem = std::make_shared<WriteBuffer>();
+    uint64_t record_cnt = 0;
+    for (const auto& path : file_vec) {
+        std::string name = ::openmldb::base::ParseFileNameFromPath(path);
+        if (name.size() > strlen(TMP_SUFFIX) &&
+            name.compare(name.size() - strlen(TMP_SUFFIX), strlen(TMP_SUFFIX), TMP_SUFFIX) == 0) {
+            // a flush or a compaction broken off
+            unlink(path.c_str());
+            continue;
+        }
+        if (name.size() <= strlen(FILE_SUFFIX) ||
+            name.compare(name.size() - strlen(FILE_SUFFIX), strlen(FILE_SUFFIX), FILE_SUFFIX) != 0) {
+            continue;
+        }
+        std::shared_ptr<SortedFile> file = SortedFile::Open(path);
+        if (!file) {
+            PDLOG(WARNING, "fail to open sorted file %s. tid %u pid %u", path.c_str(), id_, pid_);
+            return false;
+        }
+        uint64_t file_no = strtoull(name.c_str(), NULL, 10);
+        file_no_ = std::max(file_no_.load(std::memory_order_relaxed), file_no + 1);
+        seq_ = std::max(seq_, file->GetMeta().max_seq);
+        record_cnt += file->GetMeta().record_cnt;
+        version->files.push_back(file);
+    }
+    record_cnt_.store(record_cnt, std::memory_order_relaxed);
+    SetVersion(version);
+    UpdateDiskused();
+    PDLOG(INFO, "init disk table name %s, id %d, pid %d, file cnt %u, path %s", name_.c_str(), id_, pid_,
+          version->files.size(), db_path_.c_str());
+    return true;
+}
+
+std::string DiskTable::NewFilePath() {
+    char name[32];
+    snprintf(name, sizeof(name), "%010lu", file_no_.fetch_add(1, std::memory_order_relaxed));
+    return db_path_ + "/" + name;
+}
+
+void DiskTable::UpdateDiskused() {
+    uint64_t size = 0;
+    for (const auto& file : GetVersion()->files) {
+        size += file->GetFileSize();
+    }
+    SetDiskused(size);
+}
+
+bool DiskTable::AddRowKeys(int32_t inner_pos, const ::openmldb::base::Slice& pk, uint64_t time,
+                           const TSDimensions* ts_dimensions, std::vector<RowKey>* keys) {
+    auto inner_index = table_index_.GetInnerIndex(inner_pos);
+    if (!inner_index) {
+        PDLOG(WARNING, "invalid inner index pos %d. tid %u pid %u", inner_pos, id_, pid_);
+        return false;
+    }
+    for (const auto& index_def : inner_index->GetIndex()) {
+        if (!index_def->IsReady()) {
+            continue;
+        }
+        uint64_t ts = time;
+        auto ts_col = index_def->GetTsColumn();
+        if (ts_col) {
+            if (ts_dimensions == NULL) {
+                PDLOG(WARNING, "has set col. tid %u pid %u", id_, pid_);
+                return false;
+            }
+            bool has_found_ts = false;
+            for (const auto& ts_dimension : *ts_dimensions) {
+                if (static_cast<int>(ts_dimension.idx()) == ts_col->GetTsIdx()) {
+                    ts = ts_dimension.ts();
+                    has_found_ts = true;
+                    break;
+                }
+            }
+            if (!has_found_ts) {
+                DEBUGLOG("cannot find ts col %d. tid %u pid %u", ts_col->GetTsIdx(), id_, pid_);
+                continue;
+            }
+        }
+        keys->push_back(RowKey{index_def->GetId(), pk, ts});
+    }
+    return true;
+}
+
+bool DiskTable::Write(const std::vector<RowKey>& keys, uint8_t type, const ::openmldb::base::Slice& value) {
+    if (keys.empty()) {
+        return true;
+    }
+    bool need_flush = false;
+    bool need_wait = false;
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        auto version = GetVersion();
+        for (const auto& row_key : keys) {
+            uint64_t seq = ++seq_;
+            std::string key = EncodePrefix(row_key.index_id, row_key.pk);
+            AppendInverted64(&key, row_key.time);
+            AppendInverted64(&key, seq);
+            version->mem->Put(key, type, value, seq);
+        }
+        if (version->mem->GetByteSize() >= (static_cast<uint64_t>(FLAGS_write_buffer_mb) << 20)) {
+            auto new_version = std::make_shared<DiskVersion>(*version);
+            new_version->imms.push_back(version->mem);
+            new_version->mem = std::make_shared<WriteBuffer>();
+            need_wait = new_version->imms.size() >= MAX_IMM_NUM;
+            SetVersion(new_version);
+            need_flush = true;
+        }
+    }
+    if (need_flush) {
+        FlushImms(need_wait);
+    }
+    return true;
+}
+
+bool DiskTable::Put(const std::string& pk, uint64_t time, const char* data, uint32_t size) {
+    std::vector<RowKey> keys;
+    if (!AddRowKeys(0, pk, time, NULL, &keys) || keys.empty()) {
+        return false;
+    }
+    Write(keys, TYPE_VALUE, ::openmldb::base::Slice(data, size));
+    record_cnt_.fetch_add(1, std::memory_order_relaxed);
+    IncrKeyVersion(pk.data(), pk.size());
+    return true;
+}
+
+bool DiskTable::Put(const ::openmldb::base::Slice& pk, uint64_t time, const ::openmldb::base::Slice& value,
+                    uint32_t index_id) {
+    Write(std::vector<RowKey>{RowKey{index_id, pk, time}}, TYPE_VALUE, value);
+    if (index_id == count_index_id_) {
+        record_cnt_.fetch_add(1, std::memory_order_relaxed);
+    }
+    IncrKeyVersion(pk.data(), pk.size());
+    return true;
+}
+
+bool DiskTable::Contains(uint32_t index_id, const ::openmldb::base::Slice& pk, uint64_t time,
+                         const ::openmldb::base::Slice& data) {
+    auto version = GetVersion();
+    std::unique_ptr<SortedIterator> it(version->NewIterator());
+    DiskRowCursor cursor(it.get());
+    for (cursor.Seek(EncodePrefix(index_id, pk), time); cursor.Valid() && cursor.GetTime() == time; cursor.Next()) {
+        if (cursor.GetValue().compare(data) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool DiskTable::Put(uint64_t time, const std::string& value, const Dimensions& dimensions) {
+    std::map<int32_t, ::openmldb::base::Slice> inner_index_key_map;
+    for (auto iter = dimensions.begin(); iter != dimensions.end(); iter++) {
+        int32_t inner_pos = table_index_.GetInnerIndexPos(iter->idx());
+        if (inner_pos < 0) {
+            PDLOG(WARNING, "invalid dimesion. dimesion idx %u, tid %u pid %u", iter->idx(), id_, pid_);
+            return false;
+        }
+        inner_index_key_map.emplace(inner_pos, iter->key());
+    }
+    std::vector<RowKey> keys;
+    for (const auto& kv : inner_index_key_map) {
+        if (!AddRowKeys(kv.first, kv.second, time, NULL, &keys)) {
+            return false;
+        }
+    }
+    Write(keys, TYPE_VALUE, value);
+    record_cnt_.fetch_add(1, std::memory_order_relaxed);
+    for (const auto& kv : inner_index_key_map) {
+        IncrKeyVersion(kv.second.data(), kv.second.size());
+    }
+    return true;
+}
+
+bool DiskTable::Put(const Dimensions& dimensions, const TSDimensions& ts_dimensions, const std::string& value) {
+    if (dimensions.empty() || ts_dimensions.empty()) {
+        PDLOG(WARNING, "empty dimension. tid %u pid %u", id_, pid_);
+        return false;
+    }
+    std::map<int32_t, ::openmldb::base::Slice> inner_index_key_map;
+    for (auto iter = dimensions.begin(); iter != dimensions.end(); iter++) {
+        int32_t inner_pos = table_index_.GetInnerIndexPos(iter->idx());
+        if (inner_pos < 0) {
+            PDLOG(WARNING, "invalid dimension. dimension idx %u, tid %u pid %u", iter->idx(), id_, pid_);
+            return false;
+        }
+        inner_index_key_map.emplace(inner_pos, iter->key());
+    }
+    std::vector<RowKey> keys;
+    for (const auto& kv : inner_index_key_map) {
+        if (!AddRowKeys(kv.first, kv.second, ts_dimensions.Get(0).ts(), &ts_dimensions, &keys)) {
+            return false;
+        }
+    }
+    Write(keys, TYPE_VALUE, value);
+    record_cnt_.fetch_add(1, std::memory_order_relaxed);
+    for (const auto& kv : inner_index_key_map) {
+        IncrKeyVersion(kv.second.data(), kv.second.size());
+    }
+    return true;
+}
+
+bool DiskTable::Delete(const std::string& pk, uint32_t idx) {
+    std::shared_ptr<IndexDef> index_def = GetIndex(idx);
+    if (!index_def || !index_def->IsReady()) {
+        return false;
+    }
+    std::vector<RowKey> keys;
+    auto inner_index = table_index_.GetInnerIndex(index_def->GetInnerPos());
+    for (const auto& cur_index : inner_index->GetIndex()) {
+        keys.push_back(RowKey{cur_index->GetId(), pk, UINT64_MAX});
+    }
+    bool ok = Write(keys, TYPE_DELETION, ::openmldb::base::Slice());
+    IncrKeyVersion(pk.data(), pk.size());
+    return ok;
+}
+
+TableIterator* DiskTable::NewIterator(const std::string& pk, Ticket& ticket) { return NewIterator(0, pk, ticket); }
+
+TableIterator* DiskTable::NewIterator(uint32_t index, const std::string& pk, Ticket& ticket) {
+    std::shared_ptr<IndexDef> index_def = table_index_.GetIndex(index);
+    if (!index_def || !index_def->IsReady()) {
+        PDLOG(WARNING, "index %d not found in table, tid %u pid %u", index, id_, pid_);
+        return NULL;
+    }
+    return new DiskTableIterator(GetVersion(), EncodePrefix(index_def->GetId(), pk));
+}
+
+TableIterator* DiskTable::NewTraverseIterator(uint32_t index) {
+    std::shared_ptr<IndexDef> index_def = GetIndex(index);
+    if (!index_def || !index_def->IsReady()) {
+        PDLOG(WARNING, "index %u not found. tid %u pid %u", index, id_, pid_);
+        return NULL;
+    }
+    auto ttl = index_def->GetTTL();
+    return new DiskTableTraverseIterator(GetVersion(), index_def->GetId(), ttl->ttl_type, GetExpireTime(*ttl),
+                                         ttl->lat_ttl);
+}
+
+::hybridse::vm::WindowIterator* DiskTable::NewWindowIterator(uint32_t index) {
+    std::shared_ptr<IndexDef> index_def = GetIndex(index);
+    if (!index_def || !index_def->IsReady()) {
+        PDLOG(WARNING, "index %u not found. tid %u pid %u", index, id_, pid_);
+        return NULL;
+    }
+    auto ttl = index_def->GetTTL();
+    return new DiskTableKeyIterator(GetVersion(), index_def->GetId(), ttl->ttl_type, GetExpireTime(*ttl),
+                                    ttl->lat_ttl);
+}
+
+int DiskTable::GetCount(uint32_t index, const std::string& pk, uint64_t* count) {
+    std::shared_ptr<IndexDef> index_def = GetIndex(index);
+    if (!index_def || !index_def->IsReady()) {
+        return -1;
+    }
+    auto version = GetVersion();
+    std::unique_ptr<SortedIterator> it(version->NewIterator());
+    DiskRowCursor cursor(it.get());
+    uint64_t cnt = 0;
+    for (cursor.SeekToFirst(EncodePrefix(index_def->GetId(), pk)); cursor.Valid(); cursor.Next()) {
+        cnt++;
+    }
+    *count = cnt;
+    return 0;
+}
+
+::hybridse::vm::RowIterator* DiskTable::NewRowIterator(uint32_t index, const std::string& pk) {
+    std::shared_ptr<IndexDef> index_def = GetIndex(index);
+    if (!index_def || !index_def->IsReady()) {
+        return NULL;
+    }
+    auto it = new DiskTableWindowIterator(GetVersion(), EncodePrefix(index_def->GetId(), pk),
+                                          index_def->GetTTL()->ttl_type, 0, 0);
+    it->SeekToFirst();
+    return it;
+}
+
+bool DiskTable::Flush() {
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        auto version = GetVersion();
+        if (!version->mem->IsEmpty()) {
+            auto new_version = std::make_shared<DiskVersion>(*version);
+            new_version->imms.push_back(version->mem);
+            new_version->mem = std::make_shared<WriteBuffer>();
+            SetVersion(new_version);
+        }
+    }
+    return FlushImms(true);
+}
+
+static SortedFile::CompressType GetFileCompressType() {
+    if (FLAGS_file_compression == "zlib") {
+        return SortedFile::kZlib;
+    }
+    return SortedFile::kNoCompress;
+}
+
+bool DiskTable::FlushImms(bool wait) {
+    std::unique_lock<std::mutex> flush_lock(flush_mu_, std::defer_lock);
+    if (wait) {
+        flush_lock.lock();
+    } else if (!flush_lock.try_lock()) {
+        return true;
+    }
+    while (true) {
+        auto version = GetVersion();
+        if (version->imms.empty()) {
+            break;
+        }
+        std::shared_ptr<WriteBuffer> imm = version->imms.front();
+        uint64_t consumed = ::baidu::common::timer::get_micros();
+        std::string path = NewFilePath();
+        SortedFile::Builder builder(path + TMP_SUFFIX, GetFileCompressType());
+        if (!builder.Open()) {
+            return false;
+        }
+        SortedFile::Meta meta;
+        meta.max_seq = imm->GetMaxSeq();
+        std::string count_prefix = EncodeIndexPrefix(count_index_id_);
+        std::unique_ptr<SortedIterator> it(imm->NewIterator());
+        for (it->SeekToFirst(); it->Valid(); it->Next()) {
+            ::openmldb::base::Slice key = it->GetKey();
+            if (!builder.Add(key, it->GetValue())) {
+                return false;
+            }
+            uint32_t prefix_size = GetPrefixSize(key);
+            if (prefix_size == 0 || it->GetValue().data()[0] != TYPE_VALUE) {
+                continue;
+            }
+            meta.min_time = std::min(meta.min_time, DecodeInverted64(key.data() + prefix_size));
+            if (key.starts_with(count_prefix)) {
+                meta.record_cnt++;
+            }
+        }
+        if (!builder.Finish(meta) || !::openmldb::base::Rename(path + TMP_SUFFIX, path + FILE_SUFFIX)) {
+            PDLOG(WARNING, "fail to flush write buffer. tid %u pid %u", id_, pid_);
+            return false;
+        }
+        std::shared_ptr<SortedFile> file = SortedFile::Open(path + FILE_SUFFIX);
+        if (!file) {
+            return false;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mu_);
+            auto new_version = std::make_shared<DiskVersion>(*GetVersion());
+            new_version->imms.erase(new_version->imms.begin());
+            new_version->files.push_back(file);
+            SetVersion(new_version);
+        }
+        PDLOG(INFO, "flush write buffer to %s, size %lu consumed %lu ms. tid %u pid %u", file->GetPath().c_str(),
+              file->GetFileSize(), (::baidu::common::timer::get_micros() - consumed) / 1000, id_, pid_);
+    }
+    UpdateDiskused();
+    return true;
+}
+
+bool DiskTable::Compact() {
+    std::lock_guard<std::mutex> flush_lock(flush_mu_);
+    auto version = GetVersion();
+    std::vector<std::shared_ptr<SortedFile>> files = version->files;
+    if (files.empty()) {
+        return true;
+    }
+    uint64_t consumed = ::baidu::common::timer::get_micros();
+    // the ttl of the indexes, the rows of the indexes deleted are dropped
+    std::map<uint32_t, TTLSt> ttl_map;
+    for (const auto& index_def : table_index_.GetAllIndex()) {
+        if (index_def->GetStatus() == IndexStatus::kDeleted) {
+            continue;
+        }
+        auto ttl = index_def->GetTTL();
+        ttl_map.emplace(index_def->GetId(), TTLSt(GetExpireTime(*ttl), ttl->lat_ttl, ttl->ttl_type));
+    }
+    std::vector<SortedIterator*> iters;
+    for (const auto& file : files) {
+        iters.push_back(file->NewIterator());
+    }
+    MergedIterator it(std::move(iters));
+    std::vector<std::shared_ptr<SortedFile>> outputs;
+    std::unique_ptr<SortedFile::Builder> builder;
+    std::string path;
+    SortedFile::Meta meta;
+    auto finish_file = [&]() -> bool {
+        if (!builder) {
+            return true;
+        }
+        if (!builder->Finish(meta) || !::openmldb::base::Rename(path + TMP_SUFFIX, path + FILE_SUFFIX)) {
+            return false;
+        }
+        builder.reset();
+        std::shared_ptr<SortedFile> file = SortedFile::Open(path + FILE_SUFFIX);
+        if (!file) {
+            return false;
+        }
+        outputs.push_back(file);
+        return true;
+    };
+    auto abandon = [&]() {
+        if (builder) {
+            builder->Abandon();
+        }
+        for (auto& file : outputs) {
+            file->MarkObsolete();
+        }
+        PDLOG(WARNING, "fail to compact. tid %u pid %u", id_, pid_);
+        return false;
+    };
+    uint64_t max_seq = 0;
+    for (const auto& file : files) {
+        max_seq = std::max(max_seq, file->GetMeta().max_seq);
+    }
+    std::string count_prefix = EncodeIndexPrefix(count_index_id_);
+    uint64_t file_size = static_cast<uint64_t>(FLAGS_disk_table_file_size_mb) << 20;
+    uint64_t gc_record_cnt = 0;
+    uint64_t drop_cnt = 0;
+    std::string cur_prefix;
+    const TTLSt* ttl = NULL;
+    uint64_t del_seq = 0;
+    uint32_t record_idx = 0;
+    for (it.SeekToFirst(); it.Valid(); it.Next()) {
+        ::openmldb::base::Slice key = it.GetKey();
+        uint32_t prefix_size = GetPrefixSize(key);
+        if (prefix_size == 0) {
+            drop_cnt++;
+            continue;
+        }
+        if (cur_prefix.size() != prefix_size || memcmp(cur_prefix.data(), key.data(), prefix_size) != 0) {
+            cur_prefix.assign(key.data(), prefix_size);
+            uint32_t index_id = 0;
+            memcpy(&index_id, key.data(), sizeof(index_id));
+            auto iter = ttl_map.find(be32toh(index_id));
+            ttl = iter == ttl_map.end() ? NULL : &iter->second;
+            del_seq = 0;
+            record_idx = 0;
+        }
+        uint64_t time = DecodeInverted64(key.data() + prefix_size);
+        uint64_t seq = DecodeInverted64(key.data() + prefix_size + 8);
+        bool is_count = key.starts_with(count_prefix);
+        if (it.GetValue().data()[0] == TYPE_DELETION) {
+            // all the rows written before the tombstone are in the files being compacted
+            del_seq = std::max(del_seq, seq);
+            drop_cnt++;
+            continue;
+        }
+        if (ttl == NULL || seq < del_seq || ttl->IsExpired(time, ++record_idx)) {
+            drop_cnt++;
+            if (is_count) {
+                gc_record_cnt++;
+            }
+            continue;
+        }
+        if (!builder) {
+            path = NewFilePath();
+            builder.reset(new SortedFile::Builder(path + TMP_SUFFIX, GetFileCompressType()));
+            if (!builder->Open()) {
+                builder.reset();
+                return abandon();
+            }
+            meta = SortedFile::Meta();
+            meta.max_seq = max_seq;
+        }
+        if (!builder->Add(key, it.GetValue())) {
+            return abandon();
+        }
+        meta.min_time = std::min(meta.min_time, time);
+        if (is_count) {
+            meta.record_cnt++;
+        }
+        if (builder->GetFileSize() >= file_size && !finish_file()) {
+            return abandon();
+        }
+    }
+    if (!finish_file()) {
+        return abandon();
+    }
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        auto new_version = std::make_shared<DiskVersion>(*GetVersion());
+        new_version->files = outputs;
+        SetVersion(new_version);
+    }
+    for (auto& file : files) {
+        file->MarkObsolete();
+    }
+    record_cnt_.fetch_sub(std::min(gc_record_cnt, record_cnt_.load(std::memory_order_relaxed)),
+                          std::memory_order_relaxed);
+    UpdateDiskused();
+    PDLOG(INFO, "compact %u files into %u files, drop %lu rows, consumed %lu ms. tid %u pid %u", files.size(),
+          outputs.size(), drop_cnt, (::baidu::common::timer::get_micros() - consumed) / 1000, id_, pid_);
+    return true;
+}
+
+void DiskTable::SchedGc() {
+    PDLOG(INFO, "start making gc for disk table %s, tid %u, pid %u", name_.c_str(), id_, pid_);
+    FlushImms(true);
+    Compact();
+    UpdateTTL();
+}
+
+// tll as ms
+uint64_t DiskTable::GetExpireTime(const TTLSt& ttl_st) {
+    if (ttl_st.abs_ttl == 0 || ttl_st.ttl_type == ::openmldb::storage::TTLType::kLatestTime) {
+        return 0;
+    }
+    uint64_t cur_time = ::baidu::common::timer::get_micros() / 1000;
+    return cur_time - ttl_st.abs_ttl;
+}
+
+bool DiskTable::CheckLatest(uint32_t index_id, const std::string& key, uint64_t ts) {
+    Ticket ticket;
+    std::unique_ptr<TableIterator> it(NewIterator(index_id, key, ticket));
+    if (!it) {
+        return false;
+    }
+    it->SeekToLast();
+    return !it->Valid() || ts < it->GetKey();
+}
+
+bool DiskTable::CheckAbsolute(const TTLSt& ttl_st, uint64_t ts) { return ts < GetExpireTime(ttl_st); }
+
+bool DiskTable::IsExpire(const ::openmldb::api::LogEntry& entry) {
+    std::map<uint32_t, uint64_t> ts_dimemsions_map;
+    for (auto iter = entry.ts_dimensions().begin(); iter != entry.ts_dimensions().end(); iter++) {
+        ts_dimemsions_map.insert(std::make_pair(iter->idx(), iter->ts()));
+    }
+    std::map<int32_t, std::string> inner_index_key_map;
+    if (entry.dimensions_size() > 0) {
+        for (auto iter = entry.dimensions().begin(); iter != entry.dimensions().end(); iter++) {
+            int32_t inner_pos = table_index_.GetInnerIndexPos(iter->idx());
+            if (inner_pos >= 0) {
+                inner_index_key_map.emplace(inner_pos, iter->key());
+            }
+        }
+    } else {
+        int32_t inner_pos = table_index_.GetInnerIndexPos(0);
+        if (inner_pos >= 0) {
+            inner_index_key_map.emplace(inner_pos, entry.pk());
+        }
+    }
+    for (const auto& kv : inner_index_key_map) {
+        auto inner_index = table_index_.GetInnerIndex(kv.first);
+        if (!inner_index) {
+            continue;
+        }
+        for (const auto& index_def : inner_index->GetIndex()) {
+            if (!index_def || !index_def->IsReady()) {
+                continue;
+            }
+            auto ttl = index_def->GetTTL();
+            if (!ttl->NeedGc()) {
+                return false;
+            }
+            uint64_t ts = entry.ts();
+            auto ts_col = index_def->GetTsColumn();
+            if (ts_col) {
+                auto iter = ts_dimemsions_map.find(ts_col->GetTsIdx());
+                if (iter == ts_dimemsions_map.end()) {
+                    continue;
+                }
+                ts = iter->second;
+            }
+            bool is_expire = false;
+            uint32_t index_id = index_def->GetId();
+            switch (index_def->GetTTLType()) {
+                case ::openmldb::storage::TTLType::kLatestTime:
+                    is_expire = CheckLatest(index_id, kv.second, ts);
+                    break;
+                case ::openmldb::storage::TTLType::kAbsoluteTime:
+                    is_expire = CheckAbsolute(*ttl, ts);
+                    break;
+                case ::openmldb::storage::TTLType::kAbsOrLat:
+                    is_expire = CheckAbsolute(*ttl, ts) || CheckLatest(index_id, kv.second, ts);
+                    break;
+                case ::openmldb::storage::TTLType::kAbsAndLat:
+                    is_expire = CheckAbsolute(*ttl, ts) && CheckLatest(index_id, kv.second, ts);
+                    break;
+                default:
+                    return true;
+            }
+            if (!is_expire) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+}  // namespace storage
+}  // namespace openmldb
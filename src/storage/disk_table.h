@@ -0,0 +1,326 @@
+/*
+ * Copyright 2021 4Paradigm
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SRC_STORAGE_DISK_TABLE_H_
+#define SRC_STORAGE_DISK_TABLE_H_
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <string>
+#include <vector>
+
+#include "base/skiplist.h"
+#include "base/slice.h"
+#include "proto/tablet.pb.h"
+#include "storage/iterator.h"
+#include "storage/schema.h"
+#include "storage/sorted_file.h"
+#include "storage/table.h"
+#include "storage/ticket.h"
+#include "vm/catalog.h"
+
+namespace openmldb {
+namespace storage {
+
+struct DiskKeyComparator {
+    int operator()(const ::openmldb::base::Slice& a, const ::openmldb::base::Slice& b) const { return a.compare(b); }
+};
+
+// WriteBuffer keeps the latest writes of a disk table in memory until they are flushed into a sorted file.
+// The puts need external synchronization, the readers don't lock
+class WriteBuffer {
+ public:
+    WriteBuffer();
+    ~WriteBuffer();
+    WriteBuffer(const WriteBuffer&) = delete;
+    WriteBuffer& operator=(const WriteBuffer&) = delete;
+
+    void Put(const ::openmldb::base::Slice& key, uint8_t type, const ::openmldb::base::Slice& value, uint64_t seq);
+
+    SortedIterator* NewIterator();
+
+    uint64_t GetByteSize() const { return byte_size_.load(std::memory_order_relaxed); }
+    uint64_t GetMaxSeq() const { return max_seq_.load(std::memory_order_relaxed); }
+    bool IsEmpty() { return list_.IsEmpty(); }
+
+ private:
+    class Iterator;
+
+    ::openmldb::base::Skiplist<::openmldb::base::Slice, ::openmldb::base::Slice, DiskKeyComparator> list_;
+    std::atomic<uint64_t> byte_size_;
+    std::atomic<uint64_t> max_seq_;
+};
+
+// DiskVersion is a snapshot of the write buffers and the sorted files of a disk table. The iterators hold the
+// version they read, so the buffers flushed and the files compacted meanwhile are kept until they leave
+struct DiskVersion {
+    std::shared_ptr<WriteBuffer> mem;
+    // the write buffers being flushed, the oldest is the first
+    std::vector<std::shared_ptr<WriteBuffer>> imms;
+    std::vector<std::shared_ptr<SortedFile>> files;
+
+    SortedIterator* NewIterator() const;
+};
+
+// DiskRowCursor walks the rows of one key of an index on a sorted iterator in the desc order of time. The
+// tombstones of the key and the rows written before them are skipped
+class DiskRowCursor {
+ public:
+    explicit DiskRowCursor(SortedIterator* it) : it_(it), prefix_(), del_seq_(0), time_(0), valid_(false) {}
+
+    // the newest row of the key which is encoded as prefix
+    void SeekToFirst(const std::string& prefix);
+    // the first row whose time is not greater than time
+    void Seek(const std::string& prefix, uint64_t time);
+    void Next();
+
+    bool Valid() const { return valid_; }
+    const uint64_t& GetTime() const { return time_; }
+    // the value refers to the block of the sorted iterator, it's valid until the cursor moves
+    ::openmldb::base::Slice GetValue() const;
+    // a copy of the value which is owned by the returned slice
+    ::openmldb::base::Slice CopyValue() const;
+    const std::string& GetPrefix() const { return prefix_; }
+    std::string GetPK() const;
+
+ private:
+    void ReadTombstone(const std::string& prefix);
+    void Skip();
+
+    SortedIterator* it_;
+    std::string prefix_;
+    uint64_t del_seq_;
+    uint64_t time_;
+    bool valid_;
+};
+
+class DiskTableIterator : public TableIterator {
+ public:
+    DiskTableIterator(const std::shared_ptr<DiskVersion>& version, const std::string& prefix);
+    ~DiskTableIterator() override {}
+    bool Valid() override { return cursor_.Valid(); }
+    void Next() override { cursor_.Next(); }
+    // the callers keep the values across Next, so they get a copy
+    ::openmldb::base::Slice GetValue() const override { return cursor_.CopyValue(); }
+    std::string GetPK() const override { return cursor_.GetPK(); }
+    uint64_t GetKey() const override { return cursor_.GetTime(); }
+    void SeekToFirst() override { cursor_.SeekToFirst(prefix_); }
+    void SeekToLast() override;
+    void Seek(uint64_t time) override { cursor_.Seek(prefix_, time); }
+
+ private:
+    std::shared_ptr<DiskVersion> version_;
+    std::unique_ptr<SortedIterator> it_;
+    std::string prefix_;
+    DiskRowCursor cursor_;
+};
+
+class DiskTableWindowIterator : public ::hybridse::vm::RowIterator {
+ public:
+    DiskTableWindowIterator(const std::shared_ptr<DiskVersion>& version, const std::string& prefix,
+                            ::openmldb::storage::TTLType ttl_type, uint64_t expire_time, uint64_t expire_cnt);
+    ~DiskTableWindowIterator() override {}
+
+    bool Valid() const override {
+        return cursor_.Valid() && !expire_value_.IsExpired(cursor_.GetTime(), record_idx_);
+    }
+    void Next() override {
+        cursor_.Next();
+        record_idx_++;
+    }
+    const uint64_t& GetKey() const override { return cursor_.GetTime(); }
+    // the row is copied, the data of the files may be gone after the iterator moves
+    const ::hybridse::codec::Row& GetValue() override;
+    void Seek(const uint64_t& key) override { cursor_.Seek(prefix_, key); }
+    void SeekToFirst() override {
+        cursor_.SeekToFirst(prefix_);
+        record_idx_ = 0;
+    }
+    bool IsSeekable() const override { return true; }
+
+ private:
+    std::shared_ptr<DiskVersion> version_;
+    std::unique_ptr<SortedIterator> it_;
+    std::string prefix_;
+    DiskRowCursor cursor_;
+    uint32_t record_idx_;
+    TTLSt expire_value_;
+    ::hybridse::codec::Row row_;
+};
+
+class DiskTableKeyIterator : public ::hybridse::vm::WindowIterator {
+ public:
+    DiskTableKeyIterator(const std::shared_ptr<DiskVersion>& version, uint32_t index_id,
+                         ::openmldb::storage::TTLType ttl_type, uint64_t expire_time, uint64_t expire_cnt);
+    ~DiskTableKeyIterator() override {}
+
+    void Seek(const std::string& key) override;
+    void SeekToFirst() override;
+    void Next() override;
+    bool Valid() override { return valid_; }
+    std::unique_ptr<::hybridse::vm::RowIterator> GetValue() override;
+    ::hybridse::vm::RowIterator* GetRawValue() override;
+    const hybridse::codec::Row GetKey() override;
+
+ private:
+    // move to the first key from the current position which has rows
+    void SeekKey();
+
+    std::shared_ptr<DiskVersion> version_;
+    std::unique_ptr<SortedIterator> it_;
+    DiskRowCursor cursor_;
+    std::string index_prefix_;
+    ::openmldb::storage::TTLType ttl_type_;
+    uint64_t expire_time_;
+    uint64_t expire_cnt_;
+    bool valid_;
+};
+
+class DiskTableTraverseIterator : public TableIterator {
+ public:
+    DiskTableTraverseIterator(const std::shared_ptr<DiskVersion>& version, uint32_t index_id,
+                              ::openmldb::storage::TTLType ttl_type, uint64_t expire_time, uint64_t expire_cnt);
+    ~DiskTableTraverseIterator() override {}
+    bool Valid() override;
+    void Next() override;
+    void Seek(const std::string& key, uint64_t time) override;
+    ::openmldb::base::Slice GetValue() const override { return cursor_.CopyValue(); }
+    std::string GetPK() const override { return cursor_.GetPK(); }
+    uint64_t GetKey() const override;
+    void SeekToFirst() override;
+    uint64_t GetCount() const override { return traverse_cnt_; }
+
+ private:
+    // move to the first key from the current position which has unexpired rows
+    void SeekKey();
+
+    std::shared_ptr<DiskVersion> version_;
+    std::unique_ptr<SortedIterator> it_;
+    DiskRowCursor cursor_;
+    std::string index_prefix_;
+    uint32_t record_idx_;
+    TTLSt expire_value_;
+    uint64_t traverse_cnt_;
+    bool valid_;
+};
+
+// DiskTable keeps the rows on the disk in a log structured merge store. A row is written into each index as a
+// key of (index id, pk, time desc, seq desc), the writes go to a write buffer in memory first and the full buffers
+// are flushed into the sorted files, which are merged and filtered by the ttl of the indexes when gc runs.
+// The write buffers are not logged, the rows are recovered from the binlog like a memtable. The sorted files are
+// under db_path
+class DiskTable : public Table {
+ public:
+    DiskTable(const ::openmldb::api::TableMeta& table_meta, const std::string& db_path);
+    ~DiskTable() override;
+    DiskTable(const DiskTable&) = delete;
+    DiskTable& operator=(const DiskTable&) = delete;
+
+    bool Init() override;
+
+    bool Put(const std::string& pk, uint64_t time, const char* data, uint32_t size) override;
+
+    bool Put(uint64_t time, const std::string& value, const Dimensions& dimensions) override;
+
+    bool Put(const Dimensions& dimensions, const TSDimensions& ts_dimensions, const std::string& value) override;
+
+    // put a row into the index of index_id only, it's used to move the rows of a memtable into its disk tier. The row
+    // is counted if the records are counted by the index
+    bool Put(const ::openmldb::base::Slice& pk, uint64_t time, const ::openmldb::base::Slice& value, uint32_t index_id);
+
+    // whether the index of index_id has a row of pk with time and the value data
+    bool Contains(uint32_t index_id, const ::openmldb::base::Slice& pk, uint64_t time,
+                  const ::openmldb::base::Slice& data);
+
+    // delete the rows of pk in the inner index of idx
+    bool Delete(const std::string& pk, uint32_t idx) override;
+
+    // the rows of pk in the index, the expired ones which are not compacted yet are counted too
+    int GetCount(uint32_t index, const std::string& pk, uint64_t* count);
+
+    TableIterator* NewIterator(const std::string& pk, Ticket& ticket) override;  // NOLINT
+
+    TableIterator* NewIterator(uint32_t index, const std::string& pk, Ticket& ticket) override;  // NOLINT
+
+    TableIterator* NewTraverseIterator(uint32_t index) override;
+
+    ::hybridse::vm::WindowIterator* NewWindowIterator(uint32_t index) override;
+
+    // the rows of pk in the index with no ttl applied, the caller filters the expired ones
+    ::hybridse::vm::RowIterator* NewRowIterator(uint32_t index, const std::string& pk);
+
+    // flush the write buffers and merge the sorted files, the expired rows and the deleted ones are dropped
+    void SchedGc() override;
+
+    uint64_t GetRecordCnt() const override { return record_cnt_.load(std::memory_order_relaxed); }
+
+    bool IsExpire(const ::openmldb::api::LogEntry& entry) override;
+
+    uint64_t GetExpireTime(const TTLSt& ttl_st) override;
+
+    // flush the write buffer into a sorted file
+    bool Flush();
+
+    // merge the sorted files into the files of disk_table_file_size_mb, the ttl of the indexes is applied
+    bool Compact();
+
+    uint32_t GetFileCnt() { return GetVersion()->files.size(); }
+
+ private:
+    struct RowKey {
+        uint32_t index_id;
+        ::openmldb::base::Slice pk;
+        uint64_t time;
+    };
+
+    std::shared_ptr<DiskVersion> GetVersion() const {
+        return std::atomic_load_explicit(&version_, std::memory_order_acquire);
+    }
+    void SetVersion(const std::shared_ptr<DiskVersion>& version) {
+        std::atomic_store_explicit(&version_, version, std::memory_order_release);
+    }
+
+    bool Write(const std::vector<RowKey>& keys, uint8_t type, const ::openmldb::base::Slice& value);
+    // add the rows of the ready indexes of an inner index to keys
+    bool AddRowKeys(int32_t inner_pos, const ::openmldb::base::Slice& pk, uint64_t time,
+                    const TSDimensions* ts_dimensions, std::vector<RowKey>* keys);
+    // flush the write buffers waiting, it returns at once if another flush is running and wait is false
+    bool FlushImms(bool wait);
+    std::string NewFilePath();
+    void UpdateDiskused();
+
+    bool CheckLatest(uint32_t index_id, const std::string& key, uint64_t ts);
+    bool CheckAbsolute(const TTLSt& ttl, uint64_t ts);
+
+    const std::string db_path_;
+    std::shared_ptr<DiskVersion> version_;
+    // it guards the writes to the active write buffer and the changes of the version
+    std::mutex mu_;
+    // it serializes the flushes and the compactions
+    std::mutex flush_mu_;
+    uint64_t seq_;
+    std::atomic<uint64_t> file_no_;
+    std::atomic<uint64_t> record_cnt_;
+    // the records are counted by the rows of this index
+    uint32_t count_index_id_;
+};
+
+}  // namespace storage
+}  // namespace openmldb
+
+#endif  // SRC_STORAGE_DISK_TABLE_H_
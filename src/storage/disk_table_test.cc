@@ -0,0 +1,332 @@
+/*
+ * Copyright 2021 4Paradigm
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "storage/disk_table.h"
+
+#include <gflags/gflags.h>
+
+#include <memory>
+#include <string>
+
+#include "base/file_util.h"
+#include "base/glog_wapper.h"
+#include "codec/schema_codec.h"
+#include "common/timer.h"
+#include "gtest/gtest.h"
+
+DECLARE_uint32(max_traverse_cnt);
+DECLARE_uint32(write_buffer_mb);
+DECLARE_string(file_compression);
+
+namespace openmldb {
+namespace storage {
+
+using ::openmldb::codec::SchemaCodec;
+
+inline std::string GenRand() { return std::to_string(rand() % 10000000 + 1); }  // NOLINT
+
+class DiskTableTest : public ::testing::Test {
+ public:
+    DiskTableTest() : path_("/tmp/disk_table_test/" + GenRand()) {}
+    ~DiskTableTest() { ::openmldb::base::RemoveDirRecursive(path_); }
+
+ protected:
+    std::string path_;
+};
+
+static ::openmldb::api::TableMeta GetTableMeta(::openmldb::type::TTLType ttl_type, uint64_t abs_ttl,
+                                               uint64_t lat_ttl) {
+    ::openmldb::api::TableMeta table_meta;
+    table_meta.set_name("table1");
+    table_meta.set_tid(1);
+    table_meta.set_pid(0);
+    SchemaCodec::SetColumnDesc(table_meta.add_column_desc(), "card", ::openmldb::type::kString);
+    SchemaCodec::SetColumnDesc(table_meta.add_column_desc(), "mcc", ::openmldb::type::kString);
+    SchemaCodec::SetColumnDesc(table_meta.add_column_desc(), "ts1", ::openmldb::type::kBigInt);
+    SchemaCodec::SetColumnDesc(table_meta.add_column_desc(), "ts2", ::openmldb::type::kBigInt);
+    SchemaCodec::SetIndex(table_meta.add_column_key(), "card", "card", "ts1", ttl_type, abs_ttl, lat_ttl);
+    SchemaCodec::SetIndex(table_meta.add_column_key(), "card1", "card", "ts2", ttl_type, abs_ttl, lat_ttl);
+    SchemaCodec::SetIndex(table_meta.add_column_key(), "mcc", "mcc", "ts1", ttl_type, abs_ttl, lat_ttl);
+    return table_meta;
+}
+
+static void PutRow(DiskTable* table, const std::string& card, const std::string& mcc, uint64_t ts1, uint64_t ts2,
+                   const std::string& value) {
+    ::openmldb::api::PutRequest request;
+    ::openmldb::api::Dimension* dim = request.add_dimensions();
+    dim->set_idx(0);
+    dim->set_key(card);
+    dim = request.add_dimensions();
+    dim->set_idx(1);
+    dim->set_key(card);
+    dim = request.add_dimensions();
+    dim->set_idx(2);
+    dim->set_key(mcc);
+    ::openmldb::api::TSDimension* ts = request.add_ts_dimensions();
+    ts->set_idx(0);
+    ts->set_ts(ts1);
+    ts = request.add_ts_dimensions();
+    ts->set_idx(1);
+    ts->set_ts(ts2);
+    ASSERT_TRUE(table->Put(request.dimensions(), request.ts_dimensions(), value));
+}
+
+static int CountRows(Table* table, uint32_t index, const std::string& pk) {
+    Ticket ticket;
+    std::unique_ptr<TableIterator> it(table->NewIterator(index, pk, ticket));
+    int count = 0;
+    uint64_t last = UINT64_MAX;
+    for (it->SeekToFirst(); it->Valid(); it->Next()) {
+        EXPECT_LE(it->GetKey(), last);
+        last = it->GetKey();
+        count++;
+    }
+    return count;
+}
+
+static int Traverse(Table* table, uint32_t index) {
+    std::unique_ptr<TableIterator> it(table->NewTraverseIterator(index));
+    int count = 0;
+    for (it->SeekToFirst(); it->Valid(); it->Next()) {
+        count++;
+    }
+    return count;
+}
+
+TEST_F(DiskTableTest, PutAndIterator) {
+    DiskTable table(GetTableMeta(::openmldb::type::kAbsoluteTime, 0, 0), path_);
+    ASSERT_TRUE(table.Init());
+    for (int i = 0; i < 1000; i++) {
+        PutRow(&table, "card" + std::to_string(i % 100), "mcc" + std::to_string(i), 1000 + i, 10000 + i,
+               "value" + std::to_string(i));
+        if (i == 500) {
+            // the rows are read from both the files and the write buffer
+            ASSERT_TRUE(table.Flush());
+        }
+    }
+    ASSERT_EQ(1000u, table.GetRecordCnt());
+    ASSERT_EQ(1u, table.GetFileCnt());
+    ASSERT_EQ(10, CountRows(&table, 0, "card5"));
+    ASSERT_EQ(10, CountRows(&table, 1, "card5"));
+    ASSERT_EQ(1, CountRows(&table, 2, "mcc10"));
+    ASSERT_EQ(0, CountRows(&table, 0, "card100"));
+    ASSERT_EQ(1000, Traverse(&table, 0));
+    ASSERT_EQ(1000, Traverse(&table, 2));
+    Ticket ticket;
+    ASSERT_EQ(NULL, table.NewIterator(3, "mcc10", ticket));
+
+    std::unique_ptr<TableIterator> it(table.NewIterator(0, "card5", ticket));
+    it->Seek(1555);
+    ASSERT_TRUE(it->Valid());
+    ASSERT_EQ(1505u, it->GetKey());
+    ASSERT_EQ("value505", it->GetValue().ToString());
+    it->SeekToLast();
+    ASSERT_TRUE(it->Valid());
+    ASSERT_EQ(1005u, it->GetKey());
+    it.reset(table.NewIterator(1, "card5", ticket));
+    it->SeekToFirst();
+    ASSERT_TRUE(it->Valid());
+    ASSERT_EQ(10905u, it->GetKey());
+
+    ASSERT_TRUE(table.Flush());
+    ASSERT_TRUE(table.Compact());
+    ASSERT_EQ(1u, table.GetFileCnt());
+    ASSERT_EQ(1000, Traverse(&table, 1));
+    ASSERT_EQ(10, CountRows(&table, 0, "card99"));
+}
+
+TEST_F(DiskTableTest, Recover) {
+    FLAGS_file_compression = "zlib";
+    {
+        DiskTable table(GetTableMeta(::openmldb::type::kAbsoluteTime, 0, 0), path_);
+        ASSERT_TRUE(table.Init());
+        for (int i = 0; i < 1000; i++) {
+            PutRow(&table, "card" + std::to_string(i % 10), "mcc" + std::to_string(i), 1000 + i, 10000 + i,
+                   std::string(100, 'a' + i % 26));
+        }
+        ASSERT_TRUE(table.Flush());
+    }
+    FLAGS_file_compression = "off";
+    DiskTable table(GetTableMeta(::openmldb::type::kAbsoluteTime, 0, 0), path_);
+    ASSERT_TRUE(table.Init());
+    ASSERT_EQ(1000u, table.GetRecordCnt());
+    ASSERT_GT(table.GetDiskused(), 0u);
+    ASSERT_LT(table.GetDiskused(), 100u * 1000);
+    Ticket ticket;
+    std::unique_ptr<TableIterator> it(table.NewIterator(0, "card3", ticket));
+    int count = 0;
+    for (it->SeekToFirst(); it->Valid(); it->Next()) {
+        uint64_t i = it->GetKey() - 1000;
+        ASSERT_EQ(std::string(100, 'a' + i % 26), it->GetValue().ToString());
+        count++;
+    }
+    ASSERT_EQ(100, count);
+    // the new rows are after the ones recovered
+    PutRow(&table, "card3", "mcc", 5000, 5000, "new");
+    it.reset(table.NewIterator(0, "card3", ticket));
+    it->SeekToFirst();
+    ASSERT_EQ("new", it->GetValue().ToString());
+}
+
+TEST_F(DiskTableTest, Delete) {
+    DiskTable table(GetTableMeta(::openmldb::type::kAbsoluteTime, 0, 0), path_);
+    ASSERT_TRUE(table.Init());
+    for (int i = 0; i < 10; i++) {
+        PutRow(&table, "card0", "mcc" + std::to_string(i), 1000 + i, 1000 + i, "value");
+    }
+    PutRow(&table, "card1", "mcc", 1000, 1000, "value");
+    ASSERT_TRUE(table.Flush());
+    ASSERT_TRUE(table.Delete("card0", 0));
+    ASSERT_EQ(0, CountRows(&table, 0, "card0"));
+    ASSERT_EQ(0, CountRows(&table, 1, "card0"));
+    ASSERT_EQ(1, CountRows(&table, 2, "mcc5"));
+    ASSERT_EQ(1, Traverse(&table, 0));
+    PutRow(&table, "card0", "mcc", 900, 900, "value");
+    ASSERT_EQ(1, CountRows(&table, 0, "card0"));
+    ASSERT_TRUE(table.Flush());
+    ASSERT_TRUE(table.Compact());
+    ASSERT_EQ(1, CountRows(&table, 0, "card0"));
+    ASSERT_EQ(2, Traverse(&table, 0));
+    ASSERT_EQ(2u, table.GetRecordCnt());
+}
+
+TEST_F(DiskTableTest, GcAbsolute) {
+    DiskTable table(GetTableMeta(::openmldb::type::kAbsoluteTime, 10, 0), path_);
+    ASSERT_TRUE(table.Init());
+    uint64_t now = ::baidu::common::timer::get_micros() / 1000;
+    for (int i = 0; i < 100; i++) {
+        uint64_t ts = i % 2 == 0 ? now - 20 * 60 * 1000 - i : now - i;
+        PutRow(&table, "card" + std::to_string(i % 10), "mcc" + std::to_string(i), ts, ts, "value");
+    }
+    ASSERT_TRUE(table.Flush());
+    // the expired rows are hidden before gc
+    ASSERT_EQ(50, Traverse(&table, 0));
+    ::hybridse::vm::WindowIterator* window = table.NewWindowIterator(0);
+    ASSERT_TRUE(window != NULL);
+    window->Seek("card1");
+    ASSERT_TRUE(window->Valid());
+    std::unique_ptr<::hybridse::vm::RowIterator> rows = window->GetValue();
+    int count = 0;
+    for (rows->SeekToFirst(); rows->Valid(); rows->Next()) {
+        count++;
+    }
+    ASSERT_EQ(10, count);
+    delete window;
+    table.SchedGc();
+    ASSERT_EQ(50u, table.GetRecordCnt());
+    ASSERT_EQ(10, CountRows(&table, 0, "card1"));
+    ASSERT_EQ(0, CountRows(&table, 0, "card0"));
+    ASSERT_EQ(50, Traverse(&table, 2));
+    ::openmldb::api::LogEntry entry;
+    ::openmldb::api::Dimension* dim = entry.add_dimensions();
+    dim->set_idx(0);
+    dim->set_key("card1");
+    ::openmldb::api::TSDimension* ts1 = entry.add_ts_dimensions();
+    ts1->set_idx(0);
+    ::openmldb::api::TSDimension* ts2 = entry.add_ts_dimensions();
+    ts2->set_idx(1);
+    ts1->set_ts(now - 30 * 60 * 1000);
+    ts2->set_ts(now - 30 * 60 * 1000);
+    ASSERT_TRUE(table.IsExpire(entry));
+    ts1->set_ts(now);
+    ASSERT_FALSE(table.IsExpire(entry));
+}
+
+TEST_F(DiskTableTest, GcLatest) {
+    DiskTable table(GetTableMeta(::openmldb::type::kLatestTime, 0, 3), path_);
+    ASSERT_TRUE(table.Init());
+    for (int i = 0; i < 10; i++) {
+        PutRow(&table, "card0", "mcc" + std::to_string(i), 1000 + i, 1000 + i, "value" + std::to_string(i));
+        if (i % 3 == 0) {
+            ASSERT_TRUE(table.Flush());
+        }
+    }
+    ASSERT_EQ(3, Traverse(&table, 0));
+    table.SchedGc();
+    ASSERT_EQ(3, CountRows(&table, 0, "card0"));
+    ASSERT_EQ(1, CountRows(&table, 2, "mcc0"));
+    ASSERT_EQ(3u, table.GetRecordCnt());
+    Ticket ticket;
+    std::unique_ptr<TableIterator> it(table.NewIterator(0, "card0", ticket));
+    it->SeekToFirst();
+    ASSERT_EQ("value9", it->GetValue().ToString());
+}
+
+TEST_F(DiskTableTest, WindowIterator) {
+    DiskTable table(GetTableMeta(::openmldb::type::kAbsoluteTime, 0, 0), path_);
+    ASSERT_TRUE(table.Init());
+    for (int i = 0; i < 100; i++) {
+        PutRow(&table, "card" + std::to_string(i % 10), "mcc" + std::to_string(i), 1000 + i, 1000 + i,
+               "value" + std::to_string(i));
+        if (i == 50) {
+            ASSERT_TRUE(table.Flush());
+        }
+    }
+    std::unique_ptr<::hybridse::vm::WindowIterator> window(table.NewWindowIterator(0));
+    int key_cnt = 0;
+    for (window->SeekToFirst(); window->Valid(); window->Next()) {
+        std::string pk(reinterpret_cast<const char*>(window->GetKey().buf()), window->GetKey().size());
+        std::unique_ptr<::hybridse::vm::RowIterator> rows = window->GetValue();
+        int count = 0;
+        for (; rows->Valid(); rows->Next()) {
+            uint64_t i = rows->GetKey() - 1000;
+            ASSERT_EQ("card" + std::to_string(i % 10), pk);
+            const ::hybridse::codec::Row& row = rows->GetValue();
+            ASSERT_EQ("value" + std::to_string(i), std::string(reinterpret_cast<const char*>(row.buf()), row.size()));
+            count++;
+        }
+        ASSERT_EQ(10, count);
+        key_cnt++;
+    }
+    ASSERT_EQ(10, key_cnt);
+    window->Seek("card3");
+    ASSERT_TRUE(window->Valid());
+    std::unique_ptr<::hybridse::vm::RowIterator> rows = window->GetValue();
+    rows->Seek(1050);
+    ASSERT_TRUE(rows->Valid());
+    ASSERT_EQ(1043u, rows->GetKey());
+}
+
+TEST_F(DiskTableTest, TraverseSeek) {
+    DiskTable table(GetTableMeta(::openmldb::type::kAbsoluteTime, 0, 0), path_);
+    ASSERT_TRUE(table.Init());
+    for (int i = 0; i < 30; i++) {
+        PutRow(&table, "card" + std::to_string(i % 3), "mcc" + std::to_string(i), 1000 + i, 1000 + i, "value");
+    }
+    std::unique_ptr<TableIterator> it(table.NewTraverseIterator(0));
+    it->Seek("card1", 1013);
+    ASSERT_TRUE(it->Valid());
+    ASSERT_EQ("card1", it->GetPK());
+    ASSERT_EQ(1010u, it->GetKey());
+    int count = 0;
+    for (; it->Valid() && it->GetPK() == "card1"; it->Next()) {
+        count++;
+    }
+    ASSERT_EQ(4, count);
+    it->Seek("card1", 1001);
+    ASSERT_TRUE(it->Valid());
+    ASSERT_NE("card1", it->GetPK());
+}
+
+}  // namespace storage
+}  // namespace openmldb
+
+int main(int argc, char** argv) {
+    FLAGS_max_traverse_cnt = 200000;
+    ::testing::InitGoogleTest(&argc, argv);
+    ::openmldb::base::SetLogLevel(INFO);
+    return RUN_ALL_TESTS();
+}
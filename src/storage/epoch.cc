@@ -0,0 +1,83 @@
+/*
+ * Copyright 2021 4Paradigm
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "storage/epoch.h"
+
+namespace openmldb {
+namespace storage {
+
+EpochManager* EpochManager::GetInstance() {
+    static EpochManager instance;
+    return &instance;
+}
+
+EpochSlot* EpochManager::Enter() {
+    // the slot used last time by the thread is likely free and cached
+    thread_local EpochSlot* hint = nullptr;
+    EpochSlot* slot = nullptr;
+    if (hint != nullptr && TryAcquire(hint)) {
+        slot = hint;
+    }
+    for (SlotChunk* chunk = head_.load(std::memory_order_acquire); slot == nullptr && chunk != nullptr;
+         chunk = chunk->next) {
+        for (uint32_t i = 0; i < SLOT_CHUNK_SIZE; i++) {
+            if (TryAcquire(&chunk->slots[i])) {
+                slot = &chunk->slots[i];
+                break;
+            }
+        }
+    }
+    if (slot == nullptr) {
+        SlotChunk* chunk = new SlotChunk();
+        slot = &chunk->slots[0];
+        slot->in_use.store(true, std::memory_order_relaxed);
+        chunk->next = head_.load(std::memory_order_relaxed);
+        while (!head_.compare_exchange_weak(chunk->next, chunk, std::memory_order_release,
+                                            std::memory_order_relaxed)) {
+        }
+    }
+    hint = slot;
+    slot->epoch.store(epoch_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    // the pinned epoch must be visible to gc before the reader loads any node
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    return slot;
+}
+
+void EpochManager::Exit(EpochSlot* slot) {
+    if (slot == nullptr) {
+        return;
+    }
+    slot->epoch.store(0, std::memory_order_release);
+    slot->in_use.store(false, std::memory_order_release);
+}
+
+uint64_t EpochManager::GetSafeEpoch() const {
+    // pairs with the fence in Enter, a reader not seen pinned here sees the nodes unlinked before
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    uint64_t safe_epoch = epoch_.load(std::memory_order_seq_cst);
+    for (SlotChunk* chunk = head_.load(std::memory_order_acquire); chunk != nullptr; chunk = chunk->next) {
+        for (uint32_t i = 0; i < SLOT_CHUNK_SIZE; i++) {
+            uint64_t epoch = chunk->slots[i].epoch.load(std::memory_order_acquire);
+            if (epoch != 0 && epoch < safe_epoch) {
+                safe_epoch = epoch;
+            }
+        }
+    }
+    return safe_epoch;
+}
+
+}  // namespace storage
+}  // namespace openmldb
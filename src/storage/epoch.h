@@ -0,0 +1,81 @@
+/*
+ * Copyright 2021 4Paradigm
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SRC_STORAGE_EPOCH_H_
+#define SRC_STORAGE_EPOCH_H_
+
+#include <atomic>
+
+namespace openmldb {
+namespace storage {
+
+// the epoch a reader is in, 0 means the slot is not pinned. A slot takes a cache line of its own, so pinning it
+// doesn't write any line shared with other readers
+struct alignas(64) EpochSlot {
+    std::atomic<uint64_t> epoch{0};
+    std::atomic<bool> in_use{false};
+};
+
+// EpochManager is the epoch based reclamation of the nodes gc unlinks from segments. A reader pins a slot with the
+// global epoch before it reads the lists and unpins it when it's done, it only writes its own slot. Gc unlinks
+// the nodes at once and advances the epoch after, the nodes are freed when no reader is pinned in an epoch before
+// the advanced one. The slots are owned by the readers instead of the threads, so a reader may move between threads.
+class EpochManager {
+ public:
+    static EpochManager* GetInstance();
+
+    EpochManager(const EpochManager&) = delete;
+    EpochManager& operator=(const EpochManager&) = delete;
+
+    // get a free slot and pin it with the current epoch
+    EpochSlot* Enter();
+
+    // unpin the slot and give it back
+    void Exit(EpochSlot* slot);
+
+    uint64_t GetEpoch() const { return epoch_.load(std::memory_order_acquire); }
+
+    // advance the global epoch, it returns the new one
+    uint64_t Advance() { return epoch_.fetch_add(1, std::memory_order_seq_cst) + 1; }
+
+    // the min epoch of the pinned readers or the global epoch if there is none. The nodes unlinked before the
+    // epoch advanced to it are not visible to any reader
+    uint64_t GetSafeEpoch() const;
+
+ private:
+    static constexpr uint32_t SLOT_CHUNK_SIZE = 64;
+
+    struct SlotChunk {
+        EpochSlot slots[SLOT_CHUNK_SIZE];
+        SlotChunk* next = nullptr;
+    };
+
+    EpochManager() : epoch_(1), head_(nullptr) {}
+
+    static inline bool TryAcquire(EpochSlot* slot) {
+        return !slot->in_use.load(std::memory_order_relaxed) &&
+               !slot->in_use.exchange(true, std::memory_order_acquire);
+    }
+
+    std::atomic<uint64_t> epoch_;
+    // the chunks are never freed, a new one is pushed when all the slots are in use
+    std::atomic<SlotChunk*> head_;
+};
+
+}  // namespace storage
+}  // namespace openmldb
+
+#endif  // SRC_STORAGE_EPOCH_H_
@@ -0,0 +1,560 @@
+/*
+ * Copyright 2021 4Paradigm
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "storage/key_entries.h"
+
+#include <string.h>
+
+#include <utility>
+
+namespace openmldb {
+namespace storage {
+
+using ::openmldb::base::Slice;
+
+static const SliceComparator scmp;
+
+KeyBTree::Leaf::Leaf() : TreeNode(true) {
+    for (uint32_t i = 0; i < LEAF_SIZE; i++) {
+        prefixes[i].store(0, std::memory_order_relaxed);
+        nodes[i].store(NULL, std::memory_order_relaxed);
+    }
+}
+
+KeyBTree::Inner::Inner() : TreeNode(false) {
+    for (uint32_t i = 0; i < INNER_SIZE; i++) {
+        prefixes[i].store(0, std::memory_order_relaxed);
+        keys[i].store(NULL, std::memory_order_relaxed);
+    }
+    for (uint32_t i = 0; i <= INNER_SIZE; i++) {
+        children[i].store(NULL, std::memory_order_relaxed);
+    }
+}
+
+KeyBTree::KeyBTree() : root_(new Leaf()), head_(new KeyNode(1)), garbage_(), retired_() {
+    head_->SetNext(0, NULL);
+}
+
+KeyBTree::~KeyBTree() {
+    DeleteTree(root_.load(std::memory_order_relaxed));
+    FreeGarbage(&garbage_);
+    for (auto& garbage : retired_) {
+        FreeGarbage(&garbage);
+    }
+    delete head_;
+}
+
+char* KeyBTree::NewSeparator(const Slice& key) {
+    uint32_t size = key.size();
+    char* separator = new char[sizeof(uint32_t) + size];
+    memcpy(separator, &size, sizeof(uint32_t));
+    memcpy(separator + sizeof(uint32_t), key.data(), size);
+    return separator;
+}
+
+Slice KeyBTree::GetSeparator(const char* separator) {
+    uint32_t size = 0;
+    memcpy(&size, separator, sizeof(uint32_t));
+    return Slice(separator + sizeof(uint32_t), size);
+}
+
+uint32_t KeyBTree::SearchLeaf(const Leaf* leaf, const Slice& key, uint64_t prefix, uint32_t* count, bool* ok) {
+    uint32_t cnt = leaf->count.load(std::memory_order_acquire);
+    if (cnt > LEAF_SIZE) {
+        *ok = false;
+        cnt = LEAF_SIZE;
+    }
+    *count = cnt;
+    uint32_t low = 0;
+    uint32_t high = cnt;
+    while (low < high) {
+        uint32_t mid = (low + high) >> 1;
+        uint64_t cur = leaf->prefixes[mid].load(std::memory_order_relaxed);
+        if (cur < prefix) {
+            low = mid + 1;
+        } else if (cur > prefix) {
+            high = mid;
+        } else {
+            const KeyNode* node = leaf->nodes[mid].load(std::memory_order_acquire);
+            if (node == NULL) {
+                *ok = false;
+                return 0;
+            }
+            if (scmp(node->GetKey(), key) < 0) {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+    }
+    return low;
+}
+
+uint32_t KeyBTree::SearchInner(const Inner* inner, const Slice& key, uint64_t prefix, bool* ok) {
+    uint32_t cnt = inner->count.load(std::memory_order_acquire);
+    if (cnt > INNER_SIZE) {
+        *ok = false;
+        cnt = INNER_SIZE;
+    }
+    uint32_t low = 0;
+    uint32_t high = cnt;
+    while (low < high) {
+        uint32_t mid = (low + high) >> 1;
+        uint64_t cur = inner->prefixes[mid].load(std::memory_order_relaxed);
+        if (cur < prefix) {
+            low = mid + 1;
+        } else if (cur > prefix) {
+            high = mid;
+        } else {
+            const char* separator = inner->keys[mid].load(std::memory_order_acquire);
+            if (separator == NULL) {
+                *ok = false;
+                return 0;
+            }
+            if (scmp(GetSeparator(separator), key) <= 0) {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+    }
+    return low;
+}
+
+KeyBTree::Leaf* KeyBTree::FindLeaf(const Slice& key, uint64_t prefix, uint64_t* version) const {
+    bool ok = true;
+    TreeNode* node = root_.load(std::memory_order_acquire);
+    uint64_t node_version = ReadVersion(node, &ok);
+    if (!ok || node != root_.load(std::memory_order_acquire)) {
+        return NULL;
+    }
+    while (!node->is_leaf) {
+        const Inner* inner = static_cast<const Inner*>(node);
+        uint32_t idx = SearchInner(inner, key, prefix, &ok);
+        TreeNode* child = inner->children[idx].load(std::memory_order_acquire);
+        if (!ok || child == NULL) {
+            return NULL;
+        }
+        // the child is read before the parent is validated, so a split of the child is seen in one of them
+        uint64_t child_version = ReadVersion(child, &ok);
+        if (!ok || !Validate(inner, node_version)) {
+            return NULL;
+        }
+        node = child;
+        node_version = child_version;
+    }
+    *version = node_version;
+    return static_cast<Leaf*>(node);
+}
+
+KeyBTree::Leaf* KeyBTree::FindLeaf(const Slice& key, uint64_t prefix, Path* path) const {
+    bool ok = true;
+    path->depth = 0;
+    TreeNode* node = root_.load(std::memory_order_relaxed);
+    while (!node->is_leaf) {
+        Inner* inner = static_cast<Inner*>(node);
+        uint32_t idx = SearchInner(inner, key, prefix, &ok);
+        path->nodes[path->depth] = inner;
+        path->idx[path->depth] = idx;
+        path->depth++;
+        node = inner->children[idx].load(std::memory_order_relaxed);
+    }
+    return static_cast<Leaf*>(node);
+}
+
+KeyBTree::KeyNode* KeyBTree::GetPrevNode(const Path& path, const Leaf* leaf, uint32_t pos) const {
+    if (pos > 0) {
+        return leaf->nodes[pos - 1].load(std::memory_order_relaxed);
+    }
+    // the last key of the subtree on the left of the deepest turn. The leaves except the root are never empty
+    for (uint32_t level = path.depth; level > 0; level--) {
+        uint32_t idx = path.idx[level - 1];
+        if (idx == 0) {
+            continue;
+        }
+        TreeNode* node = path.nodes[level - 1]->children[idx - 1].load(std::memory_order_relaxed);
+        while (!node->is_leaf) {
+            Inner* inner = static_cast<Inner*>(node);
+            node = inner->children[inner->count.load(std::memory_order_relaxed)].load(std::memory_order_relaxed);
+        }
+        Leaf* left = static_cast<Leaf*>(node);
+        return left->nodes[left->count.load(std::memory_order_relaxed) - 1].load(std::memory_order_relaxed);
+    }
+    return head_;
+}
+
+int KeyBTree::Get(const Slice& key, void*& value) {
+    uint64_t prefix = GetPrefix(key);
+    while (true) {
+        uint64_t version = 0;
+        Leaf* leaf = FindLeaf(key, prefix, &version);
+        if (leaf == NULL) {
+            continue;
+        }
+        bool ok = true;
+        uint32_t count = 0;
+        uint32_t pos = SearchLeaf(leaf, key, prefix, &count, &ok);
+        KeyNode* node = NULL;
+        if (ok && pos < count && leaf->prefixes[pos].load(std::memory_order_relaxed) == prefix) {
+            node = leaf->nodes[pos].load(std::memory_order_acquire);
+        }
+        if (!ok || !Validate(leaf, version)) {
+            continue;
+        }
+        if (node == NULL || scmp(node->GetKey(), key) != 0) {
+            return -1;
+        }
+        value = node->GetValue();
+        return 0;
+    }
+}
+
+KeyBTree::KeyNode* KeyBTree::LowerBound(const Slice& key) {
+    uint64_t prefix = GetPrefix(key);
+    while (true) {
+        uint64_t version = 0;
+        Leaf* leaf = FindLeaf(key, prefix, &version);
+        if (leaf == NULL) {
+            continue;
+        }
+        bool ok = true;
+        uint32_t count = 0;
+        uint32_t pos = SearchLeaf(leaf, key, prefix, &count, &ok);
+        KeyNode* node = NULL;
+        if (ok && count > 0) {
+            node = leaf->nodes[pos < count ? pos : count - 1].load(std::memory_order_acquire);
+        }
+        if (!ok || !Validate(leaf, version)) {
+            continue;
+        }
+        if (count == 0) {
+            // only the root leaf of an empty tree has no key
+            return head_->GetNext(0);
+        }
+        // the keys between the last one of the leaf and key would be in the leaf, so the next node is the one
+        return pos < count ? node : node->GetNext(0);
+    }
+}
+
+void KeyBTree::InsertLeafAt(Leaf* leaf, uint32_t pos, uint64_t prefix, KeyNode* node) {
+    uint32_t count = leaf->count.load(std::memory_order_relaxed);
+    for (uint32_t i = count; i > pos; i--) {
+        leaf->prefixes[i].store(leaf->prefixes[i - 1].load(std::memory_order_relaxed), std::memory_order_relaxed);
+        leaf->nodes[i].store(leaf->nodes[i - 1].load(std::memory_order_relaxed), std::memory_order_release);
+    }
+    leaf->prefixes[pos].store(prefix, std::memory_order_relaxed);
+    leaf->nodes[pos].store(node, std::memory_order_release);
+    leaf->count.store(count + 1, std::memory_order_release);
+}
+
+void KeyBTree::InsertInnerAt(Inner* inner, uint32_t idx, uint64_t prefix, const char* key, TreeNode* child) {
+    uint32_t count = inner->count.load(std::memory_order_relaxed);
+    for (uint32_t i = count; i > idx; i--) {
+        inner->prefixes[i].store(inner->prefixes[i - 1].load(std::memory_order_relaxed), std::memory_order_relaxed);
+        inner->keys[i].store(inner->keys[i - 1].load(std::memory_order_relaxed), std::memory_order_release);
+        inner->children[i + 1].store(inner->children[i].load(std::memory_order_relaxed), std::memory_order_release);
+    }
+    inner->prefixes[idx].store(prefix, std::memory_order_relaxed);
+    inner->keys[idx].store(key, std::memory_order_release);
+    inner->children[idx + 1].store(child, std::memory_order_release);
+    inner->count.store(count + 1, std::memory_order_release);
+}
+
+void KeyBTree::SplitInner(Inner* inner, uint32_t idx, Inner* right, uint64_t* prefix, const char** key,
+                          TreeNode* child) {
+    uint64_t prefixes[INNER_SIZE + 1];
+    const char* keys[INNER_SIZE + 1];
+    TreeNode* children[INNER_SIZE + 2];
+    for (uint32_t i = 0, j = 0; i <= INNER_SIZE; i++) {
+        if (i == idx) {
+            prefixes[i] = *prefix;
+            keys[i] = *key;
+        } else {
+            prefixes[i] = inner->prefixes[j].load(std::memory_order_relaxed);
+            keys[i] = inner->keys[j].load(std::memory_order_relaxed);
+            j++;
+        }
+    }
+    for (uint32_t i = 0, j = 0; i <= INNER_SIZE + 1; i++) {
+        if (i == idx + 1) {
+            children[i] = child;
+        } else {
+            children[i] = inner->children[j].load(std::memory_order_relaxed);
+            j++;
+        }
+    }
+    uint32_t mid = (INNER_SIZE + 1) / 2;
+    for (uint32_t i = mid + 1; i <= INNER_SIZE; i++) {
+        right->prefixes[i - mid - 1].store(prefixes[i], std::memory_order_relaxed);
+        right->keys[i - mid - 1].store(keys[i], std::memory_order_release);
+    }
+    for (uint32_t i = mid + 1; i <= INNER_SIZE + 1; i++) {
+        right->children[i - mid - 1].store(children[i], std::memory_order_release);
+    }
+    right->count.store(INNER_SIZE - mid, std::memory_order_relaxed);
+    for (uint32_t i = 0; i < INNER_SIZE; i++) {
+        inner->prefixes[i].store(i < mid ? prefixes[i] : 0, std::memory_order_relaxed);
+        inner->keys[i].store(i < mid ? keys[i] : NULL, std::memory_order_release);
+    }
+    for (uint32_t i = 0; i <= INNER_SIZE; i++) {
+        inner->children[i].store(i <= mid ? children[i] : NULL, std::memory_order_release);
+    }
+    inner->count.store(mid, std::memory_order_release);
+    *prefix = prefixes[mid];
+    *key = keys[mid];
+}
+
+uint8_t KeyBTree::Insert(const Slice& key, void*& value) {
+    uint64_t prefix = GetPrefix(key);
+    Path path;
+    Leaf* leaf = FindLeaf(key, prefix, &path);
+    bool ok = true;
+    uint32_t count = 0;
+    uint32_t pos = SearchLeaf(leaf, key, prefix, &count, &ok);
+    KeyNode* node = new KeyNode(key, value, 1);
+    // link the node before it's in the tree, so a reader finds it in the tree can iterate from it
+    KeyNode* prev = GetPrevNode(path, leaf, pos);
+    node->SetNextNoBarrier(0, prev->GetNextNoBarrier(0));
+    prev->SetNext(0, node);
+    if (count < LEAF_SIZE) {
+        WriteLock(leaf);
+        InsertLeafAt(leaf, pos, prefix, node);
+        WriteUnlock(leaf);
+    } else {
+        SplitInsert(path, leaf, pos, prefix, node);
+    }
+    return 1;
+}
+
+void KeyBTree::SplitInsert(const Path& path, Leaf* leaf, uint32_t pos, uint64_t prefix, KeyNode* node) {
+    // the split goes up to the deepest inner node which isn't full. The nodes it changes are locked from the top,
+    // so a reader which gets a child before the split fails to validate the parent
+    uint32_t top = path.depth;
+    while (top > 0 && path.nodes[top - 1]->count.load(std::memory_order_relaxed) == INNER_SIZE) {
+        top--;
+    }
+    uint32_t first_locked = top > 0 ? top - 1 : 0;
+    for (uint32_t i = first_locked; i < path.depth; i++) {
+        WriteLock(path.nodes[i]);
+    }
+    WriteLock(leaf);
+    Leaf* right = new Leaf();
+    uint32_t mid = LEAF_SIZE / 2;
+    for (uint32_t i = mid; i < LEAF_SIZE; i++) {
+        right->prefixes[i - mid].store(leaf->prefixes[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+        right->nodes[i - mid].store(leaf->nodes[i].load(std::memory_order_relaxed), std::memory_order_release);
+        leaf->prefixes[i].store(0, std::memory_order_relaxed);
+        leaf->nodes[i].store(NULL, std::memory_order_release);
+    }
+    right->count.store(LEAF_SIZE - mid, std::memory_order_relaxed);
+    leaf->count.store(mid, std::memory_order_release);
+    if (pos <= mid) {
+        InsertLeafAt(leaf, pos, prefix, node);
+    } else {
+        InsertLeafAt(right, pos - mid, prefix, node);
+    }
+    uint64_t sep_prefix = right->prefixes[0].load(std::memory_order_relaxed);
+    const char* sep = NewSeparator(right->nodes[0].load(std::memory_order_relaxed)->GetKey());
+    TreeNode* new_child = right;
+    for (uint32_t level = path.depth; level > 0 && new_child != NULL; level--) {
+        Inner* inner = path.nodes[level - 1];
+        uint32_t idx = path.idx[level - 1];
+        if (inner->count.load(std::memory_order_relaxed) < INNER_SIZE) {
+            InsertInnerAt(inner, idx, sep_prefix, sep, new_child);
+            new_child = NULL;
+        } else {
+            Inner* inner_right = new Inner();
+            SplitInner(inner, idx, inner_right, &sep_prefix, &sep, new_child);
+            new_child = inner_right;
+        }
+    }
+    if (new_child != NULL) {
+        Inner* root = new Inner();
+        root->prefixes[0].store(sep_prefix, std::memory_order_relaxed);
+        root->keys[0].store(sep, std::memory_order_release);
+        root->children[0].store(root_.load(std::memory_order_relaxed), std::memory_order_release);
+        root->children[1].store(new_child, std::memory_order_release);
+        root->count.store(1, std::memory_order_relaxed);
+        root_.store(root, std::memory_order_release);
+    }
+    WriteUnlock(leaf);
+    for (uint32_t i = path.depth; i > first_locked; i--) {
+        WriteUnlock(path.nodes[i - 1]);
+    }
+}
+
+KeyBTree::KeyNode* KeyBTree::Remove(const Slice& key) {
+    uint64_t prefix = GetPrefix(key);
+    Path path;
+    Leaf* leaf = FindLeaf(key, prefix, &path);
+    bool ok = true;
+    uint32_t count = 0;
+    uint32_t pos = SearchLeaf(leaf, key, prefix, &count, &ok);
+    if (pos >= count) {
+        return NULL;
+    }
+    KeyNode* node = leaf->nodes[pos].load(std::memory_order_relaxed);
+    if (scmp(node->GetKey(), key) != 0) {
+        return NULL;
+    }
+    KeyNode* prev = GetPrevNode(path, leaf, pos);
+    if (count > 1 || path.depth == 0) {
+        WriteLock(leaf);
+        for (uint32_t i = pos; i + 1 < count; i++) {
+            leaf->prefixes[i].store(leaf->prefixes[i + 1].load(std::memory_order_relaxed), std::memory_order_relaxed);
+            leaf->nodes[i].store(leaf->nodes[i + 1].load(std::memory_order_relaxed), std::memory_order_release);
+        }
+        leaf->prefixes[count - 1].store(0, std::memory_order_relaxed);
+        leaf->nodes[count - 1].store(NULL, std::memory_order_release);
+        leaf->count.store(count - 1, std::memory_order_release);
+        WriteUnlock(leaf);
+    } else {
+        RemoveLeaf(path, leaf);
+    }
+    // the next of the node is kept, so a reader on it goes on to the nodes after
+    prev->SetNext(0, node->GetNextNoBarrier(0));
+    return node;
+}
+
+void KeyBTree::RemoveLeaf(const Path& path, Leaf* leaf) {
+    // the leaf gets empty, it's removed with the inner nodes which have it as the only child
+    uint32_t top = path.depth;
+    while (top > 0 && path.nodes[top - 1]->count.load(std::memory_order_relaxed) == 0) {
+        top--;
+    }
+    uint32_t first_locked = top > 0 ? top - 1 : 0;
+    for (uint32_t i = first_locked; i < path.depth; i++) {
+        WriteLock(path.nodes[i]);
+    }
+    WriteLock(leaf);
+    leaf->count.store(0, std::memory_order_release);
+    garbage_.nodes.push_back(leaf);
+    for (uint32_t i = top; i < path.depth; i++) {
+        garbage_.nodes.push_back(path.nodes[i]);
+    }
+    if (top == 0) {
+        root_.store(new Leaf(), std::memory_order_release);
+    } else {
+        Inner* inner = path.nodes[top - 1];
+        uint32_t idx = path.idx[top - 1];
+        uint32_t count = inner->count.load(std::memory_order_relaxed);
+        // remove the separator before the child, or the one after it for the first child, so the range of the
+        // child is merged into a neighbor
+        uint32_t key_idx = idx > 0 ? idx - 1 : 0;
+        garbage_.keys.push_back(const_cast<char*>(inner->keys[key_idx].load(std::memory_order_relaxed)));
+        for (uint32_t i = key_idx; i + 1 < count; i++) {
+            inner->prefixes[i].store(inner->prefixes[i + 1].load(std::memory_order_relaxed),
+                                     std::memory_order_relaxed);
+            inner->keys[i].store(inner->keys[i + 1].load(std::memory_order_relaxed), std::memory_order_release);
+        }
+        for (uint32_t i = idx; i < count; i++) {
+            inner->children[i].store(inner->children[i + 1].load(std::memory_order_relaxed),
+                                     std::memory_order_relaxed);
+        }
+        inner->prefixes[count - 1].store(0, std::memory_order_relaxed);
+        inner->keys[count - 1].store(NULL, std::memory_order_release);
+        inner->children[count].store(NULL, std::memory_order_release);
+        inner->count.store(count - 1, std::memory_order_release);
+        if (top == 1 && count == 1) {
+            // the root has one child left, the child becomes the root
+            root_.store(inner->children[0].load(std::memory_order_relaxed), std::memory_order_release);
+            garbage_.nodes.push_back(inner);
+        }
+    }
+    WriteUnlock(leaf);
+    for (uint32_t i = path.depth; i > first_locked; i--) {
+        WriteUnlock(path.nodes[i - 1]);
+    }
+}
+
+uint64_t KeyBTree::Clear() {
+    DeleteTree(root_.load(std::memory_order_relaxed));
+    root_.store(new Leaf(), std::memory_order_release);
+    uint64_t cnt = 0;
+    KeyNode* node = head_->GetNext(0);
+    head_->SetNextNoBarrier(0, NULL);
+    while (node != NULL) {
+        cnt++;
+        KeyNode* tmp = node;
+        node = node->GetNext(0);
+        delete tmp;
+    }
+    return cnt;
+}
+
+void KeyBTree::RetireGarbage(uint64_t version) {
+    if (garbage_.nodes.empty() && garbage_.keys.empty()) {
+        return;
+    }
+    garbage_.version = version;
+    retired_.push_back(std::move(garbage_));
+    garbage_ = Garbage();
+}
+
+void KeyBTree::FreeGarbage(uint64_t version) {
+    while (!retired_.empty() && retired_.front().version <= version) {
+        FreeGarbage(&retired_.front());
+        retired_.pop_front();
+    }
+}
+
+void KeyBTree::FreeGarbage(Garbage* garbage) {
+    for (TreeNode* node : garbage->nodes) {
+        if (node->is_leaf) {
+            delete static_cast<Leaf*>(node);
+        } else {
+            delete static_cast<Inner*>(node);
+        }
+    }
+    for (char* key : garbage->keys) {
+        delete[] key;
+    }
+    garbage->nodes.clear();
+    garbage->keys.clear();
+}
+
+void KeyBTree::DeleteTree(TreeNode* node) {
+    if (node->is_leaf) {
+        delete static_cast<Leaf*>(node);
+        return;
+    }
+    Inner* inner = static_cast<Inner*>(node);
+    uint32_t count = inner->count.load(std::memory_order_relaxed);
+    for (uint32_t i = 0; i < count; i++) {
+        delete[] inner->keys[i].load(std::memory_order_relaxed);
+    }
+    for (uint32_t i = 0; i <= count; i++) {
+        DeleteTree(inner->children[i].load(std::memory_order_relaxed));
+    }
+    delete inner;
+}
+
+KeyEntries::KeyEntries(uint8_t max_height, uint8_t branch, ::openmldb::type::KeyIndexType index_type)
+    : list_(NULL), tree_(NULL) {
+    if (index_type == ::openmldb::type::kBTree) {
+        tree_ = new KeyBTree();
+    } else {
+        list_ = new ::openmldb::base::Skiplist<Slice, void*, SliceComparator>(max_height, branch, scmp);
+    }
+}
+
+KeyEntries::~KeyEntries() {
+    delete list_;
+    delete tree_;
+}
+
+}  // namespace storage
+}  // namespace openmldb
@@ -0,0 +1,269 @@
+/*
+ * Copyright 2021 4Paradigm
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SRC_STORAGE_KEY_ENTRIES_H_
+#define SRC_STORAGE_KEY_ENTRIES_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <deque>
+#include <vector>
+
+#include "base/skiplist.h"
+#include "base/slice.h"
+#include "proto/type.pb.h"
+
+namespace openmldb {
+namespace storage {
+
+struct SliceComparator {
+    int operator()(const ::openmldb::base::Slice& a, const ::openmldb::base::Slice& b) const { return a.compare(b); }
+};
+
+// KeyBTree is a B+tree from the keys to the key nodes. The key nodes are linked in the key order like the bottom
+// level of a skiplist, so they are iterated the same way and a removed node still leads to the nodes after it.
+// A lookup reads one tree node per level instead of a node per key on the way, and the 8 byte key prefixes kept
+// inline settle most comparisons without reading the keys.
+// The writes need external synchronization, they change the tree nodes in place and bump the versions of them.
+// The readers don't lock, they restart from the root if a tree node they read is changed. The tree nodes the
+// writes remove are kept as garbage and freed by FreeGarbage after the readers which may see them leave.
+class KeyBTree {
+ public:
+    typedef ::openmldb::base::Node<::openmldb::base::Slice, void*> KeyNode;
+
+    KeyBTree();
+    ~KeyBTree();
+
+    KeyBTree(const KeyBTree&) = delete;
+    KeyBTree& operator=(const KeyBTree&) = delete;
+
+    // the key must not be in the tree. It returns the height of the new node, which is always 1
+    uint8_t Insert(const ::openmldb::base::Slice& key, void*& value);  // NOLINT
+
+    int Get(const ::openmldb::base::Slice& key, void*& value);  // NOLINT
+
+    // unlink the node of key, it's NULL if the key is not in the tree
+    KeyNode* Remove(const ::openmldb::base::Slice& key);
+
+    KeyNode* GetFirst() { return head_->GetNext(0); }
+
+    // the first node whose key is not less than key, NULL if there is none
+    KeyNode* LowerBound(const ::openmldb::base::Slice& key);
+
+    // delete all the key nodes, need external synchronized
+    uint64_t Clear();
+
+    // tag the garbage since the last call with version, need external synchronized
+    void RetireGarbage(uint64_t version);
+
+    // free the garbage tagged with version or before, need external synchronized
+    void FreeGarbage(uint64_t version);
+
+ private:
+    static constexpr uint32_t LEAF_SIZE = 32;
+    static constexpr uint32_t INNER_SIZE = 32;
+    // the tree splits the root only when it's full, so it never gets this deep
+    static constexpr uint32_t MAX_DEPTH = 16;
+
+    // the version is odd while a write changes the node
+    struct TreeNode {
+        explicit TreeNode(bool leaf) : version(0), count(0), is_leaf(leaf) {}
+        std::atomic<uint64_t> version;
+        std::atomic<uint32_t> count;
+        const bool is_leaf;
+    };
+
+    struct Leaf : public TreeNode {
+        Leaf();
+        std::atomic<uint64_t> prefixes[LEAF_SIZE];
+        std::atomic<KeyNode*> nodes[LEAF_SIZE];
+    };
+
+    // child i holds the keys in [keys[i - 1], keys[i]). A separator key is a copy of the first key of a leaf
+    // when it splits, it's the size followed by the bytes
+    struct Inner : public TreeNode {
+        Inner();
+        std::atomic<uint64_t> prefixes[INNER_SIZE];
+        std::atomic<const char*> keys[INNER_SIZE];
+        std::atomic<TreeNode*> children[INNER_SIZE + 1];
+    };
+
+    // the inner nodes from the root to a leaf and the child index taken in each of them
+    struct Path {
+        Inner* nodes[MAX_DEPTH];
+        uint32_t idx[MAX_DEPTH];
+        uint32_t depth = 0;
+    };
+
+    struct Garbage {
+        uint64_t version = 0;
+        std::vector<TreeNode*> nodes;
+        std::vector<char*> keys;
+    };
+
+    // the first 8 bytes of the key in big endian with zero padding, a smaller prefix means a smaller key
+    static inline uint64_t GetPrefix(const ::openmldb::base::Slice& key) {
+        const uint8_t* data = reinterpret_cast<const uint8_t*>(key.data());
+        uint32_t size = key.size() < 8 ? key.size() : 8;
+        uint64_t prefix = 0;
+        for (uint32_t i = 0; i < size; i++) {
+            prefix |= static_cast<uint64_t>(data[i]) << (56 - 8 * i);
+        }
+        return prefix;
+    }
+
+    static inline uint64_t ReadVersion(const TreeNode* node, bool* ok) {
+        uint64_t version = node->version.load(std::memory_order_acquire);
+        if (version & 1) {
+            *ok = false;
+        }
+        return version;
+    }
+
+    static inline bool Validate(const TreeNode* node, uint64_t version) {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return node->version.load(std::memory_order_relaxed) == version;
+    }
+
+    static inline void WriteLock(TreeNode* node) {
+        node->version.store(node->version.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    static inline void WriteUnlock(TreeNode* node) {
+        node->version.store(node->version.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    static char* NewSeparator(const ::openmldb::base::Slice& key);
+    static ::openmldb::base::Slice GetSeparator(const char* separator);
+
+    // the position of the first entry not less than key, ok is false if the leaf is seen in a write
+    static uint32_t SearchLeaf(const Leaf* leaf, const ::openmldb::base::Slice& key, uint64_t prefix,
+                               uint32_t* count, bool* ok);
+    // the index of the child which may have key
+    static uint32_t SearchInner(const Inner* inner, const ::openmldb::base::Slice& key, uint64_t prefix, bool* ok);
+
+    // the leaf which may have key and its version, NULL if the reader has to restart
+    Leaf* FindLeaf(const ::openmldb::base::Slice& key, uint64_t prefix, uint64_t* version) const;
+    Leaf* FindLeaf(const ::openmldb::base::Slice& key, uint64_t prefix, Path* path) const;
+
+    // the node before the entry pos of the leaf in the key order
+    KeyNode* GetPrevNode(const Path& path, const Leaf* leaf, uint32_t pos) const;
+
+    static void InsertLeafAt(Leaf* leaf, uint32_t pos, uint64_t prefix, KeyNode* node);
+    static void InsertInnerAt(Inner* inner, uint32_t idx, uint64_t prefix, const char* key, TreeNode* child);
+    // split the full inner node with a key inserted at idx, the upper half goes to right and the key in the middle
+    // is moved up to prefix and key
+    static void SplitInner(Inner* inner, uint32_t idx, Inner* right, uint64_t* prefix, const char** key,
+                           TreeNode* child);
+    void SplitInsert(const Path& path, Leaf* leaf, uint32_t pos, uint64_t prefix, KeyNode* node);
+    void RemoveLeaf(const Path& path, Leaf* leaf);
+
+    static void DeleteTree(TreeNode* node);
+    static void FreeGarbage(Garbage* garbage);
+
+    std::atomic<TreeNode*> root_;
+    KeyNode* head_;
+    Garbage garbage_;
+    std::deque<Garbage> retired_;
+};
+
+// KeyEntries is the key index of a segment, the keys are kept in a skiplist or a KeyBTree by the index type of
+// the table. The writes need external synchronization and the readers don't lock in both of them.
+class KeyEntries {
+ public:
+    typedef ::openmldb::base::Node<::openmldb::base::Slice, void*> KeyNode;
+
+    KeyEntries(uint8_t max_height, uint8_t branch, ::openmldb::type::KeyIndexType index_type);
+    ~KeyEntries();
+
+    KeyEntries(const KeyEntries&) = delete;
+    KeyEntries& operator=(const KeyEntries&) = delete;
+
+    ::openmldb::type::KeyIndexType GetIndexType() const {
+        return tree_ == NULL ? ::openmldb::type::kSkiplist : ::openmldb::type::kBTree;
+    }
+
+    // Insert need external synchronized, it returns the height of the new node
+    inline uint8_t Insert(const ::openmldb::base::Slice& key, void*& value) {  // NOLINT
+        return tree_ == NULL ? list_->Insert(key, value) : tree_->Insert(key, value);
+    }
+
+    inline int Get(const ::openmldb::base::Slice& key, void*& value) {  // NOLINT
+        return tree_ == NULL ? list_->Get(key, value) : tree_->Get(key, value);
+    }
+
+    // Remove need external synchronized
+    inline KeyNode* Remove(const ::openmldb::base::Slice& key) {
+        return tree_ == NULL ? list_->Remove(key) : tree_->Remove(key);
+    }
+
+    // Need external synchronized
+    inline uint64_t Clear() { return tree_ == NULL ? list_->Clear() : tree_->Clear(); }
+
+    // the tree nodes removed by the writes since the last call are tagged with version, need external synchronized
+    inline void RetireGarbage(uint64_t version) {
+        if (tree_ != NULL) {
+            tree_->RetireGarbage(version);
+        }
+    }
+
+    // free the tree nodes tagged with version or before, need external synchronized
+    inline void FreeGarbage(uint64_t version) {
+        if (tree_ != NULL) {
+            tree_->FreeGarbage(version);
+        }
+    }
+
+    class Iterator {
+     public:
+        explicit Iterator(KeyEntries* entries) : node_(NULL), entries_(entries) {}
+        ~Iterator() {}
+
+        bool Valid() const { return node_ != NULL; }
+
+        void Next() { node_ = node_->GetNext(0); }
+
+        const ::openmldb::base::Slice& GetKey() const { return node_->GetKey(); }
+
+        void*& GetValue() { return node_->GetValue(); }
+
+        void Seek(const ::openmldb::base::Slice& key) {
+            node_ = entries_->tree_ == NULL ? entries_->list_->LowerBound(key) : entries_->tree_->LowerBound(key);
+        }
+
+        void SeekToFirst() {
+            node_ = entries_->tree_ == NULL ? entries_->list_->GetFirst() : entries_->tree_->GetFirst();
+        }
+
+     private:
+        KeyNode* node_;
+        KeyEntries* const entries_;
+    };
+
+    // delete the iterator after it's used
+    Iterator* NewIterator() { return new Iterator(this); }
+
+ private:
+    ::openmldb::base::Skiplist<::openmldb::base::Slice, void*, SliceComparator>* list_;
+    KeyBTree* tree_;
+};
+
+}  // namespace storage
+}  // namespace openmldb
+
+#endif  // SRC_STORAGE_KEY_ENTRIES_H_
@@ -0,0 +1,359 @@
+/*
+ * Copyright 2021 4Paradigm
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "storage/key_entries.h"
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "base/glog_wapper.h"  // NOLINT
+#include "common/timer.h"
+#include "gtest/gtest.h"
+#include "storage/segment.h"
+
+using ::openmldb::base::Slice;
+
+namespace openmldb {
+namespace storage {
+
+class KeyEntriesTest : public ::testing::TestWithParam<::openmldb::type::KeyIndexType> {
+ public:
+    KeyEntriesTest() {}
+    ~KeyEntriesTest() {}
+};
+
+// keys of different lengths which share long prefixes, so the comparisons go beyond the inline prefixes
+std::vector<std::string> GenKeys(uint32_t cnt, uint32_t seed) {
+    std::mt19937 rand(seed);
+    std::vector<std::string> keys;
+    keys.reserve(cnt);
+    for (uint32_t i = 0; i < cnt; i++) {
+        switch (rand() % 4) {
+            case 0:
+                keys.push_back(std::to_string(rand() % 1000));
+                break;
+            case 1:
+                keys.push_back("card_" + std::to_string(rand()));
+                break;
+            case 2:
+                keys.push_back("merchant_id_" + std::to_string(rand() % 100000) + "|" + std::to_string(i));
+                break;
+            default:
+                keys.push_back(std::string(rand() % 12, '\0') + std::to_string(rand() % 100));
+        }
+    }
+    return keys;
+}
+
+void CheckEntries(KeyEntries* entries, const std::map<std::string, uint64_t>& expect) {
+    std::unique_ptr<KeyEntries::Iterator> it(entries->NewIterator());
+    it->SeekToFirst();
+    for (const auto& kv : expect) {
+        ASSERT_TRUE(it->Valid());
+        ASSERT_EQ(kv.first, it->GetKey().ToString());
+        ASSERT_EQ(kv.second, reinterpret_cast<uint64_t>(it->GetValue()));
+        void* value = NULL;
+        ASSERT_EQ(0, entries->Get(Slice(kv.first), value));
+        ASSERT_EQ(kv.second, reinterpret_cast<uint64_t>(value));
+        it->Next();
+    }
+    ASSERT_FALSE(it->Valid());
+}
+
+TEST_P(KeyEntriesTest, InsertGetRemove) {
+    KeyEntries entries(12, 4, GetParam());
+    std::vector<std::string> keys = GenKeys(20000, 1);
+    std::map<std::string, uint64_t> expect;
+    for (uint32_t i = 0; i < keys.size(); i++) {
+        if (expect.find(keys[i]) != expect.end()) {
+            continue;
+        }
+        void* value = reinterpret_cast<void*>(static_cast<uint64_t>(i + 1));
+        ASSERT_GE(entries.Insert(Slice(keys[i]), value), 1);
+        expect.emplace(keys[i], i + 1);
+    }
+    CheckEntries(&entries, expect);
+    void* value = NULL;
+    ASSERT_EQ(-1, entries.Get(Slice("not_exist"), value));
+
+    // seek the keys in the map and the ones not in it
+    std::vector<std::string> probes = GenKeys(2000, 2);
+    probes.push_back("");
+    probes.push_back(std::string(20, '\xff'));
+    std::unique_ptr<KeyEntries::Iterator> it(entries.NewIterator());
+    for (const auto& probe : probes) {
+        it->Seek(Slice(probe));
+        auto iter = expect.lower_bound(probe);
+        if (iter == expect.end()) {
+            ASSERT_FALSE(it->Valid()) << probe;
+        } else {
+            ASSERT_TRUE(it->Valid()) << probe;
+            ASSERT_EQ(iter->first, it->GetKey().ToString());
+        }
+    }
+
+    std::mt19937 rand(3);
+    for (auto iter = expect.begin(); iter != expect.end();) {
+        if (rand() % 4 == 0) {
+            ++iter;
+            continue;
+        }
+        KeyEntries::KeyNode* node = entries.Remove(Slice(iter->first));
+        ASSERT_TRUE(node != NULL);
+        ASSERT_EQ(iter->first, node->GetKey().ToString());
+        delete node;
+        iter = expect.erase(iter);
+    }
+    ASSERT_TRUE(entries.Remove(Slice("not_exist")) == NULL);
+    CheckEntries(&entries, expect);
+    entries.RetireGarbage(1);
+    entries.FreeGarbage(1);
+
+    // insert the removed keys back
+    for (uint32_t i = 0; i < keys.size(); i++) {
+        if (expect.find(keys[i]) != expect.end()) {
+            continue;
+        }
+        void* value = reinterpret_cast<void*>(static_cast<uint64_t>(i + 1));
+        entries.Insert(Slice(keys[i]), value);
+        expect.emplace(keys[i], i + 1);
+    }
+    CheckEntries(&entries, expect);
+    for (const auto& kv : expect) {
+        delete entries.Remove(Slice(kv.first));
+    }
+    it->SeekToFirst();
+    ASSERT_FALSE(it->Valid());
+    ASSERT_EQ(0u, entries.Clear());
+    entries.RetireGarbage(2);
+    entries.FreeGarbage(2);
+}
+
+TEST_P(KeyEntriesTest, Clear) {
+    KeyEntries entries(12, 4, GetParam());
+    std::vector<std::string> keys;
+    keys.reserve(1000);
+    for (uint32_t i = 0; i < 1000; i++) {
+        keys.push_back("key" + std::to_string(i));
+        void* value = NULL;
+        entries.Insert(Slice(keys.back()), value);
+    }
+    ASSERT_EQ(1000u, entries.Clear());
+    void* value = NULL;
+    ASSERT_EQ(-1, entries.Get(Slice(keys[0]), value));
+    entries.Insert(Slice(keys[0]), value);
+    ASSERT_EQ(0, entries.Get(Slice(keys[0]), value));
+    ASSERT_EQ(1u, entries.Clear());
+}
+
+// the readers check the keys which are always in the index while the writer inserts and removes the others.
+// The skiplist unlinks the nexts of a removed node, so a reader passing it may miss the keys after and the writer
+// only inserts for it
+TEST_P(KeyEntriesTest, ConcurrentRead) {
+    KeyEntries entries(12, 4, GetParam());
+    bool remove = GetParam() == ::openmldb::type::kBTree;
+    std::vector<std::string> stable;
+    std::vector<std::string> volatile_keys;
+    for (uint32_t i = 0; i < 20000; i++) {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "key_%08u", i);
+        if (i % 2 == 0) {
+            stable.push_back(buf);
+        } else {
+            volatile_keys.push_back(buf);
+        }
+    }
+    for (uint32_t i = 0; i < stable.size(); i++) {
+        void* value = reinterpret_cast<void*>(static_cast<uint64_t>(i + 1));
+        entries.Insert(Slice(stable[i]), value);
+    }
+    std::atomic<bool> stop(false);
+    std::atomic<uint64_t> errors(0);
+    std::vector<std::thread> readers;
+    for (uint32_t t = 0; t < 4; t++) {
+        readers.emplace_back([&, t]() {
+            std::mt19937 rand(t);
+            std::unique_ptr<KeyEntries::Iterator> it(entries.NewIterator());
+            while (!stop.load(std::memory_order_relaxed)) {
+                uint32_t idx = rand() % stable.size();
+                void* value = NULL;
+                if (entries.Get(Slice(stable[idx]), value) != 0 ||
+                    reinterpret_cast<uint64_t>(value) != idx + 1) {
+                    errors.fetch_add(1, std::memory_order_relaxed);
+                }
+                it->Seek(Slice(stable[idx]));
+                if (!it->Valid() || it->GetKey().compare(Slice(stable[idx])) != 0) {
+                    errors.fetch_add(1, std::memory_order_relaxed);
+                    continue;
+                }
+                // the keys are in order and the stable ones are not skipped
+                std::string last = stable[idx];
+                uint32_t next = idx + 1;
+                for (uint32_t i = 0; i < 64 && it->Valid(); i++) {
+                    it->Next();
+                    if (!it->Valid()) {
+                        break;
+                    }
+                    std::string cur = it->GetKey().ToString();
+                    if (cur <= last) {
+                        errors.fetch_add(1, std::memory_order_relaxed);
+                        break;
+                    }
+                    if (next < stable.size() && cur > stable[next]) {
+                        errors.fetch_add(1, std::memory_order_relaxed);
+                        break;
+                    }
+                    if (next < stable.size() && cur == stable[next]) {
+                        next++;
+                    }
+                    last = cur;
+                }
+            }
+        });
+    }
+    // the removed nodes are freed after the readers stop
+    std::vector<KeyEntries::KeyNode*> removed;
+    std::mt19937 rand(7);
+    for (uint32_t round = 0; round < 20; round++) {
+        for (uint32_t i = 0; i < volatile_keys.size(); i++) {
+            void* value = NULL;
+            if (entries.Get(Slice(volatile_keys[i]), value) == 0) {
+                if (!remove) {
+                    continue;
+                }
+                removed.push_back(entries.Remove(Slice(volatile_keys[i])));
+            } else if (rand() % 2 == 0) {
+                entries.Insert(Slice(volatile_keys[i]), value);
+            }
+        }
+        entries.RetireGarbage(round);
+    }
+    stop.store(true, std::memory_order_relaxed);
+    for (auto& reader : readers) {
+        reader.join();
+    }
+    ASSERT_EQ(0u, errors.load());
+    entries.FreeGarbage(UINT64_MAX);
+    for (auto* node : removed) {
+        delete node;
+    }
+    entries.Clear();
+}
+
+TEST_P(KeyEntriesTest, Segment) {
+    Segment segment(8, GetParam());
+    for (uint32_t i = 0; i < 1000; i++) {
+        std::string key = "pk" + std::to_string(i);
+        std::string value = "value" + std::to_string(i);
+        segment.Put(Slice(key), 9527 + i, value.c_str(), value.size());
+    }
+    ASSERT_EQ(1000u, segment.GetPkCnt());
+    for (uint32_t i = 0; i < 1000; i++) {
+        DataBlock* block = NULL;
+        std::string key = "pk" + std::to_string(i);
+        ASSERT_TRUE(segment.Get(Slice(key), 9527 + i, &block));
+        ASSERT_EQ("value" + std::to_string(i), std::string(block->data, block->size));
+    }
+    for (uint32_t i = 0; i < 1000; i += 2) {
+        ASSERT_TRUE(segment.Delete(Slice("pk" + std::to_string(i))));
+    }
+    {
+        Ticket ticket;
+        std::unique_ptr<MemTableIterator> it(segment.NewIterator(Slice("pk1"), ticket));
+        it->SeekToFirst();
+        ASSERT_TRUE(it->Valid());
+        ASSERT_EQ("value1", it->GetValue().ToString());
+    }
+    uint64_t gc_idx_cnt = 0;
+    uint64_t gc_record_cnt = 0;
+    uint64_t gc_record_byte_size = 0;
+    for (uint32_t i = 0; i < 4; i++) {
+        segment.IncrGcVersion();
+        segment.GcFreeList(gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
+    }
+    ASSERT_EQ(500u, gc_record_cnt);
+    DataBlock* block = NULL;
+    ASSERT_FALSE(segment.Get(Slice("pk0"), 9527, &block));
+    ASSERT_TRUE(segment.Get(Slice("pk1"), 9528, &block));
+    segment.ReleaseAndCount(gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
+    ASSERT_EQ(1000u, gc_record_cnt);
+}
+
+TEST_P(KeyEntriesTest, PointLookupBenchmark) {
+    KeyEntries entries(12, 4, GetParam());
+    uint32_t key_cnt = 200000;
+    std::vector<std::string> keys;
+    keys.reserve(key_cnt);
+    for (uint32_t i = 0; i < key_cnt; i++) {
+        keys.push_back("card_no_" + std::to_string(6222020000000000ul + i * 7919ul));
+    }
+    std::mt19937 rand(11);
+    std::shuffle(keys.begin(), keys.end(), rand);
+    uint64_t consumed = ::baidu::common::timer::get_micros();
+    for (uint32_t i = 0; i < key_cnt; i++) {
+        void* value = reinterpret_cast<void*>(static_cast<uint64_t>(i + 1));
+        entries.Insert(Slice(keys[i]), value);
+    }
+    consumed = ::baidu::common::timer::get_micros() - consumed;
+    std::cout << ::openmldb::type::KeyIndexType_Name(GetParam()) << " insert " << key_cnt
+              << " keys avg consumed:" << consumed * 1000 / key_cnt << "ns" << std::endl;
+    std::shuffle(keys.begin(), keys.end(), rand);
+    uint32_t times = 5;
+    uint64_t found = 0;
+    consumed = ::baidu::common::timer::get_micros();
+    for (uint32_t t = 0; t < times; t++) {
+        for (uint32_t i = 0; i < key_cnt; i++) {
+            void* value = NULL;
+            found += entries.Get(Slice(keys[i]), value) == 0;
+        }
+    }
+    consumed = ::baidu::common::timer::get_micros() - consumed;
+    ASSERT_EQ(static_cast<uint64_t>(key_cnt) * times, found);
+    std::cout << ::openmldb::type::KeyIndexType_Name(GetParam()) << " get " << key_cnt
+              << " keys avg consumed:" << consumed * 1000 / (static_cast<uint64_t>(key_cnt) * times) << "ns"
+              << std::endl;
+    std::unique_ptr<KeyEntries::Iterator> it(entries.NewIterator());
+    consumed = ::baidu::common::timer::get_micros();
+    for (uint32_t i = 0; i < key_cnt; i++) {
+        it->Seek(Slice(keys[i]));
+        found += it->Valid();
+    }
+    consumed = ::baidu::common::timer::get_micros() - consumed;
+    std::cout << ::openmldb::type::KeyIndexType_Name(GetParam()) << " seek " << key_cnt
+              << " keys avg consumed:" << consumed * 1000 / key_cnt << "ns" << std::endl;
+    entries.Clear();
+}
+
+INSTANTIATE_TEST_CASE_P(KeyIndexType, KeyEntriesTest,
+                        ::testing::Values(::openmldb::type::kSkiplist, ::openmldb::type::kBTree));
+
+}  // namespace storage
+}  // namespace openmldb
+
+int main(int argc, char** argv) {
+    ::openmldb::base::SetLogLevel(INFO);
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
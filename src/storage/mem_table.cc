@@ -16,12 +16,16 @@
 
 #include "storage/mem_table.h"
 
+#include <snappy.h>
+
 #include <algorithm>
+#include <thread>  // NOLINT
 #include <utility>
 
 #include "base/glog_wapper.h"
 #include "base/hash.h"
 #include "base/slice.h"
+#include "codec/row_codec.h"
 #include "common/timer.h"
 #include "gflags/gflags.h"
 #include "storage/record.h"
@@ -33,6 +37,9 @@ DECLARE_uint32(key_entry_max_height);
 DECLARE_uint32(absolute_default_skiplist_height);
 DECLARE_uint32(latest_default_skiplist_height);
 DECLARE_uint32(max_traverse_cnt);
+DECLARE_bool(enable_latest_bounded_list);
+DECLARE_uint32(extract_index_thread_num);
+DECLARE_uint32(extract_index_max_rate);
 
 namespace openmldb {
 namespace storage {
@@ -48,13 +55,21 @@ MemTable::MemTable(const std::string& name, uint32_t id, uint32_t pid, uint32_t
       enable_gc_(true),
       record_cnt_(0),
       segment_released_(false),
-      record_byte_size_(0) {}
+      record_byte_size_(0),
+      cold_tier_(),
+      cold_age_(0),
+      cold_check_(false),
+      aggregators_(std::make_shared<std::vector<std::shared_ptr<Aggregator>>>()) {}
 
 MemTable::MemTable(const ::openmldb::api::TableMeta& table_meta)
     : Table(table_meta.name(), table_meta.tid(), table_meta.pid(), 0, true, 60 * 1000,
             std::map<std::string, uint32_t>(), ::openmldb::type::TTLType::kAbsoluteTime,
             ::openmldb::type::CompressType::kNoCompress),
-      segments_(MAX_INDEX_NUM, NULL) {
+      segments_(MAX_INDEX_NUM, NULL),
+      cold_tier_(),
+      cold_age_(0),
+      cold_check_(false),
+      aggregators_(std::make_shared<std::vector<std::shared_ptr<Aggregator>>>()) {
     seg_cnt_ = 8;
     enable_gc_ = true;
     record_cnt_ = 0;
@@ -107,23 +122,176 @@ bool MemTable::Init() {
         Segment** seg_arr = new Segment*[seg_cnt_];
         if (!ts_vec.empty()) {
             for (uint32_t j = 0; j < seg_cnt_; j++) {
-                seg_arr[j] = new Segment(cur_key_entry_max_height, ts_vec);
+                seg_arr[j] = new Segment(cur_key_entry_max_height, ts_vec, table_meta_->key_index_type());
                 PDLOG(INFO, "init %u, %u segment. height %u, ts col num %u. tid %u pid %u", i, j,
                       cur_key_entry_max_height, ts_vec.size(), id_, pid_);
             }
         } else {
             for (uint32_t j = 0; j < seg_cnt_; j++) {
-                seg_arr[j] = new Segment(cur_key_entry_max_height);
+                seg_arr[j] = new Segment(cur_key_entry_max_height, table_meta_->key_index_type());
                 PDLOG(INFO, "init %u, %u segment. height %u tid %u pid %u", i, j, cur_key_entry_max_height, id_, pid_);
             }
         }
         segments_[i] = seg_arr;
         key_entry_max_height_ = cur_key_entry_max_height;
     }
+    UpdateLatestBound();
+    auto aggregators = std::make_shared<std::vector<std::shared_ptr<Aggregator>>>();
+    for (const auto& info : table_meta_->aggregators()) {
+        auto aggregator = std::make_shared<Aggregator>(this, info);
+        std::string msg;
+        if (!aggregator->Init(&msg)) {
+            PDLOG(WARNING, "fail to init aggregator %s on index %s: %s. tid %u pid %u", info.aggr_func().c_str(),
+                  info.index_name().c_str(), msg.c_str(), id_, pid_);
+            return false;
+        }
+        aggregators->push_back(aggregator);
+    }
+    std::atomic_store_explicit(&aggregators_, aggregators, std::memory_order_release);
     PDLOG(INFO, "init table name %s, id %d, pid %d, seg_cnt %d", name_.c_str(), id_, pid_, seg_cnt_);
     return true;
 }
 
+bool MemTable::InitColdTier(const std::string& path, uint64_t age) {
+    auto cold_tier = std::make_shared<DiskTable>(*GetTableMeta(), path);
+    if (!cold_tier->Init()) {
+        PDLOG(WARNING, "fail to init cold tier %s. tid %u pid %u", path.c_str(), id_, pid_);
+        return false;
+    }
+    cold_check_.store(cold_tier->GetFileCnt() > 0, std::memory_order_relaxed);
+    cold_age_ = age;
+    cold_tier_ = cold_tier;
+    PDLOG(INFO, "init cold tier %s with age %lu ms. tid %u pid %u", path.c_str(), age, id_, pid_);
+    return true;
+}
+
+bool MemTable::AddAggregator(const ::openmldb::api::AggregatorInfo& info, std::string* msg) {
+    auto aggregator = std::make_shared<Aggregator>(this, info);
+    if (!aggregator->Init(msg)) {
+        PDLOG(WARNING, "fail to add aggregator %s on index %s: %s. tid %u pid %u", info.aggr_func().c_str(),
+              info.index_name().c_str(), msg->c_str(), id_, pid_);
+        return false;
+    }
+    // the segments are walked without gc like extracting an index, and the aggregators are added one by one so that
+    // they are in the same order as the table meta
+    std::lock_guard<std::mutex> gc_lock(gc_mu_);
+    aggregator->BeginBackfill();
+    auto aggregators = std::make_shared<std::vector<std::shared_ptr<Aggregator>>>(
+        *std::atomic_load_explicit(&aggregators_, std::memory_order_acquire));
+    aggregators->push_back(aggregator);
+    std::atomic_store_explicit(&aggregators_, aggregators, std::memory_order_release);
+    uint64_t cnt = BackfillAggregator(aggregator.get());
+    aggregator->EndBackfill();
+    auto new_table_meta = std::make_shared<::openmldb::api::TableMeta>(*GetTableMeta());
+    new_table_meta->add_aggregators()->CopyFrom(info);
+    std::atomic_store_explicit(&table_meta_, new_table_meta, std::memory_order_release);
+    PDLOG(INFO, "add aggregator %s on index %s with %lu rows. tid %u pid %u", info.aggr_func().c_str(),
+          info.index_name().c_str(), cnt, id_, pid_);
+    return true;
+}
+
+uint64_t MemTable::BackfillAggregator(Aggregator* aggregator) {
+    std::shared_ptr<IndexDef> index_def = GetIndex(aggregator->GetIndexId());
+    uint32_t inner_pos = index_def->GetInnerPos();
+    uint32_t ts_idx = 0;
+    if (index_def->GetTsColumn()) {
+        segments_[inner_pos][0]->GetTsIdx(index_def->GetTsColumn()->GetTsIdx(), ts_idx);
+    }
+    // the rows moved into the cold tier already are only read by the edge scans of the queries
+    uint64_t cnt = 0;
+    std::string cur_key;
+    for (uint32_t seg_idx = 0; seg_idx < seg_cnt_; seg_idx++) {
+        Segment* segment = segments_[inner_pos][seg_idx];
+        std::unique_ptr<KeyEntries::Iterator> pk_it(segment->GetKeyEntries()->NewIterator());
+        for (pk_it->SeekToFirst(); pk_it->Valid(); pk_it->Next()) {
+            void* value = pk_it->GetValue();
+            KeyEntry* entry = segment->GetTsCnt() > 1 ? ((KeyEntry**)value)[ts_idx]  // NOLINT
+                                                      : (KeyEntry*)value;            // NOLINT
+            cur_key.assign(pk_it->GetKey().data(), pk_it->GetKey().size());
+            std::unique_ptr<KeyEntryIterator> it(entry->NewIterator());
+            for (it->SeekToFirst(); it->Valid(); it->Next()) {
+                aggregator->Backfill(cur_key, it->GetKey(), it->GetValue());
+                cnt++;
+            }
+        }
+    }
+    return cnt;
+}
+
+void MemTable::BackfillAggregators() {
+    std::lock_guard<std::mutex> gc_lock(gc_mu_);
+    auto aggregators = std::atomic_load_explicit(&aggregators_, std::memory_order_acquire);
+    for (const auto& aggregator : *aggregators) {
+        aggregator->BeginBackfill();
+        uint64_t cnt = BackfillAggregator(aggregator.get());
+        aggregator->EndBackfill();
+        const auto& info = aggregator->GetInfo();
+        PDLOG(INFO, "backfill aggregator %s on index %s with %lu rows. tid %u pid %u", info.aggr_func().c_str(),
+              info.index_name().c_str(), cnt, id_, pid_);
+    }
+}
+
+std::shared_ptr<Aggregator> MemTable::GetAggregator(uint32_t pos) {
+    auto aggregators = std::atomic_load_explicit(&aggregators_, std::memory_order_acquire);
+    if (pos >= aggregators->size()) {
+        return std::shared_ptr<Aggregator>();
+    }
+    return aggregators->at(pos);
+}
+
+std::shared_ptr<Aggregator> MemTable::FindAggregator(const ::openmldb::api::AggregatorInfo& info) {
+    auto count_all = [](const std::string& col) { return col.empty() || col == "*"; };
+    auto aggregators = std::atomic_load_explicit(&aggregators_, std::memory_order_acquire);
+    for (const auto& aggregator : *aggregators) {
+        const auto& cur = aggregator->GetInfo();
+        if (cur.index_name() == info.index_name() && cur.aggr_func() == info.aggr_func() &&
+            cur.filter_col() == info.filter_col() &&
+            (cur.aggr_col() == info.aggr_col() || (count_all(cur.aggr_col()) && count_all(info.aggr_col())))) {
+            return aggregator;
+        }
+    }
+    return std::shared_ptr<Aggregator>();
+}
+
+void MemTable::UpdateLatestBound() {
+    if (!FLAGS_enable_latest_bounded_list || segments_.empty()) {
+        return;
+    }
+    bool enable_gc = enable_gc_.load(std::memory_order_relaxed);
+    auto inner_indexs = table_index_.GetAllInnerIndex();
+    for (uint32_t i = 0; i < inner_indexs->size(); i++) {
+        if (segments_[i] == NULL) {
+            continue;
+        }
+        // the indexs without ts column share one list, so the loosest ttl wins
+        std::map<uint32_t, uint64_t> bound_map;
+        for (const auto& index_def : inner_indexs->at(i)->GetIndex()) {
+            uint32_t real_idx = 0;
+            auto ts_col = index_def->GetTsColumn();
+            if (segments_[i][0]->GetTsCnt() > 1 &&
+                (!ts_col || segments_[i][0]->GetTsIdx(ts_col->GetTsIdx(), real_idx) < 0)) {
+                continue;
+            }
+            auto ttl = index_def->GetTTL();
+            uint64_t keep_cnt = 0;
+            if (enable_gc && (ttl->ttl_type == TTLType::kLatestTime || ttl->ttl_type == TTLType::kAbsOrLat)) {
+                keep_cnt = ttl->lat_ttl;
+            }
+            auto iter = bound_map.find(real_idx);
+            if (iter == bound_map.end()) {
+                bound_map.emplace(real_idx, keep_cnt);
+            } else if (iter->second > 0 && (keep_cnt == 0 || keep_cnt > iter->second)) {
+                iter->second = keep_cnt;
+            }
+        }
+        for (uint32_t j = 0; j < seg_cnt_; j++) {
+            for (const auto& kv : bound_map) {
+                segments_[i][j]->SetLatestBound(kv.first, kv.second);
+            }
+        }
+    }
+}
+
 void MemTable::SetCompressType(::openmldb::type::CompressType compress_type) { compress_type_ = compress_type; }
 
 ::openmldb::type::CompressType MemTable::GetCompressType() { return compress_type_; }
@@ -139,6 +307,13 @@ bool MemTable::Put(const std::string& pk, uint64_t time, const char* data, uint3
     segment->Put(spk, time, data, size);
     record_cnt_.fetch_add(1, std::memory_order_relaxed);
     record_byte_size_.fetch_add(GetRecordSize(size));
+    IncrKeyVersion(pk.data(), pk.size());
+    auto aggregators = std::atomic_load_explicit(&aggregators_, std::memory_order_acquire);
+    for (const auto& aggregator : *aggregators) {
+        if (aggregator->GetIndexId() == 0) {
+            aggregator->Update(pk, time, Slice(data, size));
+        }
+    }
     return true;
 }
 
@@ -175,10 +350,11 @@ bool MemTable::Put(uint64_t time, const std::string& value, const Dimensions& di
     for (const auto& kv : inner_index_key_map) {
         auto inner_index = table_index_.GetInnerIndex(kv.first);
         bool need_put = false;
+        bool extracting = false;
         for (const auto& index_def : inner_index->GetIndex()) {
             if (index_def->IsReady()) {
                 need_put = true;
-                break;
+                extracting = extracting || index_def->IsExtracting();
             }
         }
         if (need_put) {
@@ -187,11 +363,20 @@ bool MemTable::Put(uint64_t time, const std::string& value, const Dimensions& di
                 seg_idx = ::openmldb::base::hash(kv.second.data(), kv.second.size(), SEED) % seg_cnt_;
             }
             Segment* segment = segments_[kv.first][seg_idx];
-            segment->Put(::openmldb::base::Slice(kv.second), time, block);
+            if (!extracting) {
+                segment->Put(::openmldb::base::Slice(kv.second), time, block);
+            } else if (!segment->PutIfAbsent(::openmldb::base::Slice(kv.second), time, block)) {
+                // the extraction has put the block with its own reference
+                block->Unref();
+            }
         }
     }
     record_cnt_.fetch_add(1, std::memory_order_relaxed);
     record_byte_size_.fetch_add(GetRecordSize(value.length()));
+    for (const auto& kv : inner_index_key_map) {
+        IncrKeyVersion(kv.second.data(), kv.second.size());
+    }
+    UpdateAggregators(dimensions, nullptr, time, value);
     return true;
 }
 
@@ -240,11 +425,12 @@ bool MemTable::Put(const Dimensions& dimensions, const TSDimensions& ts_dimensio
     for (const auto& kv : inner_index_key_map) {
         auto inner_index = table_index_.GetInnerIndex(kv.first);
         bool need_put = false;
+        bool extracting = false;
         for (const auto& index_def : inner_index->GetIndex()) {
             if (index_def->IsReady()) {
                 // TODO(hw): if we don't find this ts(has_found_ts==false), but it's ready, will put too?
                 need_put = true;
-                break;
+                extracting = extracting || index_def->IsExtracting();
             }
         }
         if (need_put) {
@@ -253,14 +439,53 @@ bool MemTable::Put(const Dimensions& dimensions, const TSDimensions& ts_dimensio
                 seg_idx = ::openmldb::base::hash(kv.second.data(), kv.second.size(), SEED) % seg_cnt_;
             }
             Segment* segment = segments_[kv.first][seg_idx];
-            segment->Put(::openmldb::base::Slice(kv.second), ts_dimensions, block);
+            if (!extracting) {
+                segment->Put(::openmldb::base::Slice(kv.second), ts_dimensions, block);
+            } else if (!segment->PutIfAbsent(::openmldb::base::Slice(kv.second), ts_dimensions, block)) {
+                // the extraction has put the block with its own reference
+                block->Unref();
+            }
         }
     }
     record_cnt_.fetch_add(1, std::memory_order_relaxed);
     record_byte_size_.fetch_add(GetRecordSize(value.length()));
+    for (const auto& kv : inner_index_key_map) {
+        IncrKeyVersion(kv.second.data(), kv.second.size());
+    }
+    UpdateAggregators(dimensions, &ts_dimensions, 0, value);
     return true;
 }
 
+void MemTable::UpdateAggregators(const Dimensions& dimensions, const TSDimensions* ts_dimensions, uint64_t time,
+                                 const std::string& value) {
+    auto aggregators = std::atomic_load_explicit(&aggregators_, std::memory_order_acquire);
+    for (const auto& aggregator : *aggregators) {
+        for (const auto& dimension : dimensions) {
+            if (dimension.idx() != aggregator->GetIndexId()) {
+                continue;
+            }
+            uint64_t ts = time;
+            if (ts_dimensions != nullptr) {
+                // the same ts as the segment puts the row with
+                bool found = false;
+                for (const auto& ts_dimension : *ts_dimensions) {
+                    if (ts_dimensions->size() == 1 ||
+                        static_cast<int32_t>(ts_dimension.idx()) == aggregator->GetTsIdx()) {
+                        ts = ts_dimension.ts();
+                        found = true;
+                        break;
+                    }
+                }
+                if (!found) {
+                    break;
+                }
+            }
+            aggregator->Update(dimension.key(), ts, Slice(value));
+            break;
+        }
+    }
+}
+
 bool MemTable::Put(const Slice& pk, uint64_t time, DataBlock* row, uint32_t idx) {
     std::shared_ptr<IndexDef> index_def = GetIndex(idx);
     if (!index_def || !index_def->IsReady()) {
@@ -276,6 +501,71 @@ bool MemTable::Put(const Slice& pk, uint64_t time, DataBlock* row, uint32_t idx)
     return true;
 }
 
+bool MemTable::PutIfAbsent(const ::openmldb::api::LogEntry& entry, ReplayCounts* replayed) {
+    Slice value(entry.value());
+    // true if the list holds no more of the row than the ones replayed before, the replayed row is counted
+    auto is_absent = [&](Segment* segment, uint32_t inner_pos, const std::string& key, uint32_t key_entry_id,
+                         uint64_t time) {
+        uint32_t& same_cnt = (*replayed)[std::make_tuple(inner_pos, key, time, entry.value())];
+        return segment->CountSame(Slice(key), key_entry_id, time, value) <= same_cnt++;
+    };
+    if (entry.dimensions_size() == 0) {
+        uint32_t seg_idx = 0;
+        if (seg_cnt_ > 1) {
+            seg_idx = ::openmldb::base::hash(entry.pk().c_str(), entry.pk().length(), SEED) % seg_cnt_;
+        }
+        if (!is_absent(segments_[0][seg_idx], 0, entry.pk(), 0, entry.ts())) {
+            return true;
+        }
+        return Table::Put(entry);
+    }
+    Dimensions absent_dimensions;
+    for (const auto& dimension : entry.dimensions()) {
+        int32_t inner_pos = table_index_.GetInnerIndexPos(dimension.idx());
+        if (inner_pos < 0) {
+            PDLOG(WARNING, "invalid dimension. dimension idx %u, tid %u pid %u", dimension.idx(), id_, pid_);
+            return false;
+        }
+        uint32_t seg_idx = 0;
+        if (seg_cnt_ > 1) {
+            seg_idx = ::openmldb::base::hash(dimension.key().c_str(), dimension.key().length(), SEED) % seg_cnt_;
+        }
+        Segment* segment = segments_[inner_pos][seg_idx];
+        // the row is put into all the ts lists of a segment or none of them, so one list is enough
+        bool absent = false;
+        if (entry.ts_dimensions_size() == 0) {
+            absent = is_absent(segment, inner_pos, dimension.key(), 0, entry.ts());
+        } else if (entry.ts_dimensions_size() == 1 && segment->GetTsCnt() == 1) {
+            absent = is_absent(segment, inner_pos, dimension.key(), 0, entry.ts_dimensions(0).ts());
+        } else {
+            for (const auto& ts_dimension : entry.ts_dimensions()) {
+                uint32_t real_idx = 0;
+                if (segment->GetTsIdx(ts_dimension.idx(), real_idx) == 0) {
+                    absent = is_absent(segment, inner_pos, dimension.key(), real_idx, ts_dimension.ts());
+                    break;
+                }
+            }
+        }
+        if (absent) {
+            absent_dimensions.Add()->CopyFrom(dimension);
+        }
+    }
+    if (absent_dimensions.size() == entry.dimensions_size()) {
+        return Table::Put(entry);
+    }
+    if (absent_dimensions.empty()) {
+        return true;
+    }
+    // the record is counted when it's loaded from the checkpoint
+    bool ok = entry.ts_dimensions_size() > 0 ? Put(absent_dimensions, entry.ts_dimensions(), entry.value())
+                                             : Put(entry.ts(), entry.value(), absent_dimensions);
+    if (ok) {
+        record_cnt_.fetch_sub(1, std::memory_order_relaxed);
+        record_byte_size_.fetch_sub(GetRecordSize(entry.value().length()));
+    }
+    return ok;
+}
+
 bool MemTable::Delete(const std::string& pk, uint32_t idx) {
     std::shared_ptr<IndexDef> index_def = GetIndex(idx);
     if (!index_def || !index_def->IsReady()) {
@@ -288,7 +578,18 @@ bool MemTable::Delete(const std::string& pk, uint32_t idx) {
     }
     uint32_t real_idx = index_def->GetInnerPos();
     Segment* segment = segments_[real_idx][seg_idx];
-    return segment->Delete(spk);
+    bool ok = segment->Delete(spk);
+    if (cold_tier_) {
+        ok = cold_tier_->Delete(pk, idx) || ok;
+    }
+    IncrKeyVersion(pk.data(), pk.size());
+    auto aggregators = std::atomic_load_explicit(&aggregators_, std::memory_order_acquire);
+    for (const auto& aggregator : *aggregators) {
+        if (aggregator->GetIndexId() == idx) {
+            aggregator->Delete(pk);
+        }
+    }
+    return ok;
 }
 
 uint64_t MemTable::Release() {
@@ -312,15 +613,35 @@ uint64_t MemTable::Release() {
 }
 
 void MemTable::SchedGc() {
+    std::unique_lock<std::mutex> gc_lock(gc_mu_, std::try_to_lock);
+    if (!gc_lock.owns_lock()) {
+        PDLOG(INFO, "index is extracting from memory, skip gc for table %s, tid %u, pid %u", name_.c_str(), id_,
+              pid_);
+        return;
+    }
     uint64_t consumed = ::baidu::common::timer::get_micros();
     PDLOG(INFO, "start making gc for table %s, tid %u, pid %u", name_.c_str(), id_, pid_);
     uint64_t gc_idx_cnt = 0;
     uint64_t gc_record_cnt = 0;
     uint64_t gc_record_byte_size = 0;
+    uint64_t move_idx_cnt = 0;
+    uint64_t move_record_cnt = 0;
+    uint64_t move_record_byte_size = 0;
+    uint64_t cold_time = ::baidu::common::timer::get_micros() / 1000 - cold_age_;
+    bool cold_check = cold_check_.load(std::memory_order_relaxed);
+    RecordWriter cold_writer = [this, cold_check](uint32_t index_id, const Slice& key, uint64_t time,
+                                                  const Slice& value) {
+        if (cold_check && cold_tier_->Contains(index_id, key, time, value)) {
+            return;
+        }
+        cold_tier_->Put(key, time, value, index_id);
+    };
     auto inner_indexs = table_index_.GetAllInnerIndex();
     for (uint32_t i = 0; i < inner_indexs->size(); i++) {
         const std::vector<std::shared_ptr<IndexDef>>& real_index = inner_indexs->at(i)->GetIndex();
         std::map<uint32_t, TTLSt> ttl_st_map;
+        // the ts index of the lists moved into the cold tier and their index ids
+        std::map<uint32_t, uint32_t> cold_index_map;
         bool need_gc = true;
         size_t deleted_num = 0;
         for (size_t pos = 0; pos < real_index.size(); pos++) {
@@ -331,6 +652,13 @@ void MemTable::SchedGc() {
             } else {
                 ttl_st_map.emplace(0, *(cur_index->GetTTL()));
             }
+            if (cold_tier_ && cur_index->IsReady()) {
+                // an index added after the cold tier is opened is kept in memory
+                auto cold_index = cold_tier_->GetIndex(cur_index->GetName());
+                if (cold_index && cold_index->IsReady() && cold_index->GetId() == cur_index->GetId()) {
+                    cold_index_map.emplace(ts_col ? ts_col->GetTsIdx() : 0, cur_index->GetId());
+                }
+            }
             if (cur_index->GetStatus() == IndexStatus::kWaiting) {
                 cur_index->SetStatus(IndexStatus::kDeleting);
                 need_gc = false;
@@ -366,19 +694,43 @@ void MemTable::SchedGc() {
             } else {
                 segment->ExecuteGc(ttl_st_map, gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
             }
+            if (!cold_index_map.empty()) {
+                segment->MoveRecords(cold_time, cold_index_map, cold_writer, move_idx_cnt, move_record_cnt,
+                                     move_record_byte_size);
+            }
+            segment->SealTimeBlocks();
             seg_gc_time = ::baidu::common::timer::get_micros() / 1000 - seg_gc_time;
             PDLOG(INFO, "gc segment[%u][%u] done consumed %lu for table %s tid %u pid %u", i, j, seg_gc_time,
                   name_.c_str(), id_, pid_);
         }
     }
     consumed = ::baidu::common::timer::get_micros() - consumed;
-    record_cnt_.fetch_sub(gc_record_cnt, std::memory_order_relaxed);
-    record_byte_size_.fetch_sub(gc_record_byte_size, std::memory_order_relaxed);
+    record_cnt_.fetch_sub(gc_record_cnt + move_record_cnt, std::memory_order_relaxed);
+    record_byte_size_.fetch_sub(gc_record_byte_size + move_record_byte_size, std::memory_order_relaxed);
     PDLOG(INFO,
           "gc finished, gc_idx_cnt %lu, gc_record_cnt %lu consumed %lu ms for "
           "table %s tid %u pid %u",
           gc_idx_cnt, gc_record_cnt, consumed / 1000, name_.c_str(), id_, pid_);
+    if (cold_tier_ && enable_gc_.load(std::memory_order_relaxed)) {
+        PDLOG(INFO, "move %lu idx and %lu records into cold tier for table %s tid %u pid %u", move_idx_cnt,
+              move_record_cnt, name_.c_str(), id_, pid_);
+        cold_check_.store(false, std::memory_order_relaxed);
+        // the rows moved are durable once they are flushed
+        cold_tier_->Flush();
+        cold_tier_->SchedGc();
+    }
+    auto aggregators = std::atomic_load_explicit(&aggregators_, std::memory_order_acquire);
+    for (const auto& aggregator : *aggregators) {
+        std::shared_ptr<IndexDef> index_def = GetIndex(aggregator->GetIndexId());
+        if (index_def) {
+            uint64_t expire_time = GetExpireTime(*(index_def->GetTTL()));
+            if (expire_time > 0) {
+                aggregator->Expire(expire_time);
+            }
+        }
+    }
     UpdateTTL();
+    UpdateLatestBound();
 }
 
 // tll as ms
@@ -391,18 +743,31 @@ uint64_t MemTable::GetExpireTime(const TTLSt& ttl_st) {
     return cur_time - ttl_st.abs_ttl;
 }
 
-bool MemTable::CheckLatest(uint32_t index_id, const std::string& key, uint64_t ts) {
+bool MemTable::CheckLatest(uint32_t index_id, const std::string& key, uint64_t ts, uint64_t lat_ttl) {
     ::openmldb::storage::Ticket ticket;
     ::openmldb::storage::TableIterator* it = NewIterator(index_id, key, ticket);
-    it->SeekToLast();
-    if (it->Valid()) {
-        if (ts >= it->GetKey()) {
-            delete it;
-            return false;
+    if (it == NULL) {
+        return true;
+    }
+    uint64_t oldest = 0;
+    bool has_row = false;
+    if (cold_tier_) {
+        // both tiers keep lat_ttl rows, only the latest lat_ttl rows of them are kept by the ttl
+        it->SeekToFirst();
+        for (uint64_t cnt = 0; it->Valid() && cnt < lat_ttl; cnt++) {
+            oldest = it->GetKey();
+            has_row = true;
+            it->Next();
+        }
+    } else {
+        it->SeekToLast();
+        if (it->Valid()) {
+            oldest = it->GetKey();
+            has_row = true;
         }
     }
     delete it;
-    return true;
+    return !has_row || ts < oldest;
 }
 
 inline bool MemTable::CheckAbsolute(const TTLSt& ttl_st, uint64_t ts) {
@@ -464,16 +829,16 @@ bool MemTable::IsExpire(const LogEntry& entry) {
             uint32_t index_id = index_def->GetId();
             switch (ttl_type) {
                 case ::openmldb::storage::TTLType::kLatestTime:
-                    is_expire = CheckLatest(index_id, kv.second, ts);
+                    is_expire = CheckLatest(index_id, kv.second, ts, ttl->lat_ttl);
                     break;
                 case ::openmldb::storage::TTLType::kAbsoluteTime:
                     is_expire = CheckAbsolute(*ttl, ts);
                     break;
                 case ::openmldb::storage::TTLType::kAbsOrLat:
-                    is_expire = CheckAbsolute(*ttl, ts) || CheckLatest(index_id, kv.second, ts);
+                    is_expire = CheckAbsolute(*ttl, ts) || CheckLatest(index_id, kv.second, ts, ttl->lat_ttl);
                     break;
                 case ::openmldb::storage::TTLType::kAbsAndLat:
-                    is_expire = CheckAbsolute(*ttl, ts) && CheckLatest(index_id, kv.second, ts);
+                    is_expire = CheckAbsolute(*ttl, ts) && CheckLatest(index_id, kv.second, ts, ttl->lat_ttl);
                     break;
                 default:
                     return true;
@@ -499,10 +864,33 @@ int MemTable::GetCount(uint32_t index, const std::string& pk, uint64_t& count) {
     uint32_t real_idx = index_def->GetInnerPos();
     Segment* segment = segments_[real_idx][seg_idx];
     auto ts_col = index_def->GetTsColumn();
-    if (ts_col) {
-        return segment->GetCount(spk, ts_col->GetTsIdx(), count);
+    if (cold_tier_ && cold_check_.load(std::memory_order_relaxed)) {
+        // the rows recovered after a restart may be in both tiers until the next gc, count them by the merged rows
+        Ticket ticket;
+        std::unique_ptr<TableIterator> it(NewIterator(index, pk, ticket));
+        if (!it) {
+            return -1;
+        }
+        count = 0;
+        for (it->SeekToFirst(); it->Valid(); it->Next()) {
+            count++;
+        }
+        return 0;
+    }
+    int ret = ts_col ? segment->GetCount(spk, ts_col->GetTsIdx(), count) : segment->GetCount(spk, count);
+    if (!cold_tier_) {
+        return ret;
     }
-    return segment->GetCount(spk, count);
+    // the key may be only in the cold tier when all of its rows are moved
+    if (ret < 0) {
+        count = 0;
+    }
+    uint64_t cold_cnt = 0;
+    if (cold_tier_->GetCount(index, pk, &cold_cnt) < 0 || (ret < 0 && cold_cnt == 0)) {
+        return ret;
+    }
+    count += cold_cnt;
+    return 0;
 }
 
 TableIterator* MemTable::NewIterator(const std::string& pk, Ticket& ticket) { return NewIterator(0, pk, ticket); }
@@ -521,10 +909,19 @@ TableIterator* MemTable::NewIterator(uint32_t index, const std::string& pk, Tick
     uint32_t real_idx = index_def->GetInnerPos();
     Segment* segment = segments_[real_idx][seg_idx];
     auto ts_col = index_def->GetTsColumn();
+    TableIterator* it = NULL;
     if (ts_col) {
-        return segment->NewIterator(spk, ts_col->GetTsIdx(), ticket);
+        it = segment->NewIterator(spk, ts_col->GetTsIdx(), ticket);
+    } else {
+        it = segment->NewIterator(spk, ticket);
+    }
+    if (cold_tier_) {
+        TableIterator* cold_it = cold_tier_->NewIterator(index, pk, ticket);
+        if (cold_it != NULL) {
+            return new TieredTableIterator(it, cold_it);
+        }
     }
-    return segment->NewIterator(spk, ticket);
+    return it;
 }
 
 uint64_t MemTable::GetRecordIdxByteSize() {
@@ -634,13 +1031,13 @@ bool MemTable::AddIndex(const ::openmldb::common::ColumnKey& column_key) {
         Segment** seg_arr = new Segment*[seg_cnt_];
         if (!ts_vec.empty()) {
             for (uint32_t j = 0; j < seg_cnt_; j++) {
-                seg_arr[j] = new Segment(FLAGS_absolute_default_skiplist_height, ts_vec);
+                seg_arr[j] = new Segment(FLAGS_absolute_default_skiplist_height, ts_vec, table_meta_->key_index_type());
                 PDLOG(INFO, "init %u, %u segment. height %u, ts col num %u. tid %u pid %u", inner_id, j,
                       FLAGS_absolute_default_skiplist_height, ts_vec.size(), id_, pid_);
             }
         } else {
             for (uint32_t j = 0; j < seg_cnt_; j++) {
-                seg_arr[j] = new Segment(FLAGS_absolute_default_skiplist_height);
+                seg_arr[j] = new Segment(FLAGS_absolute_default_skiplist_height, table_meta_->key_index_type());
                 PDLOG(INFO, "init %u, %u segment. height %u tid %u pid %u", inner_id, j,
                       FLAGS_absolute_default_skiplist_height, id_, pid_);
             }
@@ -667,8 +1064,237 @@ bool MemTable::AddIndex(const ::openmldb::common::ColumnKey& column_key) {
         table_index_.AddInnerIndex(inner_index_st);
         table_index_.SetInnerIndexPos(new_table_meta->column_key_size() - 1, inner_id);
     }
+    // the index may be filled by ExtractIndexFromMemory, every put which sees the index ready skips the rows it
+    // extracts until it's done
+    index_def->SetExtracting(true);
     index_def->SetStatus(IndexStatus::kReady);
     std::atomic_store_explicit(&table_meta_, new_table_meta, std::memory_order_release);
+    UpdateLatestBound();
+    return true;
+}
+
+static bool IsSameColumns(const ::openmldb::common::ColumnKey& a, const ::openmldb::common::ColumnKey& b) {
+    if (a.col_name_size() != b.col_name_size()) {
+        return false;
+    }
+    for (int i = 0; i < a.col_name_size(); i++) {
+        if (a.col_name(i) != b.col_name(i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// whether the index with ttl keeps every record the index with new_ttl keeps. They have the same ts column,
+// the latest ttl is compared only if they have the same key columns
+static bool IsTTLCovered(const TTLSt& ttl, const TTLSt& new_ttl, bool same_key) {
+    if (!ttl.NeedGc()) {
+        return true;
+    }
+    if (ttl.ttl_type == TTLType::kAbsoluteTime && new_ttl.ttl_type == TTLType::kAbsoluteTime) {
+        return new_ttl.abs_ttl != 0 && ttl.abs_ttl >= new_ttl.abs_ttl;
+    }
+    return same_key && ttl.ttl_type == new_ttl.ttl_type && ttl.abs_ttl == new_ttl.abs_ttl &&
+           ttl.lat_ttl == new_ttl.lat_ttl;
+}
+
+bool MemTable::ExtractIndexFromMemory(const std::string& index_name, uint32_t partition_num, uint64_t* count) {
+    std::shared_ptr<IndexDef> index_def = GetIndex(index_name);
+    if (!index_def || !index_def->IsReady()) {
+        PDLOG(WARNING, "index %s is not ready. tid %u pid %u", index_name.c_str(), id_, pid_);
+        return false;
+    }
+    auto table_meta = GetTableMeta();
+    const ::openmldb::common::ColumnKey* column_key = nullptr;
+    for (const auto& cur_key : table_meta->column_key()) {
+        if (cur_key.index_name() == index_name) {
+            column_key = &cur_key;
+            break;
+        }
+    }
+    if (column_key == nullptr) {
+        PDLOG(WARNING, "index %s is not in table meta. tid %u pid %u", index_name.c_str(), id_, pid_);
+        return false;
+    }
+    std::shared_ptr<IndexDef> src_index;
+    bool same_key = false;
+    for (const auto& cur_key : table_meta->column_key()) {
+        if (cur_key.index_name() == index_name || cur_key.ts_name() != column_key->ts_name()) {
+            continue;
+        }
+        std::shared_ptr<IndexDef> cur_index = GetIndex(cur_key.index_name());
+        if (!cur_index || !cur_index->IsReady()) {
+            continue;
+        }
+        bool cur_same_key = IsSameColumns(cur_key, *column_key);
+        if (!cur_same_key && partition_num != 1) {
+            continue;
+        }
+        if (!IsTTLCovered(*(cur_index->GetTTL()), *(index_def->GetTTL()), cur_same_key)) {
+            continue;
+        }
+        if (!src_index || (cur_same_key && !same_key)) {
+            src_index = cur_index;
+            same_key = cur_same_key;
+        }
+    }
+    if (!src_index) {
+        PDLOG(INFO, "no index can be extracted to index %s in memory. tid %u pid %u", index_name.c_str(), id_, pid_);
+        return false;
+    }
+    // the key of the new index is decoded from the row if the key columns are different
+    std::vector<uint32_t> index_cols;
+    uint32_t max_idx = 0;
+    if (!same_key) {
+        std::map<std::string, uint32_t> column_desc_map;
+        for (int32_t i = 0; i < table_meta->column_desc_size(); ++i) {
+            column_desc_map.emplace(table_meta->column_desc(i).name(), i);
+        }
+        uint32_t base_size = table_meta->column_desc_size();
+        for (int32_t i = 0; i < table_meta->added_column_desc_size(); ++i) {
+            column_desc_map.emplace(table_meta->added_column_desc(i).name(), i + base_size);
+        }
+        for (const auto& name : column_key->col_name()) {
+            auto iter = column_desc_map.find(name);
+            if (iter == column_desc_map.end()) {
+                PDLOG(WARNING, "fail to find column_desc %s. tid %u pid %u", name.c_str(), id_, pid_);
+                return false;
+            }
+            index_cols.push_back(iter->second);
+            max_idx = std::max(max_idx, iter->second);
+        }
+    }
+    std::lock_guard<std::mutex> gc_lock(gc_mu_);
+    uint32_t src_inner = src_index->GetInnerPos();
+    uint32_t src_ts_idx = 0;
+    if (src_index->GetTsColumn()) {
+        segments_[src_inner][0]->GetTsIdx(src_index->GetTsColumn()->GetTsIdx(), src_ts_idx);
+    }
+    Segment** new_segments = segments_[index_def->GetInnerPos()];
+    if (new_segments[0]->GetTsCnt() > 1) {
+        PDLOG(WARNING, "index %s shares the segments with other ts columns, it can't be extracted. tid %u pid %u",
+              index_name.c_str(), id_, pid_);
+        return false;
+    }
+    bool compressed = GetCompressType() == ::openmldb::type::kSnappy;
+    uint32_t thread_num = std::max(1u, std::min(FLAGS_extract_index_thread_num, seg_cnt_));
+    uint64_t max_rate = FLAGS_extract_index_max_rate / thread_num;
+    if (FLAGS_extract_index_max_rate > 0 && max_rate == 0) {
+        max_rate = 1;
+    }
+    std::atomic<uint64_t> extract_cnt(0);
+    std::atomic<uint64_t> skip_cnt(0);
+    uint64_t start_time = ::baidu::common::timer::get_micros();
+    auto extract = [&](uint32_t thread_idx) {
+        uint64_t thread_start = ::baidu::common::timer::get_micros();
+        uint64_t thread_cnt = 0;
+        std::vector<std::string> row;
+        std::string buff;
+        std::string cur_key;
+        // the values of the records with the same time as the current one in the source list
+        std::vector<Slice> same_time;
+        uint64_t last_time = 0;
+        for (uint32_t seg_idx = thread_idx; seg_idx < seg_cnt_; seg_idx += thread_num) {
+            Segment* segment = segments_[src_inner][seg_idx];
+            std::unique_ptr<KeyEntries::Iterator> pk_it(segment->GetKeyEntries()->NewIterator());
+            for (pk_it->SeekToFirst(); pk_it->Valid(); pk_it->Next()) {
+                void* value = pk_it->GetValue();
+                KeyEntry* entry = segment->GetTsCnt() > 1 ? ((KeyEntry**)value)[src_ts_idx]  // NOLINT
+                                                          : (KeyEntry*)value;                // NOLINT
+                std::unique_ptr<KeyEntryIterator> it(entry->NewIterator());
+                same_time.clear();
+                for (it->SeekToFirst(); it->Valid(); it->Next()) {
+                    Slice value = it->GetValue();
+                    if (!same_time.empty() && it->GetKey() != last_time) {
+                        same_time.clear();
+                    }
+                    last_time = it->GetKey();
+                    uint32_t same_cnt = 0;
+                    for (const auto& cur : same_time) {
+                        if (cur.size() == value.size() && memcmp(cur.data(), value.data(), value.size()) == 0) {
+                            same_cnt++;
+                        }
+                    }
+                    same_time.push_back(value);
+                    if (same_key) {
+                        cur_key.assign(pk_it->GetKey().data(), pk_it->GetKey().size());
+                    } else {
+                        const int8_t* raw = reinterpret_cast<const int8_t*>(value.data());
+                        uint32_t size = value.size();
+                        if (compressed) {
+                            buff.clear();
+                            snappy::Uncompress(value.data(), value.size(), &buff);
+                            raw = reinterpret_cast<const int8_t*>(buff.data());
+                            size = buff.size();
+                        }
+                        std::shared_ptr<Schema> schema =
+                            GetVersionSchema(::openmldb::codec::RowView::GetSchemaVersion(raw));
+                        row.clear();
+                        if (schema == nullptr || schema->size() < static_cast<int>(max_idx + 1) ||
+                            !::openmldb::codec::RowCodec::DecodeRow(*schema, raw, size, true, 0, max_idx + 1, row)) {
+                            skip_cnt.fetch_add(1, std::memory_order_relaxed);
+                            continue;
+                        }
+                        cur_key.clear();
+                        for (uint32_t i : index_cols) {
+                            if (!cur_key.empty()) {
+                                cur_key.append("|");
+                            }
+                            cur_key.append(row[i]);
+                        }
+                        if (cur_key.empty()) {
+                            skip_cnt.fetch_add(1, std::memory_order_relaxed);
+                            continue;
+                        }
+                    }
+                    uint32_t new_seg_idx = 0;
+                    if (seg_cnt_ > 1) {
+                        new_seg_idx = ::openmldb::base::hash(cur_key.c_str(), cur_key.length(), SEED) % seg_cnt_;
+                    }
+                    // the record which is put after the index is added may be in the new index already. A record
+                    // sealed in a time block has no data block to share, it's copied to a new one
+                    Segment* new_segment = new_segments[new_seg_idx];
+                    DataBlock* block = it->GetBlock();
+                    if (block != NULL) {
+                        if (new_segment->PutBlockIfAbsent(Slice(cur_key), it->GetKey(), block)) {
+                            extract_cnt.fetch_add(1, std::memory_order_relaxed);
+                        }
+                    } else {
+                        block = new DataBlock(1, value.data(), value.size());
+                        if (new_segment->PutCopyIfAbsent(Slice(cur_key), it->GetKey(), block, same_cnt)) {
+                            extract_cnt.fetch_add(1, std::memory_order_relaxed);
+                            record_cnt_.fetch_add(1, std::memory_order_relaxed);
+                            record_byte_size_.fetch_add(GetRecordSize(value.size()), std::memory_order_relaxed);
+                        } else {
+                            delete block;
+                        }
+                    }
+                    thread_cnt++;
+                    if (max_rate > 0 && thread_cnt % 1000 == 0) {
+                        uint64_t expect = thread_cnt * 1000000 / max_rate;
+                        uint64_t cost = ::baidu::common::timer::get_micros() - thread_start;
+                        if (cost < expect) {
+                            std::this_thread::sleep_for(std::chrono::microseconds(expect - cost));
+                        }
+                    }
+                }
+            }
+        }
+    };
+    std::vector<std::thread> threads;
+    for (uint32_t i = 0; i < thread_num; i++) {
+        threads.emplace_back(extract, i);
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    index_def->SetExtracting(false);
+    *count = extract_cnt.load(std::memory_order_relaxed);
+    PDLOG(INFO,
+          "extract index %s from index %s in memory. extract num %lu skip num %lu thread num %u consumed %lu ms. "
+          "tid %u pid %u",
+          index_name.c_str(), src_index->GetName().c_str(), *count, skip_cnt.load(std::memory_order_relaxed),
+          thread_num, (::baidu::common::timer::get_micros() - start_time) / 1000, id_, pid_);
     return true;
 }
 
@@ -693,6 +1319,13 @@ bool MemTable::DeleteIndex(const std::string& idx_name) {
     }
     std::atomic_store_explicit(&table_meta_, new_table_meta, std::memory_order_release);
     index_def->SetStatus(IndexStatus::kWaiting);
+    if (cold_tier_) {
+        // the rows of the index in the cold tier are dropped by its next compaction
+        auto cold_index = cold_tier_->GetIndex(idx_name);
+        if (cold_index) {
+            cold_index->SetStatus(IndexStatus::kDeleted);
+        }
+    }
     return true;
 }
 
@@ -715,6 +1348,10 @@ bool MemTable::DeleteIndex(const std::string& idx_name) {
     if (ts_col) {
         ts_idx = ts_col->GetTsIdx();
     }
+    if (cold_tier_) {
+        return new TieredKeyIterator(segments_[real_idx], seg_cnt_, cold_tier_.get(), index, ttl->ttl_type,
+                                     expire_time, expire_cnt, ts_idx);
+    }
     return new MemTableKeyIterator(segments_[real_idx], seg_cnt_, ttl->ttl_type, expire_time, expire_cnt, ts_idx);
 }
 
@@ -733,6 +1370,11 @@ TableIterator* MemTable::NewTraverseIterator(uint32_t index) {
     }
     uint32_t real_idx = index_def->GetInnerPos();
     auto ts_col = index_def->GetTsColumn();
+    if (cold_tier_) {
+        return new TieredTraverseIterator(new TieredKeyIterator(segments_[real_idx], seg_cnt_, cold_tier_.get(),
+                                                                index, ttl->ttl_type, expire_time, expire_cnt,
+                                                                ts_col ? ts_col->GetTsIdx() : 0));
+    }
     if (ts_col) {
         return new MemTableTraverseIterator(segments_[real_idx], seg_cnt_, ttl->ttl_type, expire_time, expire_cnt,
                                             ts_col->GetTsIdx());
@@ -813,7 +1455,7 @@ bool MemTable::BulkLoad(const std::vector<DataBlock*>& data_blocks,
                         VLOG(1) << "do segment(" << real_idx << "-" << seg_idx << ") put, key" << pk.ToString()
                                 << ", time " << time_entry.time() << ", key_entry_id " << key_entry_id << ", block id "
                                 << time_entry.block_id();
-                        block->dim_cnt_down++;
+                        block->Ref();
                         segment->BulkLoadPut(key_entry_id, pk, time_entry.time(), block);
                     }
                 }
@@ -847,7 +1489,6 @@ MemTableKeyIterator::~MemTableKeyIterator() {
 }
 
 void MemTableKeyIterator::SeekToFirst() {
-    ticket_.Pop();
     if (pk_it_ != NULL) {
         delete pk_it_;
         pk_it_ = NULL;
@@ -866,7 +1507,6 @@ void MemTableKeyIterator::Seek(const std::string& key) {
         delete pk_it_;
         pk_it_ = NULL;
     }
-    ticket_.Pop();
     if (seg_cnt_ > 1) {
         seg_idx_ = ::openmldb::base::hash(key.c_str(), key.length(), SEED) % seg_cnt_;
     }
@@ -886,30 +1526,24 @@ bool MemTableKeyIterator::Valid() {
 void MemTableKeyIterator::Next() { NextPK(); }
 
 ::hybridse::vm::RowIterator* MemTableKeyIterator::GetRawValue() {
-    TimeEntries::Iterator* it = NULL;
+    KeyEntryIterator* it = NULL;
     if (segments_[seg_idx_]->GetTsCnt() > 1) {
         KeyEntry* entry = ((KeyEntry**)pk_it_->GetValue())[ts_idx_];  // NOLINT
-        it = entry->entries.NewIterator();
-        ticket_.Push(entry);
+        it = entry->NewIterator();
     } else {
-        it = ((KeyEntry*)pk_it_->GetValue())  // NOLINT
-                 ->entries.NewIterator();
-        ticket_.Push((KeyEntry*)pk_it_->GetValue());  // NOLINT
+        it = ((KeyEntry*)pk_it_->GetValue())->NewIterator();  // NOLINT
     }
     it->SeekToFirst();
     return new MemTableWindowIterator(it, ttl_type_, expire_time_, expire_cnt_);
 }
 
 std::unique_ptr<::hybridse::vm::RowIterator> MemTableKeyIterator::GetValue() {
-    TimeEntries::Iterator* it = NULL;
+    KeyEntryIterator* it = NULL;
     if (segments_[seg_idx_]->GetTsCnt() > 1) {
         KeyEntry* entry = ((KeyEntry**)pk_it_->GetValue())[ts_idx_];  // NOLINT
-        it = entry->entries.NewIterator();
-        ticket_.Push(entry);
+        it = entry->NewIterator();
     } else {
-        it = ((KeyEntry*)pk_it_->GetValue())  // NOLINT
-                 ->entries.NewIterator();
-        ticket_.Push((KeyEntry*)pk_it_->GetValue());  // NOLINT
+        it = ((KeyEntry*)pk_it_->GetValue())->NewIterator();  // NOLINT
     }
     it->SeekToFirst();
     std::unique_ptr<MemTableWindowIterator> wit(new MemTableWindowIterator(it, ttl_type_, expire_time_, expire_cnt_));
@@ -924,7 +1558,6 @@ const hybridse::codec::Row MemTableKeyIterator::GetKey() {
 
 void MemTableKeyIterator::NextPK() {
     do {
-        ticket_.Pop();
         if (pk_it_->Valid()) {
             pk_it_->Next();
         }
@@ -988,7 +1621,6 @@ void MemTableTraverseIterator::NextPK() {
     delete it_;
     it_ = NULL;
     do {
-        ticket_.Pop();
         if (pk_it_->Valid()) {
             pk_it_->Next();
         }
@@ -1012,12 +1644,9 @@ void MemTableTraverseIterator::NextPK() {
         }
         if (segments_[seg_idx_]->GetTsCnt() > 1) {
             KeyEntry* entry = ((KeyEntry**)pk_it_->GetValue())[0];  // NOLINT
-            it_ = entry->entries.NewIterator();
-            ticket_.Push(entry);
+            it_ = entry->NewIterator();
         } else {
-            it_ = ((KeyEntry*)pk_it_->GetValue())  // NOLINT
-                      ->entries.NewIterator();
-            ticket_.Push((KeyEntry*)pk_it_->GetValue());  // NOLINT
+            it_ = ((KeyEntry*)pk_it_->GetValue())->NewIterator();  // NOLINT
         }
         it_->SeekToFirst();
         record_idx_ = 1;
@@ -1037,7 +1666,6 @@ void MemTableTraverseIterator::Seek(const std::string& key, uint64_t ts) {
         delete it_;
         it_ = NULL;
     }
-    ticket_.Pop();
     if (seg_cnt_ > 1) {
         seg_idx_ = ::openmldb::base::hash(key.c_str(), key.length(), SEED) % seg_cnt_;
     }
@@ -1047,12 +1675,9 @@ void MemTableTraverseIterator::Seek(const std::string& key, uint64_t ts) {
     if (pk_it_->Valid()) {
         if (segments_[seg_idx_]->GetTsCnt() > 1) {
             KeyEntry* entry = ((KeyEntry**)pk_it_->GetValue())[ts_idx_];  // NOLINT
-            ticket_.Push(entry);
-            it_ = entry->entries.NewIterator();
+            it_ = entry->NewIterator();
         } else {
-            ticket_.Push((KeyEntry*)pk_it_->GetValue());  // NOLINT
-            it_ = ((KeyEntry*)pk_it_->GetValue())         // NOLINT
-                      ->entries.NewIterator();
+            it_ = ((KeyEntry*)pk_it_->GetValue())->NewIterator();  // NOLINT
         }
         if (spk.compare(pk_it_->GetKey()) != 0) {
             it_->SeekToFirst();
@@ -1091,7 +1716,13 @@ void MemTableTraverseIterator::Seek(const std::string& key, uint64_t ts) {
 }
 
 openmldb::base::Slice MemTableTraverseIterator::GetValue() const {
-    return openmldb::base::Slice(it_->GetValue()->data, it_->GetValue()->size);
+    openmldb::base::Slice value = it_->GetValue();
+    if (it_->IsValueBuffered()) {
+        char* buf = new char[value.size()];
+        memcpy(buf, value.data(), value.size());
+        return openmldb::base::Slice(buf, value.size(), true);
+    }
+    return value;
 }
 
 uint64_t MemTableTraverseIterator::GetKey() const {
@@ -1109,7 +1740,6 @@ std::string MemTableTraverseIterator::GetPK() const {
 }
 
 void MemTableTraverseIterator::SeekToFirst() {
-    ticket_.Pop();
     if (pk_it_ != NULL) {
         delete pk_it_;
         pk_it_ = NULL;
@@ -1124,12 +1754,9 @@ void MemTableTraverseIterator::SeekToFirst() {
         while (pk_it_->Valid()) {
             if (segments_[seg_idx_]->GetTsCnt() > 1) {
                 KeyEntry* entry = ((KeyEntry**)pk_it_->GetValue())[ts_idx_];  // NOLINT
-                ticket_.Push(entry);
-                it_ = entry->entries.NewIterator();
+                it_ = entry->NewIterator();
             } else {
-                ticket_.Push((KeyEntry*)pk_it_->GetValue());  // NOLINT
-                it_ = ((KeyEntry*)pk_it_->GetValue())         // NOLINT
-                          ->entries.NewIterator();
+                it_ = ((KeyEntry*)pk_it_->GetValue())->NewIterator();  // NOLINT
             }
             it_->SeekToFirst();
             traverse_cnt_++;
@@ -1140,7 +1767,6 @@ void MemTableTraverseIterator::SeekToFirst() {
             delete it_;
             it_ = NULL;
             pk_it_->Next();
-            ticket_.Pop();
             if (traverse_cnt_ >= FLAGS_max_traverse_cnt) {
                 return;
             }
@@ -1150,5 +1776,310 @@ void MemTableTraverseIterator::SeekToFirst() {
     }
 }
 
+TieredTableIterator::TieredTableIterator(TableIterator* hot, TableIterator* cold)
+    : hot_(hot), cold_(cold), cur_(NULL) {}
+
+TieredTableIterator::~TieredTableIterator() {
+    delete hot_;
+    delete cold_;
+}
+
+void TieredTableIterator::Pick() {
+    cur_ = NULL;
+    bool hot_valid = hot_->Valid();
+    while (cold_->Valid()) {
+        if (!hot_valid || cold_->GetKey() > hot_->GetKey()) {
+            cur_ = cold_;
+            return;
+        }
+        if (cold_->GetKey() < hot_->GetKey() || cold_->GetValue().compare(hot_->GetValue()) != 0) {
+            break;
+        }
+        // the row is being moved into the cold tier
+        cold_->Next();
+    }
+    if (hot_valid) {
+        cur_ = hot_;
+    }
+}
+
+void TieredTableIterator::Next() {
+    cur_->Next();
+    Pick();
+}
+
+void TieredTableIterator::SeekToFirst() {
+    hot_->SeekToFirst();
+    cold_->SeekToFirst();
+    Pick();
+}
+
+void TieredTableIterator::Seek(uint64_t time) {
+    hot_->Seek(time);
+    cold_->Seek(time);
+    Pick();
+}
+
+void TieredTableIterator::SeekToLast() {
+    hot_->SeekToLast();
+    cold_->SeekToLast();
+    cur_ = NULL;
+    if (hot_->Valid() && (!cold_->Valid() || hot_->GetKey() < cold_->GetKey())) {
+        cur_ = hot_;
+        cold_->Next();
+    } else if (cold_->Valid()) {
+        cur_ = cold_;
+        hot_->Next();
+    }
+}
+
+TieredWindowIterator::TieredWindowIterator(::hybridse::vm::RowIterator* hot, ::hybridse::vm::RowIterator* cold,
+                                           ::openmldb::storage::TTLType ttl_type, uint64_t expire_time,
+                                           uint64_t expire_cnt)
+    : hot_(hot), cold_(cold), cur_(NULL), record_idx_(0), expire_value_(expire_time, expire_cnt, ttl_type) {
+    SeekToFirst();
+}
+
+TieredWindowIterator::~TieredWindowIterator() {
+    delete hot_;
+    delete cold_;
+}
+
+static bool IsSameRow(const ::hybridse::codec::Row& a, const ::hybridse::codec::Row& b) {
+    return a.size() == b.size() && memcmp(a.buf(), b.buf(), a.size()) == 0;
+}
+
+void TieredWindowIterator::Pick() {
+    cur_ = NULL;
+    bool hot_valid = hot_ != NULL && hot_->Valid();
+    while (cold_ != NULL && cold_->Valid()) {
+        if (!hot_valid || cold_->GetKey() > hot_->GetKey()) {
+            cur_ = cold_;
+            return;
+        }
+        if (cold_->GetKey() < hot_->GetKey() || !IsSameRow(cold_->GetValue(), hot_->GetValue())) {
+            break;
+        }
+        cold_->Next();
+    }
+    if (hot_valid) {
+        cur_ = hot_;
+    }
+}
+
+void TieredWindowIterator::Next() {
+    cur_->Next();
+    record_idx_++;
+    Pick();
+}
+
+void TieredWindowIterator::Seek(const uint64_t& key) {
+    if (hot_ != NULL) {
+        hot_->Seek(key);
+    }
+    if (cold_ != NULL) {
+        cold_->Seek(key);
+    }
+    Pick();
+}
+
+void TieredWindowIterator::SeekToFirst() {
+    if (hot_ != NULL) {
+        hot_->SeekToFirst();
+    }
+    if (cold_ != NULL) {
+        cold_->SeekToFirst();
+    }
+    record_idx_ = 0;
+    Pick();
+}
+
+TieredKeyIterator::TieredKeyIterator(Segment** segments, uint32_t seg_cnt, DiskTable* cold_tier, uint32_t index,
+                                     ::openmldb::storage::TTLType ttl_type, uint64_t expire_time,
+                                     uint64_t expire_cnt, uint32_t ts_index)
+    : segments_(segments),
+      seg_cnt_(seg_cnt),
+      cold_tier_(cold_tier),
+      index_(index),
+      ttl_type_(ttl_type),
+      expire_time_(expire_time),
+      expire_cnt_(expire_cnt),
+      hot_(new MemTableKeyIterator(segments, seg_cnt, ttl_type, 0, 0, ts_index)),
+      cold_(cold_tier->NewWindowIterator(index)),
+      in_cold_(false) {}
+
+bool TieredKeyIterator::InMemory(const std::string& key) {
+    uint32_t seg_idx = 0;
+    if (seg_cnt_ > 1) {
+        seg_idx = ::openmldb::base::hash(key.c_str(), key.length(), SEED) % seg_cnt_;
+    }
+    void* value = NULL;
+    return segments_[seg_idx]->GetKeyEntries()->Get(Slice(key), value) == 0;
+}
+
+void TieredKeyIterator::SkipColdKeys() {
+    if (!cold_) {
+        return;
+    }
+    while (cold_->Valid()) {
+        ::hybridse::codec::Row row = cold_->GetKey();
+        if (!InMemory(std::string(reinterpret_cast<const char*>(row.buf()), row.size()))) {
+            return;
+        }
+        cold_->Next();
+    }
+}
+
+void TieredKeyIterator::SeekToFirst() {
+    hot_->SeekToFirst();
+    in_cold_ = !hot_->Valid();
+    if (in_cold_ && cold_) {
+        cold_->SeekToFirst();
+        SkipColdKeys();
+    }
+}
+
+void TieredKeyIterator::Seek(const std::string& key) {
+    hot_->Seek(key);
+    if (hot_->Valid()) {
+        ::hybridse::codec::Row row = hot_->GetKey();
+        if (key.compare(0, key.size(), reinterpret_cast<const char*>(row.buf()), row.size()) == 0 ||
+            !cold_) {
+            in_cold_ = false;
+            return;
+        }
+    }
+    // the key is in the disk tier only or is not found
+    in_cold_ = true;
+    if (cold_) {
+        cold_->Seek(key);
+        SkipColdKeys();
+    }
+}
+
+void TieredKeyIterator::Next() {
+    if (!in_cold_) {
+        hot_->Next();
+        if (hot_->Valid()) {
+            return;
+        }
+        in_cold_ = true;
+        if (cold_) {
+            cold_->SeekToFirst();
+            SkipColdKeys();
+        }
+        return;
+    }
+    if (cold_) {
+        cold_->Next();
+        SkipColdKeys();
+    }
+}
+
+bool TieredKeyIterator::Valid() {
+    if (!in_cold_) {
+        return hot_->Valid();
+    }
+    return cold_ && cold_->Valid();
+}
+
+::hybridse::vm::RowIterator* TieredKeyIterator::GetRawValue() {
+    if (in_cold_) {
+        // the ttl of the key is applied by the disk tier since all its rows are there
+        return cold_->GetRawValue();
+    }
+    ::hybridse::codec::Row row = hot_->GetKey();
+    std::string pk(reinterpret_cast<const char*>(row.buf()), row.size());
+    return new TieredWindowIterator(hot_->GetRawValue(), cold_tier_->NewRowIterator(index_, pk), ttl_type_,
+                                    expire_time_, expire_cnt_);
+}
+
+std::unique_ptr<::hybridse::vm::RowIterator> TieredKeyIterator::GetValue() {
+    return std::unique_ptr<::hybridse::vm::RowIterator>(GetRawValue());
+}
+
+const hybridse::codec::Row TieredKeyIterator::GetKey() { return in_cold_ ? cold_->GetKey() : hot_->GetKey(); }
+
+TieredTraverseIterator::TieredTraverseIterator(TieredKeyIterator* key_it)
+    : key_it_(key_it), row_it_(), pk_(), traverse_cnt_(0) {}
+
+void TieredTraverseIterator::ResetKey() {
+    ::hybridse::codec::Row row = key_it_->GetKey();
+    pk_.assign(reinterpret_cast<const char*>(row.buf()), row.size());
+    row_it_.reset(key_it_->GetRawValue());
+    row_it_->SeekToFirst();
+    traverse_cnt_++;
+}
+
+void TieredTraverseIterator::SeekKey() {
+    while (key_it_->Valid()) {
+        ResetKey();
+        if (row_it_->Valid() || traverse_cnt_ >= FLAGS_max_traverse_cnt) {
+            return;
+        }
+        key_it_->Next();
+    }
+    row_it_.reset();
+}
+
+bool TieredTraverseIterator::Valid() { return row_it_ && key_it_->Valid() && row_it_->Valid(); }
+
+void TieredTraverseIterator::Next() {
+    row_it_->Next();
+    traverse_cnt_++;
+    if (!row_it_->Valid()) {
+        key_it_->Next();
+        SeekKey();
+    }
+}
+
+void TieredTraverseIterator::SeekToFirst() {
+    key_it_->SeekToFirst();
+    SeekKey();
+}
+
+void TieredTraverseIterator::Seek(const std::string& key, uint64_t time) {
+    key_it_->Seek(key);
+    if (!key_it_->Valid()) {
+        row_it_.reset();
+        return;
+    }
+    ResetKey();
+    if (pk_ != key) {
+        if (!row_it_->Valid()) {
+            key_it_->Next();
+            SeekKey();
+        }
+        return;
+    }
+    // the rows are walked from the first one so the latest ttl counts them
+    while (row_it_->Valid() && row_it_->GetKey() >= time) {
+        row_it_->Next();
+        traverse_cnt_++;
+    }
+    if (!row_it_->Valid()) {
+        key_it_->Next();
+        SeekKey();
+    }
+}
+
+::openmldb::base::Slice TieredTraverseIterator::GetValue() const {
+    const ::hybridse::codec::Row& row = row_it_->GetValue();
+    if (!row.IsBorrowed()) {
+        // the copy of a buffered or cold row is owned by the row iterator and replaced once it moves
+        char* buf = new char[row.size()];
+        memcpy(buf, row.buf(), row.size());
+        return ::openmldb::base::Slice(buf, row.size(), true);
+    }
+    return ::openmldb::base::Slice(reinterpret_cast<const char*>(row.buf()), row.size());
+}
+
+uint64_t TieredTraverseIterator::GetKey() const {
+    if (row_it_ && row_it_->Valid()) {
+        return row_it_->GetKey();
+    }
+    return UINT64_MAX;
+}
+
 }  // namespace storage
 }  // namespace openmldb
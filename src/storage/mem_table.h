@@ -20,10 +20,14 @@
 #include <atomic>
 #include <map>
 #include <memory>
+#include <mutex>  // NOLINT
 #include <string>
+#include <tuple>
 #include <vector>
 
 #include "proto/tablet.pb.h"
+#include "storage/aggregator.h"
+#include "storage/disk_table.h"
 #include "storage/iterator.h"
 #include "storage/segment.h"
 #include "storage/table.h"
@@ -40,7 +44,7 @@ typedef google::protobuf::RepeatedPtrField<::openmldb::api::Dimension> Dimension
 
 class MemTableWindowIterator : public ::hybridse::vm::RowIterator {
  public:
-    MemTableWindowIterator(TimeEntries::Iterator* it, ::openmldb::storage::TTLType ttl_type, uint64_t expire_time,
+    MemTableWindowIterator(KeyEntryIterator* it, ::openmldb::storage::TTLType ttl_type, uint64_t expire_time,
                            uint64_t expire_cnt)
         : it_(it), record_idx_(0), expire_value_(expire_time, expire_cnt, ttl_type), row_() {}
 
@@ -62,7 +66,19 @@ class MemTableWindowIterator : public ::hybridse::vm::RowIterator {
 
     // TODO(wangtaize) unify the row object
     inline const ::hybridse::codec::Row& GetValue() {
-        row_.Reset(reinterpret_cast<const int8_t*>(it_->GetValue()->data), it_->GetValue()->size);
+        ::openmldb::base::Slice value = it_->GetValue();
+        if (it_->IsValueBuffered()) {
+            // a window may keep the row after the iterator moves to another block, so it gets its own copy
+            int8_t* buf = reinterpret_cast<int8_t*>(malloc(value.size()));
+            memcpy(buf, value.data(), value.size());
+            row_ = ::hybridse::codec::Row(::hybridse::base::RefCountedSlice::CreateManaged(buf, value.size()));
+            return row_;
+        }
+        if (!row_.IsBorrowed()) {
+            // Reset keeps the ownership of the slice, release the copy first
+            row_ = ::hybridse::codec::Row();
+        }
+        row_.Reset(reinterpret_cast<const int8_t*>(value.data()), value.size());
         return row_;
     }
     inline void Seek(const uint64_t& key) { it_->Seek(key); }
@@ -70,7 +86,7 @@ class MemTableWindowIterator : public ::hybridse::vm::RowIterator {
     inline bool IsSeekable() const { return true; }
 
  private:
-    TimeEntries::Iterator* it_;
+    KeyEntryIterator* it_;
     uint32_t record_idx_;
     TTLSt expire_value_;
     ::hybridse::codec::Row row_;
@@ -104,7 +120,7 @@ class MemTableKeyIterator : public ::hybridse::vm::WindowIterator {
     uint32_t const seg_cnt_;
     uint32_t seg_idx_;
     KeyEntries::Iterator* pk_it_;
-    TimeEntries::Iterator* it_;
+    KeyEntryIterator* it_;
     ::openmldb::storage::TTLType ttl_type_;
     uint64_t expire_time_;
     uint64_t expire_cnt_;
@@ -121,6 +137,8 @@ class MemTableTraverseIterator : public TableIterator {
     inline bool Valid() override;
     void Next() override;
     void Seek(const std::string& key, uint64_t time) override;
+    // a value uncompressed from a time block is overwritten once the iterator reads another block, so it's
+    // returned as a copy owned by the slice
     openmldb::base::Slice GetValue() const override;
     std::string GetPK() const override;
     uint64_t GetKey() const override;
@@ -135,7 +153,7 @@ class MemTableTraverseIterator : public TableIterator {
     uint32_t const seg_cnt_;
     uint32_t seg_idx_;
     KeyEntries::Iterator* pk_it_;
-    TimeEntries::Iterator* it_;
+    KeyEntryIterator* it_;
     uint32_t record_idx_;
     uint32_t ts_idx_;
     // uint64_t expire_value_;
@@ -144,6 +162,119 @@ class MemTableTraverseIterator : public TableIterator {
     uint64_t traverse_cnt_;
 };
 
+// TieredTableIterator merges the rows of a key in memory and in the disk tier in the desc order of time. A row which
+// is in both tiers while gc moves it is returned once. The values of the disk tier are copies owned by the returned
+// slices, they stay valid after Next
+class TieredTableIterator : public TableIterator {
+ public:
+    // the iterators are owned by it
+    TieredTableIterator(TableIterator* hot, TableIterator* cold);
+    ~TieredTableIterator() override;
+    bool Valid() override { return cur_ != NULL; }
+    void Next() override;
+    ::openmldb::base::Slice GetValue() const override { return cur_->GetValue(); }
+    uint64_t GetKey() const override { return cur_->GetKey(); }
+    void SeekToFirst() override;
+    void SeekToLast() override;
+    void Seek(uint64_t time) override;
+
+ private:
+    void Pick();
+
+    TableIterator* hot_;
+    TableIterator* cold_;
+    TableIterator* cur_;
+};
+
+// TieredWindowIterator is the window of a key on the rows in memory and in the disk tier, the ttl is applied to the
+// merged rows
+class TieredWindowIterator : public ::hybridse::vm::RowIterator {
+ public:
+    // the iterators are owned by it and have no ttl applied, either of them may be NULL
+    TieredWindowIterator(::hybridse::vm::RowIterator* hot, ::hybridse::vm::RowIterator* cold,
+                         ::openmldb::storage::TTLType ttl_type, uint64_t expire_time, uint64_t expire_cnt);
+    ~TieredWindowIterator() override;
+
+    bool Valid() const override {
+        return cur_ != NULL && !expire_value_.IsExpired(cur_->GetKey(), record_idx_);
+    }
+    void Next() override;
+    const uint64_t& GetKey() const override { return cur_->GetKey(); }
+    const ::hybridse::codec::Row& GetValue() override { return cur_->GetValue(); }
+    void Seek(const uint64_t& key) override;
+    void SeekToFirst() override;
+    bool IsSeekable() const override { return true; }
+
+ private:
+    void Pick();
+
+    ::hybridse::vm::RowIterator* hot_;
+    ::hybridse::vm::RowIterator* cold_;
+    ::hybridse::vm::RowIterator* cur_;
+    uint32_t record_idx_;
+    TTLSt expire_value_;
+};
+
+// TieredKeyIterator walks the keys of an index in memory first, each with the rows of the disk tier merged, and then
+// the keys which are in the disk tier only
+class TieredKeyIterator : public ::hybridse::vm::WindowIterator {
+ public:
+    TieredKeyIterator(Segment** segments, uint32_t seg_cnt, DiskTable* cold_tier, uint32_t index,
+                      ::openmldb::storage::TTLType ttl_type, uint64_t expire_time, uint64_t expire_cnt,
+                      uint32_t ts_index);
+    ~TieredKeyIterator() override {}
+
+    void Seek(const std::string& key) override;
+    void SeekToFirst() override;
+    void Next() override;
+    bool Valid() override;
+    std::unique_ptr<::hybridse::vm::RowIterator> GetValue() override;
+    ::hybridse::vm::RowIterator* GetRawValue() override;
+    const hybridse::codec::Row GetKey() override;
+
+ private:
+    bool InMemory(const std::string& key);
+    // skip the keys of the disk tier which are in memory
+    void SkipColdKeys();
+
+    Segment** segments_;
+    uint32_t const seg_cnt_;
+    DiskTable* cold_tier_;
+    uint32_t index_;
+    ::openmldb::storage::TTLType ttl_type_;
+    uint64_t expire_time_;
+    uint64_t expire_cnt_;
+    std::unique_ptr<MemTableKeyIterator> hot_;
+    std::unique_ptr<::hybridse::vm::WindowIterator> cold_;
+    bool in_cold_;
+};
+
+// TieredTraverseIterator traverses the rows of an index in memory and in the disk tier in the order of the keys of
+// TieredKeyIterator
+class TieredTraverseIterator : public TableIterator {
+ public:
+    explicit TieredTraverseIterator(TieredKeyIterator* key_it);
+    ~TieredTraverseIterator() override {}
+    bool Valid() override;
+    void Next() override;
+    void Seek(const std::string& key, uint64_t time) override;
+    ::openmldb::base::Slice GetValue() const override;
+    std::string GetPK() const override { return pk_; }
+    uint64_t GetKey() const override;
+    void SeekToFirst() override;
+    uint64_t GetCount() const override { return traverse_cnt_; }
+
+ private:
+    // move to the first key from the current one which has unexpired rows
+    void SeekKey();
+    void ResetKey();
+
+    std::unique_ptr<TieredKeyIterator> key_it_;
+    std::unique_ptr<::hybridse::vm::RowIterator> row_it_;
+    std::string pk_;
+    uint64_t traverse_cnt_;
+};
+
 class MemTable : public Table {
  public:
     MemTable(const std::string& name, uint32_t id, uint32_t pid, uint32_t seg_cnt,
@@ -188,6 +319,7 @@ class MemTable : public Table {
 
     void SchedGc() override;
 
+    // the rows of pk in both tiers, the expired ones which are not collected yet are counted too
     int GetCount(uint32_t index, const std::string& pk,
                  uint64_t& count);  // NOLINT
 
@@ -201,11 +333,17 @@ class MemTable : public Table {
 
     inline uint64_t GetRecordByteSize() const { return record_byte_size_.load(std::memory_order_relaxed); }
 
-    uint64_t GetRecordCnt() const override { return record_cnt_.load(std::memory_order_relaxed); }
+    uint64_t GetRecordCnt() const override {
+        uint64_t cnt = record_cnt_.load(std::memory_order_relaxed);
+        return cold_tier_ ? cnt + cold_tier_->GetRecordCnt() : cnt;
+    }
 
     inline uint32_t GetSegCnt() const { return seg_cnt_; }
 
-    inline void SetExpire(bool is_expire) { enable_gc_.store(is_expire, std::memory_order_relaxed); }
+    inline void SetExpire(bool is_expire) {
+        enable_gc_.store(is_expire, std::memory_order_relaxed);
+        UpdateLatestBound();
+    }
 
     uint64_t GetExpireTime(const TTLSt& ttl_st) override;
 
@@ -223,10 +361,55 @@ class MemTable : public Table {
 
     bool AddIndex(const ::openmldb::common::ColumnKey& column_key);
 
+    // the counts of the rows replayed by PutIfAbsent, keyed by the inner index, the key, the time and the value
+    using ReplayCounts = std::map<std::tuple<uint32_t, std::string, uint64_t, std::string>, uint32_t>;
+
+    // put the entry only into the inner indexes which don't have it. It's used to replay the binlog entries
+    // which may be in the checkpoint already. The i-th same row replayed at a key and time is skipped only if the
+    // list has more than i of them, so a row written twice is kept twice
+    bool PutIfAbsent(const ::openmldb::api::LogEntry& entry, ReplayCounts* replayed);
+
+    // fill the added index index_name from the segments of another ready index in memory, the data blocks are
+    // shared. The source index has the same ts column and keeps every record the new index keeps, its key columns
+    // are the same as the new index unless partition_num is 1. Return false if there is no such index.
+    // The segments are traversed in parallel and gc is skipped until it's done
+    bool ExtractIndexFromMemory(const std::string& index_name, uint32_t partition_num, uint64_t* count);
+
+    // keep the rows older than age ms in a disk table under path, gc moves them out of memory and the iterators read
+    // both tiers. It's called after Init and before the table is used
+    bool InitColdTier(const std::string& path, uint64_t age);
+
+    std::shared_ptr<DiskTable> GetColdTier() const { return cold_tier_; }
+
+    // pre-aggregate the rows of an index into time buckets, the existing rows are aggregated before it returns and
+    // info is appended to the aggregators of the table meta. The aggregators in the table meta are created by Init
+    // and filled by the recovery
+    bool AddAggregator(const ::openmldb::api::AggregatorInfo& info, std::string* msg);
+
+    // aggregate the rows in the segments by the aggregators of the table meta. It's called after the rows are loaded
+    // from a checkpoint which doesn't update the aggregators
+    void BackfillAggregators();
+
+    // the aggregator at pos of the aggregators in the table meta
+    std::shared_ptr<Aggregator> GetAggregator(uint32_t pos);
+
+    // the aggregator with the index, the function and the columns of info, the bucket size is ignored
+    std::shared_ptr<Aggregator> FindAggregator(const ::openmldb::api::AggregatorInfo& info);
+
  private:
+    // aggregate the rows in the segments of the index of aggregator, return the number of rows. gc_mu_ is held
+    uint64_t BackfillAggregator(Aggregator* aggregator);
+
+    void UpdateAggregators(const Dimensions& dimensions, const TSDimensions* ts_dimensions, uint64_t time,
+                           const std::string& value);
+
     bool CheckAbsolute(const TTLSt& ttl, uint64_t ts);
 
-    bool CheckLatest(uint32_t index_id, const std::string& key, uint64_t ts);
+    // whether ts is older than the rows of key kept by the latest ttl lat_ttl
+    bool CheckLatest(uint32_t index_id, const std::string& key, uint64_t ts, uint64_t lat_ttl);
+
+    // sync the latest ttl of indexs to the bounded list of segments
+    void UpdateLatestBound();
 
  private:
     uint32_t seg_cnt_;
@@ -237,6 +420,14 @@ class MemTable : public Table {
     bool segment_released_;
     std::atomic<uint64_t> record_byte_size_;
     uint32_t key_entry_max_height_;
+    std::mutex gc_mu_;
+    std::shared_ptr<DiskTable> cold_tier_;
+    uint64_t cold_age_;
+    // the rows moved before a restart may be recovered into memory again, the first move after it skips the rows
+    // in the cold tier already. it's set under gc_mu_
+    std::atomic<bool> cold_check_;
+    std::shared_ptr<std::vector<std::shared_ptr<Aggregator>>> aggregators_;
+    friend class MemTableCheckpoint;
 };
 
 }  // namespace storage
@@ -0,0 +1,442 @@
+/*
+ * Copyright 2021 4Paradigm
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "storage/mem_table_checkpoint.h"
+
+#include <fcntl.h>
+#include <google/protobuf/io/zero_copy_stream_impl.h>
+#include <google/protobuf/text_format.h>
+#include <unistd.h>
+
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "base/file_util.h"
+#include "base/glog_wapper.h"
+#include "base/hash.h"
+#include "base/strings.h"
+#include "common/timer.h"
+#include "storage/record.h"
+#include "storage/ticket.h"
+
+namespace openmldb {
+namespace storage {
+
+static const std::string CHECKPOINT_MANIFEST = "MANIFEST";  // NOLINT
+static const std::string CHECKPOINT_SUBFIX = ".ckp";        // NOLINT
+static const uint32_t CHECKPOINT_MAGIC = 0x4f4d434b;
+static const uint32_t CHECKPOINT_VERSION = 1;
+static const uint32_t END_MARK = UINT32_MAX;
+static const uint32_t REF_TAG = UINT32_MAX - 1;
+static const uint32_t SHARED_FLAG = 1u << 31;
+static const size_t CHECKPOINT_BUFFER_SIZE = 4 * 1024 * 1024;
+static const uint32_t SEED = 0xe17a1465;
+// the keys dumped under one ticket
+static const uint32_t DUMP_KEYS_PER_TICKET = 1024;
+
+template <class T>
+static inline bool WriteValue(FILE* fd, const T& value) {
+    return fwrite(&value, sizeof(T), 1, fd) == 1;
+}
+
+static inline bool WriteBytes(FILE* fd, const char* data, uint32_t size) {
+    return size == 0 || fwrite(data, 1, size, fd) == size;
+}
+
+template <class T>
+static inline bool ReadValue(FILE* fd, T* value) {
+    return fread(value, sizeof(T), 1, fd) == 1;
+}
+
+static inline bool ReadBytes(FILE* fd, char* data, uint32_t size) {
+    return size == 0 || fread(data, 1, size, fd) == size;
+}
+
+// a block written with SHARED_FLAG whose references are not all written yet
+struct SharedBlock {
+    uint64_t id;
+    uint32_t size;
+    uint32_t hash;
+    uint32_t refs;
+};
+
+MemTableCheckpoint::MemTableCheckpoint(uint32_t tid, uint32_t pid, const std::string& path)
+    : tid_(tid), pid_(pid), path_(path) {}
+
+bool MemTableCheckpoint::Init() {
+    if (!::openmldb::base::MkdirRecur(path_)) {
+        PDLOG(WARNING, "fail to create checkpoint path %s", path_.c_str());
+        return false;
+    }
+    return true;
+}
+
+int MemTableCheckpoint::Make(std::shared_ptr<MemTable> table, const std::function<uint64_t()>& get_offset) {
+    for (const auto& index : table->GetAllIndex()) {
+        if (index->GetStatus() != IndexStatus::kReady) {
+            PDLOG(INFO, "index %s is not ready, skip making checkpoint. tid %u pid %u", index->GetName().c_str(),
+                  tid_, pid_);
+            return -1;
+        }
+    }
+    ::openmldb::api::CheckpointManifest old_manifest;
+    if (GetManifest(path_ + CHECKPOINT_MANIFEST, &old_manifest) < 0) {
+        PDLOG(WARNING, "fail to read checkpoint manifest, it will be overwritten. tid %u pid %u", tid_, pid_);
+        old_manifest.Clear();
+    }
+    // Put is called before the entry is appended to binlog, so all the entries up to offset are in the table
+    uint64_t offset = get_offset();
+    std::string now_time = ::openmldb::base::GetNowTime();
+    std::string name = now_time.substr(0, now_time.length() - 2) + "_" + std::to_string(offset) + CHECKPOINT_SUBFIX;
+    std::string full_path = path_ + name;
+    std::string tmp_path = full_path + ".tmp";
+    FILE* fd = fopen(tmp_path.c_str(), "wb");
+    if (fd == NULL) {
+        PDLOG(WARNING, "fail to create file %s", tmp_path.c_str());
+        return -1;
+    }
+    setvbuf(fd, NULL, _IOFBF, CHECKPOINT_BUFFER_SIZE);
+    uint64_t consumed = ::baidu::common::timer::now_time();
+    uint64_t count = 0;
+    bool ok = Dump(table.get(), fd, &count);
+    if (!ok) {
+        PDLOG(WARNING, "write error. path[%s]", tmp_path.c_str());
+    } else if (fflush(fd) == EOF || fsync(fileno(fd)) == -1) {
+        PDLOG(WARNING, "flush error. path[%s]", tmp_path.c_str());
+        ok = false;
+    }
+    fclose(fd);
+    // read after the file is synced, so the puts in flight at the end of the dump have been appended
+    uint64_t end_offset = get_offset();
+    if (!ok || rename(tmp_path.c_str(), full_path.c_str()) != 0) {
+        unlink(tmp_path.c_str());
+        return -1;
+    }
+    ::openmldb::api::CheckpointManifest manifest;
+    manifest.set_offset(offset);
+    manifest.set_end_offset(end_offset);
+    manifest.set_name(name);
+    manifest.set_count(count);
+    manifest.set_seg_cnt(table->seg_cnt_);
+    auto inner_indexes = table->table_index_.GetAllInnerIndex();
+    for (uint32_t i = 0; i < inner_indexes->size(); i++) {
+        manifest.add_ts_cnt(table->segments_[i][0]->GetTsCnt());
+    }
+    if (GenManifest(manifest) != 0) {
+        PDLOG(WARNING, "fail to generate checkpoint manifest. tid %u pid %u", tid_, pid_);
+        unlink(full_path.c_str());
+        return -1;
+    }
+    if (!old_manifest.name().empty() && old_manifest.name() != name) {
+        unlink((path_ + old_manifest.name()).c_str());
+    }
+    consumed = ::baidu::common::timer::now_time() - consumed;
+    PDLOG(INFO, "make checkpoint %s. tid %u pid %u offset %lu end_offset %lu count %lu consumed %us", name.c_str(),
+          tid_, pid_, offset, end_offset, count, consumed);
+    return 0;
+}
+
+int MemTableCheckpoint::Recover(std::shared_ptr<MemTable> table, uint64_t min_offset, uint64_t* offset,
+                                uint64_t* end_offset) {
+    ::openmldb::api::CheckpointManifest manifest;
+    if (GetManifest(path_ + CHECKPOINT_MANIFEST, &manifest) != 0) {
+        return 1;
+    }
+    if (manifest.offset() < min_offset) {
+        PDLOG(INFO, "checkpoint offset %lu is less than snapshot offset %lu. tid %u pid %u", manifest.offset(),
+              min_offset, tid_, pid_);
+        return 1;
+    }
+    auto inner_indexes = table->table_index_.GetAllInnerIndex();
+    bool match = manifest.seg_cnt() == table->seg_cnt_ &&
+                 manifest.ts_cnt_size() == static_cast<int>(inner_indexes->size());
+    for (uint32_t i = 0; match && i < inner_indexes->size(); i++) {
+        match = manifest.ts_cnt(i) == table->segments_[i][0]->GetTsCnt();
+    }
+    for (const auto& index : table->GetAllIndex()) {
+        match = match && index->GetStatus() == IndexStatus::kReady;
+    }
+    if (!match) {
+        PDLOG(WARNING, "the indexes are changed after checkpoint %s is made, skip it. tid %u pid %u",
+              manifest.name().c_str(), tid_, pid_);
+        return 1;
+    }
+    std::string full_path = path_ + manifest.name();
+    FILE* fd = fopen(full_path.c_str(), "rb");
+    if (fd == NULL) {
+        PDLOG(WARNING, "fail to open checkpoint %s", full_path.c_str());
+        return 1;
+    }
+    setvbuf(fd, NULL, _IOFBF, CHECKPOINT_BUFFER_SIZE);
+    uint64_t consumed = ::baidu::common::timer::now_time();
+    uint64_t count = 0;
+    bool ok = Load(table.get(), fd, &count);
+    fclose(fd);
+    if (!ok) {
+        PDLOG(WARNING, "fail to load checkpoint %s. tid %u pid %u", full_path.c_str(), tid_, pid_);
+        return -1;
+    }
+    // the rows are loaded into the segments directly, the aggregators are filled from them
+    table->BackfillAggregators();
+    if (count != manifest.count()) {
+        PDLOG(WARNING, "checkpoint %s, expect cnt %lu but load cnt %lu", manifest.name().c_str(), manifest.count(),
+              count);
+    }
+    *offset = manifest.offset();
+    *end_offset = manifest.end_offset();
+    consumed = ::baidu::common::timer::now_time() - consumed;
+    PDLOG(INFO, "load checkpoint %s. tid %u pid %u offset %lu count %lu consumed %us", manifest.name().c_str(), tid_,
+          pid_, manifest.offset(), count, consumed);
+    return 0;
+}
+
+bool MemTableCheckpoint::Dump(MemTable* table, FILE* fd, uint64_t* count) {
+    bool ok = WriteValue(fd, CHECKPOINT_MAGIC) && WriteValue(fd, CHECKPOINT_VERSION);
+    // a block is freed by gc if all its references are expired, so its address may be reused by a new block
+    // during the dump. the size and hash of the data tell them apart
+    std::unordered_map<DataBlock*, SharedBlock> shared_blocks;
+    uint64_t next_id = 0;
+    uint64_t record_cnt = 0;
+    std::function<void(uint32_t, KeyEntry*)> dump_entry = [&](uint32_t, KeyEntry* entry) {
+        std::unique_ptr<KeyEntryIterator> it(entry->NewIterator());
+        for (it->SeekToFirst(); ok && it->Valid(); it->Next()) {
+            DataBlock* block = it->GetBlock();
+            uint64_t time = it->GetKey();
+            if (block == NULL) {
+                // a record sealed in a time block is not shared, it's loaded back to the skiplist
+                Slice value = it->GetValue();
+                ok = WriteValue(fd, static_cast<uint32_t>(value.size())) && WriteValue(fd, time) &&
+                     WriteBytes(fd, value.data(), value.size());
+                record_cnt++;
+                continue;
+            }
+            uint32_t hash = 0;
+            if (!shared_blocks.empty()) {
+                auto iter = shared_blocks.find(block);
+                if (iter != shared_blocks.end()) {
+                    hash = ::openmldb::base::hash(block->data, block->size, SEED);
+                    if (iter->second.size == block->size && iter->second.hash == hash) {
+                        ok = WriteValue(fd, REF_TAG) && WriteValue(fd, time) && WriteValue(fd, iter->second.id);
+                        if (--iter->second.refs == 0) {
+                            shared_blocks.erase(iter);
+                        }
+                        continue;
+                    }
+                    shared_blocks.erase(iter);
+                }
+            }
+            uint8_t refs = block->dim_cnt_down.load(std::memory_order_relaxed);
+            if (refs > 1) {
+                if (hash == 0) {
+                    hash = ::openmldb::base::hash(block->data, block->size, SEED);
+                }
+                shared_blocks.emplace(block, SharedBlock{next_id++, block->size, hash, refs - 1u});
+                ok = WriteValue(fd, block->size | SHARED_FLAG) && WriteValue(fd, time) && WriteValue(fd, refs);
+            } else {
+                ok = WriteValue(fd, block->size) && WriteValue(fd, time);
+            }
+            ok = ok && WriteBytes(fd, block->data, block->size);
+            record_cnt++;
+        }
+        ok = ok && WriteValue(fd, END_MARK);
+    };
+    auto inner_indexes = table->table_index_.GetAllInnerIndex();
+    for (uint32_t i = 0; ok && i < inner_indexes->size(); i++) {
+        for (uint32_t j = 0; ok && j < table->seg_cnt_; j++) {
+            Segment* segment = table->segments_[i][j];
+            // a ticket holds back the gc of all the tables, so a new one is taken for every batch of keys and the
+            // iterator seeks the last key dumped again
+            std::string last_key;
+            bool started = false;
+            bool done = false;
+            while (ok && !done) {
+                Ticket ticket;
+                std::unique_ptr<KeyEntries::Iterator> it(segment->GetKeyEntries()->NewIterator());
+                if (!started) {
+                    it->SeekToFirst();
+                    started = true;
+                } else {
+                    it->Seek(Slice(last_key));
+                    if (it->Valid() && it->GetKey() == Slice(last_key)) {
+                        it->Next();
+                    }
+                }
+                for (uint32_t cnt = 0; ok && it->Valid() && cnt < DUMP_KEYS_PER_TICKET; it->Next(), cnt++) {
+                    void* value = it->GetValue();
+                    const Slice& key = it->GetKey();
+                    ok = WriteValue(fd, static_cast<uint32_t>(key.size())) && WriteBytes(fd, key.data(), key.size());
+                    if (ok) {
+                        segment->VisitKeyEntry(value, dump_entry);
+                    }
+                    last_key.assign(key.data(), key.size());
+                }
+                done = !it->Valid();
+            }
+            ok = ok && WriteValue(fd, END_MARK);
+        }
+    }
+    ok = ok && WriteValue(fd, CHECKPOINT_MAGIC) && WriteValue(fd, record_cnt);
+    *count = record_cnt;
+    return ok;
+}
+
+bool MemTableCheckpoint::Load(MemTable* table, FILE* fd, uint64_t* count) {
+    uint32_t magic = 0;
+    uint32_t version = 0;
+    if (!ReadValue(fd, &magic) || !ReadValue(fd, &version) || magic != CHECKPOINT_MAGIC ||
+        version != CHECKPOINT_VERSION) {
+        PDLOG(WARNING, "invalid checkpoint header. tid %u pid %u", tid_, pid_);
+        return false;
+    }
+    // the shared blocks and their references to be read
+    std::unordered_map<uint64_t, std::pair<DataBlock*, uint32_t>> shared_blocks;
+    uint64_t next_id = 0;
+    uint64_t record_cnt = 0;
+    uint64_t record_byte_size = 0;
+    std::string key;
+    std::vector<std::pair<uint64_t, DataBlock*>> time_entries;
+    auto inner_indexes = table->table_index_.GetAllInnerIndex();
+    for (uint32_t i = 0; i < inner_indexes->size(); i++) {
+        for (uint32_t j = 0; j < table->seg_cnt_; j++) {
+            Segment* segment = table->segments_[i][j];
+            uint32_t ts_cnt = segment->GetTsCnt();
+            while (true) {
+                uint32_t key_size = 0;
+                if (!ReadValue(fd, &key_size)) {
+                    return false;
+                }
+                if (key_size == END_MARK) {
+                    break;
+                }
+                key.resize(key_size);
+                if (!ReadBytes(fd, &key[0], key_size)) {
+                    return false;
+                }
+                for (uint32_t k = 0; k < ts_cnt; k++) {
+                    time_entries.clear();
+                    while (true) {
+                        uint32_t tag = 0;
+                        uint64_t time = 0;
+                        if (!ReadValue(fd, &tag)) {
+                            return false;
+                        }
+                        if (tag == END_MARK) {
+                            break;
+                        }
+                        if (!ReadValue(fd, &time)) {
+                            return false;
+                        }
+                        DataBlock* block = NULL;
+                        if (tag == REF_TAG) {
+                            uint64_t id = 0;
+                            if (!ReadValue(fd, &id)) {
+                                return false;
+                            }
+                            auto iter = shared_blocks.find(id);
+                            if (iter == shared_blocks.end()) {
+                                PDLOG(WARNING, "block id %lu is not found. tid %u pid %u", id, tid_, pid_);
+                                return false;
+                            }
+                            block = iter->second.first;
+                            block->Ref();
+                            if (--iter->second.second == 0) {
+                                shared_blocks.erase(iter);
+                            }
+                        } else {
+                            bool shared = (tag & SHARED_FLAG) != 0;
+                            uint32_t size = tag & ~SHARED_FLAG;
+                            uint8_t refs = 1;
+                            if (shared && !ReadValue(fd, &refs)) {
+                                return false;
+                            }
+                            char* data = new char[size];
+                            if (!ReadBytes(fd, data, size)) {
+                                delete[] data;
+                                return false;
+                            }
+                            block = new DataBlock(1, data, size, true);
+                            if (shared) {
+                                if (refs > 1) {
+                                    shared_blocks.emplace(next_id, std::make_pair(block, refs - 1u));
+                                }
+                                next_id++;
+                            }
+                            record_cnt++;
+                            record_byte_size += GetRecordSize(size);
+                        }
+                        time_entries.emplace_back(time, block);
+                    }
+                    segment->LoadKeyEntry(Slice(key), k, time_entries);
+                }
+            }
+        }
+    }
+    uint64_t expect_cnt = 0;
+    if (!ReadValue(fd, &magic) || magic != CHECKPOINT_MAGIC || !ReadValue(fd, &expect_cnt) ||
+        expect_cnt != record_cnt) {
+        PDLOG(WARNING, "invalid checkpoint footer. tid %u pid %u", tid_, pid_);
+        return false;
+    }
+    table->record_cnt_.fetch_add(record_cnt, std::memory_order_relaxed);
+    table->record_byte_size_.fetch_add(record_byte_size, std::memory_order_relaxed);
+    *count = record_cnt;
+    return true;
+}
+
+int MemTableCheckpoint::GetManifest(const std::string& full_path, ::openmldb::api::CheckpointManifest* manifest) {
+    int fd = open(full_path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return 1;
+    }
+    google::protobuf::io::FileInputStream file_input(fd);
+    file_input.SetCloseOnDelete(true);
+    if (!google::protobuf::TextFormat::Parse(&file_input, manifest)) {
+        PDLOG(WARNING, "parse checkpoint manifest %s failed", full_path.c_str());
+        return -1;
+    }
+    return 0;
+}
+
+int MemTableCheckpoint::GenManifest(const ::openmldb::api::CheckpointManifest& manifest) {
+    std::string full_path = path_ + CHECKPOINT_MANIFEST;
+    std::string tmp_file = full_path + ".tmp";
+    std::string manifest_info;
+    google::protobuf::TextFormat::PrintToString(manifest, &manifest_info);
+    FILE* fd_write = fopen(tmp_file.c_str(), "w");
+    if (fd_write == NULL) {
+        PDLOG(WARNING, "fail to open file %s", tmp_file.c_str());
+        return -1;
+    }
+    bool io_error = false;
+    if (fputs(manifest_info.c_str(), fd_write) == EOF) {
+        PDLOG(WARNING, "write error. path[%s]", tmp_file.c_str());
+        io_error = true;
+    }
+    if (!io_error && ((fflush(fd_write) == EOF) || fsync(fileno(fd_write)) == -1)) {
+        PDLOG(WARNING, "flush error. path[%s]", tmp_file.c_str());
+        io_error = true;
+    }
+    fclose(fd_write);
+    if (!io_error && rename(tmp_file.c_str(), full_path.c_str()) == 0) {
+        return 0;
+    }
+    unlink(tmp_file.c_str());
+    return -1;
+}
+
+}  // namespace storage
+}  // namespace openmldb
@@ -0,0 +1,77 @@
+/*
+ * Copyright 2021 4Paradigm
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SRC_STORAGE_MEM_TABLE_CHECKPOINT_H_
+#define SRC_STORAGE_MEM_TABLE_CHECKPOINT_H_
+
+#include <stdio.h>
+
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "proto/tablet.pb.h"
+#include "storage/mem_table.h"
+
+namespace openmldb {
+namespace storage {
+
+// MemTableCheckpoint dumps the key entries of a memtable to a local file and loads them back without
+// replaying the snapshot. The file is grouped by inner index, segment and key:
+//   header: magic, version
+//   for every inner index and segment: keys in order, then END_MARK
+//   key: key size, key, then the time entries of every ts list in list order, each ended by END_MARK
+//   time entry: tag, time and
+//     the row bytes if tag is the row size. SHARED_FLAG in tag means the row is indexed by other lists too,
+//     it gets the next block id and the reference count follows the time
+//     the block id if tag is REF_TAG, the row is written before
+//   footer: magic, record count
+// The data blocks shared by inner indexes are written once. All integers are in the host byte order, the
+// checkpoint is only loaded by the tablet which makes it.
+class MemTableCheckpoint {
+ public:
+    // path is the checkpoint dir of a table
+    MemTableCheckpoint(uint32_t tid, uint32_t pid, const std::string& path);
+
+    bool Init();
+
+    // dump the table without blocking puts. get_offset returns the current binlog offset, it's read before the
+    // dump as the checkpoint offset and after as the end offset.
+    int Make(std::shared_ptr<MemTable> table, const std::function<uint64_t()>& get_offset);
+
+    // load the checkpoint into an empty table if its offset is not less than min_offset.
+    // return 0 if it's loaded, 1 if there is no available checkpoint and -1 if loading fails
+    int Recover(std::shared_ptr<MemTable> table, uint64_t min_offset, uint64_t* offset, uint64_t* end_offset);
+
+    static int GetManifest(const std::string& full_path, ::openmldb::api::CheckpointManifest* manifest);
+
+ private:
+    bool Dump(MemTable* table, FILE* fd, uint64_t* count);
+
+    bool Load(MemTable* table, FILE* fd, uint64_t* count);
+
+    int GenManifest(const ::openmldb::api::CheckpointManifest& manifest);
+
+ private:
+    uint32_t tid_;
+    uint32_t pid_;
+    std::string path_;
+};
+
+}  // namespace storage
+}  // namespace openmldb
+
+#endif  // SRC_STORAGE_MEM_TABLE_CHECKPOINT_H_
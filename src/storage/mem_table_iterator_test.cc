@@ -15,8 +15,15 @@
  */
 
 #include "common/timer.h"
+#include "gflags/gflags.h"
 #include "gtest/gtest.h"
 #include "storage/mem_table.h"
+#include "vm/mem_catalog.h"
+
+DECLARE_uint32(time_block_hot_cnt);
+DECLARE_uint32(time_block_min_cnt);
+DECLARE_uint32(time_block_max_cnt);
+DECLARE_bool(time_block_compress);
 
 namespace openmldb {
 namespace storage {
@@ -48,6 +55,48 @@ TEST_F(MemTableIteratorTest, smoketest) {
     ASSERT_FALSE(it->Valid());
 }
 
+TEST_F(MemTableIteratorTest, WindowOverCompressedTimeBlocks) {
+    FLAGS_time_block_hot_cnt = 10;
+    FLAGS_time_block_min_cnt = 20;
+    FLAGS_time_block_max_cnt = 32;
+    FLAGS_time_block_compress = true;
+    std::map<std::string, uint32_t> mapping;
+    mapping.insert(std::make_pair("idx0", 0));
+    MemTable table("tx_log", 1, 1, 1, mapping, 10, ::openmldb::type::TTLType::kAbsoluteTime);
+    table.Init();
+    std::string key = "test";
+    uint64_t now = ::baidu::common::timer::get_micros() / 1000;
+    uint64_t start = now - 99;
+    for (uint64_t ts = start; ts <= now; ts++) {
+        std::string value = "value" + std::to_string(ts);
+        table.Put(key, ts, value.c_str(), value.size());
+    }
+    // all but the latest 10 records are sealed into several compressed blocks
+    table.SchedGc();
+
+    std::unique_ptr<::hybridse::vm::WindowIterator> it(table.NewWindowIterator(0));
+    it->SeekToFirst();
+    ASSERT_TRUE(it->Valid());
+    std::unique_ptr<::hybridse::vm::RowIterator> wit = it->GetValue();
+    // the window is buffered from the oldest row, the rows of the blocks read before must stay valid
+    ::hybridse::vm::CurrentHistoryWindow window(::hybridse::vm::WindowRange::CreateRowsWindow(200));
+    for (uint64_t ts = start; ts <= now; ts++) {
+        wit->Seek(ts);
+        ASSERT_TRUE(wit->Valid());
+        ASSERT_EQ(ts, wit->GetKey());
+        ASSERT_TRUE(window.BufferData(ts, wit->GetValue()));
+    }
+    ASSERT_EQ(100u, window.GetCount());
+    for (uint64_t pos = 0; pos < 100; pos++) {
+        ASSERT_EQ("value" + std::to_string(now - pos), window.At(pos).ToString());
+    }
+
+    FLAGS_time_block_hot_cnt = 0;
+    FLAGS_time_block_min_cnt = 128;
+    FLAGS_time_block_max_cnt = 1024;
+    FLAGS_time_block_compress = false;
+}
+
 }  // namespace storage
 }  // namespace openmldb
 
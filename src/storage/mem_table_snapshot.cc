@@ -23,7 +23,9 @@
 #include <snappy.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <set>
+#include <thread>  // NOLINT
 #include <utility>
 
 #include "base/count_down_latch.h"
@@ -43,6 +45,7 @@
 #include "log/log_reader.h"
 #include "log/sequential_file.h"
 #include "proto/tablet.pb.h"
+#include "storage/mem_table_checkpoint.h"
 
 using google::protobuf::RepeatedPtrField;
 using ::openmldb::codec::SchemaCodec;
@@ -54,6 +57,8 @@ DECLARE_uint32(load_table_batch);
 DECLARE_uint32(load_table_thread_num);
 DECLARE_uint32(load_table_queue_size);
 DECLARE_string(snapshot_compression);
+DECLARE_uint32(snapshot_max_segments);
+DECLARE_bool(enable_memtable_checkpoint);
 
 namespace openmldb {
 namespace storage {
@@ -63,11 +68,12 @@ const uint32_t KEY_NUM_DISPLAY = 1000000;    // NOLINT
 const std::string MANIFEST = "MANIFEST";     // NOLINT
 
 MemTableSnapshot::MemTableSnapshot(uint32_t tid, uint32_t pid, LogParts* log_part, const std::string& db_root_path)
-    : Snapshot(tid, pid), log_part_(log_part), db_root_path_(db_root_path) {}
+    : Snapshot(tid, pid), log_part_(log_part), db_root_path_(db_root_path), dedup_end_offset_(0) {}
 
 bool MemTableSnapshot::Init() {
     snapshot_path_ = db_root_path_ + "/" + std::to_string(tid_) + "_" + std::to_string(pid_) + "/snapshot/";
     log_path_ = db_root_path_ + "/" + std::to_string(tid_) + "_" + std::to_string(pid_) + "/binlog/";
+    checkpoint_path_ = db_root_path_ + "/" + std::to_string(tid_) + "_" + std::to_string(pid_) + "/checkpoint/";
     if (!::openmldb::base::MkdirRecur(snapshot_path_)) {
         PDLOG(WARNING, "fail to create db meta path %s", snapshot_path_.c_str());
         return false;
@@ -86,8 +92,49 @@ bool MemTableSnapshot::Recover(std::shared_ptr<Table> table, uint64_t& latest_of
     if (ret == -1) {
         return false;
     }
+    std::shared_ptr<MemTable> mem_table = std::dynamic_pointer_cast<MemTable>(table);
+    if (FLAGS_enable_memtable_checkpoint && mem_table) {
+        // the checkpoint is not older than the snapshot, so it replaces the snapshot on load
+        MemTableCheckpoint checkpoint(tid_, pid_, checkpoint_path_);
+        uint64_t checkpoint_offset = 0;
+        int load_ret = checkpoint.Recover(mem_table, manifest.offset(), &checkpoint_offset, &dedup_end_offset_);
+        if (load_ret < 0) {
+            return false;
+        }
+        if (load_ret == 0) {
+            latest_offset = checkpoint_offset;
+            offset_ = manifest.offset();
+            return true;
+        }
+    }
     if (ret == 0) {
-        RecoverFromSnapshot(manifest.name(), manifest.count(), table);
+        std::vector<std::pair<std::string, uint64_t>> files;
+        GetSnapshotFiles(manifest, &files);
+        // the records of different snapshot files are independent, so the files are read in parallel. The readers
+        // share one put pool, so the threads of a table are bounded by load_table_thread_num whatever the file count
+        ::openmldb::base::TaskPool load_pool(FLAGS_load_table_thread_num, FLAGS_load_table_batch);
+        std::vector<std::atomic<uint64_t>> succ_cnts(files.size());
+        std::vector<std::atomic<uint64_t>> failed_cnts(files.size());
+        uint32_t thread_num = std::min(files.size(), static_cast<size_t>(std::max(FLAGS_load_table_thread_num, 1u)));
+        std::atomic<size_t> next_file(0);
+        std::vector<std::thread> threads;
+        for (uint32_t i = 0; i < thread_num; i++) {
+            threads.emplace_back([&]() {
+                for (size_t idx = next_file.fetch_add(1); idx < files.size(); idx = next_file.fetch_add(1)) {
+                    RecoverSingleSnapshot(snapshot_path_ + "/" + files[idx].first, table, &load_pool,
+                                          &succ_cnts[idx], &failed_cnts[idx]);
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        // the counts are final only after all the queued puts are done
+        load_pool.Stop();
+        for (size_t idx = 0; idx < files.size(); idx++) {
+            CheckRecoverCount(files[idx].first, files[idx].second, succ_cnts[idx].load(std::memory_order_relaxed),
+                              failed_cnts[idx].load(std::memory_order_relaxed));
+        }
         latest_offset = manifest.offset();
         offset_ = latest_offset;
     }
@@ -97,84 +144,79 @@ bool MemTableSnapshot::Recover(std::shared_ptr<Table> table, uint64_t& latest_of
 void MemTableSnapshot::RecoverFromSnapshot(const std::string& snapshot_name, uint64_t expect_cnt,
                                            std::shared_ptr<Table> table) {
     std::string full_path = snapshot_path_ + "/" + snapshot_name;
-    std::atomic<uint64_t> g_succ_cnt(0);
-    std::atomic<uint64_t> g_failed_cnt(0);
-    RecoverSingleSnapshot(full_path, table, &g_succ_cnt, &g_failed_cnt);
-    PDLOG(INFO, "[Recover] progress done stat: success count %lu, failed count %lu",
-          g_succ_cnt.load(std::memory_order_relaxed), g_failed_cnt.load(std::memory_order_relaxed));
-    if (g_succ_cnt.load(std::memory_order_relaxed) != expect_cnt) {
+    std::atomic<uint64_t> succ_cnt(0);
+    std::atomic<uint64_t> failed_cnt(0);
+    ::openmldb::base::TaskPool load_pool(FLAGS_load_table_thread_num, FLAGS_load_table_batch);
+    RecoverSingleSnapshot(full_path, table, &load_pool, &succ_cnt, &failed_cnt);
+    load_pool.Stop();
+    CheckRecoverCount(snapshot_name, expect_cnt, succ_cnt.load(std::memory_order_relaxed),
+                      failed_cnt.load(std::memory_order_relaxed));
+}
+
+void MemTableSnapshot::CheckRecoverCount(const std::string& snapshot_name, uint64_t expect_cnt, uint64_t succ_cnt,
+                                         uint64_t failed_cnt) {
+    PDLOG(INFO, "[Recover] progress done stat: success count %lu, failed count %lu", succ_cnt, failed_cnt);
+    if (succ_cnt != expect_cnt) {
         PDLOG(WARNING, "snapshot %s , expect cnt %lu but succ_cnt %lu", snapshot_name.c_str(), expect_cnt,
-              g_succ_cnt.load(std::memory_order_relaxed));
+              succ_cnt);
     }
 }
 
 void MemTableSnapshot::RecoverSingleSnapshot(const std::string& path, std::shared_ptr<Table> table,
-                                             std::atomic<uint64_t>* g_succ_cnt, std::atomic<uint64_t>* g_failed_cnt) {
-    ::openmldb::base::TaskPool load_pool_(FLAGS_load_table_thread_num, FLAGS_load_table_batch);
-    std::atomic<uint64_t> succ_cnt, failed_cnt;
-    succ_cnt = failed_cnt = 0;
+                                             ::openmldb::base::TaskPool* load_pool, std::atomic<uint64_t>* succ_cnt,
+                                             std::atomic<uint64_t>* failed_cnt) {
+    if (table == NULL) {
+        PDLOG(WARNING, "table input is NULL");
+        return;
+    }
+    FILE* fd = fopen(path.c_str(), "rb");
+    if (fd == NULL) {
+        PDLOG(WARNING, "fail to open path %s for error %s", path.c_str(), strerror(errno));
+        return;
+    }
+    bool compressed = IsCompressed(path);
+    ::openmldb::log::SequentialFile* seq_file = ::openmldb::log::NewSeqFile(path, fd);
+    ::openmldb::log::Reader reader(seq_file, NULL, false, 0, compressed);
+    std::string buffer;
+    // second
+    uint64_t consumed = ::baidu::common::timer::now_time();
+    uint64_t read_cnt = 0;
+    std::vector<std::string*> recordPtr;
+    recordPtr.reserve(FLAGS_load_table_batch);
 
-    do {
-        if (table == NULL) {
-            PDLOG(WARNING, "table input is NULL");
-            break;
-        }
-        FILE* fd = fopen(path.c_str(), "rb");
-        if (fd == NULL) {
-            PDLOG(WARNING, "fail to open path %s for error %s", path.c_str(), strerror(errno));
+    while (true) {
+        buffer.clear();
+        ::openmldb::base::Slice record;
+        ::openmldb::base::Status status = reader.ReadRecord(&record, &buffer);
+        if (status.IsWaitRecord() || status.IsEof()) {
+            consumed = ::baidu::common::timer::now_time() - consumed;
+            PDLOG(INFO,
+                  "read path %s for table tid %u pid %u completed, "
+                  "read_cnt %lu, failed_cnt %lu, consumed %us",
+                  path.c_str(), tid_, pid_, read_cnt, failed_cnt->load(std::memory_order_relaxed), consumed);
             break;
         }
-        bool compressed = IsCompressed(path);
-        ::openmldb::log::SequentialFile* seq_file = ::openmldb::log::NewSeqFile(path, fd);
-        ::openmldb::log::Reader reader(seq_file, NULL, false, 0, compressed);
-        std::string buffer;
-        // second
-        uint64_t consumed = ::baidu::common::timer::now_time();
-        std::vector<std::string*> recordPtr;
-        recordPtr.reserve(FLAGS_load_table_batch);
 
-        while (true) {
-            buffer.clear();
-            ::openmldb::base::Slice record;
-            ::openmldb::base::Status status = reader.ReadRecord(&record, &buffer);
-            if (status.IsWaitRecord() || status.IsEof()) {
-                consumed = ::baidu::common::timer::now_time() - consumed;
-                PDLOG(INFO,
-                      "read path %s for table tid %u pid %u completed, "
-                      "succ_cnt %lu, failed_cnt %lu, consumed %us",
-                      path.c_str(), tid_, pid_, succ_cnt.load(std::memory_order_relaxed),
-                      failed_cnt.load(std::memory_order_relaxed), consumed);
-                break;
-            }
-
-            if (!status.ok()) {
-                PDLOG(WARNING, "fail to read record for tid %u, pid %u with error %s", tid_, pid_,
-                      status.ToString().c_str());
-                failed_cnt.fetch_add(1, std::memory_order_relaxed);
-                continue;
-            }
-            std::string* sp = new std::string(record.data(), record.size());
-            recordPtr.push_back(sp);
-            if (recordPtr.size() >= FLAGS_load_table_batch) {
-                load_pool_.AddTask(
-                    boost::bind(&MemTableSnapshot::Put, this, path, table, recordPtr, &succ_cnt, &failed_cnt));
-                recordPtr.clear();
-            }
-        }
-        if (recordPtr.size() > 0) {
-            load_pool_.AddTask(
-                boost::bind(&MemTableSnapshot::Put, this, path, table, recordPtr, &succ_cnt, &failed_cnt));
-        }
-        // will close the fd atomic
-        delete seq_file;
-        if (g_succ_cnt) {
-            g_succ_cnt->fetch_add(succ_cnt, std::memory_order_relaxed);
+        if (!status.ok()) {
+            PDLOG(WARNING, "fail to read record for tid %u, pid %u with error %s", tid_, pid_,
+                  status.ToString().c_str());
+            failed_cnt->fetch_add(1, std::memory_order_relaxed);
+            continue;
         }
-        if (g_failed_cnt) {
-            g_failed_cnt->fetch_add(failed_cnt, std::memory_order_relaxed);
+        read_cnt++;
+        std::string* sp = new std::string(record.data(), record.size());
+        recordPtr.push_back(sp);
+        if (recordPtr.size() >= FLAGS_load_table_batch) {
+            load_pool->AddTask(
+                boost::bind(&MemTableSnapshot::Put, this, path, table, recordPtr, succ_cnt, failed_cnt));
+            recordPtr.clear();
         }
-    } while (false);
-    load_pool_.Stop();
+    }
+    if (recordPtr.size() > 0) {
+        load_pool->AddTask(boost::bind(&MemTableSnapshot::Put, this, path, table, recordPtr, succ_cnt, failed_cnt));
+    }
+    // will close the fd atomic
+    delete seq_file;
 }
 
 void MemTableSnapshot::Put(std::string& path, std::shared_ptr<Table>& table, std::vector<std::string*> recordPtr,
@@ -200,26 +242,44 @@ void MemTableSnapshot::Put(std::string& path, std::shared_ptr<Table>& table, std
 int MemTableSnapshot::TTLSnapshot(std::shared_ptr<Table> table, const ::openmldb::api::Manifest& manifest,
                                   WriteHandle* wh, uint64_t& count, uint64_t& expired_key_num,
                                   uint64_t& deleted_key_num) {
-    std::string full_path = snapshot_path_ + manifest.name();
+    std::set<uint32_t> deleted_index;
+    for (const auto& it : table->GetAllIndex()) {
+        if (it->GetStatus() != ::openmldb::storage::IndexStatus::kReady) {
+            deleted_index.insert(it->GetId());
+        }
+    }
+    std::vector<std::pair<std::string, uint64_t>> files;
+    GetSnapshotFiles(manifest, &files);
+    for (const auto& file : files) {
+        if (TTLSnapshotFile(table, file.first, file.second, deleted_index, wh, count, expired_key_num,
+                            deleted_key_num) < 0) {
+            return -1;
+        }
+    }
+    PDLOG(INFO, "load snapshot success. load key num[%lu] ttl key num[%lu]", count, expired_key_num);
+    return 0;
+}
+
+int MemTableSnapshot::TTLSnapshotFile(std::shared_ptr<Table> table, const std::string& name, uint64_t expect_cnt,
+                                      const std::set<uint32_t>& deleted_index, WriteHandle* wh, uint64_t& count,
+                                      uint64_t& expired_key_num, uint64_t& deleted_key_num) {
+    std::string full_path = snapshot_path_ + name;
     FILE* fd = fopen(full_path.c_str(), "rb");
     if (fd == NULL) {
         PDLOG(WARNING, "fail to open path %s for error %s", full_path.c_str(), strerror(errno));
         return -1;
     }
     bool compressed = IsCompressed(full_path);
-    ::openmldb::log::SequentialFile* seq_file = ::openmldb::log::NewSeqFile(manifest.name(), fd);
+    ::openmldb::log::SequentialFile* seq_file = ::openmldb::log::NewSeqFile(name, fd);
     ::openmldb::log::Reader reader(seq_file, NULL, false, 0, compressed);
 
     std::string buffer;
     std::string tmp_buf;
     ::openmldb::api::LogEntry entry;
     bool has_error = false;
-    std::set<uint32_t> deleted_index;
-    for (const auto& it : table->GetAllIndex()) {
-        if (it->GetStatus() != ::openmldb::storage::IndexStatus::kReady) {
-            deleted_index.insert(it->GetId());
-        }
-    }
+    uint64_t file_count = 0;
+    uint64_t file_expired_key_num = 0;
+    uint64_t file_deleted_key_num = 0;
     while (true) {
         ::openmldb::base::Slice record;
         ::openmldb::base::Status status = reader.ReadRecord(&record, &buffer);
@@ -240,13 +300,13 @@ int MemTableSnapshot::TTLSnapshot(std::shared_ptr<Table> table, const ::openmldb
         }
         int ret = RemoveDeletedKey(entry, deleted_index, &tmp_buf);
         if (ret == 1) {
-            deleted_key_num++;
+            file_deleted_key_num++;
             continue;
         } else if (ret == 2) {
             record.reset(tmp_buf.data(), tmp_buf.size());
         }
         if (table->IsExpire(entry)) {
-            expired_key_num++;
+            file_expired_key_num++;
             continue;
         }
         status = wh->Write(record);
@@ -255,23 +315,26 @@ int MemTableSnapshot::TTLSnapshot(std::shared_ptr<Table> table, const ::openmldb
             has_error = true;
             break;
         }
-        if ((count + expired_key_num + deleted_key_num) % KEY_NUM_DISPLAY == 0) {
-            PDLOG(INFO, "tackled key num[%lu] total[%lu]", count + expired_key_num, manifest.count());
+        if ((file_count + file_expired_key_num + file_deleted_key_num) % KEY_NUM_DISPLAY == 0) {
+            PDLOG(INFO, "tackled key num[%lu] total[%lu] in %s", file_count + file_expired_key_num, expect_cnt,
+                  name.c_str());
         }
-        count++;
+        file_count++;
     }
     delete seq_file;
-    if (expired_key_num + count + deleted_key_num != manifest.count()) {
+    count += file_count;
+    expired_key_num += file_expired_key_num;
+    deleted_key_num += file_deleted_key_num;
+    if (file_expired_key_num + file_count + file_deleted_key_num != expect_cnt) {
         PDLOG(WARNING,
-              "key num not match! total key num[%lu] load key num[%lu] ttl key "
+              "key num not match! snapshot[%s] total key num[%lu] load key num[%lu] ttl key "
               "num[%lu]",
-              manifest.count(), count, expired_key_num);
+              name.c_str(), expect_cnt, file_count, file_expired_key_num);
         has_error = true;
     }
     if (has_error) {
         return -1;
     }
-    PDLOG(INFO, "load snapshot success. load key num[%lu] ttl key num[%lu]", count, expired_key_num);
     return 0;
 }
 
@@ -353,8 +416,33 @@ int MemTableSnapshot::MakeSnapshot(std::shared_ptr<Table> table, uint64_t& out_o
         return -1;
     }
     making_snapshot_.store(true, std::memory_order_release);
+    uint64_t collected_offset = CollectDeletedKey(end_offset);
+    ::openmldb::api::Manifest manifest;
+    int result = GetLocalManifest(snapshot_path_ + MANIFEST, manifest);
+    // get deleted index
+    std::set<uint32_t> deleted_index;
+    bool all_index_ready = true;
+    for (const auto& it : table->GetAllIndex()) {
+        if (it->GetStatus() == ::openmldb::storage::IndexStatus::kDeleted) {
+            deleted_index.insert(it->GetId());
+        }
+        if (it->GetStatus() != ::openmldb::storage::IndexStatus::kReady) {
+            all_index_ready = false;
+        }
+    }
+    // The binlog delta is written as a new segment only if the records in the old snapshot files are not affected
+    // by it, i.e. no key or index is deleted. Otherwise the old files and the delta are compacted into a new snapshot,
+    // which drops the expired and deleted records as well.
+    bool make_segment = FLAGS_snapshot_max_segments > 0 && result == 0 &&
+                        static_cast<uint32_t>(manifest.segments_size()) < FLAGS_snapshot_max_segments &&
+                        deleted_keys_.empty() && all_index_ready;
     std::string now_time = ::openmldb::base::GetNowTime();
-    std::string snapshot_name = now_time.substr(0, now_time.length() - 2) + ".sdb";
+    std::string snapshot_name = now_time.substr(0, now_time.length() - 2);
+    if (make_segment) {
+        // the start offset makes the segments made in the same minute distinct
+        snapshot_name.append("_" + std::to_string(offset_ + 1));
+    }
+    snapshot_name.append(".sdb");
     if (FLAGS_snapshot_compression != "off") {
         snapshot_name.append(".");
         snapshot_name.append(FLAGS_snapshot_compression);
@@ -365,22 +453,20 @@ int MemTableSnapshot::MakeSnapshot(std::shared_ptr<Table> table, uint64_t& out_o
     FILE* fd = fopen(tmp_file_path.c_str(), "ab+");
     if (fd == NULL) {
         PDLOG(WARNING, "fail to create file %s", tmp_file_path.c_str());
+        deleted_keys_.clear();
         making_snapshot_.store(false, std::memory_order_release);
         return -1;
     }
-    uint64_t collected_offset = CollectDeletedKey(end_offset);
     uint64_t start_time = ::baidu::common::timer::now_time();
     WriteHandle* wh = new WriteHandle(FLAGS_snapshot_compression, snapshot_name_tmp, fd);
-    ::openmldb::api::Manifest manifest;
     bool has_error = false;
     uint64_t write_count = 0;
     uint64_t expired_key_num = 0;
     uint64_t deleted_key_num = 0;
     uint64_t last_term = 0;
-    int result = GetLocalManifest(snapshot_path_ + MANIFEST, manifest);
     if (result == 0) {
         // filter old snapshot
-        if (TTLSnapshot(table, manifest, wh, write_count, expired_key_num, deleted_key_num) < 0) {
+        if (!make_segment && TTLSnapshot(table, manifest, wh, write_count, expired_key_num, deleted_key_num) < 0) {
             has_error = true;
         }
         last_term = manifest.term();
@@ -389,14 +475,6 @@ int MemTableSnapshot::MakeSnapshot(std::shared_ptr<Table> table, uint64_t& out_o
         // parse manifest error
         has_error = true;
     }
-
-    // get deleted index
-    std::set<uint32_t> deleted_index;
-    for (const auto& it : table->GetAllIndex()) {
-        if (it->GetStatus() == ::openmldb::storage::IndexStatus::kDeleted) {
-            deleted_index.insert(it->GetId());
-        }
-    }
     ::openmldb::log::LogReader log_reader(log_part_, log_path_, false);
     log_reader.SetOffset(offset_);
     uint64_t cur_offset = offset_;
@@ -481,14 +559,43 @@ int MemTableSnapshot::MakeSnapshot(std::shared_ptr<Table> table, uint64_t& out_o
     if (has_error) {
         unlink(tmp_file_path.c_str());
         ret = -1;
+    } else if (make_segment) {
+        ::openmldb::api::Manifest new_manifest(manifest);
+        new_manifest.set_offset(cur_offset);
+        new_manifest.set_term(last_term);
+        new_manifest.set_count(manifest.count() + write_count);
+        if (write_count == 0) {
+            // nothing to persist, only the offset is moved
+            unlink(tmp_file_path.c_str());
+        } else if (rename(tmp_file_path.c_str(), full_path.c_str()) == 0) {
+            ::openmldb::api::SnapshotSegment* segment = new_manifest.add_segments();
+            segment->set_name(snapshot_name);
+            segment->set_count(write_count);
+            segment->set_offset(cur_offset);
+        } else {
+            PDLOG(WARNING, "rename[%s] failed", snapshot_name.c_str());
+            unlink(tmp_file_path.c_str());
+            ret = -1;
+        }
+        if (ret == 0) {
+            if (GenManifest(new_manifest) == 0) {
+                uint64_t consumed = ::baidu::common::timer::now_time() - start_time;
+                PDLOG(INFO,
+                      "make snapshot segment[%s] success. update offset from %lu to %lu."
+                      "use %lu second. write key %lu expired key %lu",
+                      snapshot_name.c_str(), offset_, cur_offset, consumed, write_count, expired_key_num);
+                offset_ = cur_offset;
+                out_offset = cur_offset;
+            } else {
+                PDLOG(WARNING, "GenManifest failed. delete snapshot file[%s]", full_path.c_str());
+                unlink(full_path.c_str());
+                ret = -1;
+            }
+        }
     } else {
         if (rename(tmp_file_path.c_str(), full_path.c_str()) == 0) {
             if (GenManifest(snapshot_name, write_count, cur_offset, last_term) == 0) {
-                // delete old snapshot
-                if (manifest.has_name() && manifest.name() != snapshot_name) {
-                    DEBUGLOG("old snapshot[%s] has deleted", manifest.name().c_str());
-                    unlink((snapshot_path_ + manifest.name()).c_str());
-                }
+                DeleteOldSnapshot(manifest, snapshot_name);
                 uint64_t consumed = ::baidu::common::timer::now_time() - start_time;
                 PDLOG(INFO,
                       "make snapshot[%s] success. update offset from %lu to %lu."
@@ -514,6 +621,35 @@ int MemTableSnapshot::MakeSnapshot(std::shared_ptr<Table> table, uint64_t& out_o
     return ret;
 }
 
+int MemTableSnapshot::MakeCheckpoint(std::shared_ptr<Table> table, const std::function<uint64_t()>& get_offset) {
+    std::shared_ptr<MemTable> mem_table = std::dynamic_pointer_cast<MemTable>(table);
+    if (!mem_table) {
+        return -1;
+    }
+    if (making_snapshot_.load(std::memory_order_acquire)) {
+        PDLOG(INFO, "snapshot is doing now!");
+        return 0;
+    }
+    making_snapshot_.store(true, std::memory_order_release);
+    MemTableCheckpoint checkpoint(tid_, pid_, checkpoint_path_);
+    int ret = checkpoint.Init() ? checkpoint.Make(mem_table, get_offset) : -1;
+    making_snapshot_.store(false, std::memory_order_release);
+    return ret;
+}
+
+void MemTableSnapshot::DeleteOldSnapshot(const ::openmldb::api::Manifest& manifest, const std::string& new_name) {
+    if (manifest.has_name() && manifest.name() != new_name) {
+        DEBUGLOG("old snapshot[%s] has deleted", manifest.name().c_str());
+        unlink((snapshot_path_ + manifest.name()).c_str());
+    }
+    for (const auto& segment : manifest.segments()) {
+        if (segment.name() != new_name) {
+            DEBUGLOG("old snapshot segment[%s] has deleted", segment.name().c_str());
+            unlink((snapshot_path_ + segment.name()).c_str());
+        }
+    }
+}
+
 int MemTableSnapshot::RemoveDeletedKey(const ::openmldb::api::LogEntry& entry, const std::set<uint32_t>& deleted_index,
                                        std::string* buffer) {
     uint64_t cur_offset = entry.log_index();
@@ -559,157 +695,164 @@ int MemTableSnapshot::ExtractIndexFromSnapshot(std::shared_ptr<Table> table, con
                                                WriteHandle* wh, const ::openmldb::common::ColumnKey& column_key,
                                                uint32_t idx, uint32_t partition_num, uint32_t max_idx,
                                                const std::vector<uint32_t>& index_cols, uint64_t& count,
-                                               uint64_t& expired_key_num, uint64_t& deleted_key_num) {
+                                               uint64_t& expired_key_num, uint64_t& deleted_key_num,
+                                               bool load_memory) {
     uint32_t tid = table->GetId();
     uint32_t pid = table->GetPid();
-    std::string full_path = snapshot_path_ + manifest.name();
-    FILE* fd = fopen(full_path.c_str(), "rb");
-    if (fd == NULL) {
-        PDLOG(WARNING, "fail to open path %s for error %s", full_path.c_str(), strerror(errno));
-        return -1;
-    }
-    ::openmldb::log::SequentialFile* seq_file = ::openmldb::log::NewSeqFile(manifest.name(), fd);
-    bool compressed = IsCompressed(full_path);
-    ::openmldb::log::Reader reader(seq_file, NULL, false, 0, compressed);
-    std::string buffer;
-    ::openmldb::api::LogEntry entry;
-    bool has_error = false;
     uint64_t extract_count = 0;
     uint64_t schame_size_less_count = 0;
     uint64_t other_error_count = 0;
-    DLOG(INFO) << "extract index data from snapshot";
-    while (true) {
-        ::openmldb::base::Slice record;
-        ::openmldb::base::Status status = reader.ReadRecord(&record, &buffer);
-        if (status.IsEof()) {
-            break;
-        }
-        if (!status.ok()) {
-            PDLOG(WARNING, "fail to read record for tid %u, pid %u with error %s", tid_, pid_,
-                  status.ToString().c_str());
-            has_error = true;
-            break;
-        }
-        if (!entry.ParseFromString(record.ToString())) {
-            PDLOG(WARNING, "fail parse record for tid %u, pid %u with value %s", tid_, pid_,
-                  ::openmldb::base::DebugString(record.ToString()).c_str());
-            has_error = true;
-            break;
+    std::vector<std::pair<std::string, uint64_t>> files;
+    GetSnapshotFiles(manifest, &files);
+    for (const auto& file : files) {
+        uint64_t last_total = expired_key_num + count + deleted_key_num + schame_size_less_count + other_error_count;
+        std::string full_path = snapshot_path_ + file.first;
+        FILE* fd = fopen(full_path.c_str(), "rb");
+        if (fd == NULL) {
+            PDLOG(WARNING, "fail to open path %s for error %s", full_path.c_str(), strerror(errno));
+            return -1;
         }
-        // deleted key
-        std::string tmp_buf;
-        if (entry.dimensions_size() == 0) {
-            std::string combined_key = entry.pk() + "|0";
-            if (deleted_keys_.find(combined_key) != deleted_keys_.end()) {
-                deleted_key_num++;
-                continue;
+        ::openmldb::log::SequentialFile* seq_file = ::openmldb::log::NewSeqFile(file.first, fd);
+        bool compressed = IsCompressed(full_path);
+        ::openmldb::log::Reader reader(seq_file, NULL, false, 0, compressed);
+        std::string buffer;
+        ::openmldb::api::LogEntry entry;
+        bool has_error = false;
+        DLOG(INFO) << "extract index data from snapshot " << file.first;
+        while (true) {
+            ::openmldb::base::Slice record;
+            ::openmldb::base::Status status = reader.ReadRecord(&record, &buffer);
+            if (status.IsEof()) {
+                break;
             }
-        } else {
-            std::set<int> deleted_pos_set;
-            for (int pos = 0; pos < entry.dimensions_size(); pos++) {
-                std::string combined_key =
-                    entry.dimensions(pos).key() + "|" + std::to_string(entry.dimensions(pos).idx());
-                if (deleted_keys_.find(combined_key) != deleted_keys_.end() ||
-                    !table->GetIndex(entry.dimensions(pos).idx())->IsReady()) {
-                    deleted_pos_set.insert(pos);
-                }
+            if (!status.ok()) {
+                PDLOG(WARNING, "fail to read record for tid %u, pid %u with error %s", tid_, pid_,
+                      status.ToString().c_str());
+                has_error = true;
+                break;
+            }
+            if (!entry.ParseFromString(record.ToString())) {
+                PDLOG(WARNING, "fail parse record for tid %u, pid %u with value %s", tid_, pid_,
+                      ::openmldb::base::DebugString(record.ToString()).c_str());
+                has_error = true;
+                break;
             }
-            if (!deleted_pos_set.empty()) {
-                if ((int)deleted_pos_set.size() ==  // NOLINT
-                    entry.dimensions_size()) {
+            // deleted key
+            std::string tmp_buf;
+            if (entry.dimensions_size() == 0) {
+                std::string combined_key = entry.pk() + "|0";
+                if (deleted_keys_.find(combined_key) != deleted_keys_.end()) {
                     deleted_key_num++;
                     continue;
-                } else {
-                    ::openmldb::api::LogEntry tmp_entry(entry);
-                    entry.clear_dimensions();
-                    for (int pos = 0; pos < tmp_entry.dimensions_size(); pos++) {
-                        if (deleted_pos_set.find(pos) == deleted_pos_set.end()) {
-                            ::openmldb::api::Dimension* dimension = entry.add_dimensions();
-                            dimension->CopyFrom(tmp_entry.dimensions(pos));
+                }
+            } else {
+                std::set<int> deleted_pos_set;
+                for (int pos = 0; pos < entry.dimensions_size(); pos++) {
+                    std::string combined_key =
+                        entry.dimensions(pos).key() + "|" + std::to_string(entry.dimensions(pos).idx());
+                    if (deleted_keys_.find(combined_key) != deleted_keys_.end() ||
+                        !table->GetIndex(entry.dimensions(pos).idx())->IsReady()) {
+                        deleted_pos_set.insert(pos);
+                    }
+                }
+                if (!deleted_pos_set.empty()) {
+                    if ((int)deleted_pos_set.size() ==  // NOLINT
+                        entry.dimensions_size()) {
+                        deleted_key_num++;
+                        continue;
+                    } else {
+                        ::openmldb::api::LogEntry tmp_entry(entry);
+                        entry.clear_dimensions();
+                        for (int pos = 0; pos < tmp_entry.dimensions_size(); pos++) {
+                            if (deleted_pos_set.find(pos) == deleted_pos_set.end()) {
+                                ::openmldb::api::Dimension* dimension = entry.add_dimensions();
+                                dimension->CopyFrom(tmp_entry.dimensions(pos));
+                            }
                         }
+                        entry.SerializeToString(&tmp_buf);
+                        record.reset(tmp_buf.data(), tmp_buf.size());
                     }
-                    entry.SerializeToString(&tmp_buf);
-                    record.reset(tmp_buf.data(), tmp_buf.size());
                 }
             }
-        }
-        // delete timeout key
-        if (table->IsExpire(entry)) {
-            expired_key_num++;
-            continue;
-        }
-        if (!(entry.has_method_type() && entry.method_type() == ::openmldb::api::MethodType::kDelete)) {
-            // new column_key
-            std::vector<std::string> row;
-            int ret = DecodeData(table, entry, max_idx, row);
-            if (ret == 2) {
-                count++;
-                wh->Write(record);
-                continue;
-            } else if (ret != 0) {
-                DLOG(INFO) << "skip current data";
-                other_error_count++;
+            // delete timeout key
+            if (table->IsExpire(entry)) {
+                expired_key_num++;
                 continue;
             }
-            std::string cur_key;
-            for (uint32_t i : index_cols) {
-                if (cur_key.empty()) {
-                    cur_key = row[i];
-                } else {
-                    cur_key += "|" + row[i];
+            if (!(entry.has_method_type() && entry.method_type() == ::openmldb::api::MethodType::kDelete)) {
+                // new column_key
+                std::vector<std::string> row;
+                int ret = DecodeData(table, entry, max_idx, row);
+                if (ret == 2) {
+                    count++;
+                    wh->Write(record);
+                    continue;
+                } else if (ret != 0) {
+                    DLOG(INFO) << "skip current data";
+                    other_error_count++;
+                    continue;
                 }
-            }
-            if (cur_key.empty()) {
-                other_error_count++;
-                DLOG(INFO) << "skip empty key";
-                continue;
-            }
-            uint32_t index_pid = ::openmldb::base::hash64(cur_key) % partition_num;
-            // update entry and write entry into memory
-            if (index_pid == pid) {
-                if (entry.dimensions_size() == 1 && entry.dimensions(0).idx() == idx) {
+                std::string cur_key;
+                for (uint32_t i : index_cols) {
+                    if (cur_key.empty()) {
+                        cur_key = row[i];
+                    } else {
+                        cur_key += "|" + row[i];
+                    }
+                }
+                if (cur_key.empty()) {
                     other_error_count++;
-                    DLOG(INFO) << "skip not default key " << cur_key;
+                    DLOG(INFO) << "skip empty key";
                     continue;
                 }
-                ::openmldb::api::Dimension* dim = entry.add_dimensions();
-                dim->set_key(cur_key);
-                dim->set_idx(idx);
-                entry.SerializeToString(&tmp_buf);
-                record.reset(tmp_buf.data(), tmp_buf.size());
-                entry.clear_dimensions();
-                dim = entry.add_dimensions();
-                dim->set_key(cur_key);
-                dim->set_idx(idx);
-                table->Put(entry);
-                extract_count++;
+                uint32_t index_pid = ::openmldb::base::hash64(cur_key) % partition_num;
+                // update entry and write entry into memory
+                if (index_pid == pid) {
+                    if (entry.dimensions_size() == 1 && entry.dimensions(0).idx() == idx) {
+                        other_error_count++;
+                        DLOG(INFO) << "skip not default key " << cur_key;
+                        continue;
+                    }
+                    ::openmldb::api::Dimension* dim = entry.add_dimensions();
+                    dim->set_key(cur_key);
+                    dim->set_idx(idx);
+                    entry.SerializeToString(&tmp_buf);
+                    record.reset(tmp_buf.data(), tmp_buf.size());
+                    entry.clear_dimensions();
+                    dim = entry.add_dimensions();
+                    dim->set_key(cur_key);
+                    dim->set_idx(idx);
+                    if (load_memory) {
+                        table->Put(entry);
+                    }
+                    extract_count++;
+                }
+            }
+            status = wh->Write(record);
+            if (!status.ok()) {
+                PDLOG(WARNING,
+                      "fail to extract index from snapshot. status[%s] tid[%u] "
+                      "pid[%u]",
+                      status.ToString().c_str(), tid, pid);
+                has_error = true;
+                break;
+            }
+            if ((count + expired_key_num + deleted_key_num) % KEY_NUM_DISPLAY == 0) {
+                PDLOG(INFO, "tackled key num[%lu] total[%lu] tid[%u] pid[%u]", count + expired_key_num, file.second,
+                      tid, pid);
             }
+            count++;
         }
-        status = wh->Write(record);
-        if (!status.ok()) {
-            PDLOG(WARNING,
-                  "fail to extract index from snapshot. status[%s] tid[%u] "
-                  "pid[%u]",
-                  status.ToString().c_str(), tid, pid);
+        delete seq_file;
+        uint64_t total = expired_key_num + count + deleted_key_num + schame_size_less_count + other_error_count;
+        if (total - last_total != file.second) {
+            LOG(WARNING) << "key num not match ! snapshot[" << file.first << "] total key num[" << file.second
+                         << "] tackled key num[" << total - last_total << "] tid[" << tid << "] pid[" << pid << "]";
             has_error = true;
-            break;
         }
-        if ((count + expired_key_num + deleted_key_num) % KEY_NUM_DISPLAY == 0) {
-            PDLOG(INFO, "tackled key num[%lu] total[%lu] tid[%u] pid[%u]", count + expired_key_num, manifest.count(),
-                  tid, pid);
+        if (has_error) {
+            return -1;
         }
-        count++;
-    }
-    delete seq_file;
-    if (expired_key_num + count + deleted_key_num + schame_size_less_count + other_error_count != manifest.count()) {
-        LOG(WARNING) << "key num not match ! total key num[" << manifest.count() << "] load key num[" << count
-                     << "] ttl key num[" << expired_key_num << "] schema size less num[" << schame_size_less_count
-                     << "] other error count[" << other_error_count << "]"
-                     << " tid[" << tid << "] pid[" << pid << "]";
-        has_error = true;
-    }
-    if (has_error) {
-        return -1;
     }
     LOG(INFO) << "extract index from snapshot success. extract key num[" << extract_count << "] load key num[" << count
               << "] ttl key num[" << expired_key_num << "] schema size less num[" << schame_size_less_count
@@ -719,7 +862,8 @@ int MemTableSnapshot::ExtractIndexFromSnapshot(std::shared_ptr<Table> table, con
 }
 
 int MemTableSnapshot::ExtractIndexData(std::shared_ptr<Table> table, const ::openmldb::common::ColumnKey& column_key,
-                                       uint32_t idx, uint32_t partition_num, uint64_t& out_offset) {
+                                       uint32_t idx, uint32_t partition_num, uint64_t& out_offset,
+                                       bool load_memory) {
     uint32_t tid = table->GetId();
     uint32_t pid = table->GetPid();
     if (making_snapshot_.exchange(true, std::memory_order_consume)) {
@@ -781,7 +925,7 @@ int MemTableSnapshot::ExtractIndexData(std::shared_ptr<Table> table, const ::ope
     if (result == 0) {
         DLOG(INFO) << "begin extract index data from snapshot";
         if (ExtractIndexFromSnapshot(table, manifest, wh, column_key, idx, partition_num, max_idx, index_cols,
-                                     write_count, expired_key_num, deleted_key_num) < 0) {
+                                     write_count, expired_key_num, deleted_key_num, load_memory) < 0) {
             has_error = true;
         }
         last_term = manifest.term();
@@ -906,7 +1050,9 @@ int MemTableSnapshot::ExtractIndexData(std::shared_ptr<Table> table, const ::ope
                     dim = entry.add_dimensions();
                     dim->set_key(cur_key);
                     dim->set_idx(idx);
-                    table->Put(entry);
+                    if (load_memory) {
+                        table->Put(entry);
+                    }
                     extract_count++;
                 }
             }
@@ -955,11 +1101,7 @@ int MemTableSnapshot::ExtractIndexData(std::shared_ptr<Table> table, const ::ope
     } else {
         if (rename(tmp_file_path.c_str(), full_path.c_str()) == 0) {
             if (GenManifest(snapshot_name, write_count, cur_offset, last_term) == 0) {
-                // delete old snapshot
-                if (manifest.has_name() && manifest.name() != snapshot_name) {
-                    DEBUGLOG("old snapshot[%s] has deleted", manifest.name().c_str());
-                    unlink((snapshot_path_ + manifest.name()).c_str());
-                }
+                DeleteOldSnapshot(manifest, snapshot_name);
                 uint64_t consumed = ::baidu::common::timer::now_time() - start_time;
                 PDLOG(INFO,
                       "make snapshot[%s] success. update offset from %lu to %lu."
@@ -1074,64 +1216,68 @@ bool MemTableSnapshot::DumpSnapshotIndexData(std::shared_ptr<Table> table,
         return false;
     }
     *snapshot_offset = manifest.offset();
-    std::string path = snapshot_path_ + "/" + manifest.name();
-    uint64_t succ_cnt = 0;
-    uint64_t failed_cnt = 0;
-    FILE* fd = fopen(path.c_str(), "rb");
-    if (fd == NULL) {
-        PDLOG(WARNING, "fail to open path %s for error %s", path.c_str(), strerror(errno));
-        return false;
-    }
-    ::openmldb::log::SequentialFile* seq_file = ::openmldb::log::NewSeqFile(path, fd);
-    bool compressed = IsCompressed(path);
-    ::openmldb::log::Reader reader(seq_file, NULL, false, 0, compressed);
-    ::openmldb::api::LogEntry entry;
-    std::string buffer;
-    std::string entry_buff;
-    DLOG(INFO) << "begin dump snapshot index data";
-    while (true) {
-        buffer.clear();
-        ::openmldb::base::Slice record;
-        ::openmldb::base::Status status = reader.ReadRecord(&record, &buffer);
-        if (status.IsWaitRecord() || status.IsEof()) {
-            PDLOG(INFO,
-                  "read path %s for table tid %u pid %u completed, succ_cnt "
-                  "%lu, failed_cnt %lu",
-                  path.c_str(), tid_, pid_, succ_cnt, failed_cnt);
-            break;
-        }
-        if (!status.ok()) {
-            PDLOG(WARNING, "fail to read record for tid %u, pid %u with error %s", tid_, pid_,
-                  status.ToString().c_str());
-            failed_cnt++;
-            continue;
-        }
-        entry_buff.assign(record.data(), record.size());
-        if (!entry.ParseFromString(entry_buff)) {
-            PDLOG(WARNING, "fail to parse record for tid %u, pid %u", tid_, pid_);
-            failed_cnt++;
-            continue;
-        }
-        uint32_t index_pid = 0;
-        if (!PackNewIndexEntry(table, index_cols, max_idx, idx, partition_num, &entry, &index_pid)) {
-            DLOG(INFO) << "pack new entry fail in snapshot";
-            continue;
-        }
-        std::string entry_str;
-        entry.SerializeToString(&entry_str);
-        ::openmldb::base::Slice new_record(entry_str);
-        status = whs[index_pid]->Write(new_record);
-        if (!status.ok()) {
-            delete seq_file;
-            PDLOG(WARNING,
-                  "fail to dump index entrylog in snapshot to pid[%u]. tid "
-                  "%u pid %u",
-                  index_pid, tid_, pid_);
+    std::vector<std::pair<std::string, uint64_t>> files;
+    GetSnapshotFiles(manifest, &files);
+    for (const auto& file : files) {
+        std::string path = snapshot_path_ + "/" + file.first;
+        uint64_t succ_cnt = 0;
+        uint64_t failed_cnt = 0;
+        FILE* fd = fopen(path.c_str(), "rb");
+        if (fd == NULL) {
+            PDLOG(WARNING, "fail to open path %s for error %s", path.c_str(), strerror(errno));
             return false;
         }
-        succ_cnt++;
+        ::openmldb::log::SequentialFile* seq_file = ::openmldb::log::NewSeqFile(path, fd);
+        bool compressed = IsCompressed(path);
+        ::openmldb::log::Reader reader(seq_file, NULL, false, 0, compressed);
+        ::openmldb::api::LogEntry entry;
+        std::string buffer;
+        std::string entry_buff;
+        DLOG(INFO) << "begin dump snapshot index data";
+        while (true) {
+            buffer.clear();
+            ::openmldb::base::Slice record;
+            ::openmldb::base::Status status = reader.ReadRecord(&record, &buffer);
+            if (status.IsWaitRecord() || status.IsEof()) {
+                PDLOG(INFO,
+                      "read path %s for table tid %u pid %u completed, succ_cnt "
+                      "%lu, failed_cnt %lu",
+                      path.c_str(), tid_, pid_, succ_cnt, failed_cnt);
+                break;
+            }
+            if (!status.ok()) {
+                PDLOG(WARNING, "fail to read record for tid %u, pid %u with error %s", tid_, pid_,
+                      status.ToString().c_str());
+                failed_cnt++;
+                continue;
+            }
+            entry_buff.assign(record.data(), record.size());
+            if (!entry.ParseFromString(entry_buff)) {
+                PDLOG(WARNING, "fail to parse record for tid %u, pid %u", tid_, pid_);
+                failed_cnt++;
+                continue;
+            }
+            uint32_t index_pid = 0;
+            if (!PackNewIndexEntry(table, index_cols, max_idx, idx, partition_num, &entry, &index_pid)) {
+                DLOG(INFO) << "pack new entry fail in snapshot";
+                continue;
+            }
+            std::string entry_str;
+            entry.SerializeToString(&entry_str);
+            ::openmldb::base::Slice new_record(entry_str);
+            status = whs[index_pid]->Write(new_record);
+            if (!status.ok()) {
+                delete seq_file;
+                PDLOG(WARNING,
+                      "fail to dump index entrylog in snapshot to pid[%u]. tid "
+                      "%u pid %u",
+                      index_pid, tid_, pid_);
+                return false;
+            }
+            succ_cnt++;
+        }
+        delete seq_file;
     }
-    delete seq_file;
     return true;
 }
 
@@ -17,12 +17,14 @@
 #pragma once
 
 #include <atomic>
+#include <functional>
 #include <map>
 #include <memory>
 #include <set>
 #include <string>
 #include <vector>
 
+#include "base/taskpool.hpp"
 #include "codec/schema_codec.h"
 #include "log/log_reader.h"
 #include "log/log_writer.h"
@@ -58,6 +60,12 @@ class MemTableSnapshot : public Snapshot {
                      uint64_t& out_offset,  // NOLINT
                      uint64_t end_offset) override;
 
+    // dump the table to the checkpoint dir, get_offset returns the current binlog offset
+    int MakeCheckpoint(std::shared_ptr<Table> table, const std::function<uint64_t()>& get_offset);
+
+    // the binlog entries in (latest_offset of Recover, dedup end offset] may be in the recovered checkpoint
+    uint64_t GetDedupEndOffset() const { return dedup_end_offset_; }
+
     int TTLSnapshot(std::shared_ptr<Table> table, const ::openmldb::api::Manifest& manifest, WriteHandle* wh,
                     uint64_t& count, uint64_t& expired_key_num,  // NOLINT
                     uint64_t& deleted_key_num);                  // NOLINT
@@ -71,7 +79,8 @@ class MemTableSnapshot : public Snapshot {
                                  uint32_t idx, uint32_t partition_num, uint32_t max_idx,
                                  const std::vector<uint32_t>& index_cols,
                                  uint64_t& count,                                        // NOLINT
-                                 uint64_t& expired_key_num, uint64_t& deleted_key_num);  // NOLINT
+                                 uint64_t& expired_key_num, uint64_t& deleted_key_num,   // NOLINT
+                                 bool load_memory);
 
     bool DumpSnapshotIndexData(std::shared_ptr<Table> table, const std::vector<std::vector<uint32_t>>& index_cols,
                                uint32_t max_idx, uint32_t idx, const std::vector<::openmldb::log::WriteHandle*>& whs,
@@ -81,9 +90,12 @@ class MemTableSnapshot : public Snapshot {
                              uint32_t max_idx, uint32_t idx, const std::vector<::openmldb::log::WriteHandle*>& whs,
                              uint64_t snapshot_offset, uint64_t collected_offset);
 
+    // rewrite the snapshot with the new index dimension. The records of the new index in this partition are put
+    // into the table too if load_memory is true, it's false if the index is extracted from memory already
     int ExtractIndexData(std::shared_ptr<Table> table, const ::openmldb::common::ColumnKey& column_key, uint32_t idx,
                          uint32_t partition_num,
-                         uint64_t& out_offset);  // NOLINT
+                         uint64_t& out_offset,  // NOLINT
+                         bool load_memory = true);
 
     bool DumpIndexData(std::shared_ptr<Table> table, const ::openmldb::common::ColumnKey& column_key, uint32_t idx,
                        const std::vector<::openmldb::log::WriteHandle*>& whs);
@@ -96,9 +108,22 @@ class MemTableSnapshot : public Snapshot {
                          std::string* buffer);
 
  private:
-    // load single snapshot to table
-    void RecoverSingleSnapshot(const std::string& path, std::shared_ptr<Table> table, std::atomic<uint64_t>* g_succ_cnt,
-                               std::atomic<uint64_t>* g_failed_cnt);
+    // read single snapshot and put its records to table by load_pool, the counts are final after load_pool stops
+    void RecoverSingleSnapshot(const std::string& path, std::shared_ptr<Table> table,
+                               ::openmldb::base::TaskPool* load_pool, std::atomic<uint64_t>* succ_cnt,
+                               std::atomic<uint64_t>* failed_cnt);
+
+    void CheckRecoverCount(const std::string& snapshot_name, uint64_t expect_cnt, uint64_t succ_cnt,
+                           uint64_t failed_cnt);
+
+    // filter the records of a snapshot file like TTLSnapshot
+    int TTLSnapshotFile(std::shared_ptr<Table> table, const std::string& name, uint64_t expect_cnt,
+                        const std::set<uint32_t>& deleted_index, WriteHandle* wh,
+                        uint64_t& count, uint64_t& expired_key_num,  // NOLINT
+                        uint64_t& deleted_key_num);                  // NOLINT
+
+    // delete the snapshot files in manifest except new_name
+    void DeleteOldSnapshot(const ::openmldb::api::Manifest& manifest, const std::string& new_name);
 
     uint64_t CollectDeletedKey(uint64_t end_offset);
 
@@ -112,6 +137,8 @@ class MemTableSnapshot : public Snapshot {
     std::string log_path_;
     std::map<std::string, uint64_t> deleted_keys_;
     std::string db_root_path_;
+    std::string checkpoint_path_;
+    uint64_t dedup_end_offset_;
 };
 
 }  // namespace storage
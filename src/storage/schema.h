@@ -198,6 +198,9 @@ class IndexDef {
     inline uint32_t GetId() const { return index_id_; }
     void SetStatus(IndexStatus status) { status_.store(status, std::memory_order_release); }
     IndexStatus GetStatus() const { return status_.load(std::memory_order_acquire); }
+    // a ready index which is filled by ExtractIndexFromMemory, the puts skip the rows extracted already
+    inline bool IsExtracting() const { return extracting_.load(std::memory_order_acquire); }
+    void SetExtracting(bool extracting) { extracting_.store(extracting, std::memory_order_release); }
     inline ::openmldb::type::IndexType GetType() { return type_; }
     inline const std::vector<ColumnDef>& GetColumns() { return columns_; }
     void SetTTL(const TTLSt& ttl);
@@ -212,6 +215,7 @@ class IndexDef {
     uint32_t index_id_;
     uint32_t inner_pos_;
     std::atomic<IndexStatus> status_;
+    std::atomic<bool> extracting_{false};
     ::openmldb::type::IndexType type_;
     std::vector<ColumnDef> columns_;
     std::shared_ptr<TTLSt> ttl_st_;
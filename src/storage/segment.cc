@@ -18,6 +18,10 @@
 
 #include <gflags/gflags.h>
 
+#include <algorithm>
+#include <set>
+#include <string>
+
 #include "base/glog_wapper.h"
 #include "base/strings.h"
 #include "common/timer.h"
@@ -26,11 +30,15 @@
 DECLARE_int32(gc_safe_offset);
 DECLARE_uint32(skiplist_max_height);
 DECLARE_uint32(gc_deleted_pk_version_delta);
+DECLARE_uint32(latest_bounded_list_slack);
+DECLARE_uint32(time_block_hot_cnt);
+DECLARE_uint32(time_block_min_cnt);
+DECLARE_uint32(time_block_max_cnt);
+DECLARE_bool(time_block_compress);
 
 namespace openmldb {
 namespace storage {
 
-static const SliceComparator scmp;
 Segment::Segment()
     : entries_(NULL),
       mu_(),
@@ -40,12 +48,14 @@ Segment::Segment()
       ts_cnt_(1),
       gc_version_(0),
       ttl_offset_(FLAGS_gc_safe_offset * 60 * 1000) {
-    entries_ = new KeyEntries((uint8_t)FLAGS_skiplist_max_height, 4, scmp);
+    entries_ = new KeyEntries((uint8_t)FLAGS_skiplist_max_height, 4, ::openmldb::type::kSkiplist);
     key_entry_max_height_ = (uint8_t)FLAGS_skiplist_max_height;
     entry_free_list_ = new KeyEntryNodeList(4, 4, tcmp);
+    node_free_list_ = new DataNodeList(4, 4, tcmp);
+    latest_bound_vec_.push_back(std::make_shared<std::atomic<uint64_t>>(0));
 }
 
-Segment::Segment(uint8_t height)
+Segment::Segment(uint8_t height, ::openmldb::type::KeyIndexType key_index_type)
     : entries_(NULL),
       mu_(),
       idx_cnt_(0),
@@ -55,11 +65,14 @@ Segment::Segment(uint8_t height)
       ts_cnt_(1),
       gc_version_(0),
       ttl_offset_(FLAGS_gc_safe_offset * 60 * 1000) {
-    entries_ = new KeyEntries((uint8_t)FLAGS_skiplist_max_height, 4, scmp);
+    entries_ = new KeyEntries((uint8_t)FLAGS_skiplist_max_height, 4, key_index_type);
     entry_free_list_ = new KeyEntryNodeList(4, 4, tcmp);
+    node_free_list_ = new DataNodeList(4, 4, tcmp);
+    latest_bound_vec_.push_back(std::make_shared<std::atomic<uint64_t>>(0));
 }
 
-Segment::Segment(uint8_t height, const std::vector<uint32_t>& ts_idx_vec)
+Segment::Segment(uint8_t height, const std::vector<uint32_t>& ts_idx_vec,
+                 ::openmldb::type::KeyIndexType key_index_type)
     : entries_(NULL),
       mu_(),
       idx_cnt_(0),
@@ -69,17 +82,23 @@ Segment::Segment(uint8_t height, const std::vector<uint32_t>& ts_idx_vec)
       ts_cnt_(ts_idx_vec.size()),
       gc_version_(0),
       ttl_offset_(FLAGS_gc_safe_offset * 60 * 1000) {
-    entries_ = new KeyEntries((uint8_t)FLAGS_skiplist_max_height, 4, scmp);
+    entries_ = new KeyEntries((uint8_t)FLAGS_skiplist_max_height, 4, key_index_type);
     entry_free_list_ = new KeyEntryNodeList(4, 4, tcmp);
+    node_free_list_ = new DataNodeList(4, 4, tcmp);
     for (uint32_t i = 0; i < ts_idx_vec.size(); i++) {
         ts_idx_map_[ts_idx_vec[i]] = i;
         idx_cnt_vec_.push_back(std::make_shared<std::atomic<uint64_t>>(0));
+        latest_bound_vec_.push_back(std::make_shared<std::atomic<uint64_t>>(0));
+    }
+    if (latest_bound_vec_.empty()) {
+        latest_bound_vec_.push_back(std::make_shared<std::atomic<uint64_t>>(0));
     }
 }
 
 Segment::~Segment() {
     delete entries_;
     delete entry_free_list_;
+    delete node_free_list_;
 }
 
 uint64_t Segment::Release() {
@@ -129,6 +148,25 @@ uint64_t Segment::Release() {
     }
     delete f_it;
     entry_free_list_->Clear();
+
+    DataNodeList::Iterator* n_it = node_free_list_->NewIterator();
+    n_it->SeekToFirst();
+    while (n_it->Valid()) {
+        ::openmldb::base::Node<uint64_t, DataBlock*>* node = n_it->GetValue();
+        while (node != NULL) {
+            ::openmldb::base::Node<uint64_t, DataBlock*>* tmp = node;
+            node = node->GetNextNoBarrier(0);
+            DataBlock* block = tmp->GetValue();
+            if (block->Unref() && block->retired_cnt.load(std::memory_order_acquire) == 0) {
+                delete block;
+            }
+            delete tmp;
+        }
+        n_it->Next();
+    }
+    delete n_it;
+    node_free_list_->Clear();
+    GcRetiredNodes(gc_version_.load(std::memory_order_relaxed));
     idx_cnt_vec_.clear();
     return cnt;
 }
@@ -138,6 +176,8 @@ void Segment::ReleaseAndCount(uint64_t& gc_idx_cnt, uint64_t& gc_record_cnt, uin
     it->SeekToFirst();
     while (it->Valid()) {
         Slice key = it->GetKey();
+        // move on before the node is removed, the skiplist unlinks the next of a removed node
+        it->Next();
         ::openmldb::base::Node<Slice, void*>* entry_node = NULL;
         {
             std::lock_guard<std::mutex> lock(mu_);
@@ -145,13 +185,15 @@ void Segment::ReleaseAndCount(uint64_t& gc_idx_cnt, uint64_t& gc_record_cnt, uin
         }
         if (entry_node != NULL) {
             FreeEntry(entry_node, gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
+            delete entry_node;
         }
-        it->Next();
         pk_cnt_.fetch_sub(1, std::memory_order_relaxed);
     }
     delete it;
     uint64_t cur_version = gc_version_.load(std::memory_order_relaxed);
     GcEntryFreeList(cur_version, gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
+    GcNodeFreeList(cur_version, gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
+    GcRetiredNodes(cur_version);
     Release();
 }
 
@@ -191,6 +233,7 @@ void Segment::PutUnlock(const Slice& key, uint64_t time, DataBlock* row) {
         ->count_.fetch_add(1, std::memory_order_relaxed);
     byte_size += GetRecordTsIdxSize(height);
     idx_byte_size_.fetch_add(byte_size, std::memory_order_relaxed);
+    TrimLatestUnlock((KeyEntry*)entry, 0);  // NOLINT
 }
 
 void Segment::BulkLoadPut(unsigned int key_entry_id, const Slice& key, uint64_t time, DataBlock* row) {
@@ -213,6 +256,7 @@ void Segment::BulkLoadPut(unsigned int key_entry_id, const Slice& key, uint64_t
             uint8_t height = entries_->Insert(skey, entry_arr);
             byte_size += GetRecordPkMultiIdxSize(height, key.size(), key_entry_max_height_, ts_cnt_);
             pk_cnt_.fetch_add(1, std::memory_order_relaxed);
+            key_entry_or_list = entry_arr;
         }
         uint8_t height = ((KeyEntry**)key_entry_or_list)[key_entry_id]->entries.Insert(  // NOLINT
             time, row);
@@ -221,6 +265,168 @@ void Segment::BulkLoadPut(unsigned int key_entry_id, const Slice& key, uint64_t
         byte_size += GetRecordTsIdxSize(height);
         idx_byte_size_.fetch_add(byte_size, std::memory_order_relaxed);
         idx_cnt_vec_[key_entry_id]->fetch_add(1, std::memory_order_relaxed);
+        TrimLatestUnlock(((KeyEntry**)key_entry_or_list)[key_entry_id], key_entry_id);  // NOLINT
+    }
+}
+
+void Segment::LoadKeyEntry(const Slice& key, uint32_t key_entry_id,
+                           const std::vector<std::pair<uint64_t, DataBlock*>>& time_entries) {
+    if (time_entries.empty() || key_entry_id >= ts_cnt_) {
+        return;
+    }
+    void* key_entry_or_list = nullptr;
+    uint32_t byte_size = 0;
+    std::lock_guard<std::mutex> lock(mu_);
+    if (entries_->Get(key, key_entry_or_list) < 0 || key_entry_or_list == nullptr) {
+        char* pk = new char[key.size()];
+        memcpy(pk, key.data(), key.size());
+        Slice skey(pk, key.size());
+        if (ts_cnt_ == 1) {
+            key_entry_or_list = (void*)new KeyEntry(key_entry_max_height_);  // NOLINT
+            uint8_t height = entries_->Insert(skey, key_entry_or_list);
+            byte_size += GetRecordPkIdxSize(height, key.size(), key_entry_max_height_);
+        } else {
+            auto** entry_arr = new KeyEntry*[ts_cnt_];
+            for (uint32_t i = 0; i < ts_cnt_; i++) {
+                entry_arr[i] = new KeyEntry(key_entry_max_height_);
+            }
+            key_entry_or_list = (void*)entry_arr;  // NOLINT
+            uint8_t height = entries_->Insert(skey, key_entry_or_list);
+            byte_size += GetRecordPkMultiIdxSize(height, key.size(), key_entry_max_height_, ts_cnt_);
+        }
+        pk_cnt_.fetch_add(1, std::memory_order_relaxed);
+    }
+    KeyEntry* entry = ts_cnt_ > 1 ? ((KeyEntry**)key_entry_or_list)[key_entry_id]  // NOLINT
+                                  : (KeyEntry*)key_entry_or_list;                 // NOLINT
+    uint64_t cnt = 0;
+    for (auto it = time_entries.rbegin(); it != time_entries.rend(); ++it) {
+        DataBlock* row = it->second;
+        uint8_t height = entry->entries.AddToFirst(it->first, row);
+        if (height == 0) {
+            // not in the list order, fallback to insert
+            height = entry->entries.Insert(it->first, row);
+        }
+        byte_size += GetRecordTsIdxSize(height);
+        cnt++;
+    }
+    entry->count_.fetch_add(cnt, std::memory_order_relaxed);
+    if (ts_cnt_ > 1) {
+        idx_cnt_vec_[key_entry_id]->fetch_add(cnt, std::memory_order_relaxed);
+    } else {
+        idx_cnt_.fetch_add(cnt, std::memory_order_relaxed);
+    }
+    idx_byte_size_.fetch_add(byte_size, std::memory_order_relaxed);
+    TrimLatestUnlock(entry, key_entry_id);
+}
+
+uint32_t Segment::CountSame(const Slice& key, uint32_t key_entry_id, uint64_t time, const Slice& data) {
+    if (key_entry_id >= ts_cnt_) {
+        return 0;
+    }
+    void* key_entry_or_list = nullptr;
+    if (entries_->Get(key, key_entry_or_list) < 0 || key_entry_or_list == nullptr) {
+        return 0;
+    }
+    KeyEntry* entry = ts_cnt_ > 1 ? ((KeyEntry**)key_entry_or_list)[key_entry_id]  // NOLINT
+                                  : (KeyEntry*)key_entry_or_list;                 // NOLINT
+    uint32_t cnt = 0;
+    std::unique_ptr<KeyEntryIterator> it(entry->NewIterator());
+    for (it->Seek(time); it->Valid() && it->GetKey() == time; it->Next()) {
+        Slice value = it->GetValue();
+        if (value.size() == data.size() && memcmp(value.data(), data.data(), data.size()) == 0) {
+            cnt++;
+        }
+    }
+    return cnt;
+}
+
+bool Segment::HasBlockUnlock(const Slice& key, uint64_t time, DataBlock* row) {
+    void* entry = nullptr;
+    if (entries_->Get(key, entry) < 0 || entry == nullptr) {
+        return false;
+    }
+    std::unique_ptr<TimeEntries::Iterator> it(((KeyEntry*)entry)->entries.NewIterator());  // NOLINT
+    for (it->Seek(time); it->Valid() && it->GetKey() == time; it->Next()) {
+        if (it->GetValue() == row) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Segment::PutBlockIfAbsent(const Slice& key, uint64_t time, DataBlock* row) {
+    if (ts_cnt_ > 1) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mu_);
+    if (HasBlockUnlock(key, time, row)) {
+        return false;
+    }
+    // the source index may have dropped the last reference by gc, the block is going to be freed then
+    if (!row->RefIfAlive()) {
+        return false;
+    }
+    PutUnlock(key, time, row);
+    return true;
+}
+
+bool Segment::PutCopyIfAbsent(const Slice& key, uint64_t time, DataBlock* row, uint32_t same_cnt) {
+    if (ts_cnt_ > 1) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mu_);
+    void* entry = nullptr;
+    if (entries_->Get(key, entry) == 0 && entry != nullptr) {
+        // the sealed records of the list are compared too
+        uint32_t cnt = 0;
+        std::unique_ptr<KeyEntryIterator> it(((KeyEntry*)entry)->NewIterator());  // NOLINT
+        for (it->Seek(time); it->Valid() && it->GetKey() == time; it->Next()) {
+            Slice value = it->GetValue();
+            if (value.size() == row->size && memcmp(value.data(), row->data, row->size) == 0 && ++cnt > same_cnt) {
+                return false;
+            }
+        }
+    }
+    PutUnlock(key, time, row);
+    return true;
+}
+
+bool Segment::PutIfAbsent(const Slice& key, uint64_t time, DataBlock* row) {
+    if (ts_cnt_ > 1) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mu_);
+    if (HasBlockUnlock(key, time, row)) {
+        return false;
+    }
+    PutUnlock(key, time, row);
+    return true;
+}
+
+bool Segment::PutIfAbsent(const Slice& key, const TSDimensions& ts_dimension, DataBlock* row) {
+    if (ts_cnt_ > 1 || ts_dimension.size() == 0) {
+        Put(key, ts_dimension, row);
+        return true;
+    }
+    if (ts_dimension.size() == 1) {
+        return PutIfAbsent(key, ts_dimension.begin()->ts(), row);
+    }
+    for (const auto& cur_ts : ts_dimension) {
+        if (ts_idx_map_.find(cur_ts.idx()) != ts_idx_map_.end()) {
+            return PutIfAbsent(key, cur_ts.ts(), row);
+        }
+    }
+    return true;
+}
+
+void Segment::VisitKeyEntry(void* key_entry_or_list, const std::function<void(uint32_t, KeyEntry*)>& visitor) {
+    std::lock_guard<std::mutex> lock(mu_);
+    if (ts_cnt_ == 1) {
+        visitor(0, (KeyEntry*)key_entry_or_list);  // NOLINT
+        return;
+    }
+    for (uint32_t i = 0; i < ts_cnt_; i++) {
+        visitor(i, ((KeyEntry**)key_entry_or_list)[i]);  // NOLINT
     }
 }
 
@@ -274,7 +480,40 @@ void Segment::Put(const Slice& key, const TSDimensions& ts_dimension, DataBlock*
         byte_size += GetRecordTsIdxSize(height);
         idx_byte_size_.fetch_add(byte_size, std::memory_order_relaxed);
         idx_cnt_vec_[pos->second]->fetch_add(1, std::memory_order_relaxed);
+        TrimLatestUnlock(((KeyEntry**)entry_arr)[pos->second], pos->second);  // NOLINT
+    }
+}
+
+void Segment::SetLatestBound(uint32_t real_idx, uint64_t keep_cnt) {
+    if (real_idx >= latest_bound_vec_.size()) {
+        return;
+    }
+    latest_bound_vec_[real_idx]->store(keep_cnt, std::memory_order_relaxed);
+}
+
+void Segment::TrimLatestUnlock(KeyEntry* entry, uint32_t real_idx) {
+    uint64_t keep_cnt = latest_bound_vec_[real_idx]->load(std::memory_order_relaxed);
+    // trim in batch of latest_bounded_list_slack records to amortize the walk of SplitByPos
+    if (keep_cnt == 0 || entry->count_.load(std::memory_order_relaxed) <= keep_cnt + FLAGS_latest_bounded_list_slack) {
+        return;
+    }
+    ::openmldb::base::Node<uint64_t, DataBlock*>* node = entry->entries.SplitByPos(keep_cnt);
+    if (node == NULL) {
+        return;
+    }
+    uint64_t cnt = 0;
+    for (auto* cur = node; cur != NULL; cur = cur->GetNextNoBarrier(0)) {
+        cnt++;
+    }
+    entry->count_.fetch_sub(cnt, std::memory_order_relaxed);
+    if (ts_cnt_ > 1) {
+        idx_cnt_vec_[real_idx]->fetch_sub(cnt, std::memory_order_relaxed);
+    } else {
+        idx_cnt_.fetch_sub(cnt, std::memory_order_relaxed);
     }
+    // the reader which holds a ticket may be iterating on these nodes, so free them later
+    std::lock_guard<std::mutex> lock(gc_mu_);
+    node_free_list_->Insert(gc_version_.load(std::memory_order_relaxed), node);
 }
 
 bool Segment::Get(const Slice& key, const uint64_t time, DataBlock** block) {
@@ -332,13 +571,15 @@ void Segment::FreeList(::openmldb::base::Node<uint64_t, DataBlock*>* node, uint6
         idx_byte_size_.fetch_sub(GetRecordTsIdxSize(tmp->Height()));
         node = node->GetNextNoBarrier(0);
         DEBUGLOG("delete key %lu with height %u", tmp->GetKey(), tmp->Height());
-        if (tmp->GetValue()->dim_cnt_down > 1) {
-            tmp->GetValue()->dim_cnt_down--;
-        } else {
-            DEBUGLOG("delele data block for key %lu", tmp->GetKey());
-            gc_record_byte_size += GetRecordSize(tmp->GetValue()->size);
-            delete tmp->GetValue();
+        DataBlock* block = tmp->GetValue();
+        if (block->Unref()) {
+            gc_record_byte_size += GetRecordSize(block->size);
             gc_record_cnt++;
+            // the nodes of the other indexes retired by gc may still be read, the last of them frees the block
+            if (block->retired_cnt.load(std::memory_order_acquire) == 0) {
+                DEBUGLOG("delele data block for key %lu", tmp->GetKey());
+                delete block;
+            }
         }
         delete tmp;
     }
@@ -364,6 +605,7 @@ void Segment::FreeEntry(::openmldb::base::Node<Slice, void*>* entry_node, uint64
                 FreeList(data_node, gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
             }
             delete it;
+            FreeBlocks(entry, gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
             delete entry;
             idx_cnt_vec_[i]->fetch_sub(gc_idx_cnt - old, std::memory_order_relaxed);
         }
@@ -382,6 +624,7 @@ void Segment::FreeEntry(::openmldb::base::Node<Slice, void*>* entry_node, uint64
             FreeList(data_node, gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
         }
         delete it;
+        FreeBlocks(entry, gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
         delete entry;
         uint64_t byte_size =
             GetRecordPkIdxSize(entry_node->Height(), entry_node->GetKey().size(), key_entry_max_height_);
@@ -408,13 +651,458 @@ void Segment::GcEntryFreeList(uint64_t version, uint64_t& gc_idx_cnt, uint64_t&
     }
 }
 
-void Segment::GcFreeList(uint64_t& gc_idx_cnt, uint64_t& gc_record_cnt, uint64_t& gc_record_byte_size) {
+void Segment::GcNodeFreeList(uint64_t version, uint64_t& gc_idx_cnt, uint64_t& gc_record_cnt,
+                             uint64_t& gc_record_byte_size) {
+    ::openmldb::base::Node<uint64_t, ::openmldb::base::Node<uint64_t, DataBlock*>*>* node = NULL;
+    {
+        std::lock_guard<std::mutex> lock(gc_mu_);
+        node = node_free_list_->Split(version);
+    }
+    while (node != NULL) {
+        // idx cnt has been decreased when the nodes were trimmed
+        FreeList(node->GetValue(), gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
+        ::openmldb::base::Node<uint64_t, ::openmldb::base::Node<uint64_t, DataBlock*>*>* tmp = node;
+        node = node->GetNextNoBarrier(0);
+        delete tmp;
+    }
+}
+
+void Segment::RetireList(::openmldb::base::Node<uint64_t, DataBlock*>* node, uint64_t& gc_idx_cnt,
+                         uint64_t& gc_record_cnt, uint64_t& gc_record_byte_size) {
+    if (node == NULL) {
+        return;
+    }
+    for (auto* cur = node; cur != NULL; cur = cur->GetNextNoBarrier(0)) {
+        gc_idx_cnt++;
+        idx_byte_size_.fetch_sub(GetRecordTsIdxSize(cur->Height()));
+        DataBlock* block = cur->GetValue();
+        // the record is counted by the last index which unlinks it, but the block is only freed with the nodes
+        block->retired_cnt.fetch_add(1, std::memory_order_relaxed);
+        if (block->Unref()) {
+            gc_record_byte_size += GetRecordSize(block->size);
+            gc_record_cnt++;
+        }
+    }
+    std::lock_guard<std::mutex> lock(gc_mu_);
+    retired_nodes_.push_back(RetiredNodes{gc_version_.load(std::memory_order_relaxed), node, {}});
+}
+
+void Segment::GcRetiredNodes(uint64_t version) {
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        entries_->FreeGarbage(version);
+    }
+    std::deque<RetiredNodes> retired_nodes;
+    {
+        std::lock_guard<std::mutex> lock(gc_mu_);
+        while (!retired_nodes_.empty() && retired_nodes_.front().version <= version) {
+            retired_nodes.push_back(std::move(retired_nodes_.front()));
+            retired_nodes_.pop_front();
+        }
+    }
+    for (auto& retired : retired_nodes) {
+        auto* node = retired.node;
+        while (node != NULL) {
+            auto* tmp = node;
+            node = node->GetNextNoBarrier(0);
+            DataBlock* block = tmp->GetValue();
+            if (block->retired_cnt.fetch_sub(1, std::memory_order_acq_rel) == 1 &&
+                block->dim_cnt_down.load(std::memory_order_acquire) == 0) {
+                delete block;
+            }
+            delete tmp;
+        }
+        for (TimeBlock* block : retired.time_blocks) {
+            delete block;
+        }
+    }
+}
+
+// the count of the records newer than time in the blocks
+static uint64_t CountNewer(TimeBlock* block, uint64_t time) {
+    uint64_t cnt = 0;
+    for (; block != NULL && block->GetMinTime() > time; block = block->GetNext()) {
+        cnt += block->GetCount();
+    }
+    if (block != NULL) {
+        cnt += block->Seek(time);
+    }
+    return cnt;
+}
+
+::openmldb::base::Node<uint64_t, DataBlock*>* Segment::SplitUnlock(KeyEntry* entry, const TTLSt& ttl,
+                                                                   std::vector<CutBlock>* cut) {
+    TimeBlock* head = entry->blocks_.load(std::memory_order_relaxed);
+    uint64_t list_keep = ttl.lat_ttl;
+    uint64_t block_keep = ttl.lat_ttl;
+    if (head != NULL && ttl.lat_ttl > 0 && ttl.ttl_type != TTLType::kAbsoluteTime) {
+        // the latest records are counted in the merged order of the skiplist and the blocks
+        list_keep = 0;
+        block_keep = 0;
+        KeyEntryIterator it(entry);
+        for (it.SeekToFirst(); it.Valid() && list_keep + block_keep < ttl.lat_ttl; it.Next()) {
+            if (it.GetBlock() != NULL) {
+                list_keep++;
+            } else {
+                block_keep++;
+            }
+        }
+    }
+    ::openmldb::base::Node<uint64_t, DataBlock*>* node = NULL;
+    switch (ttl.ttl_type) {
+        case TTLType::kAbsoluteTime:
+            node = entry->entries.Split(ttl.abs_ttl);
+            block_keep = CountNewer(head, ttl.abs_ttl);
+            break;
+        case TTLType::kLatestTime:
+            node = entry->entries.SplitByPos(list_keep);
+            break;
+        case TTLType::kAbsAndLat:
+            node = entry->entries.SplitByKeyAndPos(ttl.abs_ttl, list_keep);
+            block_keep = std::max(block_keep, CountNewer(head, ttl.abs_ttl));
+            break;
+        case TTLType::kAbsOrLat:
+            if (ttl.abs_ttl == 0) {
+                node = entry->entries.SplitByPos(list_keep);
+            } else if (ttl.lat_ttl == 0) {
+                node = entry->entries.Split(ttl.abs_ttl);
+                block_keep = CountNewer(head, ttl.abs_ttl);
+            } else {
+                node = entry->entries.SplitByKeyOrPos(ttl.abs_ttl, list_keep);
+                block_keep = std::min(block_keep, CountNewer(head, ttl.abs_ttl));
+            }
+            break;
+        default:
+            return NULL;
+    }
+    if (head != NULL) {
+        CutBlocksUnlock(entry, block_keep, cut);
+    }
+    return node;
+}
+
+void Segment::CutBlocksUnlock(KeyEntry* entry, uint64_t keep_cnt, std::vector<CutBlock>* cut) {
+    TimeBlock* pre = NULL;
+    TimeBlock* block = entry->blocks_.load(std::memory_order_relaxed);
+    while (block != NULL && keep_cnt >= block->GetCount()) {
+        keep_cnt -= block->GetCount();
+        pre = block;
+        block = block->GetNext();
+    }
+    if (block == NULL) {
+        return;
+    }
+    TimeBlock* kept = NULL;
+    if (keep_cnt > 0) {
+        // the block is immutable, the records kept are copied to a new one
+        std::string buf;
+        const char* values = block->GetValues(&buf);
+        if (values == NULL) {
+            PDLOG(WARNING, "fail to uncompress time block, drop %u records", block->GetCount());
+            keep_cnt = 0;
+        } else {
+            std::vector<TimeBlock::Record> records;
+            block->GetRecords(values, 0, &records);
+            kept = TimeBlock::New(records.data(), keep_cnt, block->IsCompressed());
+            idx_byte_size_.fetch_add(kept->GetByteSize(), std::memory_order_relaxed);
+        }
+    }
+    // the readers on the blocks cut still reach the ones after them
+    if (pre == NULL) {
+        entry->blocks_.store(kept, std::memory_order_release);
+    } else {
+        pre->SetNext(kept);
+    }
+    cut->push_back(CutBlock{block, static_cast<uint32_t>(keep_cnt)});
+    for (block = block->GetNext(); block != NULL; block = block->GetNext()) {
+        cut->push_back(CutBlock{block, 0});
+    }
+}
+
+void Segment::RetireBlocks(const std::vector<CutBlock>& cut, uint64_t& gc_idx_cnt, uint64_t& gc_record_cnt,
+                           uint64_t& gc_record_byte_size) {
+    if (cut.empty()) {
+        return;
+    }
+    std::vector<TimeBlock*> blocks;
+    for (const auto& cur : cut) {
+        for (uint32_t i = cur.pos; i < cur.block->GetCount(); i++) {
+            gc_idx_cnt++;
+            if (cur.block->IsOwner(i)) {
+                gc_record_byte_size += GetRecordSize(cur.block->GetSize(i));
+                gc_record_cnt++;
+            }
+        }
+        idx_byte_size_.fetch_sub(cur.block->GetByteSize(), std::memory_order_relaxed);
+        blocks.push_back(cur.block);
+    }
+    std::lock_guard<std::mutex> lock(gc_mu_);
+    retired_nodes_.push_back(RetiredNodes{gc_version_.load(std::memory_order_relaxed), NULL, std::move(blocks)});
+}
+
+void Segment::FreeBlocks(KeyEntry* entry, uint64_t& gc_idx_cnt, uint64_t& gc_record_cnt,
+                         uint64_t& gc_record_byte_size) {
+    TimeBlock* block = entry->blocks_.exchange(NULL, std::memory_order_relaxed);
+    while (block != NULL) {
+        for (uint32_t i = 0; i < block->GetCount(); i++) {
+            gc_idx_cnt++;
+            if (block->IsOwner(i)) {
+                gc_record_byte_size += GetRecordSize(block->GetSize(i));
+                gc_record_cnt++;
+            }
+        }
+        idx_byte_size_.fetch_sub(block->GetByteSize(), std::memory_order_relaxed);
+        TimeBlock* next = block->GetNext();
+        delete block;
+        block = next;
+    }
+}
+
+::openmldb::base::Node<uint64_t, DataBlock*>* Segment::SealUnlock(KeyEntry* entry,
+                                                                  std::vector<TimeBlock*>* replaced) {
+    uint64_t hot_cnt = FLAGS_time_block_hot_cnt;
+    ::openmldb::base::Node<uint64_t, DataBlock*>* node = entry->entries.GetFirst();
+    for (uint64_t i = 0; i < hot_cnt && node != NULL; i++) {
+        node = node->GetNext(0);
+    }
+    std::vector<TimeBlock::Record> records;
+    for (auto* cur = node; cur != NULL; cur = cur->GetNext(0)) {
+        DataBlock* block = cur->GetValue();
+        // gc is the only one which drops the references of the data blocks, so the count is stable here
+        bool own = block->dim_cnt_down.load(std::memory_order_relaxed) <= 1;
+        records.push_back(TimeBlock::Record{cur->GetKey(), block->data, block->size, own});
+    }
+    if (records.empty() || records.size() < FLAGS_time_block_min_cnt) {
+        return NULL;
+    }
+    // the blocks newer than the oldest record to seal are merged with the records, they are put late
+    uint64_t min_time = records.back().time;
+    TimeBlock* rest = entry->blocks_.load(std::memory_order_relaxed);
+    std::deque<std::string> bufs;
+    std::vector<TimeBlock::Record> merged;
+    for (; rest != NULL && rest->GetMaxTime() > min_time; rest = rest->GetNext()) {
+        bufs.emplace_back();
+        const char* values = rest->GetValues(&bufs.back());
+        if (values == NULL) {
+            PDLOG(WARNING, "fail to uncompress time block, skip sealing");
+            replaced->clear();
+            return NULL;
+        }
+        rest->GetRecords(values, 0, &merged);
+        replaced->push_back(rest);
+    }
+    if (!merged.empty()) {
+        std::vector<TimeBlock::Record> sealed;
+        sealed.reserve(records.size() + merged.size());
+        std::merge(records.begin(), records.end(), merged.begin(), merged.end(), std::back_inserter(sealed),
+                   [](const TimeBlock::Record& a, const TimeBlock::Record& b) { return a.time > b.time; });
+        records.swap(sealed);
+    }
+    uint32_t max_cnt = std::max(FLAGS_time_block_max_cnt, 1u);
+    TimeBlock* head = NULL;
+    TimeBlock* tail = NULL;
+    for (uint64_t start = 0; start < records.size(); start += max_cnt) {
+        uint32_t cnt = std::min(static_cast<uint64_t>(max_cnt), records.size() - start);
+        TimeBlock* block = TimeBlock::New(&records[start], cnt, FLAGS_time_block_compress);
+        idx_byte_size_.fetch_add(block->GetByteSize(), std::memory_order_relaxed);
+        if (tail == NULL) {
+            head = block;
+        } else {
+            tail->SetNext(block);
+        }
+        tail = block;
+    }
+    tail->SetNext(rest);
+    // the readers check the sequence after they move, so a reader sees the records either in the skiplist or in the
+    // blocks. It seeks the last record again if the sequence is changed
+    entry->seal_seq_.store(entry->seal_seq_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    entry->blocks_.store(head, std::memory_order_release);
+    node = entry->entries.SplitByPos(hot_cnt);
+    entry->seal_seq_.store(entry->seal_seq_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    return node;
+}
+
+void Segment::SealTimeBlocks() {
+    if (FLAGS_time_block_hot_cnt == 0) {
+        return;
+    }
+    uint64_t consumed = ::baidu::common::timer::get_micros();
+    uint64_t seal_cnt = 0;
+    std::unique_ptr<KeyEntries::Iterator> it(entries_->NewIterator());
+    for (it->SeekToFirst(); it->Valid(); it->Next()) {
+        void* value = it->GetValue();
+        for (uint32_t i = 0; i < ts_cnt_; i++) {
+            // a list with latest bound is short already
+            if (GetLatestBound(i) > 0) {
+                continue;
+            }
+            KeyEntry* entry = ts_cnt_ > 1 ? ((KeyEntry**)value)[i] : (KeyEntry*)value;  // NOLINT
+            ::openmldb::base::Node<uint64_t, DataBlock*>* node = NULL;
+            std::vector<TimeBlock*> replaced;
+            {
+                std::lock_guard<std::mutex> lock(mu_);
+                node = SealUnlock(entry, &replaced);
+            }
+            if (node == NULL) {
+                continue;
+            }
+            // the records are in the blocks now, the nodes are retired without counting them as gc
+            for (auto* cur = node; cur != NULL; cur = cur->GetNextNoBarrier(0)) {
+                idx_byte_size_.fetch_sub(GetRecordTsIdxSize(cur->Height()), std::memory_order_relaxed);
+                DataBlock* block = cur->GetValue();
+                block->retired_cnt.fetch_add(1, std::memory_order_relaxed);
+                block->Unref();
+                seal_cnt++;
+            }
+            for (TimeBlock* block : replaced) {
+                idx_byte_size_.fetch_sub(block->GetByteSize(), std::memory_order_relaxed);
+            }
+            std::lock_guard<std::mutex> lock(gc_mu_);
+            retired_nodes_.push_back(
+                RetiredNodes{gc_version_.load(std::memory_order_relaxed), node, std::move(replaced)});
+        }
+    }
+    DEBUGLOG("[SealTimeBlocks] segment seal %lu records consumed %lu", seal_cnt,
+             (::baidu::common::timer::get_micros() - consumed) / 1000);
+}
+
+void Segment::MoveRecords(uint64_t time, const std::map<uint32_t, uint32_t>& ts_index_map, const RecordWriter& writer,
+                          uint64_t& gc_idx_cnt, uint64_t& gc_record_cnt, uint64_t& gc_record_byte_size) {
+    if (ts_index_map.empty()) {
+        return;
+    }
+    uint64_t consumed = ::baidu::common::timer::get_micros();
+    uint64_t old = gc_idx_cnt;
+    // the real index of the lists to move and their index ids
+    std::vector<std::pair<uint32_t, uint32_t>> lists;
+    if (ts_cnt_ > 1) {
+        for (const auto& kv : ts_index_map) {
+            auto pos = ts_idx_map_.find(kv.first);
+            if (pos != ts_idx_map_.end() && pos->second < ts_cnt_) {
+                lists.emplace_back(pos->second, kv.second);
+            }
+        }
+    } else {
+        lists.emplace_back(0, ts_index_map.begin()->second);
+    }
+    std::unique_ptr<KeyEntries::Iterator> it(entries_->NewIterator());
+    it->SeekToFirst();
+    while (it->Valid()) {
+        void* value = it->GetValue();
+        Slice key = it->GetKey();
+        it->Next();
+        bool moved = false;
+        for (const auto& list : lists) {
+            KeyEntry* entry = ts_cnt_ > 1 ? ((KeyEntry**)value)[list.first] : (KeyEntry*)value;  // NOLINT
+            uint64_t last_time = 0;
+            if (!entry->GetLastTime(&last_time) || last_time > time) {
+                continue;
+            }
+            std::set<DataBlock*> written;
+            {
+                KeyEntryIterator entry_it(entry);
+                for (entry_it.Seek(time); entry_it.Valid(); entry_it.Next()) {
+                    writer(list.second, key, entry_it.GetKey(), entry_it.GetValue());
+                    if (entry_it.GetBlock() != NULL) {
+                        written.insert(entry_it.GetBlock());
+                    }
+                }
+            }
+            ::openmldb::base::Node<uint64_t, DataBlock*>* node = NULL;
+            std::vector<CutBlock> cut;
+            {
+                std::lock_guard<std::mutex> lock(mu_);
+                TimeBlock* head = entry->blocks_.load(std::memory_order_relaxed);
+                node = entry->entries.Split(time);
+                if (head != NULL) {
+                    CutBlocksUnlock(entry, CountNewer(head, time), &cut);
+                }
+            }
+            // the records put late after they were written
+            for (auto* cur = node; cur != NULL; cur = cur->GetNextNoBarrier(0)) {
+                DataBlock* block = cur->GetValue();
+                if (written.find(block) == written.end()) {
+                    writer(list.second, key, cur->GetKey(), Slice(block->data, block->size));
+                }
+            }
+            uint64_t entry_gc_idx_cnt = 0;
+            RetireList(node, entry_gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
+            RetireBlocks(cut, entry_gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
+            entry->count_.fetch_sub(entry_gc_idx_cnt, std::memory_order_relaxed);
+            if (ts_cnt_ > 1) {
+                idx_cnt_vec_[list.first]->fetch_sub(entry_gc_idx_cnt, std::memory_order_relaxed);
+            }
+            gc_idx_cnt += entry_gc_idx_cnt;
+            moved = true;
+        }
+        if (!moved) {
+            continue;
+        }
+        ::openmldb::base::Node<Slice, void*>* entry_node = NULL;
+        {
+            std::lock_guard<std::mutex> lock(mu_);
+            bool is_empty = true;
+            for (uint32_t i = 0; i < ts_cnt_ && is_empty; i++) {
+                KeyEntry* entry = ts_cnt_ > 1 ? ((KeyEntry**)value)[i] : (KeyEntry*)value;  // NOLINT
+                is_empty = entry->IsEmpty();
+            }
+            if (is_empty) {
+                entry_node = entries_->Remove(key);
+            }
+        }
+        if (entry_node != NULL) {
+            std::lock_guard<std::mutex> lock(gc_mu_);
+            entry_free_list_->Insert(gc_version_.load(std::memory_order_relaxed), entry_node);
+        }
+    }
+    if (ts_cnt_ <= 1) {
+        idx_cnt_.fetch_sub(gc_idx_cnt - old, std::memory_order_relaxed);
+    }
+    DEBUGLOG("[MoveRecords] segment move records not newer than %lu consumed %lu, count %lu", time,
+             (::baidu::common::timer::get_micros() - consumed) / 1000, gc_idx_cnt - old);
+}
+
+void Segment::IncrGcVersion() {
+    {
+        // the key index nodes removed by puts and gc in this version are freed with the nodes gc unlinked
+        std::lock_guard<std::mutex> lock(mu_);
+        entries_->RetireGarbage(gc_version_.load(std::memory_order_relaxed));
+    }
+    std::lock_guard<std::mutex> lock(gc_mu_);
+    uint64_t epoch = EpochManager::GetInstance()->Advance();
+    uint64_t version = gc_version_.fetch_add(1, std::memory_order_relaxed) + 1;
+    version_epochs_.emplace_back(version, epoch);
+}
+
+bool Segment::GetFreeVersion(uint64_t* version) {
     uint64_t cur_version = gc_version_.load(std::memory_order_relaxed);
     if (cur_version < FLAGS_gc_deleted_pk_version_delta) {
+        return false;
+    }
+    uint64_t max_version = cur_version - FLAGS_gc_deleted_pk_version_delta;
+    uint64_t safe_epoch = EpochManager::GetInstance()->GetSafeEpoch();
+    bool found = false;
+    std::lock_guard<std::mutex> lock(gc_mu_);
+    // the nodes of version v are unlinked before the epoch of version v + 1, no reader can see them if all the
+    // readers are in that epoch or later
+    while (!version_epochs_.empty() && version_epochs_.front().first <= max_version + 1 &&
+           version_epochs_.front().second <= safe_epoch) {
+        *version = version_epochs_.front().first - 1;
+        version_epochs_.pop_front();
+        found = true;
+    }
+    return found;
+}
+
+void Segment::GcFreeList(uint64_t& gc_idx_cnt, uint64_t& gc_record_cnt, uint64_t& gc_record_byte_size) {
+    uint64_t free_list_version = 0;
+    if (!GetFreeVersion(&free_list_version)) {
         return;
     }
-    uint64_t free_list_version = cur_version - FLAGS_gc_deleted_pk_version_delta;
     GcEntryFreeList(free_list_version, gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
+    GcNodeFreeList(free_list_version, gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
+    GcRetiredNodes(free_list_version);
 }
 
 void Segment::ExecuteGc(const TTLSt& ttl_st, uint64_t& gc_idx_cnt, uint64_t& gc_record_cnt,
@@ -493,14 +1181,14 @@ void Segment::Gc4Head(uint64_t keep_cnt, uint64_t& gc_idx_cnt, uint64_t& gc_reco
     while (it->Valid()) {
         KeyEntry* entry = (KeyEntry*)it->GetValue();  // NOLINT
         ::openmldb::base::Node<uint64_t, DataBlock*>* node = NULL;
+        std::vector<CutBlock> cut;
         {
             std::lock_guard<std::mutex> lock(mu_);
-            if (entry->refs_.load(std::memory_order_acquire) <= 0) {
-                node = entry->entries.SplitByPos(keep_cnt);
-            }
+            node = SplitUnlock(entry, TTLSt(0, keep_cnt, TTLType::kLatestTime), &cut);
         }
         uint64_t entry_gc_idx_cnt = 0;
-        FreeList(node, entry_gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
+        RetireList(node, entry_gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
+        RetireBlocks(cut, entry_gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
         entry->count_.fetch_sub(entry_gc_idx_cnt, std::memory_order_relaxed);
         gc_idx_cnt += entry_gc_idx_cnt;
         it->Next();
@@ -532,72 +1220,38 @@ void Segment::GcAllType(const std::map<uint32_t, TTLSt>& ttl_st_map, uint64_t& g
             }
             KeyEntry* entry = entry_arr[pos->second];
             ::openmldb::base::Node<uint64_t, DataBlock*>* node = NULL;
-            bool continue_flag = false;
+            std::vector<CutBlock> cut;
+            uint64_t last_time = 0;
             switch (kv.second.ttl_type) {
-                case ::openmldb::storage::TTLType::kAbsoluteTime: {
-                    node = entry->entries.GetLast();
-                    if (node == NULL || node->GetKey() > kv.second.abs_ttl) {
-                        continue_flag = true;
-                    } else {
-                        node = NULL;
-                        std::lock_guard<std::mutex> lock(mu_);
-                        SplitList(entry, kv.second.abs_ttl, &node);
-                        if (entry->entries.IsEmpty()) {
-                            empty_cnt++;
-                        }
-                    }
-                    break;
-                }
-                case ::openmldb::storage::TTLType::kLatestTime: {
-                    std::lock_guard<std::mutex> lock(mu_);
-                    if (entry->refs_.load(std::memory_order_acquire) <= 0) {
-                        node = entry->entries.SplitByPos(kv.second.lat_ttl);
-                    }
-                    break;
-                }
+                case ::openmldb::storage::TTLType::kAbsoluteTime:
                 case ::openmldb::storage::TTLType::kAbsAndLat: {
-                    node = entry->entries.GetLast();
-                    if (node == NULL || node->GetKey() > kv.second.abs_ttl) {
-                        continue_flag = true;
-                    } else {
-                        node = NULL;
-                        std::lock_guard<std::mutex> lock(mu_);
-                        if (entry->refs_.load(std::memory_order_acquire) <= 0) {
-                            node = entry->entries.SplitByKeyAndPos(kv.second.abs_ttl, kv.second.lat_ttl);
-                        }
+                    if (!entry->GetLastTime(&last_time) || last_time > kv.second.abs_ttl) {
+                        continue;
                     }
                     break;
                 }
+                case ::openmldb::storage::TTLType::kLatestTime:
+                    break;
                 case ::openmldb::storage::TTLType::kAbsOrLat: {
-                    node = entry->entries.GetLast();
-                    if (node == NULL) {
-                        continue_flag = true;
-                    } else {
-                        node = NULL;
-                        std::lock_guard<std::mutex> lock(mu_);
-                        if (entry->refs_.load(std::memory_order_acquire) <= 0) {
-                            if (kv.second.abs_ttl == 0) {
-                                node = entry->entries.SplitByPos(kv.second.lat_ttl);
-                            } else if (kv.second.lat_ttl == 0) {
-                                node = entry->entries.Split(kv.second.abs_ttl);
-                            } else {
-                                node = entry->entries.SplitByKeyOrPos(kv.second.abs_ttl, kv.second.lat_ttl);
-                            }
-                        }
-                        if (entry->entries.IsEmpty()) {
-                            empty_cnt++;
-                        }
+                    if (!entry->GetLastTime(&last_time)) {
+                        continue;
                     }
                     break;
                 }
                 default:
                     return;
             }
-            if (continue_flag) {
-                continue;
+            {
+                std::lock_guard<std::mutex> lock(mu_);
+                node = SplitUnlock(entry, kv.second, &cut);
+                if (kv.second.ttl_type != ::openmldb::storage::TTLType::kLatestTime &&
+                    kv.second.ttl_type != ::openmldb::storage::TTLType::kAbsAndLat && entry->IsEmpty()) {
+                    empty_cnt++;
+                }
             }
             uint64_t entry_gc_idx_cnt = 0;
-            FreeList(node, entry_gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
+            RetireList(node, entry_gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
+            RetireBlocks(cut, entry_gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
             entry->count_.fetch_sub(entry_gc_idx_cnt, std::memory_order_relaxed);
             idx_cnt_vec_[pos->second]->fetch_sub(entry_gc_idx_cnt, std::memory_order_relaxed);
             gc_idx_cnt += entry_gc_idx_cnt;
@@ -608,7 +1262,7 @@ void Segment::GcAllType(const std::map<uint32_t, TTLSt>& ttl_st_map, uint64_t& g
             {
                 std::lock_guard<std::mutex> lock(mu_);
                 for (uint32_t i = 0; i < ts_cnt_; i++) {
-                    if (!entry_arr[i]->entries.IsEmpty()) {
+                    if (!entry_arr[i]->IsEmpty()) {
                         is_empty = false;
                         break;
                     }
@@ -628,13 +1282,6 @@ void Segment::GcAllType(const std::map<uint32_t, TTLSt>& ttl_st_map, uint64_t& g
     delete it;
 }
 
-void Segment::SplitList(KeyEntry* entry, uint64_t ts, ::openmldb::base::Node<uint64_t, DataBlock*>** node) {
-    // skip entry that ocupied by reader
-    if (entry->refs_.load(std::memory_order_acquire) <= 0) {
-        *node = entry->entries.Split(ts);
-    }
-}
-
 // fast gc with no global pause
 void Segment::Gc4TTL(const uint64_t time, uint64_t& gc_idx_cnt, uint64_t& gc_record_cnt,
                      uint64_t& gc_record_byte_size) {
@@ -646,22 +1293,23 @@ void Segment::Gc4TTL(const uint64_t time, uint64_t& gc_idx_cnt, uint64_t& gc_rec
         KeyEntry* entry = (KeyEntry*)it->GetValue();  // NOLINT
         Slice key = it->GetKey();
         it->Next();
-        ::openmldb::base::Node<uint64_t, DataBlock*>* node = entry->entries.GetLast();
-        if (node == NULL) {
+        uint64_t last_time = 0;
+        if (!entry->GetLastTime(&last_time)) {
             continue;
-        } else if (node->GetKey() > time) {
+        } else if (last_time > time) {
             DEBUGLOG(
                 "[Gc4TTL] segment gc with key %lu need not ttl, last node "
                 "key %lu",
-                time, node->GetKey());
+                time, last_time);
             continue;
         }
-        node = NULL;
+        ::openmldb::base::Node<uint64_t, DataBlock*>* node = NULL;
+        std::vector<CutBlock> cut;
         ::openmldb::base::Node<Slice, void*>* entry_node = NULL;
         {
             std::lock_guard<std::mutex> lock(mu_);
-            SplitList(entry, time, &node);
-            if (entry->entries.IsEmpty()) {
+            node = SplitUnlock(entry, TTLSt(time, 0, TTLType::kAbsoluteTime), &cut);
+            if (entry->IsEmpty()) {
                 entry_node = entries_->Remove(key);
             }
         }
@@ -670,7 +1318,8 @@ void Segment::Gc4TTL(const uint64_t time, uint64_t& gc_idx_cnt, uint64_t& gc_rec
             entry_free_list_->Insert(gc_version_.load(std::memory_order_relaxed), entry_node);
         }
         uint64_t entry_gc_idx_cnt = 0;
-        FreeList(node, entry_gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
+        RetireList(node, entry_gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
+        RetireBlocks(cut, entry_gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
         entry->count_.fetch_sub(entry_gc_idx_cnt, std::memory_order_relaxed);
         gc_idx_cnt += entry_gc_idx_cnt;
     }
@@ -692,26 +1341,26 @@ void Segment::Gc4TTLAndHead(const uint64_t time, const uint64_t keep_cnt, uint64
     it->SeekToFirst();
     while (it->Valid()) {
         KeyEntry* entry = (KeyEntry*)it->GetValue();  // NOLINT
-        ::openmldb::base::Node<uint64_t, DataBlock*>* node = entry->entries.GetLast();
         it->Next();
-        if (node == NULL) {
+        uint64_t last_time = 0;
+        if (!entry->GetLastTime(&last_time)) {
             continue;
-        } else if (node->GetKey() > time) {
+        } else if (last_time > time) {
             DEBUGLOG(
                 "[Gc4TTLAndHead] segment gc with key %lu need not ttl, last "
                 "node key %lu",
-                time, node->GetKey());
+                time, last_time);
             continue;
         }
-        node = NULL;
+        ::openmldb::base::Node<uint64_t, DataBlock*>* node = NULL;
+        std::vector<CutBlock> cut;
         {
             std::lock_guard<std::mutex> lock(mu_);
-            if (entry->refs_.load(std::memory_order_acquire) <= 0) {
-                node = entry->entries.SplitByKeyAndPos(time, keep_cnt);
-            }
+            node = SplitUnlock(entry, TTLSt(time, keep_cnt, TTLType::kAbsAndLat), &cut);
         }
         uint64_t entry_gc_idx_cnt = 0;
-        FreeList(node, entry_gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
+        RetireList(node, entry_gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
+        RetireBlocks(cut, entry_gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
         entry->count_.fetch_sub(entry_gc_idx_cnt, std::memory_order_relaxed);
         gc_idx_cnt += entry_gc_idx_cnt;
     }
@@ -743,18 +1392,17 @@ void Segment::Gc4TTLOrHead(const uint64_t time, const uint64_t keep_cnt, uint64_
         KeyEntry* entry = (KeyEntry*)it->GetValue();  // NOLINT
         Slice key = it->GetKey();
         it->Next();
-        ::openmldb::base::Node<uint64_t, DataBlock*>* node = entry->entries.GetLast();
-        if (node == NULL) {
+        uint64_t last_time = 0;
+        if (!entry->GetLastTime(&last_time)) {
             continue;
         }
-        node = NULL;
+        ::openmldb::base::Node<uint64_t, DataBlock*>* node = NULL;
+        std::vector<CutBlock> cut;
         ::openmldb::base::Node<Slice, void*>* entry_node = NULL;
         {
             std::lock_guard<std::mutex> lock(mu_);
-            if (entry->refs_.load(std::memory_order_acquire) <= 0) {
-                node = entry->entries.SplitByKeyOrPos(time, keep_cnt);
-            }
-            if (entry->entries.IsEmpty()) {
+            node = SplitUnlock(entry, TTLSt(time, keep_cnt, TTLType::kAbsOrLat), &cut);
+            if (entry->IsEmpty()) {
                 entry_node = entries_->Remove(key);
             }
         }
@@ -763,7 +1411,8 @@ void Segment::Gc4TTLOrHead(const uint64_t time, const uint64_t keep_cnt, uint64_
             entry_free_list_->Insert(gc_version_.load(std::memory_order_relaxed), entry_node);
         }
         uint64_t entry_gc_idx_cnt = 0;
-        FreeList(node, entry_gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
+        RetireList(node, entry_gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
+        RetireBlocks(cut, entry_gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
         entry->count_.fetch_sub(entry_gc_idx_cnt, std::memory_order_relaxed);
         gc_idx_cnt += entry_gc_idx_cnt;
     }
@@ -813,8 +1462,7 @@ MemTableIterator* Segment::NewIterator(const Slice& key, Ticket& ticket) {
     if (entries_->Get(key, entry) < 0 || entry == NULL) {
         return new MemTableIterator(NULL);
     }
-    ticket.Push((KeyEntry*)entry);                                           // NOLINT
-    return new MemTableIterator(((KeyEntry*)entry)->entries.NewIterator());  // NOLINT
+    return new MemTableIterator(((KeyEntry*)entry)->NewIterator());  // NOLINT
 }
 
 MemTableIterator* Segment::NewIterator(const Slice& key, uint32_t idx, Ticket& ticket) {
@@ -829,11 +1477,150 @@ MemTableIterator* Segment::NewIterator(const Slice& key, uint32_t idx, Ticket& t
     if (entries_->Get(key, entry_arr) < 0 || entry_arr == NULL) {
         return new MemTableIterator(NULL);
     }
-    ticket.Push(((KeyEntry**)entry_arr)[pos->second]);                                         // NOLINT
-    return new MemTableIterator(((KeyEntry**)entry_arr)[pos->second]->entries.NewIterator());  // NOLINT
+    return new MemTableIterator(((KeyEntry**)entry_arr)[pos->second]->NewIterator());  // NOLINT
+}
+
+bool KeyEntry::GetLastTime(uint64_t* time) {
+    bool found = false;
+    if (!entries.IsEmpty()) {
+        ::openmldb::base::Node<uint64_t, DataBlock*>* node = entries.GetLast();
+        if (node != NULL) {
+            *time = node->GetKey();
+            found = true;
+        }
+    }
+    TimeBlock* block = blocks_.load(std::memory_order_acquire);
+    if (block != NULL) {
+        for (TimeBlock* next = block->GetNext(); next != NULL; next = next->GetNext()) {
+            block = next;
+        }
+        // a late put in the skiplist may be older than the blocks
+        if (!found || block->GetMinTime() < *time) {
+            *time = block->GetMinTime();
+        }
+        found = true;
+    }
+    return found;
+}
+
+KeyEntryIterator* KeyEntry::NewIterator() { return new KeyEntryIterator(this); }
+
+KeyEntryIterator::KeyEntryIterator(KeyEntry* entry)
+    : entry_(entry),
+      it_(entry->entries.NewIterator()),
+      block_(NULL),
+      pos_(0),
+      in_list_(false),
+      valid_(false),
+      key_(0),
+      dup_(0),
+      seq_(0),
+      values_block_(NULL),
+      values_(NULL),
+      buf_() {}
+
+KeyEntryIterator::~KeyEntryIterator() { delete it_; }
+
+void KeyEntryIterator::Pick() {
+    bool list_valid = it_->Valid();
+    if (!list_valid && block_ == NULL) {
+        valid_ = false;
+        in_list_ = false;
+        return;
+    }
+    valid_ = true;
+    in_list_ = list_valid && (block_ == NULL || it_->GetKey() >= block_->GetTime(pos_));
+    key_ = in_list_ ? it_->GetKey() : block_->GetTime(pos_);
+}
+
+void KeyEntryIterator::NextUnchecked() {
+    if (in_list_) {
+        it_->Next();
+    } else if (++pos_ >= block_->GetCount()) {
+        block_ = block_->GetNext();
+        pos_ = 0;
+    }
+    Pick();
+}
+
+void KeyEntryIterator::SeekUnchecked(uint64_t time, uint64_t skip) {
+    it_->Seek(time);
+    block_ = entry_->blocks_.load(std::memory_order_acquire);
+    while (block_ != NULL && block_->GetMinTime() > time) {
+        block_ = block_->GetNext();
+    }
+    pos_ = block_ == NULL ? 0 : block_->Seek(time);
+    Pick();
+    uint64_t skipped = 0;
+    while (skipped < skip && valid_ && key_ == time) {
+        NextUnchecked();
+        skipped++;
+    }
+    dup_ = valid_ && key_ == time ? skipped + 1 : 1;
+}
+
+void KeyEntryIterator::SeekChecked(uint64_t time, uint64_t skip) {
+    while (true) {
+        seq_ = entry_->seal_seq_.load(std::memory_order_acquire);
+        if (seq_ & 1) {
+            // the sealing holds only a few stores
+            continue;
+        }
+        SeekUnchecked(time, skip);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (entry_->seal_seq_.load(std::memory_order_relaxed) == seq_) {
+            return;
+        }
+    }
+}
+
+void KeyEntryIterator::Next() {
+    uint64_t key = key_;
+    uint64_t dup = dup_;
+    NextUnchecked();
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (entry_->seal_seq_.load(std::memory_order_relaxed) != seq_) {
+        SeekChecked(key, dup);
+        return;
+    }
+    dup_ = valid_ && key_ == key ? dup + 1 : 1;
+}
+
+::openmldb::base::Slice KeyEntryIterator::GetValue() const {
+    if (in_list_) {
+        DataBlock* block = it_->GetValue();
+        return ::openmldb::base::Slice(block->data, block->size);
+    }
+    if (values_block_ != block_) {
+        values_ = block_->GetValues(&buf_);
+        values_block_ = block_;
+    }
+    if (values_ == NULL) {
+        return ::openmldb::base::Slice();
+    }
+    return block_->GetValue(values_, pos_);
 }
 
-MemTableIterator::MemTableIterator(TimeEntries::Iterator* it) : it_(it) {}
+void KeyEntryIterator::Seek(uint64_t time) { SeekChecked(time, 0); }
+
+void KeyEntryIterator::SeekToFirst() { SeekChecked(UINT64_MAX, 0); }
+
+void KeyEntryIterator::SeekToLast() {
+    uint64_t time = 0;
+    if (!entry_->GetLastTime(&time)) {
+        valid_ = false;
+        return;
+    }
+    uint64_t cnt = 0;
+    for (Seek(time); valid_ && key_ == time; Next()) {
+        cnt++;
+    }
+    if (cnt > 0) {
+        SeekChecked(time, cnt - 1);
+    }
+}
+
+MemTableIterator::MemTableIterator(KeyEntryIterator* it) : it_(it) {}
 
 MemTableIterator::~MemTableIterator() {
     if (it_ != NULL) {
@@ -862,9 +1649,7 @@ void MemTableIterator::Next() {
     it_->Next();
 }
 
-::openmldb::base::Slice MemTableIterator::GetValue() const {
-    return ::openmldb::base::Slice(it_->GetValue()->data, it_->GetValue()->size);
-}
+::openmldb::base::Slice MemTableIterator::GetValue() const { return it_->GetValue(); }
 
 uint64_t MemTableIterator::GetKey() const { return it_->GetKey(); }
 
@@ -18,17 +18,23 @@
 #define SRC_STORAGE_SEGMENT_H_
 
 #include <atomic>
+#include <deque>
+#include <functional>
 #include <map>
 #include <memory>
 #include <mutex>  // NOLINT
+#include <utility>
 #include <vector>
 
 #include "base/skiplist.h"
 #include "base/slice.h"
 #include "proto/tablet.pb.h"
+#include "storage/epoch.h"
 #include "storage/iterator.h"
+#include "storage/key_entries.h"
 #include "storage/schema.h"
 #include "storage/ticket.h"
+#include "storage/time_block.h"
 
 namespace openmldb {
 namespace storage {
@@ -41,18 +47,22 @@ class Segment;
 class Ticket;
 
 struct DataBlock {
-    // dimension count down
-    uint8_t dim_cnt_down;
+    // dimension count down, the indexes referring to the block. It's changed by the segments of different indexes
+    std::atomic<uint8_t> dim_cnt_down;
+    // the nodes referring to the block which are unlinked by gc but not freed yet. The block is freed when both
+    // counts are 0
+    std::atomic<uint8_t> retired_cnt;
     uint32_t size;
     char* data;
 
-    DataBlock(uint8_t dim_cnt, const char* input, uint32_t len) : dim_cnt_down(dim_cnt), size(len), data(NULL) {
+    DataBlock(uint8_t dim_cnt, const char* input, uint32_t len)
+        : dim_cnt_down(dim_cnt), retired_cnt(0), size(len), data(NULL) {
         data = new char[len];
         memcpy(data, input, len);
     }
 
     DataBlock(uint8_t dim_cnt, char* input, uint32_t len, bool skip_copy)
-        : dim_cnt_down(dim_cnt), size(len), data(NULL) {
+        : dim_cnt_down(dim_cnt), retired_cnt(0), size(len), data(NULL) {
         if (skip_copy) {
             data = input;
         } else {
@@ -65,6 +75,23 @@ struct DataBlock {
         delete[] data;
         data = NULL;
     }
+
+    // take the reference of one more index
+    inline void Ref() { dim_cnt_down.fetch_add(1, std::memory_order_relaxed); }
+
+    // take the reference of one more index unless the count is 0 already, the block may be freed by gc then
+    inline bool RefIfAlive() {
+        uint8_t cnt = dim_cnt_down.load(std::memory_order_relaxed);
+        while (cnt > 0) {
+            if (dim_cnt_down.compare_exchange_weak(cnt, cnt + 1, std::memory_order_acq_rel)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // drop the reference of an index, true if it was the last one and the count is 0 now
+    inline bool Unref() { return dim_cnt_down.fetch_sub(1, std::memory_order_acq_rel) == 1; }
 };
 
 // the desc time comparator
@@ -82,9 +109,11 @@ struct TimeComparator {
 static const TimeComparator tcmp;
 typedef ::openmldb::base::Skiplist<uint64_t, DataBlock*, TimeComparator> TimeEntries;
 
+class KeyEntryIterator;
+
 class MemTableIterator : public TableIterator {
  public:
-    explicit MemTableIterator(TimeEntries::Iterator* it);
+    explicit MemTableIterator(KeyEntryIterator* it);
     virtual ~MemTableIterator();
     void Seek(const uint64_t time) override;
     bool Valid() override;
@@ -95,14 +124,23 @@ class MemTableIterator : public TableIterator {
     void SeekToLast() override;
 
  private:
-    TimeEntries::Iterator* it_;
+    KeyEntryIterator* it_;
 };
 
+// KeyEntry keeps the records of a key in a ts index. The latest records are in the skiplist and the older ones may
+// be sealed into the time blocks by gc, see Segment::SealTimeBlocks
 class KeyEntry {
  public:
-    KeyEntry() : entries(12, 4, tcmp), refs_(0), count_(0) {}
-    explicit KeyEntry(uint8_t height) : entries(height, 4, tcmp), refs_(0), count_(0) {}
-    ~KeyEntry() {}
+    KeyEntry() : entries(12, 4, tcmp), count_(0), blocks_(NULL), seal_seq_(0) {}
+    explicit KeyEntry(uint8_t height) : entries(height, 4, tcmp), count_(0), blocks_(NULL), seal_seq_(0) {}
+    ~KeyEntry() {
+        TimeBlock* block = blocks_.load(std::memory_order_relaxed);
+        while (block != NULL) {
+            TimeBlock* next = block->GetNext();
+            delete block;
+            block = next;
+        }
+    }
 
     // just return the count of datablock
     uint64_t Release() {
@@ -112,44 +150,116 @@ class KeyEntry {
         while (it->Valid()) {
             cnt += 1;
             DataBlock* block = it->GetValue();
-            // Avoid double free
-            if (block->dim_cnt_down > 1) {
-                block->dim_cnt_down--;
-            } else {
+            // Avoid double free, the block of retired nodes is freed with them
+            if (block->Unref() && block->retired_cnt.load(std::memory_order_acquire) == 0) {
                 delete block;
             }
             it->Next();
         }
         entries.Clear();
         delete it;
+        TimeBlock* block = blocks_.exchange(NULL, std::memory_order_relaxed);
+        while (block != NULL) {
+            TimeBlock* next = block->GetNext();
+            cnt += block->GetCount();
+            delete block;
+            block = next;
+        }
         return cnt;
     }
 
-    void Ref() { refs_.fetch_add(1, std::memory_order_relaxed); }
+    uint64_t GetCount() { return count_.load(std::memory_order_relaxed); }
+
+    bool IsEmpty() { return entries.IsEmpty() && blocks_.load(std::memory_order_acquire) == NULL; }
 
-    void UnRef() { refs_.fetch_sub(1, std::memory_order_relaxed); }
+    // the time of the oldest record, it returns false if there is none
+    bool GetLastTime(uint64_t* time);
 
-    uint64_t GetCount() { return count_.load(std::memory_order_relaxed); }
+    // delete the iterator after it's used, the ticket must be taken before
+    KeyEntryIterator* NewIterator();
 
  public:
     TimeEntries entries;
-    std::atomic<uint64_t> refs_;
     std::atomic<uint64_t> count_;
+    // the sealed records from the newest to the oldest, they are all older than the records in the skiplist
+    // except the ones put late
+    std::atomic<TimeBlock*> blocks_;
+    // it's odd while the records are being sealed
+    std::atomic<uint64_t> seal_seq_;
     friend Segment;
 };
 
-struct SliceComparator {
-    int operator()(const ::openmldb::base::Slice& a, const ::openmldb::base::Slice& b) const { return a.compare(b); }
+// KeyEntryIterator iterates the records of a key entry in the desc order of time. The records in the skiplist are
+// merged with the time blocks since a late put may be older than the sealed records. If the records are sealed
+// during the iteration, it seeks the position of the last record again, the equal times are told apart by the
+// count of the records with that time before it.
+class KeyEntryIterator {
+ public:
+    explicit KeyEntryIterator(KeyEntry* entry);
+    ~KeyEntryIterator();
+
+    KeyEntryIterator(const KeyEntryIterator&) = delete;
+    KeyEntryIterator& operator=(const KeyEntryIterator&) = delete;
+
+    bool Valid() const { return valid_; }
+
+    void Next();
+
+    const uint64_t& GetKey() const { return key_; }
+
+    ::openmldb::base::Slice GetValue() const;
+
+    // the data block of the record, it's NULL if the record is sealed in a time block
+    DataBlock* GetBlock() const { return in_list_ ? it_->GetValue() : NULL; }
+
+    // whether the value is uncompressed into the buffer of the iterator, it's overwritten once the iterator reads
+    // another block. The other values are in the segment and live as long as the ticket of the iterator
+    bool IsValueBuffered() const { return !in_list_ && block_ != NULL && block_->IsCompressed(); }
+
+    // the first record whose time is not greater than time
+    void Seek(uint64_t time);
+
+    void SeekToFirst();
+
+    void SeekToLast();
+
+ private:
+    // move to the record after the skip records with the time since the first one not greater than time
+    void SeekChecked(uint64_t time, uint64_t skip);
+    void SeekUnchecked(uint64_t time, uint64_t skip);
+    void NextUnchecked();
+    // pick the newer one of the skiplist and the block as the current record
+    void Pick();
+
+    KeyEntry* entry_;
+    TimeEntries::Iterator* it_;
+    TimeBlock* block_;
+    uint32_t pos_;
+    bool in_list_;
+    bool valid_;
+    uint64_t key_;
+    // the count of the records with key_ till the current one
+    uint64_t dup_;
+    uint64_t seq_;
+    // the uncompressed values of values_block_
+    mutable const TimeBlock* values_block_;
+    mutable const char* values_;
+    mutable std::string buf_;
 };
 
-typedef ::openmldb::base::Skiplist<::openmldb::base::Slice, void*, SliceComparator> KeyEntries;
+// the writer of the records moved out of a segment, the arguments are the index id, the key, the time and the value
+typedef std::function<void(uint32_t, const Slice&, uint64_t, const Slice&)> RecordWriter;
+
 typedef ::openmldb::base::Skiplist<uint64_t, ::openmldb::base::Node<Slice, void*>*, TimeComparator> KeyEntryNodeList;
+typedef ::openmldb::base::Skiplist<uint64_t, ::openmldb::base::Node<uint64_t, DataBlock*>*, TimeComparator>
+    DataNodeList;
 
 class Segment {
  public:
     Segment();
-    explicit Segment(uint8_t height);
-    Segment(uint8_t height, const std::vector<uint32_t>& ts_idx_vec);
+    explicit Segment(uint8_t height, ::openmldb::type::KeyIndexType key_index_type = ::openmldb::type::kSkiplist);
+    Segment(uint8_t height, const std::vector<uint32_t>& ts_idx_vec,
+            ::openmldb::type::KeyIndexType key_index_type = ::openmldb::type::kSkiplist);
     ~Segment();
 
     // Put time data
@@ -161,9 +271,37 @@ class Segment {
 
     void BulkLoadPut(unsigned int key_entry_id, const Slice& key, uint64_t time, DataBlock* row);
 
+    // load the time entries of a key which are in the list order, it's used to recover from checkpoint.
+    // the entries are added to the head of the list one by one from the last, so no search is needed
+    void LoadKeyEntry(const Slice& key, uint32_t key_entry_id,
+                      const std::vector<std::pair<uint64_t, DataBlock*>>& time_entries);
+
+    // the count of the records with time and the value data in the list of key_entry_id
+    uint32_t CountSame(const Slice& key, uint32_t key_entry_id, uint64_t time, const Slice& data);
+
+    // visit the key entries of a value in KeyEntries under the put mutex, so a concurrent put
+    // is seen in all the ts lists of the key or in none of them
+    void VisitKeyEntry(void* key_entry_or_list, const std::function<void(uint32_t, KeyEntry*)>& visitor);
+
+    // put a data block shared with other indexes and take a reference of it. It's skipped if the list has the block
+    // already, which is checked under the same lock as PutIfAbsent, or if gc has dropped the last reference of the
+    // block. Only the segment with one ts list is supported
+    bool PutBlockIfAbsent(const Slice& key, uint64_t time, DataBlock* row);
+
+    // put the copy of a record sealed in a time block, which has no data block to share. It's skipped if the list
+    // has more than same_cnt records with the same time and value, same_cnt is the count of them before the record
+    // in the source list, so the rows put twice are both kept
+    bool PutCopyIfAbsent(const Slice& key, uint64_t time, DataBlock* row, uint32_t same_cnt);
+
     void Put(const Slice& key, const TSDimensions& ts_dimension, DataBlock* row);
 
-    // Get time data
+    // put like Put but skip the row if the list has the block already, which is put by PutBlockIfAbsent while the
+    // index is extracted. false if the row is skipped, the reference of the block is not changed then
+    bool PutIfAbsent(const Slice& key, uint64_t time, DataBlock* row);
+
+    bool PutIfAbsent(const Slice& key, const TSDimensions& ts_dimension, DataBlock* row);
+
+    // Get time data, the records sealed into the time blocks have no data block and are read by the iterators
     bool Get(const Slice& key, uint64_t time, DataBlock** block);
 
     bool Get(const Slice& key, uint32_t idx, uint64_t time, DataBlock** block);
@@ -194,6 +332,7 @@ class Segment {
     void GcAllType(const std::map<uint32_t, TTLSt>& ttl_st_map, uint64_t& gc_idx_cnt,  // NOLINT
                    uint64_t& gc_record_cnt,                                            // NOLINT
                    uint64_t& gc_record_byte_size);                                     // NOLINT
+    // the ticket keeps the nodes the iterator visits from being freed, it must be taken before the call
     MemTableIterator* NewIterator(const Slice& key, Ticket& ticket);                   // NOLINT
     MemTableIterator* NewIterator(const Slice& key, uint32_t idx,
                                   Ticket& ticket);  // NOLINT
@@ -239,17 +378,62 @@ class Segment {
     int GetCount(const Slice& key, uint64_t& count);                // NOLINT
     int GetCount(const Slice& key, uint32_t idx, uint64_t& count);  // NOLINT
 
-    void IncrGcVersion() { gc_version_.fetch_add(1, std::memory_order_relaxed); }
+    // start a gc round, the epoch is advanced so the readers after it can't see the nodes unlinked before
+    void IncrGcVersion();
 
     void ReleaseAndCount(uint64_t& gc_idx_cnt,            // NOLINT
                          uint64_t& gc_record_cnt,         // NOLINT
                          uint64_t& gc_record_byte_size);  // NOLINT
 
+    // keep at most keep_cnt records per key on put, 0 means unbounded.
+    // the trimmed nodes are freed by GcFreeList after gc_deleted_pk_version_delta versions and the readers leave
+    void SetLatestBound(uint32_t real_idx, uint64_t keep_cnt);
+
+    uint64_t GetLatestBound(uint32_t real_idx) const {
+        if (real_idx >= latest_bound_vec_.size()) {
+            return 0;
+        }
+        return latest_bound_vec_[real_idx]->load(std::memory_order_relaxed);
+    }
+
+    // seal the records of each key after the latest time_block_hot_cnt ones into the time blocks, the nodes and the
+    // blocks replaced are retired like the ones gc unlinks. It's called by gc, the lists with latest bound are skipped
+    void SealTimeBlocks();
+
+    // move the records not newer than time to writer and drop them from the segment, ts_index_map maps the ts index of
+    // the lists to move to the index id passed to writer. The records are written before they are unlinked, so a reader
+    // may see a record in both places for a while. The records moved are counted like the ones gc drops
+    void MoveRecords(uint64_t time, const std::map<uint32_t, uint32_t>& ts_index_map, const RecordWriter& writer,
+                     uint64_t& gc_idx_cnt,            // NOLINT
+                     uint64_t& gc_record_cnt,         // NOLINT
+                     uint64_t& gc_record_byte_size);  // NOLINT
+
  private:
+    // the nodes and the time blocks unlinked by gc
+    struct RetiredNodes {
+        uint64_t version;
+        ::openmldb::base::Node<uint64_t, DataBlock*>* node;
+        std::vector<TimeBlock*> time_blocks;
+    };
+
+    // a time block cut by gc, the records from pos are expired
+    struct CutBlock {
+        TimeBlock* block;
+        uint32_t pos;
+    };
+
     void FreeList(::openmldb::base::Node<uint64_t, DataBlock*>* node, uint64_t& gc_idx_cnt,  // NOLINT
                   uint64_t& gc_record_cnt,         // NOLINT
                   uint64_t& gc_record_byte_size);  // NOLINT
-    void SplitList(KeyEntry* entry, uint64_t ts, ::openmldb::base::Node<uint64_t, DataBlock*>** node);
+    // count the nodes unlinked by gc and drop their references to the data blocks at once. The nodes are freed by
+    // GcFreeList after the readers which may see them leave, a data block is freed with the last node referring to
+    // it in any index, see DataBlock::retired_cnt
+    void RetireList(::openmldb::base::Node<uint64_t, DataBlock*>* node, uint64_t& gc_idx_cnt,  // NOLINT
+                    uint64_t& gc_record_cnt,         // NOLINT
+                    uint64_t& gc_record_byte_size);  // NOLINT
+    void GcRetiredNodes(uint64_t version);
+    // the max version whose nodes can be freed, it returns false if there is none
+    bool GetFreeVersion(uint64_t* version);
 
     void GcEntryFreeList(uint64_t version, uint64_t& gc_idx_cnt,  // NOLINT
                          uint64_t& gc_record_cnt,                 // NOLINT
@@ -258,6 +442,30 @@ class Segment {
                    uint64_t& gc_record_cnt,         // NOLINT
                    uint64_t& gc_record_byte_size);  // NOLINT
 
+    // need hold mu_
+    void TrimLatestUnlock(KeyEntry* entry, uint32_t real_idx);
+    // whether the list of the key has the data block with time, need hold mu_
+    bool HasBlockUnlock(const Slice& key, uint64_t time, DataBlock* row);
+    // seal the records after the hot ones into the time blocks and merge the blocks they overlap, need hold mu_.
+    // it returns the nodes unlinked, the blocks merged are added to replaced
+    ::openmldb::base::Node<uint64_t, DataBlock*>* SealUnlock(KeyEntry* entry, std::vector<TimeBlock*>* replaced);
+    // split the expired records of entry from the skiplist and the time blocks, the abs_ttl of ttl is the expire
+    // time and the lat_ttl is the count to keep. need hold mu_
+    ::openmldb::base::Node<uint64_t, DataBlock*>* SplitUnlock(KeyEntry* entry, const TTLSt& ttl,
+                                                              std::vector<CutBlock>* cut);
+    // keep keep_cnt records in the time blocks and cut the others, need hold mu_
+    void CutBlocksUnlock(KeyEntry* entry, uint64_t keep_cnt, std::vector<CutBlock>* cut);
+    void RetireBlocks(const std::vector<CutBlock>& cut, uint64_t& gc_idx_cnt,  // NOLINT
+                      uint64_t& gc_record_cnt,                                 // NOLINT
+                      uint64_t& gc_record_byte_size);                          // NOLINT
+    // count the records in the blocks of a removed key entry and free the blocks
+    void FreeBlocks(KeyEntry* entry, uint64_t& gc_idx_cnt,  // NOLINT
+                    uint64_t& gc_record_cnt,                // NOLINT
+                    uint64_t& gc_record_byte_size);         // NOLINT
+    void GcNodeFreeList(uint64_t version, uint64_t& gc_idx_cnt,  // NOLINT
+                        uint64_t& gc_record_cnt,                 // NOLINT
+                        uint64_t& gc_record_byte_size);          // NOLINT
+
  private:
     KeyEntries* entries_;
     // only Put need mutex
@@ -268,10 +476,18 @@ class Segment {
     std::atomic<uint64_t> pk_cnt_;
     uint8_t key_entry_max_height_;
     KeyEntryNodeList* entry_free_list_;
+    // data nodes trimmed on put, readers with ticket may still hold them
+    DataNodeList* node_free_list_;
+    // data nodes unlinked by gc in the order of versions, guarded by gc_mu_
+    std::deque<RetiredNodes> retired_nodes_;
     uint32_t ts_cnt_;
     std::atomic<uint64_t> gc_version_;
+    // the epoch when a version starts, the nodes of the version before are unlinked before the epoch.
+    // guarded by gc_mu_
+    std::deque<std::pair<uint64_t, uint64_t>> version_epochs_;
     std::map<uint32_t, uint32_t> ts_idx_map_;
     std::vector<std::shared_ptr<std::atomic<uint64_t>>> idx_cnt_vec_;
+    std::vector<std::shared_ptr<std::atomic<uint64_t>>> latest_bound_vec_;
     uint64_t ttl_offset_;
 };
 
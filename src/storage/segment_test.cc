@@ -16,16 +16,26 @@
 
 #include "storage/segment.h"
 
+#include <atomic>
 #include <iostream>
+#include <memory>
 #include <string>
+#include <thread>  // NOLINT
 
 #include "base/glog_wapper.h"  // NOLINT
 #include "base/slice.h"
+#include "gflags/gflags.h"
 #include "gtest/gtest.h"
 #include "storage/record.h"
 
 using ::openmldb::base::Slice;
 
+DECLARE_uint32(latest_bounded_list_slack);
+DECLARE_uint32(time_block_hot_cnt);
+DECLARE_uint32(time_block_min_cnt);
+DECLARE_uint32(time_block_max_cnt);
+DECLARE_bool(time_block_compress);
+
 namespace openmldb {
 namespace storage {
 
@@ -37,7 +47,7 @@ class SegmentTest : public ::testing::Test {
 
 TEST_F(SegmentTest, Size) {
     ASSERT_EQ(16, (int64_t)sizeof(DataBlock));
-    ASSERT_EQ(40, (int64_t)sizeof(KeyEntry));
+    ASSERT_EQ(48, (int64_t)sizeof(KeyEntry));
 }
 
 TEST_F(SegmentTest, DataBlock) {
@@ -51,6 +61,23 @@ TEST_F(SegmentTest, DataBlock) {
     delete db;
 }
 
+TEST_F(SegmentTest, DataBlockRef) {
+    const char* test = "test";
+    DataBlock* db = new DataBlock(2, test, 4);
+    ASSERT_TRUE(db->RefIfAlive());
+    ASSERT_FALSE(db->Unref());
+    ASSERT_FALSE(db->Unref());
+    ASSERT_TRUE(db->Unref());
+    // the last reference is dropped, the block can't be shared any more
+    ASSERT_FALSE(db->RefIfAlive());
+    ASSERT_EQ(0, db->dim_cnt_down.load());
+
+    Segment segment;
+    ASSERT_FALSE(segment.PutBlockIfAbsent(Slice("pk"), 1, db));
+    ASSERT_EQ(0u, segment.GetIdxCnt());
+    delete db;
+}
+
 TEST_F(SegmentTest, PutAndGet) {
     Segment segment;
     const char* test = "test";
@@ -100,20 +127,22 @@ TEST_F(SegmentTest, Delete) {
     segment.Put(pk, 9528, value.c_str(), value.size());
     segment.Put(pk, 9529, value.c_str(), value.size());
     ASSERT_EQ(1, (int64_t)segment.GetPkCnt());
-    Ticket ticket;
-    MemTableIterator* it = segment.NewIterator("test1", ticket);
-    int size = 0;
-    it->SeekToFirst();
-    while (it->Valid()) {
-        it->Next();
-        size++;
+    {
+        Ticket ticket;
+        MemTableIterator* it = segment.NewIterator("test1", ticket);
+        int size = 0;
+        it->SeekToFirst();
+        while (it->Valid()) {
+            it->Next();
+            size++;
+        }
+        ASSERT_EQ(4, size);
+        delete it;
+        ASSERT_TRUE(segment.Delete(pk));
+        it = segment.NewIterator("test1", ticket);
+        ASSERT_FALSE(it->Valid());
+        delete it;
     }
-    ASSERT_EQ(4, size);
-    delete it;
-    ASSERT_TRUE(segment.Delete(pk));
-    it = segment.NewIterator("test1", ticket);
-    ASSERT_FALSE(it->Valid());
-    delete it;
     uint64_t gc_idx_cnt = 0;
     uint64_t gc_record_cnt = 0;
     uint64_t gc_record_byte_size = 0;
@@ -233,6 +262,161 @@ TEST_F(SegmentTest, TestGc4Head) {
     ASSERT_FALSE(it->Valid());
 }
 
+TEST_F(SegmentTest, GcWithReader) {
+    Segment segment;
+    Slice pk("PK");
+    for (int i = 0; i < 5; i++) {
+        segment.Put(pk, 9760 + i, "test", 4);
+    }
+    uint64_t gc_idx_cnt = 0;
+    uint64_t gc_record_cnt = 0;
+    uint64_t gc_record_byte_size = 0;
+    {
+        Ticket ticket;
+        MemTableIterator* it = segment.NewIterator(pk, ticket);
+        it->SeekToFirst();
+        it->Next();
+        it->Next();
+        ASSERT_TRUE(it->Valid());
+        ASSERT_EQ(9762, (int64_t)it->GetKey());
+        // the key being read is trimmed at once
+        segment.IncrGcVersion();
+        segment.Gc4Head(1, gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
+        ASSERT_EQ(4, (int64_t)gc_idx_cnt);
+        ASSERT_EQ(4, (int64_t)gc_record_cnt);
+        uint64_t count = 0;
+        ASSERT_EQ(0, segment.GetCount(pk, count));
+        ASSERT_EQ(1, (int64_t)count);
+        // but the unlinked nodes are kept for the reader
+        for (int i = 0; i < 4; i++) {
+            segment.IncrGcVersion();
+            segment.GcFreeList(gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
+        }
+        ASSERT_EQ(4, (int64_t)gc_idx_cnt);
+        int size = 0;
+        for (; it->Valid(); it->Next()) {
+            ASSERT_EQ(4u, it->GetValue().size());
+            size++;
+        }
+        ASSERT_EQ(3, size);
+        delete it;
+    }
+    Ticket ticket;
+    MemTableIterator* it = segment.NewIterator(pk, ticket);
+    it->SeekToFirst();
+    ASSERT_TRUE(it->Valid());
+    ASSERT_EQ(9764, (int64_t)it->GetKey());
+    it->Next();
+    ASSERT_FALSE(it->Valid());
+    delete it;
+    // the nodes are freed after the reader leaves, the records were counted when they were unlinked
+    segment.IncrGcVersion();
+    segment.GcFreeList(gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
+    ASSERT_EQ(4, (int64_t)gc_idx_cnt);
+    ASSERT_EQ(4, (int64_t)gc_record_cnt);
+    ASSERT_EQ(1, (int64_t)segment.GetIdxCnt());
+}
+
+TEST_F(SegmentTest, GcSharedBlockWithReader) {
+    // the blocks are shared by two indexes
+    Segment segment1;
+    Segment segment2;
+    Slice pk("PK");
+    for (int i = 0; i < 5; i++) {
+        auto* block = new DataBlock(2, "test", 4);
+        segment1.Put(pk, 9760 + i, block);
+        segment2.Put(pk, 9760 + i, block);
+    }
+    uint64_t gc_idx_cnt = 0;
+    uint64_t gc_record_cnt = 0;
+    uint64_t gc_record_byte_size = 0;
+    // the key of index 2 is deleted in an older version than the nodes of index 1 are unlinked
+    ASSERT_TRUE(segment2.Delete(pk));
+    for (int i = 0; i < 4; i++) {
+        segment2.IncrGcVersion();
+    }
+    std::atomic<int> step(0);
+    std::thread reader([&segment1, &pk, &step] {
+        Ticket ticket;
+        std::unique_ptr<MemTableIterator> it(segment1.NewIterator(pk, ticket));
+        it->SeekToFirst();
+        // stop at a node to be unlinked
+        it->Next();
+        step.store(1);
+        while (step.load() != 2) {
+            std::this_thread::yield();
+        }
+        int size = 0;
+        for (; it->Valid(); it->Next()) {
+            ASSERT_EQ("test", it->GetValue().ToString());
+            size++;
+        }
+        ASSERT_EQ(4, size);
+    });
+    while (step.load() != 1) {
+        std::this_thread::yield();
+    }
+    segment1.IncrGcVersion();
+    segment1.Gc4Head(1, gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
+    ASSERT_EQ(4, (int64_t)gc_idx_cnt);
+    ASSERT_EQ(0, (int64_t)gc_record_cnt);
+    // the entry of index 2 is freed but the blocks are still referred by the retired nodes of index 1
+    segment2.GcFreeList(gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
+    ASSERT_EQ(0, (int64_t)segment2.GetPkCnt());
+    ASSERT_EQ(4, (int64_t)gc_record_cnt);
+    step.store(2);
+    reader.join();
+    for (int i = 0; i < 4; i++) {
+        segment1.IncrGcVersion();
+        segment1.GcFreeList(gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
+    }
+    ASSERT_EQ(4, (int64_t)gc_record_cnt);
+    ASSERT_EQ(1, (int64_t)segment1.GetIdxCnt());
+}
+
+TEST_F(SegmentTest, TestLatestBoundOnPut) {
+    uint32_t old_slack = FLAGS_latest_bounded_list_slack;
+    FLAGS_latest_bounded_list_slack = 0;
+    Segment segment;
+    segment.SetLatestBound(0, 2);
+    ASSERT_EQ(2, (int64_t)segment.GetLatestBound(0));
+    Slice pk("PK");
+    for (int i = 0; i < 5; i++) {
+        segment.Put(pk, 9760 + i, "test", 4);
+    }
+    uint64_t count = 0;
+    ASSERT_EQ(0, segment.GetCount(pk, count));
+    ASSERT_EQ(2, (int64_t)count);
+    ASSERT_EQ(2, (int64_t)segment.GetIdxCnt());
+    {
+        Ticket ticket;
+        MemTableIterator* it = segment.NewIterator(pk, ticket);
+        it->SeekToFirst();
+        ASSERT_TRUE(it->Valid());
+        ASSERT_EQ(9764, (int64_t)it->GetKey());
+        it->Next();
+        ASSERT_TRUE(it->Valid());
+        ASSERT_EQ(9763, (int64_t)it->GetKey());
+        it->Next();
+        ASSERT_FALSE(it->Valid());
+        delete it;
+    }
+    uint64_t gc_idx_cnt = 0;
+    uint64_t gc_record_cnt = 0;
+    uint64_t gc_record_byte_size = 0;
+    // the trimmed records are freed after gc_deleted_pk_version_delta versions
+    segment.IncrGcVersion();
+    segment.GcFreeList(gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
+    ASSERT_EQ(0, (int64_t)gc_record_cnt);
+    segment.IncrGcVersion();
+    segment.GcFreeList(gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
+    ASSERT_EQ(3, (int64_t)gc_idx_cnt);
+    ASSERT_EQ(3, (int64_t)gc_record_cnt);
+    ASSERT_EQ(3 * GetRecordSize(4), (int64_t)gc_record_byte_size);
+    ASSERT_EQ(2, (int64_t)segment.GetIdxCnt());
+    FLAGS_latest_bounded_list_slack = old_slack;
+}
+
 TEST_F(SegmentTest, TestGc4TTL) {
     Segment segment;
     segment.Put("PK", 9768, "test1", 5);
@@ -413,6 +597,142 @@ TEST_F(SegmentTest, PutAndGetTS) {
     ASSERT_EQ(e, t);
 }
 
+void CheckTimeBlockRecords(Segment* segment, const Slice& pk, uint64_t start, uint64_t end) {
+    Ticket ticket;
+    std::unique_ptr<MemTableIterator> it(segment->NewIterator(pk, ticket));
+    it->SeekToFirst();
+    for (uint64_t ts = end; ts >= start; ts--) {
+        ASSERT_TRUE(it->Valid());
+        ASSERT_EQ(ts, it->GetKey());
+        ASSERT_EQ("value" + std::to_string(ts), it->GetValue().ToString());
+        it->Next();
+    }
+    ASSERT_FALSE(it->Valid());
+}
+
+class TimeBlockSegmentTest : public ::testing::TestWithParam<bool> {
+ public:
+    void SetUp() override {
+        FLAGS_time_block_hot_cnt = 10;
+        FLAGS_time_block_min_cnt = 20;
+        FLAGS_time_block_max_cnt = 32;
+        FLAGS_time_block_compress = GetParam();
+    }
+    void TearDown() override {
+        FLAGS_time_block_hot_cnt = 0;
+        FLAGS_time_block_min_cnt = 128;
+        FLAGS_time_block_max_cnt = 1024;
+        FLAGS_time_block_compress = false;
+    }
+};
+
+TEST_P(TimeBlockSegmentTest, SealAndSeek) {
+    Segment segment;
+    Slice pk("PK");
+    for (uint64_t ts = 1000; ts < 1100; ts++) {
+        std::string value = "value" + std::to_string(ts);
+        segment.Put(pk, ts, value.data(), value.size());
+    }
+    segment.SealTimeBlocks();
+    CheckTimeBlockRecords(&segment, pk, 1000, 1099);
+    Ticket ticket;
+    std::unique_ptr<MemTableIterator> it(segment.NewIterator(pk, ticket));
+    for (uint64_t ts : {1095, 1089, 1050, 1031, 1000}) {
+        it->Seek(ts);
+        ASSERT_TRUE(it->Valid());
+        ASSERT_EQ(ts, it->GetKey());
+        ASSERT_EQ("value" + std::to_string(ts), it->GetValue().ToString());
+    }
+    it->Seek(999);
+    ASSERT_FALSE(it->Valid());
+    it->Seek(2000);
+    ASSERT_TRUE(it->Valid());
+    ASSERT_EQ(1099u, it->GetKey());
+    it->SeekToLast();
+    ASSERT_TRUE(it->Valid());
+    ASSERT_EQ(1000u, it->GetKey());
+    uint64_t count = 0;
+    ASSERT_EQ(0, segment.GetCount(pk, count));
+    ASSERT_EQ(100u, count);
+    // a seal without new records changes nothing
+    segment.SealTimeBlocks();
+    CheckTimeBlockRecords(&segment, pk, 1000, 1099);
+}
+
+TEST_P(TimeBlockSegmentTest, LatePut) {
+    Segment segment;
+    Slice pk("PK");
+    for (uint64_t ts = 1000; ts < 1100; ts += 2) {
+        std::string value = "value" + std::to_string(ts);
+        segment.Put(pk, ts, value.data(), value.size());
+    }
+    segment.SealTimeBlocks();
+    // the puts older than the sealed records are merged with the blocks
+    for (uint64_t ts = 1001; ts < 1100; ts += 2) {
+        std::string value = "value" + std::to_string(ts);
+        segment.Put(pk, ts, value.data(), value.size());
+    }
+    CheckTimeBlockRecords(&segment, pk, 1000, 1099);
+    segment.SealTimeBlocks();
+    CheckTimeBlockRecords(&segment, pk, 1000, 1099);
+}
+
+TEST_P(TimeBlockSegmentTest, Gc) {
+    Segment segment;
+    Slice pk("PK");
+    for (uint64_t ts = 1000; ts < 1100; ts++) {
+        std::string value = "value" + std::to_string(ts);
+        segment.Put(pk, ts, value.data(), value.size());
+    }
+    segment.SealTimeBlocks();
+    uint64_t gc_idx_cnt = 0;
+    uint64_t gc_record_cnt = 0;
+    uint64_t gc_record_byte_size = 0;
+    segment.Gc4TTL(1020, gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
+    ASSERT_EQ(21u, gc_idx_cnt);
+    ASSERT_EQ(21u, gc_record_cnt);
+    ASSERT_EQ(21 * GetRecordSize(9), (int64_t)gc_record_byte_size);
+    CheckTimeBlockRecords(&segment, pk, 1021, 1099);
+    segment.Gc4Head(45, gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
+    ASSERT_EQ(55u, gc_idx_cnt);
+    ASSERT_EQ(55u, gc_record_cnt);
+    CheckTimeBlockRecords(&segment, pk, 1055, 1099);
+    segment.Gc4Head(5, gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
+    ASSERT_EQ(95u, gc_idx_cnt);
+    ASSERT_EQ(95u, gc_record_cnt);
+    CheckTimeBlockRecords(&segment, pk, 1095, 1099);
+    segment.IncrGcVersion();
+    segment.IncrGcVersion();
+    segment.ReleaseAndCount(gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
+    ASSERT_EQ(100u, gc_idx_cnt);
+    ASSERT_EQ(100u, gc_record_cnt);
+    ASSERT_EQ(100 * GetRecordSize(9), (int64_t)gc_record_byte_size);
+}
+
+TEST_P(TimeBlockSegmentTest, SealWithReader) {
+    Segment segment;
+    Slice pk("PK");
+    for (uint64_t ts = 1000; ts < 1100; ts++) {
+        std::string value = "value" + std::to_string(ts);
+        segment.Put(pk, ts, value.data(), value.size());
+    }
+    Ticket ticket;
+    std::unique_ptr<MemTableIterator> it(segment.NewIterator(pk, ticket));
+    it->Seek(1050);
+    ASSERT_TRUE(it->Valid());
+    // the reader goes on from where it was after the records are sealed
+    segment.IncrGcVersion();
+    segment.SealTimeBlocks();
+    uint64_t ts = 1050;
+    for (; it->Valid(); it->Next(), ts--) {
+        ASSERT_EQ(ts, it->GetKey());
+        ASSERT_EQ("value" + std::to_string(ts), it->GetValue().ToString());
+    }
+    ASSERT_EQ(999u, ts);
+}
+
+INSTANTIATE_TEST_CASE_P(Compress, TimeBlockSegmentTest, ::testing::Bool());
+
 }  // namespace storage
 }  // namespace openmldb
 
@@ -32,15 +32,18 @@ const std::string MANIFEST = "MANIFEST";  // NOLINT
 
 int Snapshot::GenManifest(const std::string& snapshot_name, uint64_t key_count, uint64_t offset, uint64_t term) {
     DEBUGLOG("record offset[%lu]. add snapshot[%s] key_count[%lu]", offset, snapshot_name.c_str(), key_count);
-    std::string full_path = snapshot_path_ + MANIFEST;
-    std::string tmp_file = snapshot_path_ + MANIFEST + ".tmp";
     ::openmldb::api::Manifest manifest;
-    std::string manifest_info;
     manifest.set_offset(offset);
     manifest.set_name(snapshot_name);
     manifest.set_count(key_count);
     manifest.set_term(term);
-    manifest_info.clear();
+    return GenManifest(manifest);
+}
+
+int Snapshot::GenManifest(const ::openmldb::api::Manifest& manifest) {
+    std::string full_path = snapshot_path_ + MANIFEST;
+    std::string tmp_file = snapshot_path_ + MANIFEST + ".tmp";
+    std::string manifest_info;
     google::protobuf::TextFormat::PrintToString(manifest, &manifest_info);
     FILE* fd_write = fopen(tmp_file.c_str(), "w");
     if (fd_write == NULL) {
@@ -81,5 +84,17 @@ int Snapshot::GetLocalManifest(const std::string& full_path, ::openmldb::api::Ma
     return 0;
 }
 
+void Snapshot::GetSnapshotFiles(const ::openmldb::api::Manifest& manifest,
+                                std::vector<std::pair<std::string, uint64_t>>* files) {
+    uint64_t base_count = manifest.count();
+    for (const auto& segment : manifest.segments()) {
+        base_count -= segment.count();
+    }
+    files->emplace_back(manifest.name(), base_count);
+    for (const auto& segment : manifest.segments()) {
+        files->emplace_back(segment.name(), segment.count());
+    }
+}
+
 }  // namespace storage
 }  // namespace openmldb
@@ -18,6 +18,8 @@
 
 #include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "log/log_writer.h"
 #include "proto/tablet.pb.h"
@@ -38,8 +40,13 @@ class Snapshot {
                          uint64_t& latest_offset) = 0;  // NOLINT
     uint64_t GetOffset() { return offset_; }
     int GenManifest(const std::string& snapshot_name, uint64_t key_count, uint64_t offset, uint64_t term);
+    int GenManifest(const ::openmldb::api::Manifest& manifest);
     static int GetLocalManifest(const std::string& full_path,
                                 ::openmldb::api::Manifest& manifest);  // NOLINT
+    // get the name and record count of all snapshot files in manifest, the base snapshot is the first one and the
+    // segments follow in offset order
+    static void GetSnapshotFiles(const ::openmldb::api::Manifest& manifest,
+                                 std::vector<std::pair<std::string, uint64_t>>* files);
 
  protected:
     uint32_t tid_;
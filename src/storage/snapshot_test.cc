@@ -40,6 +40,8 @@
 
 DECLARE_string(db_root_path);
 DECLARE_string(snapshot_compression);
+DECLARE_uint32(snapshot_max_segments);
+DECLARE_bool(enable_memtable_checkpoint);
 
 using ::openmldb::api::LogEntry;
 namespace openmldb {
@@ -860,6 +862,81 @@ TEST_F(SnapshotTest, MakeSnapshot) {
     ASSERT_EQ(7, (int64_t)manifest.term());
 }
 
+TEST_F(SnapshotTest, MakeSnapshotSegment) {
+    FLAGS_snapshot_max_segments = 2;
+    LogParts* log_part = new LogParts(12, 4, scmp);
+    MemTableSnapshot snapshot(6, 2, log_part, FLAGS_db_root_path);
+    snapshot.Init();
+    std::map<std::string, uint32_t> mapping;
+    mapping.insert(std::make_pair("idx0", 0));
+    std::shared_ptr<MemTable> table =
+        std::make_shared<MemTable>("tx_log", 6, 2, 8, mapping, 0, ::openmldb::type::TTLType::kAbsoluteTime);
+    table->Init();
+    uint64_t offset = 1;
+    uint32_t binlog_index = 0;
+    std::string log_path = FLAGS_db_root_path + "/6_2/binlog/";
+    std::string snapshot_path = FLAGS_db_root_path + "/6_2/snapshot/";
+    WriteHandle* wh = NULL;
+    RollWLogFile(&wh, log_part, log_path, binlog_index, offset);
+    int count = 0;
+    auto write_log = [&](int num) {
+        for (int i = 0; i < num; i++, count++) {
+            ::openmldb::api::LogEntry entry;
+            entry.set_log_index(offset);
+            entry.set_pk("key" + std::to_string(count));
+            entry.set_ts(::baidu::common::timer::get_micros() / 1000);
+            entry.set_value("value");
+            entry.set_term(5);
+            std::string buffer;
+            entry.SerializeToString(&buffer);
+            ::openmldb::base::Slice slice(buffer);
+            ASSERT_TRUE(wh->Write(slice).ok());
+            offset++;
+        }
+        wh->Sync();
+    };
+    auto check = [&](uint64_t total, int segment_num) {
+        uint64_t offset_value = 0;
+        ASSERT_EQ(0, snapshot.MakeSnapshot(table, offset_value, 0));
+        ASSERT_EQ(offset - 1, offset_value);
+        std::vector<std::string> vec;
+        ASSERT_EQ(0, ::openmldb::base::GetFileName(snapshot_path, vec));
+        // MANIFEST, base snapshot and segments
+        ASSERT_EQ(segment_num + 2, static_cast<int>(vec.size()));
+        ::openmldb::api::Manifest manifest;
+        ASSERT_EQ(0, GetManifest(snapshot_path + "MANIFEST", &manifest));
+        ASSERT_EQ(offset - 1, manifest.offset());
+        ASSERT_EQ(total, manifest.count());
+        ASSERT_EQ(segment_num, manifest.segments_size());
+    };
+    write_log(10);
+    check(10, 0);
+    // only the delta is written
+    write_log(5);
+    check(15, 1);
+    // nothing new, no empty segment
+    check(15, 1);
+    write_log(5);
+    check(20, 2);
+    // the segment limit is reached, all files are compacted
+    write_log(5);
+    check(25, 0);
+    write_log(5);
+    check(30, 1);
+
+    // recover from the base snapshot and the segment
+    std::shared_ptr<MemTable> recovered_table =
+        std::make_shared<MemTable>("tx_log", 6, 2, 8, mapping, 0, ::openmldb::type::TTLType::kAbsoluteTime);
+    recovered_table->Init();
+    MemTableSnapshot recovered_snapshot(6, 2, log_part, FLAGS_db_root_path);
+    ASSERT_TRUE(recovered_snapshot.Init());
+    uint64_t latest_offset = 0;
+    ASSERT_TRUE(recovered_snapshot.Recover(recovered_table, latest_offset));
+    ASSERT_EQ(offset - 1, latest_offset);
+    ASSERT_EQ(30u, recovered_table->GetRecordCnt());
+    FLAGS_snapshot_max_segments = 0;
+}
+
 TEST_F(SnapshotTest, MakeSnapshot_with_delete_index) {
     LogParts* log_part = new LogParts(12, 4, scmp);
     MemTableSnapshot snapshot(1, 3, log_part, FLAGS_db_root_path);
@@ -1748,6 +1825,106 @@ TEST_F(SnapshotTest, Recover_large_snapshot_and_binlog) {
     delete it;
 }
 
+TEST_F(SnapshotTest, MakeCheckpoint) {
+    ::openmldb::api::TableMeta table_meta;
+    table_meta.set_name("test");
+    table_meta.set_tid(7);
+    table_meta.set_pid(2);
+    table_meta.set_seg_cnt(8);
+    SchemaCodec::SetColumnDesc(table_meta.add_column_desc(), "card", ::openmldb::type::kString);
+    SchemaCodec::SetColumnDesc(table_meta.add_column_desc(), "mcc", ::openmldb::type::kString);
+    SchemaCodec::SetColumnDesc(table_meta.add_column_desc(), "ts1", ::openmldb::type::kBigInt);
+    SchemaCodec::SetColumnDesc(table_meta.add_column_desc(), "ts2", ::openmldb::type::kBigInt);
+    SchemaCodec::SetIndex(table_meta.add_column_key(), "card", "card", "ts1", ::openmldb::type::kAbsoluteTime, 0, 0);
+    SchemaCodec::SetIndex(table_meta.add_column_key(), "card1", "card", "ts2", ::openmldb::type::kAbsoluteTime, 0, 0);
+    SchemaCodec::SetIndex(table_meta.add_column_key(), "mcc", "mcc", "ts1", ::openmldb::type::kAbsoluteTime, 0, 0);
+    table_meta.set_mode(::openmldb::api::TableMode::kTableLeader);
+    auto gen_entry = [](uint32_t i) {
+        ::openmldb::api::LogEntry entry;
+        entry.set_log_index(i + 1);
+        entry.set_value("value" + std::to_string(i));
+        auto* dim = entry.add_dimensions();
+        dim->set_key("card" + std::to_string(i % 10));
+        dim->set_idx(0);
+        dim = entry.add_dimensions();
+        dim->set_key("card" + std::to_string(i % 10));
+        dim->set_idx(1);
+        dim = entry.add_dimensions();
+        dim->set_key("mcc" + std::to_string(i % 5));
+        dim->set_idx(2);
+        auto* ts_dim = entry.add_ts_dimensions();
+        ts_dim->set_ts(1000 + i);
+        ts_dim->set_idx(0);
+        ts_dim = entry.add_ts_dimensions();
+        ts_dim->set_ts(2000 + i);
+        ts_dim->set_idx(1);
+        return entry;
+    };
+    std::shared_ptr<MemTable> table = std::make_shared<MemTable>(table_meta);
+    table->Init();
+    for (uint32_t i = 0; i < 100; i++) {
+        auto entry = gen_entry(i);
+        ASSERT_TRUE(table->Put(entry.dimensions(), entry.ts_dimensions(), entry.value()));
+    }
+    FLAGS_enable_memtable_checkpoint = true;
+    LogParts* log_part = new LogParts(12, 4, scmp);
+    MemTableSnapshot snapshot(7, 2, log_part, FLAGS_db_root_path);
+    ASSERT_TRUE(snapshot.Init());
+    ASSERT_EQ(0, snapshot.MakeCheckpoint(table, []() { return 100; }));
+
+    std::shared_ptr<MemTable> new_table = std::make_shared<MemTable>(table_meta);
+    new_table->Init();
+    MemTableSnapshot new_snapshot(7, 2, log_part, FLAGS_db_root_path);
+    ASSERT_TRUE(new_snapshot.Init());
+    uint64_t offset = 0;
+    ASSERT_TRUE(new_snapshot.Recover(new_table, offset));
+    ASSERT_EQ(100u, offset);
+    ASSERT_EQ(100u, new_snapshot.GetDedupEndOffset());
+    ASSERT_EQ(table->GetRecordCnt(), new_table->GetRecordCnt());
+    ASSERT_EQ(table->GetRecordIdxCnt(), new_table->GetRecordIdxCnt());
+    ASSERT_EQ(table->GetRecordPkCnt(), new_table->GetRecordPkCnt());
+    std::vector<std::pair<uint32_t, int64_t>> index_ts = {{0, 1000}, {1, 2000}, {2, 1000}};
+    for (const auto& kv : index_ts) {
+        std::string key = kv.first == 2 ? "mcc3" : "card3";
+        uint32_t step = kv.first == 2 ? 5 : 10;
+        Ticket ticket;
+        TableIterator* it = new_table->NewIterator(kv.first, key, ticket);
+        it->SeekToFirst();
+        int32_t i = 100 - step + 3;
+        for (; it->Valid(); it->Next(), i -= step) {
+            ASSERT_EQ(kv.second + i, static_cast<int64_t>(it->GetKey()));
+            ASSERT_EQ("value" + std::to_string(i), it->GetValue().ToString());
+        }
+        ASSERT_EQ(3 - static_cast<int32_t>(step), i);
+        delete it;
+    }
+
+    // the entries replayed after the checkpoint are put only if they are not loaded
+    MemTable::ReplayCounts replayed;
+    ASSERT_TRUE(new_table->PutIfAbsent(gen_entry(99), &replayed));
+    ASSERT_EQ(100u, new_table->GetRecordCnt());
+    ASSERT_TRUE(new_table->PutIfAbsent(gen_entry(100), &replayed));
+    ASSERT_EQ(101u, new_table->GetRecordCnt());
+    ASSERT_EQ(table->GetRecordIdxCnt() + 2, new_table->GetRecordIdxCnt());
+    // a same row written twice is replayed twice and kept twice
+    auto same_entry = gen_entry(100);
+    same_entry.set_log_index(102);
+    ASSERT_TRUE(new_table->PutIfAbsent(same_entry, &replayed));
+    ASSERT_EQ(102u, new_table->GetRecordCnt());
+    ASSERT_EQ(table->GetRecordIdxCnt() + 4, new_table->GetRecordIdxCnt());
+
+    // a snapshot newer than the checkpoint is used instead
+    ASSERT_EQ(0, new_snapshot.GenManifest("20190614.sdb", 0, 101, 1));
+    std::shared_ptr<MemTable> table3 = std::make_shared<MemTable>(table_meta);
+    table3->Init();
+    MemTableSnapshot snapshot3(7, 2, log_part, FLAGS_db_root_path);
+    ASSERT_TRUE(snapshot3.Init());
+    ASSERT_TRUE(snapshot3.Recover(table3, offset));
+    ASSERT_EQ(101u, offset);
+    ASSERT_EQ(0u, snapshot3.GetDedupEndOffset());
+    FLAGS_enable_memtable_checkpoint = false;
+}
+
 }  // namespace storage
 }  // namespace openmldb
 
@@ -0,0 +1,491 @@
+/*
+ * Copyright 2021 4Paradigm
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "storage/sorted_file.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include <algorithm>
+#include <list>
+#include <map>
+#include <mutex>  // NOLINT
+#include <utility>
+
+#include "base/glog_wapper.h"
+#include "gflags/gflags.h"
+
+DECLARE_uint32(block_cache_mb);
+DECLARE_uint32(block_cache_shardbits);
+DECLARE_bool(verify_compression);
+
+namespace openmldb {
+namespace storage {
+
+static const uint32_t BLOCK_SIZE = 4 * 1024;
+static const uint32_t FOOTER_SIZE = 48;
+static const uint64_t MAGIC = 0x6f6d6c6462736674;
+
+static inline void PutFixed32(std::string* dst, uint32_t value) {
+    dst->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+static inline void PutFixed64(std::string* dst, uint64_t value) {
+    dst->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+static inline uint32_t DecodeFixed32(const char* ptr) {
+    uint32_t value;
+    memcpy(&value, ptr, sizeof(value));
+    return value;
+}
+
+static inline uint64_t DecodeFixed64(const char* ptr) {
+    uint64_t value;
+    memcpy(&value, ptr, sizeof(value));
+    return value;
+}
+
+// BlockCache keeps the uncompressed data of the compressed blocks in the lru order. The memory is limited by
+// block_cache_mb and divided into 2^block_cache_shardbits shards, the uncompressed blocks are read from the
+// mapped files directly and left to the page cache
+class BlockCache {
+ public:
+    static BlockCache* GetInstance() {
+        static BlockCache cache(static_cast<uint64_t>(FLAGS_block_cache_mb) << 20,
+                                std::min(FLAGS_block_cache_shardbits, 16u));
+        return &cache;
+    }
+
+    std::shared_ptr<const std::string> Lookup(uint64_t id, uint64_t offset) {
+        Shard& shard = GetShard(id, offset);
+        std::lock_guard<std::mutex> lock(shard.mu);
+        auto it = shard.map.find(std::make_pair(id, offset));
+        if (it == shard.map.end()) {
+            return std::shared_ptr<const std::string>();
+        }
+        shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+        return it->second->second;
+    }
+
+    void Insert(uint64_t id, uint64_t offset, const std::shared_ptr<const std::string>& data) {
+        if (shard_capacity_ == 0) {
+            return;
+        }
+        Shard& shard = GetShard(id, offset);
+        auto key = std::make_pair(id, offset);
+        std::lock_guard<std::mutex> lock(shard.mu);
+        if (shard.map.find(key) != shard.map.end()) {
+            return;
+        }
+        shard.lru.emplace_front(key, data);
+        shard.map.emplace(key, shard.lru.begin());
+        shard.usage += data->size();
+        while (shard.usage > shard_capacity_ && !shard.lru.empty()) {
+            auto& last = shard.lru.back();
+            shard.usage -= last.second->size();
+            shard.map.erase(last.first);
+            shard.lru.pop_back();
+        }
+    }
+
+ private:
+    typedef std::pair<uint64_t, uint64_t> Key;
+    typedef std::list<std::pair<Key, std::shared_ptr<const std::string>>> LruList;
+
+    struct Shard {
+        std::mutex mu;
+        LruList lru;
+        std::map<Key, LruList::iterator> map;
+        uint64_t usage = 0;
+    };
+
+    BlockCache(uint64_t capacity, uint32_t shard_bits)
+        : shard_bits_(shard_bits), shard_capacity_(capacity >> shard_bits), shards_(1u << shard_bits) {}
+
+    Shard& GetShard(uint64_t id, uint64_t offset) {
+        uint64_t hash = (id * 0x9e3779b97f4a7c15ull) ^ (offset >> 12);
+        return shards_[shard_bits_ == 0 ? 0 : (hash >> (64 - shard_bits_))];
+    }
+
+    const uint32_t shard_bits_;
+    const uint64_t shard_capacity_;
+    std::vector<Shard> shards_;
+};
+
+class SortedFile::Iterator : public SortedIterator {
+ public:
+    explicit Iterator(const SortedFile* file) : file_(file), block_idx_(0), pos_(0), next_(0), valid_(false) {}
+
+    bool Valid() const override { return valid_; }
+
+    void Next() override {
+        if (next_ >= block_.size()) {
+            LoadBlock(block_idx_ + 1);
+            return;
+        }
+        ParseRecord();
+    }
+
+    ::openmldb::base::Slice GetKey() const override { return key_; }
+    ::openmldb::base::Slice GetValue() const override { return value_; }
+
+    void Seek(const ::openmldb::base::Slice& key) override {
+        const auto& blocks = file_->blocks_;
+        // the last block whose first key is not greater than key
+        uint32_t low = 0;
+        uint32_t high = blocks.size();
+        while (low < high) {
+            uint32_t mid = (low + high) >> 1;
+            if (blocks[mid].first_key.compare(key) <= 0) {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+        LoadBlock(low == 0 ? 0 : low - 1);
+        while (valid_ && key_.compare(key) < 0) {
+            Next();
+        }
+    }
+
+    void SeekToFirst() override { LoadBlock(0); }
+
+ private:
+    void LoadBlock(uint32_t idx) {
+        valid_ = false;
+        holder_.reset();
+        for (; idx < file_->blocks_.size(); idx++) {
+            if (!file_->ReadBlock(idx, &block_, &holder_)) {
+                return;
+            }
+            if (block_.size() > 0) {
+                break;
+            }
+        }
+        if (idx >= file_->blocks_.size()) {
+            return;
+        }
+        block_idx_ = idx;
+        next_ = 0;
+        ParseRecord();
+    }
+
+    void ParseRecord() {
+        pos_ = next_;
+        if (pos_ + 8 > block_.size()) {
+            valid_ = false;
+            return;
+        }
+        const char* ptr = block_.data() + pos_;
+        uint32_t key_size = DecodeFixed32(ptr);
+        uint32_t value_size = DecodeFixed32(ptr + 4);
+        if (pos_ + 8 + key_size + value_size > block_.size()) {
+            PDLOG(WARNING, "corrupted block %u in %s", block_idx_, file_->path_.c_str());
+            valid_ = false;
+            return;
+        }
+        key_.reset(ptr + 8, key_size);
+        value_.reset(ptr + 8 + key_size, value_size);
+        next_ = pos_ + 8 + key_size + value_size;
+        valid_ = true;
+    }
+
+    const SortedFile* file_;
+    uint32_t block_idx_;
+    ::openmldb::base::Slice block_;
+    std::shared_ptr<const std::string> holder_;
+    uint64_t pos_;
+    uint64_t next_;
+    bool valid_;
+    ::openmldb::base::Slice key_;
+    ::openmldb::base::Slice value_;
+};
+
+MergedIterator::MergedIterator(std::vector<SortedIterator*>&& iters) : iters_(std::move(iters)), cur_(NULL) {}
+
+MergedIterator::~MergedIterator() {
+    for (auto* it : iters_) {
+        delete it;
+    }
+}
+
+void MergedIterator::FindSmallest() {
+    cur_ = NULL;
+    for (auto* it : iters_) {
+        if (it->Valid() && (cur_ == NULL || it->GetKey().compare(cur_->GetKey()) < 0)) {
+            cur_ = it;
+        }
+    }
+}
+
+void MergedIterator::Next() {
+    cur_->Next();
+    FindSmallest();
+}
+
+void MergedIterator::Seek(const ::openmldb::base::Slice& key) {
+    for (auto* it : iters_) {
+        it->Seek(key);
+    }
+    FindSmallest();
+}
+
+void MergedIterator::SeekToFirst() {
+    for (auto* it : iters_) {
+        it->SeekToFirst();
+    }
+    FindSmallest();
+}
+
+SortedFile::Builder::Builder(const std::string& path, CompressType compress)
+    : path_(path), compress_(compress), fd_(NULL), block_cnt_(0), offset_(0), cnt_(0) {}
+
+SortedFile::Builder::~Builder() {
+    if (fd_ != NULL) {
+        Abandon();
+    }
+}
+
+bool SortedFile::Builder::Open() {
+    fd_ = fopen(path_.c_str(), "wb");
+    if (fd_ == NULL) {
+        PDLOG(WARNING, "fail to create file %s", path_.c_str());
+        return false;
+    }
+    return true;
+}
+
+void SortedFile::Builder::Abandon() {
+    if (fd_ != NULL) {
+        fclose(fd_);
+        fd_ = NULL;
+    }
+    unlink(path_.c_str());
+}
+
+bool SortedFile::Builder::Write(const char* data, size_t size) {
+    if (size > 0 && fwrite(data, 1, size, fd_) != size) {
+        PDLOG(WARNING, "fail to write file %s", path_.c_str());
+        return false;
+    }
+    offset_ += size;
+    return true;
+}
+
+bool SortedFile::Builder::Add(const ::openmldb::base::Slice& key, const ::openmldb::base::Slice& value) {
+    if (block_.empty()) {
+        first_key_.assign(key.data(), key.size());
+    }
+    PutFixed32(&block_, key.size());
+    PutFixed32(&block_, value.size());
+    block_.append(key.data(), key.size());
+    block_.append(value.data(), value.size());
+    cnt_++;
+    if (block_.size() >= BLOCK_SIZE) {
+        return FlushBlock();
+    }
+    return true;
+}
+
+bool SortedFile::Builder::FlushBlock() {
+    if (block_.empty()) {
+        return true;
+    }
+    const std::string* data = &block_;
+    std::string compressed;
+    if (compress_ == kZlib) {
+        uLongf size = compressBound(block_.size());
+        compressed.resize(size);
+        if (compress2(reinterpret_cast<Bytef*>(&compressed[0]), &size, reinterpret_cast<const Bytef*>(block_.data()),
+                      block_.size(), Z_DEFAULT_COMPRESSION) == Z_OK &&
+            size < block_.size()) {
+            compressed.resize(size);
+            data = &compressed;
+        }
+        if (data == &compressed && FLAGS_verify_compression) {
+            std::string raw(block_.size(), '\0');
+            uLongf raw_size = raw.size();
+            if (uncompress(reinterpret_cast<Bytef*>(&raw[0]), &raw_size,
+                           reinterpret_cast<const Bytef*>(compressed.data()), compressed.size()) != Z_OK ||
+                raw != block_) {
+                PDLOG(WARNING, "verify compression failed, keep the block raw. file %s", path_.c_str());
+                data = &block_;
+            }
+        }
+    }
+    PutFixed32(&index_, first_key_.size());
+    index_.append(first_key_);
+    PutFixed64(&index_, offset_);
+    PutFixed32(&index_, data->size());
+    PutFixed32(&index_, block_.size());
+    block_cnt_++;
+    bool ok = Write(data->data(), data->size());
+    block_.clear();
+    return ok;
+}
+
+bool SortedFile::Builder::Finish(const Meta& meta) {
+    if (!FlushBlock()) {
+        return false;
+    }
+    uint64_t index_offset = offset_;
+    std::string footer;
+    PutFixed64(&footer, index_offset);
+    PutFixed32(&footer, block_cnt_);
+    PutFixed32(&footer, compress_);
+    PutFixed64(&footer, meta.record_cnt);
+    PutFixed64(&footer, meta.max_seq);
+    PutFixed64(&footer, meta.min_time);
+    PutFixed64(&footer, MAGIC);
+    if (!Write(index_.data(), index_.size()) || !Write(footer.data(), footer.size())) {
+        return false;
+    }
+    if (fflush(fd_) != 0 || fsync(fileno(fd_)) != 0) {
+        PDLOG(WARNING, "fail to sync file %s", path_.c_str());
+        return false;
+    }
+    fclose(fd_);
+    fd_ = NULL;
+    return true;
+}
+
+static std::atomic<uint64_t> file_id(0);
+
+SortedFile::SortedFile(const std::string& path, uint64_t id)
+    : path_(path),
+      id_(id),
+      fd_(-1),
+      base_(NULL),
+      size_(0),
+      compress_(kNoCompress),
+      meta_(),
+      blocks_(),
+      obsolete_(false) {}
+
+SortedFile::~SortedFile() {
+    if (base_ != NULL) {
+        munmap(const_cast<char*>(base_), size_);
+    }
+    if (fd_ >= 0) {
+        close(fd_);
+    }
+    if (obsolete_.load(std::memory_order_relaxed)) {
+        unlink(path_.c_str());
+    }
+}
+
+std::shared_ptr<SortedFile> SortedFile::Open(const std::string& path) {
+    std::shared_ptr<SortedFile> file(new SortedFile(path, file_id.fetch_add(1, std::memory_order_relaxed)));
+    if (!file->Load()) {
+        return std::shared_ptr<SortedFile>();
+    }
+    return file;
+}
+
+bool SortedFile::Load() {
+    fd_ = open(path_.c_str(), O_RDONLY);
+    if (fd_ < 0) {
+        PDLOG(WARNING, "fail to open file %s", path_.c_str());
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd_, &st) != 0 || static_cast<uint64_t>(st.st_size) < FOOTER_SIZE) {
+        PDLOG(WARNING, "invalid file %s", path_.c_str());
+        return false;
+    }
+    size_ = st.st_size;
+    void* base = mmap(NULL, size_, PROT_READ, MAP_SHARED, fd_, 0);
+    if (base == MAP_FAILED) {
+        PDLOG(WARNING, "fail to map file %s", path_.c_str());
+        return false;
+    }
+    base_ = reinterpret_cast<const char*>(base);
+    const char* footer = base_ + size_ - FOOTER_SIZE;
+    uint64_t index_offset = DecodeFixed64(footer);
+    uint32_t block_cnt = DecodeFixed32(footer + 8);
+    compress_ = static_cast<CompressType>(DecodeFixed32(footer + 12));
+    meta_.record_cnt = DecodeFixed64(footer + 16);
+    meta_.max_seq = DecodeFixed64(footer + 24);
+    meta_.min_time = DecodeFixed64(footer + 32);
+    if (DecodeFixed64(footer + 40) != MAGIC || index_offset > size_ - FOOTER_SIZE) {
+        PDLOG(WARNING, "invalid footer of file %s", path_.c_str());
+        return false;
+    }
+    const char* ptr = base_ + index_offset;
+    const char* end = footer;
+    blocks_.reserve(block_cnt);
+    for (uint32_t i = 0; i < block_cnt; i++) {
+        if (ptr + 4 > end) {
+            break;
+        }
+        uint32_t key_size = DecodeFixed32(ptr);
+        if (ptr + 4 + key_size + 16 > end) {
+            break;
+        }
+        BlockHandle handle;
+        handle.first_key.reset(ptr + 4, key_size);
+        ptr += 4 + key_size;
+        handle.offset = DecodeFixed64(ptr);
+        handle.size = DecodeFixed32(ptr + 8);
+        handle.raw_size = DecodeFixed32(ptr + 12);
+        ptr += 16;
+        if (handle.offset + handle.size > index_offset) {
+            break;
+        }
+        blocks_.push_back(handle);
+    }
+    if (blocks_.size() != block_cnt) {
+        PDLOG(WARNING, "invalid index of file %s", path_.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool SortedFile::ReadBlock(uint32_t idx, ::openmldb::base::Slice* data,
+                           std::shared_ptr<const std::string>* holder) const {
+    const BlockHandle& handle = blocks_[idx];
+    if (handle.size == handle.raw_size) {
+        data->reset(base_ + handle.offset, handle.size);
+        return true;
+    }
+    BlockCache* cache = BlockCache::GetInstance();
+    std::shared_ptr<const std::string> block = cache->Lookup(id_, handle.offset);
+    if (!block) {
+        std::string* raw = new std::string(handle.raw_size, '\0');
+        block.reset(raw);
+        uLongf raw_size = handle.raw_size;
+        if (uncompress(reinterpret_cast<Bytef*>(&(*raw)[0]), &raw_size,
+                       reinterpret_cast<const Bytef*>(base_ + handle.offset), handle.size) != Z_OK ||
+            raw_size != handle.raw_size) {
+            PDLOG(WARNING, "fail to uncompress block %u of file %s", idx, path_.c_str());
+            return false;
+        }
+        cache->Insert(id_, handle.offset, block);
+    }
+    data->reset(block->data(), block->size());
+    *holder = block;
+    return true;
+}
+
+SortedIterator* SortedFile::NewIterator() const { return new Iterator(this); }
+
+}  // namespace storage
+}  // namespace openmldb
@@ -0,0 +1,164 @@
+/*
+ * Copyright 2021 4Paradigm
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SRC_STORAGE_SORTED_FILE_H_
+#define SRC_STORAGE_SORTED_FILE_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/slice.h"
+
+namespace openmldb {
+namespace storage {
+
+// SortedIterator iterates the key value pairs of a sorted source in the bytewise order of the keys
+class SortedIterator {
+ public:
+    SortedIterator() {}
+    virtual ~SortedIterator() {}
+    SortedIterator(const SortedIterator&) = delete;
+    SortedIterator& operator=(const SortedIterator&) = delete;
+    virtual bool Valid() const = 0;
+    virtual void Next() = 0;
+    // the key and the value are valid until the iterator moves
+    virtual ::openmldb::base::Slice GetKey() const = 0;
+    virtual ::openmldb::base::Slice GetValue() const = 0;
+    // move to the first key not less than key
+    virtual void Seek(const ::openmldb::base::Slice& key) = 0;
+    virtual void SeekToFirst() = 0;
+};
+
+// MergedIterator merges the sorted sources, the same key in several sources is returned once per source
+class MergedIterator : public SortedIterator {
+ public:
+    // the iterators are owned by the merged iterator
+    explicit MergedIterator(std::vector<SortedIterator*>&& iters);
+    ~MergedIterator() override;
+    bool Valid() const override { return cur_ != NULL; }
+    void Next() override;
+    ::openmldb::base::Slice GetKey() const override { return cur_->GetKey(); }
+    ::openmldb::base::Slice GetValue() const override { return cur_->GetValue(); }
+    void Seek(const ::openmldb::base::Slice& key) override;
+    void SeekToFirst() override;
+
+ private:
+    void FindSmallest();
+
+    std::vector<SortedIterator*> iters_;
+    SortedIterator* cur_;
+};
+
+// SortedFile is an immutable file of the key value pairs in the key order. The pairs are packed into blocks of
+// about 4KB which are compressed with zlib optionally, the first key of each block is kept in the index at the end
+// of the file. The file is mapped into memory, a seek binary searches the index and scans one block.
+// The file format:
+//   block: [key size u32][value size u32][key][value]...
+//   index: [key size u32][first key][offset u64][size u32][raw size u32]... per block
+//   footer: [index offset u64][block count u32][compress u32][record count u64][max seq u64][min time u64][magic u64]
+class SortedFile {
+ public:
+    enum CompressType { kNoCompress = 0, kZlib = 1 };
+
+    struct Meta {
+        // the count of the records counted by the builder
+        uint64_t record_cnt = 0;
+        uint64_t max_seq = 0;
+        uint64_t min_time = UINT64_MAX;
+    };
+
+    class Builder {
+     public:
+        Builder(const std::string& path, CompressType compress);
+        ~Builder();
+        Builder(const Builder&) = delete;
+        Builder& operator=(const Builder&) = delete;
+
+        bool Open();
+        // the keys must be added in order
+        bool Add(const ::openmldb::base::Slice& key, const ::openmldb::base::Slice& value);
+        bool Finish(const Meta& meta);
+        // drop the unfinished file
+        void Abandon();
+
+        uint64_t GetFileSize() const { return offset_ + block_.size(); }
+        uint64_t GetCount() const { return cnt_; }
+
+     private:
+        bool FlushBlock();
+        bool Write(const char* data, size_t size);
+
+        std::string path_;
+        CompressType compress_;
+        FILE* fd_;
+        std::string block_;
+        std::string first_key_;
+        std::string index_;
+        uint32_t block_cnt_;
+        uint64_t offset_;
+        uint64_t cnt_;
+    };
+
+    ~SortedFile();
+    SortedFile(const SortedFile&) = delete;
+    SortedFile& operator=(const SortedFile&) = delete;
+
+    static std::shared_ptr<SortedFile> Open(const std::string& path);
+
+    SortedIterator* NewIterator() const;
+
+    const Meta& GetMeta() const { return meta_; }
+    const std::string& GetPath() const { return path_; }
+    uint64_t GetFileSize() const { return size_; }
+    // the file is removed from the disk once the last reader releases it
+    void MarkObsolete() { obsolete_.store(true, std::memory_order_relaxed); }
+
+ private:
+    class Iterator;
+
+    struct BlockHandle {
+        ::openmldb::base::Slice first_key;
+        uint64_t offset;
+        uint32_t size;
+        uint32_t raw_size;
+    };
+
+    SortedFile(const std::string& path, uint64_t id);
+    bool Load();
+    // the uncompressed data of the block, the holder keeps the data of a compressed block alive
+    bool ReadBlock(uint32_t idx, ::openmldb::base::Slice* data, std::shared_ptr<const std::string>* holder) const;
+
+    const std::string path_;
+    // the id of the opened file in the block cache
+    const uint64_t id_;
+    int fd_;
+    const char* base_;
+    uint64_t size_;
+    CompressType compress_;
+    Meta meta_;
+    std::vector<BlockHandle> blocks_;
+    std::atomic<bool> obsolete_;
+};
+
+}  // namespace storage
+}  // namespace openmldb
+
+#endif  // SRC_STORAGE_SORTED_FILE_H_
@@ -16,12 +16,14 @@
 
 #pragma once
 
+#include <array>
 #include <atomic>
 #include <map>
 #include <memory>
 #include <string>
 #include <vector>
 
+#include "base/hash.h"
 #include "proto/tablet.pb.h"
 #include "storage/iterator.h"
 #include "storage/schema.h"
@@ -161,7 +163,24 @@ class Table {
 
     bool CheckFieldExist(const std::string& name);
 
+    // the write version of key, it's increased by every put and delete of the key. The keys of the same hash slot
+    // share one version, so a version can be increased by other keys too
+    inline uint64_t GetKeyVersion(const std::string& key) const {
+        return key_versions_[GetKeyVersionSlot(key.data(), key.size())].load(std::memory_order_acquire);
+    }
+
  protected:
+    inline void IncrKeyVersion(const char* key, uint32_t size) {
+        key_versions_[GetKeyVersionSlot(key, size)].fetch_add(1, std::memory_order_release);
+    }
+
+    static inline uint32_t GetKeyVersionSlot(const char* key, uint32_t size) {
+        return ::openmldb::base::hash(key, size, KEY_VERSION_SEED) & (KEY_VERSION_SLOTS - 1);
+    }
+
+    static constexpr uint32_t KEY_VERSION_SLOTS = 1024;
+    static constexpr uint32_t KEY_VERSION_SEED = 0x9b2c4d1f;
+
     void UpdateTTL();
     bool InitFromMeta();
 
@@ -180,6 +199,7 @@ class Table {
     int64_t last_make_snapshot_time_;
     std::shared_ptr<std::map<int32_t, std::shared_ptr<Schema>>> version_schema_;
     std::shared_ptr<std::vector<::openmldb::storage::UpdateTTLMeta>> update_ttl_;
+    std::array<std::atomic<uint64_t>, KEY_VERSION_SLOTS> key_versions_{};
 };
 
 }  // namespace storage
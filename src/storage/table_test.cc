@@ -16,7 +16,15 @@
 
 #include <gflags/gflags.h>
 
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "base/file_util.h"
 #include "base/glog_wapper.h"
+#include "codec/codec.h"
 #include "codec/schema_codec.h"
 #include "common/timer.h"
 #include "gtest/gtest.h"
@@ -25,6 +33,11 @@
 
 DECLARE_uint32(max_traverse_cnt);
 DECLARE_int32(gc_safe_offset);
+DECLARE_uint32(time_block_hot_cnt);
+DECLARE_uint32(time_block_min_cnt);
+DECLARE_uint32(time_block_max_cnt);
+DECLARE_uint32(block_cache_mb);
+DECLARE_string(file_compression);
 
 namespace openmldb {
 namespace storage {
@@ -707,6 +720,195 @@ TEST_F(TableTest, TraverseIteratorCount) {
     FLAGS_max_traverse_cnt = old_max_traverse;
 }
 
+TEST_F(TableTest, ExtractIndexFromMemory) {
+    ::openmldb::api::TableMeta table_meta;
+    table_meta.set_name("table1");
+    table_meta.set_tid(1);
+    table_meta.set_pid(0);
+    table_meta.set_seg_cnt(8);
+    table_meta.set_mode(::openmldb::api::TableMode::kTableLeader);
+    SchemaCodec::SetColumnDesc(table_meta.add_column_desc(), "card", ::openmldb::type::kString);
+    SchemaCodec::SetColumnDesc(table_meta.add_column_desc(), "mcc", ::openmldb::type::kString);
+    SchemaCodec::SetColumnDesc(table_meta.add_column_desc(), "price", ::openmldb::type::kBigInt);
+    SchemaCodec::SetColumnDesc(table_meta.add_column_desc(), "ts1", ::openmldb::type::kBigInt);
+    SchemaCodec::SetIndex(table_meta.add_column_key(), "card", "card", "ts1", ::openmldb::type::kAbsoluteTime, 0, 0);
+    SchemaCodec::SetIndex(table_meta.add_column_key(), "mcc", "mcc", "ts1", ::openmldb::type::kAbsoluteTime, 0, 0);
+    MemTable table(table_meta);
+    table.Init();
+
+    ::openmldb::codec::RowBuilder builder(table_meta.column_desc());
+    for (int i = 0; i < 1000; i++) {
+        std::string card = "card" + std::to_string(i % 10);
+        std::string mcc = "mcc" + std::to_string(i % 7);
+        std::string value;
+        value.resize(builder.CalTotalLength(card.size() + mcc.size()));
+        builder.SetBuffer(reinterpret_cast<int8_t*>(&value[0]), value.size());
+        ASSERT_TRUE(builder.AppendString(card.c_str(), card.size()));
+        ASSERT_TRUE(builder.AppendString(mcc.c_str(), mcc.size()));
+        ASSERT_TRUE(builder.AppendInt64(i));
+        ASSERT_TRUE(builder.AppendInt64(1000 + i));
+        ::openmldb::api::PutRequest request;
+        ::openmldb::api::Dimension* dim = request.add_dimensions();
+        dim->set_idx(0);
+        dim->set_key(card);
+        dim = request.add_dimensions();
+        dim->set_idx(1);
+        dim->set_key(mcc);
+        ::openmldb::api::TSDimension* ts = request.add_ts_dimensions();
+        ts->set_idx(0);
+        ts->set_ts(1000 + i);
+        ASSERT_TRUE(table.Put(request.dimensions(), request.ts_dimensions(), value));
+    }
+    uint64_t record_byte_size = table.GetRecordByteSize();
+
+    // the same key columns as index card
+    ::openmldb::common::ColumnKey column_key;
+    SchemaCodec::SetIndex(&column_key, "card2", "card", "ts1", ::openmldb::type::kAbsoluteTime, 0, 0);
+    ASSERT_TRUE(table.AddIndex(column_key));
+    uint64_t count = 0;
+    ASSERT_TRUE(table.ExtractIndexFromMemory("card2", 2, &count));
+    ASSERT_EQ(1000u, count);
+    ASSERT_EQ(1000u, table.GetRecordCnt());
+    ASSERT_EQ(record_byte_size, table.GetRecordByteSize());
+    // the records in the new index already are skipped
+    ASSERT_TRUE(table.ExtractIndexFromMemory("card2", 2, &count));
+    ASSERT_EQ(0u, count);
+    Ticket ticket;
+    TableIterator* it = table.NewIterator(2, "card3", ticket);
+    it->SeekToFirst();
+    int num = 0;
+    uint64_t last_ts = 0;
+    while (it->Valid()) {
+        if (num > 0) {
+            ASSERT_LT(it->GetKey(), last_ts);
+        }
+        last_ts = it->GetKey();
+        num++;
+        it->Next();
+    }
+    ASSERT_EQ(100, num);
+    delete it;
+
+    // the key is decoded from the row, it's supported only if the table has one partition
+    ::openmldb::common::ColumnKey column_key2;
+    SchemaCodec::SetIndex(&column_key2, "mcc_price", "mcc|price", "ts1", ::openmldb::type::kAbsoluteTime, 0, 0);
+    ASSERT_TRUE(table.AddIndex(column_key2));
+    ASSERT_FALSE(table.ExtractIndexFromMemory("mcc_price", 2, &count));
+    ASSERT_TRUE(table.ExtractIndexFromMemory("mcc_price", 1, &count));
+    ASSERT_EQ(1000u, count);
+    it = table.NewIterator(3, "mcc3|10", ticket);
+    it->SeekToFirst();
+    ASSERT_TRUE(it->Valid());
+    ASSERT_EQ(1010u, it->GetKey());
+    ::openmldb::codec::RowView view(table_meta.column_desc());
+    ASSERT_TRUE(view.Reset(reinterpret_cast<const int8_t*>(it->GetValue().data()), it->GetValue().size()));
+    int64_t price = 0;
+    ASSERT_EQ(0, view.GetInt64(2, &price));
+    ASSERT_EQ(10, price);
+    it->Next();
+    ASSERT_FALSE(it->Valid());
+    delete it;
+
+    ASSERT_EQ(4000u, table.GetRecordIdxCnt());
+    ASSERT_EQ(1000u, table.GetRecordCnt());
+}
+
+TEST_F(TableTest, ExtractIndexWithPut) {
+    FLAGS_time_block_hot_cnt = 10;
+    FLAGS_time_block_min_cnt = 20;
+    FLAGS_time_block_max_cnt = 32;
+    ::openmldb::api::TableMeta table_meta;
+    table_meta.set_name("table1");
+    table_meta.set_tid(1);
+    table_meta.set_pid(0);
+    table_meta.set_seg_cnt(8);
+    table_meta.set_mode(::openmldb::api::TableMode::kTableLeader);
+    SchemaCodec::SetColumnDesc(table_meta.add_column_desc(), "card", ::openmldb::type::kString);
+    SchemaCodec::SetColumnDesc(table_meta.add_column_desc(), "mcc", ::openmldb::type::kString);
+    SchemaCodec::SetColumnDesc(table_meta.add_column_desc(), "ts1", ::openmldb::type::kBigInt);
+    SchemaCodec::SetIndex(table_meta.add_column_key(), "card", "card", "ts1", ::openmldb::type::kAbsoluteTime, 0, 0);
+    SchemaCodec::SetIndex(table_meta.add_column_key(), "mcc", "mcc", "ts1", ::openmldb::type::kAbsoluteTime, 0, 0);
+    MemTable table(table_meta);
+    table.Init();
+
+    auto put = [&](int i, bool new_index) {
+        std::string card = "card" + std::to_string(i % 10);
+        std::string mcc = "mcc" + std::to_string(i % 7);
+        std::string value;
+        ::openmldb::codec::RowBuilder row_builder(table_meta.column_desc());
+        value.resize(row_builder.CalTotalLength(card.size() + mcc.size()));
+        row_builder.SetBuffer(reinterpret_cast<int8_t*>(&value[0]), value.size());
+        row_builder.AppendString(card.c_str(), card.size());
+        row_builder.AppendString(mcc.c_str(), mcc.size());
+        row_builder.AppendInt64(1000 + i);
+        ::openmldb::api::PutRequest request;
+        ::openmldb::api::Dimension* dim = request.add_dimensions();
+        dim->set_idx(0);
+        dim->set_key(card);
+        dim = request.add_dimensions();
+        dim->set_idx(1);
+        dim->set_key(mcc);
+        if (new_index) {
+            dim = request.add_dimensions();
+            dim->set_idx(2);
+            dim->set_key(card);
+        }
+        ::openmldb::api::TSDimension* ts = request.add_ts_dimensions();
+        ts->set_idx(0);
+        ts->set_ts(1000 + i);
+        return table.Put(request.dimensions(), request.ts_dimensions(), value);
+    };
+    // every record is put twice, the same records put by the user are both kept in the new index
+    for (int i = 0; i < 1000; i++) {
+        ASSERT_TRUE(put(i, false));
+        ASSERT_TRUE(put(i, false));
+    }
+    // most of the records are sealed into the time blocks
+    table.SchedGc();
+
+    ::openmldb::common::ColumnKey column_key;
+    SchemaCodec::SetIndex(&column_key, "card2", "card", "ts1", ::openmldb::type::kAbsoluteTime, 0, 0);
+    ASSERT_TRUE(table.AddIndex(column_key));
+    std::atomic<bool> put_ok(true);
+    std::thread put_thread([&] {
+        for (int i = 1000; i < 3000; i++) {
+            if (!put(i, true)) {
+                put_ok.store(false);
+            }
+        }
+    });
+    uint64_t count = 0;
+    ASSERT_TRUE(table.ExtractIndexFromMemory("card2", 2, &count));
+    put_thread.join();
+    ASSERT_TRUE(put_ok.load());
+    // the records extracted already are skipped
+    ASSERT_TRUE(table.ExtractIndexFromMemory("card2", 2, &count));
+    ASSERT_EQ(0u, count);
+
+    Ticket ticket;
+    for (int i = 0; i < 10; i++) {
+        std::string key = "card" + std::to_string(i);
+        std::unique_ptr<TableIterator> src_it(table.NewIterator(0, key, ticket));
+        std::unique_ptr<TableIterator> it(table.NewIterator(2, key, ticket));
+        src_it->SeekToFirst();
+        it->SeekToFirst();
+        int num = 0;
+        while (src_it->Valid()) {
+            ASSERT_TRUE(it->Valid());
+            ASSERT_EQ(src_it->GetKey(), it->GetKey());
+            ASSERT_EQ(src_it->GetValue().ToString(), it->GetValue().ToString());
+            num++;
+            src_it->Next();
+            it->Next();
+        }
+        ASSERT_FALSE(it->Valid());
+        ASSERT_EQ(400, num);
+    }
+    FLAGS_time_block_hot_cnt = 0;
+    FLAGS_time_block_min_cnt = 128;
+    FLAGS_time_block_max_cnt = 1024;
+}
+
 TEST_F(TableTest, UpdateTTL) {
     ::openmldb::api::TableMeta table_meta;
     table_meta.set_name("table1");
@@ -1112,11 +1314,231 @@ TEST_F(TableTest, GcAbsAndLat) {
     FLAGS_gc_safe_offset = offset;
 }
 
+static void PutColdTierRow(MemTable* table, const std::string& card, const std::string& mcc, uint64_t ts,
+                           const std::string& value) {
+    ::openmldb::api::PutRequest request;
+    ::openmldb::api::Dimension* dim = request.add_dimensions();
+    dim->set_idx(0);
+    dim->set_key(card);
+    dim = request.add_dimensions();
+    dim->set_idx(1);
+    dim->set_key(mcc);
+    ::openmldb::api::TSDimension* tsd = request.add_ts_dimensions();
+    tsd->set_idx(0);
+    tsd->set_ts(ts);
+    ASSERT_TRUE(table->Put(request.dimensions(), request.ts_dimensions(), value));
+}
+
+static int CountColdTierRows(MemTable* table, uint32_t index, const std::string& pk) {
+    Ticket ticket;
+    std::unique_ptr<TableIterator> it(table->NewIterator(index, pk, ticket));
+    int count = 0;
+    uint64_t last = UINT64_MAX;
+    for (it->SeekToFirst(); it->Valid(); it->Next()) {
+        EXPECT_LE(it->GetKey(), last);
+        last = it->GetKey();
+        count++;
+    }
+    return count;
+}
+
+TEST_F(TableTest, ColdTier) {
+    std::string path = "/tmp/table_test_cold_tier/" + std::to_string(::baidu::common::timer::get_micros());
+    ::openmldb::api::TableMeta table_meta;
+    table_meta.set_name("t0");
+    table_meta.set_tid(1);
+    table_meta.set_pid(0);
+    table_meta.set_seg_cnt(4);
+    SchemaCodec::SetColumnDesc(table_meta.add_column_desc(), "card", ::openmldb::type::kString);
+    SchemaCodec::SetColumnDesc(table_meta.add_column_desc(), "mcc", ::openmldb::type::kString);
+    SchemaCodec::SetColumnDesc(table_meta.add_column_desc(), "ts1", ::openmldb::type::kBigInt);
+    SchemaCodec::SetIndex(table_meta.add_column_key(), "card", "card", "ts1", ::openmldb::type::kAbsoluteTime, 0, 0);
+    SchemaCodec::SetIndex(table_meta.add_column_key(), "mcc", "mcc", "ts1", ::openmldb::type::kAbsoluteTime, 0, 0);
+    uint64_t now = ::baidu::common::timer::get_micros() / 1000;
+    auto put_rows = [&](MemTable* table) {
+        for (int i = 0; i < 200; i++) {
+            // the rows of card10 are all old
+            std::string card = i < 180 ? "card" + std::to_string(i % 9) : "card10";
+            uint64_t ts = i < 180 ? now - (i / 9) * 60 * 1000 : now - (30 + i) * 60 * 1000;
+            PutColdTierRow(table, card, "mcc" + std::to_string(i % 5), ts, "value" + std::to_string(i));
+        }
+    };
+    {
+        MemTable table(table_meta);
+        ASSERT_TRUE(table.Init());
+        ASSERT_TRUE(table.InitColdTier(path, 10 * 60 * 1000));
+        put_rows(&table);
+        uint64_t byte_size = table.GetRecordByteSize();
+        ASSERT_EQ(20, CountColdTierRows(&table, 0, "card3"));
+        table.SchedGc();
+        ASSERT_EQ(200u, table.GetRecordCnt());
+        ASSERT_EQ(110u, table.GetColdTier()->GetRecordCnt());
+        ASSERT_LT(table.GetRecordByteSize(), byte_size);
+        ASSERT_EQ(20, CountColdTierRows(&table, 0, "card3"));
+        ASSERT_EQ(20, CountColdTierRows(&table, 0, "card10"));
+        ASSERT_EQ(40, CountColdTierRows(&table, 1, "mcc2"));
+        uint64_t cnt = 0;
+        ASSERT_EQ(0, table.GetCount(0, "card3", cnt));
+        ASSERT_EQ(20u, cnt);
+        // all the rows of card10 are in the cold tier
+        ASSERT_EQ(0, table.GetCount(0, "card10", cnt));
+        ASSERT_EQ(20u, cnt);
+        ASSERT_EQ(0, table.GetCount(1, "mcc2", cnt));
+        ASSERT_EQ(40u, cnt);
+
+        // the window of a key continues into the cold tier
+        std::unique_ptr<::hybridse::vm::WindowIterator> wit(table.NewWindowIterator(0));
+        wit->Seek("card3");
+        ASSERT_TRUE(wit->Valid());
+        ASSERT_EQ("card3", wit->GetKey().ToString());
+        std::unique_ptr<::hybridse::vm::RowIterator> rit = wit->GetValue();
+        int count = 0;
+        for (rit->SeekToFirst(); rit->Valid(); rit->Next()) {
+            count++;
+        }
+        ASSERT_EQ(20, count);
+        rit->Seek(now - 15 * 60 * 1000);
+        ASSERT_TRUE(rit->Valid());
+        ASSERT_EQ(now - 15 * 60 * 1000, rit->GetKey());
+        wit->Seek("card10");
+        ASSERT_TRUE(wit->Valid());
+        ASSERT_EQ("card10", wit->GetKey().ToString());
+        int key_cnt = 0;
+        for (wit->SeekToFirst(); wit->Valid(); wit->Next()) {
+            key_cnt++;
+        }
+        ASSERT_EQ(10, key_cnt);
+
+        std::unique_ptr<TableIterator> tit(table.NewTraverseIterator(0));
+        count = 0;
+        for (tit->SeekToFirst(); tit->Valid(); tit->Next()) {
+            count++;
+        }
+        ASSERT_EQ(200, count);
+
+        ASSERT_TRUE(table.Delete("card3", 0));
+        ASSERT_EQ(0, CountColdTierRows(&table, 0, "card3"));
+    }
+    {
+        // the rows recovered into memory again are not moved twice
+        MemTable table(table_meta);
+        ASSERT_TRUE(table.Init());
+        ASSERT_TRUE(table.InitColdTier(path, 10 * 60 * 1000));
+        put_rows(&table);
+        ASSERT_EQ(20, CountColdTierRows(&table, 0, "card4"));
+        ASSERT_EQ(20, CountColdTierRows(&table, 0, "card10"));
+        uint64_t cnt = 0;
+        ASSERT_EQ(0, table.GetCount(0, "card10", cnt));
+        ASSERT_EQ(20u, cnt);
+        table.SchedGc();
+        ASSERT_EQ(20, CountColdTierRows(&table, 0, "card4"));
+        ASSERT_EQ(20, CountColdTierRows(&table, 0, "card10"));
+        ASSERT_EQ(40, CountColdTierRows(&table, 1, "mcc2"));
+        ASSERT_EQ(0, table.GetCount(0, "card4", cnt));
+        ASSERT_EQ(20u, cnt);
+        ASSERT_EQ(0, table.GetCount(0, "card10", cnt));
+        ASSERT_EQ(20u, cnt);
+    }
+    ::openmldb::base::RemoveDirRecursive("/tmp/table_test_cold_tier");
+}
+
+TEST_F(TableTest, ColdTierValueAfterNext) {
+    std::string path = "/tmp/table_test_cold_tier/" + std::to_string(::baidu::common::timer::get_micros());
+    FLAGS_file_compression = "zlib";
+    ::openmldb::api::TableMeta table_meta;
+    table_meta.set_name("t0");
+    table_meta.set_tid(1);
+    table_meta.set_pid(0);
+    table_meta.set_seg_cnt(1);
+    SchemaCodec::SetColumnDesc(table_meta.add_column_desc(), "card", ::openmldb::type::kString);
+    SchemaCodec::SetColumnDesc(table_meta.add_column_desc(), "mcc", ::openmldb::type::kString);
+    SchemaCodec::SetColumnDesc(table_meta.add_column_desc(), "ts1", ::openmldb::type::kBigInt);
+    SchemaCodec::SetIndex(table_meta.add_column_key(), "card", "card", "ts1", ::openmldb::type::kAbsoluteTime, 0, 0);
+    SchemaCodec::SetIndex(table_meta.add_column_key(), "mcc", "mcc", "ts1", ::openmldb::type::kAbsoluteTime, 0, 0);
+    uint64_t now = ::baidu::common::timer::get_micros() / 1000;
+    auto make_value = [](int i) { return std::string(200, 'v') + std::to_string(i); };
+    MemTable table(table_meta);
+    ASSERT_TRUE(table.Init());
+    ASSERT_TRUE(table.InitColdTier(path, 10 * 60 * 1000));
+    for (int i = 0; i < 1000; i++) {
+        PutColdTierRow(&table, "card0", "mcc0", now - 20 * 60 * 1000 - i, make_value(i));
+    }
+    table.SchedGc();
+    FLAGS_file_compression = "off";
+    ASSERT_EQ(1000u, table.GetColdTier()->GetRecordCnt());
+
+    // the values are kept across Next as ScanIndex does, the blocks they are read from are released already
+    Ticket ticket;
+    std::unique_ptr<TableIterator> it(table.NewIterator(0, "card0", ticket));
+    std::vector<::openmldb::base::Slice> values;
+    for (it->SeekToFirst(); it->Valid(); it->Next()) {
+        values.push_back(it->GetValue());
+    }
+    ASSERT_EQ(1000u, values.size());
+    for (int i = 0; i < 1000; i++) {
+        ASSERT_EQ(make_value(i), values[i].ToString());
+    }
+    ::openmldb::base::RemoveDirRecursive("/tmp/table_test_cold_tier");
+}
+
+TEST_F(TableTest, ColdTierLatestExpire) {
+    std::string path = "/tmp/table_test_cold_tier/" + std::to_string(::baidu::common::timer::get_micros());
+    ::openmldb::api::TableMeta table_meta;
+    table_meta.set_name("t0");
+    table_meta.set_tid(1);
+    table_meta.set_pid(0);
+    table_meta.set_seg_cnt(1);
+    SchemaCodec::SetColumnDesc(table_meta.add_column_desc(), "card", ::openmldb::type::kString);
+    SchemaCodec::SetColumnDesc(table_meta.add_column_desc(), "mcc", ::openmldb::type::kString);
+    SchemaCodec::SetColumnDesc(table_meta.add_column_desc(), "ts1", ::openmldb::type::kBigInt);
+    SchemaCodec::SetIndex(table_meta.add_column_key(), "card", "card", "ts1", ::openmldb::type::kLatestTime, 0, 3);
+    SchemaCodec::SetIndex(table_meta.add_column_key(), "mcc", "mcc", "ts1", ::openmldb::type::kLatestTime, 0, 3);
+    uint64_t now = ::baidu::common::timer::get_micros() / 1000;
+    MemTable table(table_meta);
+    ASSERT_TRUE(table.Init());
+    ASSERT_TRUE(table.InitColdTier(path, 10 * 60 * 1000));
+    // the old rows are moved into the cold tier, then the new rows are kept in memory
+    for (int i = 0; i < 3; i++) {
+        PutColdTierRow(&table, "card0", "mcc0", now - (20 + i) * 60 * 1000, "old" + std::to_string(i));
+    }
+    table.SchedGc();
+    for (int i = 0; i < 3; i++) {
+        PutColdTierRow(&table, "card0", "mcc0", now - (1 + i) * 60 * 1000, "new" + std::to_string(i));
+    }
+    table.SchedGc();
+    uint64_t cnt = 0;
+    ASSERT_EQ(0, table.GetCount(0, "card0", cnt));
+    ASSERT_EQ(6u, cnt);
+
+    auto make_entry = [&](uint64_t ts) {
+        ::openmldb::api::LogEntry entry;
+        entry.set_ts(ts);
+        ::openmldb::api::Dimension* dim = entry.add_dimensions();
+        dim->set_idx(0);
+        dim->set_key("card0");
+        dim = entry.add_dimensions();
+        dim->set_idx(1);
+        dim->set_key("mcc0");
+        ::openmldb::api::TSDimension* tsd = entry.add_ts_dimensions();
+        tsd->set_idx(0);
+        tsd->set_ts(ts);
+        return entry;
+    };
+    // only the latest 3 rows of both tiers are kept
+    ASSERT_TRUE(table.IsExpire(make_entry(now - 10 * 60 * 1000)));
+    ASSERT_TRUE(table.IsExpire(make_entry(now - 25 * 60 * 1000)));
+    ASSERT_FALSE(table.IsExpire(make_entry(now - 2 * 60 * 1000)));
+    ASSERT_FALSE(table.IsExpire(make_entry(now)));
+    ::openmldb::base::RemoveDirRecursive("/tmp/table_test_cold_tier");
+}
+
 }  // namespace storage
 }  // namespace openmldb
 
 int main(int argc, char** argv) {
     FLAGS_max_traverse_cnt = 200000;
+    // the uncompressed blocks of the cold tier are released once the iterators leave them
+    FLAGS_block_cache_mb = 0;
     ::testing::InitGoogleTest(&argc, argv);
     ::openmldb::base::SetLogLevel(INFO);
     return RUN_ALL_TESTS();
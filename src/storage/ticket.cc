@@ -19,30 +19,9 @@
 namespace openmldb {
 namespace storage {
 
-Ticket::Ticket() {}
+Ticket::Ticket() : slot_(EpochManager::GetInstance()->Enter()) {}
 
-Ticket::~Ticket() {
-    std::vector<KeyEntry*>::iterator it = entries_.begin();
-    for (; it != entries_.end(); ++it) {
-        (*it)->UnRef();
-    }
-}
-
-void Ticket::Push(KeyEntry* entry) {
-    if (entry == NULL) {
-        return;
-    }
-    entry->Ref();
-    entries_.push_back(entry);
-}
-
-void Ticket::Pop() {
-    if (!entries_.empty()) {
-        KeyEntry* entry = entries_.back();
-        entries_.pop_back();
-        entry->UnRef();
-    }
-}
+Ticket::~Ticket() { EpochManager::GetInstance()->Exit(slot_); }
 
 }  // namespace storage
 }  // namespace openmldb
@@ -17,15 +17,13 @@
 #ifndef SRC_STORAGE_TICKET_H_
 #define SRC_STORAGE_TICKET_H_
 
-#include <vector>
-
-#include "storage/segment.h"
+#include "storage/epoch.h"
 
 namespace openmldb {
 namespace storage {
 
-class KeyEntry;
-
+// Ticket pins an epoch for the readers of segments in its lifetime, the nodes gc unlinks in the meantime are not
+// freed until it's destroyed. Take it before getting any entry from a segment and keep it while iterating.
 class Ticket {
  public:
     Ticket();
@@ -33,11 +31,8 @@ class Ticket {
     Ticket(const Ticket&) = delete;
     Ticket& operator=(const Ticket& s) = delete;
 
-    void Push(KeyEntry* entry);
-    void Pop();
-
  private:
-    std::vector<KeyEntry*> entries_;
+    EpochSlot* slot_;
 };
 
 }  // namespace storage
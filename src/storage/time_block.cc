@@ -0,0 +1,126 @@
+/*
+ * Copyright 2021 4Paradigm
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "storage/time_block.h"
+
+#include <snappy.h>
+#include <string.h>
+
+namespace openmldb {
+namespace storage {
+
+TimeBlock::TimeBlock(uint32_t cnt, uint64_t max_time, uint64_t min_time)
+    : cnt_(cnt),
+      max_time_(max_time),
+      min_time_(min_time),
+      compressed_(false),
+      data_size_(0),
+      buf_size_(0),
+      buf_(NULL),
+      times_(NULL),
+      offsets_(NULL),
+      owners_(NULL),
+      data_(NULL),
+      next_(NULL) {}
+
+TimeBlock::~TimeBlock() { delete[] buf_; }
+
+TimeBlock* TimeBlock::New(const Record* records, uint32_t cnt, bool compress) {
+    if (records == NULL || cnt == 0) {
+        return NULL;
+    }
+    uint32_t raw_size = 0;
+    for (uint32_t i = 0; i < cnt; i++) {
+        raw_size += records[i].size;
+    }
+    std::string compressed;
+    if (compress) {
+        std::string raw;
+        raw.reserve(raw_size);
+        for (uint32_t i = 0; i < cnt; i++) {
+            raw.append(records[i].data, records[i].size);
+        }
+        ::snappy::Compress(raw.data(), raw.size(), &compressed);
+        // keep the raw values if they can't be compressed
+        compress = compressed.size() < raw.size();
+    }
+    TimeBlock* block = new TimeBlock(cnt, records[0].time, records[cnt - 1].time);
+    block->compressed_ = compress;
+    block->data_size_ = compress ? compressed.size() : raw_size;
+    uint64_t meta_size = sizeof(uint64_t) * cnt + sizeof(uint32_t) * (cnt + 1) + cnt;
+    block->buf_size_ = meta_size + block->data_size_;
+    block->buf_ = new char[block->buf_size_];
+    uint64_t* times = reinterpret_cast<uint64_t*>(block->buf_);
+    uint32_t* offsets = reinterpret_cast<uint32_t*>(times + cnt);
+    uint8_t* owners = reinterpret_cast<uint8_t*>(offsets + cnt + 1);
+    char* data = reinterpret_cast<char*>(owners + cnt);
+    uint32_t offset = 0;
+    for (uint32_t i = 0; i < cnt; i++) {
+        times[i] = records[i].time;
+        offsets[i] = offset;
+        owners[i] = records[i].owner ? 1 : 0;
+        if (!compress) {
+            memcpy(data + offset, records[i].data, records[i].size);
+        }
+        offset += records[i].size;
+    }
+    offsets[cnt] = offset;
+    if (compress) {
+        memcpy(data, compressed.data(), compressed.size());
+    }
+    block->times_ = times;
+    block->offsets_ = offsets;
+    block->owners_ = owners;
+    block->data_ = data;
+    return block;
+}
+
+uint32_t TimeBlock::Seek(uint64_t time) const {
+    uint32_t low = 0;
+    uint32_t high = cnt_;
+    while (low < high) {
+        uint32_t mid = (low + high) >> 1;
+        if (times_[mid] > time) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+const char* TimeBlock::GetValues(std::string* buf) const {
+    if (!compressed_) {
+        return data_;
+    }
+    if (buf == NULL) {
+        return NULL;
+    }
+    buf->clear();
+    if (!::snappy::Uncompress(data_, data_size_, buf) || buf->size() != offsets_[cnt_]) {
+        return NULL;
+    }
+    return buf->data();
+}
+
+void TimeBlock::GetRecords(const char* values, uint32_t idx, std::vector<Record>* records) const {
+    for (uint32_t i = idx; i < cnt_; i++) {
+        records->push_back(Record{times_[i], values + offsets_[i], GetSize(i), owners_[i] != 0});
+    }
+}
+
+}  // namespace storage
+}  // namespace openmldb
@@ -0,0 +1,101 @@
+/*
+ * Copyright 2021 4Paradigm
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SRC_STORAGE_TIME_BLOCK_H_
+#define SRC_STORAGE_TIME_BLOCK_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "base/slice.h"
+
+namespace openmldb {
+namespace storage {
+
+// TimeBlock keeps the sealed records of a key in one buffer, the times, the value offsets and the values are
+// stored in arrays in the desc order of time. It's immutable once built. The blocks of a key are chained from the
+// newest to the oldest and their time ranges don't overlap, so a seek skips the blocks by the min and max time in
+// the header and binary searches the times of one block.
+class TimeBlock {
+ public:
+    struct Record {
+        uint64_t time;
+        const char* data;
+        uint32_t size;
+        // the block owns the record if no index refers to its data block any more, the record is counted in the
+        // records of the table until the block drops it
+        bool owner;
+    };
+
+    // the records must be in the desc order of time. The values are compressed with snappy if compress is true
+    static TimeBlock* New(const Record* records, uint32_t cnt, bool compress);
+    ~TimeBlock();
+
+    TimeBlock(const TimeBlock&) = delete;
+    TimeBlock& operator=(const TimeBlock&) = delete;
+
+    uint32_t GetCount() const { return cnt_; }
+    uint64_t GetMaxTime() const { return max_time_; }
+    uint64_t GetMinTime() const { return min_time_; }
+    uint64_t GetTime(uint32_t idx) const { return times_[idx]; }
+    bool IsOwner(uint32_t idx) const { return owners_[idx] != 0; }
+    uint32_t GetSize(uint32_t idx) const { return offsets_[idx + 1] - offsets_[idx]; }
+    bool IsCompressed() const { return compressed_; }
+    // the memory the block takes
+    uint64_t GetByteSize() const { return sizeof(TimeBlock) + buf_size_; }
+
+    // the first record whose time is not greater than time, it's the count if there is none
+    uint32_t Seek(uint64_t time) const;
+
+    // the values of all the records, a compressed block is uncompressed to buf. It's NULL if the data is corrupted
+    const char* GetValues(std::string* buf) const;
+
+    // the value of the record idx in the values returned by GetValues
+    ::openmldb::base::Slice GetValue(const char* values, uint32_t idx) const {
+        return ::openmldb::base::Slice(values + offsets_[idx], offsets_[idx + 1] - offsets_[idx]);
+    }
+
+    // the records from idx to the end with the data in values, it's used to build new blocks
+    void GetRecords(const char* values, uint32_t idx, std::vector<Record>* records) const;
+
+    TimeBlock* GetNext() const { return next_.load(std::memory_order_acquire); }
+    void SetNext(TimeBlock* next) { next_.store(next, std::memory_order_release); }
+
+ private:
+    TimeBlock(uint32_t cnt, uint64_t max_time, uint64_t min_time);
+
+    const uint32_t cnt_;
+    const uint64_t max_time_;
+    const uint64_t min_time_;
+    bool compressed_;
+    uint32_t data_size_;
+    uint64_t buf_size_;
+    // times_, offsets_, owners_ and data_ are in buf_
+    char* buf_;
+    const uint64_t* times_;
+    const uint32_t* offsets_;
+    const uint8_t* owners_;
+    const char* data_;
+    std::atomic<TimeBlock*> next_;
+};
+
+}  // namespace storage
+}  // namespace openmldb
+
+#endif  // SRC_STORAGE_TIME_BLOCK_H_
@@ -0,0 +1,465 @@
+/*
+ * Copyright 2021 4Paradigm
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "tablet/aggr_route.h"
+
+#include <algorithm>
+#include <limits>
+#include <map>
+
+#include "boost/algorithm/string.hpp"
+#include "catalog/schema_adapter.h"
+#include "codec/schema_codec.h"
+#include "glog/logging.h"
+#include "vm/physical_op.h"
+
+namespace openmldb {
+namespace tablet {
+
+using ::hybridse::vm::PhysicalOpNode;
+
+namespace {
+
+int32_t FindColumn(const ::openmldb::codec::Schema& schema, const ::hybridse::node::ExprNode* expr) {
+    if (expr == nullptr || expr->GetExprType() != ::hybridse::node::kExprColumnRef) {
+        return -1;
+    }
+    auto column = dynamic_cast<const ::hybridse::node::ColumnRefNode*>(expr);
+    for (int32_t i = 0; i < schema.size(); i++) {
+        if (schema.Get(i).name() == column->GetColumnName()) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+bool IsNumeric(::openmldb::type::DataType type) {
+    switch (type) {
+        case ::openmldb::type::kSmallInt:
+        case ::openmldb::type::kInt:
+        case ::openmldb::type::kBigInt:
+        case ::openmldb::type::kTimestamp:
+        case ::openmldb::type::kFloat:
+        case ::openmldb::type::kDouble:
+            return true;
+        default:
+            return false;
+    }
+}
+
+}  // namespace
+
+std::shared_ptr<AggrRoute> AggrRoute::Build(const ::hybridse::vm::CompileInfo& info) {
+    // PROJECT(type=Aggregation) over REQUEST_UNION(request, partition of an index) of the same table
+    const PhysicalOpNode* plan = info.GetPhysicalPlan();
+    if (plan == nullptr || plan->GetOpType() != ::hybridse::vm::kPhysicalOpProject || plan->GetProducerCnt() != 1) {
+        return nullptr;
+    }
+    auto project = dynamic_cast<const ::hybridse::vm::PhysicalProjectNode*>(plan);
+    if (project == nullptr || project->project_type_ != ::hybridse::vm::kAggregation) {
+        return nullptr;
+    }
+    auto request_union = dynamic_cast<const ::hybridse::vm::PhysicalRequestUnionNode*>(plan->GetProducer(0));
+    if (request_union == nullptr || request_union->GetProducerCnt() != 2 ||
+        !request_union->window_unions().Empty() || request_union->instance_not_in_window() ||
+        !request_union->output_request_row()) {
+        return nullptr;
+    }
+    auto request = dynamic_cast<const ::hybridse::vm::PhysicalRequestProviderNode*>(request_union->GetProducer(0));
+    auto partition = dynamic_cast<const ::hybridse::vm::PhysicalPartitionProviderNode*>(
+        request_union->GetProducer(1));
+    if (request == nullptr || partition == nullptr || !request->table_handler_ || !partition->table_handler_) {
+        return nullptr;
+    }
+    auto table_handler = partition->table_handler_;
+    if (request->table_handler_->GetDatabase() != table_handler->GetDatabase() ||
+        request->table_handler_->GetName() != table_handler->GetName()) {
+        return nullptr;
+    }
+    const auto& window = request_union->window();
+    const auto* frame = window.range().frame();
+    if (window.partition().ValidKey() || !window.index_key().ValidKey() || !window.range().Valid() ||
+        frame == nullptr || frame->frame_type() != ::hybridse::node::kFrameRowsRange || frame->frame_maxsize() != 0) {
+        return nullptr;
+    }
+
+    std::shared_ptr<AggrRoute> route(new AggrRoute());
+    route->db_ = table_handler->GetDatabase();
+    route->table_ = table_handler->GetName();
+    route->index_name_ = partition->index_name_;
+    route->start_offset_ = frame->GetHistoryRangeStart();
+    route->end_offset_ = frame->GetHistoryRangeEnd();
+    route->exclude_current_time_ = request_union->exclude_current_time();
+    if (!::openmldb::catalog::SchemaAdapter::ConvertSchema(info.GetRequestSchema(), &route->request_schema_) ||
+        !::openmldb::catalog::SchemaAdapter::ConvertSchema(info.GetSchema(), &route->output_schema_) ||
+        route->output_schema_.size() != static_cast<int>(project->project().size())) {
+        return nullptr;
+    }
+    const auto& schema = route->request_schema_;
+
+    // the key of the index is built from the request columns in the order of the index
+    const auto& indexes = table_handler->GetIndex();
+    auto index_it = indexes.find(route->index_name_);
+    if (index_it == indexes.end()) {
+        return nullptr;
+    }
+    const auto* index_keys = window.index_key().keys();
+    if (index_keys->GetChildNum() != index_it->second.keys.size()) {
+        return nullptr;
+    }
+    std::map<std::string, uint32_t> key_cols;
+    for (size_t i = 0; i < index_keys->GetChildNum(); i++) {
+        int32_t col = FindColumn(schema, index_keys->GetChild(i));
+        if (col < 0) {
+            return nullptr;
+        }
+        switch (schema.Get(col).data_type()) {
+            case ::openmldb::type::kString:
+            case ::openmldb::type::kVarchar:
+            case ::openmldb::type::kBool:
+            case ::openmldb::type::kSmallInt:
+            case ::openmldb::type::kInt:
+            case ::openmldb::type::kBigInt:
+            case ::openmldb::type::kTimestamp:
+                break;
+            default:
+                return nullptr;
+        }
+        key_cols.emplace(schema.Get(col).name(), col);
+    }
+    for (const auto& key : index_it->second.keys) {
+        auto it = key_cols.find(key.name);
+        if (it == key_cols.end()) {
+            return nullptr;
+        }
+        route->key_cols_.push_back(it->second);
+    }
+    int32_t ts_col = FindColumn(schema, window.range().range_key());
+    if (ts_col < 0 || static_cast<uint32_t>(ts_col) != index_it->second.ts_pos) {
+        return nullptr;
+    }
+    switch (schema.Get(ts_col).data_type()) {
+        case ::openmldb::type::kBigInt:
+        case ::openmldb::type::kTimestamp:
+            break;
+        default:
+            return nullptr;
+    }
+    route->ts_col_ = ts_col;
+
+    // the outputs are the request columns and the aggregates of the window
+    for (size_t i = 0; i < project->project().size(); i++) {
+        const auto* expr = project->project().GetExpr(i);
+        const auto* column_frame = project->project().GetFrame(i);
+        if (column_frame != nullptr && column_frame != frame && !column_frame->Equals(frame)) {
+            return nullptr;
+        }
+        Column column;
+        if (expr->GetExprType() == ::hybridse::node::kExprColumnRef) {
+            column.request_col = FindColumn(schema, expr);
+            if (column.request_col < 0 ||
+                schema.Get(column.request_col).data_type() != route->output_schema_.Get(i).data_type()) {
+                return nullptr;
+            }
+            route->columns_.push_back(column);
+            continue;
+        }
+        if (expr->GetExprType() != ::hybridse::node::kExprCall ||
+            !IsNumeric(route->output_schema_.Get(i).data_type())) {
+            return nullptr;
+        }
+        auto call = dynamic_cast<const ::hybridse::node::CallExprNode*>(expr);
+        if (call->GetFnDef() == nullptr) {
+            return nullptr;
+        }
+        std::string func = boost::to_lower_copy(call->GetFnDef()->GetName());
+        ::openmldb::storage::AggrType type;
+        bool has_filter = false;
+        if (!::openmldb::storage::Aggregator::ParseAggrFunc(func, &type, &has_filter) ||
+            call->GetChildNum() != (has_filter ? 2u : 1u)) {
+            return nullptr;
+        }
+        column.aggr_type = type;
+        column.has_filter = has_filter;
+        auto& aggr_info = column.aggr_info;
+        aggr_info.set_aggr_func(func);
+        aggr_info.set_index_name(route->index_name_);
+        const auto* arg = call->GetChild(0);
+        if (arg->GetExprType() == ::hybridse::node::kExprAll && type == ::openmldb::storage::AggrType::kCount) {
+            aggr_info.set_aggr_col("*");
+        } else {
+            int32_t col = FindColumn(schema, arg);
+            if (col < 0) {
+                return nullptr;
+            }
+            // sum_where, min_where and max_where of the engine don't skip the null values
+            if (has_filter && type != ::openmldb::storage::AggrType::kCount &&
+                type != ::openmldb::storage::AggrType::kAvg && !schema.Get(col).not_null()) {
+                return nullptr;
+            }
+            aggr_info.set_aggr_col(schema.Get(col).name());
+        }
+        if (has_filter) {
+            int32_t col = FindColumn(schema, call->GetChild(1));
+            if (col < 0 || schema.Get(col).data_type() != ::openmldb::type::kBool) {
+                return nullptr;
+            }
+            aggr_info.set_filter_col(schema.Get(col).name());
+        }
+        route->columns_.push_back(column);
+    }
+    route->request_view_.reset(new ::openmldb::codec::RowView(route->request_schema_));
+    DLOG(INFO) << "procedure " << info.GetSql() << " is routed to the aggregators of index " << route->index_name_;
+    return route;
+}
+
+bool AggrRoute::GetKey(const int8_t* row, uint32_t size, std::string* key) {
+    if (row == nullptr || size <= ::openmldb::codec::HEADER_LENGTH ||
+        ::openmldb::codec::RowView::GetSize(row) != size) {
+        return false;
+    }
+    key->clear();
+    std::string value;
+    for (uint32_t col : key_cols_) {
+        if (!key->empty()) {
+            key->append("|");
+        }
+        if (request_view_->IsNULL(row, col)) {
+            key->append(::openmldb::codec::NONETOKEN);
+            continue;
+        }
+        if (request_view_->GetStrValue(row, col, &value) != 0) {
+            return false;
+        }
+        key->append(value.empty() ? ::openmldb::codec::EMPTY_STRING : value);
+    }
+    return true;
+}
+
+bool AggrRoute::GetTs(const int8_t* row, uint64_t* ts) {
+    int64_t value = 0;
+    if (request_view_->GetInteger(row, ts_col_, request_schema_.Get(ts_col_).data_type(), &value) != 0 ||
+        value < 0) {
+        return false;
+    }
+    *ts = value;
+    return true;
+}
+
+bool AggrRoute::Run(::openmldb::storage::MemTable* table, const std::string& key, const int8_t* row, uint32_t size,
+                    std::string* output) {
+    uint64_t ts = 0;
+    if (!GetTs(row, &ts)) {
+        return false;
+    }
+    // the window of the request union, the rows expired by ttl are skipped like the window iterator of the table
+    std::shared_ptr<::openmldb::storage::IndexDef> index_def = table->GetIndex(index_name_);
+    if (!index_def || !index_def->IsReady() || index_def->GetTTLType() != ::openmldb::storage::TTLType::kAbsoluteTime) {
+        return false;
+    }
+    int64_t signed_ts = static_cast<int64_t>(ts);
+    uint64_t start_ts = signed_ts + start_offset_ < 0 ? 0 : signed_ts + start_offset_;
+    uint64_t end_ts = 0;
+    if (exclude_current_time_ && end_offset_ == 0) {
+        end_ts = ts == 0 ? 0 : ts - 1;
+    } else {
+        end_ts = signed_ts + end_offset_ < 0 ? 0 : signed_ts + end_offset_;
+    }
+    uint64_t expire_time = table->GetExpireTime(*index_def->GetTTL());
+    if (expire_time > 0) {
+        start_ts = std::max(start_ts, expire_time + 1);
+    }
+
+    std::vector<AggrValue> values(columns_.size());
+    uint32_t str_len = 0;
+    for (size_t i = 0; i < columns_.size(); i++) {
+        const auto& column = columns_[i];
+        if (column.request_col >= 0) {
+            auto type = request_schema_.Get(column.request_col).data_type();
+            if ((type == ::openmldb::type::kString || type == ::openmldb::type::kVarchar) &&
+                !request_view_->IsNULL(row, column.request_col)) {
+                char* ch = nullptr;
+                uint32_t len = 0;
+                if (request_view_->GetValue(row, column.request_col, &ch, &len) != 0) {
+                    return false;
+                }
+                str_len += len;
+            }
+            continue;
+        }
+        auto aggregator = table->FindAggregator(column.aggr_info);
+        if (!aggregator) {
+            return false;
+        }
+        ::openmldb::storage::AggrBuffer buffer;
+        // the request row is always in the window
+        aggregator->Aggregate(request_view_.get(), row, &buffer);
+        if (!aggregator->Query(key, start_ts, end_ts, &buffer)) {
+            return false;
+        }
+        auto& value = values[i];
+        value.is_int = aggregator->IsIntegerOutput();
+        value.is_null = !aggregator->GetValue(buffer, &value.int_value, &value.double_value);
+        if (value.is_null) {
+            SetEmptyValue(column, output_schema_.Get(i).data_type(), &value);
+        }
+    }
+
+    ::openmldb::codec::RowBuilder builder(output_schema_);
+    uint32_t total_size = builder.CalTotalLength(str_len);
+    output->assign(total_size, '\0');
+    builder.SetBuffer(reinterpret_cast<int8_t*>(&(*output)[0]), total_size);
+    for (size_t i = 0; i < columns_.size(); i++) {
+        bool ok = false;
+        if (columns_[i].request_col >= 0) {
+            ok = AppendRequestColumn(row, columns_[i].request_col, &builder);
+        } else if (values[i].is_null) {
+            ok = builder.AppendNULL();
+        } else {
+            ok = AppendAggregate(values[i], output_schema_.Get(i).data_type(), &builder);
+        }
+        if (!ok) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool AggrRoute::AppendRequestColumn(const int8_t* row, uint32_t col, ::openmldb::codec::RowBuilder* builder) {
+    if (request_view_->IsNULL(row, col)) {
+        return builder->AppendNULL();
+    }
+    auto type = request_schema_.Get(col).data_type();
+    switch (type) {
+        case ::openmldb::type::kBool: {
+            bool val = false;
+            return request_view_->GetValue(row, col, type, &val) == 0 && builder->AppendBool(val);
+        }
+        case ::openmldb::type::kSmallInt: {
+            int16_t val = 0;
+            return request_view_->GetValue(row, col, type, &val) == 0 && builder->AppendInt16(val);
+        }
+        case ::openmldb::type::kInt: {
+            int32_t val = 0;
+            return request_view_->GetValue(row, col, type, &val) == 0 && builder->AppendInt32(val);
+        }
+        case ::openmldb::type::kBigInt: {
+            int64_t val = 0;
+            return request_view_->GetValue(row, col, type, &val) == 0 && builder->AppendInt64(val);
+        }
+        case ::openmldb::type::kTimestamp: {
+            int64_t val = 0;
+            return request_view_->GetValue(row, col, type, &val) == 0 && builder->AppendTimestamp(val);
+        }
+        case ::openmldb::type::kFloat: {
+            float val = 0;
+            return request_view_->GetValue(row, col, type, &val) == 0 && builder->AppendFloat(val);
+        }
+        case ::openmldb::type::kDouble: {
+            double val = 0;
+            return request_view_->GetValue(row, col, type, &val) == 0 && builder->AppendDouble(val);
+        }
+        case ::openmldb::type::kDate: {
+            int32_t val = 0;
+            return request_view_->GetValue(row, col, type, &val) == 0 && builder->AppendDate(val);
+        }
+        case ::openmldb::type::kString:
+        case ::openmldb::type::kVarchar: {
+            char* ch = nullptr;
+            uint32_t len = 0;
+            return request_view_->GetValue(row, col, &ch, &len) == 0 && builder->AppendString(ch, len);
+        }
+        default:
+            return false;
+    }
+}
+
+void AggrRoute::SetEmptyValue(const Column& column, ::openmldb::type::DataType type, AggrValue* value) {
+    bool is_float = type == ::openmldb::type::kFloat || type == ::openmldb::type::kDouble;
+    value->is_null = false;
+    value->is_int = !is_float;
+    value->int_value = 0;
+    value->double_value = 0;
+    switch (column.aggr_type) {
+        case ::openmldb::storage::AggrType::kSum:
+        case ::openmldb::storage::AggrType::kCount:
+            break;
+        case ::openmldb::storage::AggrType::kAvg:
+            value->is_int = false;
+            value->double_value = std::numeric_limits<double>::quiet_NaN();
+            break;
+        case ::openmldb::storage::AggrType::kMin:
+        case ::openmldb::storage::AggrType::kMax: {
+            // min and max are null, min_where and max_where are the initial value of the type
+            if (!column.has_filter) {
+                value->is_null = true;
+                break;
+            }
+            bool is_min = column.aggr_type == ::openmldb::storage::AggrType::kMin;
+            switch (type) {
+                case ::openmldb::type::kFloat:
+                    value->double_value = is_min ? std::numeric_limits<float>::max()
+                                                 : std::numeric_limits<float>::lowest();
+                    break;
+                case ::openmldb::type::kDouble:
+                    value->double_value = is_min ? std::numeric_limits<double>::max()
+                                                 : std::numeric_limits<double>::lowest();
+                    break;
+                case ::openmldb::type::kSmallInt:
+                    value->int_value = is_min ? std::numeric_limits<int16_t>::max()
+                                              : std::numeric_limits<int16_t>::min();
+                    break;
+                case ::openmldb::type::kInt:
+                    value->int_value = is_min ? std::numeric_limits<int32_t>::max()
+                                              : std::numeric_limits<int32_t>::min();
+                    break;
+                case ::openmldb::type::kTimestamp:
+                    value->int_value = is_min ? std::numeric_limits<int64_t>::max() : 0;
+                    break;
+                default:
+                    value->int_value = is_min ? std::numeric_limits<int64_t>::max()
+                                              : std::numeric_limits<int64_t>::min();
+                    break;
+            }
+            break;
+        }
+    }
+}
+
+bool AggrRoute::AppendAggregate(const AggrValue& value, ::openmldb::type::DataType type,
+                                ::openmldb::codec::RowBuilder* builder) {
+    int64_t int_value = value.is_int ? value.int_value : static_cast<int64_t>(value.double_value);
+    double double_value = value.is_int ? static_cast<double>(value.int_value) : value.double_value;
+    switch (type) {
+        case ::openmldb::type::kSmallInt:
+            return builder->AppendInt16(static_cast<int16_t>(int_value));
+        case ::openmldb::type::kInt:
+            return builder->AppendInt32(static_cast<int32_t>(int_value));
+        case ::openmldb::type::kBigInt:
+            return builder->AppendInt64(int_value);
+        case ::openmldb::type::kTimestamp:
+            return builder->AppendTimestamp(int_value);
+        case ::openmldb::type::kFloat:
+            return builder->AppendFloat(static_cast<float>(double_value));
+        case ::openmldb::type::kDouble:
+            return builder->AppendDouble(double_value);
+        default:
+            return false;
+    }
+}
+
+}  // namespace tablet
+}  // namespace openmldb
@@ -0,0 +1,100 @@
+/*
+ * Copyright 2021 4Paradigm
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SRC_TABLET_AGGR_ROUTE_H_
+#define SRC_TABLET_AGGR_ROUTE_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "codec/codec.h"
+#include "proto/tablet.pb.h"
+#include "storage/mem_table.h"
+#include "vm/engine.h"
+
+namespace openmldb {
+namespace tablet {
+
+// AggrRoute serves a procedure in request mode from the pre-aggregates of its table. It's built from the request
+// plan of a procedure which selects only the request columns and the sum, count, min, max, avg or their _where
+// forms of one ROWS_RANGE window over an index of the table. The aggregate of the window is the query of the
+// aggregator over the window range plus the request row, so it doesn't scan the key's history
+class AggrRoute {
+ public:
+    // nullptr if the plan of info isn't in the supported form
+    static std::shared_ptr<AggrRoute> Build(const ::hybridse::vm::CompileInfo& info);
+
+    inline const std::string& GetDB() const { return db_; }
+    inline const std::string& GetTable() const { return table_; }
+
+    // the index key of the window of a request row, false if the row can't be served by the route
+    bool GetKey(const int8_t* row, uint32_t size, std::string* key);
+
+    // compute the output row from the aggregators of table which holds the partition of key. false if table
+    // has no aggregator for one of the columns or the row can't be served, then it should be run by the engine
+    bool Run(::openmldb::storage::MemTable* table, const std::string& key, const int8_t* row, uint32_t size,
+             std::string* output);
+
+ private:
+    struct Column {
+        // the position in the request row, or -1 for an aggregate
+        int32_t request_col = -1;
+        // the index name is set by the route
+        ::openmldb::api::AggregatorInfo aggr_info;
+        ::openmldb::storage::AggrType aggr_type = ::openmldb::storage::AggrType::kSum;
+        bool has_filter = false;
+    };
+
+    struct AggrValue {
+        bool is_null = true;
+        bool is_int = true;
+        int64_t int_value = 0;
+        double double_value = 0;
+    };
+
+    AggrRoute() = default;
+
+    bool GetTs(const int8_t* row, uint64_t* ts);
+
+    bool AppendRequestColumn(const int8_t* row, uint32_t col, ::openmldb::codec::RowBuilder* builder);
+
+    // the output of the udaf of the engine over a window without a value, which isn't always null
+    static void SetEmptyValue(const Column& column, ::openmldb::type::DataType type, AggrValue* value);
+
+    static bool AppendAggregate(const AggrValue& value, ::openmldb::type::DataType type,
+                                ::openmldb::codec::RowBuilder* builder);
+
+    std::string db_;
+    std::string table_;
+    std::string index_name_;
+    // the request columns of the index key in the order of the index
+    std::vector<uint32_t> key_cols_;
+    uint32_t ts_col_ = 0;
+    // the window is [ts + start_offset_, ts + end_offset_] of the request ts
+    int64_t start_offset_ = 0;
+    int64_t end_offset_ = 0;
+    bool exclude_current_time_ = false;
+    std::vector<Column> columns_;
+    ::openmldb::codec::Schema request_schema_;
+    ::openmldb::codec::Schema output_schema_;
+    // the offsets of the columns are independent of the row, the view of request_schema_ is shared by the requests
+    std::unique_ptr<::openmldb::codec::RowView> request_view_;
+};
+
+}  // namespace tablet
+}  // namespace openmldb
+#endif  // SRC_TABLET_AGGR_ROUTE_H_
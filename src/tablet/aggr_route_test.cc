@@ -0,0 +1,281 @@
+/*
+ * Copyright 2021 4Paradigm
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "tablet/aggr_route.h"
+
+#include <cmath>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "catalog/schema_adapter.h"
+#include "catalog/tablet_catalog.h"
+#include "codec/fe_row_codec.h"
+#include "codec/schema_codec.h"
+#include "gtest/gtest.h"
+#include "storage/mem_table.h"
+#include "vm/engine.h"
+
+namespace openmldb {
+namespace tablet {
+
+using ::openmldb::codec::SchemaCodec;
+
+static const uint64_t BASE_TS = 1589780888000l;
+static const uint64_t HOUR = 3600000;
+
+class AggrRouteTest : public ::testing::Test {
+ public:
+    AggrRouteTest() {}
+    ~AggrRouteTest() {}
+
+    void SetUp() override {
+        meta_.set_name("t1");
+        meta_.set_db("db1");
+        meta_.set_tid(1);
+        meta_.set_pid(0);
+        meta_.set_seg_cnt(8);
+        meta_.set_mode(::openmldb::api::TableMode::kTableLeader);
+        SchemaCodec::SetColumnDesc(meta_.add_column_desc(), "card", ::openmldb::type::kString);
+        SchemaCodec::SetColumnDesc(meta_.add_column_desc(), "amt", ::openmldb::type::kBigInt);
+        meta_.mutable_column_desc(1)->set_not_null(true);
+        SchemaCodec::SetColumnDesc(meta_.add_column_desc(), "price", ::openmldb::type::kDouble);
+        SchemaCodec::SetColumnDesc(meta_.add_column_desc(), "ok", ::openmldb::type::kBool);
+        SchemaCodec::SetColumnDesc(meta_.add_column_desc(), "ts", ::openmldb::type::kTimestamp);
+        SchemaCodec::SetIndex(meta_.add_column_key(), "card", "card", "ts", ::openmldb::type::kAbsoluteTime, 0, 0);
+        table_ = std::make_shared<::openmldb::storage::MemTable>(meta_);
+        ASSERT_TRUE(table_->Init());
+        catalog_ = std::make_shared<::openmldb::catalog::TabletCatalog>();
+        ASSERT_TRUE(catalog_->Init());
+        ASSERT_TRUE(catalog_->AddTable(meta_, table_));
+        engine_ = std::make_shared<::hybridse::vm::Engine>(catalog_);
+    }
+
+    // every 7th price is null to check the null values are skipped like the engine
+    std::string EncodeRow(const std::string& card, int64_t amt, bool null_price, bool ok, uint64_t ts) {
+        ::openmldb::codec::RowBuilder builder(meta_.column_desc());
+        std::string value;
+        value.resize(builder.CalTotalLength(card.size()));
+        builder.SetBuffer(reinterpret_cast<int8_t*>(&value[0]), value.size());
+        builder.AppendString(card.c_str(), card.size());
+        builder.AppendInt64(amt);
+        if (null_price) {
+            builder.AppendNULL();
+        } else {
+            builder.AppendDouble(amt * 0.5);
+        }
+        builder.AppendBool(ok);
+        builder.AppendTimestamp(ts);
+        return value;
+    }
+
+    void PutRows(int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            std::string card = "card" + std::to_string(i % 3);
+            uint64_t ts = BASE_TS + i * HOUR;
+            std::string value = EncodeRow(card, i, i % 7 == 0, i % 2 == 0, ts);
+            ASSERT_TRUE(table_->Put(card, ts, value.c_str(), value.size()));
+        }
+    }
+
+    void AddAggregator(const std::string& func, const std::string& col, const std::string& filter) {
+        ::openmldb::api::AggregatorInfo info;
+        info.set_aggr_func(func);
+        info.set_index_name("card");
+        info.set_aggr_col(col);
+        info.set_filter_col(filter);
+        info.set_bucket_size(24 * HOUR);
+        std::string msg;
+        ASSERT_TRUE(table_->AddAggregator(info, &msg)) << msg;
+    }
+
+    std::shared_ptr<AggrRoute> Build(const std::string& sql, ::hybridse::vm::RequestRunSession* session) {
+        ::hybridse::base::Status status;
+        if (!engine_->Get(sql, "db1", *session, status)) {
+            ADD_FAILURE() << status.msg;
+            return nullptr;
+        }
+        return AggrRoute::Build(*session->GetCompileInfo());
+    }
+
+    // the output of the route is the same as the engine
+    void CheckRequest(const std::shared_ptr<AggrRoute>& route, ::hybridse::vm::RequestRunSession* session,
+                      const std::string& request) {
+        ::hybridse::codec::Row row(request);
+        ::hybridse::codec::Row expect;
+        ASSERT_EQ(0, session->Run(row, &expect));
+        std::string key;
+        ASSERT_TRUE(route->GetKey(row.buf(), row.size(), &key));
+        std::string output;
+        ASSERT_TRUE(route->Run(table_.get(), key, row.buf(), row.size(), &output));
+
+        const auto& schema = session->GetSchema();
+        ::hybridse::codec::RowView expect_view(schema);
+        ::hybridse::codec::RowView view(schema);
+        ASSERT_TRUE(expect_view.Reset(expect.buf(), expect.size()));
+        ASSERT_TRUE(view.Reset(reinterpret_cast<const int8_t*>(output.data()), output.size()));
+        for (int i = 0; i < schema.size(); i++) {
+            ASSERT_EQ(expect_view.IsNULL(i), view.IsNULL(i)) << schema.Get(i).name();
+            if (expect_view.IsNULL(i)) {
+                continue;
+            }
+            switch (schema.Get(i).type()) {
+                case ::hybridse::type::kVarchar: {
+                    const char* expect_str = nullptr;
+                    const char* str = nullptr;
+                    uint32_t expect_len = 0;
+                    uint32_t len = 0;
+                    ASSERT_EQ(0, expect_view.GetString(i, &expect_str, &expect_len));
+                    ASSERT_EQ(0, view.GetString(i, &str, &len));
+                    ASSERT_EQ(std::string(expect_str, expect_len), std::string(str, len));
+                    break;
+                }
+                case ::hybridse::type::kInt64: {
+                    int64_t expect_val = 0;
+                    int64_t val = 0;
+                    ASSERT_EQ(0, expect_view.GetInt64(i, &expect_val));
+                    ASSERT_EQ(0, view.GetInt64(i, &val));
+                    ASSERT_EQ(expect_val, val) << schema.Get(i).name();
+                    break;
+                }
+                case ::hybridse::type::kTimestamp: {
+                    int64_t expect_val = 0;
+                    int64_t val = 0;
+                    ASSERT_EQ(0, expect_view.GetTimestamp(i, &expect_val));
+                    ASSERT_EQ(0, view.GetTimestamp(i, &val));
+                    ASSERT_EQ(expect_val, val) << schema.Get(i).name();
+                    break;
+                }
+                case ::hybridse::type::kDouble: {
+                    double expect_val = 0;
+                    double val = 0;
+                    ASSERT_EQ(0, expect_view.GetDouble(i, &expect_val));
+                    ASSERT_EQ(0, view.GetDouble(i, &val));
+                    if (std::isnan(expect_val)) {
+                        ASSERT_TRUE(std::isnan(val)) << schema.Get(i).name();
+                    } else {
+                        ASSERT_NEAR(expect_val, val, 1e-6) << schema.Get(i).name();
+                    }
+                    break;
+                }
+                default:
+                    FAIL() << "unexpected type of " << schema.Get(i).name();
+            }
+        }
+    }
+
+ protected:
+    ::openmldb::api::TableMeta meta_;
+    std::shared_ptr<::openmldb::storage::MemTable> table_;
+    std::shared_ptr<::openmldb::catalog::TabletCatalog> catalog_;
+    std::shared_ptr<::hybridse::vm::Engine> engine_;
+};
+
+TEST_F(AggrRouteTest, SameAsEngine) {
+    AddAggregator("sum", "amt", "");
+    AddAggregator("count", "*", "");
+    AddAggregator("max", "price", "");
+    AddAggregator("avg", "price", "");
+    AddAggregator("sum_where", "amt", "ok");
+    AddAggregator("count_where", "amt", "ok");
+    AddAggregator("min_where", "amt", "ok");
+    PutRows(0, 300);
+    std::string sql =
+        "select card, ts, sum(amt) over w as s, count(*) over w as c, max(price) over w as mx, "
+        "avg(price) over w as av, sum_where(amt, ok) over w as sw, count_where(amt, ok) over w as cw, "
+        "min_where(amt, ok) over w as mw from t1 "
+        "window w as (partition by card order by ts rows_range between 3d preceding and current row);";
+    ::hybridse::vm::RequestRunSession session;
+    auto route = Build(sql, &session);
+    ASSERT_TRUE(route);
+    ASSERT_EQ("db1", route->GetDB());
+    ASSERT_EQ("t1", route->GetTable());
+
+    // the windows cross the buckets, start in the middle of a bucket or are out of the rows
+    for (int i : {0, 5, 71, 72, 150, 299, 320, 500}) {
+        CheckRequest(route, &session, EncodeRow("card" + std::to_string(i % 3), i, false, i % 2 == 0,
+                                                BASE_TS + i * HOUR));
+    }
+    // an empty window of a new key, min_where and avg aren't null in the engine
+    CheckRequest(route, &session, EncodeRow("card9", 1, true, false, BASE_TS));
+    CheckRequest(route, &session, EncodeRow("", 1, true, true, BASE_TS));
+
+    // the rows put later are served by the aggregators at once
+    PutRows(300, 400);
+    CheckRequest(route, &session, EncodeRow("card1", 400, false, true, BASE_TS + 400 * HOUR));
+}
+
+TEST_F(AggrRouteTest, ExcludeCurrentTime) {
+    AddAggregator("sum", "amt", "");
+    PutRows(0, 100);
+    std::string sql =
+        "select card, sum(amt) over w as s from t1 "
+        "window w as (partition by card order by ts rows_range between 2d preceding and current row "
+        "EXCLUDE CURRENT_TIME);";
+    ::hybridse::vm::RequestRunSession session;
+    auto route = Build(sql, &session);
+    ASSERT_TRUE(route);
+    CheckRequest(route, &session, EncodeRow("card0", 60, false, true, BASE_TS + 60 * HOUR));
+    CheckRequest(route, &session, EncodeRow("card2", 61, false, true, BASE_TS + 200 * HOUR));
+}
+
+TEST_F(AggrRouteTest, FallBack) {
+    AddAggregator("sum", "amt", "");
+    PutRows(0, 10);
+    std::string window = " from t1 window w as (partition by card order by ts rows_range between 3d preceding and "
+                         "current row);";
+    {
+        // a rows window isn't served by the buckets of time
+        ::hybridse::vm::RequestRunSession session;
+        ASSERT_FALSE(Build("select card, sum(amt) over w as s from t1 window w as (partition by card order by ts "
+                           "rows between 10 preceding and current row);",
+                           &session));
+    }
+    {
+        ::hybridse::vm::RequestRunSession session;
+        ASSERT_FALSE(Build("select card, distinct_count(amt) over w as s" + window, &session));
+    }
+    {
+        ::hybridse::vm::RequestRunSession session;
+        ASSERT_FALSE(Build("select card, amt + 1 as a, sum(amt) over w as s" + window, &session));
+    }
+    {
+        // sum_where of the engine doesn't skip the null values
+        ::hybridse::vm::RequestRunSession session;
+        ASSERT_FALSE(Build("select card, sum_where(price, ok) over w as s" + window, &session));
+    }
+    {
+        // there isn't an aggregator of max(amt), the request is run by the engine
+        ::hybridse::vm::RequestRunSession session;
+        auto route = Build("select card, sum(amt) over w as s, max(amt) over w as m" + window, &session);
+        ASSERT_TRUE(route);
+        ::hybridse::codec::Row row(EncodeRow("card1", 1, false, true, BASE_TS + 10 * HOUR));
+        std::string key;
+        ASSERT_TRUE(route->GetKey(row.buf(), row.size(), &key));
+        ASSERT_EQ("card1", key);
+        std::string output;
+        ASSERT_FALSE(route->Run(table_.get(), key, row.buf(), row.size(), &output));
+    }
+}
+
+}  // namespace tablet
+}  // namespace openmldb
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    ::hybridse::vm::Engine::InitializeGlobalLLVM();
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,120 @@
+/*
+ * Copyright 2021 4Paradigm
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "tablet/request_cache.h"
+
+#include <iterator>
+#include <utility>
+
+#include "common/timer.h"
+
+namespace openmldb {
+namespace tablet {
+
+RequestCache::RequestCache(uint32_t capacity, uint64_t max_age_ms)
+    : capacity_(capacity),
+      max_age_ms_(max_age_ms),
+      mu_(),
+      lru_(),
+      entries_(),
+      versions_(),
+      hit_cnt_(0),
+      miss_cnt_(0) {}
+
+std::string RequestCache::GetKey(const std::string& db, const std::string& sp_name, const std::string& request) {
+    std::string key;
+    key.reserve(db.size() + sp_name.size() + request.size() + 2);
+    key.append(db).push_back('\0');
+    key.append(sp_name).push_back('\0');
+    key.append(request);
+    return key;
+}
+
+bool RequestCache::Get(const std::string& db, const std::string& sp_name, const std::string& request,
+                       std::string* output) {
+    std::string key = GetKey(db, sp_name, request);
+    uint64_t now = ::baidu::common::timer::get_micros() / 1000;
+    std::lock_guard<std::mutex> lock(mu_);
+    auto iter = entries_.find(key);
+    if (iter == entries_.end()) {
+        miss_cnt_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    auto it = iter->second;
+    if (now >= it->create_time + max_age_ms_ || !::openmldb::catalog::KeyReadRecorder::IsUnchanged(it->reads)) {
+        EraseUnlock(it);
+        miss_cnt_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    lru_.splice(lru_.begin(), lru_, it);
+    output->assign(it->output);
+    hit_cnt_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+uint64_t RequestCache::GetVersion(const std::string& db, const std::string& sp_name) {
+    std::string prefix = GetKey(db, sp_name, "");
+    std::lock_guard<std::mutex> lock(mu_);
+    auto it = versions_.find(prefix);
+    return it == versions_.end() ? 0 : it->second;
+}
+
+bool RequestCache::Put(const std::string& db, const std::string& sp_name, const std::string& request,
+                       const std::string& output, ::openmldb::catalog::KeyReadRecorder::KeyReads&& reads,
+                       uint64_t version) {
+    if (capacity_ == 0) {
+        return false;
+    }
+    std::string key = GetKey(db, sp_name, request);
+    std::string prefix = GetKey(db, sp_name, "");
+    uint64_t now = ::baidu::common::timer::get_micros() / 1000;
+    std::lock_guard<std::mutex> lock(mu_);
+    auto version_it = versions_.find(prefix);
+    if ((version_it == versions_.end() ? 0 : version_it->second) != version ||
+        !::openmldb::catalog::KeyReadRecorder::IsUnchanged(reads)) {
+        return false;
+    }
+    auto iter = entries_.find(key);
+    if (iter != entries_.end()) {
+        EraseUnlock(iter->second);
+    }
+    lru_.push_front(Entry{key, output, std::move(reads), now});
+    entries_.emplace(std::move(key), lru_.begin());
+    while (entries_.size() > capacity_) {
+        EraseUnlock(std::prev(lru_.end()));
+    }
+    return true;
+}
+
+void RequestCache::Drop(const std::string& db, const std::string& sp_name) {
+    std::string prefix = GetKey(db, sp_name, "");
+    std::lock_guard<std::mutex> lock(mu_);
+    versions_[prefix]++;
+    for (auto it = lru_.begin(); it != lru_.end();) {
+        auto cur = it++;
+        if (cur->key.compare(0, prefix.size(), prefix) == 0) {
+            EraseUnlock(cur);
+        }
+    }
+}
+
+void RequestCache::EraseUnlock(std::list<Entry>::iterator it) {
+    entries_.erase(it->key);
+    lru_.erase(it);
+}
+
+}  // namespace tablet
+}  // namespace openmldb
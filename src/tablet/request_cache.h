@@ -0,0 +1,84 @@
+/*
+ * Copyright 2021 4Paradigm
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SRC_TABLET_REQUEST_CACHE_H_
+#define SRC_TABLET_REQUEST_CACHE_H_
+
+#include <atomic>
+#include <list>
+#include <mutex>  // NOLINT
+#include <string>
+#include <unordered_map>
+
+#include "catalog/distribute_iterator.h"
+
+namespace openmldb {
+namespace tablet {
+
+// RequestCache keeps the output rows of the procedures run in request mode, which are looked up by the procedure and
+// the request row. An entry records the versions of the keys read to compute it and it's reused only if none of the
+// keys is written since, e.g. a retry or several callers scoring the same key at once. The number of entries is
+// bounded by LRU and an entry lives for max_age_ms at most, as the rows expired by ttl don't change the versions
+class RequestCache {
+ public:
+    RequestCache(uint32_t capacity, uint64_t max_age_ms);
+    RequestCache(const RequestCache&) = delete;
+    RequestCache& operator=(const RequestCache&) = delete;
+
+    // output is set to the cached output of the request, false if there is no valid one
+    bool Get(const std::string& db, const std::string& sp_name, const std::string& request, std::string* output);
+
+    // the version of the entries of a procedure, it's read before the compile info of the procedure is fetched
+    uint64_t GetVersion(const std::string& db, const std::string& sp_name);
+
+    // the output is not cached if the procedure is dropped since version is read or one of the keys is written
+    // since it's read, so a run racing with them doesn't leave a stale entry
+    bool Put(const std::string& db, const std::string& sp_name, const std::string& request, const std::string& output,
+             ::openmldb::catalog::KeyReadRecorder::KeyReads&& reads, uint64_t version);
+
+    // drop the entries of a procedure which is dropped or recompiled and bump its version
+    void Drop(const std::string& db, const std::string& sp_name);
+
+    inline uint64_t GetHitCnt() const { return hit_cnt_.load(std::memory_order_relaxed); }
+    inline uint64_t GetMissCnt() const { return miss_cnt_.load(std::memory_order_relaxed); }
+
+ private:
+    struct Entry {
+        std::string key;
+        std::string output;
+        ::openmldb::catalog::KeyReadRecorder::KeyReads reads;
+        uint64_t create_time;
+    };
+
+    static std::string GetKey(const std::string& db, const std::string& sp_name, const std::string& request);
+
+    void EraseUnlock(std::list<Entry>::iterator it);
+
+    uint32_t capacity_;
+    uint64_t max_age_ms_;
+    std::mutex mu_;
+    // the most recently used entry is at the front
+    std::list<Entry> lru_;
+    std::unordered_map<std::string, std::list<Entry>::iterator> entries_;
+    // the versions of the procedures which are dropped, keyed by the prefix of their entries
+    std::unordered_map<std::string, uint64_t> versions_;
+    std::atomic<uint64_t> hit_cnt_;
+    std::atomic<uint64_t> miss_cnt_;
+};
+
+}  // namespace tablet
+}  // namespace openmldb
+#endif  // SRC_TABLET_REQUEST_CACHE_H_
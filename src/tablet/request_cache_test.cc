@@ -0,0 +1,224 @@
+/*
+ * Copyright 2021 4Paradigm
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "tablet/request_cache.h"
+
+#include <memory>
+#include <string>
+#include <thread>  // NOLINT
+#include <utility>
+
+#include "base/glog_wapper.h"
+#include "codec/schema_codec.h"
+#include "gtest/gtest.h"
+#include "storage/mem_table.h"
+
+namespace openmldb {
+namespace tablet {
+
+using ::openmldb::catalog::DistributeWindowIterator;
+using ::openmldb::catalog::KeyReadRecorder;
+using ::openmldb::codec::SchemaCodec;
+
+class RequestCacheTest : public ::testing::Test {
+ public:
+    RequestCacheTest() {}
+    ~RequestCacheTest() {}
+};
+
+static std::shared_ptr<::openmldb::storage::MemTable> CreateTable() {
+    ::openmldb::api::TableMeta table_meta;
+    table_meta.set_name("t1");
+    table_meta.set_tid(1);
+    table_meta.set_pid(0);
+    table_meta.set_seg_cnt(8);
+    SchemaCodec::SetColumnDesc(table_meta.add_column_desc(), "card", ::openmldb::type::kString);
+    SchemaCodec::SetColumnDesc(table_meta.add_column_desc(), "ts1", ::openmldb::type::kBigInt);
+    SchemaCodec::SetIndex(table_meta.add_column_key(), "card", "card", "ts1", ::openmldb::type::kAbsoluteTime, 0, 0);
+    auto table = std::make_shared<::openmldb::storage::MemTable>(table_meta);
+    table->Init();
+    return table;
+}
+
+static void PutRow(::openmldb::storage::MemTable* table, const std::string& key, uint64_t ts) {
+    ::openmldb::api::PutRequest request;
+    auto dim = request.add_dimensions();
+    dim->set_idx(0);
+    dim->set_key(key);
+    auto ts_dim = request.add_ts_dimensions();
+    ts_dim->set_idx(0);
+    ts_dim->set_ts(ts);
+    ASSERT_TRUE(table->Put(request.dimensions(), request.ts_dimensions(), "value"));
+}
+
+// read the keys with the window iterator as a request does
+static bool ReadKeys(std::shared_ptr<::openmldb::catalog::Tables> tables, const std::vector<std::string>& keys,
+                     KeyReadRecorder::KeyReads* reads) {
+    KeyReadRecorder recorder;
+    KeyReadRecorder::Scope scope(&recorder);
+    DistributeWindowIterator iter(tables, 0);
+    for (const auto& key : keys) {
+        iter.Seek(key);
+    }
+    reads->swap(recorder.GetReads());
+    return recorder.IsTracked();
+}
+
+TEST_F(RequestCacheTest, KeyReadRecorder) {
+    auto table = CreateTable();
+    auto tables = std::make_shared<::openmldb::catalog::Tables>();
+    tables->emplace(0, table);
+    PutRow(table.get(), "card0", 1000);
+
+    KeyReadRecorder::KeyReads reads;
+    ASSERT_TRUE(ReadKeys(tables, {"card0", "card1", "card0"}, &reads));
+    ASSERT_EQ(2u, reads.size());
+    ASSERT_TRUE(KeyReadRecorder::IsUnchanged(reads));
+    // a new key is put into the empty window of card1
+    PutRow(table.get(), "card1", 1000);
+    ASSERT_FALSE(KeyReadRecorder::IsUnchanged(reads));
+
+    ASSERT_TRUE(ReadKeys(tables, {"card0"}, &reads));
+    ASSERT_TRUE(table->Delete("card0", 0));
+    ASSERT_FALSE(KeyReadRecorder::IsUnchanged(reads));
+
+    // a scan over the keys is not tracked
+    DistributeWindowIterator iter(tables, 0);
+    {
+        KeyReadRecorder recorder;
+        KeyReadRecorder::Scope scope(&recorder);
+        iter.SeekToFirst();
+        ASSERT_FALSE(recorder.IsTracked());
+    }
+
+    // nothing is recorded out of a scope, and a nested scope records into its own recorder
+    iter.Seek("card0");
+    ASSERT_TRUE(ReadKeys(tables, {}, &reads));
+    ASSERT_TRUE(reads.empty());
+    {
+        KeyReadRecorder outer;
+        KeyReadRecorder::Scope outer_scope(&outer);
+        ASSERT_TRUE(ReadKeys(tables, {"card0"}, &reads));
+        ASSERT_EQ(1u, reads.size());
+        iter.Seek("card1");
+        ASSERT_EQ(1u, outer.GetReads().size());
+        ASSERT_EQ("card1", outer.GetReads()[0].key);
+    }
+    // the recorder is bound to the thread running the request only
+    {
+        KeyReadRecorder recorder;
+        KeyReadRecorder::Scope scope(&recorder);
+        std::thread t([&tables]() {
+            DistributeWindowIterator other(tables, 0);
+            other.Seek("card0");
+            other.SeekToFirst();
+        });
+        t.join();
+        ASSERT_TRUE(recorder.IsTracked());
+        ASSERT_TRUE(recorder.GetReads().empty());
+    }
+
+    ASSERT_TRUE(ReadKeys(tables, {"card1"}, &reads));
+    tables->clear();
+    table.reset();
+    ASSERT_FALSE(KeyReadRecorder::IsUnchanged(reads));
+}
+
+TEST_F(RequestCacheTest, GetAndPut) {
+    auto table = CreateTable();
+    auto tables = std::make_shared<::openmldb::catalog::Tables>();
+    tables->emplace(0, table);
+    RequestCache cache(2, 60000);
+    std::string output;
+    ASSERT_FALSE(cache.Get("db", "sp", "row0", &output));
+
+    KeyReadRecorder::KeyReads reads;
+    ASSERT_TRUE(ReadKeys(tables, {"card0"}, &reads));
+    ASSERT_TRUE(cache.Put("db", "sp", "row0", "output0", std::move(reads), cache.GetVersion("db", "sp")));
+    ASSERT_TRUE(cache.Get("db", "sp", "row0", &output));
+    ASSERT_EQ("output0", output);
+    ASSERT_FALSE(cache.Get("db", "sp1", "row0", &output));
+    ASSERT_FALSE(cache.Get("db", "sp", "row1", &output));
+
+    // the entry is dropped once the key read is written
+    PutRow(table.get(), "card0", 1000);
+    ASSERT_FALSE(cache.Get("db", "sp", "row0", &output));
+
+    // the least recently used entry is evicted
+    for (const auto& request : {"row0", "row1", "row2"}) {
+        ASSERT_TRUE(ReadKeys(tables, {"card0"}, &reads));
+        ASSERT_TRUE(cache.Put("db", "sp", request, std::string("output") + request, std::move(reads),
+                              cache.GetVersion("db", "sp")));
+        if (std::string(request) == "row1") {
+            ASSERT_TRUE(cache.Get("db", "sp", "row0", &output));
+        }
+    }
+    ASSERT_TRUE(cache.Get("db", "sp", "row0", &output));
+    ASSERT_FALSE(cache.Get("db", "sp", "row1", &output));
+    ASSERT_TRUE(cache.Get("db", "sp", "row2", &output));
+    ASSERT_EQ("outputrow2", output);
+
+    cache.Drop("db", "sp");
+    ASSERT_FALSE(cache.Get("db", "sp", "row0", &output));
+    ASSERT_FALSE(cache.Get("db", "sp", "row2", &output));
+    ASSERT_EQ(4u, cache.GetHitCnt());
+}
+
+TEST_F(RequestCacheTest, StalePut) {
+    auto table = CreateTable();
+    auto tables = std::make_shared<::openmldb::catalog::Tables>();
+    tables->emplace(0, table);
+    RequestCache cache(10, 60000);
+    std::string output;
+
+    // the procedure is dropped while the output is computed
+    uint64_t version = cache.GetVersion("db", "sp");
+    KeyReadRecorder::KeyReads reads;
+    ASSERT_TRUE(ReadKeys(tables, {"card0"}, &reads));
+    cache.Drop("db", "sp");
+    ASSERT_FALSE(cache.Put("db", "sp", "row0", "output0", std::move(reads), version));
+    ASSERT_FALSE(cache.Get("db", "sp", "row0", &output));
+    // the drop of another procedure doesn't matter
+    version = cache.GetVersion("db", "sp");
+    ASSERT_TRUE(ReadKeys(tables, {"card0"}, &reads));
+    cache.Drop("db", "sp1");
+    ASSERT_TRUE(cache.Put("db", "sp", "row0", "output0", std::move(reads), version));
+    ASSERT_TRUE(cache.Get("db", "sp", "row0", &output));
+
+    // a key read is written while the output is computed
+    ASSERT_TRUE(ReadKeys(tables, {"card0", "card1"}, &reads));
+    PutRow(table.get(), "card1", 1000);
+    ASSERT_FALSE(cache.Put("db", "sp", "row1", "output1", std::move(reads), version));
+    ASSERT_FALSE(cache.Get("db", "sp", "row1", &output));
+    // the cached entry of row0 is kept as its key is not written
+    ASSERT_TRUE(cache.Get("db", "sp", "row0", &output));
+}
+
+TEST_F(RequestCacheTest, MaxAge) {
+    RequestCache cache(10, 0);
+    ASSERT_TRUE(cache.Put("db", "sp", "row0", "output0", KeyReadRecorder::KeyReads(), 0));
+    std::string output;
+    ASSERT_FALSE(cache.Get("db", "sp", "row0", &output));
+}
+
+}  // namespace tablet
+}  // namespace openmldb
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    ::openmldb::base::SetLogLevel(INFO);
+    return RUN_ALL_TESTS();
+}
@@ -40,6 +40,7 @@
 #include "base/file_util.h"
 #include "base/glog_wapper.h"
 #include "base/hash.h"
+#include "base/mem_pool.h"
 #include "base/status.h"
 #include "base/strings.h"
 #include "brpc/controller.h"
@@ -51,6 +52,7 @@
 #include "common/timer.h"
 #include "glog/logging.h"
 #include "storage/binlog.h"
+#include "storage/disk_table.h"
 #include "storage/segment.h"
 #include "tablet/file_sender.h"
 
@@ -67,6 +69,7 @@ DECLARE_uint32(scan_max_bytes_size);
 DECLARE_uint32(scan_reserve_size);
 DECLARE_double(mem_release_rate);
 DECLARE_string(db_root_path);
+DECLARE_uint32(cold_tier_age);
 DECLARE_bool(binlog_notify_on_put);
 DECLARE_int32(task_pool_size);
 DECLARE_int32(io_pool_size);
@@ -82,8 +85,12 @@ DECLARE_uint32(task_check_interval);
 DECLARE_uint32(load_index_max_wait_time);
 DECLARE_bool(use_name);
 DECLARE_bool(enable_distsql);
+DECLARE_uint32(request_cache_size);
+DECLARE_uint32(request_cache_max_age);
+DECLARE_string(jit_object_cache_path);
 DECLARE_string(snapshot_compression);
 DECLARE_string(file_compression);
+DECLARE_bool(enable_memtable_checkpoint);
 
 // cluster config
 DECLARE_string(endpoint);
@@ -102,6 +109,7 @@ DECLARE_uint32(snapshot_ttl_check_interval);
 DECLARE_uint32(put_slow_log_threshold);
 DECLARE_uint32(query_slow_log_threshold);
 DECLARE_int32(snapshot_pool_size);
+DECLARE_int32(procedure_compile_pool_size);
 
 namespace openmldb {
 namespace tablet {
@@ -120,6 +128,7 @@ TabletImpl::TabletImpl()
       task_pool_(FLAGS_task_pool_size),
       io_pool_(FLAGS_io_pool_size),
       snapshot_pool_(FLAGS_snapshot_pool_size),
+      sp_compile_pool_(std::max(FLAGS_procedure_compile_pool_size, 1)),
       server_(NULL),
       mode_root_paths_(),
       mode_recycle_root_paths_(),
@@ -130,9 +139,12 @@ TabletImpl::TabletImpl()
       zk_path_(),
       endpoint_(),
       sp_cache_(std::shared_ptr<SpCache>(new SpCache())),
+      request_cache_(),
       notify_path_() {}
 
 TabletImpl::~TabletImpl() {
+    // the queued compiles are dropped, they are useless once the tablet stops
+    sp_compile_pool_.Stop(false);
     task_pool_.Stop(true);
     keep_alive_pool_.Stop(true);
     gc_pool_.Stop(true);
@@ -149,9 +161,14 @@ bool TabletImpl::Init(const std::string& zk_cluster, const std::string& zk_path,
                       const std::string& real_endpoint) {
     ::hybridse::vm::EngineOptions options;
     options.set_cluster_optimized(FLAGS_enable_distsql);
+    options.jit_options().set_object_cache_path(FLAGS_jit_object_cache_path);
     engine_ = std::unique_ptr<::hybridse::vm::Engine>(new ::hybridse::vm::Engine(catalog_, options));
     catalog_->SetLocalTablet(
         std::shared_ptr<::hybridse::vm::Tablet>(new ::hybridse::vm::LocalTablet(engine_.get(), sp_cache_)));
+    // the reads of the partitions on other tablets can't be tracked with distsql
+    if (FLAGS_request_cache_size > 0 && !FLAGS_enable_distsql) {
+        request_cache_.reset(new RequestCache(FLAGS_request_cache_size, FLAGS_request_cache_max_age));
+    }
     std::set<std::string> snapshot_compression_set{"off", "zlib", "snappy"};
     if (snapshot_compression_set.find(FLAGS_snapshot_compression) == snapshot_compression_set.end()) {
         LOG(WARNING) << "wrong snapshot_compression: " << FLAGS_snapshot_compression;
@@ -178,6 +195,10 @@ bool TabletImpl::Init(const std::string& zk_cluster, const std::string& zk_path,
             PDLOG(WARNING, "fail to init zookeeper with cluster %s", zk_cluster.c_str());
             return false;
         }
+        std::string change_log_path = zk_path + "/table/notify_log";
+        table_node_cache_.reset(
+            new ::openmldb::zk::ZkNodeCache(zk_client_, zk_path + "/table/db_table_data", change_log_path));
+        sp_node_cache_.reset(new ::openmldb::zk::ZkNodeCache(zk_client_, sp_root_path_, change_log_path));
     } else {
         PDLOG(INFO, "zk cluster disabled");
     }
@@ -299,6 +320,60 @@ bool TabletImpl::RegisterZK() {
     return true;
 }
 
+// project a snappy compressed row, the output row is compressed too. row and buf are reused by the rows, out
+// refers to buf
+static bool ProjectCompressedRow(::openmldb::codec::RowProject* row_project, const ::openmldb::base::Slice& data,
+                                 std::string* row, std::string* buf, ::openmldb::base::Slice* out) {
+    size_t row_size = 0;
+    if (!::snappy::GetUncompressedLength(data.data(), data.size(), &row_size)) {
+        return false;
+    }
+    if (row->size() < row_size) {
+        row->resize(row_size);
+    }
+    if (!::snappy::RawUncompress(data.data(), data.size(), &(*row)[0])) {
+        return false;
+    }
+    const int8_t* row_ptr = reinterpret_cast<const int8_t*>(row->data());
+    uint32_t size = row_project->GetProjectSize(row_ptr, row_size);
+    if (size == 0) {
+        return false;
+    }
+    size_t max_size = size + ::snappy::MaxCompressedLength(size);
+    if (buf->size() < max_size) {
+        buf->resize(max_size);
+    }
+    if (!row_project->Project(row_ptr, row_size, reinterpret_cast<int8_t*>(&(*buf)[0]), size)) {
+        return false;
+    }
+    size_t compressed_size = 0;
+    ::snappy::RawCompress(buf->data(), size, &(*buf)[size], &compressed_size);
+    out->reset(buf->data() + size, compressed_size);
+    return true;
+}
+
+// project a row into value directly
+static bool ProjectValue(::openmldb::codec::RowProject* row_project, const ::openmldb::base::Slice& data,
+                         bool compressed, std::string* value) {
+    if (compressed) {
+        std::string row;
+        std::string buf;
+        ::openmldb::base::Slice out;
+        if (!ProjectCompressedRow(row_project, data, &row, &buf, &out)) {
+            return false;
+        }
+        value->assign(out.data(), out.size());
+        return true;
+    }
+    const int8_t* row_ptr = reinterpret_cast<const int8_t*>(data.data());
+    uint32_t size = row_project->GetProjectSize(row_ptr, data.size());
+    if (size == 0) {
+        return false;
+    }
+    value->resize(size);
+    return row_project->Project(row_ptr, data.size(), reinterpret_cast<int8_t*>(&(*value)[0]), size);
+}
+
 bool TabletImpl::CheckGetDone(::openmldb::api::GetType type, uint64_t ts, uint64_t target_ts) {
     switch (type) {
         case openmldb::api::GetType::kSubKeyEq:
@@ -354,11 +429,9 @@ int32_t TabletImpl::GetIndex(const ::openmldb::api::GetRequest* request, const :
         real_et_type = ::openmldb::api::GetType::kSubKeyGe;
     }
     bool enable_project = false;
+    bool compressed = meta.compress_type() == ::openmldb::type::kSnappy;
     openmldb::codec::RowProject row_project(vers_schema, request->projection());
     if (request->projection().size() > 0 && meta.format_version() == 1) {
-        if (meta.compress_type() == ::openmldb::type::kSnappy) {
-            return -1;
-        }
         bool ok = row_project.Init();
         if (!ok) {
             PDLOG(WARNING, "invalid project list");
@@ -379,17 +452,10 @@ int32_t TabletImpl::GetIndex(const ::openmldb::api::GetRequest* request, const :
         if (st_type == ::openmldb::api::GetType::kSubKeyGe || st_type == ::openmldb::api::GetType::kSubKeyGt) {
             ::openmldb::base::Slice it_value = it->GetValue();
             if (enable_project) {
-                int8_t* ptr = nullptr;
-                uint32_t size = 0;
-                openmldb::base::Slice data = it->GetValue();
-                const int8_t* row_ptr = reinterpret_cast<const int8_t*>(data.data());
-                bool ok = row_project.Project(row_ptr, data.size(), &ptr, &size);
-                if (!ok) {
+                if (!ProjectValue(&row_project, it_value, compressed, value)) {
                     PDLOG(WARNING, "fail to make a projection");
                     return -4;
                 }
-                value->assign(reinterpret_cast<char*>(ptr), size);
-                delete[] ptr;
             } else {
                 value->assign(it_value.data(), it_value.size());
             }
@@ -422,17 +488,10 @@ int32_t TabletImpl::GetIndex(const ::openmldb::api::GetRequest* request, const :
             return 1;
         }
         if (enable_project) {
-            int8_t* ptr = nullptr;
-            uint32_t size = 0;
-            openmldb::base::Slice data = it->GetValue();
-            const int8_t* row_ptr = reinterpret_cast<const int8_t*>(data.data());
-            bool ok = row_project.Project(row_ptr, data.size(), &ptr, &size);
-            if (!ok) {
+            if (!ProjectValue(&row_project, it->GetValue(), compressed, value)) {
                 PDLOG(WARNING, "fail to make a projection");
                 return -4;
             }
-            value->assign(reinterpret_cast<char*>(ptr), size);
-            delete[] ptr;
         } else {
             value->assign(it->GetValue().data(), it->GetValue().size());
         }
@@ -770,12 +829,9 @@ int32_t TabletImpl::ScanIndex(const ::openmldb::api::ScanRequest* request, const
     }
 
     bool enable_project = false;
+    bool compressed = meta.compress_type() == ::openmldb::type::kSnappy;
     ::openmldb::codec::RowProject row_project(vers_schema, request->projection());
     if (request->projection().size() > 0 && meta.format_version() == 1) {
-        if (meta.compress_type() == ::openmldb::type::kSnappy) {
-            LOG(WARNING) << "project on compress row data do not eing supported";
-            return -1;
-        }
         bool ok = row_project.Init();
         if (!ok) {
             PDLOG(WARNING, "invalid project list");
@@ -788,6 +844,10 @@ int32_t TabletImpl::ScanIndex(const ::openmldb::api::ScanRequest* request, const
     uint64_t last_time = 0;
     uint32_t total_block_size = 0;
     uint32_t record_count = 0;
+    std::string row_buf;
+    std::string project_buf;
+    // the projected rows are laid out in blocks owned by io_buf, all of them go by the arena to keep the order
+    ::openmldb::codec::IOBufArena project_arena(io_buf);
     combine_it->SeekToFirst();
     while (combine_it->Valid()) {
         if (limit > 0 && record_count >= limit) {
@@ -823,17 +883,29 @@ int32_t TabletImpl::ScanIndex(const ::openmldb::api::ScanRequest* request, const
             if (jump_out) break;
         }
         last_time = ts;
-        if (enable_project) {
-            int8_t* ptr = nullptr;
-            uint32_t size = 0;
+        if (enable_project && compressed) {
+            ::openmldb::base::Slice out;
+            if (!ProjectCompressedRow(&row_project, combine_it->GetValue(), &row_buf, &project_buf, &out)) {
+                PDLOG(WARNING, "fail to make a projection");
+                return -4;
+            }
+            memcpy(project_arena.Allocate(out.size()), out.data(), out.size());
+            total_block_size += out.size();
+        } else if (enable_project) {
+            // the row is projected while the iterator still holds it, right into the memory of io_buf
             openmldb::base::Slice data = combine_it->GetValue();
             const int8_t* row_ptr = reinterpret_cast<const int8_t*>(data.data());
-            bool ok = row_project.Project(row_ptr, data.size(), &ptr, &size);
-            if (!ok) {
+            uint32_t size = row_project.GetProjectSize(row_ptr, data.size());
+            if (size == 0) {
+                PDLOG(WARNING, "fail to make a projection");
+                return -4;
+            }
+            if (!row_project.Project(row_ptr, data.size(), project_arena.Allocate(size), size)) {
+                // the arena flushes the records allocated when it's destroyed, the unfilled one is dropped
+                project_arena.Discard(size);
                 PDLOG(WARNING, "fail to make a projection");
                 return -4;
             }
-            io_buf->append(reinterpret_cast<void*>(ptr), size);
             total_block_size += size;
         } else {
             openmldb::base::Slice data = combine_it->GetValue();
@@ -847,6 +919,7 @@ int32_t TabletImpl::ScanIndex(const ::openmldb::api::ScanRequest* request, const
         }
         combine_it->Next();
     }
+    project_arena.Flush();
     *count = record_count;
     return 0;
 }
@@ -878,12 +951,9 @@ int32_t TabletImpl::ScanIndex(const ::openmldb::api::ScanRequest* request, const
     }
 
     bool enable_project = false;
+    bool compressed = meta.compress_type() == ::openmldb::type::kSnappy;
     ::openmldb::codec::RowProject row_project(vers_schema, request->projection());
     if (request->projection().size() > 0 && meta.format_version() == 1) {
-        if (meta.compress_type() == ::openmldb::type::kSnappy) {
-            LOG(WARNING) << "project on compress row data do not eing supported";
-            return -1;
-        }
         bool ok = row_project.Init();
         if (!ok) {
             PDLOG(WARNING, "invalid project list");
@@ -896,6 +966,10 @@ int32_t TabletImpl::ScanIndex(const ::openmldb::api::ScanRequest* request, const
     uint64_t last_time = 0;
     boost::container::deque<std::pair<uint64_t, ::openmldb::base::Slice>> tmp;
     uint32_t total_block_size = 0;
+    // the projected rows are kept in the pool until they are encoded
+    ::hybridse::base::ByteMemoryPool project_pool;
+    std::string row_buf;
+    std::string project_buf;
     combine_it->SeekToFirst();
     while (combine_it->Valid()) {
         if (limit > 0 && tmp.size() >= limit) {
@@ -931,22 +1005,37 @@ int32_t TabletImpl::ScanIndex(const ::openmldb::api::ScanRequest* request, const
             if (jump_out) break;
         }
         last_time = ts;
-        if (enable_project) {
-            int8_t* ptr = nullptr;
-            uint32_t size = 0;
+        if (enable_project && compressed) {
+            ::openmldb::base::Slice out;
+            if (!ProjectCompressedRow(&row_project, combine_it->GetValue(), &row_buf, &project_buf, &out)) {
+                PDLOG(WARNING, "fail to make a projection");
+                return -4;
+            }
+            char* ptr = project_pool.Alloc(out.size());
+            memcpy(ptr, out.data(), out.size());
+            tmp.emplace_back(ts, Slice(ptr, out.size()));
+            total_block_size += out.size();
+        } else if (enable_project) {
+            // the row is projected while the iterator still holds it
             openmldb::base::Slice data = combine_it->GetValue();
             const int8_t* row_ptr = reinterpret_cast<const int8_t*>(data.data());
-            bool ok = row_project.Project(row_ptr, data.size(), &ptr, &size);
-            if (!ok) {
+            uint32_t size = row_project.GetProjectSize(row_ptr, data.size());
+            if (size == 0) {
+                PDLOG(WARNING, "fail to make a projection");
+                return -4;
+            }
+            char* ptr = project_pool.Alloc(size);
+            if (!row_project.Project(row_ptr, data.size(), reinterpret_cast<int8_t*>(ptr), size)) {
                 PDLOG(WARNING, "fail to make a projection");
                 return -4;
             }
-            tmp.emplace_back(ts, Slice(reinterpret_cast<char*>(ptr), size, true));
+            tmp.emplace_back(ts, Slice(ptr, size));
             total_block_size += size;
         } else {
+            // the value of a row in the disk tier owns its copy, it's moved into tmp to outlive the iterator
             openmldb::base::Slice data = combine_it->GetValue();
             total_block_size += data.size();
-            tmp.emplace_back(ts, data);
+            tmp.emplace_back(ts, std::move(data));
         }
         if (total_block_size > FLAGS_scan_max_bytes_size) {
             LOG(WARNING) << "reach the max byte size " << FLAGS_scan_max_bytes_size << " cur is " << total_block_size;
@@ -1358,8 +1447,8 @@ void TabletImpl::Traverse(RpcController* controller, const ::openmldb::api::Trav
             value_map[last_pk].reserve(request->limit());
         }
         openmldb::base::Slice value = it->GetValue();
-        value_map[last_pk].push_back(std::make_pair(it->GetKey(), value));
         total_block_size += last_pk.length() + value.size();
+        value_map[last_pk].push_back(std::make_pair(it->GetKey(), std::move(value)));
         scount++;
         if (it->GetCount() >= FLAGS_max_traverse_cnt) {
             DEBUGLOG("traverse cnt %lu max %lu, key %s ts %lu", it->GetCount(), FLAGS_max_traverse_cnt, last_pk.c_str(),
@@ -1562,6 +1651,8 @@ void TabletImpl::ProcessQuery(RpcController* ctrl, const openmldb::api::QueryReq
         if (request->is_procedure()) {
             const std::string& db_name = request->db();
             const std::string& sp_name = request->sp_name();
+            // read before the compile info, the output of a procedure dropped in the meantime is not cached
+            uint64_t cache_version = request_cache_ ? request_cache_->GetVersion(db_name, sp_name) : 0;
             std::shared_ptr<hybridse::vm::CompileInfo> request_compile_info;
             {
                 hybridse::base::Status status;
@@ -1575,7 +1666,7 @@ void TabletImpl::ProcessQuery(RpcController* ctrl, const openmldb::api::QueryReq
             }
             session.SetCompileInfo(request_compile_info);
             session.SetSpName(sp_name);
-            RunRequestQuery(ctrl, *request, session, *response, *buf);
+            RunRequestQuery(ctrl, *request, session, cache_version, *response, *buf);
         } else {
             bool ok = engine_->Get(request->sql(), request->db(), session, status);
             if (!ok || session.GetCompileInfo() == nullptr) {
@@ -1584,7 +1675,7 @@ void TabletImpl::ProcessQuery(RpcController* ctrl, const openmldb::api::QueryReq
                 DLOG(WARNING) << "fail to compile sql in request mode:\n" << request->sql();
                 return;
             }
-            RunRequestQuery(ctrl, *request, session, *response, *buf);
+            RunRequestQuery(ctrl, *request, session, 0, *response, *buf);
         }
         const std::string& sql = session.GetCompileInfo()->GetSql();
         if (response->code() != ::openmldb::base::kOk) {
@@ -2253,6 +2344,7 @@ void TabletImpl::MakeSnapshotInternal(uint32_t tid, uint32_t pid, uint64_t end_o
     uint64_t cur_offset = replicator->GetOffset();
     uint64_t snapshot_offset = snapshot->GetOffset();
     int ret = 0;
+    bool need_checkpoint = false;
     if (cur_offset < snapshot_offset + FLAGS_make_snapshot_threshold_offset && end_offset == 0) {
         PDLOG(INFO,
               "offset can't reach the threshold. tid[%u] pid[%u] "
@@ -2266,12 +2358,20 @@ void TabletImpl::MakeSnapshotInternal(uint32_t tid, uint32_t pid, uint64_t end_o
             if (replicator) {
                 replicator->SetSnapshotLogPartIndex(offset);
             }
+            need_checkpoint = FLAGS_enable_memtable_checkpoint;
         }
     }
     {
         std::lock_guard<SpinMutex> spin_lock(spin_mutex_);
         table->SetTableStat(::openmldb::storage::kNormal);
     }
+    if (need_checkpoint) {
+        // the table is dumped after the state is restored, puts are not blocked by the checkpoint
+        auto memtable_snapshot = std::static_pointer_cast<::openmldb::storage::MemTableSnapshot>(snapshot);
+        if (memtable_snapshot->MakeCheckpoint(table, [replicator]() { return replicator->GetOffset(); }) < 0) {
+            PDLOG(WARNING, "fail to make checkpoint. tid[%u] pid[%u]", tid, pid);
+        }
+    }
     {
         std::lock_guard<std::mutex> lock(mu_);
         if (task) {
@@ -2578,7 +2678,7 @@ void TabletImpl::SendSnapshotInternal(const std::string& endpoint, uint32_t tid,
         }
         full_path.append("snapshot/");
         std::string manifest_file = full_path + "MANIFEST";
-        std::string snapshot_file;
+        std::vector<std::pair<std::string, uint64_t>> snapshot_files;
         {
             int fd = open(manifest_file.c_str(), O_RDONLY);
             if (fd < 0) {
@@ -2593,11 +2693,18 @@ void TabletImpl::SendSnapshotInternal(const std::string& endpoint, uint32_t tid,
                 PDLOG(WARNING, "parse manifest failed. tid[%u] pid[%u]", tid, pid);
                 break;
             }
-            snapshot_file = manifest.name();
+            ::openmldb::storage::Snapshot::GetSnapshotFiles(manifest, &snapshot_files);
+        }
+        // send snapshot files
+        bool send_failed = false;
+        for (const auto& snapshot_file : snapshot_files) {
+            if (sender.SendFile(snapshot_file.first, full_path + snapshot_file.first) < 0) {
+                PDLOG(WARNING, "send snapshot %s failed. tid[%u] pid[%u]", snapshot_file.first.c_str(), tid, pid);
+                send_failed = true;
+                break;
+            }
         }
-        // send snapshot file
-        if (sender.SendFile(snapshot_file, full_path + snapshot_file) < 0) {
-            PDLOG(WARNING, "send snapshot failed. tid[%u] pid[%u]", tid, pid);
+        if (send_failed) {
             break;
         }
         // send manifest file
@@ -2826,8 +2933,9 @@ int TabletImpl::LoadTableInternal(uint32_t tid, uint32_t pid, std::shared_ptr<::
         }
         std::string binlog_path = db_root_path + "/" + std::to_string(tid) + "_" + std::to_string(pid) + "/binlog/";
         ::openmldb::storage::Binlog binlog(replicator->GetLogPart(), binlog_path);
+        auto memtable_snapshot = std::static_pointer_cast<::openmldb::storage::MemTableSnapshot>(snapshot);
         if (snapshot->Recover(table, snapshot_offset) &&
-            binlog.RecoverFromBinlog(table, snapshot_offset, latest_offset)) {
+            binlog.RecoverFromBinlog(table, snapshot_offset, latest_offset, memtable_snapshot->GetDedupEndOffset())) {
             table->SetTableStat(::openmldb::storage::kNormal);
             replicator->SetOffset(latest_offset);
             replicator->SetSnapshotLogPartIndex(snapshot->GetOffset());
@@ -3093,10 +3201,14 @@ int32_t TabletImpl::GetSnapshotOffset(uint32_t tid, uint32_t pid, std::string& m
         PDLOG(WARNING, "parse manifest failed");
         return 0;
     }
-    std::string snapshot_file = db_path + "/snapshot/" + manifest.name();
-    if (!::openmldb::base::IsExists(snapshot_file)) {
-        PDLOG(WARNING, "snapshot file[%s] is not exist", snapshot_file.c_str());
-        return 0;
+    std::vector<std::pair<std::string, uint64_t>> snapshot_files;
+    ::openmldb::storage::Snapshot::GetSnapshotFiles(manifest, &snapshot_files);
+    for (const auto& file : snapshot_files) {
+        std::string snapshot_file = db_path + "/snapshot/" + file.first;
+        if (!::openmldb::base::IsExists(snapshot_file)) {
+            PDLOG(WARNING, "snapshot file[%s] is not exist", snapshot_file.c_str());
+            return 0;
+        }
     }
     offset = manifest.offset();
     term = manifest.term();
@@ -3389,13 +3501,6 @@ int TabletImpl::CreateTableInternal(const ::openmldb::api::TableMeta* table_meta
         msg.assign("table exists");
         return -1;
     }
-    Table* table_ptr = new MemTable(*table_meta);
-    table.reset(table_ptr);
-    if (!table->Init()) {
-        PDLOG(WARNING, "fail to init table. tid %u, pid %u", table_meta->tid(), table_meta->pid());
-        msg.assign("fail to init table");
-        return -1;
-    }
     std::string db_root_path;
     bool ok = ChooseDBRootPath(tid, pid, db_root_path);
     if (!ok) {
@@ -3405,6 +3510,32 @@ int TabletImpl::CreateTableInternal(const ::openmldb::api::TableMeta* table_meta
     }
     std::string table_db_path =
         db_root_path + "/" + std::to_string(table_meta->tid()) + "_" + std::to_string(table_meta->pid());
+    bool is_disk = table_meta->storage_mode() == ::openmldb::type::StorageMode::kDisk;
+    if (is_disk) {
+        // the write buffers of a disk table are not logged, so its files are rebuilt from the snapshot and the
+        // binlog like a memtable, the files left by the last run would duplicate the recovered rows
+        std::string disk_path = table_db_path + "/disk";
+        if (::openmldb::base::IsExists(disk_path) && !::openmldb::base::RemoveDirRecursive(disk_path)) {
+            PDLOG(WARNING, "fail to remove the disk table path %s. tid %u, pid %u", disk_path.c_str(), tid, pid);
+            msg.assign("fail to remove the disk table path");
+            return -1;
+        }
+        table = std::make_shared<::openmldb::storage::DiskTable>(*table_meta, disk_path);
+    } else {
+        table = std::make_shared<MemTable>(*table_meta);
+    }
+    if (!table->Init()) {
+        PDLOG(WARNING, "fail to init table. tid %u, pid %u", table_meta->tid(), table_meta->pid());
+        msg.assign("fail to init table");
+        return -1;
+    }
+    if (FLAGS_cold_tier_age > 0 && !is_disk &&
+        !std::dynamic_pointer_cast<MemTable>(table)->InitColdTier(table_db_path + "/cold",
+                                                                  FLAGS_cold_tier_age * 60 * 1000ul)) {
+        PDLOG(WARNING, "fail to init cold tier. tid %u, pid %u", tid, pid);
+        msg.assign("fail to init cold tier");
+        return -1;
+    }
     std::shared_ptr<LogReplicator> replicator;
     if (table->IsLeader()) {
         replicator =
@@ -3766,57 +3897,48 @@ void TabletImpl::RefreshTableInfo() {
     } catch (const std::exception& e) {
         LOG(WARNING) << "value is not integer";
     }
-    std::string db_table_data_path = zk_path_ + "/table/db_table_data";
-    std::vector<std::string> table_datas;
-    if (zk_client_->IsExistNode(db_table_data_path) == 0) {
-        bool ok = zk_client_->GetChildren(db_table_data_path, table_datas);
-        if (!ok) {
-            LOG(WARNING) << "fail to get table list with path " << db_table_data_path;
-            return;
-        }
-    } else {
-        LOG(INFO) << "no tables in db";
+    std::lock_guard<std::mutex> lock(refresh_mu_);
+    // only the table and procedure nodes modified since last refresh are fetched and parsed
+    std::map<std::string, std::string> changed_tables;
+    std::vector<std::string> deleted_tables;
+    if (!table_node_cache_->Refresh(&changed_tables, &deleted_tables)) {
+        LOG(WARNING) << "fail to get table list with path " << table_node_cache_->GetRootPath();
+        return;
     }
-    std::vector<::openmldb::nameserver::TableInfo> table_info_vec;
-    for (const auto& node : table_datas) {
-        std::string value;
-        if (!zk_client_->GetNodeValue(db_table_data_path + "/" + node, value)) {
-            LOG(WARNING) << "fail to get table data. node: " << node;
-            continue;
-        }
+    for (const auto& node : deleted_tables) {
+        table_infos_.erase(node);
+    }
+    for (const auto& kv : changed_tables) {
         ::openmldb::nameserver::TableInfo table_info;
-        if (!table_info.ParseFromString(value)) {
-            LOG(WARNING) << "fail to parse table proto. node: " << node << " value: " << value;
+        if (!table_info.ParseFromString(kv.second)) {
+            LOG(WARNING) << "fail to parse table proto. node: " << kv.first << " value: " << kv.second;
+            table_infos_.erase(kv.first);
             continue;
         }
-        table_info_vec.push_back(std::move(table_info));
+        table_infos_[kv.first] = std::move(table_info);
+    }
+    std::vector<::openmldb::nameserver::TableInfo> table_info_vec;
+    table_info_vec.reserve(table_infos_.size());
+    for (const auto& kv : table_infos_) {
+        table_info_vec.push_back(kv.second);
     }
     // procedure part
-    std::vector<std::string> sp_datas;
-    if (zk_client_->IsExistNode(sp_root_path_) == 0) {
-        bool ok = zk_client_->GetChildren(sp_root_path_, sp_datas);
-        if (!ok) {
-            LOG(WARNING) << "fail to get procedure list with path " << sp_root_path_;
-            return;
-        }
-    } else {
-        DLOG(INFO) << "no procedures in db";
+    std::map<std::string, std::string> changed_sps;
+    std::vector<std::string> deleted_sps;
+    if (!sp_node_cache_->Refresh(&changed_sps, &deleted_sps)) {
+        LOG(WARNING) << "fail to get procedure list with path " << sp_root_path_;
+        return;
     }
-    openmldb::catalog::Procedures db_sp_map;
-    for (const auto& node : sp_datas) {
-        if (node.empty()) continue;
-        std::string value;
-        bool ok = zk_client_->GetNodeValue(sp_root_path_ + "/" + node, value);
-        if (!ok) {
-            LOG(WARNING) << "fail to get procedure data. node: " << node;
-            continue;
-        }
+    for (const auto& node : deleted_sps) {
+        sp_infos_.erase(node);
+    }
+    for (const auto& kv : changed_sps) {
+        sp_infos_.erase(kv.first);
         std::string uncompressed;
-        ::snappy::Uncompress(value.c_str(), value.length(), &uncompressed);
+        ::snappy::Uncompress(kv.second.c_str(), kv.second.length(), &uncompressed);
         ::openmldb::api::ProcedureInfo sp_info_pb;
-        ok = sp_info_pb.ParseFromString(uncompressed);
-        if (!ok) {
-            LOG(WARNING) << "fail to parse procedure proto. node: " << node << " value: " << value;
+        if (!sp_info_pb.ParseFromString(uncompressed)) {
+            LOG(WARNING) << "fail to parse procedure proto. node: " << kv.first << " value: " << kv.second;
             continue;
         }
         // conver to ProcedureInfoImpl
@@ -3826,38 +3948,27 @@ void TabletImpl::RefreshTableInfo() {
                          << " db: " << sp_info_pb.db_name();
             continue;
         }
-        auto it = db_sp_map.find(sp_info->GetDbName());
-        if (it == db_sp_map.end()) {
-            std::map<std::string, std::shared_ptr<hybridse::sdk::ProcedureInfo>> sp_in_db = {
-                {sp_info->GetSpName(), sp_info}};
-            db_sp_map.insert(std::make_pair(sp_info->GetDbName(), sp_in_db));
-        } else {
-            it->second.insert(std::make_pair(sp_info->GetSpName(), sp_info));
-        }
+        sp_infos_.emplace(kv.first, sp_info);
+    }
+    openmldb::catalog::Procedures db_sp_map;
+    for (const auto& kv : sp_infos_) {
+        db_sp_map[kv.second->GetDbName()].emplace(kv.second->GetSpName(), kv.second);
     }
     auto old_db_sp_map = catalog_->GetProcedures();
     catalog_->Refresh(table_info_vec, version, db_sp_map);
     // skip exist procedure, don`t need recompile
+    std::vector<std::shared_ptr<hybridse::sdk::ProcedureInfo>> new_sps;
     for (const auto& db_sp_map_kv : db_sp_map) {
-        const auto& db = db_sp_map_kv.first;
-        auto old_db_sp_map_it = old_db_sp_map.find(db);
-        if (old_db_sp_map_it != old_db_sp_map.end()) {
-            auto old_sp_map = old_db_sp_map_it->second;
-            for (const auto& sp_map_kv : db_sp_map_kv.second) {
-                const auto& sp_name = sp_map_kv.first;
-                auto old_sp_map_it = old_sp_map.find(sp_name);
-                if (old_sp_map_it != old_sp_map.end()) {
-                    continue;
-                } else {
-                    CreateProcedure(sp_map_kv.second);
-                }
-            }
-        } else {
-            for (const auto& sp_map_kv : db_sp_map_kv.second) {
-                CreateProcedure(sp_map_kv.second);
+        auto old_db_sp_map_it = old_db_sp_map.find(db_sp_map_kv.first);
+        for (const auto& sp_map_kv : db_sp_map_kv.second) {
+            if (old_db_sp_map_it != old_db_sp_map.end() &&
+                old_db_sp_map_it->second.find(sp_map_kv.first) != old_db_sp_map_it->second.end()) {
+                continue;
             }
+            new_sps.push_back(sp_map_kv.second);
         }
     }
+    CreateProcedures(new_sps);
 }
 
 int TabletImpl::CheckDimessionPut(const ::openmldb::api::PutRequest* request, uint32_t idx_cnt) {
@@ -4042,6 +4153,12 @@ void TabletImpl::DeleteIndex(RpcController* controller, const ::openmldb::api::D
         return;
     }
     MemTable* mem_table = dynamic_cast<MemTable*>(table.get());
+    if (mem_table == NULL) {
+        PDLOG(WARNING, "table is not memtable. tid %u, pid %u", tid, pid);
+        response->set_code(::openmldb::base::ReturnCode::kTableTypeMismatch);
+        response->set_msg("table is not memtable");
+        return;
+    }
     if (!mem_table->DeleteIndex(request->idx_name())) {
         response->set_code(::openmldb::base::ReturnCode::kDeleteIndexFailed);
         response->set_msg("delete index failed");
@@ -4055,6 +4172,96 @@ void TabletImpl::DeleteIndex(RpcController* controller, const ::openmldb::api::D
     response->set_msg("ok");
 }
 
+void TabletImpl::CreateAggregator(RpcController* controller, const ::openmldb::api::CreateAggregatorRequest* request,
+                                  ::openmldb::api::GeneralResponse* response, Closure* done) {
+    brpc::ClosureGuard done_guard(done);
+    uint32_t tid = request->tid();
+    uint32_t pid = request->pid();
+    std::shared_ptr<Table> table = GetTable(tid, pid);
+    if (!table) {
+        PDLOG(WARNING, "table is not exist. tid %u, pid %u", tid, pid);
+        response->set_code(::openmldb::base::ReturnCode::kTableIsNotExist);
+        response->set_msg("table is not exist");
+        return;
+    }
+    MemTable* mem_table = dynamic_cast<MemTable*>(table.get());
+    if (mem_table == NULL) {
+        PDLOG(WARNING, "table is not memtable. tid %u, pid %u", tid, pid);
+        response->set_code(::openmldb::base::ReturnCode::kTableTypeMismatch);
+        response->set_msg("table is not memtable");
+        return;
+    }
+    if (table->GetTableStat() != ::openmldb::storage::kNormal) {
+        PDLOG(WARNING, "table state is %d, cannot create aggregator. tid %u, pid %u", table->GetTableStat(), tid,
+              pid);
+        response->set_code(::openmldb::base::ReturnCode::kTableStatusIsNotKnormal);
+        response->set_msg("table status is not kNormal");
+        return;
+    }
+    std::string root_path;
+    if (!ChooseDBRootPath(tid, pid, root_path)) {
+        response->set_code(::openmldb::base::ReturnCode::kFailToGetDbRootPath);
+        response->set_msg("fail to get table db root path");
+        PDLOG(WARNING, "table db path is not found. tid %u, pid %u", tid, pid);
+        return;
+    }
+    std::string msg;
+    if (!mem_table->AddAggregator(request->aggregator(), &msg)) {
+        response->set_code(::openmldb::base::ReturnCode::kInvalidParameter);
+        response->set_msg(msg);
+        return;
+    }
+    // the aggregator is created again when the table is loaded, and filled by the recovery
+    std::string db_path = root_path + "/" + std::to_string(tid) + "_" + std::to_string(pid);
+    WriteTableMeta(db_path, table->GetTableMeta().get());
+    response->set_code(::openmldb::base::ReturnCode::kOk);
+    response->set_msg("ok");
+}
+
+void TabletImpl::QueryAggregate(RpcController* controller, const ::openmldb::api::QueryAggregateRequest* request,
+                                ::openmldb::api::QueryAggregateResponse* response, Closure* done) {
+    brpc::ClosureGuard done_guard(done);
+    std::shared_ptr<Table> table = GetTable(request->tid(), request->pid());
+    if (!table) {
+        PDLOG(WARNING, "table is not exist. tid %u, pid %u", request->tid(), request->pid());
+        response->set_code(::openmldb::base::ReturnCode::kTableIsNotExist);
+        response->set_msg("table is not exist");
+        return;
+    }
+    if (table->GetTableStat() == ::openmldb::storage::kLoading) {
+        response->set_code(::openmldb::base::ReturnCode::kTableIsLoading);
+        response->set_msg("table is loading");
+        return;
+    }
+    MemTable* mem_table = dynamic_cast<MemTable*>(table.get());
+    std::shared_ptr<::openmldb::storage::Aggregator> aggregator;
+    if (mem_table != NULL) {
+        aggregator = mem_table->GetAggregator(request->aggr_id());
+    }
+    if (!aggregator) {
+        response->set_code(::openmldb::base::ReturnCode::kInvalidParameter);
+        response->set_msg("aggregator is not found");
+        return;
+    }
+    ::openmldb::storage::AggrBuffer buffer;
+    if (!aggregator->Query(request->key(), request->st(), request->et(), &buffer)) {
+        response->set_code(::openmldb::base::ReturnCode::kQueryFailed);
+        response->set_msg("query failed");
+        return;
+    }
+    int64_t int_value = 0;
+    double double_value = 0;
+    if (!aggregator->GetValue(buffer, &int_value, &double_value)) {
+        response->set_is_null(true);
+    } else if (aggregator->IsIntegerOutput()) {
+        response->set_int_value(int_value);
+    } else {
+        response->set_double_value(double_value);
+    }
+    response->set_code(::openmldb::base::ReturnCode::kOk);
+    response->set_msg("ok");
+}
+
 void TabletImpl::SendIndexData(RpcController* controller, const ::openmldb::api::SendIndexDataRequest* request,
                                ::openmldb::api::GeneralResponse* response, Closure* done) {
     brpc::ClosureGuard done_guard(done);
@@ -4493,7 +4700,8 @@ void TabletImpl::ExtractIndexData(RpcController* controller, const ::openmldb::a
         std::shared_ptr<::openmldb::storage::MemTableSnapshot> memtable_snapshot =
             std::static_pointer_cast<::openmldb::storage::MemTableSnapshot>(snapshot);
         task_pool_.AddTask(boost::bind(&TabletImpl::ExtractIndexDataInternal, this, table, memtable_snapshot,
-                                       request->column_key(), request->idx(), request->partition_num(), task_ptr));
+                                       request->column_key(), request->idx(), request->partition_num(),
+                                       request->local_data(), task_ptr));
         response->set_code(::openmldb::base::ReturnCode::kOk);
         response->set_msg("ok");
         return;
@@ -4504,11 +4712,28 @@ void TabletImpl::ExtractIndexData(RpcController* controller, const ::openmldb::a
 void TabletImpl::ExtractIndexDataInternal(std::shared_ptr<::openmldb::storage::Table> table,
                                           std::shared_ptr<::openmldb::storage::MemTableSnapshot> memtable_snapshot,
                                           ::openmldb::common::ColumnKey& column_key, uint32_t idx,
-                                          uint32_t partition_num, std::shared_ptr<::openmldb::api::TaskInfo> task) {
+                                          uint32_t partition_num, bool local_data,
+                                          std::shared_ptr<::openmldb::api::TaskInfo> task) {
     uint64_t offset = 0;
     uint32_t tid = table->GetId();
     uint32_t pid = table->GetPid();
-    if (memtable_snapshot->ExtractIndexData(table, column_key, idx, partition_num, offset) < 0) {
+    bool load_memory = true;
+    if (local_data) {
+        auto mem_table = std::dynamic_pointer_cast<MemTable>(table);
+        uint64_t count = 0;
+        if (mem_table && mem_table->ExtractIndexFromMemory(column_key.index_name(), partition_num, &count)) {
+            PDLOG(INFO, "extract index %s from memory success. count %lu tid %u pid %u",
+                  column_key.index_name().c_str(), count, tid, pid);
+            load_memory = false;
+        }
+    }
+    int ret = memtable_snapshot->ExtractIndexData(table, column_key, idx, partition_num, offset, load_memory);
+    // the puts stop checking the new index for the extracted records
+    std::shared_ptr<::openmldb::storage::IndexDef> index_def = table->GetIndex(column_key.index_name());
+    if (index_def) {
+        index_def->SetExtracting(false);
+    }
+    if (ret < 0) {
         PDLOG(WARNING, "fail to extract index. tid %u pid %u", tid, pid);
         SetTaskStatus(task, ::openmldb::api::TaskStatus::kFailed);
         return;
@@ -4694,6 +4919,9 @@ void TabletImpl::CreateProcedure(RpcController* controller, const openmldb::api:
 
     sp_cache_->InsertSQLProcedureCacheEntry(db_name, sp_name, sp_info_impl, session.GetCompileInfo(),
                                             batch_session.GetCompileInfo());
+    if (request_cache_) {
+        request_cache_->Drop(db_name, sp_name);
+    }
 
     response->set_code(::openmldb::base::ReturnCode::kOk);
     response->set_msg("ok");
@@ -4705,18 +4933,22 @@ void TabletImpl::DropProcedure(RpcController* controller, const ::openmldb::api:
     brpc::ClosureGuard done_guard(done);
     const std::string& db_name = request->db_name();
     const std::string& sp_name = request->sp_name();
-    sp_cache_->DropSQLProcedureCacheEntry(db_name, sp_name);
+    // drop from the catalog first, the background compilation checks it before inserting into sp_cache_
     if (!catalog_->DropProcedure(db_name, sp_name)) {
         LOG(WARNING) << "drop procedure" << db_name << "." << sp_name << " in catalog failed";
     }
+    sp_cache_->DropSQLProcedureCacheEntry(db_name, sp_name);
+    if (request_cache_) {
+        request_cache_->Drop(db_name, sp_name);
+    }
     response->set_code(::openmldb::base::ReturnCode::kOk);
     response->set_msg("ok");
     PDLOG(INFO, "drop procedure success. db_name[%s] sp_name[%s]", db_name.c_str(), sp_name.c_str());
 }
 
 void TabletImpl::RunRequestQuery(RpcController* ctrl, const openmldb::api::QueryRequest& request,
-                                 ::hybridse::vm::RequestRunSession& session, openmldb::api::QueryResponse& response,
-                                 butil::IOBuf& buf) {
+                                 ::hybridse::vm::RequestRunSession& session, uint64_t cache_version,
+                                 openmldb::api::QueryResponse& response, butil::IOBuf& buf) {
     if (request.is_debug()) {
         session.EnableDebug();
     }
@@ -4728,10 +4960,37 @@ void TabletImpl::RunRequestQuery(RpcController* ctrl, const openmldb::api::Query
         response.set_msg("fail to decode input row");
         return;
     }
+    // the output of a procedure is cached by the request row
+    bool use_cache = request_cache_ && request.is_procedure() && !request.has_task_id() && row.GetRowPtrCnt() == 1;
+    std::string request_row;
+    std::string cached_output;
+    if (use_cache) {
+        request_row.assign(reinterpret_cast<const char*>(row.buf()), row.size());
+    }
+    std::shared_ptr<AggrRoute> aggr_route;
+    if (request.is_procedure() && !request.has_task_id()) {
+        aggr_route = sp_cache_->GetAggrRoute(request.db(), request.sp_name());
+    }
     ::hybridse::codec::Row output;
     int32_t ret = 0;
-    if (request.has_task_id()) {
+    if (use_cache && request_cache_->Get(request.db(), request.sp_name(), request_row, &cached_output)) {
+        output = ::hybridse::codec::Row(cached_output);
+    } else if (request.has_task_id()) {
         ret = session.Run(request.task_id(), row, &output);
+    } else if (aggr_route && RunAggrRoute(aggr_route.get(), row, &output)) {
+        DLOG(INFO) << "run procedure " << request.sp_name() << " with the aggregators";
+    } else if (use_cache) {
+        // the keys read by the run are recorded by the recorder of this request
+        ::openmldb::catalog::KeyReadRecorder recorder;
+        {
+            ::openmldb::catalog::KeyReadRecorder::Scope scope(&recorder);
+            ret = session.Run(row, &output);
+        }
+        if (ret == 0 && recorder.IsTracked() && output.GetRowPtrCnt() == 1) {
+            request_cache_->Put(request.db(), request.sp_name(), request_row,
+                                std::string(reinterpret_cast<const char*>(output.buf()), output.size()),
+                                std::move(recorder.GetReads()), cache_version);
+        }
     } else {
         ret = session.Run(row, &output);
     }
@@ -4759,7 +5018,38 @@ void TabletImpl::RunRequestQuery(RpcController* ctrl, const openmldb::api::Query
     response.set_code(::openmldb::base::kOk);
 }
 
-void TabletImpl::CreateProcedure(const std::shared_ptr<hybridse::sdk::ProcedureInfo>& sp_info) {
+bool TabletImpl::RunAggrRoute(AggrRoute* route, const ::hybridse::codec::Row& row, ::hybridse::codec::Row* output) {
+    if (row.GetRowPtrCnt() != 1) {
+        return false;
+    }
+    std::string key;
+    if (!route->GetKey(row.buf(), row.size(), &key)) {
+        return false;
+    }
+    // only the partition of the key on this tablet is read, the others are run by the engine
+    auto handler = std::dynamic_pointer_cast<::openmldb::catalog::TabletTableHandler>(
+        catalog_->GetTable(route->GetDB(), route->GetTable()));
+    if (!handler || handler->GetPartitionNum() == 0) {
+        return false;
+    }
+    uint32_t pid = static_cast<uint32_t>(::openmldb::base::hash64(key) % handler->GetPartitionNum());
+    std::shared_ptr<Table> table = GetTable(handler->GetTid(), pid);
+    if (!table || table->GetTableStat() == ::openmldb::storage::kLoading) {
+        return false;
+    }
+    MemTable* mem_table = dynamic_cast<MemTable*>(table.get());
+    if (mem_table == NULL) {
+        return false;
+    }
+    std::string buf;
+    if (!route->Run(mem_table, key, row.buf(), row.size(), &buf)) {
+        return false;
+    }
+    *output = ::hybridse::codec::Row(buf);
+    return true;
+}
+
+void TabletImpl::CreateProcedure(const std::shared_ptr<hybridse::sdk::ProcedureInfo>& sp_info, uint64_t drop_seq) {
     const std::string& db_name = sp_info->GetDbName();
     const std::string& sp_name = sp_info->GetSpName();
     const std::string& sql = sp_info->GetSql();
@@ -4784,11 +5074,43 @@ void TabletImpl::CreateProcedure(const std::shared_ptr<hybridse::sdk::ProcedureI
         LOG(WARNING) << "fail to compile batch request for sql " << sql;
         return;
     }
-    sp_cache_->InsertSQLProcedureCacheEntry(db_name, sp_name, sp_info, session.GetCompileInfo(),
-                                            batch_session.GetCompileInfo());
+    // the procedure may be dropped while compiling. check the catalog without holding the cache lock, a drop after
+    // the check is recorded with a newer sequence and the insertion is rejected
+    auto info = catalog_->GetProcedureInfo(db_name, sp_name);
+    if (!info || info->GetSql() != sql ||
+        !sp_cache_->InsertSQLProcedureCacheEntry(db_name, sp_name, sp_info, session.GetCompileInfo(),
+                                                 batch_session.GetCompileInfo(), drop_seq)) {
+        LOG(INFO) << "procedure " << sp_name << " in db " << db_name << " is dropped while compiling";
+        return;
+    }
+    if (request_cache_) {
+        request_cache_->Drop(db_name, sp_name);
+    }
     LOG(INFO) << "refresh procedure success! sp_name: " << sp_name << ", db: " << db_name << ", sql: " << sql;
 }
 
+void TabletImpl::CreateProcedures(const std::vector<std::shared_ptr<hybridse::sdk::ProcedureInfo>>& sp_infos) {
+    if (sp_infos.empty()) {
+        return;
+    }
+    uint32_t total = sp_infos.size();
+    auto compiled = std::make_shared<std::atomic<uint32_t>>(0);
+    uint64_t start_time = ::baidu::common::timer::get_micros();
+    LOG(INFO) << "start to compile " << total << " procedures";
+    for (const auto& sp_info : sp_infos) {
+        uint64_t drop_seq = sp_cache_->StartCompile();
+        sp_compile_pool_.AddTask([this, sp_info, drop_seq, compiled, total, start_time]() {
+            CreateProcedure(sp_info, drop_seq);
+            sp_cache_->FinishCompile();
+            uint32_t cnt = compiled->fetch_add(1, std::memory_order_relaxed) + 1;
+            if (cnt == total || cnt % 100 == 0) {
+                LOG(INFO) << "compiled " << cnt << "/" << total << " procedures, cost "
+                          << (::baidu::common::timer::get_micros() - start_time) / 1000 << " ms";
+            }
+        });
+    }
+}
+
 void TabletImpl::GetBulkLoadInfo(RpcController* controller, const ::openmldb::api::BulkLoadInfoRequest* request,
                                  ::openmldb::api::BulkLoadInfoResponse* response, Closure* done) {
     brpc::ClosureGuard done_guard(done);
@@ -4822,6 +5144,11 @@ void TabletImpl::GetBulkLoadInfo(RpcController* controller, const ::openmldb::ap
     //  TableIndex is inside Table, so let table fulfill the response for us.
     DLOG(INFO) << "GetBulkLoadInfo for " << table->GetId() << "-" << table->GetPid();
     auto* mem_table = dynamic_cast<MemTable*>(table.get());
+    if (mem_table == nullptr) {
+        response->set_code(::openmldb::base::ReturnCode::kTableTypeMismatch);
+        response->set_msg("table is not memtable");
+        return;
+    }
     mem_table->GetBulkLoadInfo(response);
 
     response->set_code(::openmldb::base::kOk);
@@ -4855,6 +5182,11 @@ void TabletImpl::BulkLoad(RpcController* controller, const ::openmldb::api::Bulk
         response->set_msg("table is follower");
         return;
     }
+    if (std::dynamic_pointer_cast<MemTable>(table) == nullptr) {
+        response->set_code(::openmldb::base::ReturnCode::kTableTypeMismatch);
+        response->set_msg("table is not memtable");
+        return;
+    }
     if (table->GetTableStat() == ::openmldb::storage::kLoading) {
         PDLOG(WARNING, "table %u-%u is loading.", request->tid(), request->pid());
         response->set_code(::openmldb::base::ReturnCode::kTableIsLoading);
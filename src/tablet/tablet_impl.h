@@ -37,11 +37,14 @@
 #include "replica/log_replicator.h"
 #include "storage/mem_table.h"
 #include "storage/mem_table_snapshot.h"
+#include "tablet/aggr_route.h"
 #include "tablet/bulk_load_mgr.h"
 #include "tablet/combine_iterator.h"
 #include "tablet/file_receiver.h"
+#include "tablet/request_cache.h"
 #include "vm/engine.h"
 #include "zk/zk_client.h"
+#include "zk/zk_node_cache.h"
 
 using ::baidu::common::ThreadPool;
 using ::google::protobuf::Closure;
@@ -70,36 +73,105 @@ struct SQLProcedureCacheEntry {
     std::shared_ptr<hybridse::sdk::ProcedureInfo> procedure_info;
     std::shared_ptr<hybridse::vm::CompileInfo> request_info;
     std::shared_ptr<hybridse::vm::CompileInfo> batch_request_info;
+    // set if the request mode plan can be served by the aggregators of the table
+    std::shared_ptr<AggrRoute> aggr_route;
 
     SQLProcedureCacheEntry(const std::shared_ptr<hybridse::sdk::ProcedureInfo> pinfo,
                            std::shared_ptr<hybridse::vm::CompileInfo> rinfo,
                            std::shared_ptr<hybridse::vm::CompileInfo> brinfo)
-        : procedure_info(pinfo), request_info(rinfo), batch_request_info(brinfo) {}
+        : procedure_info(pinfo),
+          request_info(rinfo),
+          batch_request_info(brinfo),
+          aggr_route(rinfo ? AggrRoute::Build(*rinfo) : nullptr) {}
 };
 class SpCache : public hybridse::vm::CompileInfoCache {
  public:
-    SpCache() : db_sp_map_() {}
+    SpCache() : db_sp_map_(), drop_seq_map_(), drop_seq_(0), compiling_cnt_(0) {}
     ~SpCache() {}
     void InsertSQLProcedureCacheEntry(const std::string& db, const std::string& sp_name,
                                       std::shared_ptr<hybridse::sdk::ProcedureInfo> procedure_info,
                                       std::shared_ptr<hybridse::vm::CompileInfo> request_info,
                                       std::shared_ptr<hybridse::vm::CompileInfo> batch_request_info) {
+        SQLProcedureCacheEntry entry(procedure_info, request_info, batch_request_info);
         std::lock_guard<SpinMutex> spin_lock(spin_mutex_);
         auto& sp_map_of_db = db_sp_map_[db];
-        sp_map_of_db.insert(
-            std::make_pair(sp_name, SQLProcedureCacheEntry(procedure_info, request_info, batch_request_info)));
+        sp_map_of_db.insert(std::make_pair(sp_name, std::move(entry)));
+        // the procedure is created again, the compilations before can not insert a stale one
+        EraseDropSeqUnlock(db, sp_name);
+    }
+
+    // insert the entry only if the procedure is not dropped since `drop_seq` is returned by StartCompile, so a
+    // procedure dropped while it was compiling is not inserted after its drop
+    bool InsertSQLProcedureCacheEntry(const std::string& db, const std::string& sp_name,
+                                      std::shared_ptr<hybridse::sdk::ProcedureInfo> procedure_info,
+                                      std::shared_ptr<hybridse::vm::CompileInfo> request_info,
+                                      std::shared_ptr<hybridse::vm::CompileInfo> batch_request_info,
+                                      uint64_t drop_seq) {
+        SQLProcedureCacheEntry entry(procedure_info, request_info, batch_request_info);
+        std::lock_guard<SpinMutex> spin_lock(spin_mutex_);
+        if (GetDropSeqUnlock(db, sp_name) > drop_seq) {
+            return false;
+        }
+        auto& sp_map_of_db = db_sp_map_[db];
+        sp_map_of_db.insert(std::make_pair(sp_name, std::move(entry)));
+        EraseDropSeqUnlock(db, sp_name);
+        return true;
     }
 
     void DropSQLProcedureCacheEntry(const std::string& db, const std::string& sp_name) {
         std::lock_guard<SpinMutex> spin_lock(spin_mutex_);
-        db_sp_map_[db].erase(sp_name);
+        auto db_it = db_sp_map_.find(db);
+        if (db_it != db_sp_map_.end()) {
+            db_it->second.erase(sp_name);
+            if (db_it->second.empty()) {
+                db_sp_map_.erase(db_it);
+            }
+        }
+        drop_seq_++;
+        // only the compilations in flight check the drops
+        if (compiling_cnt_ > 0) {
+            drop_seq_map_[db][sp_name] = drop_seq_;
+        }
         return;
     }
+    // start a compilation of procedures, it returns the sequence of the last drop to insert the compiled ones.
+    // FinishCompile must be called once the compilation is done
+    uint64_t StartCompile() {
+        std::lock_guard<SpinMutex> spin_lock(spin_mutex_);
+        compiling_cnt_++;
+        return drop_seq_;
+    }
+    void FinishCompile() {
+        std::lock_guard<SpinMutex> spin_lock(spin_mutex_);
+        if (--compiling_cnt_ == 0) {
+            drop_seq_map_.clear();
+        }
+    }
+    // the procedures whose drops are kept, used for ut
+    size_t GetDropSeqCnt() {
+        std::lock_guard<SpinMutex> spin_lock(spin_mutex_);
+        size_t cnt = 0;
+        for (const auto& kv : drop_seq_map_) {
+            cnt += kv.second.size();
+        }
+        return cnt;
+    }
     const bool ProcedureExist(const std::string& db, const std::string& sp_name) {
         std::lock_guard<SpinMutex> spin_lock(spin_mutex_);
-        auto& sp_map_of_db = db_sp_map_[db];
-        auto sp_it = sp_map_of_db.find(sp_name);
-        return sp_it != sp_map_of_db.end();
+        auto db_it = db_sp_map_.find(db);
+        return db_it != db_sp_map_.end() && db_it->second.find(sp_name) != db_it->second.end();
+    }
+    std::shared_ptr<AggrRoute> GetAggrRoute(const std::string& db, const std::string& sp_name) {
+        std::lock_guard<SpinMutex> spin_lock(spin_mutex_);
+        auto db_it = db_sp_map_.find(db);
+        if (db_it == db_sp_map_.end()) {
+            return std::shared_ptr<AggrRoute>();
+        }
+        auto sp_it = db_it->second.find(sp_name);
+        if (sp_it == db_it->second.end()) {
+            return std::shared_ptr<AggrRoute>();
+        }
+        return sp_it->second.aggr_route;
     }
     std::shared_ptr<hybridse::vm::CompileInfo> GetRequestInfo(const std::string& db, const std::string& sp_name,
                                                               hybridse::base::Status& status) override {  // NOLINT
@@ -148,10 +220,39 @@ class SpCache : public hybridse::vm::CompileInfoCache {
     }
 
  private:
+    uint64_t GetDropSeqUnlock(const std::string& db, const std::string& sp_name) const {
+        auto db_it = drop_seq_map_.find(db);
+        if (db_it == drop_seq_map_.end()) {
+            return 0;
+        }
+        auto sp_it = db_it->second.find(sp_name);
+        return sp_it == db_it->second.end() ? 0 : sp_it->second;
+    }
+    void EraseDropSeqUnlock(const std::string& db, const std::string& sp_name) {
+        auto db_it = drop_seq_map_.find(db);
+        if (db_it == drop_seq_map_.end()) {
+            return;
+        }
+        db_it->second.erase(sp_name);
+        if (db_it->second.empty()) {
+            drop_seq_map_.erase(db_it);
+        }
+    }
+
     std::map<std::string, std::map<std::string, SQLProcedureCacheEntry>> db_sp_map_;
+    // the sequence of the last drop of the procedures dropped while some compilations are in flight. The sequence
+    // is global, so an entry erased on the recreation can't be confused with a later drop
+    std::map<std::string, std::map<std::string, uint64_t>> drop_seq_map_;
+    uint64_t drop_seq_;
+    uint32_t compiling_cnt_;
     SpinMutex spin_mutex_;
 };
+class TabletImplTest;
+
 class TabletImpl : public ::openmldb::api::TabletServer {
+    // used for ut
+    friend class TabletImplTest;
+
  public:
     TabletImpl();
 
@@ -281,6 +382,12 @@ class TabletImpl : public ::openmldb::api::TabletServer {
     void DeleteIndex(RpcController* controller, const ::openmldb::api::DeleteIndexRequest* request,
                      ::openmldb::api::GeneralResponse* response, Closure* done);
 
+    void CreateAggregator(RpcController* controller, const ::openmldb::api::CreateAggregatorRequest* request,
+                          ::openmldb::api::GeneralResponse* response, Closure* done);
+
+    void QueryAggregate(RpcController* controller, const ::openmldb::api::QueryAggregateRequest* request,
+                        ::openmldb::api::QueryAggregateResponse* response, Closure* done);
+
     void DumpIndexData(RpcController* controller, const ::openmldb::api::DumpIndexDataRequest* request,
                        ::openmldb::api::GeneralResponse* response, Closure* done);
 
@@ -391,7 +498,8 @@ class TabletImpl : public ::openmldb::api::TabletServer {
     void ExtractIndexDataInternal(std::shared_ptr<::openmldb::storage::Table> table,
                                   std::shared_ptr<::openmldb::storage::MemTableSnapshot> memtable_snapshot,
                                   ::openmldb::common::ColumnKey& column_key, uint32_t idx,  // NOLINT
-                                  uint32_t partition_num, std::shared_ptr<::openmldb::api::TaskInfo> task);
+                                  uint32_t partition_num, bool local_data,
+                                  std::shared_ptr<::openmldb::api::TaskInfo> task);
 
     void SchedMakeSnapshot();
 
@@ -467,11 +575,18 @@ class TabletImpl : public ::openmldb::api::TabletServer {
                                   butil::IOBuf& buf);  // NOLINT
 
  private:
+    // cache_version is the version of the request cache of the procedure read before its compile info is fetched
     void RunRequestQuery(RpcController* controller, const openmldb::api::QueryRequest& request,
-                         ::hybridse::vm::RequestRunSession& session,                  // NOLINT
-                         openmldb::api::QueryResponse& response, butil::IOBuf& buf);  // NOLINT
+                         ::hybridse::vm::RequestRunSession& session, uint64_t cache_version,  // NOLINT
+                         openmldb::api::QueryResponse& response, butil::IOBuf& buf);       // NOLINT
+
+    // compile the procedure and serve it unless it's dropped after `drop_seq`
+    void CreateProcedure(const std::shared_ptr<hybridse::sdk::ProcedureInfo>& sp_info, uint64_t drop_seq);
+    // compile the procedures on sp_compile_pool_, each procedure is served once it is compiled
+    void CreateProcedures(const std::vector<std::shared_ptr<hybridse::sdk::ProcedureInfo>>& sp_infos);
 
-    void CreateProcedure(const std::shared_ptr<hybridse::sdk::ProcedureInfo>& sp_info);
+    // run a procedure in request mode with the aggregators of its table, false if it should be run by the engine
+    bool RunAggrRoute(AggrRoute* route, const ::hybridse::codec::Row& row, ::hybridse::codec::Row* output);
 
     Tables tables_;
     std::mutex mu_;
@@ -484,6 +599,7 @@ class TabletImpl : public ::openmldb::api::TabletServer {
     ThreadPool task_pool_;
     ThreadPool io_pool_;
     ThreadPool snapshot_pool_;
+    ThreadPool sp_compile_pool_;
     std::map<uint64_t, std::list<std::shared_ptr<::openmldb::api::TaskInfo>>> task_map_;
     std::set<std::string> sync_snapshot_set_;
     std::map<std::string, std::shared_ptr<FileReceiver>> file_receiver_map_;
@@ -502,8 +618,16 @@ class TabletImpl : public ::openmldb::api::TabletServer {
     std::string zk_path_;
     std::string endpoint_;
     std::shared_ptr<SpCache> sp_cache_;
+    // the outputs of the procedures in request mode, null if it's disabled
+    std::unique_ptr<RequestCache> request_cache_;
     std::string notify_path_;
     std::string sp_root_path_;
+    std::mutex refresh_mu_;
+    std::unique_ptr<::openmldb::zk::ZkNodeCache> table_node_cache_;
+    std::unique_ptr<::openmldb::zk::ZkNodeCache> sp_node_cache_;
+    // parsed table and procedure info keyed by zk node name, guarded by refresh_mu_
+    std::map<std::string, ::openmldb::nameserver::TableInfo> table_infos_;
+    std::map<std::string, std::shared_ptr<hybridse::sdk::ProcedureInfo>> sp_infos_;
 };
 
 }  // namespace tablet
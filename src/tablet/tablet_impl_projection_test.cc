@@ -18,6 +18,7 @@
 #include <gflags/gflags.h>
 #include <google/protobuf/io/zero_copy_stream_impl.h>
 #include <google/protobuf/text_format.h>
+#include <snappy.h>
 #include <sys/stat.h>
 
 #include "base/file_util.h"
@@ -669,6 +670,78 @@ TEST_P(TabletProjectTest, scan_case) {
     }
 }
 
+TEST_P(TabletProjectTest, compress_scan_case) {
+    auto args = GetParam();
+    std::string name = ::openmldb::tablet::GenRand();
+    int tid = rand() % 10000000;  // NOLINT
+    MockClosure closure;
+    {
+        ::openmldb::api::CreateTableRequest crequest;
+        ::openmldb::api::TableMeta* table_meta = crequest.mutable_table_meta();
+        table_meta->set_name(name);
+        table_meta->set_tid(tid);
+        table_meta->set_pid(0);
+        table_meta->set_seg_cnt(8);
+        table_meta->set_mode(::openmldb::api::TableMode::kTableLeader);
+        table_meta->set_key_entry_max_height(8);
+        table_meta->set_format_version(1);
+        table_meta->set_compress_type(::openmldb::type::kSnappy);
+        Schema* schema = table_meta->mutable_column_desc();
+        schema->CopyFrom(args->schema);
+        ::openmldb::common::ColumnKey* ck = table_meta->add_column_key();
+        ck->CopyFrom(args->ckey);
+        ::openmldb::api::CreateTableResponse cresponse;
+        tablet_.CreateTable(NULL, &crequest, &cresponse, &closure);
+        ASSERT_EQ(0, cresponse.code());
+    }
+    // put the compressed record twice
+    std::string compressed;
+    ::snappy::Compress(reinterpret_cast<char*>(args->row_ptr), args->row_size, &compressed);
+    for (uint64_t i = 0; i < 2; i++) {
+        ::openmldb::api::PutRequest request;
+        request.set_tid(tid);
+        request.set_pid(0);
+        request.set_format_version(1);
+        ::openmldb::api::Dimension* dim = request.add_dimensions();
+        dim->set_idx(0);
+        dim->set_key(args->pk);
+        ::openmldb::api::TSDimension* ts = request.add_ts_dimensions();
+        ts->set_idx(0);
+        ts->set_ts(args->ts - i);
+        request.set_value(compressed);
+        ::openmldb::api::PutResponse response;
+        tablet_.Put(NULL, &request, &response, &closure);
+        ASSERT_EQ(0, response.code());
+    }
+    {
+        ::openmldb::api::ScanRequest sr;
+        sr.set_tid(tid);
+        sr.set_pid(0);
+        sr.set_pk(args->pk);
+        sr.set_st(args->ts);
+        sr.set_et(0);
+        sr.mutable_projection()->CopyFrom(args->plist);
+        ::openmldb::api::ScanResponse srp;
+        tablet_.Scan(NULL, &sr, &srp, &closure);
+        ASSERT_EQ(0, srp.code());
+        ASSERT_EQ(2, (int64_t)srp.count());
+        ::openmldb::base::KvIterator kv_it(&srp);
+        codec::RowView right(args->output_schema);
+        right.Reset(reinterpret_cast<int8_t*>(args->out_ptr), args->out_size);
+        for (int i = 0; i < 2; i++) {
+            ASSERT_TRUE(kv_it.Valid());
+            std::string value;
+            ASSERT_TRUE(::snappy::Uncompress(kv_it.GetValue().data(), kv_it.GetValue().size(), &value));
+            ASSERT_EQ(value.size(), args->out_size);
+            codec::RowView left(args->output_schema);
+            left.Reset(reinterpret_cast<const int8_t*>(value.data()), value.size());
+            CompareRow(&left, &right, args->output_schema);
+            kv_it.Next();
+        }
+        ASSERT_FALSE(kv_it.Valid());
+    }
+}
+
 INSTANTIATE_TEST_SUITE_P(TabletProjectPrefix, TabletProjectTest, testing::ValuesIn(GenCommonCase()));
 
 }  // namespace tablet
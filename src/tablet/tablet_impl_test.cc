@@ -23,13 +23,17 @@
 #include <sys/stat.h>
 
 #include <algorithm>
+#include <future>  // NOLINT
+#include <memory>
 #include <utility>
+#include <vector>
 
 #include "base/file_util.h"
 #include "base/glog_wapper.h"
 #include "base/kv_iterator.h"
 #include "base/strings.h"
 #include "boost/lexical_cast.hpp"
+#include "catalog/schema_adapter.h"
 #include "codec/codec.h"
 #include "codec/flat_array.h"
 #include "codec/row_codec.h"
@@ -53,6 +57,10 @@ DECLARE_string(db_root_path);
 DECLARE_string(recycle_bin_root_path);
 DECLARE_string(endpoint);
 DECLARE_uint32(recycle_ttl);
+DECLARE_uint32(cold_tier_age);
+DECLARE_uint32(block_cache_mb);
+DECLARE_string(file_compression);
+DECLARE_int32(procedure_compile_pool_size);
 
 namespace openmldb {
 namespace tablet {
@@ -79,6 +87,30 @@ class TabletImplTest : public ::testing::Test {
  public:
     TabletImplTest() {}
     ~TabletImplTest() {}
+
+    void CreateProcedures(TabletImpl* tablet, const std::vector<std::shared_ptr<hybridse::sdk::ProcedureInfo>>& sps) {
+        for (const auto& sp : sps) {
+            tablet->catalog_->AddProcedure(sp->GetDbName(), sp->GetSpName(), sp);
+        }
+        tablet->CreateProcedures(sps);
+    }
+    bool ProcedureReady(TabletImpl* tablet, const std::string& db, const std::string& sp_name) {
+        return tablet->sp_cache_->ProcedureExist(db, sp_name);
+    }
+    // block the compile pool until the returned promise is set
+    std::shared_ptr<std::promise<void>> BlockCompilePool(TabletImpl* tablet) {
+        auto latch = std::make_shared<std::promise<void>>();
+        std::shared_future<void> released = latch->get_future().share();
+        tablet->sp_compile_pool_.AddTask([released]() { released.wait(); });
+        return latch;
+    }
+    // wait until the compile tasks queued before are done, the pool has only one thread
+    void WaitCompilePool(TabletImpl* tablet) {
+        auto done = std::make_shared<std::promise<void>>();
+        std::future<void> f = done->get_future();
+        tablet->sp_compile_pool_.AddTask([done]() { done->set_value(); });
+        f.wait();
+    }
 };
 
 bool RollWLogFile(::openmldb::storage::WriteHandle** wh, ::openmldb::storage::LogParts* logs,
@@ -1243,6 +1275,197 @@ TEST_F(TabletImplTest, Scan_with_duplicate_skip) {
     ASSERT_EQ(3, (signed)srp.count());
 }
 
+TEST_F(TabletImplTest, ScanColdTier) {
+    // the rows older than 10 minutes are moved into compressed blocks which are not cached
+    FLAGS_cold_tier_age = 10;
+    FLAGS_file_compression = "zlib";
+    TabletImpl tablet;
+    uint32_t id = counter++;
+    tablet.Init("");
+    ::openmldb::api::CreateTableRequest request;
+    ::openmldb::api::TableMeta* table_meta = request.mutable_table_meta();
+    table_meta->set_name("t0");
+    table_meta->set_tid(id);
+    table_meta->set_pid(1);
+    AddDefaultSchema(0, 0, ::openmldb::type::TTLType::kAbsoluteTime, table_meta);
+    ::openmldb::api::CreateTableResponse response;
+    MockClosure closure;
+    tablet.CreateTable(NULL, &request, &response, &closure);
+    ASSERT_EQ(0, response.code());
+    uint64_t now = ::baidu::common::timer::get_micros() / 1000;
+    uint64_t old_time = now - 20 * 60 * 1000;
+    int row_cnt = 1000;
+    auto make_value = [](int i) { return std::string(200, 'v') + std::to_string(i); };
+    for (int i = 0; i < row_cnt; i++) {
+        ::openmldb::api::PutRequest prequest;
+        prequest.set_pk("test1");
+        prequest.set_time(old_time - i);
+        prequest.set_value(make_value(i));
+        prequest.set_tid(id);
+        prequest.set_pid(1);
+        ::openmldb::api::PutResponse presponse;
+        tablet.Put(NULL, &prequest, &presponse, &closure);
+        ASSERT_EQ(0, presponse.code());
+    }
+    ::openmldb::api::ExecuteGcRequest gc_request;
+    gc_request.set_tid(id);
+    gc_request.set_pid(1);
+    ::openmldb::api::GeneralResponse gc_response;
+    tablet.ExecuteGc(NULL, &gc_request, &gc_response, &closure);
+    ASSERT_EQ(0, gc_response.code());
+    sleep(3);
+    FLAGS_cold_tier_age = 0;
+    FLAGS_file_compression = "off";
+
+    // the values of the rows are kept after the iterator moves to the next block
+    ::openmldb::api::ScanRequest sr;
+    sr.set_tid(id);
+    sr.set_pid(1);
+    sr.set_pk("test1");
+    sr.set_st(now);
+    sr.set_et(0);
+    ::openmldb::api::ScanResponse srp;
+    tablet.Scan(NULL, &sr, &srp, &closure);
+    ASSERT_EQ(0, srp.code());
+    ASSERT_EQ(row_cnt, (signed)srp.count());
+    ::openmldb::base::KvIterator kv_it(&srp, false);
+    for (int i = 0; i < row_cnt; i++) {
+        ASSERT_TRUE(kv_it.Valid());
+        ASSERT_EQ(old_time - i, kv_it.GetKey());
+        ASSERT_EQ(make_value(i), kv_it.GetValue().ToString());
+        kv_it.Next();
+    }
+    ASSERT_FALSE(kv_it.Valid());
+}
+
+::openmldb::api::ProcedureInfo BuildProcedureProto(const std::string& db, const std::string& sp_name,
+                                                  const std::string& sql,
+                                                  const ::openmldb::api::TableMeta& table_meta) {
+    ::openmldb::api::ProcedureInfo sp_info;
+    sp_info.set_db_name(db);
+    sp_info.set_sp_name(sp_name);
+    sp_info.set_sql(sql);
+    sp_info.mutable_input_schema()->CopyFrom(table_meta.column_desc());
+    sp_info.mutable_output_schema()->CopyFrom(table_meta.column_desc());
+    sp_info.set_main_table(table_meta.name());
+    sp_info.add_tables(table_meta.name());
+    return sp_info;
+}
+
+std::shared_ptr<hybridse::sdk::ProcedureInfo> BuildProcedureInfo(const std::string& db, const std::string& sp_name,
+                                                                 const std::string& sql,
+                                                                 const ::openmldb::api::TableMeta& table_meta) {
+    return ::openmldb::catalog::SchemaAdapter::ConvertProcedureInfo(BuildProcedureProto(db, sp_name, sql, table_meta));
+}
+
+void CreateProcedureTable(TabletImpl* tablet, const std::string& db, uint32_t tid,
+                          ::openmldb::api::TableMeta* table_meta) {
+    ::openmldb::api::CreateTableRequest request;
+    table_meta->set_db(db);
+    table_meta->set_name("t0");
+    table_meta->set_tid(tid);
+    table_meta->set_pid(0);
+    table_meta->set_mode(::openmldb::api::TableMode::kTableLeader);
+    AddDefaultSchema(0, 0, ::openmldb::type::TTLType::kAbsoluteTime, table_meta);
+    request.mutable_table_meta()->CopyFrom(*table_meta);
+    ::openmldb::api::CreateTableResponse response;
+    MockClosure closure;
+    tablet->CreateTable(NULL, &request, &response, &closure);
+    ASSERT_EQ(0, response.code());
+}
+
+TEST_F(TabletImplTest, CreateProceduresReadyEach) {
+    FLAGS_procedure_compile_pool_size = 1;
+    TabletImpl tablet;
+    tablet.Init("");
+    std::string db = "db" + GenRand();
+    ::openmldb::api::TableMeta table_meta;
+    CreateProcedureTable(&tablet, db, counter++, &table_meta);
+    auto sp1 = BuildProcedureInfo(db, "sp1", "select idx0, value from t0;", table_meta);
+    auto sp2 = BuildProcedureInfo(db, "sp2", "select idx0, not_exist from t0;", table_meta);
+    auto sp3 = BuildProcedureInfo(db, "sp3", "select value, idx0 from t0;", table_meta);
+    ASSERT_TRUE(sp1 && sp2 && sp3);
+
+    auto latch = BlockCompilePool(&tablet);
+    CreateProcedures(&tablet, {sp1, sp2, sp3});
+    // none is served before it is compiled
+    ASSERT_FALSE(ProcedureReady(&tablet, db, "sp1"));
+    ASSERT_FALSE(ProcedureReady(&tablet, db, "sp3"));
+    latch->set_value();
+    WaitCompilePool(&tablet);
+    // the procedure failed to compile does not block the others
+    ASSERT_TRUE(ProcedureReady(&tablet, db, "sp1"));
+    ASSERT_FALSE(ProcedureReady(&tablet, db, "sp2"));
+    ASSERT_TRUE(ProcedureReady(&tablet, db, "sp3"));
+    FLAGS_procedure_compile_pool_size = 4;
+}
+
+TEST_F(TabletImplTest, DropProcedureWhileCompiling) {
+    FLAGS_procedure_compile_pool_size = 1;
+    TabletImpl tablet;
+    tablet.Init("");
+    std::string db = "db" + GenRand();
+    ::openmldb::api::TableMeta table_meta;
+    CreateProcedureTable(&tablet, db, counter++, &table_meta);
+    auto sp = BuildProcedureInfo(db, "sp1", "select idx0, value from t0;", table_meta);
+    auto other = BuildProcedureInfo(db, "sp2", "select value, idx0 from t0;", table_meta);
+    ASSERT_TRUE(sp && other);
+    MockClosure closure;
+    ::openmldb::api::DropProcedureRequest drop_request;
+    drop_request.set_db_name(db);
+    drop_request.set_sp_name("sp1");
+    ::openmldb::api::GeneralResponse drop_response;
+
+    // dropped before the queued compilation runs
+    auto latch = BlockCompilePool(&tablet);
+    CreateProcedures(&tablet, {sp, other});
+    tablet.DropProcedure(NULL, &drop_request, &drop_response, &closure);
+    ASSERT_EQ(0, drop_response.code());
+    ASSERT_EQ(1u, tablet.sp_cache_->GetDropSeqCnt());
+    latch->set_value();
+    WaitCompilePool(&tablet);
+    ASSERT_FALSE(ProcedureReady(&tablet, db, "sp1"));
+    // the drop of another procedure does not reject the compilation
+    ASSERT_TRUE(ProcedureReady(&tablet, db, "sp2"));
+    // the drops are not kept once no compilation is in flight
+    ASSERT_EQ(0u, tablet.sp_cache_->GetDropSeqCnt());
+    tablet.DropProcedure(NULL, &drop_request, &drop_response, &closure);
+    ASSERT_EQ(0u, tablet.sp_cache_->GetDropSeqCnt());
+
+    // the drop is forgotten once the procedure is created again
+    latch = BlockCompilePool(&tablet);
+    CreateProcedures(&tablet, {other});
+    drop_request.set_sp_name("sp2");
+    tablet.DropProcedure(NULL, &drop_request, &drop_response, &closure);
+    ASSERT_EQ(1u, tablet.sp_cache_->GetDropSeqCnt());
+    ::openmldb::api::CreateProcedureRequest create_request;
+    ::openmldb::api::GeneralResponse create_response;
+    create_request.mutable_sp_info()->CopyFrom(BuildProcedureProto(db, "sp2", "select value, idx0 from t0;",
+                                                                   table_meta));
+    tablet.CreateProcedure(NULL, &create_request, &create_response, &closure);
+    ASSERT_EQ(0, create_response.code());
+    ASSERT_EQ(0u, tablet.sp_cache_->GetDropSeqCnt());
+    latch->set_value();
+    WaitCompilePool(&tablet);
+    ASSERT_TRUE(ProcedureReady(&tablet, db, "sp2"));
+    drop_request.set_sp_name("sp1");
+
+    // dropped at some point of the compilation
+    for (int i = 0; i < 20; i++) {
+        CreateProcedures(&tablet, {sp});
+        usleep(i * 500);
+        tablet.DropProcedure(NULL, &drop_request, &drop_response, &closure);
+        ASSERT_EQ(0, drop_response.code());
+        WaitCompilePool(&tablet);
+        ASSERT_FALSE(ProcedureReady(&tablet, db, "sp1"));
+    }
+    // compiled again once it is recreated
+    CreateProcedures(&tablet, {sp});
+    WaitCompilePool(&tablet);
+    ASSERT_TRUE(ProcedureReady(&tablet, db, "sp1"));
+    FLAGS_procedure_compile_pool_size = 4;
+}
+
 TEST_F(TabletImplTest, Scan_with_latestN) {
     TabletImpl tablet;
     uint32_t id = counter++;
@@ -2105,6 +2328,84 @@ TEST_F(TabletImplTest, Recover) {
     }
 }
 
+TEST_F(TabletImplTest, DiskTableRecover) {
+    uint32_t id = counter++;
+    MockClosure closure;
+    std::string disk_path = FLAGS_db_root_path + "/" + std::to_string(id) + "_" + std::to_string(1) + "/disk";
+    {
+        TabletImpl tablet;
+        tablet.Init("");
+        ::openmldb::api::CreateTableRequest request;
+        ::openmldb::api::TableMeta* table_meta = request.mutable_table_meta();
+        table_meta->set_name("t0");
+        table_meta->set_tid(id);
+        table_meta->set_pid(1);
+        AddDefaultSchema(0, 0, ::openmldb::type::TTLType::kAbsoluteTime, table_meta);
+        table_meta->set_term(1024);
+        table_meta->set_mode(::openmldb::api::TableMode::kTableLeader);
+        table_meta->set_storage_mode(::openmldb::type::StorageMode::kDisk);
+        ::openmldb::api::CreateTableResponse response;
+        tablet.CreateTable(NULL, &request, &response, &closure);
+        ASSERT_EQ(0, response.code());
+        ASSERT_TRUE(::openmldb::base::IsExists(disk_path));
+        for (uint64_t ts = 9527; ts < 9529; ts++) {
+            ::openmldb::api::PutRequest prequest;
+            prequest.set_pk("test1");
+            prequest.set_time(ts);
+            prequest.set_value("test" + std::to_string(ts));
+            prequest.set_tid(id);
+            prequest.set_pid(1);
+            ::openmldb::api::PutResponse presponse;
+            tablet.Put(NULL, &prequest, &presponse, &closure);
+            ASSERT_EQ(0, presponse.code());
+        }
+        ::openmldb::api::ScanRequest sr;
+        sr.set_tid(id);
+        sr.set_pid(1);
+        sr.set_pk("test1");
+        sr.set_st(9530);
+        sr.set_et(9526);
+        ::openmldb::api::ScanResponse srp;
+        tablet.Scan(NULL, &sr, &srp, &closure);
+        ASSERT_EQ(0, srp.code());
+        ASSERT_EQ(2, (signed)srp.count());
+        // a disk table does not support the memtable only operations
+        ::openmldb::api::BulkLoadInfoRequest bl_request;
+        bl_request.set_tid(id);
+        bl_request.set_pid(1);
+        ::openmldb::api::BulkLoadInfoResponse bl_response;
+        tablet.GetBulkLoadInfo(NULL, &bl_request, &bl_response, &closure);
+        ASSERT_EQ(::openmldb::base::ReturnCode::kTableTypeMismatch, bl_response.code());
+    }
+    // the storage mode is kept in table_meta.txt, so the load request does not need to set it
+    {
+        TabletImpl tablet;
+        tablet.Init("");
+        ::openmldb::api::LoadTableRequest request;
+        ::openmldb::api::TableMeta* table_meta = request.mutable_table_meta();
+        table_meta->set_name("t0");
+        table_meta->set_tid(id);
+        table_meta->set_pid(1);
+        table_meta->set_mode(::openmldb::api::TableMode::kTableLeader);
+        ::openmldb::api::GeneralResponse response;
+        tablet.LoadTable(NULL, &request, &response, &closure);
+        ASSERT_EQ(0, response.code());
+        sleep(1);
+        ASSERT_TRUE(::openmldb::base::IsExists(disk_path));
+        // the rows are recovered from the binlog into the rebuilt files without duplicates
+        ::openmldb::api::ScanRequest sr;
+        sr.set_tid(id);
+        sr.set_pid(1);
+        sr.set_pk("test1");
+        sr.set_st(9530);
+        sr.set_et(9526);
+        ::openmldb::api::ScanResponse srp;
+        tablet.Scan(NULL, &sr, &srp, &closure);
+        ASSERT_EQ(0, srp.code());
+        ASSERT_EQ(2, (signed)srp.count());
+    }
+}
+
 TEST_F(TabletImplTest, LoadWithDeletedKey) {
     uint32_t id = counter++;
     MockClosure closure;
@@ -5702,5 +6003,7 @@ int main(int argc, char** argv) {
     ::openmldb::base::SetLogLevel(INFO);
     ::google::ParseCommandLineFlags(&argc, &argv, true);
     FLAGS_db_root_path = "/tmp/" + ::openmldb::tablet::GenRand();
+    // the uncompressed blocks of the cold tier are released once the iterators leave them
+    FLAGS_block_cache_mb = 0;
     return RUN_ALL_TESTS();
 }
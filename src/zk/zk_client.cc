@@ -360,6 +360,34 @@ bool ZkClient::GetNodeValue(const std::string& node, std::string& value) {
     return GetNodeValueUnLocked(node, value);
 }
 
+bool ZkClient::GetNodeValueAndVersion(const std::string& node, std::string* value, int64_t* version) {
+    if (value == NULL || version == NULL) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mu_);
+    int buffer_len = ZK_MAX_BUFFER_SIZE;
+    Stat stat;
+    if (zoo_get(zk_, node.c_str(), 0, buffer_, &buffer_len, &stat) == ZOK) {
+        value->assign(buffer_, buffer_len);
+        *version = stat.mzxid;
+        return true;
+    }
+    return false;
+}
+
+bool ZkClient::GetNodeVersion(const std::string& node, int64_t* version) {
+    if (version == NULL || node.empty()) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mu_);
+    Stat stat;
+    if (zoo_exists(zk_, node.c_str(), 0, &stat) == ZOK) {
+        *version = stat.mzxid;
+        return true;
+    }
+    return false;
+}
+
 bool ZkClient::SetNodeValue(const std::string& node, const std::string& value) {
     std::lock_guard<std::mutex> lock(mu_);
     if (node.empty()) {
@@ -87,6 +87,11 @@ class ZkClient {
     bool GetNodeValueUnLocked(const std::string& node,
                               std::string& value);  // NOLINT
 
+    // version is the zxid of the last modification of node
+    bool GetNodeValueAndVersion(const std::string& node, std::string* value, int64_t* version);
+
+    bool GetNodeVersion(const std::string& node, int64_t* version);
+
     bool SetNodeValue(const std::string& node, const std::string& value);
 
     bool SetNodeWatcher(const std::string& node, watcher_fn watcher, void* watcherCtx);
@@ -0,0 +1,204 @@
+/*
+ * Copyright 2021 4Paradigm
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "zk/zk_node_cache.h"
+
+#include <cstdlib>
+#include <set>
+#include <sstream>
+
+#include "glog/logging.h"
+
+namespace openmldb {
+namespace zk {
+
+void ZkChangeLog::Append(const std::vector<std::string>& paths, uint32_t max_entries) {
+    seq++;
+    for (const auto& path : paths) {
+        entries.emplace_back(seq, path);
+    }
+    while (entries.size() > max_entries) {
+        floor = entries.front().first;
+        entries.pop_front();
+    }
+}
+
+std::string ZkChangeLog::Encode() const {
+    std::string value = std::to_string(epoch) + " " + std::to_string(seq) + " " + std::to_string(floor) + "\n";
+    for (const auto& entry : entries) {
+        value.append(std::to_string(entry.first)).append(" ").append(entry.second).append("\n");
+    }
+    return value;
+}
+
+bool ZkChangeLog::Decode(const std::string& value) {
+    entries.clear();
+    std::istringstream ss(value);
+    std::string line;
+    if (!std::getline(ss, line)) {
+        return false;
+    }
+    std::istringstream header(line);
+    if (!(header >> epoch >> seq >> floor)) {
+        return false;
+    }
+    while (std::getline(ss, line)) {
+        char* end = nullptr;
+        uint64_t entry_seq = strtoull(line.c_str(), &end, 10);
+        if (end == line.c_str() || *end != ' ') {
+            return false;
+        }
+        entries.emplace_back(entry_seq, std::string(end + 1));
+    }
+    return true;
+}
+
+ZkNodeCache::ZkNodeCache(ZkClient* zk_client, const std::string& root_path, const std::string& change_log_path)
+    : zk_client_(zk_client),
+      root_path_(root_path),
+      change_log_path_(change_log_path),
+      versions_(),
+      invalid_(),
+      has_seq_(false),
+      epoch_(0),
+      seq_(0) {}
+
+void ZkNodeCache::Reset() {
+    versions_.clear();
+    invalid_.clear();
+    has_seq_ = false;
+}
+
+bool ZkNodeCache::Refresh(std::map<std::string, std::string>* changed, std::vector<std::string>* deleted) {
+    if (changed == nullptr || deleted == nullptr) {
+        return false;
+    }
+    changed->clear();
+    deleted->clear();
+    ZkChangeLog log;
+    bool has_log = false;
+    if (!change_log_path_.empty()) {
+        std::string value;
+        // the log is absent if nameserver doesn't write it
+        has_log = zk_client_->GetNodeValue(change_log_path_, value) && log.Decode(value);
+    }
+    if (has_log && RefreshByLog(log, changed, deleted)) {
+        return true;
+    }
+    if (!RefreshAll(changed, deleted)) {
+        return false;
+    }
+    // the changes before the log is read are covered by the full refresh
+    has_seq_ = has_log;
+    epoch_ = log.epoch;
+    seq_ = log.seq;
+    return true;
+}
+
+bool ZkNodeCache::RefreshByLog(const ZkChangeLog& log, std::map<std::string, std::string>* changed,
+                               std::vector<std::string>* deleted) {
+    if (!has_seq_ || epoch_ != log.epoch || seq_ < log.floor || seq_ > log.seq) {
+        return false;
+    }
+    std::set<std::string> nodes;
+    nodes.swap(invalid_);
+    std::string prefix = root_path_ + "/";
+    for (const auto& entry : log.entries) {
+        if (entry.first > seq_ && entry.second.compare(0, prefix.size(), prefix) == 0) {
+            nodes.insert(entry.second.substr(prefix.size()));
+        }
+    }
+    for (const auto& node : nodes) {
+        std::string path = prefix + node;
+        std::string value;
+        int64_t version = 0;
+        if (zk_client_->GetNodeValueAndVersion(path, &value, &version)) {
+            versions_[node] = version;
+            changed->emplace(node, std::move(value));
+            continue;
+        }
+        int ret = zk_client_->IsExistNode(path);
+        if (ret > 0) {
+            if (versions_.erase(node) > 0) {
+                deleted->push_back(node);
+            }
+        } else {
+            // get it again in the next refresh
+            LOG(WARNING) << "fail to get node value with path " << path;
+            invalid_.insert(node);
+        }
+    }
+    seq_ = log.seq;
+    DLOG(INFO) << "refresh " << root_path_ << " by change log, changed " << changed->size() << ", deleted "
+               << deleted->size();
+    return true;
+}
+
+bool ZkNodeCache::RefreshAll(std::map<std::string, std::string>* changed, std::vector<std::string>* deleted) {
+    std::vector<std::string> children;
+    int ret = zk_client_->IsExistNode(root_path_);
+    if (ret == 0) {
+        if (!zk_client_->GetChildren(root_path_, children)) {
+            LOG(WARNING) << "fail to get children with path " << root_path_;
+            return false;
+        }
+    } else if (ret < 0) {
+        LOG(WARNING) << "fail to check path " << root_path_;
+        return false;
+    }
+    invalid_.clear();
+    std::set<std::string> alive;
+    for (const auto& node : children) {
+        if (node.empty()) continue;
+        alive.insert(node);
+        std::string path = root_path_ + "/" + node;
+        auto it = versions_.find(node);
+        if (it != versions_.end()) {
+            int64_t version = 0;
+            if (!zk_client_->GetNodeVersion(path, &version)) {
+                // the node may be deleted just now, it will be handled in the next refresh
+                DLOG(INFO) << "fail to get version of node " << path;
+                invalid_.insert(node);
+                continue;
+            }
+            if (version == it->second) {
+                continue;
+            }
+        }
+        std::string value;
+        int64_t version = 0;
+        if (!zk_client_->GetNodeValueAndVersion(path, &value, &version)) {
+            LOG(WARNING) << "fail to get node value with path " << path;
+            invalid_.insert(node);
+            continue;
+        }
+        versions_[node] = version;
+        changed->emplace(node, std::move(value));
+    }
+    for (auto it = versions_.begin(); it != versions_.end();) {
+        if (alive.find(it->first) == alive.end()) {
+            deleted->push_back(it->first);
+            it = versions_.erase(it);
+            continue;
+        }
+        ++it;
+    }
+    DLOG(INFO) << "refresh " << root_path_ << ", changed " << changed->size() << ", deleted " << deleted->size();
+    return true;
+}
+
+}  // namespace zk
+}  // namespace openmldb
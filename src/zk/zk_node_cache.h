@@ -0,0 +1,102 @@
+/*
+ * Copyright 2021 4Paradigm
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SRC_ZK_ZK_NODE_CACHE_H_
+#define SRC_ZK_ZK_NODE_CACHE_H_
+
+#include <deque>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "zk/zk_client.h"
+
+namespace openmldb {
+namespace zk {
+
+// ZkChangeLog is the recent changes of the table and procedure nodes. Nameserver
+// writes it before every table changed notification, each notification has a
+// sequence number and the paths of the nodes changed by it
+struct ZkChangeLog {
+    // the sequence numbers of different epochs are not comparable
+    uint64_t epoch = 0;
+    // the sequence number of the last notification
+    uint64_t seq = 0;
+    // the entries of the notifications after floor are complete
+    uint64_t floor = 0;
+    // sequence number and node path, in the order of sequence number
+    std::deque<std::pair<uint64_t, std::string>> entries;
+
+    // start a new notification with the changed paths, the oldest entries are
+    // dropped if there are more than max_entries
+    void Append(const std::vector<std::string>& paths, uint32_t max_entries);
+
+    // the format is "epoch seq floor" followed by a line "seq path" for every entry
+    std::string Encode() const;
+    bool Decode(const std::string& value);
+};
+
+// ZkNodeCache tracks the version of every child of root_path, so that a refresh
+// only fetches the children which are added or modified since the last one.
+// If change_log_path is set, the changed children are read from the change log
+// and the children are listed and checked only when the log doesn't cover the
+// changes since the last refresh
+class ZkNodeCache {
+ public:
+    ZkNodeCache(ZkClient* zk_client, const std::string& root_path, const std::string& change_log_path = "");
+
+    // changed holds the node name and value of the added or modified children,
+    // deleted holds the name of the removed children
+    bool Refresh(std::map<std::string, std::string>* changed, std::vector<std::string>* deleted);
+
+    // all children will be fetched in the next refresh
+    void Reset();
+
+    // the node will be fetched in the next refresh even if it is not modified
+    void Invalidate(const std::string& node) {
+        versions_.erase(node);
+        invalid_.insert(node);
+    }
+
+    inline const std::string& GetRootPath() const { return root_path_; }
+
+    inline uint32_t Size() const { return versions_.size(); }
+
+ private:
+    // fetch the children in the log entries after the last refresh, it returns
+    // false if the log doesn't cover them
+    bool RefreshByLog(const ZkChangeLog& log, std::map<std::string, std::string>* changed,
+                      std::vector<std::string>* deleted);
+
+    bool RefreshAll(std::map<std::string, std::string>* changed, std::vector<std::string>* deleted);
+
+    ZkClient* zk_client_;
+    std::string root_path_;
+    std::string change_log_path_;
+    std::map<std::string, int64_t> versions_;
+    std::set<std::string> invalid_;
+    // the epoch and sequence number of the change log seen by the last refresh
+    bool has_seq_;
+    uint64_t epoch_;
+    uint64_t seq_;
+};
+
+}  // namespace zk
+}  // namespace openmldb
+
+#endif  // SRC_ZK_ZK_NODE_CACHE_H_
@@ -0,0 +1,121 @@
+/*
+ * Copyright 2021 4Paradigm
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "zk/zk_node_cache.h"
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace openmldb {
+namespace zk {
+
+class ZkNodeCacheTest : public ::testing::Test {
+ public:
+    ZkNodeCacheTest() {}
+    ~ZkNodeCacheTest() {}
+};
+
+TEST_F(ZkNodeCacheTest, ChangeLog) {
+    ZkChangeLog log;
+    log.epoch = 10;
+    log.Append({"/t/db_table_data/1", "/t/db_table_data/2"}, 3);
+    log.Append({}, 3);
+    log.Append({"/sp/db_sp_data/db.sp"}, 3);
+    ASSERT_EQ(3u, log.seq);
+    ASSERT_EQ(0u, log.floor);
+    ASSERT_EQ(3u, log.entries.size());
+
+    ZkChangeLog decoded;
+    ASSERT_TRUE(decoded.Decode(log.Encode()));
+    ASSERT_EQ(10u, decoded.epoch);
+    ASSERT_EQ(3u, decoded.seq);
+    ASSERT_EQ(0u, decoded.floor);
+    ASSERT_EQ(log.entries, decoded.entries);
+
+    // the oldest entries are dropped and the floor moves
+    log.Append({"/t/db_table_data/3"}, 3);
+    ASSERT_EQ(4u, log.seq);
+    ASSERT_EQ(1u, log.floor);
+    ASSERT_EQ(3u, log.entries.size());
+    ASSERT_EQ("/t/db_table_data/2", log.entries.front().second);
+
+    ASSERT_FALSE(decoded.Decode(""));
+    ASSERT_FALSE(decoded.Decode("1 2\n"));
+    ASSERT_FALSE(decoded.Decode("1 2 0\nabc\n"));
+}
+
+TEST_F(ZkNodeCacheTest, RefreshByLog) {
+    ZkClient client("127.0.0.1:6181", "", 30000, "127.0.0.1:9527", "/rtidb");
+    bool ok = client.Init();
+    ASSERT_TRUE(ok);
+    std::string root = "/rtidb/node_cache_test";
+    std::string log_path = "/rtidb/node_cache_test_log";
+    client.DeleteNode(root + "/t1");
+    client.DeleteNode(root + "/t2");
+    client.DeleteNode(root);
+    client.DeleteNode(log_path);
+    ZkChangeLog log;
+    log.epoch = 1;
+    ASSERT_TRUE(client.CreateNode(log_path, log.Encode()));
+    ASSERT_TRUE(client.CreateNode(root + "/t1", "v1"));
+
+    ZkNodeCache cache(&client, root, log_path);
+    std::map<std::string, std::string> changed;
+    std::vector<std::string> deleted;
+    ASSERT_TRUE(cache.Refresh(&changed, &deleted));
+    ASSERT_EQ(1u, changed.size());
+    ASSERT_EQ("v1", changed["t1"]);
+
+    // a node changed without a log entry is not fetched
+    ASSERT_TRUE(client.SetNodeValue(root + "/t1", "v1.1"));
+    ASSERT_TRUE(client.CreateNode(root + "/t2", "v2"));
+    log.Append({root + "/t2"}, 10);
+    ASSERT_TRUE(client.SetNodeValue(log_path, log.Encode()));
+    ASSERT_TRUE(cache.Refresh(&changed, &deleted));
+    ASSERT_EQ(1u, changed.size());
+    ASSERT_EQ("v2", changed["t2"]);
+    ASSERT_TRUE(deleted.empty());
+
+    ASSERT_TRUE(client.DeleteNode(root + "/t2"));
+    log.Append({root + "/t2", "/rtidb/other/t2"}, 10);
+    ASSERT_TRUE(client.SetNodeValue(log_path, log.Encode()));
+    ASSERT_TRUE(cache.Refresh(&changed, &deleted));
+    ASSERT_TRUE(changed.empty());
+    ASSERT_EQ(std::vector<std::string>({"t2"}), deleted);
+
+    // a new epoch falls back to the full refresh
+    log = ZkChangeLog();
+    log.epoch = 2;
+    ASSERT_TRUE(client.SetNodeValue(log_path, log.Encode()));
+    ASSERT_TRUE(cache.Refresh(&changed, &deleted));
+    ASSERT_EQ(1u, changed.size());
+    ASSERT_EQ("v1.1", changed["t1"]);
+
+    client.DeleteNode(root + "/t1");
+    client.DeleteNode(root);
+    client.DeleteNode(log_path);
+}
+
+}  // namespace zk
+}  // namespace openmldb
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}